@@ -2,6 +2,7 @@ struct VSInput
 {
     float3 position : POSITION;
     float2 texCoord : TEXCOORD;
+    uint instanceId : SV_InstanceID;
 };
 struct VSOutput
 {
@@ -10,13 +11,15 @@ struct VSOutput
 };
 cbuffer UniformBlockRootConstant : register(b0)
 {
-    float4x4 worldViewProj;
+    float4x4 viewProj;
 };
+StructuredBuffer<float4x4> worldMatrices : register(t0, space1);
 
 VSOutput main(VSInput input)
 {
     VSOutput result;
-    (result.position = mul(worldViewProj, float4(input.position, 1.0)));
+    float4 worldPos = mul(worldMatrices[input.instanceId], float4(input.position, 1.0));
+    (result.position = mul(viewProj, worldPos));
     (result.texCoord = input.texCoord);
     return result;
 };
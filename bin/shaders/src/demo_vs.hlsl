@@ -2,6 +2,7 @@ struct VSInput
 {
     float3 position : POSITION;
     float2 texCoord : TEXCOORD;
+    uint instanceId : SV_InstanceID;
 };
 
 struct VSOutput
@@ -12,13 +13,16 @@ struct VSOutput
 
 cbuffer UniformBlockRootConstant : register(b0)
 {
-    float4x4 worldViewProj;
+    float4x4 viewProj;
 };
 
+StructuredBuffer<float4x4> worldMatrices : register(t0, space1);
+
 VSOutput main(VSInput input)
 {
     VSOutput result;
-    result.position = mul(worldViewProj, float4(input.position, 1.0f));
+    float4 worldPos = mul(worldMatrices[input.instanceId], float4(input.position, 1.0f));
+    result.position = mul(viewProj, worldPos);
     result.texCoord = input.texCoord;
     return result;
 };
@@ -21,6 +21,7 @@ struct VSInput
 {
     vec3 position;
     vec2 texCoord;
+    uint instanceId;
 };
 struct VSOutput
 {
@@ -29,13 +30,19 @@ struct VSOutput
 };
 layout(row_major, push_constant) uniform UniformBlockRootConstant_Block
 {
-    mat4 worldViewProj;
+    mat4 viewProj;
 }UniformBlockRootConstant;
 
+layout(row_major, set = 1, binding = 0) readonly buffer worldMatrices
+{
+    mat4 worldMatrices_Data[];
+};
+
 VSOutput HLSLmain(VSInput input1)
 {
     VSOutput result;
-    ((result).position = MulMat(UniformBlockRootConstant.worldViewProj,vec4((input1).position, 1.0)));
+    vec4 worldPos = MulMat(worldMatrices_Data[(input1).instanceId],vec4((input1).position, 1.0));
+    ((result).position = MulMat(UniformBlockRootConstant.viewProj,worldPos));
     ((result).texCoord = (input1).texCoord);
     return result;
 }
@@ -44,6 +51,7 @@ void main()
     VSInput input1;
     input1.position = POSITION;
     input1.texCoord = TEXCOORD;
+    input1.instanceId = gl_InstanceIndex;
     VSOutput result = HLSLmain(input1);
     gl_Position = result.position;
     vertOutput_TEXCOORD = result.texCoord;
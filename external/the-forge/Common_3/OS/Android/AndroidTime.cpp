@@ -46,15 +46,16 @@ uint32_t getSystemTime()
 	return (uint32_t)ms;
 }
 
-int64_t getUSec()
+// Not affected by wall clock changes
+int64_t getNSec()
 {
 	timespec ts;
-	clock_gettime(CLOCK_REALTIME, &ts);
-	long us = (ts.tv_nsec / 1000);
-	us += ts.tv_sec * 1e6;
-	return us;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
 }
 
+int64_t getUSec() { return getNSec() / 1000; }
+
 uint32_t getTimeSinceStart() { return (uint32_t)time(NULL); }
 
 int64_t getTimerFrequency()
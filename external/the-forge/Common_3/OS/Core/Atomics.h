@@ -43,6 +43,7 @@ typedef volatile ALIGNAS(PTR_SIZE) uintptr_t tfrg_atomicptr_t;
 
 	#define tfrg_memorybarrier_acquire() _ReadWriteBarrier()
 	#define tfrg_memorybarrier_release() _ReadWriteBarrier()
+	#define tfrg_memorybarrier_full() MemoryBarrier()
 
 	#define tfrg_atomic32_load_relaxed(pVar) (*(pVar))
 	#define tfrg_atomic32_store_relaxed(dst, val) _InterlockedExchange( (volatile long*)(dst), val )
@@ -57,6 +58,7 @@ typedef volatile ALIGNAS(PTR_SIZE) uintptr_t tfrg_atomicptr_t;
 #else
 	#define tfrg_memorybarrier_acquire() __asm__ __volatile__("": : :"memory")
 	#define tfrg_memorybarrier_release() __asm__ __volatile__("": : :"memory")
+	#define tfrg_memorybarrier_full() __sync_synchronize()
 
 	#define tfrg_atomic32_load_relaxed(pVar) (*(pVar))
 	#define tfrg_atomic32_store_relaxed(dst, val) __sync_lock_test_and_set ( (volatile int32_t*)(dst), val )
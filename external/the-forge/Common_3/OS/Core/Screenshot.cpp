@@ -27,6 +27,9 @@
 #if defined(SCREENSHOT_ENABLED)
 #include "../Interfaces/ILog.h"
 #include "../Interfaces/IFileSystem.h"
+#include "../Interfaces/IThread.h"
+#include "../Core/Atomics.h"
+#include "../Core/ThreadSystem.h"
 #include "../../ThirdParty/OpenSource/tinyimageformat/tinyimageformat_query.h"
 
 #if defined(ORBIS)
@@ -41,17 +44,280 @@
 #define STBIW_FREE tf_free
 #define STBIW_ASSERT ASSERT
 #include "../../ThirdParty/OpenSource/Nothings/stb_image_write.h"
+#include "ScreenshotEncoders.h"
+
+#define DEFAULT_SCREENSHOT_RING_SIZE 4
+#define MAX_SCREENSHOT_RING_SIZE 16
+
+typedef enum ScreenshotSlotState
+{
+	SCREENSHOT_SLOT_FREE = 0,
+	// Copy submitted, waiting for pFence
+	SCREENSHOT_SLOT_GPU_PENDING,
+	// Owned by a worker until it is written
+	SCREENSHOT_SLOT_ENCODING,
+} ScreenshotSlotState;
+
+typedef struct ScreenshotSlot
+{
+	CmdPool*         pCmdPool;
+	Cmd*             pCmd;
+	Fence*           pFence;
+	Semaphore*       pSemaphore;
+	// Persistently mapped readback buffer, Vulkan only. The other backends read back into pPixels directly.
+	Buffer*          pBuffer;
+	uint8_t*         pPixels;
+	uint64_t         mSize;
+	uint64_t         mSequence;
+	uint32_t         mWidth;
+	uint32_t         mHeight;
+	uint32_t         mPixelByteSize;
+	uint32_t         mChannelCount;
+	ScreenshotFormat mFormat;
+	bool             mFlipRedBlueChannel;
+	// Protected by gCaptureMutex once the slot was handed to a worker
+	uint32_t         mState;
+	char             mFileName[FS_MAX_PATH];
+} ScreenshotSlot;
 
 static Cmd* pCmd = 0;
 static CmdPool* pCmdPool = 0;
 static Renderer* pRendererRef = 0;
 
-void initScreenshotInterface(Renderer* pRenderer, Queue* pGraphicsQueue)
+// Capture ring used by captureScreenshotAsync, created on first use
+static ScreenshotCaptureDesc gCaptureDesc = {};
+static ScreenshotSlot        gCaptureSlots[MAX_SCREENSHOT_RING_SIZE] = {};
+static uint32_t              gCaptureSlotCount = 0;
+static uint64_t              gCaptureSequence = 0;
+static ThreadSystem*         pCaptureThreadSystem = NULL;
+static Mutex                 gCaptureMutex;
+static ConditionVariable     gCaptureCond;
+
+static tfrg_atomic64_t gCapturedFrames = 0;
+static tfrg_atomic64_t gWrittenFrames = 0;
+static tfrg_atomic64_t gFailedFrames = 0;
+static tfrg_atomic64_t gStalledFrames = 0;
+
+static bool writeScreenshotFile(
+	const char* fileName, const uint8_t* pPixels, uint32_t width, uint32_t height, uint32_t channelCount, uint32_t pixelByteSize,
+	ScreenshotFormat format)
+{
+	uint8_t* pEncoded = NULL;
+	size_t   encodedSize = 0;
+	uint8_t  tgaHeader[18];
+
+	switch (format)
+	{
+	case SCREENSHOT_FORMAT_QOI: pEncoded = encodeQoi(pPixels, width, height, channelCount, &encodedSize); break;
+	case SCREENSHOT_FORMAT_TGA: writeTgaHeader(tgaHeader, width, height, channelCount); break;
+	default:
+	{
+		int len = 0;
+		pEncoded = stbi_write_png_to_mem((unsigned char*)pPixels, width * pixelByteSize, width, height, channelCount, &len);
+		encodedSize = (size_t)len;
+		break;
+	}
+	}
+
+	bool      succeeded = false;
+	FileStream fs = {};
+	if (fsOpenStreamFromPath(RD_SCREENSHOTS, fileName, FM_WRITE_BINARY, &fs))
+	{
+		if (format == SCREENSHOT_FORMAT_TGA)
+		{
+			const size_t size = (size_t)width * height * channelCount;
+			succeeded = fsWriteToStream(&fs, tgaHeader, sizeof(tgaHeader)) == sizeof(tgaHeader) && fsWriteToStream(&fs, pPixels, size) == size;
+		}
+		else
+		{
+			succeeded = pEncoded && fsWriteToStream(&fs, pEncoded, encodedSize) == encodedSize;
+		}
+		fsCloseStream(&fs);
+	}
+
+	if (pEncoded)
+		tf_free(pEncoded);
+	return succeeded;
+}
+
+/************************************************************************/
+// Capture ring
+/************************************************************************/
+static void encodeScreenshotTask(void* pUser, uintptr_t)
+{
+	ScreenshotSlot* pSlot = (ScreenshotSlot*)pUser;
+
+	// TGA stores BGR(A), the other formats RGB(A)
+	const bool swapRedBlue = pSlot->mFormat == SCREENSHOT_FORMAT_TGA ? !pSlot->mFlipRedBlueChannel : pSlot->mFlipRedBlueChannel;
+	const uint8_t* pSrc = pSlot->pPixels;
+#if defined(VULKAN)
+	pSrc = (const uint8_t*)pSlot->pBuffer->pCpuMappedAddress;
+#endif
+	// One pass over the readback memory, which may be slow to read from
+	const size_t pixelCount = (size_t)pSlot->mWidth * pSlot->mHeight;
+	if (swapRedBlue)
+		swizzleRedBlue(pSrc, pSlot->pPixels, pixelCount, pSlot->mPixelByteSize);
+	else if (pSrc != pSlot->pPixels)
+		memcpy(pSlot->pPixels, pSrc, pixelCount * pSlot->mPixelByteSize);
+
+	if (writeScreenshotFile(pSlot->mFileName, pSlot->pPixels, pSlot->mWidth, pSlot->mHeight, pSlot->mChannelCount, pSlot->mPixelByteSize, pSlot->mFormat))
+	{
+		tfrg_atomic64_add_relaxed(&gWrittenFrames, 1);
+	}
+	else
+	{
+		LOGF(eERROR, "Failed to write screenshot %s", pSlot->mFileName);
+		tfrg_atomic64_add_relaxed(&gFailedFrames, 1);
+	}
+
+	MutexLock lock(gCaptureMutex);
+	pSlot->mState = SCREENSHOT_SLOT_FREE;
+	gCaptureCond.WakeAll();
+}
+
+static void dispatchScreenshotSlot(ScreenshotSlot* pSlot)
+{
+	{
+		MutexLock lock(gCaptureMutex);
+		pSlot->mState = SCREENSHOT_SLOT_ENCODING;
+	}
+	addThreadSystemTask(pCaptureThreadSystem, encodeScreenshotTask, pSlot);
+}
+
+// Hands the copies the GPU finished to the workers. With waitForGpu set, every pending copy is waited for.
+static void dispatchCompletedScreenshots(bool waitForGpu)
+{
+	ScreenshotSlot* pPendingSlots[MAX_SCREENSHOT_RING_SIZE];
+	uint32_t        pendingCount = 0;
+	{
+		MutexLock lock(gCaptureMutex);
+		for (uint32_t i = 0; i < gCaptureSlotCount; ++i)
+		{
+			if (gCaptureSlots[i].mState == SCREENSHOT_SLOT_GPU_PENDING)
+				pPendingSlots[pendingCount++] = &gCaptureSlots[i];
+		}
+	}
+
+	for (uint32_t i = 0; i < pendingCount; ++i)
+	{
+		ScreenshotSlot* pSlot = pPendingSlots[i];
+		if (waitForGpu)
+		{
+			waitForFences(pRendererRef, 1, &pSlot->pFence);
+		}
+		else
+		{
+			FenceStatus status = FENCE_STATUS_INCOMPLETE;
+			getFenceStatus(pRendererRef, pSlot->pFence, &status);
+			if (status == FENCE_STATUS_INCOMPLETE)
+				continue;
+		}
+		dispatchScreenshotSlot(pSlot);
+	}
+}
+
+static ScreenshotSlot* acquireScreenshotSlot()
+{
+	bool stalled = false;
+	for (;;)
+	{
+		ScreenshotSlot* pOldestPending = NULL;
+		{
+			MutexLock lock(gCaptureMutex);
+			for (uint32_t i = 0; i < gCaptureSlotCount; ++i)
+			{
+				ScreenshotSlot* pSlot = &gCaptureSlots[i];
+				if (pSlot->mState == SCREENSHOT_SLOT_FREE)
+				{
+					if (stalled)
+						tfrg_atomic64_add_relaxed(&gStalledFrames, 1);
+					return pSlot;
+				}
+				if (pSlot->mState == SCREENSHOT_SLOT_GPU_PENDING && (!pOldestPending || pSlot->mSequence < pOldestPending->mSequence))
+					pOldestPending = pSlot;
+			}
+
+			stalled = true;
+			// Every slot is being encoded
+			if (!pOldestPending)
+			{
+				gCaptureCond.Wait(gCaptureMutex);
+				continue;
+			}
+		}
+
+		waitForFences(pRendererRef, 1, &pOldestPending->pFence);
+		dispatchScreenshotSlot(pOldestPending);
+	}
+}
+
+static void initScreenshotCaptureRing()
+{
+	gCaptureSlotCount = gCaptureDesc.mRingSize ? min<uint32_t>(gCaptureDesc.mRingSize, MAX_SCREENSHOT_RING_SIZE) : DEFAULT_SCREENSHOT_RING_SIZE;
+	gCaptureSequence = 0;
+
+	for (uint32_t i = 0; i < gCaptureSlotCount; ++i)
+	{
+		ScreenshotSlot* pSlot = &gCaptureSlots[i];
+		memset(pSlot, 0, sizeof(*pSlot));
+#if defined(VULKAN)
+		CmdPoolDesc cmdPoolDesc = {};
+		cmdPoolDesc.pQueue = pCmdPool->pQueue;
+		cmdPoolDesc.mTransient = true;
+		addCmdPool(pRendererRef, &cmdPoolDesc, &pSlot->pCmdPool);
+
+		CmdDesc cmdDesc = {};
+		cmdDesc.pPool = pSlot->pCmdPool;
+		addCmd(pRendererRef, &cmdDesc, &pSlot->pCmd);
+		addFence(pRendererRef, &pSlot->pFence);
+		addSemaphore(pRendererRef, &pSlot->pSemaphore);
+#endif
+	}
+
+	gCaptureMutex.Init();
+	gCaptureCond.Init();
+	initThreadSystem(&pCaptureThreadSystem, gCaptureDesc.mWorkerCount ? gCaptureDesc.mWorkerCount : MAX_LOAD_THREADS, 0, true, "ScreenshotWorker");
+}
+
+static void exitScreenshotCaptureRing()
+{
+	if (!pCaptureThreadSystem)
+		return;
+
+	flushScreenshotCaptures();
+	shutdownThreadSystem(pCaptureThreadSystem);
+	pCaptureThreadSystem = NULL;
+
+	extern void removeBuffer(Renderer* pRenderer, Buffer* pBuffer);
+	for (uint32_t i = 0; i < gCaptureSlotCount; ++i)
+	{
+		ScreenshotSlot* pSlot = &gCaptureSlots[i];
+		if (pSlot->pBuffer)
+			removeBuffer(pRendererRef, pSlot->pBuffer);
+		if (pSlot->pSemaphore)
+			removeSemaphore(pRendererRef, pSlot->pSemaphore);
+		if (pSlot->pFence)
+			removeFence(pRendererRef, pSlot->pFence);
+		if (pSlot->pCmd)
+			removeCmd(pRendererRef, pSlot->pCmd);
+		if (pSlot->pCmdPool)
+			removeCmdPool(pRendererRef, pSlot->pCmdPool);
+		tf_free(pSlot->pPixels);
+		memset(pSlot, 0, sizeof(*pSlot));
+	}
+	gCaptureSlotCount = 0;
+
+	gCaptureCond.Destroy();
+	gCaptureMutex.Destroy();
+}
+
+void initScreenshotInterface(Renderer* pRenderer, Queue* pGraphicsQueue, const ScreenshotCaptureDesc* pCaptureDesc)
 {
 	ASSERT(pRenderer);
 	ASSERT(pGraphicsQueue);
 
 	pRendererRef = pRenderer;
+	gCaptureDesc = pCaptureDesc ? *pCaptureDesc : ScreenshotCaptureDesc{};
 
 	// Allocate a command buffer for the GPU work. We use the app's rendering queue to avoid additional sync.
 	CmdPoolDesc cmdPoolDesc = {};
@@ -63,34 +329,14 @@ void initScreenshotInterface(Renderer* pRenderer, Queue* pGraphicsQueue)
 	cmdDesc.pPool = pCmdPool;
 	addCmd(pRenderer, &cmdDesc, &pCmd);
 }
-// Helper function to generate screenshot data. Not part of IScreenshot.h
-void mapRenderTarget(Renderer* pRenderer, Queue* pQueue, Cmd* pCmd, RenderTarget* pRenderTarget, ResourceState currentResourceState, void* pImageData)
-{
-	ASSERT(pImageData);
-	ASSERT(pRenderTarget);
-	ASSERT(pRenderer);
-
 #if defined(VULKAN)
-	extern void addBuffer(Renderer* pRenderer, const BufferDesc* pDesc, Buffer** ppBuffer);
-	extern void removeBuffer(Renderer* pRenderer, Buffer* pBuffer);
-
-	// Add a staging buffer.
-	uint16_t formatByteWidth = TinyImageFormat_BitSizeOfBlock(pRenderTarget->mFormat) / 8;
-	Buffer* buffer = 0;
-	BufferDesc bufferDesc = {};
-	bufferDesc.mDescriptors = DESCRIPTOR_TYPE_RW_BUFFER;
-	bufferDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_GPU_TO_CPU;
-	bufferDesc.mSize = pRenderTarget->mWidth * pRenderTarget->mHeight * formatByteWidth;
-	bufferDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT | BUFFER_CREATION_FLAG_NO_DESCRIPTOR_VIEW_CREATION;
-	bufferDesc.mStartState = RESOURCE_STATE_COPY_DEST;
-	addBuffer(pRenderer, &bufferDesc, &buffer);
-
-	beginCmd(pCmd);
-
+// Records a tightly packed copy of the first subresource of pRenderTarget into pBuffer
+static void cmdCopyRenderTargetToBuffer(Cmd* pCmd, RenderTarget* pRenderTarget, ResourceState currentResourceState, Buffer* pBuffer)
+{
 	RenderTargetBarrier srcBarrier = { pRenderTarget, currentResourceState, RESOURCE_STATE_COPY_SOURCE };
 	cmdResourceBarrier(pCmd, 0, 0, 0, 0, 1, &srcBarrier);
 
-
+	uint16_t formatByteWidth = TinyImageFormat_BitSizeOfBlock(pRenderTarget->mFormat) / 8;
 	uint32_t rowPitch = pRenderTarget->mWidth * formatByteWidth;
 	const uint32_t        width = pRenderTarget->pTexture->mWidth;
 	const uint32_t        height = pRenderTarget->pTexture->mHeight;
@@ -112,11 +358,37 @@ void mapRenderTarget(Renderer* pRenderer, Queue* pQueue, Cmd* pCmd, RenderTarget
 	copy.imageExtent.width = width;
 	copy.imageExtent.height = height;
 	copy.imageExtent.depth = depth;
-	vkCmdCopyImageToBuffer(pCmd->pVkCmdBuf, pRenderTarget->pTexture->pVkImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer->pVkBuffer, 1, &copy);
+	vkCmdCopyImageToBuffer(pCmd->pVkCmdBuf, pRenderTarget->pTexture->pVkImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, pBuffer->pVkBuffer, 1, &copy);
 
 	srcBarrier = { pRenderTarget, RESOURCE_STATE_COPY_SOURCE, currentResourceState };
 	cmdResourceBarrier(pCmd, 0, 0, 0, 0, 1, &srcBarrier);
+}
+#endif
+
+// Helper function to generate screenshot data. Not part of IScreenshot.h
+void mapRenderTarget(Renderer* pRenderer, Queue* pQueue, Cmd* pCmd, RenderTarget* pRenderTarget, ResourceState currentResourceState, void* pImageData)
+{
+	ASSERT(pImageData);
+	ASSERT(pRenderTarget);
+	ASSERT(pRenderer);
+
+#if defined(VULKAN)
+	extern void addBuffer(Renderer* pRenderer, const BufferDesc* pDesc, Buffer** ppBuffer);
+	extern void removeBuffer(Renderer* pRenderer, Buffer* pBuffer);
+
+	// Add a staging buffer.
+	uint16_t formatByteWidth = TinyImageFormat_BitSizeOfBlock(pRenderTarget->mFormat) / 8;
+	Buffer* buffer = 0;
+	BufferDesc bufferDesc = {};
+	bufferDesc.mDescriptors = DESCRIPTOR_TYPE_RW_BUFFER;
+	bufferDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_GPU_TO_CPU;
+	bufferDesc.mSize = pRenderTarget->mWidth * pRenderTarget->mHeight * formatByteWidth;
+	bufferDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT | BUFFER_CREATION_FLAG_NO_DESCRIPTOR_VIEW_CREATION;
+	bufferDesc.mStartState = RESOURCE_STATE_COPY_DEST;
+	addBuffer(pRenderer, &bufferDesc, &buffer);
 
+	beginCmd(pCmd);
+	cmdCopyRenderTargetToBuffer(pCmd, pRenderTarget, currentResourceState, buffer);
 	endCmd(pCmd);
 
 	// Submit the gpu work.
@@ -362,49 +634,162 @@ void captureScreenshot(SwapChain* pSwapChain, uint32_t swapChainRtIndex, Resourc
 
 	// Flip the BGRA to RGBA
 	if (flipRedBlueChannel)
+		swizzleRedBlue((uint8_t*)alloc, (uint8_t*)alloc, (size_t)pRenderTarget->mWidth * pRenderTarget->mHeight, byteSize);
+
+	// Convert image data to png and save it to disk.
+	writeScreenshotFile(pngFileName, (uint8_t*)alloc, pRenderTarget->mWidth, pRenderTarget->mHeight, channelCount, byteSize, SCREENSHOT_FORMAT_PNG);
+
+	tf_free(alloc);
+
+#if defined(METAL)
+	layer.framebufferOnly = true;
+#endif
+}
+
+Semaphore* captureScreenshotAsync(
+	SwapChain* pSwapChain, uint32_t swapChainRtIndex, ResourceState renderTargetCurrentState, Semaphore* pWaitSemaphore,
+	const char* fileName, ScreenshotFormat format, bool flipRedBlueChannel)
+{
+	ASSERT(pRendererRef);
+	ASSERT(pSwapChain);
+	ASSERT(fileName);
+	// initScreenshotInterface not called.
+	ASSERT(pCmd);
+
+#if defined(METAL)
+	CAMetalLayer* layer = (CAMetalLayer*)pSwapChain->pForgeView.layer;
+	if (layer.framebufferOnly)
 	{
-		int8_t* imageData = ((int8_t*)alloc);
+		LOGF(eERROR, "prepareScreenshot() must be used one frame before using captureScreenshotAsync()");
+		ASSERT(0);
+		return pWaitSemaphore;
+	}
+#endif
 
-		for (uint32_t h = 0; h < pRenderTarget->mHeight; ++h)
-		{
-			for (uint32_t w = 0; w < pRenderTarget->mWidth; ++w)
-			{
-				uint32_t pixelIndex = (h * pRenderTarget->mWidth + w) * channelCount;
-				int8_t* pixel = imageData + pixelIndex;
+	if (!pCaptureThreadSystem)
+		initScreenshotCaptureRing();
 
-				// Swap blue and red.
-				int8_t r = pixel[0];
-				pixel[0] = pixel[2];
-				pixel[2] = r;
-			}
-		}
+	RenderTarget*   pRenderTarget = pSwapChain->ppRenderTargets[swapChainRtIndex];
+	const uint32_t  pixelByteSize = TinyImageFormat_BitSizeOfBlock(pRenderTarget->mFormat) / 8;
+	const uint32_t  channelCount = TinyImageFormat_ChannelCount(pRenderTarget->mFormat);
+	const uint64_t  size = (uint64_t)pRenderTarget->mWidth * pRenderTarget->mHeight * pixelByteSize;
+
+	if (format != SCREENSHOT_FORMAT_PNG && (pixelByteSize != channelCount || channelCount < 3))
+	{
+		LOGF(eWARNING, "Render target format of %s is not 8 bit RGB(A), writing it as PNG", fileName);
+		format = SCREENSHOT_FORMAT_PNG;
 	}
 
-	// Convert image data to png.
-	int len = 0;
-	unsigned char* png = stbi_write_png_to_mem((unsigned char*)alloc, pRenderTarget->mWidth * byteSize, pRenderTarget->mWidth, pRenderTarget->mHeight, channelCount, &len);
-	
-	// Save png to disk.
-	FileStream fs = {};
-	fsOpenStreamFromPath(RD_SCREENSHOTS, pngFileName, FM_WRITE_BINARY, &fs);
-	fsWriteToStream(&fs, png, (size_t)len);
-	fsCloseStream(&fs);
+	dispatchCompletedScreenshots(false);
+	ScreenshotSlot* pSlot = acquireScreenshotSlot();
 
-	tf_free(alloc);
+	if (pSlot->mSize < size)
+	{
+#if defined(VULKAN)
+		extern void addBuffer(Renderer* pRenderer, const BufferDesc* pDesc, Buffer** ppBuffer);
+		extern void removeBuffer(Renderer* pRenderer, Buffer* pBuffer);
+
+		if (pSlot->pBuffer)
+			removeBuffer(pRendererRef, pSlot->pBuffer);
+
+		BufferDesc bufferDesc = {};
+		bufferDesc.mDescriptors = DESCRIPTOR_TYPE_RW_BUFFER;
+		bufferDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_GPU_TO_CPU;
+		bufferDesc.mSize = size;
+		bufferDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT | BUFFER_CREATION_FLAG_NO_DESCRIPTOR_VIEW_CREATION;
+		bufferDesc.mStartState = RESOURCE_STATE_COPY_DEST;
+		addBuffer(pRendererRef, &bufferDesc, &pSlot->pBuffer);
+#endif
+		tf_free(pSlot->pPixels);
+		pSlot->pPixels = (uint8_t*)tf_malloc((size_t)size);
+		pSlot->mSize = size;
+	}
+
+	pSlot->mSequence = gCaptureSequence++;
+	pSlot->mWidth = pRenderTarget->mWidth;
+	pSlot->mHeight = pRenderTarget->mHeight;
+	pSlot->mPixelByteSize = pixelByteSize;
+	pSlot->mChannelCount = channelCount;
+	pSlot->mFormat = format;
+	pSlot->mFlipRedBlueChannel = flipRedBlueChannel;
+	strncpy(pSlot->mFileName, fileName, FS_MAX_PATH - 1);
+	pSlot->mFileName[FS_MAX_PATH - 1] = 0;
+	tfrg_atomic64_add_relaxed(&gCapturedFrames, 1);
+
+#if defined(VULKAN)
+	resetCmdPool(pRendererRef, pSlot->pCmdPool);
+	beginCmd(pSlot->pCmd);
+	cmdCopyRenderTargetToBuffer(pSlot->pCmd, pRenderTarget, renderTargetCurrentState, pSlot->pBuffer);
+	endCmd(pSlot->pCmd);
+
+	// Queue order puts the copy after the frame, the semaphores keep presentation from starting before it is done
+	QueueSubmitDesc submitDesc = {};
+	submitDesc.mCmdCount = 1;
+	submitDesc.ppCmds = &pSlot->pCmd;
+	submitDesc.pSignalFence = pSlot->pFence;
+	if (pWaitSemaphore)
+	{
+		submitDesc.mWaitSemaphoreCount = 1;
+		submitDesc.ppWaitSemaphores = &pWaitSemaphore;
+		submitDesc.mSignalSemaphoreCount = 1;
+		submitDesc.ppSignalSemaphores = &pSlot->pSemaphore;
+	}
+	queueSubmit(pSlot->pCmdPool->pQueue, &submitDesc);
+	{
+		MutexLock lock(gCaptureMutex);
+		pSlot->mState = SCREENSHOT_SLOT_GPU_PENDING;
+	}
+
+	return pWaitSemaphore ? pSlot->pSemaphore : NULL;
+#else
+	// No readback ring on this backend, only the encoding is moved off this thread
+	waitQueueIdle(pCmdPool->pQueue);
+	resetCmdPool(pRendererRef, pCmdPool);
+	mapRenderTarget(pRendererRef, pCmdPool->pQueue, pCmd, pRenderTarget, renderTargetCurrentState, pSlot->pPixels);
+	dispatchScreenshotSlot(pSlot);
 
 #if defined(METAL)
 	layer.framebufferOnly = true;
 #endif
+	return pWaitSemaphore;
+#endif
+}
+
+void flushScreenshotCaptures()
+{
+	if (!pCaptureThreadSystem)
+		return;
+
+	dispatchCompletedScreenshots(true);
+	waitThreadSystemIdle(pCaptureThreadSystem);
+}
+
+void getScreenshotCaptureStats(ScreenshotCaptureStats* pOutStats)
+{
+	ASSERT(pOutStats);
+	pOutStats->mCapturedFrames = tfrg_atomic64_load_relaxed(&gCapturedFrames);
+	pOutStats->mWrittenFrames = tfrg_atomic64_load_relaxed(&gWrittenFrames);
+	pOutStats->mFailedFrames = tfrg_atomic64_load_relaxed(&gFailedFrames);
+	pOutStats->mStalledFrames = tfrg_atomic64_load_relaxed(&gStalledFrames);
 }
 
 void exitScreenshotInterface()
 {
+	exitScreenshotCaptureRing();
 	removeCmd(pRendererRef, pCmd);
 	removeCmdPool(pRendererRef, pCmdPool);
 }
 #else
-void initScreenshotInterface(Renderer* pRenderer, Queue* pQueue) {}
+void initScreenshotInterface(Renderer* pRenderer, Queue* pQueue, const ScreenshotCaptureDesc* pCaptureDesc) {}
 bool prepareScreenshot(SwapChain* pSwapChain) {return false;}
 void captureScreenshot(SwapChain* pSwapChain, uint32_t swapChainRtIndex, ResourceState renderTargetCurrentState, const char* pngFileName, bool flipRedBlueChannel) {}
+Semaphore* captureScreenshotAsync(
+	SwapChain* pSwapChain, uint32_t swapChainRtIndex, ResourceState renderTargetCurrentState, Semaphore* pWaitSemaphore,
+	const char* fileName, ScreenshotFormat format, bool flipRedBlueChannel)
+{
+	return pWaitSemaphore;
+}
+void flushScreenshotCaptures() {}
+void getScreenshotCaptureStats(ScreenshotCaptureStats* pOutStats) { *pOutStats = {}; }
 void exitScreenshotInterface() {}
 #endif
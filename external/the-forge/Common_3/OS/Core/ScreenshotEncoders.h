@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2018-2020 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+#pragma once
+
+// Pixel conversion and image encoders used by the screenshot capture workers. Kept in a header so the tests can
+// check the SIMD swizzle and the encoders without a renderer.
+
+#include "../Interfaces/ILog.h"
+#define IMEMORY_FROM_HEADER
+#include "../Interfaces/IMemory.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SCREENSHOT_SWIZZLE_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define SCREENSHOT_SWIZZLE_NEON
+#include <arm_neon.h>
+#endif
+
+// Copies count pixels of pixelByteSize bytes and swaps their first and third byte. pDst may be equal to pSrc.
+static void swizzleRedBlue(const uint8_t* pSrc, uint8_t* pDst, size_t count, uint32_t pixelByteSize)
+{
+	size_t i = 0;
+	if (pixelByteSize == 4)
+	{
+#if defined(SCREENSHOT_SWIZZLE_SSE2)
+		const __m128i keepMask = _mm_set1_epi32((int)0xFF00FF00);
+		const __m128i lowMask = _mm_set1_epi32(0xFF);
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128i pixels = _mm_loadu_si128((const __m128i*)(pSrc + i * 4));
+			const __m128i red = _mm_slli_epi32(_mm_and_si128(pixels, lowMask), 16);
+			const __m128i blue = _mm_and_si128(_mm_srli_epi32(pixels, 16), lowMask);
+			_mm_storeu_si128((__m128i*)(pDst + i * 4), _mm_or_si128(_mm_and_si128(pixels, keepMask), _mm_or_si128(red, blue)));
+		}
+#elif defined(SCREENSHOT_SWIZZLE_NEON)
+		for (; i + 16 <= count; i += 16)
+		{
+			uint8x16x4_t pixels = vld4q_u8(pSrc + i * 4);
+			const uint8x16_t red = pixels.val[0];
+			pixels.val[0] = pixels.val[2];
+			pixels.val[2] = red;
+			vst4q_u8(pDst + i * 4, pixels);
+		}
+#endif
+	}
+
+	for (; i < count; ++i)
+	{
+		const uint8_t* pPixel = pSrc + i * pixelByteSize;
+		uint8_t*       pOut = pDst + i * pixelByteSize;
+		const uint8_t  red = pPixel[0];
+		if (pOut != pPixel)
+			memcpy(pOut, pPixel, pixelByteSize);
+		pOut[0] = pPixel[2];
+		pOut[2] = red;
+	}
+}
+
+/************************************************************************/
+// QOI and TGA encoders
+/************************************************************************/
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF 0x40
+#define QOI_OP_LUMA 0x80
+#define QOI_OP_RUN 0xC0
+#define QOI_OP_RGB 0xFE
+#define QOI_OP_RGBA 0xFF
+#define QOI_HEADER_SIZE 14
+#define QOI_PADDING_SIZE 8
+#define QOI_MAX_RUN 62
+
+static uint8_t* writeBigEndian32(uint8_t* pDst, uint32_t value)
+{
+	pDst[0] = (uint8_t)(value >> 24);
+	pDst[1] = (uint8_t)(value >> 16);
+	pDst[2] = (uint8_t)(value >> 8);
+	pDst[3] = (uint8_t)value;
+	return pDst + 4;
+}
+
+// Encodes 8 bit RGB or RGBA pixels. The returned memory is released with tf_free.
+static uint8_t* encodeQoi(const uint8_t* pPixels, uint32_t width, uint32_t height, uint32_t channelCount, size_t* pOutSize)
+{
+	ASSERT(channelCount == 3 || channelCount == 4);
+	const size_t pixelCount = (size_t)width * height;
+	uint8_t*     pOut = (uint8_t*)tf_malloc(QOI_HEADER_SIZE + pixelCount * (channelCount + 1) + QOI_PADDING_SIZE);
+	uint8_t*     pDst = pOut;
+
+	*pDst++ = 'q';
+	*pDst++ = 'o';
+	*pDst++ = 'i';
+	*pDst++ = 'f';
+	pDst = writeBigEndian32(pDst, width);
+	pDst = writeBigEndian32(pDst, height);
+	*pDst++ = (uint8_t)channelCount;
+	*pDst++ = 0; // sRGB with linear alpha
+
+	// Pixels are packed as R | G << 8 | B << 16 | A << 24
+	uint32_t index[64] = {};
+	uint32_t previous = 0xFF000000;
+	uint32_t run = 0;
+	for (size_t i = 0; i < pixelCount; ++i)
+	{
+		const uint8_t* pPixel = pPixels + i * channelCount;
+		const uint32_t alpha = channelCount == 4 ? pPixel[3] : 0xFF;
+		const uint32_t pixel = pPixel[0] | (pPixel[1] << 8) | (pPixel[2] << 16) | (alpha << 24);
+
+		if (pixel == previous)
+		{
+			if (++run == QOI_MAX_RUN)
+			{
+				*pDst++ = (uint8_t)(QOI_OP_RUN | (run - 1));
+				run = 0;
+			}
+			continue;
+		}
+
+		if (run > 0)
+		{
+			*pDst++ = (uint8_t)(QOI_OP_RUN | (run - 1));
+			run = 0;
+		}
+
+		const uint32_t hash = (pPixel[0] * 3 + pPixel[1] * 5 + pPixel[2] * 7 + alpha * 11) & 63;
+		if (index[hash] == pixel)
+		{
+			*pDst++ = (uint8_t)(QOI_OP_INDEX | hash);
+		}
+		else
+		{
+			index[hash] = pixel;
+			if (alpha == (previous >> 24))
+			{
+				const int dr = (int8_t)(pPixel[0] - (uint8_t)previous);
+				const int dg = (int8_t)(pPixel[1] - (uint8_t)(previous >> 8));
+				const int db = (int8_t)(pPixel[2] - (uint8_t)(previous >> 16));
+				const int drdg = dr - dg;
+				const int dbdg = db - dg;
+
+				if (dr > -3 && dr < 2 && dg > -3 && dg < 2 && db > -3 && db < 2)
+				{
+					*pDst++ = (uint8_t)(QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+				}
+				else if (drdg > -9 && drdg < 8 && dg > -33 && dg < 32 && dbdg > -9 && dbdg < 8)
+				{
+					*pDst++ = (uint8_t)(QOI_OP_LUMA | (dg + 32));
+					*pDst++ = (uint8_t)((drdg + 8) << 4 | (dbdg + 8));
+				}
+				else
+				{
+					*pDst++ = QOI_OP_RGB;
+					*pDst++ = pPixel[0];
+					*pDst++ = pPixel[1];
+					*pDst++ = pPixel[2];
+				}
+			}
+			else
+			{
+				*pDst++ = QOI_OP_RGBA;
+				*pDst++ = pPixel[0];
+				*pDst++ = pPixel[1];
+				*pDst++ = pPixel[2];
+				*pDst++ = (uint8_t)alpha;
+			}
+		}
+		previous = pixel;
+	}
+
+	if (run > 0)
+		*pDst++ = (uint8_t)(QOI_OP_RUN | (run - 1));
+
+	memset(pDst, 0, QOI_PADDING_SIZE - 1);
+	pDst += QOI_PADDING_SIZE - 1;
+	*pDst++ = 1;
+
+	*pOutSize = (size_t)(pDst - pOut);
+	return pOut;
+}
+
+// Header of an uncompressed, top-down TGA. The pixels follow in BGR(A) order.
+static void writeTgaHeader(uint8_t* pHeader, uint32_t width, uint32_t height, uint32_t channelCount)
+{
+	memset(pHeader, 0, 18);
+	pHeader[2] = 2; // Uncompressed true color
+	pHeader[12] = (uint8_t)width;
+	pHeader[13] = (uint8_t)(width >> 8);
+	pHeader[14] = (uint8_t)height;
+	pHeader[15] = (uint8_t)(height >> 8);
+	pHeader[16] = (uint8_t)(channelCount * 8);
+	pHeader[17] = (uint8_t)(0x20 | (channelCount == 4 ? 8 : 0)); // Top-left origin, alpha bits
+}
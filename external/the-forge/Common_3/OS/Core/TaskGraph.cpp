@@ -0,0 +1,341 @@
+/*
+ * Copyright (c) 2019 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+#include "../Interfaces/IThread.h"
+#include "../Interfaces/ILog.h"
+
+#include "TaskGraph.h"
+#include "Atomics.h"
+#include "../Interfaces/IMemory.h"
+
+struct TaskGraphNodeData
+{
+	TaskFunc        mTask;
+	void*           mUser;
+	// Argument for single nodes, index count for range nodes
+	uintptr_t       mArg;
+	TaskGraph*      pGraph;
+	uint32_t        mFirstSuccessor;
+	uint32_t        mNumSuccessors;
+	uint32_t        mNumDependencies;
+	bool            mRange;
+	tfrg_atomic32_t mDependenciesLeft;
+	tfrg_atomic64_t mIndicesLeft;
+};
+
+struct TaskGraphEdge
+{
+	TaskGraphNode mBefore;
+	TaskGraphNode mAfter;
+};
+
+struct TaskGraph
+{
+	ThreadSystem*      pThreadSystem;
+
+	TaskGraphNodeData* pNodes;
+	uint32_t           mNumNodes;
+	uint32_t           mNodeCapacity;
+
+	TaskGraphEdge*     pEdges;
+	uint32_t           mNumEdges;
+	uint32_t           mEdgeCapacity;
+
+	// Successor lists of all nodes packed back to back, rebuilt on submit when edges changed
+	TaskGraphNode*     pSuccessors;
+	uint32_t           mSuccessorCapacity;
+	bool               mDirty;
+
+	tfrg_atomic32_t    mNodesLeft;
+	tfrg_atomic32_t    mNumWaiters;
+	tfrg_atomic64_t    mCompletedSubmits;
+	uint64_t           mSubmits;
+
+	Mutex              mDoneMutex;
+	ConditionVariable  mDoneCond;
+};
+
+static void emptyTaskFunc(void*, uintptr_t) {}
+
+static void runGraphNodeTask(void* user, uintptr_t index);
+
+static void scheduleNode(TaskGraphNodeData* pNode)
+{
+	ThreadSystem* pThreadSystem = pNode->pGraph->pThreadSystem;
+	if (pNode->mRange)
+		addThreadSystemRangeTask(pThreadSystem, runGraphNodeTask, pNode, pNode->mArg);
+	else
+		addThreadSystemTask(pThreadSystem, runGraphNodeTask, pNode, pNode->mArg);
+}
+
+static void wakeGraphWaiters(TaskGraph* pTaskGraph)
+{
+	pTaskGraph->mDoneMutex.Acquire();
+	pTaskGraph->mDoneCond.WakeAll();
+	pTaskGraph->mDoneMutex.Release();
+}
+
+// Releases the successors of a finished node. One ready successor is returned to run as a continuation on the
+// calling thread instead of going through the queue.
+static TaskGraphNodeData* completeNode(TaskGraphNodeData* pNode)
+{
+	TaskGraph* pTaskGraph = pNode->pGraph;
+	TaskGraphNodeData* pContinuation = NULL;
+	bool scheduled = false;
+
+	for (uint32_t i = 0; i < pNode->mNumSuccessors; ++i)
+	{
+		TaskGraphNodeData* pSuccessor = &pTaskGraph->pNodes[pTaskGraph->pSuccessors[pNode->mFirstSuccessor + i]];
+		if (tfrg_atomic32_add_relaxed(&pSuccessor->mDependenciesLeft, -1) != 1)
+			continue;
+
+		if (!pContinuation && !pSuccessor->mRange)
+		{
+			pContinuation = pSuccessor;
+		}
+		else
+		{
+			scheduleNode(pSuccessor);
+			scheduled = true;
+		}
+	}
+
+	if (tfrg_atomic32_add_relaxed(&pTaskGraph->mNodesLeft, -1) == 1)
+	{
+		// Publish completion under the lock so waiters never release the graph while we still touch it
+		pTaskGraph->mDoneMutex.Acquire();
+		tfrg_atomic64_store_release(&pTaskGraph->mCompletedSubmits, pTaskGraph->mSubmits);
+		pTaskGraph->mDoneCond.WakeAll();
+		pTaskGraph->mDoneMutex.Release();
+		return NULL;
+	}
+
+	// Let blocked waiters come back and help with the new work
+	if (scheduled && tfrg_atomic32_load_relaxed(&pTaskGraph->mNumWaiters))
+		wakeGraphWaiters(pTaskGraph);
+
+	if (pContinuation)
+		pContinuation->mTask(pContinuation->mUser, pContinuation->mArg);
+	return pContinuation;
+}
+
+static void runGraphNodeTask(void* user, uintptr_t index)
+{
+	TaskGraphNodeData* pNode = (TaskGraphNodeData*)user;
+	pNode->mTask(pNode->mUser, index);
+
+	if (pNode->mRange && tfrg_atomic64_add_relaxed(&pNode->mIndicesLeft, -1) != 1)
+		return;
+
+	while (pNode)
+		pNode = completeNode(pNode);
+}
+
+static void buildSuccessors(TaskGraph* pTaskGraph)
+{
+	TaskGraphNodeData* pNodes = pTaskGraph->pNodes;
+	for (uint32_t i = 0; i < pTaskGraph->mNumNodes; ++i)
+	{
+		pNodes[i].mNumSuccessors = 0;
+		pNodes[i].mNumDependencies = 0;
+	}
+
+	for (uint32_t i = 0; i < pTaskGraph->mNumEdges; ++i)
+	{
+		++pNodes[pTaskGraph->pEdges[i].mBefore].mNumSuccessors;
+		++pNodes[pTaskGraph->pEdges[i].mAfter].mNumDependencies;
+	}
+
+	uint32_t offset = 0;
+	for (uint32_t i = 0; i < pTaskGraph->mNumNodes; ++i)
+	{
+		pNodes[i].mFirstSuccessor = offset;
+		offset += pNodes[i].mNumSuccessors;
+		pNodes[i].mNumSuccessors = 0;
+	}
+
+	if (pTaskGraph->mSuccessorCapacity < pTaskGraph->mNumEdges)
+	{
+		pTaskGraph->mSuccessorCapacity = pTaskGraph->mEdgeCapacity;
+		pTaskGraph->pSuccessors = (TaskGraphNode*)tf_realloc(pTaskGraph->pSuccessors, sizeof(TaskGraphNode) * pTaskGraph->mSuccessorCapacity);
+	}
+
+	for (uint32_t i = 0; i < pTaskGraph->mNumEdges; ++i)
+	{
+		TaskGraphNodeData* pBefore = &pNodes[pTaskGraph->pEdges[i].mBefore];
+		pTaskGraph->pSuccessors[pBefore->mFirstSuccessor + pBefore->mNumSuccessors++] = pTaskGraph->pEdges[i].mAfter;
+	}
+
+	pTaskGraph->mDirty = false;
+}
+
+static bool isTaskGraphInFlight(TaskGraph* pTaskGraph)
+{
+	return tfrg_atomic64_load_acquire(&pTaskGraph->mCompletedSubmits) != pTaskGraph->mSubmits;
+}
+
+void initTaskGraph(ThreadSystem* pThreadSystem, TaskGraph** ppTaskGraph)
+{
+	ASSERT(pThreadSystem);
+	ASSERT(ppTaskGraph);
+
+	TaskGraph* pTaskGraph = (TaskGraph*)tf_calloc(1, sizeof(TaskGraph));
+	pTaskGraph->pThreadSystem = pThreadSystem;
+	pTaskGraph->mDoneMutex.Init();
+	pTaskGraph->mDoneCond.Init();
+
+	*ppTaskGraph = pTaskGraph;
+}
+
+void shutdownTaskGraph(TaskGraph* pTaskGraph)
+{
+	if (isTaskGraphInFlight(pTaskGraph))
+		waitForTaskGroup(TaskGroupHandle{ pTaskGraph, pTaskGraph->mSubmits });
+
+	pTaskGraph->mDoneCond.Destroy();
+	pTaskGraph->mDoneMutex.Destroy();
+	tf_free(pTaskGraph->pNodes);
+	tf_free(pTaskGraph->pEdges);
+	tf_free(pTaskGraph->pSuccessors);
+	tf_free(pTaskGraph);
+}
+
+TaskGraphNode addTaskGraphNode(TaskGraph* pTaskGraph, TaskFunc task, void* user, uintptr_t arg)
+{
+	ASSERT(!isTaskGraphInFlight(pTaskGraph));
+
+	if (pTaskGraph->mNumNodes == pTaskGraph->mNodeCapacity)
+	{
+		pTaskGraph->mNodeCapacity = max<uint32_t>(pTaskGraph->mNodeCapacity * 2, 64);
+		pTaskGraph->pNodes = (TaskGraphNodeData*)tf_realloc(pTaskGraph->pNodes, sizeof(TaskGraphNodeData) * pTaskGraph->mNodeCapacity);
+	}
+
+	TaskGraphNode node = pTaskGraph->mNumNodes++;
+	TaskGraphNodeData* pNode = &pTaskGraph->pNodes[node];
+	memset(pNode, 0, sizeof(TaskGraphNodeData));
+	pNode->mTask = task;
+	pNode->mUser = user;
+	pNode->mArg = arg;
+	pNode->pGraph = pTaskGraph;
+	pTaskGraph->mDirty = true;
+	return node;
+}
+
+TaskGraphNode addTaskGraphRangeNode(TaskGraph* pTaskGraph, TaskFunc task, void* user, uintptr_t count)
+{
+	// Empty ranges still have to release their successors
+	if (!count)
+		return addTaskGraphNode(pTaskGraph, emptyTaskFunc, NULL);
+
+	TaskGraphNode node = addTaskGraphNode(pTaskGraph, task, user, count);
+	pTaskGraph->pNodes[node].mRange = true;
+	return node;
+}
+
+void addTaskGraphEdge(TaskGraph* pTaskGraph, TaskGraphNode before, TaskGraphNode after)
+{
+	ASSERT(!isTaskGraphInFlight(pTaskGraph));
+	ASSERT(before < pTaskGraph->mNumNodes && after < pTaskGraph->mNumNodes && before != after);
+
+	if (pTaskGraph->mNumEdges == pTaskGraph->mEdgeCapacity)
+	{
+		pTaskGraph->mEdgeCapacity = max<uint32_t>(pTaskGraph->mEdgeCapacity * 2, 64);
+		pTaskGraph->pEdges = (TaskGraphEdge*)tf_realloc(pTaskGraph->pEdges, sizeof(TaskGraphEdge) * pTaskGraph->mEdgeCapacity);
+	}
+
+	pTaskGraph->pEdges[pTaskGraph->mNumEdges++] = TaskGraphEdge{ before, after };
+	pTaskGraph->mDirty = true;
+}
+
+void resetTaskGraph(TaskGraph* pTaskGraph)
+{
+	ASSERT(!isTaskGraphInFlight(pTaskGraph));
+	pTaskGraph->mNumNodes = 0;
+	pTaskGraph->mNumEdges = 0;
+	pTaskGraph->mDirty = true;
+}
+
+TaskGroupHandle submitTaskGraph(TaskGraph* pTaskGraph)
+{
+	ASSERT(!isTaskGraphInFlight(pTaskGraph));
+
+	if (pTaskGraph->mDirty)
+		buildSuccessors(pTaskGraph);
+
+	TaskGroupHandle handle = { pTaskGraph, ++pTaskGraph->mSubmits };
+	if (!pTaskGraph->mNumNodes)
+	{
+		tfrg_atomic64_store_release(&pTaskGraph->mCompletedSubmits, handle.mSubmitIndex);
+		return handle;
+	}
+
+	for (uint32_t i = 0; i < pTaskGraph->mNumNodes; ++i)
+	{
+		TaskGraphNodeData* pNode = &pTaskGraph->pNodes[i];
+		pNode->mDependenciesLeft = pNode->mNumDependencies;
+		pNode->mIndicesLeft = pNode->mRange ? pNode->mArg : 1;
+	}
+	tfrg_atomic32_store_release(&pTaskGraph->mNodesLeft, pTaskGraph->mNumNodes);
+
+	bool hasRoot = false;
+	for (uint32_t i = 0; i < pTaskGraph->mNumNodes; ++i)
+	{
+		if (!pTaskGraph->pNodes[i].mNumDependencies)
+		{
+			scheduleNode(&pTaskGraph->pNodes[i]);
+			hasRoot = true;
+		}
+	}
+	LOGF_IF(LogLevel::eERROR, !hasRoot, "Task graph has no root node, edges form a cycle");
+	ASSERT(hasRoot);
+
+	return handle;
+}
+
+bool isTaskGroupDone(TaskGroupHandle handle)
+{
+	return tfrg_atomic64_load_acquire(&handle.pGraph->mCompletedSubmits) >= handle.mSubmitIndex;
+}
+
+void waitForTaskGroup(TaskGroupHandle handle)
+{
+	TaskGraph* pTaskGraph = handle.pGraph;
+	while (!isTaskGroupDone(handle))
+	{
+		if (assistThreadSystem(pTaskGraph->pThreadSystem))
+			continue;
+
+		// Nothing to help with, sleep until the group completes or new nodes get scheduled
+		pTaskGraph->mDoneMutex.Acquire();
+		tfrg_atomic32_add_relaxed(&pTaskGraph->mNumWaiters, 1);
+		if (!isTaskGroupDone(handle))
+			pTaskGraph->mDoneCond.Wait(pTaskGraph->mDoneMutex);
+		tfrg_atomic32_add_relaxed(&pTaskGraph->mNumWaiters, -1);
+		pTaskGraph->mDoneMutex.Release();
+	}
+
+	// The completing thread may still be inside the locked section
+	pTaskGraph->mDoneMutex.Acquire();
+	pTaskGraph->mDoneMutex.Release();
+}
@@ -0,0 +1,60 @@
+#pragma once
+/*
+ * Copyright (c) 2019 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+#include "ThreadSystem.h"
+
+// Dependency aware task graph built on top of ThreadSystem.
+// Nodes become runnable once every node they depend on has finished, so stages which used to be separated by
+// waitThreadSystemIdle barriers can be expressed as a single graph. A graph can be submitted again once the
+// previous submission completed, which allows building the per frame graph once and reusing it.
+
+typedef uint32_t TaskGraphNode;
+
+struct TaskGraph;
+
+struct TaskGroupHandle
+{
+	TaskGraph* pGraph;
+	uint64_t   mSubmitIndex;
+};
+
+void initTaskGraph(ThreadSystem* pThreadSystem, TaskGraph** ppTaskGraph);
+void shutdownTaskGraph(TaskGraph* pTaskGraph);
+
+// Node running task(user, arg) once
+TaskGraphNode addTaskGraphNode(TaskGraph* pTaskGraph, TaskFunc task, void* user, uintptr_t arg = 0);
+// Node running task(user, i) for i in [0, count), the node completes when all indices finished
+TaskGraphNode addTaskGraphRangeNode(TaskGraph* pTaskGraph, TaskFunc task, void* user, uintptr_t count);
+// 'after' starts only once 'before' completed. Edges must not form cycles.
+void addTaskGraphEdge(TaskGraph* pTaskGraph, TaskGraphNode before, TaskGraphNode after);
+// Removes all nodes and edges. The graph must not be in flight.
+void resetTaskGraph(TaskGraph* pTaskGraph);
+
+TaskGroupHandle submitTaskGraph(TaskGraph* pTaskGraph);
+
+bool isTaskGroupDone(TaskGroupHandle handle);
+// Runs queued ThreadSystem tasks on the calling thread until the group completed.
+// Must not be called from inside a node of the same graph.
+void waitForTaskGroup(TaskGroupHandle handle);
@@ -790,8 +790,15 @@ static bool loadBASISTextureDesc(FileStream* pStream, TextureDesc* pOutDesc, voi
 	basist::etc1_global_selector_codebook sel_codebook(basist::g_global_selector_cb_size, basist::g_global_selector_cb);
 
 	size_t memSize = (size_t)fsGetStreamFileSize(pStream);
-	void* basisData = tf_malloc(memSize);
-	fsReadFromStream(pStream, basisData, memSize);
+	// Transcode straight out of the mapped file when possible, only copy streams that are not memory backed
+	const void* basisData = fsGetStreamBufferIfPresent(pStream);
+	void* basisCopy = NULL;
+	if (!basisData)
+	{
+		basisCopy = tf_malloc(memSize);
+		fsReadFromStream(pStream, basisCopy, memSize);
+		basisData = basisCopy;
+	}
 
 	basist::basisu_transcoder decoder(&sel_codebook);
 
@@ -799,6 +806,7 @@ static bool loadBASISTextureDesc(FileStream* pStream, TextureDesc* pOutDesc, voi
 	if (!decoder.get_file_info(basisData, (uint32_t)memSize, fileinfo))
 	{
 		LOGF(LogLevel::eERROR, "Failed retrieving Basis file information!");
+		tf_free(basisCopy);
 		return false;
 	}
 
@@ -893,7 +901,7 @@ static bool loadBASISTextureDesc(FileStream* pStream, TextureDesc* pOutDesc, voi
 			if (!decoder.get_image_level_info(basisData, (uint32_t)memSize, level_info, s, m))
 			{
 				LOGF(LogLevel::eERROR, "Failed retrieving image level information (%u %u)!\n", s, m);
-				tf_free(basisData);
+				tf_free(basisCopy);
 				tf_free(startData);
 				return false;
 			}
@@ -902,7 +910,7 @@ static bool loadBASISTextureDesc(FileStream* pStream, TextureDesc* pOutDesc, voi
 				(uint32_t)(rowPitchInBlocks * imageinfo.m_num_blocks_y), basisTextureFormat, 0, rowPitchInBlocks))
 			{
 				LOGF(LogLevel::eERROR, "Failed transcoding image level (%u %u)!", s, m);
-				tf_free(basisData);
+				tf_free(basisCopy);
 				tf_free(startData);
 				return false;
 			}
@@ -927,7 +935,7 @@ static bool loadBASISTextureDesc(FileStream* pStream, TextureDesc* pOutDesc, voi
 		}
 	}
 
-	tf_free(basisData);
+	tf_free(basisCopy);
 
 	*ppOutData = startData;
 	*pOutDataSize = requiredSize;
@@ -26,27 +26,71 @@
 #include "../Interfaces/ILog.h"
 
 #include "ThreadSystem.h"
+#include "Atomics.h"
 #include "../Interfaces/IMemory.h"
 
+// Scheduler overview:
+// - Every worker owns a Chase-Lev deque. The owner pushes and pops at the bottom, other threads steal from the top.
+// - Threads that are not workers of the system (main thread, other systems) submit through a mutex protected
+//   injection list which workers drain one task at a time.
+// - Range tasks are split in half lazily by whoever runs them, the upper half is pushed back so it can be stolen.
+// - Idle workers park on their own condition variable. Submitting wakes a single parked worker.
+
 struct ThreadedTask
 {
-	TaskFunc  mTask;
-	void*     mUser;
-	uintptr_t mStart;
-	uintptr_t mEnd;
+	TaskFunc      mTask;
+	void*         mUser;
+	uintptr_t     mStart;
+	uintptr_t     mEnd;
+	uintptr_t     mGrainSize;
+	ThreadedTask* pNext;
+};
+
+struct TaskDequeArray
+{
+	int64_t          mCapacity;
+	TaskDequeArray*  pPrev;
+	tfrg_atomicptr_t mSlots[1];
+};
+
+struct ThreadSystem;
+
+struct ThreadSystemWorker
+{
+	// Top is written by thieves, bottom only by the owner. Keep them on separate cache lines.
+	tfrg_atomic64_t    mTop;
+	char               mPadTop[64 - sizeof(tfrg_atomic64_t)];
+	tfrg_atomic64_t    mBottom;
+	tfrg_atomicptr_t   pArray;
+	ThreadSystem*      pThreadSystem;
+	ConditionVariable  mWakeCond;
+	uint32_t           mIndex;
+	uint32_t           mRandomSeed;
+	bool               mWakeSignaled;
+	char               mPadBottom[64];
 };
 
 struct ThreadSystem
 {
 	ThreadDesc                 mThreadDescs[MAX_LOAD_THREADS];
 	ThreadHandle               mThread[MAX_LOAD_THREADS];
-	ThreadedTask			   mLoadTask[MAX_SYSTEM_TASKS];
-	uint32_t				   mBegin, mEnd;
-	ConditionVariable          mQueueCond;
-	Mutex                      mQueueMutex;
+	ThreadSystemWorker         mWorkers[MAX_LOAD_THREADS];
+
+	Mutex                      mInjectMutex;
+	ThreadedTask*              pInjectHead;
+	ThreadedTask*              pInjectTail;
+	tfrg_atomic32_t            mNumInjected;
+
+	Mutex                      mSleepMutex;
+	uint32_t                   mParked[MAX_LOAD_THREADS];
+	uint32_t                   mNumParked;
+	tfrg_atomic32_t            mNumSleeping;
+
+	Mutex                      mIdleMutex;
 	ConditionVariable          mIdleCond;
+	tfrg_atomic64_t            mNumPendingTasks;
+
 	uint32_t                   mNumLoaders;
-	uint32_t                   mNumIdleLoaders;
 	volatile bool              mRun;
 
 #if defined(NX64)
@@ -54,124 +98,352 @@ struct ThreadSystem
 #endif
 };
 
-bool assistThreadSystemTasks(ThreadSystem* pThreadSystem, uint32_t* pIds, size_t count)
+// Worker identity of the calling thread, used to route submissions to the local deque
+static thread_local ThreadSystemWorker* pCurrentWorker = NULL;
+
+static ThreadSystemWorker* getCurrentWorker(ThreadSystem* pThreadSystem)
+{
+	ThreadSystemWorker* pWorker = pCurrentWorker;
+	return (pWorker && pWorker->pThreadSystem == pThreadSystem) ? pWorker : NULL;
+}
+
+/************************************************************************/
+// Chase-Lev work stealing deque
+/************************************************************************/
+static TaskDequeArray* allocDequeArray(int64_t capacity, TaskDequeArray* pPrev)
+{
+	TaskDequeArray* pArray = (TaskDequeArray*)tf_calloc(1, sizeof(TaskDequeArray) + sizeof(tfrg_atomicptr_t) * (size_t)(capacity - 1));
+	pArray->mCapacity = capacity;
+	pArray->pPrev = pPrev;
+	return pArray;
+}
+
+static void dequePush(ThreadSystemWorker* pWorker, ThreadedTask* pTask)
+{
+	int64_t bottom = (int64_t)tfrg_atomic64_load_relaxed(&pWorker->mBottom);
+	int64_t top = (int64_t)tfrg_atomic64_load_acquire(&pWorker->mTop);
+	TaskDequeArray* pArray = (TaskDequeArray*)tfrg_atomicptr_load_relaxed(&pWorker->pArray);
+
+	if (bottom - top > pArray->mCapacity - 1)
+	{
+		// Grow. Thieves may still read from the old array so it is retired instead of freed.
+		TaskDequeArray* pNewArray = allocDequeArray(pArray->mCapacity * 2, pArray);
+		for (int64_t i = top; i < bottom; ++i)
+			pNewArray->mSlots[i & (pNewArray->mCapacity - 1)] = pArray->mSlots[i & (pArray->mCapacity - 1)];
+		tfrg_atomicptr_store_release(&pWorker->pArray, (uintptr_t)pNewArray);
+		pArray = pNewArray;
+	}
+
+	pArray->mSlots[bottom & (pArray->mCapacity - 1)] = (uintptr_t)pTask;
+	tfrg_atomic64_store_release(&pWorker->mBottom, (uint64_t)(bottom + 1));
+}
+
+static ThreadedTask* dequePop(ThreadSystemWorker* pWorker)
 {
-	pThreadSystem->mQueueMutex.Acquire();
-	if (pThreadSystem->mBegin == pThreadSystem->mEnd)
+	int64_t bottom = (int64_t)tfrg_atomic64_load_relaxed(&pWorker->mBottom) - 1;
+	TaskDequeArray* pArray = (TaskDequeArray*)tfrg_atomicptr_load_relaxed(&pWorker->pArray);
+	tfrg_atomic64_store_relaxed(&pWorker->mBottom, (uint64_t)bottom);
+	tfrg_memorybarrier_full();
+	int64_t top = (int64_t)tfrg_atomic64_load_relaxed(&pWorker->mTop);
+
+	if (top > bottom)
 	{
-		pThreadSystem->mQueueMutex.Release();
-		return false;
+		tfrg_atomic64_store_relaxed(&pWorker->mBottom, (uint64_t)(bottom + 1));
+		return NULL;
+	}
+
+	ThreadedTask* pTask = (ThreadedTask*)pArray->mSlots[bottom & (pArray->mCapacity - 1)];
+	if (top == bottom)
+	{
+		// Last element, race against thieves
+		if ((int64_t)tfrg_atomic64_cas_relaxed(&pWorker->mTop, (uint64_t)top, (uint64_t)(top + 1)) != top)
+			pTask = NULL;
+		tfrg_atomic64_store_relaxed(&pWorker->mBottom, (uint64_t)(bottom + 1));
+	}
+	return pTask;
+}
+
+static ThreadedTask* dequeSteal(ThreadSystemWorker* pWorker)
+{
+	int64_t top = (int64_t)tfrg_atomic64_load_acquire(&pWorker->mTop);
+	tfrg_memorybarrier_full();
+	int64_t bottom = (int64_t)tfrg_atomic64_load_acquire(&pWorker->mBottom);
+
+	if (top >= bottom)
+		return NULL;
+
+	TaskDequeArray* pArray = (TaskDequeArray*)tfrg_atomicptr_load_acquire(&pWorker->pArray);
+	ThreadedTask* pTask = (ThreadedTask*)pArray->mSlots[top & (pArray->mCapacity - 1)];
+	if ((int64_t)tfrg_atomic64_cas_relaxed(&pWorker->mTop, (uint64_t)top, (uint64_t)(top + 1)) != top)
+		return NULL;
+	return pTask;
+}
+
+static bool dequeEmpty(ThreadSystemWorker* pWorker)
+{
+	int64_t top = (int64_t)tfrg_atomic64_load_acquire(&pWorker->mTop);
+	int64_t bottom = (int64_t)tfrg_atomic64_load_acquire(&pWorker->mBottom);
+	return top >= bottom;
+}
+
+/************************************************************************/
+// Scheduling helpers
+/************************************************************************/
+static bool hasQueuedTasks(ThreadSystem* pThreadSystem)
+{
+	if (tfrg_atomic32_load_relaxed(&pThreadSystem->mNumInjected))
+		return true;
+	for (uint32_t i = 0; i < pThreadSystem->mNumLoaders; ++i)
+	{
+		if (!dequeEmpty(&pThreadSystem->mWorkers[i]))
+			return true;
+	}
+	return false;
+}
+
+static void wakeOneWorker(ThreadSystem* pThreadSystem)
+{
+	// Pairs with the increment of mNumSleeping in parkWorker: either the worker sees the new task or we see the sleeper
+	tfrg_memorybarrier_full();
+	if (!tfrg_atomic32_load_relaxed(&pThreadSystem->mNumSleeping))
+		return;
+
+	pThreadSystem->mSleepMutex.Acquire();
+	if (pThreadSystem->mNumParked)
+	{
+		ThreadSystemWorker* pWorker = &pThreadSystem->mWorkers[pThreadSystem->mParked[--pThreadSystem->mNumParked]];
+		pWorker->mWakeSignaled = true;
+		pWorker->mWakeCond.WakeOne();
+	}
+	pThreadSystem->mSleepMutex.Release();
+}
+
+static void parkWorker(ThreadSystemWorker* pWorker)
+{
+	ThreadSystem* pThreadSystem = pWorker->pThreadSystem;
+	pThreadSystem->mSleepMutex.Acquire();
+	tfrg_atomic32_add_relaxed(&pThreadSystem->mNumSleeping, 1);
+	if (pThreadSystem->mRun && !hasQueuedTasks(pThreadSystem))
+	{
+		pWorker->mWakeSignaled = false;
+		pThreadSystem->mParked[pThreadSystem->mNumParked++] = pWorker->mIndex;
+		while (pThreadSystem->mRun && !pWorker->mWakeSignaled)
+			pWorker->mWakeCond.Wait(pThreadSystem->mSleepMutex);
+	}
+	tfrg_atomic32_add_relaxed(&pThreadSystem->mNumSleeping, -1);
+	pThreadSystem->mSleepMutex.Release();
+}
+
+static void pushTask(ThreadSystem* pThreadSystem, ThreadedTask* pTask)
+{
+	tfrg_atomic64_add_relaxed(&pThreadSystem->mNumPendingTasks, 1);
+
+	ThreadSystemWorker* pWorker = getCurrentWorker(pThreadSystem);
+	if (pWorker)
+	{
+		dequePush(pWorker, pTask);
+	}
+	else
+	{
+		pTask->pNext = NULL;
+		pThreadSystem->mInjectMutex.Acquire();
+		if (pThreadSystem->pInjectTail)
+			pThreadSystem->pInjectTail->pNext = pTask;
+		else
+			pThreadSystem->pInjectHead = pTask;
+		pThreadSystem->pInjectTail = pTask;
+		tfrg_atomic32_add_relaxed(&pThreadSystem->mNumInjected, 1);
+		pThreadSystem->mInjectMutex.Release();
 	}
 
-	uint32_t taskSize = pThreadSystem->mBegin >= pThreadSystem->mEnd ? pThreadSystem->mBegin - pThreadSystem->mEnd : MAX_SYSTEM_TASKS - (pThreadSystem->mEnd - pThreadSystem->mBegin);
-	ThreadedTask resourceTask;
-	bool found = false;
+	wakeOneWorker(pThreadSystem);
+}
+
+static void addTask(ThreadSystem* pThreadSystem, TaskFunc task, void* user, uintptr_t start, uintptr_t end, uintptr_t grainSize)
+{
+	ASSERT(start < end);
+	ThreadedTask* pTask = (ThreadedTask*)tf_malloc(sizeof(ThreadedTask));
+	*pTask = ThreadedTask{ task, user, start, end, grainSize, NULL };
+	pushTask(pThreadSystem, pTask);
+}
 
-	for (uint32_t i = 0; i < taskSize; ++i)
+static ThreadedTask* popInjectedTask(ThreadSystem* pThreadSystem)
+{
+	if (!tfrg_atomic32_load_relaxed(&pThreadSystem->mNumInjected))
+		return NULL;
+
+	pThreadSystem->mInjectMutex.Acquire();
+	ThreadedTask* pTask = pThreadSystem->pInjectHead;
+	if (pTask)
 	{
-		uint32_t index = (pThreadSystem->mEnd + i) % MAX_SYSTEM_TASKS;
-		resourceTask = pThreadSystem->mLoadTask[index];
+		pThreadSystem->pInjectHead = pTask->pNext;
+		if (!pThreadSystem->pInjectHead)
+			pThreadSystem->pInjectTail = NULL;
+		tfrg_atomic32_add_relaxed(&pThreadSystem->mNumInjected, -1);
+	}
+	pThreadSystem->mInjectMutex.Release();
+	return pTask;
+}
 
+static ThreadedTask* stealTask(ThreadSystem* pThreadSystem, ThreadSystemWorker* pThief)
+{
+	uint32_t numWorkers = pThreadSystem->mNumLoaders;
+	// A system without workers only runs tasks through the assist functions, there are no deques to steal from
+	if (!numWorkers)
+		return NULL;
+
+	uint32_t first = 0;
+	if (pThief)
+	{
+		// xorshift32 to spread thieves across victims
+		uint32_t x = pThief->mRandomSeed;
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		pThief->mRandomSeed = x;
+		first = x % numWorkers;
+	}
+
+	for (uint32_t i = 0; i < numWorkers; ++i)
+	{
+		ThreadSystemWorker* pVictim = &pThreadSystem->mWorkers[(first + i) % numWorkers];
+		if (pVictim == pThief)
+			continue;
+		ThreadedTask* pTask = dequeSteal(pVictim);
+		if (pTask)
+			return pTask;
+	}
+	return NULL;
+}
+
+static ThreadedTask* findTask(ThreadSystem* pThreadSystem, ThreadSystemWorker* pWorker)
+{
+	ThreadedTask* pTask = pWorker ? dequePop(pWorker) : NULL;
+	if (!pTask)
+		pTask = popInjectedTask(pThreadSystem);
+	if (!pTask)
+		pTask = stealTask(pThreadSystem, pWorker);
+	return pTask;
+}
+
+static void finishTask(ThreadSystem* pThreadSystem)
+{
+	if (tfrg_atomic64_add_relaxed(&pThreadSystem->mNumPendingTasks, -1) == 1)
+	{
+		pThreadSystem->mIdleMutex.Acquire();
+		pThreadSystem->mIdleCond.WakeAll();
+		pThreadSystem->mIdleMutex.Release();
+	}
+}
+
+static void runTask(ThreadSystem* pThreadSystem, ThreadedTask* pTask)
+{
+	// Split off the upper half until the chunk is small enough, the pushed halves can be stolen by idle workers
+	while (pTask->mEnd - pTask->mStart > pTask->mGrainSize)
+	{
+		uintptr_t middle = pTask->mStart + (pTask->mEnd - pTask->mStart) / 2;
+		addTask(pThreadSystem, pTask->mTask, pTask->mUser, middle, pTask->mEnd, pTask->mGrainSize);
+		pTask->mEnd = middle;
+	}
+
+	for (uintptr_t i = pTask->mStart; i < pTask->mEnd; ++i)
+		pTask->mTask(pTask->mUser, i);
+
+	tf_free(pTask);
+	finishTask(pThreadSystem);
+}
+
+static uintptr_t getGrainSize(ThreadSystem* pThreadSystem, uintptr_t count)
+{
+	// Aim for a few chunks per worker so stealing can balance uneven work
+	uintptr_t grainSize = count / ((uintptr_t)max<uint32_t>(pThreadSystem->mNumLoaders, 1) * 4);
+	return grainSize ? grainSize : 1;
+}
+
+/************************************************************************/
+// Public API
+/************************************************************************/
+bool assistThreadSystemTasks(ThreadSystem* pThreadSystem, uint32_t* pIds, size_t count)
+{
+	// Only tasks which did not start yet can be picked, those live in the injection list
+	pThreadSystem->mInjectMutex.Acquire();
+	ThreadedTask* pPrev = NULL;
+	ThreadedTask* pTask = pThreadSystem->pInjectHead;
+	for (; pTask; pPrev = pTask, pTask = pTask->pNext)
+	{
+		bool found = false;
 		for (size_t j = 0; j < count; ++j)
 		{
-			if (pIds[j] == resourceTask.mStart)
+			if (pIds[j] == pTask->mStart)
 			{
 				found = true;
 				break;
 			}
 		}
-
 		if (found)
-		{
-			if (resourceTask.mStart + 1 == resourceTask.mEnd)
-			{
-				pThreadSystem->mLoadTask[index] = pThreadSystem->mLoadTask[pThreadSystem->mEnd];
-				++pThreadSystem->mEnd;
-				pThreadSystem->mEnd = pThreadSystem->mEnd % MAX_SYSTEM_TASKS;
-			}
-			else
-			{
-				++pThreadSystem->mLoadTask[index].mStart;
-			}
 			break;
-		}
 	}
 
-	pThreadSystem->mQueueMutex.Release();
-
-	if (!found)
+	if (!pTask)
 	{
+		pThreadSystem->mInjectMutex.Release();
 		return false;
 	}
 
+	ThreadedTask resourceTask = *pTask;
+	if (pTask->mStart + 1 == pTask->mEnd)
+	{
+		if (pPrev)
+			pPrev->pNext = pTask->pNext;
+		else
+			pThreadSystem->pInjectHead = pTask->pNext;
+		if (pThreadSystem->pInjectTail == pTask)
+			pThreadSystem->pInjectTail = pPrev;
+		tfrg_atomic32_add_relaxed(&pThreadSystem->mNumInjected, -1);
+		tf_free(pTask);
+	}
+	else
+	{
+		// The remaining range stays queued, account for the index we take so idle waits cover it
+		++pTask->mStart;
+		tfrg_atomic64_add_relaxed(&pThreadSystem->mNumPendingTasks, 1);
+	}
+	pThreadSystem->mInjectMutex.Release();
+
 	resourceTask.mTask(resourceTask.mUser, resourceTask.mStart);
+	finishTask(pThreadSystem);
 	return true;
 }
 
 bool assistThreadSystem(ThreadSystem* pThreadSystem)
 {
-	pThreadSystem->mQueueMutex.Acquire();
-	if (pThreadSystem->mBegin != pThreadSystem->mEnd)
-	{
-		ThreadedTask resourceTask = pThreadSystem->mLoadTask[pThreadSystem->mEnd];
-		if (resourceTask.mStart + 1 == resourceTask.mEnd)
-		{
-			++pThreadSystem->mEnd;
-			pThreadSystem->mEnd = pThreadSystem->mEnd % MAX_SYSTEM_TASKS;
-		}
-		else
-		{
-			++pThreadSystem->mLoadTask[pThreadSystem->mEnd].mStart;
-		}
-		pThreadSystem->mQueueMutex.Release();
-		resourceTask.mTask(resourceTask.mUser, resourceTask.mStart);
-
-		return true;
-	}
-	else
-	{
-		pThreadSystem->mQueueMutex.Release();
+	ThreadedTask* pTask = findTask(pThreadSystem, getCurrentWorker(pThreadSystem));
+	if (!pTask)
 		return false;
-	}
+
+	runTask(pThreadSystem, pTask);
+	return true;
 }
 
 static void taskThreadFunc(void* pThreadData)
 {
-	ThreadSystem* pThreadSystem = (ThreadSystem*)pThreadData;
+	ThreadSystemWorker* pWorker = (ThreadSystemWorker*)pThreadData;
+	ThreadSystem* pThreadSystem = pWorker->pThreadSystem;
+	pCurrentWorker = pWorker;
+
 	while (pThreadSystem->mRun)
 	{
-		pThreadSystem->mQueueMutex.Acquire();
-		++pThreadSystem->mNumIdleLoaders;
-		while (pThreadSystem->mRun && pThreadSystem->mBegin == pThreadSystem->mEnd)
+		ThreadedTask* pTask = findTask(pThreadSystem, pWorker);
+		if (pTask)
 		{
-			pThreadSystem->mIdleCond.WakeAll();
-			pThreadSystem->mQueueCond.Wait(pThreadSystem->mQueueMutex);
-		}
-		--pThreadSystem->mNumIdleLoaders;
-		if (pThreadSystem->mBegin != pThreadSystem->mEnd)
-		{
-			ThreadedTask resourceTask = pThreadSystem->mLoadTask[pThreadSystem->mEnd];// pThreadSystem->mLoadQueue.front();
-			if (resourceTask.mStart + 1 == resourceTask.mEnd)
-			{
-				++pThreadSystem->mEnd;
-				pThreadSystem->mEnd = pThreadSystem->mEnd % MAX_SYSTEM_TASKS;
-			}
-			else
-			{
-				++pThreadSystem->mLoadTask[pThreadSystem->mEnd].mStart;
-			}
-			pThreadSystem->mQueueMutex.Release();
-			resourceTask.mTask(resourceTask.mUser, resourceTask.mStart);
-		}
-		else
-		{
-			pThreadSystem->mQueueMutex.Release();
+			runTask(pThreadSystem, pTask);
+			continue;
 		}
+
+		parkWorker(pWorker);
 	}
-	pThreadSystem->mQueueMutex.Acquire();
-	++pThreadSystem->mNumIdleLoaders;
-	pThreadSystem->mIdleCond.WakeAll();
-	pThreadSystem->mQueueMutex.Release();
+
+	pCurrentWorker = NULL;
 }
 
 void initThreadSystem(ThreadSystem** ppThreadSystem, uint32_t numRequestedThreads, int preferredCore, bool migrateEnabled, const char* threadName)
@@ -181,19 +453,38 @@ void initThreadSystem(ThreadSystem** ppThreadSystem, uint32_t numRequestedThread
 	uint32_t numThreads = max<uint32_t>(Thread::GetNumCPUCores() - 1, 1);
 	uint32_t numLoaders = min<uint32_t>(numThreads, min<uint32_t>(numRequestedThreads, MAX_LOAD_THREADS));
 
-	pThreadSystem->mQueueMutex.Init();
-	pThreadSystem->mQueueCond.Init();
+	pThreadSystem->mInjectMutex.Init();
+	pThreadSystem->mSleepMutex.Init();
+	pThreadSystem->mIdleMutex.Init();
 	pThreadSystem->mIdleCond.Init();
-	
+
 	pThreadSystem->mRun = true;
-	pThreadSystem->mNumIdleLoaders = 0;
-	pThreadSystem->mBegin = 0;
-	pThreadSystem->mEnd = 0;
+	pThreadSystem->pInjectHead = NULL;
+	pThreadSystem->pInjectTail = NULL;
+	pThreadSystem->mNumInjected = 0;
+	pThreadSystem->mNumParked = 0;
+	pThreadSystem->mNumSleeping = 0;
+	pThreadSystem->mNumPendingTasks = 0;
+	// Workers must be visible to thieves before any thread starts running
+	pThreadSystem->mNumLoaders = numLoaders;
+
+	for (unsigned i = 0; i < numLoaders; ++i)
+	{
+		ThreadSystemWorker* pWorker = &pThreadSystem->mWorkers[i];
+		pWorker->mTop = 0;
+		pWorker->mBottom = 0;
+		pWorker->pArray = (uintptr_t)allocDequeArray(MAX_SYSTEM_TASKS, NULL);
+		pWorker->pThreadSystem = pThreadSystem;
+		pWorker->mIndex = i;
+		pWorker->mRandomSeed = 0x9E3779B9u * (i + 1);
+		pWorker->mWakeSignaled = false;
+		pWorker->mWakeCond.Init();
+	}
 
 	for (unsigned i = 0; i < numLoaders; ++i)
 	{
 		pThreadSystem->mThreadDescs[i].pFunc = taskThreadFunc;
-		pThreadSystem->mThreadDescs[i].pData = pThreadSystem;
+		pThreadSystem->mThreadDescs[i].pData = &pThreadSystem->mWorkers[i];
 
 #if defined(NX64)
 		pThreadSystem->mThreadDescs[i].pThreadStack = aligned_alloc(THREAD_STACK_ALIGNMENT_NX, ALIGNED_THREAD_STACK_SIZE_NX);
@@ -205,20 +496,13 @@ void initThreadSystem(ThreadSystem** ppThreadSystem, uint32_t numRequestedThread
 
 		pThreadSystem->mThread[i] = create_thread(&pThreadSystem->mThreadDescs[i]);
 	}
-	pThreadSystem->mNumLoaders = numLoaders;
 
 	*ppThreadSystem = pThreadSystem;
 }
 
 void addThreadSystemTask(ThreadSystem* pThreadSystem, TaskFunc task, void* user, uintptr_t index)
 {
-	pThreadSystem->mQueueMutex.Acquire();
-	pThreadSystem->mLoadTask[pThreadSystem->mBegin++] = ThreadedTask{ task, user, index, index + 1 };
-	pThreadSystem->mBegin = pThreadSystem->mBegin % MAX_SYSTEM_TASKS;
-	LOGF_IF(LogLevel::eERROR, pThreadSystem->mBegin == pThreadSystem->mEnd, "Maximum amount of thread task reached: mBegin (%d), mEnd(%d), Max(%d)", pThreadSystem->mBegin, pThreadSystem->mEnd, MAX_SYSTEM_TASKS);
-	ASSERT(pThreadSystem->mBegin != pThreadSystem->mEnd);
-	pThreadSystem->mQueueMutex.Release();
-	pThreadSystem->mQueueCond.WakeAll();
+	addTask(pThreadSystem, task, user, index, index + 1, 1);
 }
 
 uint32_t getThreadSystemThreadCount(ThreadSystem* pThreadSystem)
@@ -228,34 +512,29 @@ uint32_t getThreadSystemThreadCount(ThreadSystem* pThreadSystem)
 
 void addThreadSystemRangeTask(ThreadSystem* pThreadSystem, TaskFunc task, void* user, uintptr_t count)
 {
-	pThreadSystem->mQueueMutex.Acquire();
-	pThreadSystem->mLoadTask[pThreadSystem->mBegin++] = ThreadedTask{ task, user, 0, count };
-	pThreadSystem->mBegin = pThreadSystem->mBegin % MAX_SYSTEM_TASKS;
-	LOGF_IF(LogLevel::eERROR, pThreadSystem->mBegin == pThreadSystem->mEnd, "Maximum amount of thread task reached: mBegin (%d), mEnd(%d), Max(%d)", pThreadSystem->mBegin, pThreadSystem->mEnd, MAX_SYSTEM_TASKS);
-	ASSERT(pThreadSystem->mBegin != pThreadSystem->mEnd);
-	pThreadSystem->mQueueMutex.Release();
-	pThreadSystem->mQueueCond.WakeAll();
+	if (!count)
+		return;
+	addTask(pThreadSystem, task, user, 0, count, getGrainSize(pThreadSystem, count));
 }
 
 void addThreadSystemRangeTask(ThreadSystem* pThreadSystem, TaskFunc task, void* user, uintptr_t start, uintptr_t end)
 {
-	pThreadSystem->mQueueMutex.Acquire();
-	pThreadSystem->mLoadTask[pThreadSystem->mBegin++] = ThreadedTask{ task, user, start, end };
-	pThreadSystem->mBegin = pThreadSystem->mBegin % MAX_SYSTEM_TASKS;
-	LOGF_IF(LogLevel::eERROR, pThreadSystem->mBegin == pThreadSystem->mEnd, "Maximum amount of thread task reached: mBegin (%d), mEnd(%d), Max(%d)", pThreadSystem->mBegin, pThreadSystem->mEnd, MAX_SYSTEM_TASKS);
-	ASSERT(pThreadSystem->mBegin != pThreadSystem->mEnd);
-	pThreadSystem->mQueueMutex.Release();
-	pThreadSystem->mQueueCond.WakeAll();
+	if (start >= end)
+		return;
+	addTask(pThreadSystem, task, user, start, end, getGrainSize(pThreadSystem, end - start));
 }
 
 void shutdownThreadSystem(ThreadSystem* pThreadSystem)
 {
-	pThreadSystem->mQueueMutex.Acquire();
+	pThreadSystem->mSleepMutex.Acquire();
 	pThreadSystem->mRun = false;
-	pThreadSystem->mQueueMutex.Release();
-	pThreadSystem->mQueueCond.WakeAll();
-	pThreadSystem->mBegin = 0;
-	pThreadSystem->mEnd = 0;
+	for (uint32_t i = 0; i < pThreadSystem->mNumLoaders; ++i)
+		pThreadSystem->mWorkers[i].mWakeCond.WakeAll();
+	pThreadSystem->mSleepMutex.Release();
+
+	pThreadSystem->mIdleMutex.Acquire();
+	pThreadSystem->mIdleCond.WakeAll();
+	pThreadSystem->mIdleMutex.Release();
 
 	uint32_t numLoaders = pThreadSystem->mNumLoaders;
 	for (uint32_t i = 0; i < numLoaders; ++i)
@@ -263,24 +542,52 @@ void shutdownThreadSystem(ThreadSystem* pThreadSystem)
 		destroy_thread(pThreadSystem->mThread[i]);
 	}
 
-	pThreadSystem->mQueueCond.Destroy();
+	// Drop tasks which never ran, same as the previous ring based implementation
+	for (uint32_t i = 0; i < numLoaders; ++i)
+	{
+		ThreadSystemWorker* pWorker = &pThreadSystem->mWorkers[i];
+		while (ThreadedTask* pTask = dequePop(pWorker))
+			tf_free(pTask);
+
+		TaskDequeArray* pArray = (TaskDequeArray*)pWorker->pArray;
+		while (pArray)
+		{
+			TaskDequeArray* pPrev = pArray->pPrev;
+			tf_free(pArray);
+			pArray = pPrev;
+		}
+		pWorker->mWakeCond.Destroy();
+	}
+
+	while (ThreadedTask* pTask = pThreadSystem->pInjectHead)
+	{
+		pThreadSystem->pInjectHead = pTask->pNext;
+		tf_free(pTask);
+	}
+
 	pThreadSystem->mIdleCond.Destroy();
-	pThreadSystem->mQueueMutex.Destroy();
+	pThreadSystem->mIdleMutex.Destroy();
+	pThreadSystem->mSleepMutex.Destroy();
+	pThreadSystem->mInjectMutex.Destroy();
 	tf_delete(pThreadSystem);
 }
 
 bool isThreadSystemIdle(ThreadSystem* pThreadSystem)
 {
-	pThreadSystem->mQueueMutex.Acquire();
-	bool idle = (pThreadSystem->mBegin == pThreadSystem->mEnd && pThreadSystem->mNumIdleLoaders == pThreadSystem->mNumLoaders) || !pThreadSystem->mRun;
-	pThreadSystem->mQueueMutex.Release();
-	return idle;
+	return !tfrg_atomic64_load_acquire(&pThreadSystem->mNumPendingTasks) || !pThreadSystem->mRun;
 }
 
 void waitThreadSystemIdle(ThreadSystem* pThreadSystem)
 {
-	pThreadSystem->mQueueMutex.Acquire();
-	while ((pThreadSystem->mBegin != pThreadSystem->mEnd || pThreadSystem->mNumIdleLoaders < pThreadSystem->mNumLoaders) && pThreadSystem->mRun)
-		pThreadSystem->mIdleCond.Wait(pThreadSystem->mQueueMutex);
-	pThreadSystem->mQueueMutex.Release();
+	// Without workers nobody else would ever run the queued tasks
+	if (!pThreadSystem->mNumLoaders)
+	{
+		while (assistThreadSystem(pThreadSystem))
+			;
+	}
+
+	pThreadSystem->mIdleMutex.Acquire();
+	while (tfrg_atomic64_load_acquire(&pThreadSystem->mNumPendingTasks) && pThreadSystem->mRun)
+		pThreadSystem->mIdleCond.Wait(pThreadSystem->mIdleMutex);
+	pThreadSystem->mIdleMutex.Release();
 }
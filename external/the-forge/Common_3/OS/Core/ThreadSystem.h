@@ -42,6 +42,7 @@ static void memberTaskFunc0(void* userData, size_t)
 enum
 {
 	MAX_LOAD_THREADS = 16,
+	// Initial capacity of each worker's task deque. Deques grow on demand so this is not a submission limit.
 	MAX_SYSTEM_TASKS = 128
 };
 
@@ -51,6 +52,7 @@ void initThreadSystem(ThreadSystem** ppThreadSystem, uint32_t numRequestedThread
 
 void shutdownThreadSystem(ThreadSystem* pThreadSystem);
 
+// Range tasks are split into chunks on demand so idle workers can steal the remaining part of the range.
 void addThreadSystemRangeTask(ThreadSystem* pThreadSystem, TaskFunc task, void* user, uintptr_t count);
 void addThreadSystemRangeTask(ThreadSystem* pThreadSystem, TaskFunc task, void* user, uintptr_t start, uintptr_t end);
 void addThreadSystemTask(ThreadSystem* pThreadSystem, TaskFunc task, void* user, uintptr_t index = 0);
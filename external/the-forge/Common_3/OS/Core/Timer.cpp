@@ -34,17 +34,19 @@
 
 Timer::Timer() { Reset(); }
 
-unsigned Timer::GetMSec(bool reset)
+unsigned Timer::GetMSec(bool reset) { return (unsigned)(GetNSec(reset) / 1000000); }
+
+int64_t Timer::GetNSec(bool reset)
 {
-	unsigned currentTime = getSystemTime();
-	unsigned elapsedTime = currentTime - mStartTime;
+	int64_t currentTime = getNSec();
+	int64_t elapsedTime = currentTime - mStartTime;
 	if (reset)
 		mStartTime = currentTime;
 
 	return elapsedTime;
 }
 
-void Timer::Reset() { mStartTime = getSystemTime(); }
+void Timer::Reset() { mStartTime = getNSec(); }
 
 HiresTimer::HiresTimer()
 {
@@ -53,9 +55,9 @@ HiresTimer::HiresTimer()
 	Reset();
 }
 
-int64_t HiresTimer::GetUSec(bool reset)
+int64_t HiresTimer::GetNSec(bool reset)
 {
-	int64_t currentTime = getUSec();
+	int64_t currentTime = getNSec();
 	int64_t elapsedTime = currentTime - mStartTime;
 
 	// Correct for possible weirdness with changing internal frequency
@@ -71,6 +73,8 @@ int64_t HiresTimer::GetUSec(bool reset)
 	return elapsedTime;
 }
 
+int64_t HiresTimer::GetUSec(bool reset) { return GetNSec(reset) / 1000; }
+
 int64_t HiresTimer::GetUSecAverage()
 {
 	int64_t elapsedTime = 0;
@@ -82,11 +86,11 @@ int64_t HiresTimer::GetUSecAverage()
 	if (elapsedTime < 0)
 		elapsedTime = 0;
 
-	return elapsedTime;
+	return elapsedTime / 1000;
 }
 
-float HiresTimer::GetSeconds(bool reset) { return (float)(GetUSec(reset) / 1e6); }
+float HiresTimer::GetSeconds(bool reset) { return (float)(GetNSec(reset) / 1e9); }
 
 float HiresTimer::GetSecondsAverage() { return (float)(GetUSecAverage() / 1e6); }
 
-void HiresTimer::Reset() { mStartTime = getUSec(); }
+void HiresTimer::Reset() { mStartTime = getNSec(); }
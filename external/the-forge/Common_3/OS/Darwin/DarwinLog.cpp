@@ -50,6 +50,9 @@ void _OutputDebugString(const char* str, ...)
 
 void _FailedAssert(const char* file, int line, const char* statement)
 {
+	// Make sure the messages leading up to the assert are not stuck in the asynchronous log
+	Log::Flush();
+
 	static bool debug = true;
 
 	if (debug)
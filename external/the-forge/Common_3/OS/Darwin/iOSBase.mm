@@ -33,6 +33,7 @@
 
 #include <mach/clock.h>
 #include <mach/mach.h>
+#include <mach/mach_time.h>
 
 #include "../../ThirdParty/OpenSource/EASTL/vector.h"
 
@@ -143,6 +144,16 @@ int64_t getUSec()
 	return us;
 }
 
+int64_t getNSec()
+{
+	// mach_absolute_time does not advance while asleep, like CLOCK_MONOTONIC_RAW
+	static mach_timebase_info_data_t timebase = {};
+	if (!timebase.denom)
+		mach_timebase_info(&timebase);
+	const uint64_t ticks = mach_absolute_time();
+	return (int64_t)((ticks / timebase.denom) * timebase.numer + (ticks % timebase.denom) * timebase.numer / timebase.denom);
+}
+
 int64_t getTimerFrequency()
 {
     return 1;
@@ -0,0 +1,610 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+#include "../Interfaces/IFileSystem.h"
+#include "../Interfaces/IThread.h"
+#include "../Interfaces/ILog.h"
+#include "../Core/ThreadSystem.h"
+
+#if defined(__linux__) && !defined(__ANDROID__)
+#define USE_PREAD
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define USE_IO_URING
+#endif
+#endif
+#endif
+
+#if defined(USE_PREAD)
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(USE_IO_URING)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+#include "../Interfaces/IMemory.h"
+
+bool fsIsSystemResourceDir(ResourceDirectory resourceDir);
+
+// Reads are tracked in slots. A slot is taken on submit and released when fsWaitAsyncReads returns its request,
+// so only the thread using the queue touches the free list. Finished slots are handed back through a ring of slot
+// indices, filled by the io_uring completion loop or by the pread workers.
+//
+// With io_uring the submitting thread opens the files and only the reads are asynchronous. Without it every request
+// is a pread task on a small worker pool. Resource directories which are not backed by the system file IO (zip mounts)
+// are read through their FileStream on the same workers, which are only started once something needs them.
+
+struct AsyncReadQueue;
+
+struct AsyncReadSlot
+{
+	AsyncReadQueue*   pQueue;
+	AsyncReadRequest* pRequest;
+	bool              mOwnsDestination;
+#if defined(USE_IO_URING)
+	int               mFileDesc;
+	size_t            mBytesRead;
+	size_t            mRemaining;
+	struct iovec      mVec;
+#endif
+};
+
+struct AsyncReadQueue
+{
+	uint32_t          mCapacity;
+	uint32_t          mInFlight;
+
+	AsyncReadSlot*    pSlots;
+	uint32_t*         pFreeSlots;
+	uint32_t          mFreeSlotCount;
+
+	Mutex             mCompletedMutex;
+	ConditionVariable mCompletedCond;
+	uint32_t*         pCompleted;
+	uint32_t          mCompletedHead;
+	uint32_t          mCompletedCount;
+
+	ThreadSystem*     pThreadSystem;
+
+#if defined(USE_IO_URING)
+	int                  mRingFd;
+	uint32_t             mRingReads;
+	uint32_t             mSqTail;
+	void*                pSqRing;
+	size_t               mSqRingSize;
+	void*                pCqRing;
+	size_t               mCqRingSize;
+	struct io_uring_sqe* pSqes;
+	size_t               mSqesSize;
+	uint32_t*            pSqHead;
+	uint32_t*            pSqTail;
+	uint32_t             mSqMask;
+	uint32_t*            pSqArray;
+	uint32_t*            pCqHead;
+	uint32_t*            pCqTail;
+	uint32_t             mCqMask;
+	struct io_uring_cqe* pCqes;
+#endif
+};
+/************************************************************************/
+// Blocking reads
+/************************************************************************/
+// Clamps the requested range to the file and allocates the destination if the caller did not provide one
+static size_t prepareDestination(AsyncReadSlot* pSlot, ssize_t fileSize)
+{
+	AsyncReadRequest* pRequest = pSlot->pRequest;
+	size_t available = (fileSize > 0 && (size_t)fileSize > pRequest->mOffset) ? (size_t)fileSize - pRequest->mOffset : 0;
+	size_t size = (pRequest->mSize && pRequest->mSize < available) ? pRequest->mSize : available;
+
+	if (!pRequest->pDestination && size)
+	{
+		pRequest->pDestination = tf_malloc(size);
+		pSlot->mOwnsDestination = true;
+	}
+
+	return size;
+}
+
+static void finishRead(AsyncReadSlot* pSlot, ssize_t bytesRead)
+{
+	AsyncReadRequest* pRequest = pSlot->pRequest;
+	if (bytesRead < 0 && pSlot->mOwnsDestination)
+	{
+		tf_free(pRequest->pDestination);
+		pRequest->pDestination = NULL;
+		pSlot->mOwnsDestination = false;
+	}
+	pRequest->mBytesRead = bytesRead;
+
+	AsyncReadQueue* pQueue = pSlot->pQueue;
+	pQueue->mCompletedMutex.Acquire();
+	uint32_t index = (pQueue->mCompletedHead + pQueue->mCompletedCount) % pQueue->mCapacity;
+	pQueue->pCompleted[index] = (uint32_t)(pSlot - pQueue->pSlots);
+	++pQueue->mCompletedCount;
+	pQueue->mCompletedMutex.Release();
+	pQueue->mCompletedCond.WakeOne();
+}
+
+static ssize_t readWithStream(AsyncReadSlot* pSlot)
+{
+	AsyncReadRequest* pRequest = pSlot->pRequest;
+	FileStream stream = {};
+	if (!fsOpenStreamFromPath(pRequest->mResourceDir, pRequest->pFileName, FM_READ_BINARY, &stream))
+	{
+		return -1;
+	}
+
+	ssize_t result = -1;
+	size_t size = prepareDestination(pSlot, fsGetStreamFileSize(&stream));
+	if (!size)
+	{
+		result = 0;
+	}
+	else if (fsSeekStream(&stream, SBO_START_OF_FILE, (ssize_t)pRequest->mOffset))
+	{
+		result = (ssize_t)fsReadFromStream(&stream, pRequest->pDestination, size);
+	}
+
+	fsCloseStream(&stream);
+	return result;
+}
+
+#if defined(USE_PREAD)
+static int openRequestFile(const AsyncReadRequest* pRequest, ssize_t* pOutFileSize)
+{
+	char filePath[FS_MAX_PATH] = {};
+	fsAppendPathComponent(fsGetResourceDirectory(pRequest->mResourceDir), pRequest->pFileName, filePath);
+
+	int fd = open(filePath, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		LOGF(LogLevel::eERROR, "Error opening file: %s (error: %s)", filePath, strerror(errno));
+		return -1;
+	}
+
+	struct stat fileInfo = {};
+	if (fstat(fd, &fileInfo) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+
+	*pOutFileSize = (ssize_t)fileInfo.st_size;
+	return fd;
+}
+
+static ssize_t readWithPread(AsyncReadSlot* pSlot)
+{
+	AsyncReadRequest* pRequest = pSlot->pRequest;
+	ssize_t fileSize = 0;
+	int fd = openRequestFile(pRequest, &fileSize);
+	if (fd < 0)
+	{
+		return -1;
+	}
+
+	size_t size = prepareDestination(pSlot, fileSize);
+	size_t bytesRead = 0;
+	while (bytesRead < size)
+	{
+		ssize_t res = pread(fd, (uint8_t*)pRequest->pDestination + bytesRead, size - bytesRead, (off_t)(pRequest->mOffset + bytesRead));
+		if (res < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (res <= 0)
+		{
+			break;
+		}
+		bytesRead += (size_t)res;
+	}
+
+	close(fd);
+	return bytesRead == size ? (ssize_t)bytesRead : -1;
+}
+#endif
+
+static void asyncReadTask(void* pUser, uintptr_t)
+{
+	AsyncReadSlot* pSlot = (AsyncReadSlot*)pUser;
+#if defined(USE_PREAD)
+	if (fsIsSystemResourceDir(pSlot->pRequest->mResourceDir))
+	{
+		finishRead(pSlot, readWithPread(pSlot));
+		return;
+	}
+#endif
+	finishRead(pSlot, readWithStream(pSlot));
+}
+/************************************************************************/
+// io_uring
+/************************************************************************/
+#if defined(USE_IO_URING)
+static bool initRing(AsyncReadQueue* pQueue)
+{
+	struct io_uring_params params = {};
+	int fd = (int)syscall(__NR_io_uring_setup, pQueue->mCapacity, &params);
+	if (fd < 0)
+	{
+		LOGF(LogLevel::eINFO, "io_uring is not available (%s), asynchronous reads use pread workers", strerror(errno));
+		return false;
+	}
+
+	pQueue->mRingFd = fd;
+	pQueue->mSqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+	pQueue->mCqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	pQueue->mSqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+
+	pQueue->pSqRing = mmap(NULL, pQueue->mSqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	pQueue->pCqRing = mmap(NULL, pQueue->mCqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+	void* sqes = mmap(NULL, pQueue->mSqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (pQueue->pSqRing == MAP_FAILED || pQueue->pCqRing == MAP_FAILED || sqes == MAP_FAILED)
+	{
+		LOGF(LogLevel::eWARNING, "Could not map the io_uring rings (%s), asynchronous reads use pread workers", strerror(errno));
+		if (pQueue->pSqRing != MAP_FAILED)
+			munmap(pQueue->pSqRing, pQueue->mSqRingSize);
+		if (pQueue->pCqRing != MAP_FAILED)
+			munmap(pQueue->pCqRing, pQueue->mCqRingSize);
+		if (sqes != MAP_FAILED)
+			munmap(sqes, pQueue->mSqesSize);
+		close(fd);
+		pQueue->mRingFd = -1;
+		return false;
+	}
+
+	uint8_t* sqRing = (uint8_t*)pQueue->pSqRing;
+	uint8_t* cqRing = (uint8_t*)pQueue->pCqRing;
+	pQueue->pSqes = (struct io_uring_sqe*)sqes;
+	pQueue->pSqHead = (uint32_t*)(sqRing + params.sq_off.head);
+	pQueue->pSqTail = (uint32_t*)(sqRing + params.sq_off.tail);
+	pQueue->mSqMask = *(uint32_t*)(sqRing + params.sq_off.ring_mask);
+	pQueue->pSqArray = (uint32_t*)(sqRing + params.sq_off.array);
+	pQueue->pCqHead = (uint32_t*)(cqRing + params.cq_off.head);
+	pQueue->pCqTail = (uint32_t*)(cqRing + params.cq_off.tail);
+	pQueue->mCqMask = *(uint32_t*)(cqRing + params.cq_off.ring_mask);
+	pQueue->pCqes = (struct io_uring_cqe*)(cqRing + params.cq_off.cqes);
+	pQueue->mSqTail = *pQueue->pSqTail;
+	return true;
+}
+
+static void exitRing(AsyncReadQueue* pQueue)
+{
+	munmap(pQueue->pSqes, pQueue->mSqesSize);
+	munmap(pQueue->pCqRing, pQueue->mCqRingSize);
+	munmap(pQueue->pSqRing, pQueue->mSqRingSize);
+	close(pQueue->mRingFd);
+	pQueue->mRingFd = -1;
+}
+
+// Queues the next chunk of a slot. The ring has an entry for every slot, so there is always room.
+static void queueRingRead(AsyncReadQueue* pQueue, AsyncReadSlot* pSlot)
+{
+	uint32_t index = pQueue->mSqTail & pQueue->mSqMask;
+	struct io_uring_sqe* pSqe = &pQueue->pSqes[index];
+	memset(pSqe, 0, sizeof(*pSqe));
+
+	pSlot->mVec.iov_base = (uint8_t*)pSlot->pRequest->pDestination + pSlot->mBytesRead;
+	pSlot->mVec.iov_len = pSlot->mRemaining;
+
+	// READV instead of READ keeps this working on kernels older than 5.6
+	pSqe->opcode = IORING_OP_READV;
+	pSqe->fd = pSlot->mFileDesc;
+	pSqe->off = pSlot->pRequest->mOffset + pSlot->mBytesRead;
+	pSqe->addr = (uint64_t)(uintptr_t)&pSlot->mVec;
+	pSqe->len = 1;
+	pSqe->user_data = (uint64_t)(uintptr_t)pSlot;
+
+	pQueue->pSqArray[index] = index;
+	++pQueue->mSqTail;
+	__atomic_store_n(pQueue->pSqTail, pQueue->mSqTail, __ATOMIC_RELEASE);
+}
+
+static bool enterRing(AsyncReadQueue* pQueue, uint32_t minComplete)
+{
+	uint32_t toSubmit = pQueue->mSqTail - __atomic_load_n(pQueue->pSqHead, __ATOMIC_ACQUIRE);
+	if (!toSubmit && !minComplete)
+	{
+		return true;
+	}
+
+	for (;;)
+	{
+		int res = (int)syscall(__NR_io_uring_enter, pQueue->mRingFd, toSubmit, minComplete, minComplete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+		if (res >= 0)
+		{
+			return true;
+		}
+		if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+		{
+			LOGF(LogLevel::eERROR, "io_uring_enter failed: %s", strerror(errno));
+			return false;
+		}
+		// Busy means the completion ring is full, reaping below makes room again
+		if (errno != EINTR)
+		{
+			return true;
+		}
+	}
+}
+
+static void reapRing(AsyncReadQueue* pQueue)
+{
+	uint32_t head = *pQueue->pCqHead;
+	uint32_t tail = __atomic_load_n(pQueue->pCqTail, __ATOMIC_ACQUIRE);
+
+	for (; head != tail; ++head)
+	{
+		const struct io_uring_cqe* pCqe = &pQueue->pCqes[head & pQueue->mCqMask];
+		AsyncReadSlot* pSlot = (AsyncReadSlot*)(uintptr_t)pCqe->user_data;
+		int res = pCqe->res;
+
+		if (res == -EINTR || res == -EAGAIN)
+		{
+			queueRingRead(pQueue, pSlot);
+			continue;
+		}
+
+		if (res > 0)
+		{
+			pSlot->mBytesRead += (size_t)res;
+			pSlot->mRemaining -= (size_t)res;
+			// Large reads can complete partially, keep going until the range is done or the file ends
+			if (pSlot->mRemaining)
+			{
+				queueRingRead(pQueue, pSlot);
+				continue;
+			}
+		}
+
+		close(pSlot->mFileDesc);
+		pSlot->mFileDesc = -1;
+		--pQueue->mRingReads;
+		finishRead(pSlot, (res < 0 || pSlot->mRemaining) ? -1 : (ssize_t)pSlot->mBytesRead);
+	}
+
+	__atomic_store_n(pQueue->pCqHead, head, __ATOMIC_RELEASE);
+}
+
+// Opens the file on the calling thread and queues the read. Returns false if the request completed right away.
+static bool startRingRead(AsyncReadQueue* pQueue, AsyncReadSlot* pSlot)
+{
+	ssize_t fileSize = 0;
+	int fd = openRequestFile(pSlot->pRequest, &fileSize);
+	if (fd < 0)
+	{
+		finishRead(pSlot, -1);
+		return false;
+	}
+
+	size_t size = prepareDestination(pSlot, fileSize);
+	if (!size)
+	{
+		close(fd);
+		finishRead(pSlot, 0);
+		return false;
+	}
+
+	pSlot->mFileDesc = fd;
+	pSlot->mBytesRead = 0;
+	pSlot->mRemaining = size;
+	++pQueue->mRingReads;
+	queueRingRead(pQueue, pSlot);
+	return true;
+}
+#endif
+// Without an output array the finished requests are discarded
+static uint32_t waitAsyncReads(AsyncReadQueue* pQueue, uint32_t minCompletions, uint32_t maxCompletions, AsyncReadRequest** ppCompleted)
+{
+	if (minCompletions > pQueue->mInFlight)
+	{
+		minCompletions = pQueue->mInFlight;
+	}
+	if (minCompletions > maxCompletions)
+	{
+		minCompletions = maxCompletions;
+	}
+
+#if defined(USE_IO_URING)
+	if (pQueue->mRingFd >= 0)
+	{
+		reapRing(pQueue);
+		// Ring reads are only completed by this thread, the workers may still add their own completions meanwhile
+		while (pQueue->mRingReads)
+		{
+			pQueue->mCompletedMutex.Acquire();
+			uint32_t completedCount = pQueue->mCompletedCount;
+			pQueue->mCompletedMutex.Release();
+
+			if (completedCount >= minCompletions)
+			{
+				break;
+			}
+
+			// Never wait for more ring events than there are ring reads, the rest may come from the workers
+			uint32_t waitCount = minCompletions - completedCount;
+			if (!enterRing(pQueue, waitCount < pQueue->mRingReads ? waitCount : pQueue->mRingReads))
+			{
+				break;
+			}
+			reapRing(pQueue);
+		}
+		// Also push out anything requeued while reaping
+		enterRing(pQueue, 0);
+	}
+#endif
+
+	pQueue->mCompletedMutex.Acquire();
+	while (pQueue->mCompletedCount < minCompletions && pQueue->pThreadSystem)
+	{
+		pQueue->mCompletedCond.Wait(pQueue->mCompletedMutex);
+	}
+
+	uint32_t count = 0;
+	for (; count < maxCompletions && pQueue->mCompletedCount; ++count)
+	{
+		uint32_t slotIndex = pQueue->pCompleted[pQueue->mCompletedHead];
+		pQueue->mCompletedHead = (pQueue->mCompletedHead + 1) % pQueue->mCapacity;
+		--pQueue->mCompletedCount;
+
+		AsyncReadSlot* pSlot = &pQueue->pSlots[slotIndex];
+		if (ppCompleted)
+		{
+			ppCompleted[count] = pSlot->pRequest;
+		}
+		else if (pSlot->mOwnsDestination)
+		{
+			tf_free(pSlot->pRequest->pDestination);
+			pSlot->pRequest->pDestination = NULL;
+		}
+		pSlot->pRequest = NULL;
+		pQueue->pFreeSlots[pQueue->mFreeSlotCount++] = slotIndex;
+	}
+	pQueue->mCompletedMutex.Release();
+
+	pQueue->mInFlight -= count;
+	return count;
+}
+/************************************************************************/
+// Interface
+/************************************************************************/
+bool fsCreateAsyncReadQueue(uint32_t maxInFlight, AsyncReadQueue** ppQueue)
+{
+	ASSERT(ppQueue);
+	ASSERT(maxInFlight);
+
+	AsyncReadQueue* pQueue = (AsyncReadQueue*)tf_calloc(1, sizeof(AsyncReadQueue));
+	pQueue->mCapacity = maxInFlight;
+	pQueue->pSlots = (AsyncReadSlot*)tf_calloc(maxInFlight, sizeof(AsyncReadSlot));
+	pQueue->pFreeSlots = (uint32_t*)tf_malloc(maxInFlight * sizeof(uint32_t));
+	pQueue->pCompleted = (uint32_t*)tf_malloc(maxInFlight * sizeof(uint32_t));
+	for (uint32_t i = 0; i < maxInFlight; ++i)
+	{
+		pQueue->pSlots[i].pQueue = pQueue;
+		pQueue->pFreeSlots[i] = maxInFlight - i - 1;
+	}
+	pQueue->mFreeSlotCount = maxInFlight;
+
+	pQueue->mCompletedMutex.Init();
+	pQueue->mCompletedCond.Init();
+
+#if defined(USE_IO_URING)
+	pQueue->mRingFd = -1;
+	initRing(pQueue);
+#endif
+
+	*ppQueue = pQueue;
+	return true;
+}
+
+void fsDestroyAsyncReadQueue(AsyncReadQueue* pQueue)
+{
+	if (!pQueue)
+	{
+		return;
+	}
+
+	// Nobody will pick up the remaining requests, drop the buffers allocated for them
+	while (pQueue->mInFlight)
+	{
+		waitAsyncReads(pQueue, 1, pQueue->mInFlight, NULL);
+	}
+
+	if (pQueue->pThreadSystem)
+	{
+		shutdownThreadSystem(pQueue->pThreadSystem);
+	}
+#if defined(USE_IO_URING)
+	if (pQueue->mRingFd >= 0)
+	{
+		exitRing(pQueue);
+	}
+#endif
+
+	pQueue->mCompletedCond.Destroy();
+	pQueue->mCompletedMutex.Destroy();
+	tf_free(pQueue->pCompleted);
+	tf_free(pQueue->pFreeSlots);
+	tf_free(pQueue->pSlots);
+	tf_free(pQueue);
+}
+
+uint32_t fsSubmitAsyncReads(AsyncReadQueue* pQueue, uint32_t count, AsyncReadRequest** ppRequests)
+{
+	ASSERT(pQueue);
+
+	uint32_t accepted = 0;
+	for (; accepted < count && pQueue->mInFlight < pQueue->mCapacity; ++accepted)
+	{
+		AsyncReadRequest* pRequest = ppRequests[accepted];
+		pRequest->mBytesRead = -1;
+
+		ASSERT(pQueue->mFreeSlotCount);
+		AsyncReadSlot* pSlot = &pQueue->pSlots[pQueue->pFreeSlots[--pQueue->mFreeSlotCount]];
+		pSlot->pRequest = pRequest;
+		pSlot->mOwnsDestination = false;
+		++pQueue->mInFlight;
+
+#if defined(USE_IO_URING)
+		if (pQueue->mRingFd >= 0 && fsIsSystemResourceDir(pRequest->mResourceDir))
+		{
+			startRingRead(pQueue, pSlot);
+			continue;
+		}
+#endif
+		if (!pQueue->pThreadSystem)
+		{
+			uint32_t threadCount = pQueue->mCapacity < MAX_LOAD_THREADS ? pQueue->mCapacity : MAX_LOAD_THREADS;
+			initThreadSystem(&pQueue->pThreadSystem, threadCount, 0, true, "AsyncRead");
+		}
+		addThreadSystemTask(pQueue->pThreadSystem, asyncReadTask, pSlot);
+	}
+
+#if defined(USE_IO_URING)
+	if (pQueue->mRingFd >= 0)
+	{
+		enterRing(pQueue, 0);
+	}
+#endif
+
+	return accepted;
+}
+
+uint32_t fsWaitAsyncReads(AsyncReadQueue* pQueue, uint32_t minCompletions, uint32_t maxCompletions, AsyncReadRequest** ppCompleted)
+{
+	ASSERT(pQueue);
+	ASSERT(ppCompleted);
+	return waitAsyncReads(pQueue, minCompletions, maxCompletions, ppCompleted);
+}
+
+uint32_t fsGetAsyncReadsInFlight(const AsyncReadQueue* pQueue)
+{
+	return pQueue->mInFlight;
+}
@@ -144,6 +144,11 @@ static bool MemoryStreamIsAtEnd(const FileStream* pStream)
 {
 	return pStream->mMemory.mCursor == pStream->mSize;
 }
+
+static const void* MemoryStreamGetBuffer(const FileStream* pStream)
+{
+	return pStream->mMemory.pBuffer;
+}
 /************************************************************************/
 // File Stream Functions
 /************************************************************************/
@@ -260,7 +265,8 @@ static IFileSystem gMemoryFileIO =
 	MemoryStreamGetSeekPosition,
 	MemoryStreamGetSize,
 	MemoryStreamFlush,
-	MemoryStreamIsAtEnd
+	MemoryStreamIsAtEnd,
+	MemoryStreamGetBuffer
 };
 
 static IFileSystem gSystemFileIO =
@@ -353,6 +359,11 @@ bool fsStreamAtEnd(const FileStream* pStream)
 {
 	return pStream->pIO->IsAtEnd(pStream);
 }
+
+const void* fsGetStreamBufferIfPresent(const FileStream* pStream)
+{
+	return pStream->pIO->GetStreamBuffer ? pStream->pIO->GetStreamBuffer(pStream) : NULL;
+}
 /************************************************************************/
 // Platform independent filename, extension functions
 /************************************************************************/
@@ -628,6 +639,16 @@ bool fsIsBundledResourceDir(ResourceDirectory resourceDir)
 	return gResourceDirectories[resourceDir].mBundled;
 }
 
+bool fsIsSystemResourceDir(ResourceDirectory resourceDir)
+{
+	return gResourceDirectories[resourceDir].pIO == pSystemFileIO;
+}
+
+bool fsIsResourceDirectorySet(ResourceDirectory resourceDir)
+{
+	return gResourceDirectories[resourceDir].pIO != NULL;
+}
+
 const char* fsGetResourceDirectory(ResourceDirectory resourceDir)
 {
 	const ResourceDirectoryInfo* dir = &gResourceDirectories[resourceDir];
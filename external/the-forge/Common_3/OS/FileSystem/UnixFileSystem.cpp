@@ -23,6 +23,8 @@
 */
 
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -81,11 +83,73 @@ time_t fsGetLastModifiedTime(ResourceDirectory resourceDir, const char* fileName
 	return fileInfo.st_mtime;
 }
 
+/************************************************************************/
+// Memory-mapped read-only streams
+/************************************************************************/
+static bool MappedFileStreamClose(FileStream* pFile)
+{
+	if (munmap(pFile->mMemory.pBuffer, (size_t)pFile->mSize) != 0)
+	{
+		LOGF(LogLevel::eERROR, "Error unmapping FileStream: %s", strerror(errno));
+		return false;
+	}
+
+	return true;
+}
+
+// Mapped streams behave exactly like non-owning memory streams, except that closing them unmaps the file.
+static IFileSystem* GetMappedFileIO(const IFileSystem* pMemoryIO)
+{
+	static IFileSystem mappedIO = [pMemoryIO]()
+	{
+		IFileSystem io = *pMemoryIO;
+		io.Close = MappedFileStreamClose;
+		return io;
+	}();
+	return &mappedIO;
+}
+
+static bool UnixMapFile(const char* filePath, FileMode mode, FileStream* pOut)
+{
+	int fd = open(filePath, O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat fileInfo = {};
+	void* mapping = MAP_FAILED;
+	if (fstat(fd, &fileInfo) == 0 && S_ISREG(fileInfo.st_mode) && fileInfo.st_size > 0)
+	{
+		mapping = mmap(NULL, (size_t)fileInfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	// The mapping keeps its own reference to the file.
+	close(fd);
+
+	if (mapping == MAP_FAILED)
+	{
+		return false;
+	}
+
+	fsOpenStreamFromMemory(mapping, (size_t)fileInfo.st_size, mode, false, pOut);
+	pOut->pIO = GetMappedFileIO(pOut->pIO);
+	return true;
+}
+
 bool UnixOpenFile(ResourceDirectory resourceDir, const char* fileName, FileMode mode, FileStream* pOut)
 {
 	const char* resourcePath = fsGetResourceDirectory(resourceDir);
 	char filePath[FS_MAX_PATH] = {};
 	fsAppendPathComponent(resourcePath, fileName, filePath);
+
+	// Read-only binary files are mapped instead of buffered through stdio so callers can access
+	// the contents directly with fsGetStreamBufferIfPresent. Empty files and anything that cannot be
+	// mapped (pipes, special files) fall back to fopen.
+	if ((mode & ~FM_ALLOW_READ) == FM_READ_BINARY && UnixMapFile(filePath, mode, pOut))
+	{
+		return true;
+	}
+
 	const char* modeStr = fsFileModeToString(mode);
 
 	FILE* file = fopen(filePath, modeStr);
@@ -23,11 +23,471 @@
 //*/
 
 #include "../../ThirdParty/OpenSource/zip/zip.h"
+#define MINIZ_HEADER_FILE_ONLY
+#include "../../ThirdParty/OpenSource/zip/miniz.h"
 
+#include "../Math/MathTypes.h"
 #include "../Interfaces/ILog.h"
 #include "../Interfaces/IMemory.h"
 
-static bool ZipOpen(IFileSystem* pIO, const ResourceDirectory resourceDir, const char* fileName, FileMode mode, FileStream* pOut)
+/************************************************************************/
+// Mounted read-only archive
+// The archive is mapped by the platform file layer (or loaded) once and its central directory is turned into a hash index on mount.
+// Stored entries are served straight from the archive memory, deflated entries are inflated while reading.
+/************************************************************************/
+typedef struct ZipArchiveEntry
+{
+	uint64_t mLocalHeaderOffset;
+	uint64_t mCompressedSize;
+	uint64_t mUncompressedSize;
+	uint32_t mNameOffset;
+	uint32_t mNameLength;
+	uint32_t mHash;
+	uint16_t mMethod;
+} ZipArchiveEntry;
+
+typedef struct ZipArchive
+{
+	const uint8_t*   pData;
+	uint64_t         mSize;
+	// Kept open while pData points into its mapping, otherwise pData is owned by the archive
+	FileStream       mStream;
+	bool             mMapped;
+
+	ZipArchiveEntry* pEntries;
+	uint32_t         mEntryCount;
+	// Open addressing table of entry index + 1, zero marks an empty slot
+	uint32_t*        pBuckets;
+	uint32_t         mBucketMask;
+	char*            pNames;
+} ZipArchive;
+
+typedef struct ZipInflateStream
+{
+	const uint8_t*     pCompressed;
+	uint64_t           mCompressedSize;
+	uint64_t           mCompressedCursor;
+	uint64_t           mPosition;
+	size_t             mDictOffset;
+	size_t             mDictAvailable;
+	size_t             mDictWrite;
+	tinfl_status       mStatus;
+	tinfl_decompressor mInflator;
+	uint8_t            mDict[TINFL_LZ_DICT_SIZE];
+} ZipInflateStream;
+
+static inline char ZipNormalizeChar(char c)
+{
+	if (c == '\\')
+		return '/';
+	if (c >= 'A' && c <= 'Z')
+		return c - 'A' + 'a';
+	return c;
+}
+
+// Matches the case insensitive lookup of mz_zip_reader_locate_file
+static uint32_t ZipHashName(const char* name, size_t length)
+{
+	uint32_t hash = 2166136261U;
+	for (size_t i = 0; i < length; ++i)
+	{
+		hash ^= (uint8_t)ZipNormalizeChar(name[i]);
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+static bool ZipNameEquals(const char* a, const char* b, size_t length)
+{
+	for (size_t i = 0; i < length; ++i)
+	{
+		if (ZipNormalizeChar(a[i]) != ZipNormalizeChar(b[i]))
+			return false;
+	}
+	return true;
+}
+
+static const ZipArchiveEntry* ZipFindEntry(const ZipArchive* pArchive, const char* name)
+{
+	if (!pArchive->mEntryCount)
+		return NULL;
+
+	const size_t length = strlen(name);
+	const uint32_t hash = ZipHashName(name, length);
+	for (uint32_t slot = hash & pArchive->mBucketMask;; slot = (slot + 1) & pArchive->mBucketMask)
+	{
+		uint32_t bucket = pArchive->pBuckets[slot];
+		if (!bucket)
+			return NULL;
+
+		const ZipArchiveEntry* pEntry = &pArchive->pEntries[bucket - 1];
+		if (pEntry->mHash == hash && pEntry->mNameLength == length && ZipNameEquals(pArchive->pNames + pEntry->mNameOffset, name, length))
+			return pEntry;
+	}
+}
+
+static bool ZipMapArchive(const ResourceDirectory resourceDir, const char* fileName, ZipArchive* pArchive)
+{
+	FileStream stream = {};
+	if (!fsOpenStreamFromPath(resourceDir, fileName, FM_READ_BINARY, &stream))
+		return false;
+
+	ssize_t size = fsGetStreamFileSize(&stream);
+	if (size <= 0)
+	{
+		fsCloseStream(&stream);
+		return false;
+	}
+
+	const void* pMapping = fsGetStreamBufferIfPresent(&stream);
+	if (pMapping)
+	{
+		pArchive->pData = (const uint8_t*)pMapping;
+		pArchive->mSize = (uint64_t)size;
+		pArchive->mStream = stream;
+		pArchive->mMapped = true;
+		return true;
+	}
+
+	// No mapping support (bundled assets, consoles), keep the archive in memory instead
+	uint8_t* pData = (uint8_t*)tf_malloc((size_t)size);
+	size_t bytesRead = fsReadFromStream(&stream, pData, (size_t)size);
+	fsCloseStream(&stream);
+	if (bytesRead != (size_t)size)
+	{
+		tf_free(pData);
+		return false;
+	}
+
+	pArchive->pData = pData;
+	pArchive->mSize = (uint64_t)size;
+	pArchive->mMapped = false;
+	return true;
+}
+
+static void ZipUnmapArchive(ZipArchive* pArchive)
+{
+	if (pArchive->mMapped)
+	{
+		fsCloseStream(&pArchive->mStream);
+		return;
+	}
+	tf_free((void*)pArchive->pData);
+}
+
+static void* ZipAllocFunc(void*, size_t items, size_t size) { return tf_calloc(items, size); }
+static void  ZipFreeFunc(void*, void* address) { tf_free(address); }
+static void* ZipReallocFunc(void*, void* address, size_t items, size_t size) { return tf_realloc(address, items * size); }
+
+static bool ZipBuildIndex(ZipArchive* pArchive)
+{
+	mz_zip_archive zip = {};
+	zip.m_pAlloc = ZipAllocFunc;
+	zip.m_pFree = ZipFreeFunc;
+	zip.m_pRealloc = ZipReallocFunc;
+	if (!mz_zip_reader_init_mem(&zip, pArchive->pData, (size_t)pArchive->mSize, MZ_ZIP_FLAG_DO_NOT_SORT_CENTRAL_DIRECTORY))
+		return false;
+
+	const mz_uint fileCount = mz_zip_reader_get_num_files(&zip);
+	uint32_t bucketCount = 16;
+	while (bucketCount < fileCount * 2)
+		bucketCount <<= 1;
+
+	pArchive->pEntries = (ZipArchiveEntry*)tf_calloc(fileCount ? fileCount : 1, sizeof(ZipArchiveEntry));
+	pArchive->pBuckets = (uint32_t*)tf_calloc(bucketCount, sizeof(uint32_t));
+	pArchive->mBucketMask = bucketCount - 1;
+	pArchive->mEntryCount = 0;
+
+	size_t namesCapacity = 0;
+	size_t namesSize = 0;
+	mz_zip_archive_file_stat fileStat;
+	for (mz_uint i = 0; i < fileCount; ++i)
+	{
+		if (!mz_zip_reader_file_stat(&zip, i, &fileStat) || mz_zip_reader_is_file_a_directory(&zip, i))
+			continue;
+
+		if (fileStat.m_bit_flag & 1)
+		{
+			LOGF(LogLevel::eWARNING, "Skipping encrypted zip entry %s", fileStat.m_filename);
+			continue;
+		}
+
+		const size_t nameLength = strlen(fileStat.m_filename);
+		if (namesSize + nameLength + 1 > namesCapacity)
+		{
+			namesCapacity = max<size_t>(namesCapacity * 2, namesSize + nameLength + 1);
+			pArchive->pNames = (char*)tf_realloc(pArchive->pNames, namesCapacity);
+		}
+		memcpy(pArchive->pNames + namesSize, fileStat.m_filename, nameLength + 1);
+
+		ZipArchiveEntry* pEntry = &pArchive->pEntries[pArchive->mEntryCount];
+		pEntry->mLocalHeaderOffset = fileStat.m_local_header_ofs;
+		pEntry->mCompressedSize = fileStat.m_comp_size;
+		pEntry->mUncompressedSize = fileStat.m_uncomp_size;
+		pEntry->mNameOffset = (uint32_t)namesSize;
+		pEntry->mNameLength = (uint32_t)nameLength;
+		pEntry->mHash = ZipHashName(fileStat.m_filename, nameLength);
+		pEntry->mMethod = fileStat.m_method;
+		namesSize += nameLength + 1;
+
+		// First entry wins on duplicate names, same as the linear search in miniz
+		uint32_t slot = pEntry->mHash & pArchive->mBucketMask;
+		bool duplicate = false;
+		while (pArchive->pBuckets[slot])
+		{
+			const ZipArchiveEntry* pOther = &pArchive->pEntries[pArchive->pBuckets[slot] - 1];
+			if (pOther->mHash == pEntry->mHash && pOther->mNameLength == nameLength &&
+				ZipNameEquals(pArchive->pNames + pOther->mNameOffset, fileStat.m_filename, nameLength))
+			{
+				duplicate = true;
+				break;
+			}
+			slot = (slot + 1) & pArchive->mBucketMask;
+		}
+		if (!duplicate)
+			pArchive->pBuckets[slot] = ++pArchive->mEntryCount;
+	}
+
+	mz_zip_reader_end(&zip);
+	return true;
+}
+
+static inline uint32_t ZipReadLE16(const uint8_t* p) { return (uint32_t)p[0] | ((uint32_t)p[1] << 8); }
+static inline uint32_t ZipReadLE32(const uint8_t* p) { return ZipReadLE16(p) | (ZipReadLE16(p + 2) << 16); }
+
+static const uint8_t* ZipGetEntryData(const ZipArchive* pArchive, const ZipArchiveEntry* pEntry)
+{
+	// Local file header layout, the name and extra field lengths can differ from the central directory
+	const uint32_t localHeaderSig = 0x04034b50;
+	const uint32_t localHeaderSize = 30;
+	const uint32_t nameLengthOffset = 26;
+	const uint32_t extraLengthOffset = 28;
+
+	const uint64_t headerOffset = pEntry->mLocalHeaderOffset;
+	if (headerOffset + localHeaderSize > pArchive->mSize)
+		return NULL;
+
+	const uint8_t* pHeader = pArchive->pData + headerOffset;
+	if (ZipReadLE32(pHeader) != localHeaderSig)
+		return NULL;
+
+	const uint64_t dataOffset =
+		headerOffset + localHeaderSize + ZipReadLE16(pHeader + nameLengthOffset) + ZipReadLE16(pHeader + extraLengthOffset);
+	if (dataOffset + pEntry->mCompressedSize > pArchive->mSize)
+		return NULL;
+
+	return pArchive->pData + dataOffset;
+}
+/************************************************************************/
+// Deflated entry stream
+/************************************************************************/
+static void ZipInflateReset(ZipInflateStream* pInflate)
+{
+	tinfl_init(&pInflate->mInflator);
+	pInflate->mCompressedCursor = 0;
+	pInflate->mPosition = 0;
+	pInflate->mDictOffset = 0;
+	pInflate->mDictAvailable = 0;
+	pInflate->mDictWrite = 0;
+	pInflate->mStatus = TINFL_STATUS_NEEDS_MORE_INPUT;
+}
+
+// Inflates up to byteCount bytes into pOutput. A NULL pOutput discards the data, which is how forward seeks work.
+static size_t ZipInflate(FileStream* pFile, uint8_t* pOutput, size_t byteCount)
+{
+	ZipInflateStream* pInflate = (ZipInflateStream*)pFile->pUser;
+	byteCount = (size_t)min<uint64_t>(byteCount, (uint64_t)pFile->mSize - pInflate->mPosition);
+
+	// Whole entry requested from the start: inflate straight into the caller's buffer
+	if (pOutput && pInflate->mPosition == 0 && pInflate->mCompressedCursor == 0 && byteCount == (size_t)pFile->mSize)
+	{
+		size_t inSize = (size_t)pInflate->mCompressedSize;
+		size_t outSize = byteCount;
+		tinfl_status status = tinfl_decompress(&pInflate->mInflator, pInflate->pCompressed, &inSize, pOutput, pOutput, &outSize,
+			TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
+		if (status == TINFL_STATUS_DONE && outSize == byteCount)
+		{
+			pInflate->mCompressedCursor = inSize;
+			pInflate->mPosition = outSize;
+			pInflate->mStatus = status;
+			return outSize;
+		}
+
+		LOGF(LogLevel::eERROR, "Failed to inflate zip entry (status %d)", (int)status);
+		ZipInflateReset(pInflate);
+		return 0;
+	}
+
+	size_t bytesRead = 0;
+	while (bytesRead < byteCount)
+	{
+		if (pInflate->mDictAvailable)
+		{
+			size_t copySize = min(byteCount - bytesRead, pInflate->mDictAvailable);
+			if (pOutput)
+				memcpy(pOutput + bytesRead, pInflate->mDict + pInflate->mDictOffset, copySize);
+			pInflate->mDictOffset += copySize;
+			pInflate->mDictAvailable -= copySize;
+			pInflate->mPosition += copySize;
+			bytesRead += copySize;
+			continue;
+		}
+
+		if (pInflate->mStatus <= TINFL_STATUS_DONE)
+		{
+			LOGF_IF(LogLevel::eERROR, pInflate->mStatus < TINFL_STATUS_DONE, "Failed to inflate zip entry (status %d)", (int)pInflate->mStatus);
+			break;
+		}
+
+		size_t inSize = (size_t)(pInflate->mCompressedSize - pInflate->mCompressedCursor);
+		size_t outSize = TINFL_LZ_DICT_SIZE - pInflate->mDictWrite;
+		pInflate->mStatus = tinfl_decompress(&pInflate->mInflator, pInflate->pCompressed + pInflate->mCompressedCursor, &inSize,
+			pInflate->mDict, pInflate->mDict + pInflate->mDictWrite, &outSize, 0);
+		pInflate->mCompressedCursor += inSize;
+		pInflate->mDictOffset = pInflate->mDictWrite;
+		pInflate->mDictAvailable = outSize;
+		pInflate->mDictWrite = (pInflate->mDictWrite + outSize) & (TINFL_LZ_DICT_SIZE - 1);
+	}
+
+	return bytesRead;
+}
+
+static bool ZipInflateClose(FileStream* pFile)
+{
+	tf_free(pFile->pUser);
+	return true;
+}
+
+static size_t ZipInflateRead(FileStream* pFile, void* outputBuffer, size_t bufferSizeInBytes)
+{
+	return ZipInflate(pFile, (uint8_t*)outputBuffer, bufferSizeInBytes);
+}
+
+static size_t ZipInflateWrite(FileStream*, const void*, size_t)
+{
+	LOGF(LogLevel::eWARNING, "Attempting to write to read-only zip entry");
+	return 0;
+}
+
+static bool ZipInflateSeek(FileStream* pFile, SeekBaseOffset baseOffset, ssize_t seekOffset)
+{
+	ZipInflateStream* pInflate = (ZipInflateStream*)pFile->pUser;
+
+	ssize_t newPosition = seekOffset;
+	switch (baseOffset)
+	{
+	case SBO_START_OF_FILE: break;
+	case SBO_CURRENT_POSITION: newPosition += (ssize_t)pInflate->mPosition; break;
+	case SBO_END_OF_FILE: newPosition += pFile->mSize; break;
+	}
+
+	if (newPosition < 0 || newPosition > pFile->mSize)
+	{
+		return false;
+	}
+
+	// Deflate streams can only be decoded forward, restart for backward seeks
+	if ((uint64_t)newPosition < pInflate->mPosition)
+	{
+		ZipInflateReset(pInflate);
+	}
+
+	size_t skipSize = (size_t)((uint64_t)newPosition - pInflate->mPosition);
+	return ZipInflate(pFile, NULL, skipSize) == skipSize;
+}
+
+static ssize_t ZipInflateGetSeekPosition(const FileStream* pFile)
+{
+	return (ssize_t)((const ZipInflateStream*)pFile->pUser)->mPosition;
+}
+
+static ssize_t ZipInflateGetSize(const FileStream* pFile)
+{
+	return pFile->mSize;
+}
+
+static bool ZipInflateFlush(FileStream*)
+{
+	return true;
+}
+
+static bool ZipInflateIsAtEnd(const FileStream* pFile)
+{
+	return (ssize_t)((const ZipInflateStream*)pFile->pUser)->mPosition == pFile->mSize;
+}
+
+static IFileSystem gZipInflateIO =
+{
+	NULL,
+	ZipInflateClose,
+	ZipInflateRead,
+	ZipInflateWrite,
+	ZipInflateSeek,
+	ZipInflateGetSeekPosition,
+	ZipInflateGetSize,
+	ZipInflateFlush,
+	ZipInflateIsAtEnd
+};
+/************************************************************************/
+// Zip file system
+/************************************************************************/
+static bool ZipArchiveOpen(IFileSystem* pIO, const ResourceDirectory resourceDir, const char* fileName, FileMode mode, FileStream* pOut)
+{
+	if (mode & (FM_WRITE | FM_APPEND))
+	{
+		LOGF(LogLevel::eERROR, "Zip archives are mounted read-only, cannot open %s with mode %u", fileName, mode);
+		return false;
+	}
+
+	const ZipArchive* pArchive = (const ZipArchive*)pIO->pUser;
+	char filePath[FS_MAX_PATH] = {};
+	fsAppendPathComponent(fsGetResourceDirectory(resourceDir), fileName, filePath);
+
+	const ZipArchiveEntry* pEntry = ZipFindEntry(pArchive, filePath);
+	if (!pEntry)
+	{
+		LOGF(LogLevel::eINFO, "Error finding file %s for opening in zip", fileName);
+		return false;
+	}
+
+	const uint8_t* pData = ZipGetEntryData(pArchive, pEntry);
+	if (!pData)
+	{
+		LOGF(LogLevel::eERROR, "Corrupt local header for zip entry %s", fileName);
+		return false;
+	}
+
+	if (pEntry->mMethod == 0)
+	{
+		// Stored entries are served straight from the archive memory
+		return fsOpenStreamFromMemory(pData, (size_t)pEntry->mUncompressedSize, mode, false, pOut);
+	}
+
+	if (pEntry->mMethod != MZ_DEFLATED)
+	{
+		LOGF(LogLevel::eERROR, "Unsupported compression method %u for zip entry %s", (uint32_t)pEntry->mMethod, fileName);
+		return false;
+	}
+
+	ZipInflateStream* pInflate = (ZipInflateStream*)tf_malloc(sizeof(ZipInflateStream));
+	pInflate->pCompressed = pData;
+	pInflate->mCompressedSize = pEntry->mCompressedSize;
+	ZipInflateReset(pInflate);
+
+	*pOut = {};
+	pOut->pIO = &gZipInflateIO;
+	pOut->pUser = pInflate;
+	pOut->mSize = (ssize_t)pEntry->mUncompressedSize;
+	pOut->mMode = mode;
+	return true;
+}
+
+static IFileSystem gZipFileIO =
+{
+	ZipArchiveOpen
+};
+
+static bool ZipWriterOpen(IFileSystem* pIO, const ResourceDirectory resourceDir, const char* fileName, FileMode mode, FileStream* pOut)
 {
 	// #TODO: Write to zip
 
@@ -39,7 +499,7 @@ static bool ZipOpen(IFileSystem* pIO, const ResourceDirectory resourceDir, const
 	if (error)
 	{
 		LOGF(LogLevel::eINFO, "Error %i finding file %s for opening in zip: %s", error, fileName, fileName);
-		return NULL;
+		return false;
 	}
 
 	// Extract the contents of the zip entry
@@ -53,30 +513,42 @@ static bool ZipOpen(IFileSystem* pIO, const ResourceDirectory resourceDir, const
 	return fsOpenStreamFromMemory(uncompressed, uncompressedSize, mode, true, pOut);
 }
 
-// #NOTE - Only one function needed for zip file IO as we unzip the zip entry when it is opened and treat it as memory buffer
-// More will be needed if we want to support zip write
-static IFileSystem gZipFileIO =
+// #NOTE - Archives opened for writing or appending still go through the zip library and unzip entries on open
+static IFileSystem gZipWriterIO =
 {
-	ZipOpen
+	ZipWriterOpen
 };
 
 bool fsOpenZipFile(const ResourceDirectory resourceDir, const char* fileName, FileMode mode, IFileSystem* pOut)
 {
-	char zipMode = 0;
-
-	if (mode & FM_WRITE)
-	{
-		zipMode = 'w';
-	}
-	else if (mode & FM_READ)
-	{
-		zipMode = 'r';
-	}
-	else
+	if (!(mode & (FM_WRITE | FM_APPEND)))
 	{
-		zipMode = 'a';
+		ZipArchive* pArchive = (ZipArchive*)tf_calloc(1, sizeof(ZipArchive));
+		if (!ZipMapArchive(resourceDir, fileName, pArchive))
+		{
+			LOGF(LogLevel::eERROR, "Error opening zip file at %s", fileName);
+			tf_free(pArchive);
+			return false;
+		}
+
+		if (!ZipBuildIndex(pArchive))
+		{
+			LOGF(LogLevel::eERROR, "Error reading central directory of zip file at %s", fileName);
+			ZipUnmapArchive(pArchive);
+			tf_free(pArchive->pEntries);
+			tf_free(pArchive->pBuckets);
+			tf_free(pArchive->pNames);
+			tf_free(pArchive);
+			return false;
+		}
+
+		IFileSystem system = gZipFileIO;
+		system.pUser = pArchive;
+		*pOut = system;
+		return true;
 	}
 
+	char zipMode = (mode & FM_WRITE) ? 'w' : 'a';
 	zip_t* zipFile = zip_open(resourceDir, fileName, ZIP_DEFAULT_COMPRESSION_LEVEL, zipMode);
 
 	if (!zipFile)
@@ -85,7 +557,7 @@ bool fsOpenZipFile(const ResourceDirectory resourceDir, const char* fileName, Fi
 		return false;
 	}
 
-	IFileSystem system = gZipFileIO;
+	IFileSystem system = gZipWriterIO;
 	system.pUser = zipFile;
 	*pOut = system;
 
@@ -94,6 +566,17 @@ bool fsOpenZipFile(const ResourceDirectory resourceDir, const char* fileName, Fi
 
 bool fsCloseZipFile(IFileSystem* pZip)
 {
+	if (pZip->Open == ZipArchiveOpen)
+	{
+		ZipArchive* pArchive = (ZipArchive*)pZip->pUser;
+		ZipUnmapArchive(pArchive);
+		tf_free(pArchive->pEntries);
+		tf_free(pArchive->pBuckets);
+		tf_free(pArchive->pNames);
+		tf_free(pArchive);
+		return true;
+	}
+
 	zip_close((zip_t*)pZip->pUser);
 	return true;
 }
@@ -61,6 +61,8 @@ typedef enum ResourceDirectory
 	RD_GPU_CONFIG,
 	RD_LOG,
 	RD_SCRIPTS,
+	/// Compiled Lua bytecode written by the Lua manager. Scripts are compiled from source every run while it is not set.
+	RD_SCRIPT_CACHE,
 	RD_SCREENSHOTS,
 	RD_OTHER_FILES,
 
@@ -166,6 +168,7 @@ typedef struct IFileSystem
 	ssize_t     (*GetFileSize)(const FileStream* pFile);
 	bool        (*Flush)(FileStream* pFile);
 	bool        (*IsAtEnd)(const FileStream* pFile);
+	const void* (*GetStreamBuffer)(const FileStream* pFile);
 	const char* (*GetResourceMount)(ResourceMount mount);
 
 	void*       pUser;
@@ -215,6 +218,10 @@ bool fsFlushStream(FileStream* stream);
 
 /// Returns whether the current seek position is at the end of the file stream.
 bool fsStreamAtEnd(const FileStream* stream);
+
+/// Returns the start of the stream's contents if they are addressable in memory (memory streams and
+/// memory-mapped read-only files), or NULL otherwise. The pointer stays valid until the stream is closed.
+const void* fsGetStreamBufferIfPresent(const FileStream* stream);
 /************************************************************************/
 // MARK: - Minor filename manipulation
 /************************************************************************/
@@ -243,6 +250,9 @@ void fsGetPathExtension(const char* path, char* output);
 /// Returns location set for resource directory in fsSetPathForResourceDir.
 const char* fsGetResourceDirectory(ResourceDirectory resourceDir);
 
+/// Returns whether fsSetPathForResourceDir was called for `resourceDir`, for directories which are optional.
+bool fsIsResourceDirectorySet(ResourceDirectory resourceDir);
+
 /// Sets the relative path for `resourceDir` from `mount` to `bundledFolder`.
 /// The `resourceDir` will making use of the given IFileSystem `pIO` file functions.
 /// When `mount` is set to `RM_CONTENT` for a `resourceDir`, this directory is marked as a bundled resource folder.
@@ -255,6 +265,51 @@ void fsSetPathForResourceDir(IFileSystem* pIO, ResourceMount mount, ResourceDire
 /// Gets the time of last modification for the file at `fileName`, within 'resourceDir'.
 time_t fsGetLastModifiedTime(ResourceDirectory resourceDir, const char* fileName);
 /************************************************************************/
+// MARK: - Asynchronous reads
+/************************************************************************/
+typedef struct AsyncReadRequest
+{
+	ResourceDirectory mResourceDir;
+	const char*       pFileName;
+	/// Byte range to read. A size of 0 reads until the end of the file, larger sizes are clamped to it.
+	size_t            mOffset;
+	size_t            mSize;
+	/// Receives the data. When NULL a buffer of the read size is allocated with tf_malloc and owned by the caller after completion.
+	void*             pDestination;
+	void*             pUserData;
+	/// Set on completion to the number of bytes read, or -1 if the file could not be opened or read.
+	ssize_t           mBytesRead;
+} AsyncReadRequest;
+
+typedef struct AsyncReadQueue AsyncReadQueue;
+
+/// Creates a queue which keeps up to `maxInFlight` reads in flight. Reads go through io_uring where the kernel supports it
+/// and through a pool of pread workers otherwise. A queue must only be used from one thread at a time.
+bool fsCreateAsyncReadQueue(uint32_t maxInFlight, AsyncReadQueue** ppQueue);
+
+/// Waits for the reads still in flight and destroys the queue.
+void fsDestroyAsyncReadQueue(AsyncReadQueue* pQueue);
+
+/// Starts reading a batch of requests. Returns how many were accepted, which is less than `count` once the queue is full.
+/// Requests and their file names must stay valid until they are returned by fsWaitAsyncReads.
+uint32_t fsSubmitAsyncReads(AsyncReadQueue* pQueue, uint32_t count, AsyncReadRequest** ppRequests);
+
+/// Waits until at least `minCompletions` reads have finished, 0 only polls. Returns up to `maxCompletions` finished requests in `ppCompleted`.
+uint32_t fsWaitAsyncReads(AsyncReadQueue* pQueue, uint32_t minCompletions, uint32_t maxCompletions, AsyncReadRequest** ppCompleted);
+
+/// Number of submitted reads which have not been returned by fsWaitAsyncReads yet.
+uint32_t fsGetAsyncReadsInFlight(const AsyncReadQueue* pQueue);
+/************************************************************************/
+// MARK: - Zip archives
+/************************************************************************/
+/// Mounts the zip archive at `fileName` as an IFileSystem which can be passed to fsSetPathForResourceDir.
+/// Read-only archives are mapped once and indexed, stored entries are read in place and deflated entries
+/// are inflated while reading.
+bool fsOpenZipFile(const ResourceDirectory resourceDir, const char* fileName, FileMode mode, IFileSystem* pOut);
+
+/// Unmounts an archive opened with fsOpenZipFile. All streams opened from it must be closed first.
+bool fsCloseZipFile(IFileSystem* pZip);
+/************************************************************************/
 // MARK: - FileMode
 /************************************************************************/
 static inline FileMode fsFileModeFromString(const char* modeStr)
@@ -41,6 +41,78 @@ void* tf_calloc_memalign_internal(size_t count, size_t align, size_t size, const
 void* tf_realloc_internal(void* ptr, size_t size, const char *f, int l, const char *sf);
 void  tf_free_internal(void* ptr, const char *f, int l, const char *sf);
 
+/************************************************************************/
+// MARK: - Allocator backends
+/************************************************************************/
+typedef enum MemAllocBackend
+{
+	/// Every allocation goes to the C runtime
+	MEM_ALLOC_BACKEND_SYSTEM = 0,
+	/// Allocations up to MEM_ALLOC_MAX_SMALL_SIZE come from size-class slabs through a cache owned by each thread.
+	/// Bigger allocations still go to the C runtime.
+	MEM_ALLOC_BACKEND_THREAD_CACHE,
+} MemAllocBackend;
+
+#define MEM_ALLOC_MAX_SMALL_SIZE (32 * 1024)
+#define MEM_ALLOC_SIZE_CLASS_COUNT 40
+
+typedef struct MemAllocDesc
+{
+	const char*     pAppName;
+	MemAllocBackend mBackend;
+	/// Address space reserved for the slabs of MEM_ALLOC_BACKEND_THREAD_CACHE. 0 uses the default of 4 GB.
+	size_t          mReserveSize;
+} MemAllocDesc;
+
+typedef struct MemAllocSizeClassStats
+{
+	size_t   mSize;
+	uint64_t mLiveBytes;
+	uint64_t mPeakBytes;
+	uint64_t mAllocationCount;
+} MemAllocSizeClassStats;
+
+typedef struct MemAllocStats
+{
+	MemAllocBackend        mBackend;
+	/// 0 unless MEM_ALLOC_BACKEND_THREAD_CACHE is in use
+	uint32_t               mSizeClassCount;
+	MemAllocSizeClassStats mSizeClasses[MEM_ALLOC_SIZE_CLASS_COUNT];
+} MemAllocStats;
+
+/// Uses MEM_ALLOC_BACKEND_SYSTEM
+bool MemAllocInit(const char* appName);
+/// Memory allocated before MemAllocInit, from either backend, can still be passed to tf_free and tf_realloc afterwards.
+/// Falls back to MEM_ALLOC_BACKEND_SYSTEM if the slab address space can not be reserved.
+/// The backend is ignored when USE_MEMORY_TRACKING is defined.
+bool MemAllocInit(const MemAllocDesc* pDesc);
+void MemAllocExit();
+/// Thread caches publish their counters in batches, so live and peak bytes can be behind by a few batches per thread.
+void MemAllocGetStats(MemAllocStats* pOutStats);
+
+/************************************************************************/
+// MARK: - Frame arenas
+/************************************************************************/
+/// Linear allocator for transient memory. Allocations are never freed one by one, resetFrameArena releases all of them at once.
+/// frameArenaAlloc may be called from several threads at once, resetFrameArena may not run concurrently with it.
+typedef struct FrameArena FrameArena;
+
+typedef struct FrameArenaStats
+{
+	/// Bytes handed out since the last reset, including alignment padding
+	uint64_t mLiveBytes;
+	/// Most bytes handed out between two resets
+	uint64_t mPeakBytes;
+	uint64_t mReservedBytes;
+} FrameArenaStats;
+
+bool  initFrameArena(size_t blockSize, FrameArena** ppArena);
+void  exitFrameArena(FrameArena* pArena);
+void* frameArenaAlloc(FrameArena* pArena, size_t size, size_t align);
+/// When the last frame did not fit in one block, the blocks are merged into a single one so the next frame does not have to chain them.
+void  resetFrameArena(FrameArena* pArena);
+void  getFrameArenaStats(FrameArena* pArena, FrameArenaStats* pOutStats);
+
 template <typename T, typename... Args>
 static T* tf_placement_new(void* ptr, Args&&... args)
 {
@@ -71,6 +71,57 @@ void dumpProfileData(Renderer* pRenderer, const char* appName = "" , uint32_t nM
 // Dump benchmark data to "benchmark-(data).txt" of recorded frames
 void dumpBenchmarkData(Renderer* pRenderer, IApp::Settings* pSettings, const char* appName = "");
 
+typedef struct ProfileStreamStats
+{
+	uint64_t mFrames;
+	// Frames skipped because the writer thread fell behind
+	uint64_t mDroppedFrames;
+	uint64_t mEntries;
+	uint64_t mBytesWritten;
+	// Time spent encoding the logs in flipProfiler
+	double   mFlipTotalMs;
+	double   mFlipMaxMs;
+	// Time the writer thread spent writing to disk
+	double   mWriterTotalMs;
+} ProfileStreamStats;
+
+// Stream every scope, label and counter recorded from now on to pFileName in the log directory, until stopProfileStream.
+// The logs are drained on each flipProfiler, so the capture is not limited to the frame history of the profiler
+bool startProfileStream(const char* pFileName);
+
+void stopProfileStream();
+
+void getProfileStreamStats(ProfileStreamStats* pOutStats);
+
+// Convert a profile stream to Chrome trace event JSON, which chrome://tracing and Perfetto can open. Both files are in the log directory
+bool convertProfileStreamToChromeTrace(const char* pStreamFileName, const char* pJsonFileName);
+
+typedef struct ProfileLatencyStats
+{
+	uint64_t mCount;
+	float    mMinMs;
+	float    mP50Ms;
+	float    mP95Ms;
+	float    mP99Ms;
+	float    mP999Ms;
+	float    mMaxMs;
+} ProfileLatencyStats;
+
+// Every run of every timer is recorded in a log bucketed histogram, values are accurate to about 3%.
+// Unlike the averages these are not reset by setAggregateFrames, only by resetProfileHistograms
+void setProfileHistogramsEnabled(bool bEnable);
+
+void resetProfileHistograms();
+
+// Latency percentiles of a CPU or GPU timer, merged over all threads unless pThreadID is given
+bool getProfileLatencyStats(const char* pGroup, const char* pName, ThreadID* pThreadID, ProfileLatencyStats* pOutStats);
+
+// Latency percentiles of the whole CPU frame
+bool getProfileFrameLatencyStats(ProfileLatencyStats* pOutStats);
+
+// Dump the histograms of all timers to pFileName in the log directory, two dumps can be compared with the ProfileDiff tool
+bool dumpProfileHistograms(const char* pFileName);
+
 
 //------ Profiler UI Widget --------//
 
@@ -32,8 +32,45 @@
 #define FLIP_REDBLUE_CHANNEL false
 #endif
 
-void initScreenshotInterface(Renderer* pRenderer, Queue* pQueue);
+typedef enum ScreenshotFormat
+{
+	SCREENSHOT_FORMAT_PNG = 0,
+	// Fast lossless format (https://qoiformat.org), meant for frame sequences. 8 bit RGB(A) render targets only.
+	SCREENSHOT_FORMAT_QOI,
+	// Uncompressed TGA, the cheapest to write. 8 bit RGB(A) render targets only.
+	SCREENSHOT_FORMAT_TGA,
+} ScreenshotFormat;
+
+typedef struct ScreenshotCaptureDesc
+{
+	// Readback buffers used by captureScreenshotAsync. Capturing only blocks when all of them are waiting for the GPU or a worker. 0 uses 4.
+	uint32_t mRingSize;
+	// Threads encoding and writing the captures. 0 uses one per core, minus the calling thread.
+	uint32_t mWorkerCount;
+} ScreenshotCaptureDesc;
+
+typedef struct ScreenshotCaptureStats
+{
+	uint64_t mCapturedFrames;
+	uint64_t mWrittenFrames;
+	uint64_t mFailedFrames;
+	// Captures which had to wait for a readback buffer to become free
+	uint64_t mStalledFrames;
+} ScreenshotCaptureStats;
+
+// pCaptureDesc is only used by captureScreenshotAsync and can be NULL.
+void initScreenshotInterface(Renderer* pRenderer, Queue* pQueue, const ScreenshotCaptureDesc* pCaptureDesc = NULL);
 // Use one renderpass prior to calling captureScreenshot() to prepare pSwapChain for copy.
 bool prepareScreenshot(SwapChain* pSwapChain);
 void captureScreenshot(SwapChain* pSwapChain, uint32_t swapChainRtIndex, ResourceState renderTargetCurrentState, const char* pngFileName, bool flipRedBlueChannel = FLIP_REDBLUE_CHANNEL);
+// Queues a copy of the render target on the queue given to initScreenshotInterface without waiting for the GPU.
+// Call it after submitting the frame and before presenting it. The copy waits on pWaitSemaphore, and the returned
+// semaphore has to be waited on by queuePresent instead. Encoding and writing the file happen on worker threads.
+// Captures whose copy finished are handed to the workers on the next call, or by flushScreenshotCaptures.
+Semaphore* captureScreenshotAsync(
+	SwapChain* pSwapChain, uint32_t swapChainRtIndex, ResourceState renderTargetCurrentState, Semaphore* pWaitSemaphore,
+	const char* fileName, ScreenshotFormat format = SCREENSHOT_FORMAT_PNG, bool flipRedBlueChannel = FLIP_REDBLUE_CHANNEL);
+// Blocks until every capture queued so far is written.
+void flushScreenshotCaptures();
+void getScreenshotCaptureStats(ScreenshotCaptureStats* pOutStats);
 void exitScreenshotInterface();
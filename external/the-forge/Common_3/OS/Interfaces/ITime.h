@@ -29,6 +29,8 @@
 // High res timer functions
 int64_t getUSec();
 int64_t getTimerFrequency();
+// Monotonic nanosecond ticks, unaffected by wall clock changes. Only differences between two calls are meaningful.
+int64_t getNSec();
 
 // Time related functions
 uint32_t getSystemTime();
@@ -40,10 +42,11 @@ class Timer
 	public:
 	Timer();
 	uint32_t GetMSec(bool reset);
+	int64_t  GetNSec(bool reset);
 	void     Reset();
 
 	private:
-	uint32_t mStartTime;
+	int64_t mStartTime;
 };
 
 /// High-resolution OS timer
@@ -52,6 +55,7 @@ class HiresTimer
 	public:
 	HiresTimer();
 
+	int64_t GetNSec(bool reset);
 	int64_t GetUSec(bool reset);
 	int64_t GetUSecAverage();
 	float   GetSeconds(bool reset);
@@ -59,6 +63,7 @@ class HiresTimer
 	void    Reset();
 
 	private:
+	// Nanoseconds, the history too
 	int64_t mStartTime;
 
 	static const uint32_t LENGTH_OF_HISTORY = 60;
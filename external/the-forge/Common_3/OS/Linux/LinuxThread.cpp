@@ -23,8 +23,6 @@
 */
 #ifdef __linux__
 
-#include <sys/sysctl.h>
-
 #include "../Interfaces/IThread.h"
 #include "../Interfaces/IOperatingSystem.h"
 #include "../Interfaces/ILog.h"
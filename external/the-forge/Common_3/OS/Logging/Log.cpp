@@ -26,7 +26,9 @@
 #include "../Interfaces/ILog.h"
 #include "../Interfaces/IFileSystem.h"
 #include "../Interfaces/IOperatingSystem.h"
+#include "../Core/Atomics.h"
 #include "../../ThirdParty/OpenSource/EASTL/unordered_map.h"
+#include "../../ThirdParty/OpenSource/EASTL/vector.h"
 
 #include "../Interfaces/IMemory.h"
 
@@ -39,6 +41,102 @@ static Log* pLogger = NULL;
 thread_local char Log::Buffer[MAX_BUFFER + 2];
 bool Log::sConsoleLogging = true;
 
+/************************************************************************/
+// Asynchronous mode
+/************************************************************************/
+// Every logging thread owns a single producer / single consumer ring of LogRecords. A record holds the packed arguments,
+// a copy of the format string and the preamble data of one message. The log thread merges the records of all rings by
+// timestamp, formats them and writes the whole batch before it releases the ring space and flushes the outputs.
+// The format is copied since callers pass temporaries such as eastl::string::c_str(), which are gone by then.
+#define LOG_RING_SIZE (64 * 1024)
+#define LOG_RING_MASK (LOG_RING_SIZE - 1)
+// How many times an error waits for the log thread to make room in a full ring before it is dropped as well
+#define LOG_ERROR_RETRIES 64
+
+enum LogRecordFlags
+{
+	LOG_RECORD_PADDING = 1 << 0,
+	LOG_RECORD_RAW = 1 << 1,
+	LOG_RECORD_RAW_ERROR = 1 << 2,
+	// The arguments could not be packed, the payload is the message formatted by the calling thread
+	LOG_RECORD_FORMATTED = 1 << 3,
+};
+
+struct LogRecord
+{
+	uint32_t    mSize;
+	uint32_t    mFlags;
+	uint32_t    mLevel;
+	uint32_t    mIndentation;
+	int64_t     mTimestamp;
+	int64_t     mTime;
+	const char* pFile;
+	int32_t     mLine;
+	uint32_t    mPayloadSize;
+	// Start of the format string in the payload, behind the packed arguments
+	uint32_t    mFormatOffset;
+};
+
+struct LogRing
+{
+	// Written by the owning thread only
+	tfrg_atomic64_t mHead;
+	char            mPadHead[64 - sizeof(tfrg_atomic64_t)];
+	// Written by the log thread only
+	tfrg_atomic64_t mTail;
+	char            mPadTail[64 - sizeof(tfrg_atomic64_t)];
+	tfrg_atomic32_t mDropped;
+	// Cleared when the owning thread exits, the ring is handed to the next new thread once it is empty
+	tfrg_atomic32_t mOwned;
+	LogRing*        pNext;
+	char            mThreadName[MAX_THREAD_NAME_LENGTH + 1];
+	uint64_t        mData[LOG_RING_SIZE / sizeof(uint64_t)];
+};
+
+struct LogRingCursor
+{
+	LogRing* pRing;
+	uint64_t mPos;
+	uint64_t mEnd;
+};
+
+struct AsyncLog
+{
+	tfrg_atomicptr_t  pRings;
+	ThreadDesc        mThreadDesc;
+	ThreadHandle      mThread;
+	Mutex             mWakeMutex;
+	ConditionVariable mWakeCond;
+	tfrg_atomic32_t   mWakePending;
+	// Messages dropped by threads which exited before the drop was reported
+	tfrg_atomic32_t   mExitedDropped;
+	// Serializes draining between the log thread and Flush
+	Mutex             mDrainMutex;
+	eastl::vector<LogRingCursor> mCursors;
+	volatile bool     mRun;
+	volatile bool     mEnabled;
+};
+
+// Rings are given back by a thread_local destructor when their thread exits.
+// The generation keeps threads which outlive the logger from touching freed rings.
+static tfrg_atomic32_t gLogRingGeneration = 1;
+
+struct LogRingOwner
+{
+	~LogRingOwner()
+	{
+		if (pRing && mGeneration == tfrg_atomic32_load_relaxed(&gLogRingGeneration))
+			tfrg_atomic32_store_release(&pRing->mOwned, 0);
+	}
+
+	LogRing* pRing = NULL;
+	uint32_t mGeneration = 0;
+};
+
+static thread_local LogRingOwner gLogRingOwner;
+
+static void RemoveAsyncLog(AsyncLog* pAsync);
+
 eastl::string GetTimeStamp()
 {
 	time_t sysTime;
@@ -66,7 +164,9 @@ void log_write(void * user_data, const char* message)
     ASSERT(fh);
     
     fsWriteToStream(fh, message, strlen(message));
-    fsFlushStream(fh);
+    // The log thread flushes once per batch
+    if (!Log::IsAsync())
+        fsFlushStream(fh);
 }
 
 // Close callback
@@ -99,6 +199,12 @@ void Log::Init(const char* appName, LogLevel level /* = LogLevel::eALL */)
 
 void Log::Exit()
 {
+	SetAsync(false);
+	if (pLogger->pAsync)
+	{
+		RemoveAsyncLog(pLogger->pAsync);
+		pLogger->pAsync = NULL;
+	}
 	pLogger->mLogMutex.Destroy();
 	tf_delete(pLogger);
 	pLogger = NULL;
@@ -148,6 +254,7 @@ bool Log::IsQuiet()                 { return pLogger->mQuietMode; }
 bool Log::IsRecordingTimeStamp()    { return pLogger->mRecordTimestamp; }
 bool Log::IsRecordingFile()         { return pLogger->mRecordFile; }
 bool Log::IsRecordingThreadName()   { return pLogger->mRecordThreadName; }
+bool Log::IsAsync()                 { return pLogger && pLogger->pAsync && pLogger->pAsync->mEnabled; }
 
 void Log::AddFile(const char * filename, FileMode file_mode, LogLevel log_level)
 {
@@ -204,39 +311,36 @@ void Log::AddCallback(const char * id, uint32_t log_level, void * user_data, log
 
 typedef char LogStr[LOG_LEVEL_SIZE+1];
 
-void Log::Write(uint32_t level, const char * filename, int line_number, const char* message, ...)
+static eastl::pair<uint32_t, const char*> gLogLevelPrefixes[] =
 {
-	static eastl::pair<uint32_t, const char*> logLevelPrefixes[] =
-	{
-		eastl::pair<uint32_t, const char*>{ LogLevel::eWARNING, "WARN| " },
-		eastl::pair<uint32_t, const char*>{ LogLevel::eINFO, "INFO| " },
-		eastl::pair<uint32_t, const char*>{ LogLevel::eDEBUG, " DBG| " },
-		eastl::pair<uint32_t, const char*>{ LogLevel::eERROR, " ERR| " }
-	};
+	eastl::pair<uint32_t, const char*>{ LogLevel::eWARNING, "WARN| " },
+	eastl::pair<uint32_t, const char*>{ LogLevel::eINFO, "INFO| " },
+	eastl::pair<uint32_t, const char*>{ LogLevel::eDEBUG, " DBG| " },
+	eastl::pair<uint32_t, const char*>{ LogLevel::eERROR, " ERR| " }
+};
 
-	uint32_t log_levels[LEVELS_LOG];
-	uint32_t log_level_count = 0;
-
-	// Check flags
-	for (uint32_t i = 0; i < sizeof(logLevelPrefixes) / sizeof(logLevelPrefixes[0]); ++i)
+void Log::Write(uint32_t level, const char * filename, int line_number, const char* message, ...)
+{
+	va_list args;
+	va_start(args, message);
+	if (IsAsync())
 	{
-		eastl::pair<uint32_t, const char*>& it = logLevelPrefixes[i];
-		if (it.first & level)
-		{
-			log_levels[log_level_count] = i;
-			++log_level_count;
-		}
+		WriteAsync(level, false, false, filename, line_number, message, args);
+		va_end(args);
+		return;
 	}
 
-	uint32_t preable_end = WritePreamble(Buffer, LOG_PREAMBLE_SIZE, filename, line_number);
+	char thread_name[MAX_THREAD_NAME_LENGTH + 1] = { 0 };
+	if (pLogger->mRecordThreadName)
+		Thread::GetCurrentThreadName(thread_name, MAX_THREAD_NAME_LENGTH + 1);
+
+	uint32_t preable_end = WritePreamble(Buffer, LOG_PREAMBLE_SIZE, filename, line_number, time(NULL), thread_name);
 
 	// Prepare indentation
 	uint32_t indentation = pLogger->mIndentation * INDENTATION_SIZE_LOG;
 	memset(Buffer+preable_end, ' ', indentation);
 
 	uint32_t offset = preable_end + LOG_LEVEL_SIZE + indentation;
-	va_list args;
-	va_start(args, message);
 	offset += vsnprintf(Buffer + offset, MAX_BUFFER - offset, message, args);
 	va_end(args);
 
@@ -244,59 +348,117 @@ void Log::Write(uint32_t level, const char * filename, int line_number, const ch
 	Buffer[offset] = '\n';
 	Buffer[offset + 1] = 0;
 
+	Output(level, Buffer, preable_end);
+}
+
+void Log::WriteRaw(uint32_t level, bool error, const char* message, ...)
+{
+	va_list args;
+	va_start(args, message);
+	if (IsAsync())
+	{
+		WriteAsync(level, true, error, NULL, 0, message, args);
+		va_end(args);
+		return;
+	}
+
+	vsnprintf(Buffer, MAX_BUFFER, message, args);
+	va_end(args);
+
+	OutputRaw(level, error, Buffer);
+}
+
+// Prints the message in `buffer` once for each level flag, with the level prefix written after the preamble, and passes it to the callbacks
+void Log::Output(uint32_t level, char * buffer, uint32_t preamble_end)
+{
+	uint32_t log_levels[LEVELS_LOG];
+	uint32_t log_level_count = 0;
+
+	// Check flags
+	for (uint32_t i = 0; i < sizeof(gLogLevelPrefixes) / sizeof(gLogLevelPrefixes[0]); ++i)
+	{
+		eastl::pair<uint32_t, const char*>& it = gLogLevelPrefixes[i];
+		if (it.first & level)
+		{
+			log_levels[log_level_count] = i;
+			++log_level_count;
+		}
+	}
+
 	// Log for each flag
 	for (uint32_t i = 0; i < log_level_count; ++i)
 	{
-		strncpy(Buffer + preable_end, logLevelPrefixes[log_levels[i]].second, LOG_LEVEL_SIZE);
+		strncpy(buffer + preamble_end, gLogLevelPrefixes[log_levels[i]].second, LOG_LEVEL_SIZE);
 
 		if (sConsoleLogging)
 		{
 			if (pLogger->mQuietMode)
 			{
 				if (level & LogLevel::eERROR)
-					_PrintUnicode(Buffer, true);
+					_PrintUnicode(buffer, true);
 			}
 			else
 			{
-				_PrintUnicode(Buffer, level & LogLevel::eERROR);
+				_PrintUnicode(buffer, level & LogLevel::eERROR);
 			}
 		}
 
 		MutexLock lock{ pLogger->mLogMutex };
 		for (LogCallback & callback : pLogger->mCallbacks)
 		{
-			if (callback.mLevel & log_levels[i])
-				callback.mCallback(callback.mUserData, Buffer);
+			if (callback.mLevel & gLogLevelPrefixes[log_levels[i]].first)
+				callback.mCallback(callback.mUserData, buffer);
 		}
 	}
 }
 
-void Log::WriteRaw(uint32_t level, bool error, const char* message, ...)
+void Log::OutputRaw(uint32_t level, bool error, const char * buffer)
 {
-	va_list args;
-	va_start(args, message);
-	vsnprintf(Buffer, MAX_BUFFER, message, args);
-	va_end(args);
-
 	if (sConsoleLogging)
 	{
 		if (pLogger->mQuietMode)
 		{
 			if (error)
-				_PrintUnicode(Buffer, true);
+				_PrintUnicode(buffer, true);
 		}
 		else
-			_PrintUnicode(Buffer, error);
+			_PrintUnicode(buffer, error);
 	}
 
 	MutexLock lock{ pLogger->mLogMutex };
 	for (LogCallback & callback : pLogger->mCallbacks)
 	{
 		if (callback.mLevel & level)
-			callback.mCallback(callback.mUserData, Buffer);
+			callback.mCallback(callback.mUserData, buffer);
+	}
+}
+
+void Log::FlushCallbacks()
+{
+	MutexLock lock{ pLogger->mLogMutex };
+	for (LogCallback & callback : pLogger->mCallbacks)
+	{
+		if (callback.mFlush)
+			callback.mFlush(callback.mUserData);
 	}
 }
 
+void Log::Flush()
+{
+	if (!pLogger)
+		return;
+
+	if (IsAsync())
+	{
+		// Keep draining until the producers are quiet, but do not get stuck behind a thread that never stops logging
+		for (uint32_t i = 0; i < 16 && DrainAsync(); ++i)
+		{
+		}
+	}
+
+	FlushCallbacks();
+}
+
 void Log::AddInitialLogFile(const char* appName)
 {
 
@@ -318,13 +480,12 @@ void Log::AddInitialLogFile(const char* appName)
     AddFile(exeFileName, FM_WRITE_BINARY_ALLOW_READ, LogLevel::eALL);
 }
 
-uint32_t Log::WritePreamble(char * buffer, uint32_t buffer_size, const char * file, int line)
+uint32_t Log::WritePreamble(char * buffer, uint32_t buffer_size, const char * file, int line, time_t t, const char * thread_name)
 {
 	uint32_t pos = 0;
 	// Date and time
 	if (pLogger->mRecordTimestamp && pos < buffer_size)
 	{
-		time_t  t = time(NULL);
 		tm time_info;
 	#if defined(_WINDOWS) || defined(XBOX)
 		localtime_s(&time_info, &t);
@@ -343,8 +504,6 @@ uint32_t Log::WritePreamble(char * buffer, uint32_t buffer_size, const char * fi
 
 	if (pLogger->mRecordThreadName && pos < buffer_size)
 	{
-		char thread_name[MAX_THREAD_NAME_LENGTH + 1] = { 0 };
-		Thread::GetCurrentThreadName(thread_name, MAX_THREAD_NAME_LENGTH + 1);
 		pos += snprintf(buffer + pos, buffer_size - pos, "[%-15s]", thread_name[0] == 0 ? "NoName" : thread_name);
 	}
 
@@ -369,6 +528,632 @@ bool Log::CallbackExists(const char * id)
 	return false;
 }
 
+/************************************************************************/
+// Asynchronous mode implementation
+/************************************************************************/
+enum LogArgType
+{
+	LOG_ARG_INT,
+	LOG_ARG_LONG,
+	LOG_ARG_LONG_LONG,
+	LOG_ARG_SIZE,
+	LOG_ARG_INTMAX,
+	LOG_ARG_PTRDIFF,
+	LOG_ARG_DOUBLE,
+	LOG_ARG_LONG_DOUBLE,
+	LOG_ARG_POINTER,
+	LOG_ARG_STRING,
+	LOG_ARG_PERCENT,
+	LOG_ARG_UNSUPPORTED,
+};
+
+struct LogConversion
+{
+	const char* pEnd;
+	LogArgType  mType;
+	// '*' width and precision arguments in front of the value, the last one is the precision if mStarPrecision is set
+	uint32_t    mStarCount;
+	bool        mStarPrecision;
+	int         mPrecision;
+};
+
+// Parses the printf conversion starting at the '%' in `format`
+static LogConversion ParseLogConversion(const char* format)
+{
+	LogConversion conv = {};
+	conv.mPrecision = -1;
+	conv.mType = LOG_ARG_UNSUPPORTED;
+
+	const char* p = format + 1;
+	if (*p == '%')
+	{
+		conv.mType = LOG_ARG_PERCENT;
+		conv.pEnd = p + 1;
+		return conv;
+	}
+
+	while (*p && strchr("-+ #0'", *p))
+		++p;
+
+	if (*p == '*')
+	{
+		++conv.mStarCount;
+		++p;
+	}
+	else
+	{
+		while (*p >= '0' && *p <= '9')
+			++p;
+	}
+
+	if (*p == '.')
+	{
+		++p;
+		if (*p == '*')
+		{
+			++conv.mStarCount;
+			conv.mStarPrecision = true;
+			++p;
+		}
+		else
+		{
+			conv.mPrecision = 0;
+			while (*p >= '0' && *p <= '9')
+				conv.mPrecision = conv.mPrecision * 10 + (*p++ - '0');
+		}
+	}
+
+	char length = 0;
+	bool doubled = false;
+	if (*p && strchr("hlLjzt", *p))
+	{
+		length = *p++;
+		if ((length == 'h' || length == 'l') && *p == length)
+		{
+			doubled = true;
+			++p;
+		}
+	}
+
+	switch (*p)
+	{
+	case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+		switch (length)
+		{
+		case 'l': conv.mType = doubled ? LOG_ARG_LONG_LONG : LOG_ARG_LONG; break;
+		case 'j': conv.mType = LOG_ARG_INTMAX; break;
+		case 'z': conv.mType = LOG_ARG_SIZE; break;
+		case 't': conv.mType = LOG_ARG_PTRDIFF; break;
+		case 'L': break;
+		default: conv.mType = LOG_ARG_INT; break;
+		}
+		break;
+	case 'c':
+		// Wide characters are left to the calling thread
+		if (!length)
+			conv.mType = LOG_ARG_INT;
+		break;
+	case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+		conv.mType = length == 'L' ? LOG_ARG_LONG_DOUBLE : LOG_ARG_DOUBLE;
+		break;
+	case 's':
+		if (!length)
+			conv.mType = LOG_ARG_STRING;
+		break;
+	case 'p':
+		conv.mType = LOG_ARG_POINTER;
+		break;
+	default:
+		break;
+	}
+
+	conv.pEnd = *p ? p + 1 : p;
+	return conv;
+}
+
+#define LOG_PACK(value)                                  \
+	if (size + sizeof(value) > capacity) return false;   \
+	memcpy(pOut + size, &(value), sizeof(value));        \
+	size += sizeof(value)
+
+#define LOG_PACK_ARG(type)                               \
+	{                                                    \
+		type value = va_arg(args, type);                 \
+		LOG_PACK(value);                                 \
+		break;                                           \
+	}
+
+// Copies the arguments of `format` so the log thread can format the message later. Strings are copied since they may be gone by then.
+// Returns false if the format can not be deferred or the arguments do not fit, the message is then formatted right away.
+static bool PackLogArgs(const char* format, va_list args, uint8_t* pOut, uint32_t capacity, uint32_t* pOutSize)
+{
+	uint32_t size = 0;
+	for (const char* p = format; *p; ++p)
+	{
+		if (*p != '%')
+			continue;
+
+		LogConversion conv = ParseLogConversion(p);
+		if (LOG_ARG_UNSUPPORTED == conv.mType || conv.pEnd - p >= 32)
+			return false;
+
+		p = conv.pEnd - 1;
+		if (LOG_ARG_PERCENT == conv.mType)
+			continue;
+
+		int precision = conv.mPrecision;
+		for (uint32_t i = 0; i < conv.mStarCount; ++i)
+		{
+			int star = va_arg(args, int);
+			if (conv.mStarPrecision && i == conv.mStarCount - 1)
+				precision = star;
+			LOG_PACK(star);
+		}
+
+		switch (conv.mType)
+		{
+		case LOG_ARG_INT: LOG_PACK_ARG(int)
+		case LOG_ARG_LONG: LOG_PACK_ARG(long)
+		case LOG_ARG_LONG_LONG: LOG_PACK_ARG(long long)
+		case LOG_ARG_SIZE: LOG_PACK_ARG(size_t)
+		case LOG_ARG_INTMAX: LOG_PACK_ARG(intmax_t)
+		case LOG_ARG_PTRDIFF: LOG_PACK_ARG(ptrdiff_t)
+		case LOG_ARG_DOUBLE: LOG_PACK_ARG(double)
+		case LOG_ARG_LONG_DOUBLE: LOG_PACK_ARG(long double)
+		case LOG_ARG_POINTER: LOG_PACK_ARG(void*)
+		case LOG_ARG_STRING:
+		{
+			const char* str = va_arg(args, const char*);
+			// A precision may limit the read of strings which are not null terminated
+			uint32_t length = str ? (uint32_t)(precision >= 0 ? strnlen(str, (size_t)precision) : strlen(str)) : UINT32_MAX;
+			LOG_PACK(length);
+			if (str)
+			{
+				if (size + length + 1 > capacity)
+					return false;
+				memcpy(pOut + size, str, length);
+				pOut[size + length] = 0;
+				size += length + 1;
+			}
+			break;
+		}
+		default:
+			return false;
+		}
+	}
+
+	*pOutSize = size;
+	return true;
+}
+
+#undef LOG_PACK_ARG
+#undef LOG_PACK
+
+template <typename T>
+static int FormatLogArg(char* pOut, size_t size, const char* spec, uint32_t starCount, const int* stars, T value)
+{
+	switch (starCount)
+	{
+	case 0: return snprintf(pOut, size, spec, value);
+	case 1: return snprintf(pOut, size, spec, stars[0], value);
+	default: return snprintf(pOut, size, spec, stars[0], stars[1], value);
+	}
+}
+
+#define LOG_FORMAT_ARG(type)                                                               \
+	{                                                                                      \
+		type value;                                                                        \
+		memcpy(&value, pArgs, sizeof(value));                                              \
+		pArgs += sizeof(value);                                                            \
+		written = FormatLogArg(pOut + pos, capacity - pos, spec, conv.mStarCount, stars, value); \
+		break;                                                                             \
+	}
+
+// Formats a message from the arguments packed by PackLogArgs. Returns the length written to `pOut`.
+static uint32_t FormatLogArgs(const char* format, const uint8_t* pArgs, char* pOut, uint32_t capacity)
+{
+	uint32_t pos = 0;
+	const char* p = format;
+	while (*p && pos + 1 < capacity)
+	{
+		if (*p != '%')
+		{
+			pOut[pos++] = *p++;
+			continue;
+		}
+
+		LogConversion conv = ParseLogConversion(p);
+		if (LOG_ARG_PERCENT == conv.mType)
+		{
+			pOut[pos++] = '%';
+			p = conv.pEnd;
+			continue;
+		}
+
+		char spec[32];
+		memcpy(spec, p, conv.pEnd - p);
+		spec[conv.pEnd - p] = 0;
+		p = conv.pEnd;
+
+		int stars[2] = {};
+		for (uint32_t i = 0; i < conv.mStarCount; ++i)
+		{
+			memcpy(&stars[i], pArgs, sizeof(int));
+			pArgs += sizeof(int);
+		}
+
+		int written = 0;
+		switch (conv.mType)
+		{
+		case LOG_ARG_INT: LOG_FORMAT_ARG(int)
+		case LOG_ARG_LONG: LOG_FORMAT_ARG(long)
+		case LOG_ARG_LONG_LONG: LOG_FORMAT_ARG(long long)
+		case LOG_ARG_SIZE: LOG_FORMAT_ARG(size_t)
+		case LOG_ARG_INTMAX: LOG_FORMAT_ARG(intmax_t)
+		case LOG_ARG_PTRDIFF: LOG_FORMAT_ARG(ptrdiff_t)
+		case LOG_ARG_DOUBLE: LOG_FORMAT_ARG(double)
+		case LOG_ARG_LONG_DOUBLE: LOG_FORMAT_ARG(long double)
+		case LOG_ARG_POINTER: LOG_FORMAT_ARG(void*)
+		case LOG_ARG_STRING:
+		{
+			uint32_t length;
+			memcpy(&length, pArgs, sizeof(length));
+			pArgs += sizeof(length);
+			const char* str = NULL;
+			if (length != UINT32_MAX)
+			{
+				str = (const char*)pArgs;
+				pArgs += length + 1;
+			}
+			written = FormatLogArg(pOut + pos, capacity - pos, spec, conv.mStarCount, stars, str);
+			break;
+		}
+		default:
+			break;
+		}
+
+		if (written > 0)
+			pos += ((uint32_t)written < capacity - pos) ? (uint32_t)written : capacity - pos - 1;
+	}
+
+	pOut[pos] = 0;
+	return pos;
+}
+
+#undef LOG_FORMAT_ARG
+
+static void WakeAsyncLog(AsyncLog* pAsync)
+{
+	// Pairs with the barrier in the log thread between clearing mWakePending and looking at the rings
+	tfrg_memorybarrier_full();
+	if (!tfrg_atomic32_load_relaxed(&pAsync->mWakePending) && tfrg_atomic32_cas_relaxed(&pAsync->mWakePending, 0, 1) == 0)
+	{
+		pAsync->mWakeMutex.Acquire();
+		pAsync->mWakeMutex.Release();
+		pAsync->mWakeCond.WakeOne();
+	}
+}
+
+static LogRing* AcquireLogRing(AsyncLog* pAsync)
+{
+	uint32_t generation = tfrg_atomic32_load_relaxed(&gLogRingGeneration);
+	if (gLogRingOwner.pRing && gLogRingOwner.mGeneration == generation)
+		return gLogRingOwner.pRing;
+
+	// Take over the empty ring of a thread that exited
+	LogRing* pRing = NULL;
+	for (LogRing* pIt = (LogRing*)tfrg_atomicptr_load_acquire(&pAsync->pRings); pIt; pIt = pIt->pNext)
+	{
+		if (!tfrg_atomic32_load_relaxed(&pIt->mOwned) &&
+			tfrg_atomic64_load_acquire(&pIt->mTail) == tfrg_atomic64_load_relaxed(&pIt->mHead) &&
+			tfrg_atomic32_cas_relaxed(&pIt->mOwned, 0, 1) == 0)
+		{
+			// Drops the previous thread did not get reported for are not the new thread's
+			uint32_t dropped = (uint32_t)tfrg_atomic32_store_relaxed(&pIt->mDropped, 0);
+			if (dropped)
+				tfrg_atomic32_add_relaxed(&pAsync->mExitedDropped, dropped);
+			pRing = pIt;
+			break;
+		}
+	}
+
+	if (!pRing)
+	{
+		pRing = (LogRing*)tf_calloc(1, sizeof(LogRing));
+		pRing->mOwned = 1;
+		uintptr_t next;
+		do
+		{
+			next = tfrg_atomicptr_load_relaxed(&pAsync->pRings);
+			pRing->pNext = (LogRing*)next;
+		} while ((uintptr_t)tfrg_atomicptr_cas_relaxed(&pAsync->pRings, next, (uintptr_t)pRing) != next);
+	}
+
+	// Thread names are looked up once per ring, the lookup is too slow for every message
+	Thread::GetCurrentThreadName(pRing->mThreadName, MAX_THREAD_NAME_LENGTH + 1);
+	gLogRingOwner.pRing = pRing;
+	gLogRingOwner.mGeneration = generation;
+	return pRing;
+}
+
+void Log::WriteAsync(uint32_t level, bool raw, bool error, const char * filename, int line_number, const char * message, va_list args)
+{
+	AsyncLog* pAsync = pLogger->pAsync;
+	LogRing* pRing = AcquireLogRing(pAsync);
+
+	// Pack into the thread's buffer first, the record size is only known afterwards
+	uint8_t* payload = (uint8_t*)Buffer;
+	uint32_t payloadSize = 0;
+	uint32_t formatOffset = 0;
+	uint32_t flags = (raw ? LOG_RECORD_RAW : 0) | (error ? LOG_RECORD_RAW_ERROR : 0);
+
+	va_list packArgs;
+	va_copy(packArgs, args);
+	bool packed = PackLogArgs(message, packArgs, payload, MAX_BUFFER, &payloadSize);
+	va_end(packArgs);
+	if (packed)
+	{
+		const uint32_t formatSize = (uint32_t)strlen(message) + 1;
+		packed = payloadSize + formatSize <= MAX_BUFFER;
+		if (packed)
+		{
+			memcpy(payload + payloadSize, message, formatSize);
+			formatOffset = payloadSize;
+			payloadSize += formatSize;
+		}
+	}
+	if (!packed)
+	{
+		int length = vsnprintf(Buffer, MAX_BUFFER, message, args);
+		payloadSize = (length < 0 ? 0 : (length < MAX_BUFFER ? (uint32_t)length : MAX_BUFFER - 1)) + 1;
+		flags |= LOG_RECORD_FORMATTED;
+	}
+
+	const uint32_t recordSize = (uint32_t)((sizeof(LogRecord) + payloadSize + 7) & ~7);
+	const uint64_t head = tfrg_atomic64_load_relaxed(&pRing->mHead);
+	const uint32_t contiguous = LOG_RING_SIZE - (uint32_t)(head & LOG_RING_MASK);
+	// Records never wrap, the end of the ring is skipped with a padding record instead
+	const uint32_t padding = contiguous < recordSize ? contiguous : 0;
+
+	for (uint32_t attempt = 0; LOG_RING_SIZE - (head - tfrg_atomic64_load_acquire(&pRing->mTail)) < recordSize + padding; ++attempt)
+	{
+		// Bounded drop policy: only errors wait for the log thread to make room, and only for a while
+		WakeAsyncLog(pAsync);
+		if (!(level & LogLevel::eERROR) || attempt >= LOG_ERROR_RETRIES)
+		{
+			tfrg_atomic32_add_relaxed(&pRing->mDropped, 1);
+			return;
+		}
+		Thread::Sleep(0);
+	}
+
+	uint8_t* data = (uint8_t*)pRing->mData;
+	uint64_t pos = head;
+	if (padding)
+	{
+		LogRecord* pPadding = (LogRecord*)(data + (pos & LOG_RING_MASK));
+		pPadding->mSize = padding;
+		pPadding->mFlags = LOG_RECORD_PADDING;
+		pos += padding;
+	}
+
+	LogRecord* pRecord = (LogRecord*)(data + (pos & LOG_RING_MASK));
+	pRecord->mSize = recordSize;
+	pRecord->mFlags = flags;
+	pRecord->mLevel = level;
+	pRecord->mIndentation = raw ? 0 : pLogger->mIndentation;
+	pRecord->mTimestamp = getUSec();
+	pRecord->mTime = (int64_t)time(NULL);
+	pRecord->pFile = filename;
+	pRecord->mLine = line_number;
+	pRecord->mPayloadSize = payloadSize;
+	pRecord->mFormatOffset = formatOffset;
+	memcpy(pRecord + 1, payload, payloadSize);
+
+	tfrg_atomic64_store_release(&pRing->mHead, pos + recordSize);
+	WakeAsyncLog(pAsync);
+}
+
+// Formats and writes everything currently in the rings. Returns false if there was nothing to do.
+bool Log::DrainAsync()
+{
+	AsyncLog* pAsync = pLogger->pAsync;
+	MutexLock lock{ pAsync->mDrainMutex };
+
+	eastl::vector<LogRingCursor>& cursors = pAsync->mCursors;
+	cursors.clear();
+	bool processed = false;
+
+	for (LogRing* pRing = (LogRing*)tfrg_atomicptr_load_acquire(&pAsync->pRings); pRing; pRing = pRing->pNext)
+	{
+		LogRingCursor cursor = { pRing, tfrg_atomic64_load_relaxed(&pRing->mTail), tfrg_atomic64_load_acquire(&pRing->mHead) };
+		if (cursor.mPos != cursor.mEnd)
+			cursors.push_back(cursor);
+
+		uint32_t dropped = (uint32_t)tfrg_atomic32_store_relaxed(&pRing->mDropped, 0);
+		if (dropped)
+		{
+			uint32_t preamble_end = WritePreamble(Buffer, LOG_PREAMBLE_SIZE, __FILE__, __LINE__, time(NULL), pRing->mThreadName);
+			uint32_t offset = preamble_end + LOG_LEVEL_SIZE;
+			offset += snprintf(Buffer + offset, MAX_BUFFER - offset, "Dropped %u log messages, the log ring of this thread was full\n", dropped);
+			Output(LogLevel::eWARNING, Buffer, preamble_end);
+			processed = true;
+		}
+	}
+
+	uint32_t exitedDropped = (uint32_t)tfrg_atomic32_store_relaxed(&pAsync->mExitedDropped, 0);
+	if (exitedDropped)
+	{
+		uint32_t preamble_end = WritePreamble(Buffer, LOG_PREAMBLE_SIZE, __FILE__, __LINE__, time(NULL), "Log");
+		uint32_t offset = preamble_end + LOG_LEVEL_SIZE;
+		offset += snprintf(Buffer + offset, MAX_BUFFER - offset, "Dropped %u log messages of exited threads, their log rings were full\n", exitedDropped);
+		Output(LogLevel::eWARNING, Buffer, preamble_end);
+		processed = true;
+	}
+
+	// Merge the rings by timestamp, each ring is already in order
+	for (;;)
+	{
+		LogRingCursor* pNext = NULL;
+		const LogRecord* pNextRecord = NULL;
+		for (LogRingCursor& cursor : cursors)
+		{
+			const uint8_t* data = (const uint8_t*)cursor.pRing->mData;
+			const LogRecord* pRecord = NULL;
+			while (cursor.mPos != cursor.mEnd)
+			{
+				pRecord = (const LogRecord*)(data + (cursor.mPos & LOG_RING_MASK));
+				if (!(pRecord->mFlags & LOG_RECORD_PADDING))
+					break;
+				cursor.mPos += pRecord->mSize;
+				pRecord = NULL;
+			}
+
+			if (pRecord && (!pNextRecord || pRecord->mTimestamp < pNextRecord->mTimestamp))
+			{
+				pNext = &cursor;
+				pNextRecord = pRecord;
+			}
+		}
+
+		if (!pNext)
+			break;
+
+		const char* payload = (const char*)(pNextRecord + 1);
+		if (pNextRecord->mFlags & LOG_RECORD_RAW)
+		{
+			if (pNextRecord->mFlags & LOG_RECORD_FORMATTED)
+				strncpy(Buffer, payload, MAX_BUFFER);
+			else
+				FormatLogArgs(payload + pNextRecord->mFormatOffset, (const uint8_t*)payload, Buffer, MAX_BUFFER);
+			OutputRaw(pNextRecord->mLevel, (pNextRecord->mFlags & LOG_RECORD_RAW_ERROR) != 0, Buffer);
+		}
+		else
+		{
+			uint32_t preamble_end = WritePreamble(Buffer, LOG_PREAMBLE_SIZE, pNextRecord->pFile, pNextRecord->mLine, (time_t)pNextRecord->mTime, pNext->pRing->mThreadName);
+
+			uint32_t indentation = pNextRecord->mIndentation * INDENTATION_SIZE_LOG;
+			memset(Buffer + preamble_end, ' ', indentation);
+
+			uint32_t offset = preamble_end + LOG_LEVEL_SIZE + indentation;
+			if (pNextRecord->mFlags & LOG_RECORD_FORMATTED)
+			{
+				uint32_t length = pNextRecord->mPayloadSize - 1;
+				length = (length > MAX_BUFFER - offset) ? MAX_BUFFER - offset : length;
+				memcpy(Buffer + offset, payload, length);
+				offset += length;
+			}
+			else
+			{
+				offset += FormatLogArgs(payload + pNextRecord->mFormatOffset, (const uint8_t*)payload, Buffer + offset, MAX_BUFFER - offset);
+			}
+
+			offset = (offset > MAX_BUFFER) ? MAX_BUFFER : offset;
+			Buffer[offset] = '\n';
+			Buffer[offset + 1] = 0;
+
+			Output(pNextRecord->mLevel, Buffer, preamble_end);
+		}
+
+		pNext->mPos += pNextRecord->mSize;
+		processed = true;
+	}
+
+	if (processed)
+		FlushCallbacks();
+
+	// Only now the producers may overwrite the records
+	for (LogRingCursor& cursor : cursors)
+		tfrg_atomic64_store_release(&cursor.pRing->mTail, cursor.mEnd);
+
+	return processed;
+}
+
+void Log::AsyncThreadFunc(void * pData)
+{
+	AsyncLog* pAsync = (AsyncLog*)pData;
+	Thread::SetCurrentThreadName("Log");
+
+	while (pAsync->mRun)
+	{
+		tfrg_atomic32_store_relaxed(&pAsync->mWakePending, 0);
+		tfrg_memorybarrier_full();
+		if (DrainAsync())
+			continue;
+
+		pAsync->mWakeMutex.Acquire();
+		while (pAsync->mRun && !tfrg_atomic32_load_relaxed(&pAsync->mWakePending))
+			pAsync->mWakeCond.Wait(pAsync->mWakeMutex);
+		pAsync->mWakeMutex.Release();
+	}
+}
+
+void Log::SetAsync(bool bEnable)
+{
+#if defined(NX64)
+	// The log thread would need its own stack, keep logging synchronous
+	bEnable = false;
+#endif
+	if (!pLogger || bEnable == IsAsync())
+		return;
+
+	if (!pLogger->pAsync)
+	{
+		AsyncLog* pAsync = tf_new(AsyncLog);
+		pAsync->pRings = 0;
+		pAsync->mWakePending = 0;
+		pAsync->mExitedDropped = 0;
+		pAsync->mWakeMutex.Init();
+		pAsync->mWakeCond.Init();
+		pAsync->mDrainMutex.Init();
+		pAsync->mRun = false;
+		pAsync->mEnabled = false;
+		pLogger->pAsync = pAsync;
+	}
+
+	AsyncLog* pAsync = pLogger->pAsync;
+	if (bEnable)
+	{
+		pAsync->mRun = true;
+		pAsync->mThreadDesc.pFunc = AsyncThreadFunc;
+		pAsync->mThreadDesc.pData = pAsync;
+		pAsync->mThread = create_thread(&pAsync->mThreadDesc);
+		pAsync->mEnabled = true;
+	}
+	else
+	{
+		// New messages are written right away again, the log thread finishes what is already in the rings
+		pAsync->mEnabled = false;
+		pAsync->mRun = false;
+		pAsync->mWakeMutex.Acquire();
+		pAsync->mWakeMutex.Release();
+		pAsync->mWakeCond.WakeOne();
+		destroy_thread(pAsync->mThread);
+
+		while (DrainAsync())
+		{
+		}
+	}
+}
+
+static void RemoveAsyncLog(AsyncLog* pAsync)
+{
+	tfrg_atomic32_add_relaxed(&gLogRingGeneration, 1);
+
+	LogRing* pRing = (LogRing*)pAsync->pRings;
+	while (pRing)
+	{
+		LogRing* pNext = pRing->pNext;
+		tf_free(pRing);
+		pRing = pNext;
+	}
+
+	pAsync->mDrainMutex.Destroy();
+	pAsync->mWakeCond.Destroy();
+	pAsync->mWakeMutex.Destroy();
+	tf_delete(pAsync);
+}
+
 Log::Log(const char* appName, LogLevel level)
 	: mLogLevel(level)
 	, mIndentation(0)
@@ -376,6 +1161,7 @@ Log::Log(const char* appName, LogLevel level)
 	, mRecordTimestamp(true)
 	, mRecordFile(true)
 	, mRecordThreadName(true)
+	, pAsync(NULL)
 {
 	Thread::SetMainThread();
 	Thread::SetCurrentThreadName("MainThread");
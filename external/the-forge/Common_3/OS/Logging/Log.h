@@ -93,6 +93,10 @@ public:
 	static void SetRecordingFile(bool bEnable);
 	static void SetRecordingThreadName(bool bEnable);
 	static void SetConsoleLogging(bool bEnable);
+	/// In asynchronous mode Write and WriteRaw only pack their arguments into a lock-free ring owned by the calling thread.
+	/// A background thread formats the messages and writes them out in batches. Messages which find the ring full are dropped,
+	/// errors first wait a little for space, and the number of dropped messages is reported in the log.
+	static void SetAsync(bool bEnable);
 
 	static uint32_t        GetLevel();
 	static eastl::string   GetLastMessage();
@@ -100,6 +104,10 @@ public:
 	static bool            IsRecordingTimeStamp();
 	static bool            IsRecordingFile();
 	static bool            IsRecordingThreadName();
+	static bool            IsAsync();
+
+	/// Writes out every message logged so far and flushes all outputs. Called on exit and on failed asserts.
+	static void Flush();
 
 	static void AddFile(const char * filename, FileMode file_mode, LogLevel log_level);
 	static void AddCallback(const char * id, uint32_t log_level, void * user_data, log_callback_t callback, log_close_t close = nullptr, log_flush_t flush = nullptr);
@@ -109,8 +117,15 @@ public:
 
 private:
 	static void AddInitialLogFile(const char* appName);
-	static uint32_t WritePreamble(char * buffer, uint32_t buffer_size, const char * file, int line);
+	static uint32_t WritePreamble(char * buffer, uint32_t buffer_size, const char * file, int line, time_t time, const char * thread_name);
 	static bool CallbackExists(const char * id);
+	static void Output(uint32_t level, char * buffer, uint32_t preamble_end);
+	static void OutputRaw(uint32_t level, bool error, const char * buffer);
+	static void FlushCallbacks();
+
+	static void AsyncThreadFunc(void * pData);
+	static void WriteAsync(uint32_t level, bool raw, bool error, const char * filename, int line_number, const char * message, va_list args);
+	static bool DrainAsync();
 
 	// Singleton
 	Log(const Log &) = delete;
@@ -146,6 +161,8 @@ private:
 	bool            mRecordTimestamp;
 	bool            mRecordFile;
 	bool            mRecordThreadName;
+	/// Rings and background thread of the asynchronous mode, NULL until it is enabled for the first time.
+	struct AsyncLog* pAsync;
 
 	enum{MAX_BUFFER=1024};
 
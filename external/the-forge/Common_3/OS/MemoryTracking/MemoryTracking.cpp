@@ -27,10 +27,26 @@
 #endif
 
 #include "../../ThirdParty/OpenSource/EASTL/EABase/eabase.h"
+#include "../Interfaces/IThread.h"
+#include "../Core/Atomics.h"
 
 #include <stdlib.h>
 #include <memory.h>
 
+#if !defined(_WINDOWS) && !defined(XBOX) && !defined(NX64)
+#include <sys/mman.h>
+#endif
+
+#define IMEMORY_FROM_HEADER
+#include "../Interfaces/IMemory.h"
+// The functions below are the real implementations of these
+#undef tf_malloc
+#undef tf_memalign
+#undef tf_calloc
+#undef tf_calloc_memalign
+#undef tf_realloc
+#undef tf_free
+
 #define ALIGN_TO(size, alignment) (size + alignment - 1) & ~(alignment - 1)
 #define MIN_ALLOC_ALIGNMENT EA_PLATFORM_MIN_MALLOC_ALIGNMENT
 
@@ -106,20 +122,21 @@ void tf_free_internal(void* ptr, const char *f, int l, const char *sf)
 	mmgrDeallocator(f, l, sf, m_alloc_free, ptr);
 }
 
-#else // defined(USE_MEMORY_TRACKING) || defined(USE_MTUNER)
-
-bool MemAllocInit(const char* appName)
+bool MemAllocInit(const MemAllocDesc* pDesc)
 {
-	// No op but this is where you would initialize your memory allocator and bookkeeping data in a real world scenario
-	return true;
+	// mmgr has to see every allocation, the backend is ignored
+	return MemAllocInit(pDesc->pAppName);
 }
 
-void MemAllocExit()
+void MemAllocGetStats(MemAllocStats* pOutStats)
 {
-	// Return all allocated memory to the OS. Analyze memory usage, dump memory leaks, ...
+	memset(pOutStats, 0, sizeof(*pOutStats));
+	pOutStats->mBackend = MEM_ALLOC_BACKEND_SYSTEM;
 }
 
-void* tf_malloc(size_t size)
+#else // defined(USE_MEMORY_TRACKING) || defined(USE_MTUNER)
+
+static void* system_malloc(size_t size)
 {
 #ifdef _MSC_VER
 	void* ptr = _aligned_malloc(size, MIN_ALLOC_ALIGNMENT);
@@ -132,11 +149,11 @@ void* tf_malloc(size_t size)
 	return ptr;
 }
 
-void* tf_calloc(size_t count, size_t size)
+static void* system_calloc(size_t count, size_t size)
 {
 #ifdef _MSC_VER
 	size_t sz = count * size;
-	void* ptr = tf_malloc(sz);
+	void* ptr = system_malloc(sz);
 	memset(ptr, 0, sz);
 #else
 	void* ptr = calloc(count, size);
@@ -146,7 +163,7 @@ void* tf_calloc(size_t count, size_t size)
 	return ptr;
 }
 
-void* tf_memalign(size_t alignment, size_t size)
+static void* system_memalign(size_t alignment, size_t size)
 {
 #ifdef _MSC_VER
 	void* ptr = _aligned_malloc(size, alignment);
@@ -164,7 +181,7 @@ void* tf_memalign(size_t alignment, size_t size)
 	return ptr;
 }
 
-void* tf_calloc_memalign(size_t count, size_t alignment, size_t size)
+static void* system_calloc_memalign(size_t count, size_t alignment, size_t size)
 {
 	size_t alignedArrayElementSize = ALIGN_TO(size, alignment);
 	size_t totalBytes = count * alignedArrayElementSize;
@@ -185,7 +202,7 @@ void* tf_calloc_memalign(size_t count, size_t alignment, size_t size)
 	return ptr;
 }
 
-void* tf_realloc(void* ptr, size_t size)
+static void* system_realloc(void* ptr, size_t size)
 {
 #ifdef _MSC_VER
 	void* reallocPtr = _aligned_realloc(ptr, size, MIN_ALLOC_ALIGNMENT);
@@ -198,7 +215,7 @@ void* tf_realloc(void* ptr, size_t size)
 	return reallocPtr;
 }
 
-void tf_free(void* ptr)
+static void system_free(void* ptr)
 {
 	MTUNER_FREE(0, ptr);
 
@@ -209,16 +226,661 @@ void tf_free(void* ptr)
 #endif
 }
 
-void* tf_malloc_internal(size_t size, const char *f, int l, const char *sf) { return tf_malloc(size); }
+/************************************************************************/
+// Thread cache backend
+/************************************************************************/
+// Small allocations are carved from 64 KB spans inside one reserved address range, so tf_free can tell them apart from
+// C runtime allocations with a range check. Every span serves a single size class for its whole life.
+// Each thread keeps a free list per size class and trades batches of objects with the central free list of the class,
+// which is the only place a lock is taken. The reservation stays mapped until the process exits, frees coming from
+// static destructors after MemAllocExit are still valid.
+#define SLAB_SPAN_SHIFT 16
+#define SLAB_SPAN_SIZE (1ull << SLAB_SPAN_SHIFT)
+#define SLAB_COMMIT_SIZE (16 * SLAB_SPAN_SIZE)
+#define SLAB_DEFAULT_RESERVE_SIZE (4ull << 30)
+#define SLAB_MAX_BATCH_COUNT 64
+#define SLAB_MIN_BATCH_COUNT 4
+
+struct SlabFreeObject
+{
+	SlabFreeObject* pNext;
+};
+
+struct SlabSizeClass
+{
+	Mutex           mLock;
+	SlabFreeObject* pFreeList;
+	uint32_t        mFreeCount;
+	uint32_t        mSize;
+	uint32_t        mBatchCount;
+	tfrg_atomic64_t mLiveBytes;
+	tfrg_atomic64_t mPeakBytes;
+	tfrg_atomic64_t mAllocationCount;
+	// Central lists are locked from many threads, keep them on separate cache lines
+	char            mPadding[64];
+};
+
+struct SlabAllocator
+{
+	uint8_t*      pBase;
+	size_t        mReserveSize;
+	Mutex         mSpanLock;
+	size_t        mSpanTop;
+	size_t        mCommitted;
+	// Size class of every span in the reservation
+	uint8_t*      pSpanClasses;
+	SlabSizeClass mClasses[MEM_ALLOC_SIZE_CLASS_COUNT];
+};
+
+struct ThreadCacheList
+{
+	SlabFreeObject* pHead;
+	uint32_t        mCount;
+};
+
+struct ThreadCache
+{
+	~ThreadCache();
+
+	ThreadCacheList mLists[MEM_ALLOC_SIZE_CLASS_COUNT];
+	// Counters which have not been published to the size classes yet
+	int64_t         mLiveBytes[MEM_ALLOC_SIZE_CLASS_COUNT];
+	uint64_t        mAllocationCount[MEM_ALLOC_SIZE_CLASS_COUNT];
+	// Set once the thread is exiting, frees from later thread_local destructors go straight to the central lists
+	bool            mReleased;
+};
+
+static MemAllocBackend  gMemAllocBackend = MEM_ALLOC_BACKEND_SYSTEM;
+static SlabAllocator    gSlabAllocator = {};
+static thread_local ThreadCache gThreadCache;
+
+static void* reserveAddressSpace(size_t size)
+{
+#if defined(_WINDOWS) || defined(XBOX)
+	return VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+#elif defined(NX64)
+	return NULL;
+#else
+	void* ptr = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	return ptr == MAP_FAILED ? NULL : ptr;
+#endif
+}
+
+static bool commitAddressSpace(void* ptr, size_t size)
+{
+#if defined(_WINDOWS) || defined(XBOX)
+	return VirtualAlloc(ptr, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+#elif defined(NX64)
+	return false;
+#else
+	return mprotect(ptr, size, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
+static uint32_t log2Floor(uint64_t value)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanReverse64(&index, value);
+	return (uint32_t)index;
+#else
+	return 63 - (uint32_t)__builtin_clzll(value);
+#endif
+}
+
+// 16 byte steps up to 128, then 4 classes per power of two up to MEM_ALLOC_MAX_SMALL_SIZE
+static uint32_t slabSizeClass(size_t size)
+{
+	if (size <= 128)
+		return size ? (uint32_t)((size - 1) >> 4) : 0;
+
+	uint32_t shift = log2Floor(size - 1);
+	uint32_t step = (uint32_t)((size - 1) >> (shift - 2)) & 3;
+	return 8 + (shift - 7) * 4 + step;
+}
+
+static uint32_t slabClassSize(uint32_t sizeClass)
+{
+	if (sizeClass < 8)
+		return (sizeClass + 1) << 4;
+
+	uint32_t shift = 7 + (sizeClass - 8) / 4;
+	uint32_t step = (sizeClass - 8) % 4;
+	return (1u << shift) + ((step + 1) << (shift - 2));
+}
+
+static inline bool slabOwns(const void* ptr)
+{
+	return (uintptr_t)ptr - (uintptr_t)gSlabAllocator.pBase < gSlabAllocator.mReserveSize;
+}
+
+static inline uint32_t slabPtrSizeClass(const void* ptr)
+{
+	return gSlabAllocator.pSpanClasses[((uintptr_t)ptr - (uintptr_t)gSlabAllocator.pBase) >> SLAB_SPAN_SHIFT];
+}
+
+static bool slabInit(size_t reserveSize)
+{
+	reserveSize = reserveSize ? reserveSize : SLAB_DEFAULT_RESERVE_SIZE;
+	reserveSize = (reserveSize + SLAB_COMMIT_SIZE - 1) & ~(SLAB_COMMIT_SIZE - 1);
+
+	// Over-reserve so the first span can be aligned to the span size
+	uint8_t* pReserved = (uint8_t*)reserveAddressSpace(reserveSize + SLAB_SPAN_SIZE);
+	if (!pReserved)
+		return false;
+
+	SlabAllocator& slab = gSlabAllocator;
+	slab.pSpanClasses = (uint8_t*)system_calloc(reserveSize >> SLAB_SPAN_SHIFT, 1);
+	if (!slab.pSpanClasses)
+		return false;
+
+	slab.mSpanLock.Init();
+	slab.mSpanTop = 0;
+	slab.mCommitted = 0;
+	for (uint32_t i = 0; i < MEM_ALLOC_SIZE_CLASS_COUNT; ++i)
+	{
+		SlabSizeClass& sizeClass = slab.mClasses[i];
+		sizeClass.mLock.Init();
+		sizeClass.pFreeList = NULL;
+		sizeClass.mFreeCount = 0;
+		sizeClass.mSize = slabClassSize(i);
+		uint32_t batchCount = (uint32_t)(SLAB_SPAN_SIZE / sizeClass.mSize / 8);
+		sizeClass.mBatchCount = batchCount < SLAB_MIN_BATCH_COUNT ? SLAB_MIN_BATCH_COUNT : (batchCount > SLAB_MAX_BATCH_COUNT ? SLAB_MAX_BATCH_COUNT : batchCount);
+	}
+
+	slab.mReserveSize = reserveSize;
+	// Publishing the base enables slabOwns
+	tfrg_memorybarrier_full();
+	slab.pBase = (uint8_t*)(((uintptr_t)pReserved + SLAB_SPAN_SIZE - 1) & ~(uintptr_t)(SLAB_SPAN_SIZE - 1));
+	return true;
+}
+
+// Carves a new span into the central free list of the size class. Called with the size class locked.
+static bool slabAddSpan(uint32_t sizeClassIndex)
+{
+	SlabAllocator& slab = gSlabAllocator;
+	uint8_t* pSpan = NULL;
+	{
+		MutexLock lock(slab.mSpanLock);
+		if (slab.mSpanTop + SLAB_SPAN_SIZE > slab.mReserveSize)
+			return false;
+
+		if (slab.mSpanTop + SLAB_SPAN_SIZE > slab.mCommitted)
+		{
+			if (!commitAddressSpace(slab.pBase + slab.mCommitted, SLAB_COMMIT_SIZE))
+				return false;
+			slab.mCommitted += SLAB_COMMIT_SIZE;
+		}
+
+		slab.pSpanClasses[slab.mSpanTop >> SLAB_SPAN_SHIFT] = (uint8_t)sizeClassIndex;
+		pSpan = slab.pBase + slab.mSpanTop;
+		slab.mSpanTop += SLAB_SPAN_SIZE;
+	}
+
+	SlabSizeClass& sizeClass = slab.mClasses[sizeClassIndex];
+	const uint32_t count = (uint32_t)(SLAB_SPAN_SIZE / sizeClass.mSize);
+	for (uint32_t i = count; i > 0; --i)
+	{
+		SlabFreeObject* pObject = (SlabFreeObject*)(pSpan + (size_t)(i - 1) * sizeClass.mSize);
+		pObject->pNext = sizeClass.pFreeList;
+		sizeClass.pFreeList = pObject;
+	}
+	sizeClass.mFreeCount += count;
+	return true;
+}
+
+static void slabPublishStats(ThreadCache* pCache, uint32_t sizeClassIndex)
+{
+	SlabSizeClass& sizeClass = gSlabAllocator.mClasses[sizeClassIndex];
+	int64_t liveBytes = pCache->mLiveBytes[sizeClassIndex];
+	if (liveBytes)
+	{
+		uint64_t live = (uint64_t)tfrg_atomic64_add_relaxed(&sizeClass.mLiveBytes, liveBytes) + (uint64_t)liveBytes;
+		uint64_t peak = tfrg_atomic64_load_relaxed(&sizeClass.mPeakBytes);
+		while ((int64_t)live > (int64_t)peak)
+		{
+			uint64_t prev = (uint64_t)tfrg_atomic64_cas_relaxed(&sizeClass.mPeakBytes, peak, live);
+			if (prev == peak)
+				break;
+			peak = prev;
+		}
+		pCache->mLiveBytes[sizeClassIndex] = 0;
+	}
+
+	if (pCache->mAllocationCount[sizeClassIndex])
+	{
+		tfrg_atomic64_add_relaxed(&sizeClass.mAllocationCount, pCache->mAllocationCount[sizeClassIndex]);
+		pCache->mAllocationCount[sizeClassIndex] = 0;
+	}
+}
+
+static bool slabRefill(ThreadCache* pCache, uint32_t sizeClassIndex)
+{
+	SlabSizeClass& sizeClass = gSlabAllocator.mClasses[sizeClassIndex];
+	ThreadCacheList& list = pCache->mLists[sizeClassIndex];
+	{
+		MutexLock lock(sizeClass.mLock);
+		if (sizeClass.mFreeCount < sizeClass.mBatchCount && !slabAddSpan(sizeClassIndex) && !sizeClass.mFreeCount)
+			return false;
+
+		uint32_t count = sizeClass.mFreeCount < sizeClass.mBatchCount ? sizeClass.mFreeCount : sizeClass.mBatchCount;
+		SlabFreeObject* pFirst = sizeClass.pFreeList;
+		SlabFreeObject* pLast = pFirst;
+		for (uint32_t i = 1; i < count; ++i)
+			pLast = pLast->pNext;
+
+		sizeClass.pFreeList = pLast->pNext;
+		sizeClass.mFreeCount -= count;
+		pLast->pNext = list.pHead;
+		list.pHead = pFirst;
+		list.mCount += count;
+	}
+
+	slabPublishStats(pCache, sizeClassIndex);
+	return true;
+}
+
+// Gives `count` objects of the thread cache back to the central free list
+static void slabRelease(ThreadCache* pCache, uint32_t sizeClassIndex, uint32_t count)
+{
+	SlabSizeClass& sizeClass = gSlabAllocator.mClasses[sizeClassIndex];
+	ThreadCacheList& list = pCache->mLists[sizeClassIndex];
+	if (!count)
+		return;
+
+	SlabFreeObject* pFirst = list.pHead;
+	SlabFreeObject* pLast = pFirst;
+	for (uint32_t i = 1; i < count; ++i)
+		pLast = pLast->pNext;
+
+	list.pHead = pLast->pNext;
+	list.mCount -= count;
+	{
+		MutexLock lock(sizeClass.mLock);
+		pLast->pNext = sizeClass.pFreeList;
+		sizeClass.pFreeList = pFirst;
+		sizeClass.mFreeCount += count;
+	}
+
+	slabPublishStats(pCache, sizeClassIndex);
+}
+
+ThreadCache::~ThreadCache()
+{
+	if (!gSlabAllocator.pBase)
+		return;
+
+	for (uint32_t i = 0; i < MEM_ALLOC_SIZE_CLASS_COUNT; ++i)
+	{
+		slabRelease(this, i, mLists[i].mCount);
+		slabPublishStats(this, i);
+	}
+	mReleased = true;
+}
+
+static void* slab_memalign(size_t alignment, size_t size)
+{
+	// Power of two classes are aligned to their size since spans are aligned to SLAB_SPAN_SIZE
+	if (alignment > MIN_ALLOC_ALIGNMENT)
+	{
+		size = size > alignment ? size : alignment;
+		size = size > 1 ? 1ull << (log2Floor(size - 1) + 1) : 1;
+	}
+
+	if (size > MEM_ALLOC_MAX_SMALL_SIZE)
+		return system_memalign(alignment, size);
+
+	ThreadCache* pCache = &gThreadCache;
+	const uint32_t sizeClassIndex = slabSizeClass(size);
+	ThreadCacheList& list = pCache->mLists[sizeClassIndex];
+	if (!list.pHead && !slabRefill(pCache, sizeClassIndex))
+		return system_memalign(alignment, size);
+
+	SlabFreeObject* pObject = list.pHead;
+	list.pHead = pObject->pNext;
+	--list.mCount;
+
+	const SlabSizeClass& sizeClass = gSlabAllocator.mClasses[sizeClassIndex];
+	const uint32_t classSize = sizeClass.mSize;
+	pCache->mLiveBytes[sizeClassIndex] += classSize;
+	// Threads which keep reusing their cached objects never refill, publish the counters every batch anyway
+	if (++pCache->mAllocationCount[sizeClassIndex] >= sizeClass.mBatchCount)
+		slabPublishStats(pCache, sizeClassIndex);
+
+	MTUNER_ALIGNED_ALLOC(0, pObject, size, classSize - size, alignment);
+	return pObject;
+}
+
+static void slab_free(void* ptr)
+{
+	MTUNER_FREE(0, ptr);
+
+	ThreadCache* pCache = &gThreadCache;
+	const uint32_t sizeClassIndex = slabPtrSizeClass(ptr);
+	ThreadCacheList& list = pCache->mLists[sizeClassIndex];
+	SlabFreeObject* pObject = (SlabFreeObject*)ptr;
+	pObject->pNext = list.pHead;
+	list.pHead = pObject;
+	++list.mCount;
+
+	const SlabSizeClass& sizeClass = gSlabAllocator.mClasses[sizeClassIndex];
+	pCache->mLiveBytes[sizeClassIndex] -= sizeClass.mSize;
+	if (pCache->mReleased)
+		slabRelease(pCache, sizeClassIndex, list.mCount);
+	else if (list.mCount > 2 * sizeClass.mBatchCount)
+		slabRelease(pCache, sizeClassIndex, sizeClass.mBatchCount);
+	else if (pCache->mLiveBytes[sizeClassIndex] <= -(int64_t)sizeClass.mBatchCount * sizeClass.mSize)
+		slabPublishStats(pCache, sizeClassIndex);
+}
+
+static void* slab_realloc(void* ptr, size_t size)
+{
+	if (!ptr)
+		return slab_memalign(MIN_ALLOC_ALIGNMENT, size);
+
+	if (!slabOwns(ptr))
+		return system_realloc(ptr, size);
+
+	if (!size)
+	{
+		slab_free(ptr);
+		return NULL;
+	}
+
+	const uint32_t sizeClassIndex = slabPtrSizeClass(ptr);
+	const uint32_t classSize = gSlabAllocator.mClasses[sizeClassIndex].mSize;
+	if (size <= MEM_ALLOC_MAX_SMALL_SIZE && slabSizeClass(size) == sizeClassIndex)
+		return ptr;
+
+	void* pRealloc = slab_memalign(MIN_ALLOC_ALIGNMENT, size);
+	if (pRealloc)
+	{
+		memcpy(pRealloc, ptr, size < classSize ? size : classSize);
+		slab_free(ptr);
+	}
+	return pRealloc;
+}
+
+bool MemAllocInit(const MemAllocDesc* pDesc)
+{
+	gMemAllocBackend = MEM_ALLOC_BACKEND_SYSTEM;
+#if UINTPTR_MAX > UINT32_MAX
+	// Fall back to the C runtime when the address space can not be reserved
+	if (MEM_ALLOC_BACKEND_THREAD_CACHE == pDesc->mBackend && (gSlabAllocator.pBase || slabInit(pDesc->mReserveSize)))
+		gMemAllocBackend = MEM_ALLOC_BACKEND_THREAD_CACHE;
+#endif
+	return true;
+}
+
+bool MemAllocInit(const char* appName)
+{
+	MemAllocDesc desc = {};
+	desc.pAppName = appName;
+	desc.mBackend = MEM_ALLOC_BACKEND_SYSTEM;
+	return MemAllocInit(&desc);
+}
 
-void* tf_memalign_internal(size_t align, size_t size, const char *f, int l, const char *sf) { return tf_memalign(align, size); }
+void MemAllocExit()
+{
+	// Slab memory is not given back here, see the comment on the thread cache backend. Only publish the counters of this thread.
+	if (gSlabAllocator.pBase)
+	{
+		for (uint32_t i = 0; i < MEM_ALLOC_SIZE_CLASS_COUNT; ++i)
+			slabPublishStats(&gThreadCache, i);
+	}
+}
 
-void* tf_calloc_internal(size_t count, size_t size, const char *f, int l, const char *sf) { return tf_calloc(count, size); }
+void MemAllocGetStats(MemAllocStats* pOutStats)
+{
+	memset(pOutStats, 0, sizeof(*pOutStats));
+	pOutStats->mBackend = gMemAllocBackend;
+	if (!gSlabAllocator.pBase)
+		return;
 
-void* tf_calloc_memalign_internal(size_t count, size_t align, size_t size, const char *f, int l, const char *sf) { return tf_calloc_memalign(count, align, size); }
+	pOutStats->mSizeClassCount = MEM_ALLOC_SIZE_CLASS_COUNT;
+	for (uint32_t i = 0; i < MEM_ALLOC_SIZE_CLASS_COUNT; ++i)
+	{
+		SlabSizeClass& sizeClass = gSlabAllocator.mClasses[i];
+		MemAllocSizeClassStats& stats = pOutStats->mSizeClasses[i];
+		stats.mSize = sizeClass.mSize;
+		stats.mLiveBytes = tfrg_atomic64_load_relaxed(&sizeClass.mLiveBytes);
+		stats.mPeakBytes = tfrg_atomic64_load_relaxed(&sizeClass.mPeakBytes);
+		stats.mAllocationCount = tfrg_atomic64_load_relaxed(&sizeClass.mAllocationCount);
+	}
+}
 
-void* tf_realloc_internal(void* ptr, size_t size, const char *f, int l, const char *sf) { return tf_realloc(ptr, size); }
+void* tf_malloc_internal(size_t size, const char *f, int l, const char *sf)
+{
+	if (MEM_ALLOC_BACKEND_THREAD_CACHE == gMemAllocBackend)
+		return slab_memalign(MIN_ALLOC_ALIGNMENT, size);
+	return system_malloc(size);
+}
 
-void tf_free_internal(void* ptr, const char *f, int l, const char *sf) { tf_free(ptr); }
+void* tf_memalign_internal(size_t align, size_t size, const char *f, int l, const char *sf)
+{
+	if (MEM_ALLOC_BACKEND_THREAD_CACHE == gMemAllocBackend)
+		return slab_memalign(align, size);
+	return system_memalign(align, size);
+}
+
+void* tf_calloc_internal(size_t count, size_t size, const char *f, int l, const char *sf)
+{
+	if (MEM_ALLOC_BACKEND_THREAD_CACHE == gMemAllocBackend)
+	{
+		size_t totalBytes = count * size;
+		if (size && totalBytes / size != count)
+			return NULL;
+		void* ptr = slab_memalign(MIN_ALLOC_ALIGNMENT, totalBytes);
+		if (ptr)
+			memset(ptr, 0, totalBytes);
+		return ptr;
+	}
+	return system_calloc(count, size);
+}
+
+void* tf_calloc_memalign_internal(size_t count, size_t align, size_t size, const char *f, int l, const char *sf)
+{
+	if (MEM_ALLOC_BACKEND_THREAD_CACHE == gMemAllocBackend)
+	{
+		size_t totalBytes = count * (ALIGN_TO(size, align));
+		void* ptr = slab_memalign(align, totalBytes);
+		if (ptr)
+			memset(ptr, 0, totalBytes);
+		return ptr;
+	}
+	return system_calloc_memalign(count, align, size);
+}
+
+void* tf_realloc_internal(void* ptr, size_t size, const char *f, int l, const char *sf)
+{
+	if (MEM_ALLOC_BACKEND_THREAD_CACHE == gMemAllocBackend)
+		return slab_realloc(ptr, size);
+	// Blocks allocated before the backend was switched off still belong to the slabs
+	if (ptr && slabOwns(ptr))
+		return slab_realloc(ptr, size);
+	return system_realloc(ptr, size);
+}
+
+void tf_free_internal(void* ptr, const char *f, int l, const char *sf)
+{
+	if (ptr && slabOwns(ptr))
+		slab_free(ptr);
+	else
+		system_free(ptr);
+}
 
 #endif // defined(USE_MEMORY_TRACKING) || defined(USE_MTUNER)
+
+/************************************************************************/
+// Frame arenas
+/************************************************************************/
+#define FRAME_ARENA_BLOCK_ALIGNMENT 64
+#define FRAME_ARENA_DEFAULT_BLOCK_SIZE (1024 * 1024)
+
+struct FrameArenaBlock
+{
+	FrameArenaBlock* pNext;
+	uint8_t*         pData;
+	size_t           mSize;
+	tfrg_atomic64_t  mOffset;
+};
+
+struct FrameArena
+{
+	tfrg_atomicptr_t pCurrent;
+	FrameArenaBlock* pFirst;
+	size_t           mBlockSize;
+	uint64_t         mPeakBytes;
+	// Taken when frameArenaAlloc has to move on to the next block
+	Mutex            mGrowLock;
+};
+
+static FrameArenaBlock* addFrameArenaBlock(size_t size)
+{
+	const size_t headerSize = ALIGN_TO(sizeof(FrameArenaBlock), FRAME_ARENA_BLOCK_ALIGNMENT);
+	FrameArenaBlock* pBlock = (FrameArenaBlock*)tf_memalign_internal(FRAME_ARENA_BLOCK_ALIGNMENT, headerSize + size, __FILE__, __LINE__, __FUNCTION__);
+	if (!pBlock)
+		return NULL;
+
+	pBlock->pNext = NULL;
+	pBlock->pData = (uint8_t*)pBlock + headerSize;
+	pBlock->mSize = size;
+	pBlock->mOffset = 0;
+	return pBlock;
+}
+
+static uint64_t getFrameArenaLiveBytes(FrameArena* pArena)
+{
+	uint64_t liveBytes = 0;
+	FrameArenaBlock* pCurrent = (FrameArenaBlock*)tfrg_atomicptr_load_acquire(&pArena->pCurrent);
+	for (FrameArenaBlock* pBlock = pArena->pFirst; pBlock; pBlock = pBlock->pNext)
+	{
+		uint64_t offset = tfrg_atomic64_load_relaxed(&pBlock->mOffset);
+		liveBytes += offset < pBlock->mSize ? offset : pBlock->mSize;
+		if (pBlock == pCurrent)
+			break;
+	}
+	return liveBytes;
+}
+
+bool initFrameArena(size_t blockSize, FrameArena** ppArena)
+{
+	FrameArena* pArena = (FrameArena*)tf_calloc_internal(1, sizeof(FrameArena), __FILE__, __LINE__, __FUNCTION__);
+	if (!pArena)
+		return false;
+
+	pArena->mBlockSize = blockSize ? blockSize : FRAME_ARENA_DEFAULT_BLOCK_SIZE;
+	pArena->pFirst = addFrameArenaBlock(pArena->mBlockSize);
+	if (!pArena->pFirst)
+	{
+		tf_free_internal(pArena, __FILE__, __LINE__, __FUNCTION__);
+		return false;
+	}
+
+	pArena->pCurrent = (uintptr_t)pArena->pFirst;
+	pArena->mGrowLock.Init();
+	*ppArena = pArena;
+	return true;
+}
+
+void exitFrameArena(FrameArena* pArena)
+{
+	if (!pArena)
+		return;
+
+	FrameArenaBlock* pBlock = pArena->pFirst;
+	while (pBlock)
+	{
+		FrameArenaBlock* pNext = pBlock->pNext;
+		tf_free_internal(pBlock, __FILE__, __LINE__, __FUNCTION__);
+		pBlock = pNext;
+	}
+
+	pArena->mGrowLock.Destroy();
+	tf_free_internal(pArena, __FILE__, __LINE__, __FUNCTION__);
+}
+
+void* frameArenaAlloc(FrameArena* pArena, size_t size, size_t align)
+{
+	align = align ? align : MIN_ALLOC_ALIGNMENT;
+	for (;;)
+	{
+		FrameArenaBlock* pBlock = (FrameArenaBlock*)tfrg_atomicptr_load_acquire(&pArena->pCurrent);
+		uint64_t offset = tfrg_atomic64_load_relaxed(&pBlock->mOffset);
+		while (true)
+		{
+			uintptr_t address = ALIGN_TO((uintptr_t)pBlock->pData + offset, (uintptr_t)align);
+			uint64_t end = (uint64_t)(address - (uintptr_t)pBlock->pData) + size;
+			if (end > pBlock->mSize)
+				break;
+
+			uint64_t prev = (uint64_t)tfrg_atomic64_cas_relaxed(&pBlock->mOffset, offset, end);
+			if (prev == offset)
+				return (void*)address;
+			offset = prev;
+		}
+
+		// Move on to the next block, unless another thread already did
+		MutexLock lock(pArena->mGrowLock);
+		if ((FrameArenaBlock*)tfrg_atomicptr_load_relaxed(&pArena->pCurrent) != pBlock)
+			continue;
+
+		// Blocks stay chained after a reset until resetFrameArena merges them
+		FrameArenaBlock* pNext = pBlock->pNext;
+		if (!pNext || pNext->mSize < size + align)
+		{
+			size_t blockSize = pArena->mBlockSize > size + align ? pArena->mBlockSize : size + align;
+			FrameArenaBlock* pNew = addFrameArenaBlock(blockSize);
+			if (!pNew)
+				return NULL;
+			pNew->pNext = pNext;
+			pBlock->pNext = pNew;
+			pNext = pNew;
+		}
+
+		tfrg_atomic64_store_relaxed(&pNext->mOffset, 0);
+		tfrg_atomicptr_store_release(&pArena->pCurrent, (uintptr_t)pNext);
+	}
+}
+
+void resetFrameArena(FrameArena* pArena)
+{
+	uint64_t liveBytes = getFrameArenaLiveBytes(pArena);
+	pArena->mPeakBytes = liveBytes > pArena->mPeakBytes ? liveBytes : pArena->mPeakBytes;
+
+	if (pArena->pFirst->pNext && (FrameArenaBlock*)pArena->pCurrent != pArena->pFirst)
+	{
+		// The frame spilled into more blocks, replace them with one block big enough for all of it
+		size_t totalSize = 0;
+		for (FrameArenaBlock* pBlock = pArena->pFirst; pBlock; pBlock = pBlock->pNext)
+			totalSize += pBlock->mSize;
+
+		// Keep the chain if the merged block can not be allocated
+		FrameArenaBlock* pMerged = addFrameArenaBlock(totalSize);
+		if (pMerged)
+		{
+			FrameArenaBlock* pBlock = pArena->pFirst;
+			while (pBlock)
+			{
+				FrameArenaBlock* pNext = pBlock->pNext;
+				tf_free_internal(pBlock, __FILE__, __LINE__, __FUNCTION__);
+				pBlock = pNext;
+			}
+
+			pArena->mBlockSize = totalSize;
+			pArena->pFirst = pMerged;
+		}
+	}
+
+	pArena->pFirst->mOffset = 0;
+	pArena->pCurrent = (uintptr_t)pArena->pFirst;
+}
+
+void getFrameArenaStats(FrameArena* pArena, FrameArenaStats* pOutStats)
+{
+	pOutStats->mLiveBytes = getFrameArenaLiveBytes(pArena);
+	pOutStats->mPeakBytes = pOutStats->mLiveBytes > pArena->mPeakBytes ? pOutStats->mLiveBytes : pArena->mPeakBytes;
+	pOutStats->mReservedBytes = 0;
+	for (FrameArenaBlock* pBlock = pArena->pFirst; pBlock; pBlock = pBlock->pNext)
+		pOutStats->mReservedBytes += pBlock->mSize;
+}
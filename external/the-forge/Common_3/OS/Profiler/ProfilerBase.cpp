@@ -40,6 +40,12 @@ float getCpuAvgFrameTime() { return -1.0f; }
 float getCpuMinFrameTime() { return -1.0f; }
 float getCpuMaxFrameTime() { return -1.0f; }
 
+void setProfileHistogramsEnabled(bool bEnable) {}
+void resetProfileHistograms() {}
+bool getProfileLatencyStats(const char* pGroup, const char* pName, ThreadID* pThreadID, ProfileLatencyStats* pOutStats) { return false; }
+bool getProfileFrameLatencyStats(ProfileLatencyStats* pOutStats) { return false; }
+bool dumpProfileHistograms(const char* pFileName) { return false; }
+
 uint64_t cpuProfileEnter(ProfileToken nToken) { return 0; }
 void cpuProfileLeave(ProfileToken nToken, uint64_t nTick) {}
 ProfileToken getCpuProfileToken(const char* pGroup, const char* pName, uint32_t nColor) { return PROFILE_INVALID_TOKEN; }
@@ -238,6 +244,7 @@ void ProfileInit()
 			S.Graph[i].nToken = PROFILE_INVALID_TOKEN;
 		}
 		S.nRunning = 1;
+		S.nHistogramsEnabled = 1;
 		S.fReferenceTime = 33.33f;
 		S.fRcpReferenceTime = 1.f / S.fReferenceTime;
 		int64_t nTick = P_TICK();
@@ -290,6 +297,17 @@ void exitCpuProfiler()
 	ProfileWebServerStop();
 	ProfileContextSwitchTraceStop();
 
+	Profile & S = g_Profile;
+	for (uint32_t i = 0; i < PROFILE_MAX_TIMERS; ++i)
+	{
+		if (S.pHistograms[i])
+		{
+			tf_free(S.pHistograms[i]);
+			S.pHistograms[i] = NULL;
+			S.nMemUsage -= sizeof(uint64_t) * PROFILE_HISTOGRAM_BUCKETS;
+		}
+	}
+
     g_bOnce = true;
     g_bUseLock = false;
 }
@@ -297,6 +315,7 @@ void exitCpuProfiler()
 void exitProfiler()
 {
 #if PROFILE_ENABLED
+    stopProfileStream();
     exitCpuProfiler();
 
 #if GPU_PROFILER_SUPPORTED
@@ -347,6 +366,7 @@ PROFILE_API void ProfileRemoveThreadLog(ProfileThreadLog * pLog)
 		}
 		P_ASSERT(nLogIndex < PROFILE_MAX_THREADS);
 
+		ProfileStreamRemoveThreadLog(nLogIndex);
 		S.Pool[nLogIndex] = 0;
 
 		for (int i = 0; i < PROFILE_MAX_FRAME_HISTORY; ++i)
@@ -430,6 +450,7 @@ void ProfileOnThreadExit()
 		}
 		P_ASSERT(nLogIndex < PROFILE_MAX_THREADS);
 
+		ProfileStreamRemoveThreadLog(nLogIndex);
 		S.Pool[nLogIndex] = 0;
 
 		for (int i = 0; i < PROFILE_MAX_FRAME_HISTORY; ++i)
@@ -820,7 +841,7 @@ uint64_t ProfileAllocateLabel(const char* pName)
 			pLabelBuffer = static_cast<char *>(tf_malloc(PROFILE_LABEL_BUFFER_SIZE + PROFILE_LABEL_MAX_LEN));
 			memset(pLabelBuffer, 0, PROFILE_LABEL_BUFFER_SIZE + PROFILE_LABEL_MAX_LEN);
 			S.nMemUsage += PROFILE_LABEL_BUFFER_SIZE + PROFILE_LABEL_MAX_LEN;
-			tfrg_atomic64_store_release(&S.LabelBuffer, *pLabelBuffer);
+			tfrg_atomicptr_store_release(&S.LabelBuffer, (uintptr_t)pLabelBuffer);
 		}
 	}
 
@@ -1027,6 +1048,20 @@ void ProfileGetRange(uint32_t nPut, uint32_t nGet, uint32_t nRange[2][2])
 
 void ProfileDumpToFile(Renderer* pRenderer);
 
+static void ProfileHistogramAdd(uint32_t nTimerIndex, uint64_t nTicks)
+{
+	Profile & S = g_Profile;
+	uint64_t* pHistogram = S.pHistograms[nTimerIndex];
+	if (!pHistogram)
+	{
+		pHistogram = static_cast<uint64_t*>(tf_calloc(PROFILE_HISTOGRAM_BUCKETS, sizeof(uint64_t)));
+		S.pHistograms[nTimerIndex] = pHistogram;
+		S.nMemUsage += sizeof(uint64_t) * PROFILE_HISTOGRAM_BUCKETS;
+	}
+	pHistogram[profileHistogramBucket(nTicks)]++;
+	S.nHistogramCount[nTimerIndex]++;
+}
+
 void ProfileFlipCpu()
 {
     MutexLock lock(ProfileMutex());
@@ -1100,6 +1135,12 @@ void ProfileFlipCpu()
 			S.nFlipAggregate += nTick;
             S.nFlipMin = ProfileMin(S.nFlipMin, nTick);
 			S.nFlipMax = ProfileMax(S.nFlipMax, nTick);
+			// Slots of the frame history that were never written have no start time
+			if (S.nHistogramsEnabled && nFrameStartCpu && nFrameEndCpu > nFrameStartCpu)
+			{
+				S.FrameHistogram[profileHistogramBucket(nTick)]++;
+				S.nFrameHistogramCount++;
+			}
 		}
 
 		uint8_t* pTimerToGroup = &S.TimerToGroup[0];
@@ -1125,6 +1166,8 @@ void ProfileFlipCpu()
 			}
 		}
 
+		ProfileStreamFlip();
+
 		if (S.nRunning)
 		{
 			uint64_t* pFrameGroup = &S.FrameGroup[0];
@@ -1257,6 +1300,11 @@ void ProfileFlipCpu()
 									nStackPos--;
 									pChildTickStack[nStackPos] += nTicks;
 
+									if (S.nHistogramsEnabled && nTicks >= 0)
+									{
+										ProfileHistogramAdd((uint32_t)nTimer, (uint64_t)nTicks);
+									}
+
                                     if (!pLog->nGpu)
                                     {
 									    uint32_t nTimerIndex = (uint32_t)ProfileLogTimerIndex(LE);
@@ -1744,6 +1792,163 @@ float getCpuFrameTime()
     return fToMs * (S.nFlipTicks);
 }
 
+static uint64_t ProfileTimerTicksPerSecond(uint32_t nTimerIndex)
+{
+	Profile & S = g_Profile;
+	const ProfileGroupInfo& Group = S.GroupInfo[S.TimerInfo[nTimerIndex].nGroupIndex];
+	return Group.Type == ProfileTokenTypeGpu ? getGpuProfileTicksPerSecond(Group.nGpuProfileToken) : (uint64_t)ProfileTicksPerSecondCpu();
+}
+
+static void ProfileFillLatencyStats(const uint64_t* pCounts, uint64_t nCount, uint64_t nTicksPerSecond, ProfileLatencyStats* pOutStats)
+{
+	memset(pOutStats, 0, sizeof(*pOutStats));
+	pOutStats->mCount = nCount;
+	if (!nCount || !nTicksPerSecond)
+		return;
+
+	uint32_t nFirst = profileHistogramFindRank(pCounts, 0);
+	uint32_t nLast = profileHistogramFindRank(pCounts, nCount - 1);
+	double fToMs = 1000.0 / (double)nTicksPerSecond;
+	pOutStats->mMinMs = (float)(profileHistogramBucketStart(nFirst) * fToMs);
+	pOutStats->mP50Ms = (float)(profileHistogramPercentile(pCounts, nCount, 50.0) * fToMs);
+	pOutStats->mP95Ms = (float)(profileHistogramPercentile(pCounts, nCount, 95.0) * fToMs);
+	pOutStats->mP99Ms = (float)(profileHistogramPercentile(pCounts, nCount, 99.0) * fToMs);
+	pOutStats->mP999Ms = (float)(profileHistogramPercentile(pCounts, nCount, 99.9) * fToMs);
+	pOutStats->mMaxMs = (float)((profileHistogramBucketStart(nLast + 1) - 1) * fToMs);
+}
+
+// Sums the histograms of the timers with the same group and name as nTimerIndex, threads get a timer each
+static uint64_t ProfileMergeHistograms(uint32_t nTimerIndex, ThreadID* pThreadID, uint64_t* pOutCounts, bool* pMerged)
+{
+	Profile & S = g_Profile;
+	const ProfileTimerInfo& Timer = S.TimerInfo[nTimerIndex];
+	uint64_t nCount = 0;
+	memset(pOutCounts, 0, sizeof(uint64_t) * PROFILE_HISTOGRAM_BUCKETS);
+	for (uint32_t i = nTimerIndex; i < S.nTotalTimers; ++i)
+	{
+		const ProfileTimerInfo& Other = S.TimerInfo[i];
+		if (!S.pHistograms[i] || Other.nGroupIndex != Timer.nGroupIndex || strcmp(Other.pName, Timer.pName) ||
+			(pThreadID && Other.threadID != *pThreadID))
+		{
+			continue;
+		}
+		for (uint32_t j = 0; j < PROFILE_HISTOGRAM_BUCKETS; ++j)
+		{
+			pOutCounts[j] += S.pHistograms[i][j];
+		}
+		nCount += S.nHistogramCount[i];
+		if (pMerged)
+		{
+			pMerged[i] = true;
+		}
+	}
+	return nCount;
+}
+
+void setProfileHistogramsEnabled(bool bEnable)
+{
+	MutexLock lock(ProfileMutex());
+	Profile & S = g_Profile;
+	S.nHistogramsEnabled = bEnable ? 1 : 0;
+}
+
+void resetProfileHistograms()
+{
+	MutexLock lock(ProfileMutex());
+	Profile & S = g_Profile;
+	for (uint32_t i = 0; i < PROFILE_MAX_TIMERS; ++i)
+	{
+		if (S.pHistograms[i])
+		{
+			memset(S.pHistograms[i], 0, sizeof(uint64_t) * PROFILE_HISTOGRAM_BUCKETS);
+		}
+		S.nHistogramCount[i] = 0;
+	}
+	memset(S.FrameHistogram, 0, sizeof(S.FrameHistogram));
+	S.nFrameHistogramCount = 0;
+}
+
+bool getProfileLatencyStats(const char* pGroup, const char* pName, ThreadID* pThreadID, ProfileLatencyStats* pOutStats)
+{
+	MutexLock lock(ProfileMutex());
+	Profile & S = g_Profile;
+	for (uint32_t i = 0; i < S.nTotalTimers; ++i)
+	{
+		if (!S.pHistograms[i] || P_STRCASECMP(pName, S.TimerInfo[i].pName) || P_STRCASECMP(pGroup, S.GroupInfo[S.TimerInfo[i].nGroupIndex].pName))
+		{
+			continue;
+		}
+		uint64_t* pCounts = static_cast<uint64_t*>(tf_malloc(sizeof(uint64_t) * PROFILE_HISTOGRAM_BUCKETS));
+		uint64_t nCount = ProfileMergeHistograms(i, pThreadID, pCounts, NULL);
+		ProfileFillLatencyStats(pCounts, nCount, ProfileTimerTicksPerSecond(i), pOutStats);
+		tf_free(pCounts);
+		return nCount > 0;
+	}
+	memset(pOutStats, 0, sizeof(*pOutStats));
+	return false;
+}
+
+bool getProfileFrameLatencyStats(ProfileLatencyStats* pOutStats)
+{
+	MutexLock lock(ProfileMutex());
+	Profile & S = g_Profile;
+	ProfileFillLatencyStats(S.FrameHistogram, S.nFrameHistogramCount, (uint64_t)ProfileTicksPerSecondCpu(), pOutStats);
+	return S.nFrameHistogramCount > 0;
+}
+
+static void ProfileWriteHistogram(FileStream* pFile, const char* pKind, const char* pGroup, const char* pName, uint64_t nTicksPerSecond, const uint64_t* pCounts, uint64_t nCount)
+{
+	char Buffer[256];
+	int nLen = snprintf(Buffer, sizeof(Buffer), "%s\t%s\t%s\t%llu\t%llu", pKind, pGroup, pName, (unsigned long long)nTicksPerSecond, (unsigned long long)nCount);
+	fsWriteToStream(pFile, Buffer, ProfileMin(nLen, (int)sizeof(Buffer) - 1));
+	for (uint32_t i = 0; i < PROFILE_HISTOGRAM_BUCKETS; ++i)
+	{
+		if (pCounts[i])
+		{
+			nLen = snprintf(Buffer, sizeof(Buffer), "\t%u:%llu", i, (unsigned long long)pCounts[i]);
+			fsWriteToStream(pFile, Buffer, nLen);
+		}
+	}
+	fsWriteToStream(pFile, "\n", 1);
+}
+
+bool dumpProfileHistograms(const char* pFileName)
+{
+	FileStream fh = {};
+	if (!fsOpenStreamFromPath(RD_LOG, pFileName, FM_WRITE, &fh))
+	{
+		LOGF(eERROR, "Failed to open %s for writing", pFileName);
+		return false;
+	}
+
+	MutexLock lock(ProfileMutex());
+	Profile & S = g_Profile;
+
+	// One line per histogram: kind, group, name, ticks per second, sample count, then bucket:count for every bucket in use
+	char Header[64];
+	int nLen = snprintf(Header, sizeof(Header), "TFPH\t%u\t%u\n", (uint32_t)PROFILE_HISTOGRAM_SUB_BUCKET_BITS, (uint32_t)PROFILE_HISTOGRAM_VALUE_BITS);
+	fsWriteToStream(&fh, Header, nLen);
+	ProfileWriteHistogram(&fh, "frame", "Frame", "Frame", (uint64_t)ProfileTicksPerSecondCpu(), S.FrameHistogram, S.nFrameHistogramCount);
+
+	uint64_t* pCounts = static_cast<uint64_t*>(tf_malloc(sizeof(uint64_t) * PROFILE_HISTOGRAM_BUCKETS));
+	bool* pMerged = static_cast<bool*>(tf_calloc(PROFILE_MAX_TIMERS, sizeof(bool)));
+	for (uint32_t i = 0; i < S.nTotalTimers; ++i)
+	{
+		if (!S.pHistograms[i] || pMerged[i])
+		{
+			continue;
+		}
+		uint64_t nCount = ProfileMergeHistograms(i, NULL, pCounts, pMerged);
+		const ProfileTimerInfo& Timer = S.TimerInfo[i];
+		ProfileWriteHistogram(&fh, "timer", S.GroupInfo[Timer.nGroupIndex].pName, Timer.pName, ProfileTimerTicksPerSecond(i), pCounts, nCount);
+	}
+	tf_free(pMerged);
+	tf_free(pCounts);
+
+	fsCloseStream(&fh);
+	return true;
+}
+
 
 int ProfileFormatCounter(int eFormat, int64_t nCounter, char* pOut, uint32_t nBufferSize)
 {
@@ -130,6 +130,7 @@
 
 #include "../Interfaces/IThread.h"
 #include "../Core/Atomics.h"
+#include "ProfilerHistogram.h"
 #ifndef PROFILE_API
 #define PROFILE_API
 #endif
@@ -385,6 +386,9 @@ PROFILE_API void ProfileGetRange(uint32_t nPut, uint32_t nGet, uint32_t nRange[2
 PROFILE_API Mutex& ProfileGetMutex();
 PROFILE_API struct ProfileThreadLog* ProfileCreateThreadLog(const char* pName);
 PROFILE_API void ProfileRemoveThreadLog(struct ProfileThreadLog * pLog);
+// Called with the profiler mutex held, see ProfilerStream.cpp
+PROFILE_API void ProfileStreamFlip();
+PROFILE_API void ProfileStreamRemoveThreadLog(uint32_t nLogIndex);
 
 PROFILE_API void ProfileContextSwitchTraceStart();
 PROFILE_API void ProfileContextSwitchTraceStop();
@@ -832,6 +836,13 @@ struct Profile
 	int64_t 					nCounterMax[PROFILE_MAX_COUNTERS];
 	int64_t 					nCounterMin[PROFILE_MAX_COUNTERS];
 #endif
+
+	// Latency of every run of a timer since the last reset, allocated on the first run
+	int							nHistogramsEnabled;
+	uint64_t*					pHistograms[PROFILE_MAX_TIMERS];
+	uint64_t					nHistogramCount[PROFILE_MAX_TIMERS];
+	uint64_t					FrameHistogram[PROFILE_HISTOGRAM_BUCKETS];
+	uint64_t					nFrameHistogramCount;
 };
 
 #define P_LOG_TICK_MASK  0x0000ffffffffffff
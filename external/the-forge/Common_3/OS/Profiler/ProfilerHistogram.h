@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+#pragma once
+
+// Log bucketed latency histogram, shared by the profiler and the ProfileDiff tool so this header has no other dependency.
+// Values below PROFILE_HISTOGRAM_SUB_BUCKETS get a bucket each, above that every power of two is split in
+// PROFILE_HISTOGRAM_SUB_BUCKETS buckets, so a bucket is never wider than about 3% of the values it holds.
+
+#include <stdint.h>
+
+#define PROFILE_HISTOGRAM_SUB_BUCKET_BITS 5
+#define PROFILE_HISTOGRAM_SUB_BUCKETS (1u << PROFILE_HISTOGRAM_SUB_BUCKET_BITS)
+// Profiler log ticks are 48 bits
+#define PROFILE_HISTOGRAM_VALUE_BITS 48
+#define PROFILE_HISTOGRAM_BUCKETS ((PROFILE_HISTOGRAM_VALUE_BITS - PROFILE_HISTOGRAM_SUB_BUCKET_BITS + 1) * PROFILE_HISTOGRAM_SUB_BUCKETS)
+
+static inline uint32_t profileHistogramBucket(uint64_t value)
+{
+	if (value < PROFILE_HISTOGRAM_SUB_BUCKETS)
+		return (uint32_t)value;
+	if (value >> PROFILE_HISTOGRAM_VALUE_BITS)
+		return PROFILE_HISTOGRAM_BUCKETS - 1;
+#if defined(_MSC_VER)
+	unsigned long msb;
+	_BitScanReverse64(&msb, value);
+#else
+	uint32_t msb = 63 - (uint32_t)__builtin_clzll(value);
+#endif
+	uint32_t shift = (uint32_t)msb - PROFILE_HISTOGRAM_SUB_BUCKET_BITS;
+	return (shift + 1) * PROFILE_HISTOGRAM_SUB_BUCKETS + (uint32_t)((value >> shift) - PROFILE_HISTOGRAM_SUB_BUCKETS);
+}
+
+// Smallest value that falls in the bucket. Passing PROFILE_HISTOGRAM_BUCKETS returns the end of the last bucket.
+static inline uint64_t profileHistogramBucketStart(uint32_t bucket)
+{
+	if (bucket < PROFILE_HISTOGRAM_SUB_BUCKETS)
+		return bucket;
+	uint32_t shift = bucket / PROFILE_HISTOGRAM_SUB_BUCKETS - 1;
+	return (uint64_t)(PROFILE_HISTOGRAM_SUB_BUCKETS + bucket % PROFILE_HISTOGRAM_SUB_BUCKETS) << shift;
+}
+
+static inline double profileHistogramBucketMid(uint32_t bucket)
+{
+	return 0.5 * (double)(profileHistogramBucketStart(bucket) + profileHistogramBucketStart(bucket + 1) - 1);
+}
+
+// Bucket holding the sample of the given zero based rank
+static inline uint32_t profileHistogramFindRank(const uint64_t* pCounts, uint64_t rank)
+{
+	uint64_t seen = 0;
+	for (uint32_t i = 0; i < PROFILE_HISTOGRAM_BUCKETS; ++i)
+	{
+		seen += pCounts[i];
+		if (seen > rank)
+			return i;
+	}
+	return PROFILE_HISTOGRAM_BUCKETS - 1;
+}
+
+// Zero based rank of a percentile in [0, 100] (nearest rank method)
+static inline uint64_t profileHistogramPercentileRank(uint64_t count, double percentile)
+{
+	if (!count)
+		return 0;
+	double rank = percentile / 100.0 * (double)count;
+	uint64_t nearest = (uint64_t)rank;
+	if ((double)nearest < rank)
+		++nearest;
+	return nearest ? (nearest > count ? count - 1 : nearest - 1) : 0;
+}
+
+// Value of a percentile in [0, 100], in the unit of the recorded values
+static inline double profileHistogramPercentile(const uint64_t* pCounts, uint64_t count, double percentile)
+{
+	if (!count)
+		return 0.0;
+	return profileHistogramBucketMid(profileHistogramFindRank(pCounts, profileHistogramPercentileRank(count, percentile)));
+}
@@ -0,0 +1,1046 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Continuous capture of the profiler logs.
+//
+// ProfileFlip hands every entry written since the previous flip to ProfileStreamFlip, which encodes them into a chunk
+// while the profiler mutex is held. The ring buffers are reused every flip, so the capture length is only limited by disk space.
+// A writer thread appends the chunks to the stream file; when it falls behind by more than PROFILE_STREAM_MAX_PENDING_BYTES
+// whole frames are dropped instead of stalling the application.
+//
+// Stream layout, all integers little endian:
+//   header  : u32 magic "TFPS", u32 version, u64 cpu ticks per second
+//   record  : u8 type, u32 payload size, payload
+//
+//   TIMER   : varint timer index, u8 gpu, u32 color, string group, string name
+//   COUNTER : varint counter index, string full name ("parent/child")
+//   THREAD  : varint stream thread id, u8 gpu, u64 os thread id, string name
+//   FRAME   : varint frame index, u64 frame start tick,
+//             varint counter count, zigzag counter delta per counter,
+//             u32 block count, blocks
+//   block   : varint stream thread id, varint entry count, u64 cpu base tick,
+//             gpu threads only: u64 gpu base tick, varint gpu ticks per second
+//             entries
+//   entry   : varint (log type | timer index << 3), then
+//             ENTER/LEAVE : zigzag tick delta to the previous scope entry, the first one to the base tick
+//             LABEL       : string
+//             others      : varint raw payload
+//   string  : varint length, bytes
+//
+// Stream thread ids are never reused, so a slot of the thread pool that is recycled within a frame still maps to the right name.
+
+#include "ProfilerBase.h"
+
+#include "../../ThirdParty/OpenSource/EASTL/vector.h"
+#include "../../ThirdParty/OpenSource/EASTL/string.h"
+
+#include "../Interfaces/IFileSystem.h"
+#include "../Interfaces/ILog.h"
+#include "../Interfaces/IMemory.h"
+
+#define PROFILE_STREAM_MAGIC 0x53504654u // "TFPS"
+#define PROFILE_STREAM_VERSION 1u
+#define PROFILE_STREAM_MAX_PENDING_BYTES (64u << 20)
+
+enum ProfileStreamRecordType
+{
+	PROFILE_STREAM_RECORD_TIMER = 1,
+	PROFILE_STREAM_RECORD_COUNTER,
+	PROFILE_STREAM_RECORD_THREAD,
+	PROFILE_STREAM_RECORD_FRAME,
+};
+
+// Log entry types as stored in the stream, the converter is compiled without the profiler
+enum ProfileStreamLogType
+{
+	PROFILE_STREAM_LOG_LEAVE = 0,
+	PROFILE_STREAM_LOG_ENTER = 1,
+	PROFILE_STREAM_LOG_LABEL = 3,
+	PROFILE_STREAM_LOG_LABEL_LITERAL = 5,
+};
+
+/************************************************************************/
+// Encoding
+/************************************************************************/
+typedef struct ProfileStreamBuffer
+{
+	uint8_t* pData;
+	size_t   mSize;
+	size_t   mCapacity;
+} ProfileStreamBuffer;
+
+static void streamReserve(ProfileStreamBuffer* pBuffer, size_t extra)
+{
+	if (pBuffer->mSize + extra <= pBuffer->mCapacity)
+		return;
+	size_t capacity = pBuffer->mCapacity ? pBuffer->mCapacity : 64 * 1024;
+	while (capacity < pBuffer->mSize + extra)
+		capacity *= 2;
+	pBuffer->pData = (uint8_t*)tf_realloc(pBuffer->pData, capacity);
+	pBuffer->mCapacity = capacity;
+}
+
+static void streamFreeBuffer(ProfileStreamBuffer* pBuffer)
+{
+	tf_free(pBuffer->pData);
+	memset(pBuffer, 0, sizeof(*pBuffer));
+}
+
+static void streamWriteBytes(ProfileStreamBuffer* pBuffer, const void* pData, size_t size)
+{
+	if (!size)
+		return;
+	streamReserve(pBuffer, size);
+	memcpy(pBuffer->pData + pBuffer->mSize, pData, size);
+	pBuffer->mSize += size;
+}
+
+static void streamWriteU8(ProfileStreamBuffer* pBuffer, uint8_t value) { streamWriteBytes(pBuffer, &value, sizeof(value)); }
+static void streamWriteU32(ProfileStreamBuffer* pBuffer, uint32_t value) { streamWriteBytes(pBuffer, &value, sizeof(value)); }
+static void streamWriteU64(ProfileStreamBuffer* pBuffer, uint64_t value) { streamWriteBytes(pBuffer, &value, sizeof(value)); }
+
+static void streamWriteVarint(ProfileStreamBuffer* pBuffer, uint64_t value)
+{
+	streamReserve(pBuffer, 10);
+	uint8_t* pDst = pBuffer->pData + pBuffer->mSize;
+	while (value >= 0x80)
+	{
+		*pDst++ = (uint8_t)(value | 0x80);
+		value >>= 7;
+	}
+	*pDst++ = (uint8_t)value;
+	pBuffer->mSize = pDst - pBuffer->pData;
+}
+
+static void streamWriteZigzag(ProfileStreamBuffer* pBuffer, int64_t value)
+{
+	streamWriteVarint(pBuffer, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+static void streamWriteString(ProfileStreamBuffer* pBuffer, const char* pString)
+{
+	size_t length = pString ? strlen(pString) : 0;
+	streamWriteVarint(pBuffer, length);
+	streamWriteBytes(pBuffer, pString, length);
+}
+
+static size_t streamBeginRecord(ProfileStreamBuffer* pBuffer, ProfileStreamRecordType type)
+{
+	streamWriteU8(pBuffer, (uint8_t)type);
+	size_t sizeOffset = pBuffer->mSize;
+	streamWriteU32(pBuffer, 0);
+	return sizeOffset;
+}
+
+static void streamEndRecord(ProfileStreamBuffer* pBuffer, size_t sizeOffset)
+{
+	uint32_t size = (uint32_t)(pBuffer->mSize - sizeOffset - sizeof(uint32_t));
+	memcpy(pBuffer->pData + sizeOffset, &size, sizeof(size));
+}
+
+/************************************************************************/
+// Decoding
+/************************************************************************/
+typedef struct ProfileStreamReader
+{
+	const uint8_t* pCur;
+	const uint8_t* pEnd;
+	bool           mError;
+} ProfileStreamReader;
+
+static uint64_t streamReadVarint(ProfileStreamReader* pReader)
+{
+	uint64_t value = 0;
+	for (uint32_t shift = 0; shift < 64; shift += 7)
+	{
+		if (pReader->pCur >= pReader->pEnd)
+			break;
+		uint8_t byte = *pReader->pCur++;
+		value |= (uint64_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return value;
+	}
+	pReader->mError = true;
+	return 0;
+}
+
+static int64_t streamReadZigzag(ProfileStreamReader* pReader)
+{
+	uint64_t value = streamReadVarint(pReader);
+	return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static void streamReadBytes(ProfileStreamReader* pReader, void* pDst, size_t size)
+{
+	if ((size_t)(pReader->pEnd - pReader->pCur) < size)
+	{
+		pReader->mError = true;
+		memset(pDst, 0, size);
+		return;
+	}
+	memcpy(pDst, pReader->pCur, size);
+	pReader->pCur += size;
+}
+
+static uint8_t streamReadU8(ProfileStreamReader* pReader)
+{
+	uint8_t value;
+	streamReadBytes(pReader, &value, sizeof(value));
+	return value;
+}
+
+static uint32_t streamReadU32(ProfileStreamReader* pReader)
+{
+	uint32_t value;
+	streamReadBytes(pReader, &value, sizeof(value));
+	return value;
+}
+
+static uint64_t streamReadU64(ProfileStreamReader* pReader)
+{
+	uint64_t value;
+	streamReadBytes(pReader, &value, sizeof(value));
+	return value;
+}
+
+static void streamReadString(ProfileStreamReader* pReader, eastl::string& out)
+{
+	uint64_t length = streamReadVarint(pReader);
+	if ((uint64_t)(pReader->pEnd - pReader->pCur) < length)
+	{
+		pReader->mError = true;
+		out.clear();
+		return;
+	}
+	out.assign((const char*)pReader->pCur, (size_t)length);
+	pReader->pCur += length;
+}
+
+#if PROFILE_ENABLED
+static_assert(P_LOG_LEAVE == PROFILE_STREAM_LOG_LEAVE && P_LOG_ENTER == PROFILE_STREAM_LOG_ENTER, "Stream log types out of date");
+static_assert(P_LOG_LABEL == PROFILE_STREAM_LOG_LABEL && P_LOG_LABEL_LITERAL == PROFILE_STREAM_LOG_LABEL_LITERAL, "Stream log types out of date");
+
+/************************************************************************/
+// Capture
+/************************************************************************/
+typedef struct ProfileStreamChunk
+{
+	ProfileStreamChunk* pNext;
+	ProfileStreamBuffer mBuffer;
+} ProfileStreamChunk;
+
+typedef struct ProfileStreamState
+{
+	// Everything up to the queue is only touched with the profiler mutex held
+	bool                mRunning;
+	char                mFileName[FS_MAX_PATH];
+	FileStream          mFile;
+	ThreadDesc          mWriterDesc;
+	ThreadHandle        mWriterThread;
+
+	uint32_t            mTimerCount;
+	uint32_t            mCounterCount;
+	int64_t             mCounterValues[PROFILE_MAX_COUNTERS];
+	uint32_t            mNextThreadId;
+	uint32_t            mThreadIds[PROFILE_MAX_THREADS];
+	uint32_t            mGet[PROFILE_MAX_THREADS];
+
+	// Logs removed between two flips, emitted with the next frame
+	ProfileStreamBuffer mRemovedRecords;
+	ProfileStreamBuffer mRemovedBlocks;
+	uint32_t            mRemovedBlockCount;
+
+	uint64_t            mFrames;
+	uint64_t            mDroppedFrames;
+	uint64_t            mEntries;
+	uint64_t            mFlipTicks;
+	uint64_t            mFlipMaxTicks;
+
+	// Writer queue
+	Mutex               mQueueMutex;
+	ConditionVariable   mQueueCond;
+	ProfileStreamChunk* pQueueHead;
+	ProfileStreamChunk* pQueueTail;
+	ProfileStreamChunk* pFreeChunks;
+	uint64_t            mPendingBytes;
+	bool                mStopWriter;
+
+	tfrg_atomic64_t     mBytesWritten;
+	tfrg_atomic64_t     mWriterTicks;
+} ProfileStreamState;
+
+static ProfileStreamState gProfileStream;
+
+static void ProfileStreamWriterThread(void*)
+{
+	ProfileStreamState& T = gProfileStream;
+	Thread::SetCurrentThreadName("ProfileStream");
+
+	for (;;)
+	{
+		ProfileStreamChunk* pChunks = NULL;
+		{
+			MutexLock lock(T.mQueueMutex);
+			while (!T.pQueueHead && !T.mStopWriter)
+				T.mQueueCond.Wait(T.mQueueMutex);
+			if (!T.pQueueHead)
+				break;
+			pChunks = T.pQueueHead;
+			T.pQueueHead = T.pQueueTail = NULL;
+		}
+
+		int64_t start = P_TICK();
+		uint64_t bytes = 0;
+		ProfileStreamChunk* pLast = pChunks;
+		for (ProfileStreamChunk* pChunk = pChunks; pChunk; pChunk = pChunk->pNext)
+		{
+			if (fsWriteToStream(&T.mFile, pChunk->mBuffer.pData, pChunk->mBuffer.mSize) != pChunk->mBuffer.mSize)
+				LOGF(eERROR, "Failed to write %u bytes to profile stream '%s'", (uint32_t)pChunk->mBuffer.mSize, T.mFileName);
+			bytes += pChunk->mBuffer.mSize;
+			pChunk->mBuffer.mSize = 0;
+			pLast = pChunk;
+		}
+		tfrg_atomic64_add_relaxed(&T.mBytesWritten, bytes);
+		tfrg_atomic64_add_relaxed(&T.mWriterTicks, P_TICK() - start);
+
+		MutexLock lock(T.mQueueMutex);
+		T.mPendingBytes -= bytes;
+		pLast->pNext = T.pFreeChunks;
+		T.pFreeChunks = pChunks;
+	}
+}
+
+static ProfileStreamChunk* ProfileStreamAcquireChunk()
+{
+	ProfileStreamState& T = gProfileStream;
+	{
+		MutexLock lock(T.mQueueMutex);
+		ProfileStreamChunk* pChunk = T.pFreeChunks;
+		if (pChunk)
+		{
+			T.pFreeChunks = pChunk->pNext;
+			pChunk->pNext = NULL;
+			return pChunk;
+		}
+	}
+	return (ProfileStreamChunk*)tf_calloc(1, sizeof(ProfileStreamChunk));
+}
+
+static uint64_t ProfileStreamPendingBytes()
+{
+	ProfileStreamState& T = gProfileStream;
+	MutexLock lock(T.mQueueMutex);
+	return T.mPendingBytes;
+}
+
+static void ProfileStreamSubmitChunk(ProfileStreamChunk* pChunk)
+{
+	ProfileStreamState& T = gProfileStream;
+	MutexLock lock(T.mQueueMutex);
+	if (!pChunk->mBuffer.mSize)
+	{
+		pChunk->pNext = T.pFreeChunks;
+		T.pFreeChunks = pChunk;
+		return;
+	}
+	if (T.pQueueTail)
+		T.pQueueTail->pNext = pChunk;
+	else
+		T.pQueueHead = pChunk;
+	T.pQueueTail = pChunk;
+	T.mPendingBytes += pChunk->mBuffer.mSize;
+	T.mQueueCond.WakeOne();
+}
+
+static void ProfileStreamWriteThread(ProfileStreamBuffer* pBuffer, uint32_t nLogIndex, ProfileThreadLog* pLog)
+{
+	ProfileStreamState& T = gProfileStream;
+	T.mThreadIds[nLogIndex] = ++T.mNextThreadId;
+
+	size_t record = streamBeginRecord(pBuffer, PROFILE_STREAM_RECORD_THREAD);
+	streamWriteVarint(pBuffer, T.mThreadIds[nLogIndex]);
+	streamWriteU8(pBuffer, pLog->nGpu ? 1 : 0);
+	streamWriteU64(pBuffer, (uint64_t)pLog->nThreadId);
+	streamWriteString(pBuffer, pLog->ThreadName);
+	streamEndRecord(pBuffer, record);
+}
+
+static void ProfileStreamWriteMetadata(ProfileStreamBuffer* pBuffer)
+{
+	ProfileStreamState& T = gProfileStream;
+	Profile& S = *ProfileGet();
+
+	for (; T.mTimerCount < S.nTotalTimers; ++T.mTimerCount)
+	{
+		const ProfileTimerInfo& timer = S.TimerInfo[T.mTimerCount];
+		const ProfileGroupInfo& group = S.GroupInfo[timer.nGroupIndex];
+		size_t record = streamBeginRecord(pBuffer, PROFILE_STREAM_RECORD_TIMER);
+		streamWriteVarint(pBuffer, T.mTimerCount);
+		streamWriteU8(pBuffer, group.Type == ProfileTokenTypeGpu ? 1 : 0);
+		streamWriteU32(pBuffer, timer.nColor);
+		streamWriteString(pBuffer, group.pName);
+		streamWriteString(pBuffer, timer.pName);
+		streamEndRecord(pBuffer, record);
+	}
+
+	for (; T.mCounterCount < S.nNumCounters; ++T.mCounterCount)
+	{
+		// Counters are registered parents first, so walking up the tree gives the full path
+		const char* pParts[32];
+		uint32_t partCount = 0;
+		for (int counter = (int)T.mCounterCount; counter >= 0 && partCount < 32; counter = S.CounterInfo[counter].nParent)
+			pParts[partCount++] = S.CounterInfo[counter].pName;
+
+		char name[256] = {};
+		size_t length = 0;
+		while (partCount--)
+		{
+			int written = snprintf(name + length, sizeof(name) - length, length ? "/%s" : "%s", pParts[partCount]);
+			if (written < 0 || length + written >= sizeof(name))
+				break;
+			length += written;
+		}
+
+		size_t record = streamBeginRecord(pBuffer, PROFILE_STREAM_RECORD_COUNTER);
+		streamWriteVarint(pBuffer, T.mCounterCount);
+		streamWriteString(pBuffer, name);
+		streamEndRecord(pBuffer, record);
+	}
+}
+
+// Encodes the entries in [mGet, nPut) of a log as one block. pBuffer may be NULL to only skip them.
+static uint32_t ProfileStreamWriteBlock(ProfileStreamBuffer* pBuffer, uint32_t nLogIndex, ProfileThreadLog* pLog, uint32_t nPut, int64_t nCpuBase)
+{
+	ProfileStreamState& T = gProfileStream;
+	Profile& S = *ProfileGet();
+	uint32_t nGet = T.mGet[nLogIndex];
+	T.mGet[nLogIndex] = nPut;
+	if (!pLog->Log || nGet == nPut || !pBuffer)
+		return 0;
+
+	uint32_t nRange[2][2];
+	ProfileGetRange(nPut, nGet, nRange);
+	uint32_t nCount = (nRange[0][1] - nRange[0][0]) + (nRange[1][1] - nRange[1][0]);
+
+	streamWriteVarint(pBuffer, T.mThreadIds[nLogIndex]);
+	streamWriteVarint(pBuffer, nCount);
+	ProfileLogEntry nPrevious;
+	if (pLog->nGpu)
+	{
+		// GPU ticks are in their own timebase, the converter lines them up with the start of the frame they belong to
+		ProfileLogEntry nFirst = pLog->Log[nRange[0][0]];
+		streamWriteU64(pBuffer, (uint64_t)S.Frames[S.nFrameCurrent].nFrameStartCpu);
+		streamWriteU64(pBuffer, (uint64_t)ProfileLogGetTick(nFirst));
+		streamWriteVarint(pBuffer, getGpuProfileTicksPerSecond(pLog->nGpuToken));
+		nPrevious = nFirst;
+	}
+	else
+	{
+		streamWriteU64(pBuffer, (uint64_t)nCpuBase);
+		nPrevious = (ProfileLogEntry)nCpuBase;
+	}
+
+	for (uint32_t j = 0; j < 2; ++j)
+	{
+		for (uint32_t k = nRange[j][0]; k < nRange[j][1]; ++k)
+		{
+			ProfileLogEntry e = pLog->Log[k];
+			uint64_t nType = ProfileLogType(e);
+			streamWriteVarint(pBuffer, nType | (ProfileLogTimerIndex(e) << 3));
+			switch (nType)
+			{
+				case P_LOG_ENTER:
+				case P_LOG_LEAVE:
+					streamWriteZigzag(pBuffer, ProfileLogTickDifference(nPrevious, e));
+					nPrevious = e;
+					break;
+				case P_LOG_LABEL:
+				case P_LOG_LABEL_LITERAL:
+					streamWriteString(pBuffer, ProfileGetLabel((uint32_t)nType, ProfileLogGetTick(e)));
+					break;
+				default:
+					streamWriteVarint(pBuffer, (uint64_t)ProfileLogGetTick(e));
+					break;
+			}
+		}
+	}
+
+	T.mEntries += nCount;
+	return 1;
+}
+
+PROFILE_API void ProfileStreamFlip()
+{
+	ProfileStreamState& T = gProfileStream;
+	if (!T.mRunning)
+		return;
+
+	Profile& S = *ProfileGet();
+	int64_t nStart = P_TICK();
+	const ProfileFrameState& frame = S.Frames[S.nFramePut];
+
+	ProfileStreamChunk* pChunk = ProfileStreamAcquireChunk();
+	ProfileStreamBuffer* pBuffer = &pChunk->mBuffer;
+
+	ProfileStreamWriteMetadata(pBuffer);
+	streamWriteBytes(pBuffer, T.mRemovedRecords.pData, T.mRemovedRecords.mSize);
+	T.mRemovedRecords.mSize = 0;
+	for (uint32_t i = 0; i < PROFILE_MAX_THREADS; ++i)
+	{
+		if (S.Pool[i] && !T.mThreadIds[i])
+			ProfileStreamWriteThread(pBuffer, i, S.Pool[i]);
+	}
+
+	// Metadata is always kept so that the frames written later can still be decoded
+	bool bDrop = ProfileStreamPendingBytes() > PROFILE_STREAM_MAX_PENDING_BYTES;
+	if (bDrop)
+	{
+		for (uint32_t i = 0; i < PROFILE_MAX_THREADS; ++i)
+		{
+			if (S.Pool[i])
+				ProfileStreamWriteBlock(NULL, i, S.Pool[i], frame.nLogStart[i], frame.nFrameStartCpu);
+		}
+		++T.mDroppedFrames;
+	}
+	else
+	{
+		size_t record = streamBeginRecord(pBuffer, PROFILE_STREAM_RECORD_FRAME);
+		streamWriteVarint(pBuffer, S.nFramePutIndex);
+		streamWriteU64(pBuffer, (uint64_t)frame.nFrameStartCpu);
+
+		streamWriteVarint(pBuffer, T.mCounterCount);
+		for (uint32_t i = 0; i < T.mCounterCount; ++i)
+		{
+			int64_t nValue = tfrg_atomic64_load_relaxed(&S.Counters[i]);
+			streamWriteZigzag(pBuffer, nValue - T.mCounterValues[i]);
+			T.mCounterValues[i] = nValue;
+		}
+
+		size_t blockCountOffset = pBuffer->mSize;
+		streamWriteU32(pBuffer, 0);
+		uint32_t nBlockCount = T.mRemovedBlockCount;
+		streamWriteBytes(pBuffer, T.mRemovedBlocks.pData, T.mRemovedBlocks.mSize);
+		for (uint32_t i = 0; i < PROFILE_MAX_THREADS; ++i)
+		{
+			if (S.Pool[i])
+				nBlockCount += ProfileStreamWriteBlock(pBuffer, i, S.Pool[i], frame.nLogStart[i], frame.nFrameStartCpu);
+		}
+		memcpy(pBuffer->pData + blockCountOffset, &nBlockCount, sizeof(nBlockCount));
+		streamEndRecord(pBuffer, record);
+		++T.mFrames;
+	}
+	T.mRemovedBlocks.mSize = 0;
+	T.mRemovedBlockCount = 0;
+
+	ProfileStreamSubmitChunk(pChunk);
+
+	uint64_t nTicks = (uint64_t)(P_TICK() - nStart);
+	T.mFlipTicks += nTicks;
+	T.mFlipMaxTicks = ProfileMax(T.mFlipMaxTicks, nTicks);
+}
+
+PROFILE_API void ProfileStreamRemoveThreadLog(uint32_t nLogIndex)
+{
+	ProfileStreamState& T = gProfileStream;
+	Profile& S = *ProfileGet();
+	ProfileThreadLog* pLog = S.Pool[nLogIndex];
+	if (T.mRunning && pLog)
+	{
+		if (!T.mThreadIds[nLogIndex])
+			ProfileStreamWriteThread(&T.mRemovedRecords, nLogIndex, pLog);
+		T.mRemovedBlockCount += ProfileStreamWriteBlock(&T.mRemovedBlocks, nLogIndex, pLog, tfrg_atomic32_load_acquire(&pLog->nPut), P_TICK());
+	}
+	T.mThreadIds[nLogIndex] = 0;
+	T.mGet[nLogIndex] = 0;
+}
+
+bool startProfileStream(const char* pFileName)
+{
+	ProfileStreamState& T = gProfileStream;
+	Profile& S = *ProfileGet();
+	MutexLock lock(ProfileGetMutex());
+
+	if (T.mRunning)
+	{
+		LOGF(eWARNING, "Profile stream '%s' is already running", T.mFileName);
+		return false;
+	}
+
+	if (!fsOpenStreamFromPath(RD_LOG, pFileName, FM_WRITE_BINARY, &T.mFile))
+	{
+		LOGF(eERROR, "Failed to open profile stream '%s'", pFileName);
+		return false;
+	}
+
+	strncpy(T.mFileName, pFileName, sizeof(T.mFileName) - 1);
+	T.mFileName[sizeof(T.mFileName) - 1] = '\0';
+
+	uint32_t header[2] = { PROFILE_STREAM_MAGIC, PROFILE_STREAM_VERSION };
+	uint64_t nTicksPerSecond = (uint64_t)ProfileTicksPerSecondCpu();
+	fsWriteToStream(&T.mFile, header, sizeof(header));
+	fsWriteToStream(&T.mFile, &nTicksPerSecond, sizeof(nTicksPerSecond));
+
+	T.mTimerCount = 0;
+	T.mCounterCount = 0;
+	T.mNextThreadId = 0;
+	memset(T.mCounterValues, 0, sizeof(T.mCounterValues));
+	memset(T.mThreadIds, 0, sizeof(T.mThreadIds));
+	// Only what is recorded from now on is streamed
+	for (uint32_t i = 0; i < PROFILE_MAX_THREADS; ++i)
+		T.mGet[i] = S.Pool[i] ? tfrg_atomic32_load_acquire(&S.Pool[i]->nPut) : 0;
+	T.mRemovedRecords.mSize = 0;
+	T.mRemovedBlocks.mSize = 0;
+	T.mRemovedBlockCount = 0;
+	T.mFrames = 0;
+	T.mDroppedFrames = 0;
+	T.mEntries = 0;
+	T.mFlipTicks = 0;
+	T.mFlipMaxTicks = 0;
+	tfrg_atomic64_store_relaxed(&T.mBytesWritten, sizeof(header) + sizeof(nTicksPerSecond));
+	tfrg_atomic64_store_relaxed(&T.mWriterTicks, 0);
+
+	T.mQueueMutex.Init();
+	T.mQueueCond.Init();
+	T.pQueueHead = T.pQueueTail = T.pFreeChunks = NULL;
+	T.mPendingBytes = 0;
+	T.mStopWriter = false;
+
+	T.mWriterDesc.pFunc = ProfileStreamWriterThread;
+	T.mWriterDesc.pData = NULL;
+	T.mWriterThread = create_thread(&T.mWriterDesc);
+
+	T.mRunning = true;
+	return true;
+}
+
+void stopProfileStream()
+{
+	ProfileStreamState& T = gProfileStream;
+	{
+		MutexLock lock(ProfileGetMutex());
+		if (!T.mRunning)
+			return;
+		T.mRunning = false;
+	}
+
+	{
+		MutexLock lock(T.mQueueMutex);
+		T.mStopWriter = true;
+		T.mQueueCond.WakeAll();
+	}
+	join_thread(T.mWriterThread);
+
+	while (T.pFreeChunks)
+	{
+		ProfileStreamChunk* pChunk = T.pFreeChunks;
+		T.pFreeChunks = pChunk->pNext;
+		streamFreeBuffer(&pChunk->mBuffer);
+		tf_free(pChunk);
+	}
+	streamFreeBuffer(&T.mRemovedRecords);
+	streamFreeBuffer(&T.mRemovedBlocks);
+	fsCloseStream(&T.mFile);
+	T.mQueueCond.Destroy();
+	T.mQueueMutex.Destroy();
+
+	ProfileStreamStats stats;
+	getProfileStreamStats(&stats);
+	LOGF(eINFO, "Profile stream '%s': %llu frames, %llu dropped, %llu entries, %.2f MB, flip %.3f ms avg / %.3f ms max, writer %.3f ms avg",
+		T.mFileName, (unsigned long long)stats.mFrames, (unsigned long long)stats.mDroppedFrames, (unsigned long long)stats.mEntries,
+		stats.mBytesWritten / (1024.0 * 1024.0), stats.mFrames ? stats.mFlipTotalMs / stats.mFrames : 0.0, stats.mFlipMaxMs,
+		stats.mFrames ? stats.mWriterTotalMs / stats.mFrames : 0.0);
+}
+
+void getProfileStreamStats(ProfileStreamStats* pOutStats)
+{
+	ProfileStreamState& T = gProfileStream;
+	MutexLock lock(ProfileGetMutex());
+	double fToMs = 1000.0 / (double)ProfileTicksPerSecondCpu();
+	pOutStats->mFrames = T.mFrames;
+	pOutStats->mDroppedFrames = T.mDroppedFrames;
+	pOutStats->mEntries = T.mEntries;
+	pOutStats->mBytesWritten = tfrg_atomic64_load_relaxed(&T.mBytesWritten);
+	pOutStats->mFlipTotalMs = T.mFlipTicks * fToMs;
+	pOutStats->mFlipMaxMs = T.mFlipMaxTicks * fToMs;
+	pOutStats->mWriterTotalMs = tfrg_atomic64_load_relaxed(&T.mWriterTicks) * fToMs;
+}
+#else
+bool startProfileStream(const char* pFileName) { return false; }
+void stopProfileStream() {}
+void getProfileStreamStats(ProfileStreamStats* pOutStats) { memset(pOutStats, 0, sizeof(*pOutStats)); }
+#endif
+
+/************************************************************************/
+// Chrome trace conversion
+/************************************************************************/
+typedef struct ProfileTraceTimer
+{
+	eastl::string mGroup;
+	eastl::string mName;
+} ProfileTraceTimer;
+
+typedef struct ProfileTraceScope
+{
+	uint32_t mTimer;
+	int64_t  mStart;
+} ProfileTraceScope;
+
+typedef struct ProfileTraceThread
+{
+	bool                              mGpu;
+	eastl::vector<ProfileTraceScope> mStack;
+} ProfileTraceThread;
+
+typedef struct ProfileTraceCounter
+{
+	eastl::string mName;
+	int64_t       mValue;
+	bool          mWritten;
+} ProfileTraceCounter;
+
+typedef struct ProfileTraceWriter
+{
+	FileStream*   pFile;
+	eastl::string mText;
+	bool          mFirstEvent;
+	uint64_t      mEventCount;
+	// Ticks are written relative to the first frame so the microsecond values keep their precision
+	int64_t       mBaseTick;
+	double        mTicksToUs;
+} ProfileTraceWriter;
+
+static void traceFlush(ProfileTraceWriter* pWriter, bool force)
+{
+	if (pWriter->mText.size() >= 64 * 1024 || (force && !pWriter->mText.empty()))
+	{
+		fsWriteToStream(pWriter->pFile, pWriter->mText.data(), pWriter->mText.size());
+		pWriter->mText.clear();
+	}
+}
+
+static void traceAppendEscaped(ProfileTraceWriter* pWriter, const char* pString, size_t length)
+{
+	pWriter->mText.push_back('"');
+	for (size_t i = 0; i < length; ++i)
+	{
+		char c = pString[i];
+		if (c == '"' || c == '\\')
+		{
+			pWriter->mText.push_back('\\');
+			pWriter->mText.push_back(c);
+		}
+		else if ((unsigned char)c < 0x20)
+		{
+			pWriter->mText.append_sprintf("\\u%04x", (unsigned)c);
+		}
+		else
+		{
+			pWriter->mText.push_back(c);
+		}
+	}
+	pWriter->mText.push_back('"');
+}
+
+static void traceAppendEscaped(ProfileTraceWriter* pWriter, const eastl::string& string)
+{
+	traceAppendEscaped(pWriter, string.data(), string.size());
+}
+
+static void traceBeginEvent(ProfileTraceWriter* pWriter, const char* pPhase, uint32_t pid, uint32_t tid)
+{
+	pWriter->mText.append(pWriter->mFirstEvent ? "\n" : ",\n");
+	pWriter->mFirstEvent = false;
+	pWriter->mText.append_sprintf("{\"ph\":\"%s\",\"pid\":%u,\"tid\":%u", pPhase, pid, tid);
+	++pWriter->mEventCount;
+}
+
+static void traceEndEvent(ProfileTraceWriter* pWriter)
+{
+	pWriter->mText.push_back('}');
+	traceFlush(pWriter, false);
+}
+
+static void traceAppendTime(ProfileTraceWriter* pWriter, const char* pKey, int64_t tick)
+{
+	pWriter->mText.append_sprintf(",\"%s\":%.3f", pKey, (double)(tick - pWriter->mBaseTick) * pWriter->mTicksToUs);
+}
+
+static void traceAppendTimerName(ProfileTraceWriter* pWriter, const eastl::vector<ProfileTraceTimer>& timers, uint32_t timer)
+{
+	if (timer < timers.size())
+	{
+		pWriter->mText.append(",\"cat\":");
+		traceAppendEscaped(pWriter, timers[timer].mGroup);
+		pWriter->mText.append(",\"name\":");
+		traceAppendEscaped(pWriter, timers[timer].mName);
+	}
+	else
+	{
+		pWriter->mText.append_sprintf(",\"name\":\"timer %u\"", timer);
+	}
+}
+
+bool convertProfileStreamToChromeTrace(const char* pStreamFileName, const char* pJsonFileName)
+{
+	FileStream input = {};
+	if (!fsOpenStreamFromPath(RD_LOG, pStreamFileName, FM_READ_BINARY, &input))
+	{
+		LOGF(eERROR, "Failed to open profile stream '%s'", pStreamFileName);
+		return false;
+	}
+
+	uint32_t header[2] = {};
+	uint64_t nTicksPerSecond = 0;
+	if (fsReadFromStream(&input, header, sizeof(header)) != sizeof(header) ||
+		fsReadFromStream(&input, &nTicksPerSecond, sizeof(nTicksPerSecond)) != sizeof(nTicksPerSecond) ||
+		header[0] != PROFILE_STREAM_MAGIC || header[1] != PROFILE_STREAM_VERSION || !nTicksPerSecond)
+	{
+		LOGF(eERROR, "'%s' is not a profile stream", pStreamFileName);
+		fsCloseStream(&input);
+		return false;
+	}
+
+	FileStream output = {};
+	if (!fsOpenStreamFromPath(RD_LOG, pJsonFileName, FM_WRITE, &output))
+	{
+		LOGF(eERROR, "Failed to open '%s'", pJsonFileName);
+		fsCloseStream(&input);
+		return false;
+	}
+
+	ProfileTraceWriter writer = {};
+	writer.pFile = &output;
+	writer.mFirstEvent = true;
+	writer.mBaseTick = INT64_MIN;
+	writer.mTicksToUs = 1e6 / (double)nTicksPerSecond;
+
+	eastl::vector<ProfileTraceTimer>   timers;
+	eastl::vector<ProfileTraceThread>  threads;
+	eastl::vector<ProfileTraceCounter> counters;
+	eastl::vector<uint8_t>             payload;
+	eastl::string                      name;
+	eastl::string                      group;
+	bool                               bResult = true;
+
+	writer.mText.append("{\"traceEvents\":[");
+	const char* pProcessNames[2] = { "CPU", "GPU" };
+	for (uint32_t pid = 1; pid <= 2; ++pid)
+	{
+		traceBeginEvent(&writer, "M", pid, 0);
+		writer.mText.append_sprintf(",\"name\":\"process_name\",\"args\":{\"name\":\"%s\"}", pProcessNames[pid - 1]);
+		traceEndEvent(&writer);
+	}
+
+	for (;;)
+	{
+		uint8_t type;
+		uint32_t size;
+		if (fsReadFromStream(&input, &type, sizeof(type)) != sizeof(type))
+			break;
+		payload.resize(0);
+		if (fsReadFromStream(&input, &size, sizeof(size)) == sizeof(size))
+		{
+			payload.resize(size);
+			if (fsReadFromStream(&input, payload.data(), size) != size)
+				payload.resize(0);
+		}
+		if (payload.empty())
+		{
+			// A capture that was not stopped cleanly ends with a partial record
+			LOGF(eWARNING, "Profile stream '%s' is truncated", pStreamFileName);
+			break;
+		}
+
+		ProfileStreamReader reader = { payload.data(), payload.data() + payload.size(), false };
+		switch (type)
+		{
+			case PROFILE_STREAM_RECORD_TIMER:
+			{
+				uint32_t index = (uint32_t)streamReadVarint(&reader);
+				streamReadU8(&reader);
+				streamReadU32(&reader);
+				streamReadString(&reader, group);
+				streamReadString(&reader, name);
+				if (index >= timers.size())
+					timers.resize(index + 1);
+				timers[index].mGroup = group;
+				timers[index].mName = name;
+				break;
+			}
+			case PROFILE_STREAM_RECORD_COUNTER:
+			{
+				uint32_t index = (uint32_t)streamReadVarint(&reader);
+				streamReadString(&reader, name);
+				if (index >= counters.size())
+					counters.resize(index + 1);
+				counters[index].mName = name;
+				counters[index].mValue = 0;
+				counters[index].mWritten = false;
+				break;
+			}
+			case PROFILE_STREAM_RECORD_THREAD:
+			{
+				uint32_t id = (uint32_t)streamReadVarint(&reader);
+				bool bGpu = streamReadU8(&reader) != 0;
+				streamReadU64(&reader);
+				streamReadString(&reader, name);
+				if (id >= threads.size())
+					threads.resize(id + 1);
+				threads[id].mGpu = bGpu;
+				threads[id].mStack.clear();
+
+				traceBeginEvent(&writer, "M", bGpu ? 2 : 1, id);
+				writer.mText.append(",\"name\":\"thread_name\",\"args\":{\"name\":");
+				traceAppendEscaped(&writer, name);
+				writer.mText.append("}");
+				traceEndEvent(&writer);
+				break;
+			}
+			case PROFILE_STREAM_RECORD_FRAME:
+			{
+				uint64_t frameIndex = streamReadVarint(&reader);
+				int64_t frameStart = (int64_t)streamReadU64(&reader);
+				if (writer.mBaseTick == INT64_MIN)
+					writer.mBaseTick = frameStart;
+
+				traceBeginEvent(&writer, "i", 1, 0);
+				writer.mText.append_sprintf(",\"name\":\"Frame %llu\",\"s\":\"g\"", (unsigned long long)frameIndex);
+				traceAppendTime(&writer, "ts", frameStart);
+				traceEndEvent(&writer);
+
+				uint32_t counterCount = (uint32_t)streamReadVarint(&reader);
+				for (uint32_t i = 0; i < counterCount && !reader.mError; ++i)
+				{
+					int64_t delta = streamReadZigzag(&reader);
+					if (i >= counters.size())
+						continue;
+					counters[i].mValue += delta;
+					if (delta || !counters[i].mWritten)
+					{
+						traceBeginEvent(&writer, "C", 1, 0);
+						writer.mText.append(",\"name\":");
+						traceAppendEscaped(&writer, counters[i].mName);
+						traceAppendTime(&writer, "ts", frameStart);
+						writer.mText.append_sprintf(",\"args\":{\"value\":%lld}", (long long)counters[i].mValue);
+						traceEndEvent(&writer);
+						counters[i].mWritten = true;
+					}
+				}
+
+				uint32_t blockCount = streamReadU32(&reader);
+				for (uint32_t b = 0; b < blockCount && !reader.mError; ++b)
+				{
+					uint32_t id = (uint32_t)streamReadVarint(&reader);
+					uint32_t entryCount = (uint32_t)streamReadVarint(&reader);
+					if (id >= threads.size())
+					{
+						reader.mError = true;
+						break;
+					}
+					ProfileTraceThread& thread = threads[id];
+					uint32_t pid = thread.mGpu ? 2 : 1;
+					int64_t cpuBase = (int64_t)streamReadU64(&reader);
+					int64_t tick = cpuBase;
+					int64_t gpuBase = 0;
+					double gpuToCpu = 1.0;
+					if (thread.mGpu)
+					{
+						gpuBase = (int64_t)streamReadU64(&reader);
+						uint64_t gpuTicksPerSecond = streamReadVarint(&reader);
+						gpuToCpu = gpuTicksPerSecond ? (double)nTicksPerSecond / (double)gpuTicksPerSecond : 1.0;
+						tick = gpuBase;
+					}
+
+					for (uint32_t e = 0; e < entryCount && !reader.mError; ++e)
+					{
+						uint64_t key = streamReadVarint(&reader);
+						uint32_t logType = (uint32_t)(key & 0x7);
+						uint32_t timer = (uint32_t)(key >> 3);
+						switch (logType)
+						{
+							case PROFILE_STREAM_LOG_ENTER:
+							case PROFILE_STREAM_LOG_LEAVE:
+							{
+								tick += streamReadZigzag(&reader);
+								int64_t cpuTick = thread.mGpu ? cpuBase + (int64_t)((tick - gpuBase) * gpuToCpu) : tick;
+								if (logType == PROFILE_STREAM_LOG_ENTER)
+								{
+									ProfileTraceScope scope = { timer, cpuTick };
+									thread.mStack.push_back(scope);
+								}
+								else if (!thread.mStack.empty())
+								{
+									// Leaves without an enter belong to scopes opened before the capture started
+									ProfileTraceScope scope = thread.mStack.back();
+									thread.mStack.pop_back();
+									traceBeginEvent(&writer, "X", pid, id);
+									traceAppendTimerName(&writer, timers, scope.mTimer);
+									traceAppendTime(&writer, "ts", scope.mStart);
+									writer.mText.append_sprintf(",\"dur\":%.3f", (double)(cpuTick - scope.mStart) * writer.mTicksToUs);
+									traceEndEvent(&writer);
+								}
+								break;
+							}
+							case PROFILE_STREAM_LOG_LABEL:
+							case PROFILE_STREAM_LOG_LABEL_LITERAL:
+							{
+								streamReadString(&reader, name);
+								int64_t cpuTick = thread.mGpu ? cpuBase + (int64_t)((tick - gpuBase) * gpuToCpu) : tick;
+								traceBeginEvent(&writer, "i", pid, id);
+								writer.mText.append(",\"s\":\"t\",\"name\":");
+								traceAppendEscaped(&writer, name);
+								traceAppendTime(&writer, "ts", cpuTick);
+								traceEndEvent(&writer);
+								break;
+							}
+							default:
+								// Meta counters and GPU bookkeeping have no trace event equivalent
+								streamReadVarint(&reader);
+								break;
+						}
+					}
+				}
+				break;
+			}
+			default:
+				// Unknown records are skipped so newer streams still convert
+				break;
+		}
+
+		if (reader.mError)
+		{
+			LOGF(eERROR, "Profile stream '%s' has a malformed record of type %u", pStreamFileName, (uint32_t)type);
+			bResult = false;
+			break;
+		}
+	}
+
+	writer.mText.append("\n],\"displayTimeUnit\":\"ns\"}\n");
+	traceFlush(&writer, true);
+	fsCloseStream(&output);
+	fsCloseStream(&input);
+
+	LOGF(eINFO, "Converted profile stream '%s' to '%s', %llu events", pStreamFileName, pJsonFileName, (unsigned long long)writer.mEventCount);
+	return bResult;
+}
@@ -1111,6 +1111,8 @@ float2 cmdDrawGpuProfile(Cmd* pCmd, const float2& screenCoordsInPx, ProfileToken
 	float2                    pos = screenCoordsInPx;
 	const char titleStr[] = "-----GPU Times-----";
 
+	// One line per timer, record them as a single draw
+	pAppUIRef->pImpl->pFontStash->beginTextBatch();
 	pAppUIRef->pImpl->pFontStash->drawText(
 		pCmd, titleStr, pos.x, pos.y, pDesc->mFontID, pDesc->mFontColor, pDesc->mFontSize,
 		pDesc->mFontSpacing, pDesc->mFontBlur);
@@ -1118,6 +1120,7 @@ float2 cmdDrawGpuProfile(Cmd* pCmd, const float2& screenCoordsInPx, ProfileToken
 	float2 totalTextSizePx = pAppUIRef->MeasureText(titleStr, *pDesc);
 	pos.y += totalTextSizePx.y + gDefaultGpuProfileDrawDesc.mHeightOffset;
 	drawGpuProfileRecursive(pCmd, pGpuProfiler, pDesc, pos, 0, totalTextSizePx);
+	pAppUIRef->pImpl->pFontStash->endTextBatch();
 
 	return totalTextSizePx;
 }
@@ -69,3 +69,13 @@ int64_t getUSec()
 	QueryPerformanceCounter(&counter);
 	return counter.QuadPart * (int64_t)1e6 / getTimerFrequency();
 }
+
+int64_t getNSec()
+{
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	// Convert whole seconds and the remainder separately, scaling the raw counter by 1e9 overflows after a few weeks of uptime
+	const int64_t frequency = getTimerFrequency();
+	const int64_t seconds = counter.QuadPart / frequency;
+	return seconds * 1000000000LL + (counter.QuadPart - seconds * frequency) * 1000000000LL / frequency;
+}
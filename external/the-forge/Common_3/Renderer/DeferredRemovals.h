@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+#pragma once
+
+// Queue behind removeResourceDeferred and beginResourceFrame of the resource loader. Kept in a header so the tests can
+// run many frames of removals with stand-in objects, without a device.
+
+#include "../OS/Interfaces/ILog.h"
+#include "../OS/Interfaces/IThread.h"
+#include "../ThirdParty/OpenSource/EASTL/vector.h"
+
+#define IMEMORY_FROM_HEADER
+#include "../OS/Interfaces/IMemory.h"
+
+typedef enum DeferredRemovalType
+{
+	DEFERRED_REMOVAL_BUFFER,
+	DEFERRED_REMOVAL_TEXTURE,
+	DEFERRED_REMOVAL_GEOMETRY,
+	DEFERRED_REMOVAL_RENDER_TARGET,
+	DEFERRED_REMOVAL_SWAP_CHAIN,
+	DEFERRED_REMOVAL_PIPELINE,
+} DeferredRemovalType;
+
+// Object removed while frames using it may still be in flight, destroyed once mFrame is complete
+struct DeferredRemoval
+{
+	DeferredRemovalType           mType;
+	void*                         pObject;
+	uint64_t                      mFrame;
+};
+
+class DeferredRemovalQueue
+{
+public:
+	typedef void (*DestroyFn)(void* pUserData, const DeferredRemoval& removal);
+
+	void init(DestroyFn destroy, void* pUserData)
+	{
+		pDestroy = destroy;
+		pDestroyUserData = pUserData;
+		mMutex.Init();
+		mFrame = 0;
+	}
+
+	/// Destroys everything still queued, the queues that used it must be idle
+	void exit()
+	{
+		flush();
+		mMutex.Destroy();
+	}
+
+	/// Stamps the object with the current frame, any thread
+	void queue(DeferredRemovalType type, void* pObject)
+	{
+		ASSERT(pObject);
+		MutexLock lock(mMutex);
+		mRemovals.push_back({ type, pObject, mFrame });
+	}
+
+	/// Starts the next frame and destroys what was removed framesInFlight or more frames ago
+	void beginFrame(uint32_t framesInFlight)
+	{
+		ASSERT(framesInFlight > 0);
+		uint64_t frame;
+		{
+			MutexLock lock(mMutex);
+			frame = ++mFrame;
+		}
+
+		// The fence of the slot being reused was signaled by frame - framesInFlight, the frames before it ran on the same queue
+		if (frame >= framesInFlight)
+			process(frame - framesInFlight, false);
+	}
+
+	void flush() { process(0, true); }
+
+	uint32_t getPendingCount()
+	{
+		MutexLock lock(mMutex);
+		return (uint32_t)mRemovals.size();
+	}
+
+private:
+	// Destroys the removals stamped with a frame up to lastCompleteFrame, all of them if flushAll is set
+	void process(uint64_t lastCompleteFrame, bool flushAll)
+	{
+		eastl::vector<DeferredRemoval> complete;
+		{
+			MutexLock lock(mMutex);
+			for (uint32_t i = 0; i < (uint32_t)mRemovals.size();)
+			{
+				if (flushAll || mRemovals[i].mFrame <= lastCompleteFrame)
+				{
+					complete.push_back(mRemovals[i]);
+					mRemovals.erase(mRemovals.begin() + i);
+				}
+				else
+				{
+					++i;
+				}
+			}
+		}
+
+		// Destroyed outside of the lock, removing a geometry goes through removeResource again
+		for (const DeferredRemoval& removal : complete)
+			pDestroy(pDestroyUserData, removal);
+	}
+
+	DestroyFn                      pDestroy;
+	void*                          pDestroyUserData;
+	Mutex                          mMutex;
+	eastl::vector<DeferredRemoval> mRemovals;
+	// Number of beginFrame calls, removals are stamped with it
+	uint64_t                       mFrame;
+};
@@ -705,8 +705,10 @@ void cmdUpdateSubresource(Cmd* pCmd, Texture* pTexture, Buffer* pSrcBuffer, cons
 		sub = { pSrcBuffer->pCpuMappedAddress, 0, 0 };
 	}
 
+	D3D11_BOX box = { pSubresourceDesc->mRegionX, pSubresourceDesc->mRegionY, 0,
+		pSubresourceDesc->mRegionX + pSubresourceDesc->mRegionWidth, pSubresourceDesc->mRegionY + pSubresourceDesc->mRegionHeight, 1 };
 	pContext->UpdateSubresource(
-		pTexture->pDxResource, subresource, NULL, (uint8_t*)sub.pData + pSubresourceDesc->mSrcOffset,
+		pTexture->pDxResource, subresource, pSubresourceDesc->mRegionWidth ? &box : NULL, (uint8_t*)sub.pData + pSubresourceDesc->mSrcOffset,
 		pSubresourceDesc->mRowPitch, pSubresourceDesc->mSlicePitch);
 
 	if (!pSrcBuffer->pCpuMappedAddress)
@@ -3848,6 +3850,16 @@ void cmdBindPushConstantsByIndex(Cmd* pCmd, RootSignature* pRootSignature, uint3
 	set_constant_buffers(pContext, (ShaderStage)pDesc->mUsedStages, pDesc->mReg, 1, &pCmd->pRootConstantBuffer);
 }
 
+uint32_t getDescriptorIndexFromName(const RootSignature* pRootSignature, const char* pName)
+{
+	ASSERT(pRootSignature);
+	ASSERT(pName);
+
+	// Looked up directly instead of through get_descriptor, probing for a descriptor the shaders may not declare is not an error
+	eastl::string_hash_map<uint32_t>::const_iterator it = pRootSignature->pDescriptorNameToIndexMap->mMap.find(pName);
+	return it != pRootSignature->pDescriptorNameToIndexMap->mMap.end() ? it->second : UINT32_MAX;
+}
+
 void cmdBindIndexBuffer(Cmd* pCmd, Buffer* pBuffer, uint32_t indexType, uint64_t offset)
 {
 	ASSERT(pCmd);
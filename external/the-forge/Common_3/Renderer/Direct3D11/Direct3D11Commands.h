@@ -249,6 +249,11 @@ struct SubresourceDataDesc
 	uint32_t mArrayLayer;
 	uint32_t mRowPitch;
 	uint32_t mSlicePitch;
+	// Region of a 2D subresource to copy to, the whole subresource when mRegionWidth is 0
+	uint32_t mRegionX;
+	uint32_t mRegionY;
+	uint32_t mRegionWidth;
+	uint32_t mRegionHeight;
 };
 
 struct UpdateSubresourcesCmd
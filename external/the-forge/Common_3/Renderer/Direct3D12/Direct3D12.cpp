@@ -4502,6 +4502,16 @@ void cmdBindPushConstantsByIndex(Cmd* pCmd, RootSignature* pRootSignature, uint3
 	else
 		pCmd->pDxCmdList->SetComputeRoot32BitConstants(pRootSignature->mDxRootConstantRootIndices[pDesc->mIndexInParent], pDesc->mSize, pConstants, 0);
 }
+
+uint32_t getDescriptorIndexFromName(const RootSignature* pRootSignature, const char* pName)
+{
+	ASSERT(pRootSignature);
+	ASSERT(pName);
+
+	// Looked up directly instead of through get_descriptor, probing for a descriptor the shaders may not declare is not an error
+	DescriptorNameToIndexMap::const_iterator it = pRootSignature->pDescriptorNameToIndexMap->mMap.find(pName);
+	return it != pRootSignature->pDescriptorNameToIndexMap->mMap.end() ? it->second : UINT32_MAX;
+}
 /************************************************************************/
 // Pipeline State Functions
 /************************************************************************/
@@ -5435,6 +5445,11 @@ typedef struct SubresourceDataDesc
 	uint64_t                           mSrcOffset;
 	uint32_t                           mMipLevel;
 	uint32_t                           mArrayLayer;
+	// Region of a 2D subresource to copy to, the whole subresource when mRegionWidth is 0
+	uint32_t                           mRegionX;
+	uint32_t                           mRegionY;
+	uint32_t                           mRegionWidth;
+	uint32_t                           mRegionHeight;
 } SubresourceDataDesc;
 
 void cmdUpdateSubresource(Cmd* pCmd, Texture* pTexture, Buffer* pSrcBuffer, const SubresourceDataDesc* pDesc)
@@ -5448,13 +5463,23 @@ void cmdUpdateSubresource(Cmd* pCmd, Texture* pTexture, Buffer* pSrcBuffer, cons
 	src.pResource = pSrcBuffer->pDxResource;
 	pCmd->pRenderer->pDxDevice->GetCopyableFootprints(&resourceDesc, subresource, 1, pDesc->mSrcOffset, &src.PlacedFootprint, NULL, NULL, NULL);
 	src.PlacedFootprint.Offset = pDesc->mSrcOffset;
+	if (pDesc->mRegionWidth)
+	{
+		// The staging memory only holds the rows of the region, with the pitch the resource loader aligned them to
+		const TinyImageFormat fmt = (TinyImageFormat)pTexture->mFormat;
+		const uint32_t        rowBytes = (pDesc->mRegionWidth / TinyImageFormat_WidthOfBlock(fmt)) * (TinyImageFormat_BitSizeOfBlock(fmt) >> 3);
+		src.PlacedFootprint.Footprint.Width = pDesc->mRegionWidth;
+		src.PlacedFootprint.Footprint.Height = pDesc->mRegionHeight;
+		src.PlacedFootprint.Footprint.Depth = 1;
+		src.PlacedFootprint.Footprint.RowPitch = round_up(rowBytes, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
+	}
 	dst.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
 	dst.pResource = pTexture->pDxResource;
 	dst.SubresourceIndex = subresource;
 #if defined(XBOX)
-	pCmd->mDma.pDxCmdList->CopyTextureRegion(&dst, 0, 0, 0, &src, NULL);
+	pCmd->mDma.pDxCmdList->CopyTextureRegion(&dst, pDesc->mRegionX, pDesc->mRegionY, 0, &src, NULL);
 #else
-	pCmd->pDxCmdList->CopyTextureRegion(&dst, 0, 0, 0, &src, NULL);
+	pCmd->pDxCmdList->CopyTextureRegion(&dst, pDesc->mRegionX, pDesc->mRegionY, 0, &src, NULL);
 #endif
 }
 
@@ -6515,7 +6540,12 @@ void removeVirtualTexture(Renderer* pRenderer, VirtualTexture* pSvt)
 	if (pSvt->mPageCounts)
 		removeBuffer(pRenderer, pSvt->mPageCounts);
 
-	if (pSvt->mVirtualImageData)
+	if (pSvt->pVirtualImageStream)
+	{
+		fsCloseStream((FileStream*)pSvt->pVirtualImageStream);
+		tf_free(pSvt->pVirtualImageStream);
+	}
+	else if (pSvt->mVirtualImageData)
 		tf_free(pSvt->mVirtualImageData);
 }
 
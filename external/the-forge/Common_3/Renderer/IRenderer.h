@@ -1027,6 +1027,8 @@ typedef struct VirtualTexture
 	Buffer*  mPageCounts;
 	/// Original Pixel image data
 	void*    mVirtualImageData;
+	/// Mapped FileStream backing mVirtualImageData, closed on removal instead of freeing the data
+	void*    pVirtualImageStream;
 	///  Total pages count
 	uint32_t mVirtualPageTotalCount;
 	/// Sparse Virtual Texture Width
@@ -1460,6 +1462,7 @@ COMPILE_ASSERT(sizeof(RootSignature) <= 16 * sizeof(uint64_t));
 typedef struct DescriptorData
 {
 	/// User can either set name of descriptor or index (index in pRootSignature->pDescriptors array)
+	/// Setting the index (see getDescriptorIndexFromName) avoids hashing the name on every update
 	/// Name of descriptor
 	const char* pName;
 	union
@@ -2234,6 +2237,9 @@ typedef struct SwapChainDesc
 	bool mEnableVsync;
 	/// We can toggle to using FLIP model if app desires.
 	bool mUseFlipSwapEffect;
+	/// Swapchain of the same window being replaced, its surface is handed over to the new swapchain (Vulkan only).
+	/// The old swapchain still has to be removed, but frames presenting from it do not have to complete first.
+	struct SwapChain* pOldSwapChain;
 } SwapChainDesc;
 
 typedef struct SwapChain
@@ -2357,6 +2363,8 @@ typedef struct RendererDesc
 	/// Flag to specify whether to request all queues from the gpu or just one of each type
 	/// This will affect memory usage - Around 200 MB more used if all queues are requested
 	bool                         mRequestAllAvailableQueues;
+	/// Allow selecting a software implementation (VK_PHYSICAL_DEVICE_TYPE_CPU) such as lavapipe when no GPU is available
+	bool                         mAllowCpuDevice;
 #endif
 #if defined(DIRECT3D12)
 	D3D_FEATURE_LEVEL            mDxFeatureLevel;
@@ -2686,6 +2694,10 @@ API_INTERFACE void FORGE_CALLCONV removePipelineCache(Renderer* pRenderer, Pipel
 API_INTERFACE void FORGE_CALLCONV addDescriptorSet(Renderer* pRenderer, const DescriptorSetDesc* pDesc, DescriptorSet** pDescriptorSet);
 API_INTERFACE void FORGE_CALLCONV removeDescriptorSet(Renderer* pRenderer, DescriptorSet* pDescriptorSet);
 API_INTERFACE void FORGE_CALLCONV updateDescriptorSet(Renderer* pRenderer, uint32_t index, DescriptorSet* pDescriptorSet, uint32_t count, const DescriptorData* pParams);
+/// Resolves a descriptor name to its index in pRootSignature->pDescriptors, or UINT32_MAX without logging if the root signature has no such descriptor.
+/// The index stays valid for the lifetime of the root signature and can be used as DescriptorData::mIndex or with cmdBindPushConstantsByIndex
+/// to skip the name lookup on every update or draw.
+API_INTERFACE uint32_t FORGE_CALLCONV getDescriptorIndexFromName(const RootSignature* pRootSignature, const char* pName);
 
 // command buffer functions
 API_INTERFACE void FORGE_CALLCONV resetCmdPool(Renderer* pRenderer, CmdPool* pCmdPool);
@@ -136,6 +136,9 @@ typedef enum GeometryLoadFlags
 	GEOMETRY_LOAD_FLAG_SHADOWED = 0x1,
 	/// Use structured buffers instead of raw buffers
 	GEOMETRY_LOAD_FLAG_STRUCTURED_BUFFERS = 0x2,
+	/// Reorder triangles for vertex cache and overdraw, then vertices for fetch locality with meshoptimizer.
+	/// Draw arguments and vertex counts stay the same, only the order within each primitive changes.
+	GEOMETRY_LOAD_FLAG_OPTIMIZE = 0x4,
 } GeometryLoadFlags;
 MAKE_ENUM_FLAG(uint32_t, GeometryLoadFlags)
 
@@ -190,6 +193,13 @@ typedef struct TextureUpdateDesc
 	Texture*              pTexture;
 	uint32_t              mMipLevel;
 	uint32_t              mArrayLayer;
+	/// Optional region of a 2D subresource, the whole subresource is updated when mRegionWidth or mRegionHeight is 0.
+	/// Must be aligned to the blocks of the format. The mapped data then only holds the rows of the region.
+	/// The texture has to be in the shader resource state, as left by a previous update of the whole subresource
+	uint32_t              mRegionX;
+	uint32_t              mRegionY;
+	uint32_t              mRegionWidth;
+	uint32_t              mRegionHeight;
 
 	/// To be filled by the caller
 	/// Example:
@@ -268,6 +278,12 @@ typedef struct ResourceLoaderDesc
 	uint64_t mBufferSize;
 	uint32_t mBufferCount;
 	bool     mSingleThreaded;
+	/// Number of workers reading, parsing and transcoding texture and geometry loads ahead of the copy thread
+	/// 0 uses one worker per spare core, ignored when mSingleThreaded is set
+	uint32_t mDecodeThreadCount;
+	/// Number of texture and geometry file reads kept in flight ahead of the decode workers
+	/// 0 lets every decode worker read its own file, ignored without decode workers
+	uint32_t mReadPrefetchDepth;
 } ResourceLoaderDesc;
 
 extern ResourceLoaderDesc gDefaultResourceLoaderDesc;
@@ -301,6 +317,26 @@ void removeResource(Buffer* pBuffer);
 void removeResource(Texture* pTexture);
 void removeResource(Geometry* pGeom);
 
+// MARK: Deferred removal
+
+/// Removing an object still referenced by frames in flight normally requires idling the queues first.
+/// The deferred removals instead stamp the object with the current frame and destroy it from beginResourceFrame
+/// once that frame is complete, so swapchain recreation or unloading do not stall the GPU.
+void removeResourceDeferred(Buffer* pBuffer);
+void removeResourceDeferred(Texture* pTexture);
+void removeResourceDeferred(Geometry* pGeom);
+void removeRenderTargetDeferred(RenderTarget* pRenderTarget);
+void removeSwapChainDeferred(SwapChain* pSwapChain);
+void removePipelineDeferred(Pipeline* pPipeline);
+
+/// Call once per frame, after waiting for the fence of the frame slot about to be recorded.
+/// framesInFlight is the number of frame slots the application cycles through, each signaling its own fence on one queue.
+/// Objects removed framesInFlight or more frames ago are destroyed.
+void beginResourceFrame(uint32_t framesInFlight);
+
+/// Destroys every object waiting for deferred removal. The queues that used them must be idle.
+void flushDeferredRemovals();
+
 // MARK: Waiting for Loads
 
 /// Returns whether all submitted resource loads and updates have been completed.
@@ -319,8 +355,11 @@ SyncToken getLastTokenCompleted();
 bool isTokenCompleted(const SyncToken* token);
 void waitForToken(const SyncToken* token);
 
-/// Either loads the cached shader bytecode or compiles the shader to create new bytecode depending on whether source is newer than binary
+/// Either loads the cached shader bytecode or compiles the shader to create new bytecode. The cached bytecode is used when it was built
+/// from the same source and include contents, macros, entry point and target. The cache index is kept in RD_SHADER_BINARIES.
 void addShader(Renderer* pRenderer, const ShaderLoadDesc* pDesc, Shader** pShader);
+/// Same as addShader for several shaders. The stages of all shaders are loaded and compiled in parallel on the resource loader's decode threads.
+void addShaders(Renderer* pRenderer, uint32_t shaderCount, const ShaderLoadDesc* pDescs, Shader** ppShaders);
 
 /// Save/Load pipeline cache from disk
 void addPipelineCache(Renderer* pRenderer, const PipelineCacheLoadDesc* pDesc, PipelineCache** ppPipelineCache);
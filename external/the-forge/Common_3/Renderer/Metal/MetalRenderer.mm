@@ -458,6 +458,16 @@ void cmdBindPushConstantsByIndex(Cmd* pCmd, RootSignature* pRootSignature, uint3
 	util_bind_push_constant(pCmd, pDesc, pConstants);
 }
 
+uint32_t getDescriptorIndexFromName(const RootSignature* pRootSignature, const char* pName)
+{
+	ASSERT(pRootSignature);
+	ASSERT(pName);
+
+	// Looked up directly instead of through get_descriptor, probing for a descriptor the shaders may not declare is not an error
+	decltype(pRootSignature->pDescriptorNameToIndexMap->mMap)::const_iterator it = pRootSignature->pDescriptorNameToIndexMap->mMap.find(pName);
+	return it != pRootSignature->pDescriptorNameToIndexMap->mMap.end() ? it->second : UINT32_MAX;
+}
+
 //
 // DescriptorSet
 //
@@ -4298,6 +4308,11 @@ typedef struct SubresourceDataDesc
 	uint32_t mArrayLayer;
 	uint32_t mRowPitch;
 	uint32_t mSlicePitch;
+	// Region of a 2D subresource to copy to, the whole subresource when mRegionWidth is 0
+	uint32_t mRegionX;
+	uint32_t mRegionY;
+	uint32_t mRegionWidth;
+	uint32_t mRegionHeight;
 } SubresourceDataDesc;
 
 void cmdUpdateSubresource(Cmd* pCmd, Texture* pTexture, Buffer* pIntermediate, const SubresourceDataDesc* pSubresourceDesc)
@@ -4306,6 +4321,13 @@ void cmdUpdateSubresource(Cmd* pCmd, Texture* pTexture, Buffer* pIntermediate, c
 			max(1, pTexture->mWidth >> pSubresourceDesc->mMipLevel),
 			max(1, pTexture->mHeight >> pSubresourceDesc->mMipLevel),
 			max(1, pTexture->mDepth >> pSubresourceDesc->mMipLevel));
+	MTLOrigin destinationOrigin = MTLOriginMake(0, 0, 0);
+	if (pSubresourceDesc->mRegionWidth)
+	{
+		sourceSize.width = pSubresourceDesc->mRegionWidth;
+		sourceSize.height = pSubresourceDesc->mRegionHeight;
+		destinationOrigin = MTLOriginMake(pSubresourceDesc->mRegionX, pSubresourceDesc->mRegionY, 0);
+	}
 	
 #ifdef TARGET_IOS
     uint64_t formatNamespace = (TinyImageFormat_Code((TinyImageFormat)pTexture->mFormat) & ((1 << TinyImageFormat_NAMESPACE_REQUIRED_BITS) - 1));
@@ -4314,7 +4336,7 @@ void cmdUpdateSubresource(Cmd* pCmd, Texture* pTexture, Buffer* pIntermediate, c
 	// PVRTC - replaceRegion is the most straightforward method
 	if (isPvrtc)
 	{
-		MTLRegion region = MTLRegionMake3D(0, 0, 0, sourceSize.width, sourceSize.height, sourceSize.depth);
+		MTLRegion region = MTLRegionMake3D(destinationOrigin.x, destinationOrigin.y, 0, sourceSize.width, sourceSize.height, sourceSize.depth);
 		[pTexture->mtlTexture replaceRegion:region mipmapLevel:pSubresourceDesc->mMipLevel withBytes:(uint8_t*)pIntermediate->pCpuMappedAddress + pSubresourceDesc->mSrcOffset bytesPerRow:0];
 		return;
 	}
@@ -4335,7 +4357,7 @@ void cmdUpdateSubresource(Cmd* pCmd, Texture* pTexture, Buffer* pIntermediate, c
 							   toTexture:pTexture->mtlTexture
 						destinationSlice:pSubresourceDesc->mArrayLayer
 						destinationLevel:pSubresourceDesc->mMipLevel
-					   destinationOrigin:MTLOriginMake(0, 0, 0)
+					   destinationOrigin:destinationOrigin
 								 options:MTLBlitOptionNone];
 }
 
@@ -2488,6 +2488,16 @@ void cmdBindPushConstantsByIndex(Cmd* pCmd, RootSignature* pRootSignature, uint3
 	util_gl_set_constant(pCmd, pRootSignature, pDesc, pConstants);
 }
 
+uint32_t getDescriptorIndexFromName(const RootSignature* pRootSignature, const char* pName)
+{
+	ASSERT(pRootSignature);
+	ASSERT(pName);
+
+	// Looked up directly instead of through get_descriptor, probing for a descriptor the shaders may not declare is not an error
+	eastl::string_hash_map<uint32_t>::const_iterator it = pRootSignature->pDescriptorNameToIndexMap->mMap.find(pName);
+	return it != pRootSignature->pDescriptorNameToIndexMap->mMap.end() ? it->second : UINT32_MAX;
+}
+
 void cmdBindIndexBuffer(Cmd* pCmd, Buffer* pBuffer, uint32_t indexType, uint64_t offset)
 {
 	ASSERT(pCmd);
@@ -2665,6 +2675,11 @@ typedef struct SubresourceDataDesc
 	uint64_t mSrcOffset;
 	uint32_t mMipLevel;
 	uint32_t mArrayLayer;
+	// Region of a 2D subresource to copy to, the whole subresource when mRegionWidth is 0
+	uint32_t mRegionX;
+	uint32_t mRegionY;
+	uint32_t mRegionWidth;
+	uint32_t mRegionHeight;
 } SubresourceDataDesc;
 
 void cmdUpdateSubresource(Cmd* pCmd, Texture* pTexture, Buffer* pSrcBuffer, const SubresourceDataDesc* pSubresourceDesc)
@@ -2694,7 +2709,15 @@ void cmdUpdateSubresource(Cmd* pCmd, Texture* pTexture, Buffer* pSrcBuffer, cons
 	}
 
 	CHECK_GLRESULT(glBindTexture(pTexture->mTarget, pTexture->mTexture));
-	if (pTexture->mType == GL_NONE) // Compressed image
+	if (pSubresourceDesc->mRegionWidth)
+	{
+		// Regions of compressed images are not supported
+		ASSERT(pTexture->mType != GL_NONE);
+		CHECK_GLRESULT(glTexSubImage2D(target, pSubresourceDesc->mMipLevel, pSubresourceDesc->mRegionX, pSubresourceDesc->mRegionY,
+			pSubresourceDesc->mRegionWidth, pSubresourceDesc->mRegionHeight, pTexture->mGlFormat, pTexture->mType,
+			(uint8_t*)pSrcBuffer->pCpuMappedAddress + pSubresourceDesc->mSrcOffset));
+	}
+	else if (pTexture->mType == GL_NONE) // Compressed image
 	{
 		GLsizei imageByteSize = util_get_compressed_texture_size(pTexture->mInternalFormat, width, height);
 		CHECK_GLRESULT(glCompressedTexImage2D(target, pSubresourceDesc->mMipLevel, pTexture->mInternalFormat,
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+#pragma once
+
+// Per thread render pass and frame buffer caches used by cmdBindRenderTargets on the Vulkan backend. Kept in a header
+// so the tests can record on many threads with stand-in render passes and frame buffers, without a device.
+//
+// FrameBufferT has to provide mRenderTargetIds and mRenderTargetIdCount, the RenderTarget::mId of its attachments.
+
+#include "../OS/Core/Atomics.h"
+#include "../OS/Interfaces/IThread.h"
+#include "../ThirdParty/OpenSource/EASTL/hash_map.h"
+#include "../ThirdParty/OpenSource/EASTL/hash_set.h"
+#include "../ThirdParty/OpenSource/EASTL/sort.h"
+#include "../ThirdParty/OpenSource/EASTL/vector.h"
+
+#define IMEMORY_FROM_HEADER
+#include "../OS/Interfaces/IMemory.h"
+
+struct Renderer;
+
+template <typename RenderPassT, typename FrameBufferT>
+class RenderPassCaches
+{
+public:
+	typedef eastl::hash_map<uint64_t, RenderPassT*>  RenderPassMap;
+	typedef eastl::hash_map<uint64_t, FrameBufferT*> FrameBufferMap;
+	typedef void (*RemoveRenderPassFn)(Renderer* pRenderer, RenderPassT* pRenderPass);
+	typedef void (*RemoveFrameBufferFn)(Renderer* pRenderer, FrameBufferT* pFrameBuffer);
+
+	/// Render passes and frame buffers created by one thread. Only the owning thread touches the maps, so lookups take no lock.
+	/// Once the owner exits the cache is orphaned and only touched with pMutex held.
+	struct Cache
+	{
+		RenderPassMap             mRenderPasses;
+		FrameBufferMap            mFrameBuffers;
+		Cache*                    pNext;
+		/// Render targets referenced by the frame buffers of this cache, guarded by pMutex
+		eastl::hash_set<uint32_t> mRenderTargetIds;
+		/// Retired render targets whose frame buffers the owner still has to evict, guarded by pMutex.
+		/// Only holds ids from mRenderTargetIds, so a cache whose thread stopped recording cannot make it grow without bound
+		eastl::vector<uint32_t>   mRetiredIds;
+		/// Set while mRetiredIds is not empty, polled by the owner on every lookup
+		tfrg_atomic32_t           mHasRetiredIds;
+		tfrg_atomic32_t           mOrphaned;
+	};
+
+	static void init(RemoveRenderPassFn removeRenderPass, RemoveFrameBufferFn removeFrameBuffer)
+	{
+		pMutex = (Mutex*)tf_calloc(1, sizeof(Mutex));
+		pMutex->Init();
+		pCaches = NULL;
+		pRemoveRenderPass = removeRenderPass;
+		pRemoveFrameBuffer = removeFrameBuffer;
+		tfrg_atomic32_add_relaxed(&gEpoch, 1);
+	}
+
+	static void exit(Renderer* pRenderer)
+	{
+		for (Cache* pCache = pCaches; pCache;)
+		{
+			for (typename RenderPassMap::value_type& it : pCache->mRenderPasses)
+				pRemoveRenderPass(pRenderer, it.second);
+			for (typename FrameBufferMap::value_type& it : pCache->mFrameBuffers)
+				pRemoveFrameBuffer(pRenderer, it.second);
+
+			Cache* pNext = pCache->pNext;
+			tf_delete(pCache);
+			pCache = pNext;
+		}
+		pCaches = NULL;
+		tfrg_atomic32_add_relaxed(&gEpoch, 1);
+
+		pMutex->Destroy();
+		tf_free(pMutex);
+		pMutex = NULL;
+	}
+
+	/// Cache of the calling thread, evicts the frame buffers of render targets removed since the last call
+	static Cache* get(Renderer* pRenderer)
+	{
+		Handle&        handle = gHandle;
+		const uint32_t epoch = tfrg_atomic32_load_relaxed(&gEpoch);
+		if (!handle.pCache || handle.mEpoch != epoch)
+		{
+			// Only need a lock the first time this thread records a render pass
+			MutexLock lock(*pMutex);
+			Cache*    pCache = tf_new(Cache);
+			pCache->pNext = pCaches;
+			tfrg_atomic32_store_relaxed(&pCache->mHasRetiredIds, 0);
+			tfrg_atomic32_store_relaxed(&pCache->mOrphaned, 0);
+			pCaches = pCache;
+			handle.pCache = pCache;
+			handle.mEpoch = epoch;
+		}
+
+		Cache* pCache = handle.pCache;
+		if (tfrg_atomic32_load_acquire(&pCache->mHasRetiredIds))
+		{
+			// A render target used by this thread was removed since the last lookup
+			MutexLock lock(*pMutex);
+			evictRetiredFrameBuffers(pRenderer, pCache);
+		}
+		return pCache;
+	}
+
+	/// Called by the owner after adding a frame buffer to its cache
+	static void trackFrameBuffer(Cache* pCache, const FrameBufferT* pFrameBuffer)
+	{
+		MutexLock lock(*pMutex);
+		for (uint32_t i = 0; i < pFrameBuffer->mRenderTargetIdCount; ++i)
+			pCache->mRenderTargetIds.insert(pFrameBuffer->mRenderTargetIds[i]);
+	}
+
+	/// Called before a render target is destroyed. Its frame buffers in the cache of the calling thread and of exited
+	/// threads are removed right away, the other threads remove theirs on their next lookup.
+	static void retireRenderTarget(Renderer* pRenderer, uint32_t renderTargetId)
+	{
+		MutexLock lock(*pMutex);
+
+		// Caches without a frame buffer using the render target have nothing to evict, unless an earlier removal is still
+		// pending because their thread exited before its next lookup
+		Cache* pOwnCache = gHandle.mEpoch == tfrg_atomic32_load_relaxed(&gEpoch) ? gHandle.pCache : NULL;
+		for (Cache* pCache = pCaches; pCache; pCache = pCache->pNext)
+		{
+			if (pCache->mRenderTargetIds.find(renderTargetId) != pCache->mRenderTargetIds.end())
+				pCache->mRetiredIds.push_back(renderTargetId);
+			if (pCache->mRetiredIds.empty())
+				continue;
+
+			if (pCache == pOwnCache || tfrg_atomic32_load_acquire(&pCache->mOrphaned))
+				evictRetiredFrameBuffers(pRenderer, pCache);
+			else
+				tfrg_atomic32_store_release(&pCache->mHasRetiredIds, 1);
+		}
+	}
+
+	/// Frame buffers held by all caches, including the ones still waiting for their owner to evict them
+	static uint32_t getFrameBufferCount()
+	{
+		MutexLock lock(*pMutex);
+		uint32_t  count = 0;
+		for (Cache* pCache = pCaches; pCache; pCache = pCache->pNext)
+			count += (uint32_t)pCache->mFrameBuffers.size();
+		return count;
+	}
+
+private:
+	/// Thread local handle to the cache of the calling thread, resolved on the first lookup of each thread
+	struct Handle
+	{
+		Cache*   pCache = NULL;
+		uint32_t mEpoch = 0;
+
+		~Handle()
+		{
+			if (pCache && mEpoch == tfrg_atomic32_load_relaxed(&gEpoch))
+				tfrg_atomic32_store_release(&pCache->mOrphaned, 1);
+		}
+	};
+
+	// Caller holds pMutex and either owns the cache or the cache is orphaned
+	static void evictRetiredFrameBuffers(Renderer* pRenderer, Cache* pCache)
+	{
+		eastl::vector<uint32_t>& retiredIds = pCache->mRetiredIds;
+		if (retiredIds.empty())
+			return;
+		eastl::sort(retiredIds.begin(), retiredIds.end());
+
+		for (typename FrameBufferMap::iterator it = pCache->mFrameBuffers.begin(); it != pCache->mFrameBuffers.end();)
+		{
+			FrameBufferT* pFrameBuffer = it->second;
+			bool          retired = false;
+			for (uint32_t i = 0; i < pFrameBuffer->mRenderTargetIdCount && !retired; ++i)
+				retired = eastl::binary_search(retiredIds.begin(), retiredIds.end(), pFrameBuffer->mRenderTargetIds[i]);
+
+			if (retired)
+			{
+				pRemoveFrameBuffer(pRenderer, pFrameBuffer);
+				it = pCache->mFrameBuffers.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+
+		for (uint32_t id : retiredIds)
+			pCache->mRenderTargetIds.erase(id);
+		retiredIds.clear();
+		tfrg_atomic32_store_release(&pCache->mHasRetiredIds, 0);
+	}
+
+	// Guarded by pMutex
+	static Cache*              pCaches;
+	static Mutex*              pMutex;
+	static RemoveRenderPassFn  pRemoveRenderPass;
+	static RemoveFrameBufferFn pRemoveFrameBuffer;
+	// Bumped by init and exit so handles left in thread local storage by a previous renderer are ignored
+	static tfrg_atomic32_t     gEpoch;
+	static thread_local Handle gHandle;
+};
+
+template <typename RenderPassT, typename FrameBufferT>
+typename RenderPassCaches<RenderPassT, FrameBufferT>::Cache* RenderPassCaches<RenderPassT, FrameBufferT>::pCaches = NULL;
+template <typename RenderPassT, typename FrameBufferT>
+Mutex* RenderPassCaches<RenderPassT, FrameBufferT>::pMutex = NULL;
+template <typename RenderPassT, typename FrameBufferT>
+typename RenderPassCaches<RenderPassT, FrameBufferT>::RemoveRenderPassFn RenderPassCaches<RenderPassT, FrameBufferT>::pRemoveRenderPass = NULL;
+template <typename RenderPassT, typename FrameBufferT>
+typename RenderPassCaches<RenderPassT, FrameBufferT>::RemoveFrameBufferFn RenderPassCaches<RenderPassT, FrameBufferT>::pRemoveFrameBuffer = NULL;
+template <typename RenderPassT, typename FrameBufferT>
+tfrg_atomic32_t RenderPassCaches<RenderPassT, FrameBufferT>::gEpoch = 0;
+template <typename RenderPassT, typename FrameBufferT>
+thread_local typename RenderPassCaches<RenderPassT, FrameBufferT>::Handle RenderPassCaches<RenderPassT, FrameBufferT>::gHandle;
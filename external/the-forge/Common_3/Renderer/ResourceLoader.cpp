@@ -34,11 +34,15 @@
 
 #define CGLTF_IMPLEMENTATION
 #include "../ThirdParty/OpenSource/cgltf/cgltf.h"
+#include "../ThirdParty/OpenSource/meshoptimizer/src/meshoptimizer.h"
 
 #include "IRenderer.h"
 #include "IResourceLoader.h"
+#include "DeferredRemovals.h"
+#include "VertexPacking.h"
 #include "../OS/Interfaces/ILog.h"
 #include "../OS/Interfaces/IThread.h"
+#include "../OS/Core/ThreadSystem.h"
 
 #if defined(__ANDROID__) && defined(VULKAN)
 #include <shaderc/shaderc.h>
@@ -49,13 +53,12 @@
 #endif
 
 #include "../OS/Core/TextureContainers.h"
+#include "../ThirdParty/OpenSource/EASTL/unordered_map.h"
+#include "../ThirdParty/OpenSource/EASTL/unordered_set.h"
+#include "../ThirdParty/OpenSource/murmurhash3/MurmurHash3_32.h"
 
 #include "../OS/Interfaces/IMemory.h"
 
-#ifdef NX64
-#include "../ThirdParty/OpenSource/murmurhash3/MurmurHash3_32.h"
-#endif
-
 struct SubresourceDataDesc
 {
 	uint64_t                           mSrcOffset;
@@ -65,6 +68,11 @@ struct SubresourceDataDesc
 	uint32_t                           mRowPitch;
 	uint32_t                           mSlicePitch;
 #endif
+	/// Region of a 2D subresource to copy to, the whole subresource when mRegionWidth is 0
+	uint32_t                           mRegionX;
+	uint32_t                           mRegionY;
+	uint32_t                           mRegionWidth;
+	uint32_t                           mRegionHeight;
 };
 
 #define MIP_REDUCE(s, mip) (max(1u, (uint32_t)((s) >> (mip))))
@@ -99,7 +107,7 @@ extern void cmdUpdateSubresource(Cmd* pCmd, Texture* pTexture, Buffer* pSrcBuffe
 
 #define MAX_FRAMES 3U
 
-ResourceLoaderDesc gDefaultResourceLoaderDesc = { 8ull << 20, 2 };
+ResourceLoaderDesc gDefaultResourceLoaderDesc = { 8ull << 20, 2, false, 0, 32 };
 /************************************************************************/
 // Surface Utils
 /************************************************************************/
@@ -216,93 +224,71 @@ static inline constexpr TinyImageFormat util_cgltf_type_to_image_format(cgltf_ty
 	}
 }
 
-#define F16_EXPONENT_BITS 0x1F
-#define F16_EXPONENT_SHIFT 10
-#define F16_EXPONENT_BIAS 15
-#define F16_MANTISSA_BITS 0x3ff
-#define F16_MANTISSA_SHIFT (23 - F16_EXPONENT_SHIFT)
-#define F16_MAX_EXPONENT (F16_EXPONENT_BITS << F16_EXPONENT_SHIFT)
-
-static inline uint16_t util_float_to_half(float val)
+// Detaches gltf buffers that point into mapped .bin files so cgltf_free does not release them, then closes the files
+static void util_cgltf_close_buffer_streams(cgltf_data* data, FileStream* pBufferStreams)
 {
-	uint32_t           f32 = (*(uint32_t*)&val);
-	uint16_t           f16 = 0;
-	/* Decode IEEE 754 little-endian 32-bit floating-point value */
-	int sign = (f32 >> 16) & 0x8000;
-	/* Map exponent to the range [-127,128] */
-	int exponent = ((f32 >> 23) & 0xff) - 127;
-	int mantissa = f32 & 0x007fffff;
-	if (exponent == 128)
-	{ /* Infinity or NaN */
-		f16 = (uint16_t)(sign | F16_MAX_EXPONENT);
-		if (mantissa)
-			f16 |= (mantissa & F16_MANTISSA_BITS);
-	}
-	else if (exponent > 15)
-	{ /* Overflow - flush to Infinity */
-		f16 = (unsigned short)(sign | F16_MAX_EXPONENT);
-	}
-	else if (exponent > -15)
-	{ /* Representable value */
-		exponent += F16_EXPONENT_BIAS;
-		mantissa >>= F16_MANTISSA_SHIFT;
-		f16 = (unsigned short)(sign | exponent << F16_EXPONENT_SHIFT | mantissa);
-	}
-	else
+	for (uint32_t i = 0; i < data->buffers_count; ++i)
 	{
-		f16 = (unsigned short)sign;
+		if (pBufferStreams[i].pIO)
+		{
+			data->buffers[i].data = NULL;
+			fsCloseStream(&pBufferStreams[i]);
+		}
 	}
-	return f16;
+	tf_free(pBufferStreams);
 }
 
-static inline void util_pack_float2_to_half2(uint32_t count, uint32_t stride, uint32_t offset, const uint8_t* src, uint8_t* dst)
+static void* util_meshopt_allocate(size_t size) { return tf_malloc(size); }
+
+static void util_meshopt_deallocate(void* ptr) { tf_free(ptr); }
+
+// Writes the reordered primitive local indices to pIndices and the new place of every vertex to pRemap
+static void util_optimize_primitive(const cgltf_primitive* prim, uint32_t* pIndices, uint32_t* pRemap)
 {
-	struct f2 { float x; float y; };
-	f2* f = (f2*)src;
-	for (uint32_t e = 0; e < count; ++e)
+	const size_t indexCount = prim->indices->count;
+	const size_t vertexCount = prim->attributes->data->count;
+
+	for (size_t idx = 0; idx < indexCount; ++idx)
+		pIndices[idx] = (uint32_t)cgltf_accessor_read_index(prim->indices, idx);
+
+	// The optimizers only work on triangle lists
+	if (cgltf_primitive_type_triangles != prim->type)
 	{
-		*(uint32_t*)(dst + e * sizeof(uint32_t) + offset) = (
-			(util_float_to_half(f[e].x) & 0x0000FFFF) | ((util_float_to_half(f[e].y) << 16) & 0xFFFF0000));
+		for (size_t v = 0; v < vertexCount; ++v)
+			pRemap[v] = (uint32_t)v;
+		return;
 	}
-}
 
-static inline uint32_t util_float2_to_unorm2x16(const float* v)
-{
-	uint32_t x = (uint32_t)round(clamp(v[0], 0, 1) * 65535.0f);
-	uint32_t y = (uint32_t)round(clamp(v[1], 0, 1) * 65535.0f);
-	return ((uint32_t)0x0000FFFF & x) | ((y << 16) & (uint32_t)0xFFFF0000);
-}
-
-#define OCT_WRAP(v, w) ((1.0f - abs((w))) * ((v) >= 0.0f ? 1.0f : -1.0f))
+	meshopt_optimizeVertexCache(pIndices, pIndices, indexCount, vertexCount);
 
-static inline void util_pack_float3_direction_to_half2(uint32_t count, uint32_t stride, uint32_t offset, const uint8_t* src, uint8_t* dst)
-{
-	struct f3 { float x; float y; float z; };
-	for (uint32_t e = 0; e < count; ++e)
+	for (size_t a = 0; a < prim->attributes_count; ++a)
 	{
-		f3 f = *(f3*)(src + e * stride);
-		float absLength = (abs(f.x) + abs(f.y) + abs(f.z));
-		f3 enc = {};
-		if (absLength)
-		{
-			enc.x = f.x / absLength;
-			enc.y = f.y / absLength;
-			enc.z = f.z / absLength;
-			if (enc.z < 0)
-			{
-				float oldX = enc.x;
-				enc.x = OCT_WRAP(enc.x, enc.y);
-				enc.y = OCT_WRAP(enc.y, oldX);
-			}
-			enc.x = enc.x * 0.5f + 0.5f;
-			enc.y = enc.y * 0.5f + 0.5f;
-			*(uint32_t*)(dst + e * sizeof(uint32_t) + offset) = util_float2_to_unorm2x16(&enc.x);
-		}
-		else
+		const cgltf_accessor* accessor = prim->attributes[a].data;
+		if (cgltf_attribute_type_position == prim->attributes[a].type && cgltf_type_vec3 == accessor->type &&
+			cgltf_component_type_r_32f == accessor->component_type)
 		{
-			*(uint32_t*)(dst + e * sizeof(uint32_t) + offset) = 0;
+			const uint8_t* positions = (uint8_t*)accessor->buffer_view->buffer->data + accessor->offset + accessor->buffer_view->offset;
+			meshopt_optimizeOverdraw(pIndices, pIndices, indexCount, (const float*)positions, vertexCount, accessor->stride, 1.05f);
+			break;
 		}
 	}
+
+	size_t uniqueVertexCount = meshopt_optimizeVertexFetchRemap(pRemap, pIndices, indexCount, vertexCount);
+	// Unreferenced vertices are kept after the referenced ones so the vertex count does not change
+	for (size_t v = 0; v < vertexCount; ++v)
+	{
+		if (~0u == pRemap[v])
+			pRemap[v] = (uint32_t)uniqueVertexCount++;
+	}
+
+	meshopt_remapIndexBuffer(pIndices, pIndices, indexCount, pRemap);
+}
+
+// Moves every element of src to the place given by pRemap
+static void util_remap_vertex_attribute(uint32_t count, uint32_t stride, const uint32_t* pRemap, const uint8_t* src, uint8_t* dst)
+{
+	for (uint32_t v = 0; v < count; ++v)
+		memcpy(dst + pRemap[v] * stride, src + v * stride, stride);
 }
 /************************************************************************/
 // Internal Structures
@@ -320,6 +306,11 @@ typedef struct TextureUpdateDescInternal
 	uint32_t          mLayerCount;
 	PreMipStepFn      pPreMipFunc;
 	bool              mMipsAfterSlice;
+	/// Region of the single subresource of an updateResource call, see TextureUpdateDesc
+	uint32_t          mRegionX;
+	uint32_t          mRegionY;
+	uint32_t          mRegionWidth;
+	uint32_t          mRegionHeight;
 } TextureUpdateDescInternal;
 
 typedef struct CopyResourceSet
@@ -365,6 +356,8 @@ typedef enum UploadFunctionResult
 	UPLOAD_FUNCTION_RESULT_INVALID_REQUEST
 } UploadFunctionResult;
 
+struct ResourceDecodeTask;
+
 struct UpdateRequest
 {
 	UpdateRequest(const BufferUpdateDesc& buffer) :           mType(UPDATE_REQUEST_UPDATE_BUFFER), bufUpdateDesc(buffer) {}
@@ -377,6 +370,7 @@ struct UpdateRequest
 	UpdateRequestType             mType = UPDATE_REQUEST_INVALID;
 	uint64_t                      mWaitIndex = 0;
 	Buffer*                       pUploadBuffer = NULL;
+	ResourceDecodeTask*           pDecodeTask = NULL;
 	union
 	{
 		BufferUpdateDesc          bufUpdateDesc;
@@ -388,6 +382,35 @@ struct UpdateRequest
 	};
 };
 
+/// CPU side of a texture or geometry load, run on the decode workers while the request waits in the queue.
+/// The copy thread only records the copies from the upload memory filled here.
+struct ResourceDecodeTask
+{
+	UpdateRequestType             mType;
+	union
+	{
+		TextureLoadDesc           texLoadDesc;
+		GeometryLoadDesc          geomLoadDesc;
+	};
+	UploadFunctionResult          mResult;
+	// Sparse textures record their setup on the copy queue so the whole load is left to the copy thread
+	bool                          mDeferred;
+	bool                          mDone;
+	TextureUpdateDescInternal     mTextureUpdate;
+	BufferUpdateDesc              mBufferUpdates[MAX_VERTEX_BINDINGS + 1];
+	uint32_t                      mBufferUpdateCount;
+	// Whole file read ahead by the prefetch thread, decoded from memory instead of opening the file again
+	AsyncReadRequest              mPrefetch;
+	char                          mPrefetchFileName[FS_MAX_PATH];
+};
+
+// Entry of the shader binary cache index, keyed by the name of the binary file
+struct ShaderCacheEntry
+{
+	uint64_t                      mKey;
+	eastl::vector<eastl::string>  mDependencies;
+};
+
 struct ResourceLoader
 {
 	Renderer*                    pRenderer;
@@ -407,8 +430,30 @@ struct ResourceLoader
 	tfrg_atomic64_t              mTokenCompleted;
 	tfrg_atomic64_t              mTokenCounter;
 
+	ThreadSystem*                pDecodeThreadSystem;
+	Mutex                        mDecodeMutex;
+	ConditionVariable            mDecodeCond;
+
+	AsyncReadQueue*              pPrefetchQueue;
+	ThreadDesc                   mPrefetchThreadDesc;
+	ThreadHandle                 mPrefetchThread;
+	Mutex                        mPrefetchMutex;
+	ConditionVariable            mPrefetchCond;
+	eastl::vector<ResourceDecodeTask*> mPrefetchRequests;
+
+	// Shader binary cache index, read from disk by the first shader load
+	Mutex                        mShaderCacheMutex;
+	ConditionVariable            mShaderCacheCond;
+	eastl::unordered_map<eastl::string, ShaderCacheEntry> mShaderCache;
+	// Binaries being compiled right now, a second load of the same variant waits for the first one
+	eastl::unordered_set<eastl::string> mShaderCompilesInFlight;
+	bool                         mShaderCacheLoaded;
+	bool                         mShaderCacheDirty;
+
 	SyncToken                    mCurrentTokenState[MAX_FRAMES];
 
+	DeferredRemovalQueue         mDeferredRemovals;
+
 	CopyEngine                   pCopyEngines[MAX_LINKED_GPUS];
 	uint32_t                     mNextSet;
 	uint32_t                     mSubmittedSets;
@@ -582,6 +627,8 @@ static void streamerFlush(CopyEngine* pCopyEngine, size_t activeSet)
 	}
 }
 
+typedef MappedMemoryRange (*AllocateUploadMemoryFn)(uint64_t memoryRequirement, uint32_t alignment);
+
 /// Return memory from pre-allocated staging buffer or create a temporary buffer if the streamer ran out of memory
 static MappedMemoryRange allocateStagingMemory(uint64_t memoryRequirement, uint32_t alignment)
 {
@@ -622,6 +669,15 @@ static MappedMemoryRange allocateStagingMemory(uint64_t memoryRequirement, uint3
 	return range;
 }
 
+/// Return a dedicated temporary staging buffer, usable from any thread
+/// The copy thread retires it with the copy resource set the upload is recorded in
+static MappedMemoryRange allocateDecodeMemory(uint64_t memoryRequirement, uint32_t alignment)
+{
+	MappedMemoryRange range = allocateUploadMemory(pResourceLoader->pRenderer, memoryRequirement, alignment);
+	range.mFlags = MAPPED_RANGE_FLAG_TEMP_BUFFER;
+	return range;
+}
+
 static void freeAllUploadMemory()
 {
 	for (size_t i = 0; i < MAX_LINKED_GPUS; ++i)
@@ -632,13 +688,105 @@ static void freeAllUploadMemory()
 			{
 				removeBuffer(pResourceLoader->pRenderer, request.pUploadBuffer);
 			}
+
+			// Decoded loads which never got recorded still own their upload memory
+			if (ResourceDecodeTask* pTask = request.pDecodeTask)
+			{
+				if (pTask->mTextureUpdate.mRange.pBuffer)
+				{
+					removeBuffer(pResourceLoader->pRenderer, pTask->mTextureUpdate.mRange.pBuffer);
+				}
+				for (uint32_t u = 0; u < pTask->mBufferUpdateCount; ++u)
+				{
+					removeBuffer(pResourceLoader->pRenderer, pTask->mBufferUpdates[u].mInternal.mMappedRange.pBuffer);
+				}
+				tf_free(pTask);
+			}
+		}
+	}
+}
+
+static uint64_t util_get_texture_update_size(Renderer* pRenderer, const TextureUpdateDescInternal& texUpdateDesc)
+{
+	const Texture* texture = texUpdateDesc.pTexture;
+	const TinyImageFormat fmt = (TinyImageFormat)texture->mFormat;
+	return util_get_surface_size(fmt, texture->mWidth, texture->mHeight, texture->mDepth,
+		util_get_texture_row_alignment(pRenderer),
+		util_get_texture_subresource_alignment(pRenderer, fmt),
+		texUpdateDesc.mBaseMipLevel, texUpdateDesc.mMipLevels,
+		texUpdateDesc.mBaseArrayLayer, texUpdateDesc.mLayerCount);
+}
+
+/// Reads all subresources of the update from the stream into upload memory, using the same layout updateTexture records copies for
+static bool readTextureSubresources(Renderer* pRenderer, const TextureUpdateDescInternal& texUpdateDesc, FileStream* pStream, uint8_t* pDstData)
+{
+	Texture* texture = texUpdateDesc.pTexture;
+	const TinyImageFormat fmt = (TinyImageFormat)texture->mFormat;
+	const uint32_t sliceAlignment = util_get_texture_subresource_alignment(pRenderer, fmt);
+	const uint32_t rowAlignment = util_get_texture_row_alignment(pRenderer);
+	uint64_t offset = 0;
+
+	uint32_t firstStart = texUpdateDesc.mMipsAfterSlice ? texUpdateDesc.mBaseMipLevel : texUpdateDesc.mBaseArrayLayer;
+	uint32_t firstEnd = texUpdateDesc.mMipsAfterSlice ? (texUpdateDesc.mBaseMipLevel + texUpdateDesc.mMipLevels) : (texUpdateDesc.mBaseArrayLayer + texUpdateDesc.mLayerCount);
+	uint32_t secondStart = texUpdateDesc.mMipsAfterSlice ? texUpdateDesc.mBaseArrayLayer : texUpdateDesc.mBaseMipLevel;
+	uint32_t secondEnd = texUpdateDesc.mMipsAfterSlice ? (texUpdateDesc.mBaseArrayLayer + texUpdateDesc.mLayerCount) : (texUpdateDesc.mBaseMipLevel + texUpdateDesc.mMipLevels);
+
+	for (uint32_t j = firstStart; j < firstEnd; ++j)
+	{
+		if (texUpdateDesc.mMipsAfterSlice && texUpdateDesc.pPreMipFunc)
+		{
+			texUpdateDesc.pPreMipFunc(pStream, j);
+		}
+
+		for (uint32_t i = secondStart; i < secondEnd; ++i)
+		{
+			if (!texUpdateDesc.mMipsAfterSlice && texUpdateDesc.pPreMipFunc)
+			{
+				texUpdateDesc.pPreMipFunc(pStream, i);
+			}
+
+			uint32_t mip = texUpdateDesc.mMipsAfterSlice ? j : i;
+
+			uint32_t w = MIP_REDUCE(texture->mWidth, mip);
+			uint32_t h = MIP_REDUCE(texture->mHeight, mip);
+			uint32_t d = MIP_REDUCE(texture->mDepth, mip);
+
+			uint32_t numBytes = 0;
+			uint32_t rowBytes = 0;
+			uint32_t numRows = 0;
+
+			if (!util_get_surface_info(w, h, fmt, &numBytes, &rowBytes, &numRows))
+			{
+				return false;
+			}
+
+			uint32_t subRowPitch = round_up(rowBytes, rowAlignment);
+			uint32_t subSlicePitch = round_up(subRowPitch * numRows, sliceAlignment);
+			uint8_t* data = pDstData + offset;
+
+			for (uint32_t z = 0; z < d; ++z)
+			{
+				uint8_t* dstData = data + subSlicePitch * z;
+				for (uint32_t r = 0; r < numRows; ++r)
+				{
+					ssize_t bytesRead = fsReadFromStream(pStream, dstData + r * subRowPitch, rowBytes);
+					if (bytesRead != rowBytes)
+					{
+						return false;
+					}
+				}
+			}
+
+			offset += d * subSlicePitch;
 		}
 	}
+
+	return true;
 }
 
 static UploadFunctionResult updateTexture(Renderer* pRenderer, CopyEngine* pCopyEngine, size_t activeSet, const TextureUpdateDescInternal& texUpdateDesc)
 {
-	// When this call comes from updateResource, staging buffer data is already filled
+	// When this call comes from updateResource or the decode workers, staging buffer data is already filled
 	// All that is left to do is record and execute the Copy commands
 	bool dataAlreadyFilled = texUpdateDesc.mRange.pBuffer ? true : false;
 	Texture* texture = texUpdateDesc.pTexture;
@@ -650,14 +798,13 @@ static UploadFunctionResult updateTexture(Renderer* pRenderer, CopyEngine* pCopy
 
 	const uint32_t sliceAlignment = util_get_texture_subresource_alignment(pRenderer, fmt);
 	const uint32_t rowAlignment = util_get_texture_row_alignment(pRenderer);
-	const uint64_t requiredSize = util_get_surface_size(fmt, texture->mWidth, texture->mHeight, texture->mDepth,
-		rowAlignment,
-		sliceAlignment,
-		texUpdateDesc.mBaseMipLevel, texUpdateDesc.mMipLevels,
-		texUpdateDesc.mBaseArrayLayer, texUpdateDesc.mLayerCount);
+	const uint64_t requiredSize = util_get_texture_update_size(pRenderer, texUpdateDesc);
+	// Only updateResource sets a region, the staging memory then holds the rows of the region of a single subresource
+	const bool hasRegion = texUpdateDesc.mRegionWidth && texUpdateDesc.mRegionHeight;
 
 #if defined(VULKAN)
-	TextureBarrier barrier = { texture, RESOURCE_STATE_UNDEFINED, RESOURCE_STATE_COPY_DEST };
+	// The rest of a subresource updated in a region has to be kept
+	TextureBarrier barrier = { texture, hasRegion ? RESOURCE_STATE_SHADER_RESOURCE : RESOURCE_STATE_UNDEFINED, RESOURCE_STATE_COPY_DEST };
 	cmdResourceBarrier(cmd, 0, NULL, 1, &barrier, 0, NULL);
 #endif
 
@@ -689,77 +836,59 @@ static UploadFunctionResult updateTexture(Renderer* pRenderer, CopyEngine* pCopy
 		return UPLOAD_FUNCTION_RESULT_STAGING_BUFFER_FULL;
 	}
 
+	if (!dataAlreadyFilled && !readTextureSubresources(pRenderer, texUpdateDesc, &stream, upload.pData))
+	{
+		return UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
+	}
+
 	uint32_t firstStart = texUpdateDesc.mMipsAfterSlice ? texUpdateDesc.mBaseMipLevel : texUpdateDesc.mBaseArrayLayer;
 	uint32_t firstEnd = texUpdateDesc.mMipsAfterSlice ? (texUpdateDesc.mBaseMipLevel + texUpdateDesc.mMipLevels) : (texUpdateDesc.mBaseArrayLayer + texUpdateDesc.mLayerCount);
 	uint32_t secondStart = texUpdateDesc.mMipsAfterSlice ? texUpdateDesc.mBaseArrayLayer : texUpdateDesc.mBaseMipLevel;
 	uint32_t secondEnd = texUpdateDesc.mMipsAfterSlice ? (texUpdateDesc.mBaseArrayLayer + texUpdateDesc.mLayerCount) : (texUpdateDesc.mBaseMipLevel + texUpdateDesc.mMipLevels);
+	ASSERT(!hasRegion || (dataAlreadyFilled && texUpdateDesc.mMipLevels == 1 && texUpdateDesc.mLayerCount == 1));
 
-	for (uint32_t p = 0; p < 1; ++p)
+	for (uint32_t j = firstStart; j < firstEnd; ++j)
 	{
-		for (uint32_t j = firstStart; j < firstEnd; ++j)
+		for (uint32_t i = secondStart; i < secondEnd; ++i)
 		{
-			if (texUpdateDesc.mMipsAfterSlice && texUpdateDesc.pPreMipFunc)
-			{
-				texUpdateDesc.pPreMipFunc(&stream, j);
-			}
-
-			for (uint32_t i = secondStart; i < secondEnd; ++i)
-			{
-				if (!texUpdateDesc.mMipsAfterSlice && texUpdateDesc.pPreMipFunc)
-				{
-					texUpdateDesc.pPreMipFunc(&stream, i);
-				}
+			uint32_t mip = texUpdateDesc.mMipsAfterSlice ? j : i;
+			uint32_t layer = texUpdateDesc.mMipsAfterSlice ? i : j;
 
-				uint32_t mip = texUpdateDesc.mMipsAfterSlice ? j : i;
-				uint32_t layer = texUpdateDesc.mMipsAfterSlice ? i : j;
+			uint32_t w = hasRegion ? texUpdateDesc.mRegionWidth : MIP_REDUCE(texture->mWidth, mip);
+			uint32_t h = hasRegion ? texUpdateDesc.mRegionHeight : MIP_REDUCE(texture->mHeight, mip);
+			uint32_t d = MIP_REDUCE(texture->mDepth, mip);
 
-				uint32_t w = MIP_REDUCE(texture->mWidth, mip);
-				uint32_t h = MIP_REDUCE(texture->mHeight, mip);
-				uint32_t d = MIP_REDUCE(texture->mDepth, mip);
+			uint32_t numBytes = 0;
+			uint32_t rowBytes = 0;
+			uint32_t numRows = 0;
 
-				uint32_t numBytes = 0;
-				uint32_t rowBytes = 0;
-				uint32_t numRows = 0;
-
-				bool ret = util_get_surface_info(w, h, fmt, &numBytes, &rowBytes, &numRows);
-				if (!ret)
-				{
-					return UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
-				}
+			bool ret = util_get_surface_info(w, h, fmt, &numBytes, &rowBytes, &numRows);
+			if (!ret)
+			{
+				return UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
+			}
 
-				uint32_t subRowPitch = round_up(rowBytes, rowAlignment);
-				uint32_t subSlicePitch = round_up(subRowPitch * numRows, sliceAlignment);
-				uint32_t subNumRows = numRows;
-				uint32_t subDepth = d;
-				uint32_t subRowSize = rowBytes;
-				uint8_t* data = upload.pData + offset;
+			uint32_t subRowPitch = round_up(rowBytes, rowAlignment);
+			uint32_t subSlicePitch = round_up(subRowPitch * numRows, sliceAlignment);
+			uint32_t subDepth = d;
 
-				if (!dataAlreadyFilled)
-				{
-					for (uint32_t z = 0; z < subDepth; ++z)
-					{
-						uint8_t* dstData = data + subSlicePitch * z;
-						for (uint32_t r = 0; r < subNumRows; ++r)
-						{
-							ssize_t bytesRead = fsReadFromStream(&stream, dstData + r * subRowPitch, subRowSize);
-							if (bytesRead != subRowSize)
-							{
-								return UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
-							}
-						}
-					}
-				}
-				SubresourceDataDesc subresourceDesc = {};
-				subresourceDesc.mArrayLayer = layer;
-				subresourceDesc.mMipLevel = mip;
-				subresourceDesc.mSrcOffset = upload.mOffset + offset;
+			SubresourceDataDesc subresourceDesc = {};
+			subresourceDesc.mArrayLayer = layer;
+			subresourceDesc.mMipLevel = mip;
+			subresourceDesc.mSrcOffset = upload.mOffset + offset;
 #if defined(DIRECT3D11) || defined(METAL) || defined(VULKAN)
-				subresourceDesc.mRowPitch = subRowPitch;
-				subresourceDesc.mSlicePitch = subSlicePitch;
+			subresourceDesc.mRowPitch = subRowPitch;
+			subresourceDesc.mSlicePitch = subSlicePitch;
 #endif
-				cmdUpdateSubresource(cmd, texture, upload.pBuffer, &subresourceDesc);
-				offset += subDepth * subSlicePitch;
+			if (hasRegion)
+			{
+				subresourceDesc.mRegionX = texUpdateDesc.mRegionX;
+				subresourceDesc.mRegionY = texUpdateDesc.mRegionY;
+				subresourceDesc.mRegionWidth = texUpdateDesc.mRegionWidth;
+				subresourceDesc.mRegionHeight = texUpdateDesc.mRegionHeight;
 			}
+			cmdUpdateSubresource(cmd, texture, upload.pBuffer, &subresourceDesc);
+			offset += subDepth * subSlicePitch;
 		}
 	}
 
@@ -776,10 +905,52 @@ static UploadFunctionResult updateTexture(Renderer* pRenderer, CopyEngine* pCopy
 	return UPLOAD_FUNCTION_RESULT_COMPLETED;
 }
 
-static UploadFunctionResult loadTexture(Renderer* pRenderer, CopyEngine* pCopyEngine, size_t activeSet, const UpdateRequest& pTextureUpdate)
+static const char* gTextureContainerExtensions[] = { NULL, "dds", "ktx", "gnf", "basis", "svt" };
+
+/// Resolves the platform default container and builds the file name of a texture load.
+/// Returns TEXTURE_CONTAINER_DEFAULT if the platform has no default container.
+static TextureContainerType util_get_texture_file_name(const TextureLoadDesc* pTextureDesc, char* fileName)
 {
-	const TextureLoadDesc* pTextureDesc = &pTextureUpdate.texLoadDesc;
+	TextureContainerType container = pTextureDesc->mContainer;
 
+	if (TEXTURE_CONTAINER_DEFAULT == container)
+	{
+#if defined(TARGET_IOS) || defined(__ANDROID__) || defined(NX64)
+		container = TEXTURE_CONTAINER_KTX;
+#elif defined(_WINDOWS) || defined(XBOX) || defined(__APPLE__) || defined(__linux__)
+		container = TEXTURE_CONTAINER_DDS;
+#elif defined(ORBIS) || defined(PROSPERO)
+		container = TEXTURE_CONTAINER_GNF;
+#endif
+	}
+
+	if (TEXTURE_CONTAINER_DEFAULT != container)
+	{
+		fsAppendPathExtension(pTextureDesc->pFileName, gTextureContainerExtensions[container], fileName);
+	}
+
+	return container;
+}
+
+/// Opens a resource file, or the copy of it the prefetch thread already read into memory.
+/// The stream takes over the prefetched data.
+static bool openResourceStream(ResourceDirectory resourceDir, const char* fileName, AsyncReadRequest* pPrefetch, FileStream* pOut)
+{
+	if (pPrefetch && pPrefetch->pDestination && pPrefetch->mBytesRead > 0)
+	{
+		void* data = pPrefetch->pDestination;
+		pPrefetch->pDestination = NULL;
+		return fsOpenStreamFromMemory(data, (size_t)pPrefetch->mBytesRead, FM_READ_BINARY, true, pOut);
+	}
+
+	return fsOpenStreamFromPath(resourceDir, fileName, FM_READ_BINARY, pOut);
+}
+
+/// CPU side of a texture load: opens the file, parses the header, transcodes if needed and creates the texture.
+/// On success pOutUpdate describes the data still to be uploaded, its pTexture stays NULL if the platform loader already uploaded everything.
+/// Sparse textures are not handled here since they record their setup on the copy queue, see loadSparseTexture.
+static UploadFunctionResult decodeTexture(Renderer* pRenderer, const TextureLoadDesc* pTextureDesc, AsyncReadRequest* pPrefetch, TextureUpdateDescInternal* pOutUpdate)
+{
 	if (pTextureDesc->pFileName)
 	{
 		FileStream stream = {};
@@ -787,19 +958,7 @@ static UploadFunctionResult loadTexture(Renderer* pRenderer, CopyEngine* pCopyEn
 		bool success = false;
 
 		TextureUpdateDescInternal updateDesc = {};
-		TextureContainerType container = pTextureDesc->mContainer;
-		static const char* extensions[] = { NULL, "dds", "ktx", "gnf", "basis", "svt" };
-
-		if (TEXTURE_CONTAINER_DEFAULT == container)
-		{
-#if defined(TARGET_IOS) || defined(__ANDROID__) || defined(NX64)
-			container = TEXTURE_CONTAINER_KTX;
-#elif defined(_WINDOWS) || defined(XBOX) || defined(__APPLE__) || defined(__linux__)
-			container = TEXTURE_CONTAINER_DDS;
-#elif defined(ORBIS) || defined(PROSPERO)
-			container = TEXTURE_CONTAINER_GNF;
-#endif
-		}
+		TextureContainerType container = util_get_texture_file_name(pTextureDesc, fileName);
 
 		TextureDesc textureDesc = {};
 		textureDesc.pName = pTextureDesc->pFileName;
@@ -811,8 +970,6 @@ static UploadFunctionResult loadTexture(Renderer* pRenderer, CopyEngine* pCopyEn
 			return UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
 		}
 
-		fsAppendPathExtension(pTextureDesc->pFileName, extensions[container], fileName);
-
 		switch (container)
 		{
 		case TEXTURE_CONTAINER_DDS:
@@ -829,7 +986,7 @@ static UploadFunctionResult loadTexture(Renderer* pRenderer, CopyEngine* pCopyEn
 
 			return res ? UPLOAD_FUNCTION_RESULT_INVALID_REQUEST : UPLOAD_FUNCTION_RESULT_COMPLETED;
 #else
-			success = fsOpenStreamFromPath(RD_TEXTURES, fileName, FM_READ_BINARY, &stream);
+			success = openResourceStream(RD_TEXTURES, fileName, pPrefetch, &stream);
 			if (success)
 			{
 				success = loadDDSTextureDesc(&stream, &textureDesc);
@@ -839,7 +996,7 @@ static UploadFunctionResult loadTexture(Renderer* pRenderer, CopyEngine* pCopyEn
 		}
 		case TEXTURE_CONTAINER_KTX:
 		{
-			success = fsOpenStreamFromPath(RD_TEXTURES, fileName, FM_READ_BINARY, &stream);
+			success = openResourceStream(RD_TEXTURES, fileName, pPrefetch, &stream);
 			if (success)
 			{
 				success = loadKTXTextureDesc(&stream, &textureDesc);
@@ -858,7 +1015,7 @@ static UploadFunctionResult loadTexture(Renderer* pRenderer, CopyEngine* pCopyEn
 		{
 			void* data = NULL;
 			uint32_t dataSize = 0;
-			success = fsOpenStreamFromPath(RD_TEXTURES, fileName, FM_READ_BINARY, &stream);
+			success = openResourceStream(RD_TEXTURES, fileName, pPrefetch, &stream);
 			if (success)
 			{
 				success = loadBASISTextureDesc(&stream, &textureDesc, &data, &dataSize);
@@ -907,122 +1064,200 @@ static UploadFunctionResult loadTexture(Renderer* pRenderer, CopyEngine* pCopyEn
 			updateDesc.mBaseArrayLayer = 0;
 			updateDesc.mLayerCount = textureDesc.mArraySize;
 
-			return updateTexture(pRenderer, pCopyEngine, activeSet, updateDesc);
+			*pOutUpdate = updateDesc;
+			return UPLOAD_FUNCTION_RESULT_COMPLETED;
+		}
+
+		// The header could not be parsed, release the file (or the prefetched copy the stream took over)
+		if (stream.pIO)
+		{
+			fsCloseStream(&stream);
 		}
-		/************************************************************************/
-		// Sparse Tetxtures
-		/************************************************************************/
+	}
+
+	return UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
+}
+
+/// Reads the remaining texture data from the stream into newly allocated upload memory, so the copy thread only has to record the copies
+static bool fillTextureUploadMemory(Renderer* pRenderer, TextureUpdateDescInternal* pUpdate)
+{
+	const uint32_t sliceAlignment = util_get_texture_subresource_alignment(pRenderer, (TinyImageFormat)pUpdate->pTexture->mFormat);
+	MappedMemoryRange range = allocateDecodeMemory(util_get_texture_update_size(pRenderer, *pUpdate), sliceAlignment);
+
+	bool success = readTextureSubresources(pRenderer, *pUpdate, &pUpdate->mStream, range.pData);
+	fsCloseStream(&pUpdate->mStream);
+	pUpdate->mStream = {};
+
+	if (!success)
+	{
+		removeBuffer(pRenderer, range.pBuffer);
+		return false;
+	}
+
+	pUpdate->mRange = range;
+	return true;
+}
+
+/************************************************************************/
+// Sparse Tetxtures
+/************************************************************************/
+static UploadFunctionResult loadSparseTexture(Renderer* pRenderer, CopyEngine* pCopyEngine, size_t activeSet, const TextureLoadDesc* pTextureDesc)
+{
 #if defined(DIRECT3D12) || defined(VULKAN)
-		if (TEXTURE_CONTAINER_SVT == container)
+	if (pTextureDesc->pFileName)
+	{
+		FileStream stream = {};
+		char fileName[FS_MAX_PATH] = {};
+		TextureDesc textureDesc = {};
+		textureDesc.pName = pTextureDesc->pFileName;
+
+		fsAppendPathExtension(pTextureDesc->pFileName, gTextureContainerExtensions[TEXTURE_CONTAINER_SVT], fileName);
+
+		if (fsOpenStreamFromPath(RD_TEXTURES, fileName, FM_READ_BINARY, &stream))
 		{
-			if (fsOpenStreamFromPath(RD_TEXTURES, fileName, FM_READ_BINARY, &stream))
+			if (loadSVTTextureDesc(&stream, &textureDesc))
 			{
-				success = loadSVTTextureDesc(&stream, &textureDesc);
-				if (success)
+				ssize_t dataOffset = fsGetStreamSeekPosition(&stream);
+				ssize_t dataSize = fsGetStreamFileSize(&stream) - dataOffset;
+
+				// Pages are read straight from the mapped file when possible, the texture then keeps the stream open until it is removed
+				const void* mapped = fsGetStreamBufferIfPresent(&stream);
+				FileStream* pMappedStream = NULL;
+				void* data = NULL;
+				if (mapped)
 				{
-					ssize_t dataSize = fsGetStreamFileSize(&stream) - fsGetStreamSeekPosition(&stream);
-					void* data = tf_malloc(dataSize);
+					pMappedStream = (FileStream*)tf_malloc(sizeof(FileStream));
+					*pMappedStream = stream;
+					data = (uint8_t*)mapped + dataOffset;
+				}
+				else
+				{
+					data = tf_malloc(dataSize);
 					fsReadFromStream(&stream, data, dataSize);
+				}
 
-					textureDesc.mStartState = RESOURCE_STATE_COPY_DEST;
-					textureDesc.mFlags |= pTextureDesc->mCreationFlag;
-					textureDesc.mNodeIndex = pTextureDesc->mNodeIndex;
-					addVirtualTexture(acquireCmd(pCopyEngine, activeSet), &textureDesc, pTextureDesc->ppTexture, data);
-					/************************************************************************/
-					// Create visibility buffer
-					/************************************************************************/
-					eastl::vector<VirtualTexturePage>* pPageTable = (eastl::vector<VirtualTexturePage>*)(*pTextureDesc->ppTexture)->pSvt->pPages;
-
-					if (pPageTable == NULL)
-						return UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
-
-					BufferLoadDesc visDesc = {};
-					visDesc.mDesc.mDescriptors = DESCRIPTOR_TYPE_RW_BUFFER;
-					visDesc.mDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_GPU_ONLY;
-					visDesc.mDesc.mStructStride = sizeof(uint);
-					visDesc.mDesc.mElementCount = (uint64_t)pPageTable->size();
-					visDesc.mDesc.mSize = visDesc.mDesc.mStructStride * visDesc.mDesc.mElementCount;
-					visDesc.mDesc.mStartState = RESOURCE_STATE_COMMON;
-					visDesc.mDesc.pName = "Vis Buffer for Sparse Texture";
-					visDesc.ppBuffer = &(*pTextureDesc->ppTexture)->pSvt->mVisibility;
-					addResource(&visDesc, NULL);
-
-					BufferLoadDesc prevVisDesc = {};
-					prevVisDesc.mDesc.mDescriptors = DESCRIPTOR_TYPE_RW_BUFFER;
-					prevVisDesc.mDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_GPU_ONLY;
-					prevVisDesc.mDesc.mStructStride = sizeof(uint);
-					prevVisDesc.mDesc.mElementCount = (uint64_t)pPageTable->size();
-					prevVisDesc.mDesc.mSize = prevVisDesc.mDesc.mStructStride * prevVisDesc.mDesc.mElementCount;
-					prevVisDesc.mDesc.mStartState = RESOURCE_STATE_COMMON;
-					prevVisDesc.mDesc.pName = "Prev Vis Buffer for Sparse Texture";
-					prevVisDesc.ppBuffer = &(*pTextureDesc->ppTexture)->pSvt->mPrevVisibility;
-					addResource(&prevVisDesc, NULL);
-
-					BufferLoadDesc alivePageDesc = {};
-					alivePageDesc.mDesc.mDescriptors = DESCRIPTOR_TYPE_RW_BUFFER;
-					alivePageDesc.mDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_CPU_TO_GPU;
+				textureDesc.mStartState = RESOURCE_STATE_COPY_DEST;
+				textureDesc.mFlags |= pTextureDesc->mCreationFlag;
+				textureDesc.mNodeIndex = pTextureDesc->mNodeIndex;
+				addVirtualTexture(acquireCmd(pCopyEngine, activeSet), &textureDesc, pTextureDesc->ppTexture, data);
+				(*pTextureDesc->ppTexture)->pSvt->pVirtualImageStream = pMappedStream;
+				/************************************************************************/
+				// Create visibility buffer
+				/************************************************************************/
+				eastl::vector<VirtualTexturePage>* pPageTable = (eastl::vector<VirtualTexturePage>*)(*pTextureDesc->ppTexture)->pSvt->pPages;
+
+				if (pPageTable == NULL)
+					return UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
+
+				BufferLoadDesc visDesc = {};
+				visDesc.mDesc.mDescriptors = DESCRIPTOR_TYPE_RW_BUFFER;
+				visDesc.mDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_GPU_ONLY;
+				visDesc.mDesc.mStructStride = sizeof(uint);
+				visDesc.mDesc.mElementCount = (uint64_t)pPageTable->size();
+				visDesc.mDesc.mSize = visDesc.mDesc.mStructStride * visDesc.mDesc.mElementCount;
+				visDesc.mDesc.mStartState = RESOURCE_STATE_COMMON;
+				visDesc.mDesc.pName = "Vis Buffer for Sparse Texture";
+				visDesc.ppBuffer = &(*pTextureDesc->ppTexture)->pSvt->mVisibility;
+				addResource(&visDesc, NULL);
+
+				BufferLoadDesc prevVisDesc = {};
+				prevVisDesc.mDesc.mDescriptors = DESCRIPTOR_TYPE_RW_BUFFER;
+				prevVisDesc.mDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_GPU_ONLY;
+				prevVisDesc.mDesc.mStructStride = sizeof(uint);
+				prevVisDesc.mDesc.mElementCount = (uint64_t)pPageTable->size();
+				prevVisDesc.mDesc.mSize = prevVisDesc.mDesc.mStructStride * prevVisDesc.mDesc.mElementCount;
+				prevVisDesc.mDesc.mStartState = RESOURCE_STATE_COMMON;
+				prevVisDesc.mDesc.pName = "Prev Vis Buffer for Sparse Texture";
+				prevVisDesc.ppBuffer = &(*pTextureDesc->ppTexture)->pSvt->mPrevVisibility;
+				addResource(&prevVisDesc, NULL);
+
+				BufferLoadDesc alivePageDesc = {};
+				alivePageDesc.mDesc.mDescriptors = DESCRIPTOR_TYPE_RW_BUFFER;
+				alivePageDesc.mDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_CPU_TO_GPU;
 #if defined(DIRECT3D12)
-					alivePageDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_OWN_MEMORY_BIT;
+				alivePageDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_OWN_MEMORY_BIT;
 #elif defined(VULKAN)
-					alivePageDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT;
+				alivePageDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT;
 #else
-					alivePageDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT | BUFFER_CREATION_FLAG_OWN_MEMORY_BIT;
-#endif
-					alivePageDesc.mDesc.mStructStride = sizeof(uint);
-					alivePageDesc.mDesc.mElementCount = (uint64_t)pPageTable->size();
-					alivePageDesc.mDesc.mSize = alivePageDesc.mDesc.mStructStride * alivePageDesc.mDesc.mElementCount;
-					alivePageDesc.mDesc.pName = "Alive pages buffer for Sparse Texture";
-					alivePageDesc.ppBuffer = &(*pTextureDesc->ppTexture)->pSvt->mAlivePage;
-					addResource(&alivePageDesc, NULL);
-
-					BufferLoadDesc removePageDesc = {};
-					removePageDesc.mDesc.mDescriptors = DESCRIPTOR_TYPE_RW_BUFFER;
-					removePageDesc.mDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_CPU_TO_GPU;
+				alivePageDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT | BUFFER_CREATION_FLAG_OWN_MEMORY_BIT;
+#endif
+				alivePageDesc.mDesc.mStructStride = sizeof(uint);
+				alivePageDesc.mDesc.mElementCount = (uint64_t)pPageTable->size();
+				alivePageDesc.mDesc.mSize = alivePageDesc.mDesc.mStructStride * alivePageDesc.mDesc.mElementCount;
+				alivePageDesc.mDesc.pName = "Alive pages buffer for Sparse Texture";
+				alivePageDesc.ppBuffer = &(*pTextureDesc->ppTexture)->pSvt->mAlivePage;
+				addResource(&alivePageDesc, NULL);
+
+				BufferLoadDesc removePageDesc = {};
+				removePageDesc.mDesc.mDescriptors = DESCRIPTOR_TYPE_RW_BUFFER;
+				removePageDesc.mDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_CPU_TO_GPU;
 #if defined(DIRECT3D12)
-					removePageDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_OWN_MEMORY_BIT;
+				removePageDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_OWN_MEMORY_BIT;
 #elif defined(VULKAN)
-					removePageDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT;
+				removePageDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT;
 #else
-					removePageDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT | BUFFER_CREATION_FLAG_OWN_MEMORY_BIT;
-#endif
-					removePageDesc.mDesc.mStructStride = sizeof(uint);
-					removePageDesc.mDesc.mElementCount = (uint64_t)pPageTable->size();
-					removePageDesc.mDesc.mSize = removePageDesc.mDesc.mStructStride * removePageDesc.mDesc.mElementCount;
-					removePageDesc.mDesc.pName = "Remove pages buffer for Sparse Texture";
-					removePageDesc.ppBuffer = &(*pTextureDesc->ppTexture)->pSvt->mRemovePage;
-					addResource(&removePageDesc, NULL);
-
-					BufferLoadDesc pageCountsDesc = {};
-					pageCountsDesc.mDesc.mDescriptors = DESCRIPTOR_TYPE_RW_BUFFER;
-					pageCountsDesc.mDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_CPU_TO_GPU;
+				removePageDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT | BUFFER_CREATION_FLAG_OWN_MEMORY_BIT;
+#endif
+				removePageDesc.mDesc.mStructStride = sizeof(uint);
+				removePageDesc.mDesc.mElementCount = (uint64_t)pPageTable->size();
+				removePageDesc.mDesc.mSize = removePageDesc.mDesc.mStructStride * removePageDesc.mDesc.mElementCount;
+				removePageDesc.mDesc.pName = "Remove pages buffer for Sparse Texture";
+				removePageDesc.ppBuffer = &(*pTextureDesc->ppTexture)->pSvt->mRemovePage;
+				addResource(&removePageDesc, NULL);
+
+				BufferLoadDesc pageCountsDesc = {};
+				pageCountsDesc.mDesc.mDescriptors = DESCRIPTOR_TYPE_RW_BUFFER;
+				pageCountsDesc.mDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_CPU_TO_GPU;
 #if defined(DIRECT3D12)
-					pageCountsDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_OWN_MEMORY_BIT;
+				pageCountsDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_OWN_MEMORY_BIT;
 #elif defined(VULKAN)
-					pageCountsDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT;
+				pageCountsDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT;
 #else
-					pageCountsDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT | BUFFER_CREATION_FLAG_OWN_MEMORY_BIT;
+				pageCountsDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT | BUFFER_CREATION_FLAG_OWN_MEMORY_BIT;
 #endif
-					pageCountsDesc.mDesc.mStructStride = sizeof(uint);
-					pageCountsDesc.mDesc.mElementCount = 4;
-					pageCountsDesc.mDesc.mSize = pageCountsDesc.mDesc.mStructStride * pageCountsDesc.mDesc.mElementCount;
-					pageCountsDesc.mDesc.pName = "Page count buffer for Sparse Texture";
-					pageCountsDesc.ppBuffer = &(*pTextureDesc->ppTexture)->pSvt->mPageCounts;
-					addResource(&pageCountsDesc, NULL);
+				pageCountsDesc.mDesc.mStructStride = sizeof(uint);
+				pageCountsDesc.mDesc.mElementCount = 4;
+				pageCountsDesc.mDesc.mSize = pageCountsDesc.mDesc.mStructStride * pageCountsDesc.mDesc.mElementCount;
+				pageCountsDesc.mDesc.pName = "Page count buffer for Sparse Texture";
+				pageCountsDesc.ppBuffer = &(*pTextureDesc->ppTexture)->pSvt->mPageCounts;
+				addResource(&pageCountsDesc, NULL);
 
+				if (!pMappedStream)
 					fsCloseStream(&stream);
 
-					return UPLOAD_FUNCTION_RESULT_COMPLETED;
-				}
+				return UPLOAD_FUNCTION_RESULT_COMPLETED;
 			}
-
-			return UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
 		}
-#endif
 	}
+#else
+	UNREF_PARAM(pRenderer);
+	UNREF_PARAM(pCopyEngine);
+	UNREF_PARAM(activeSet);
+	UNREF_PARAM(pTextureDesc);
+#endif
 
 	return UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
 }
 
+static UploadFunctionResult loadTexture(Renderer* pRenderer, CopyEngine* pCopyEngine, size_t activeSet, const UpdateRequest& pTextureUpdate)
+{
+	const TextureLoadDesc* pTextureDesc = &pTextureUpdate.texLoadDesc;
+
+	if (TEXTURE_CONTAINER_SVT == pTextureDesc->mContainer)
+	{
+		return loadSparseTexture(pRenderer, pCopyEngine, activeSet, pTextureDesc);
+	}
+
+	TextureUpdateDescInternal updateDesc = {};
+	UploadFunctionResult result = decodeTexture(pRenderer, pTextureDesc, NULL, &updateDesc);
+	if (UPLOAD_FUNCTION_RESULT_COMPLETED != result || !updateDesc.pTexture)
+	{
+		return result;
+	}
+
+	return updateTexture(pRenderer, pCopyEngine, activeSet, updateDesc);
+}
+
 static UploadFunctionResult updateBuffer(Renderer* pRenderer, CopyEngine* pCopyEngine, size_t activeSet, const BufferUpdateDesc& bufUpdateDesc)
 {
 	ASSERT(pCopyEngine->pQueue->mNodeIndex == bufUpdateDesc.pBuffer->mNodeIndex);
@@ -1037,9 +1272,11 @@ static UploadFunctionResult updateBuffer(Renderer* pRenderer, CopyEngine* pCopyE
 	return UPLOAD_FUNCTION_RESULT_COMPLETED;
 }
 
-static UploadFunctionResult loadGeometry(Renderer* pRenderer, CopyEngine* pCopyEngine, size_t activeSet, UpdateRequest& pGeometryLoad)
+/// CPU side of a geometry load: parses the gltf, creates the buffers and packs indices and vertices into upload memory returned by pAllocateUpload.
+/// The buffer copies still to be recorded are returned in pOutUpdates (index buffer followed by the vertex buffers), none are needed on UMA platforms.
+static UploadFunctionResult decodeGeometry(Renderer* pRenderer, GeometryLoadDesc* pDesc, AsyncReadRequest* pPrefetch, AllocateUploadMemoryFn pAllocateUpload, BufferUpdateDesc* pOutUpdates, uint32_t* pOutUpdateCount)
 {
-	GeometryLoadDesc* pDesc = &pGeometryLoad.geomLoadDesc;
+	*pOutUpdateCount = 0;
 
 	char iext[FS_MAX_PATH] = { 0 };
 	fsGetPathExtension(pDesc->pFileName, iext);
@@ -1048,7 +1285,7 @@ static UploadFunctionResult loadGeometry(Renderer* pRenderer, CopyEngine* pCopyE
 	if (iext[0] != 0 && (stricmp(iext, "gltf") == 0 || stricmp(iext, "glb") == 0))
 	{
 		FileStream file = {};
-		if (!fsOpenStreamFromPath(RD_MESHES, pDesc->pFileName, FM_READ_BINARY, &file))
+		if (!openResourceStream(RD_MESHES, pDesc->pFileName, pPrefetch, &file))
 		{
 			LOGF(eERROR, "Failed to open gltf file %s", pDesc->pFileName);
 			ASSERT(false);
@@ -1056,23 +1293,31 @@ static UploadFunctionResult loadGeometry(Renderer* pRenderer, CopyEngine* pCopyE
 		}
 
 		ssize_t fileSize = fsGetStreamFileSize(&file);
-		void* fileData = tf_malloc(fileSize);
 		cgltf_result result = cgltf_result_invalid_gltf;
 
-		fsReadFromStream(&file, fileData, fileSize);
+		// Parse straight out of the mapped file when possible. The stream stays open until the
+		// gltf data is freed since the glb binary chunk is referenced in place.
+		void* fileData = NULL;
+		const void* fileBuffer = fsGetStreamBufferIfPresent(&file);
+		if (!fileBuffer)
+		{
+			fileData = tf_malloc(fileSize);
+			fsReadFromStream(&file, fileData, fileSize);
+			fileBuffer = fileData;
+		}
 
 		cgltf_options options = {};
 		cgltf_data* data = NULL;
 		options.memory_alloc = [](void* user, cgltf_size size) { return tf_malloc(size); };
 		options.memory_free = [](void* user, void* ptr) { tf_free(ptr); };
-		result = cgltf_parse(&options, fileData, fileSize, &data);
-		fsCloseStream(&file);
+		result = cgltf_parse(&options, fileBuffer, fileSize, &data);
 
 		if (cgltf_result_success != result)
 		{
 			LOGF(eERROR, "Failed to parse gltf file %s with error %u", pDesc->pFileName, (uint32_t)result);
 			ASSERT(false);
 			tf_free(fileData);
+			fsCloseStream(&file);
 			return UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
 		}
 
@@ -1085,6 +1330,8 @@ static UploadFunctionResult loadGeometry(Renderer* pRenderer, CopyEngine* pCopyE
 #endif
 
 		// Load buffers located in separate files (.bin) using our file system
+		// Mapped files are referenced in place and kept open until the gltf data is freed
+		FileStream* pBufferStreams = (FileStream*)tf_calloc(data->buffers_count ? data->buffers_count : 1, sizeof(FileStream));
 		for (uint32_t i = 0; i < data->buffers_count; ++i)
 		{
 			const char* uri = data->buffers[i].uri;
@@ -1104,10 +1351,18 @@ static UploadFunctionResult loadGeometry(Renderer* pRenderer, CopyEngine* pCopyE
 				if (fsOpenStreamFromPath(RD_MESHES, path, FM_READ_BINARY, &fs))
 				{
 					ASSERT(fsGetStreamFileSize(&fs) >= (ssize_t)data->buffers[i].size);
+					const void* mapped = fsGetStreamBufferIfPresent(&fs);
+					if (mapped)
+					{
+						data->buffers[i].data = (void*)mapped;
+						pBufferStreams[i] = fs;
+						continue;
+					}
+
 					data->buffers[i].data = tf_malloc(data->buffers[i].size);
 					fsReadFromStream(&fs, data->buffers[i].data, data->buffers[i].size);
+					fsCloseStream(&fs);
 				}
-				fsCloseStream(&fs);
 			}
 		}
 
@@ -1116,12 +1371,13 @@ static UploadFunctionResult loadGeometry(Renderer* pRenderer, CopyEngine* pCopyE
 		{
 			LOGF(eERROR, "Failed to load buffers from gltf file %s with error %u", pDesc->pFileName, (uint32_t)result);
 			ASSERT(false);
+			util_cgltf_close_buffer_streams(data, pBufferStreams);
+			cgltf_free(data);
 			tf_free(fileData);
+			fsCloseStream(&file);
 			return UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
 		}
 
-		typedef void (*PackingFunction)(uint32_t count, uint32_t stride, uint32_t offset, const uint8_t* src, uint8_t* dst);
-
 		uint32_t vertexStrides[SEMANTIC_TEXCOORD9 + 1] = {};
 		uint32_t vertexAttribCount[SEMANTIC_TEXCOORD9 + 1] = {};
 		uint32_t vertexOffsets[SEMANTIC_TEXCOORD9 + 1] = {};
@@ -1271,7 +1527,7 @@ static UploadFunctionResult loadGeometry(Renderer* pRenderer, CopyEngine* pCopyE
 #if UMA
 		indexUpdateDesc.mInternal.mMappedRange = { (uint8_t*)geom->pIndexBuffer->pCpuMappedAddress };
 #else
-		indexUpdateDesc.mInternal.mMappedRange = allocateStagingMemory(indexUpdateDesc.mSize, RESOURCE_BUFFER_ALIGNMENT);
+		indexUpdateDesc.mInternal.mMappedRange = pAllocateUpload(indexUpdateDesc.mSize, RESOURCE_BUFFER_ALIGNMENT);
 #endif
 		indexUpdateDesc.pMappedData = indexUpdateDesc.mInternal.mMappedRange.pData;
 
@@ -1299,12 +1555,32 @@ static UploadFunctionResult loadGeometry(Renderer* pRenderer, CopyEngine* pCopyE
 #if UMA
 			vertexUpdateDesc[i].mInternal.mMappedRange = { (uint8_t*)geom->pVertexBuffers[bufferCounter]->pCpuMappedAddress, 0 };
 #else
-			vertexUpdateDesc[i].mInternal.mMappedRange = allocateStagingMemory(vertexUpdateDesc[i].mSize, RESOURCE_BUFFER_ALIGNMENT);
+			vertexUpdateDesc[i].mInternal.mMappedRange = pAllocateUpload(vertexUpdateDesc[i].mSize, RESOURCE_BUFFER_ALIGNMENT);
 #endif
 			vertexUpdateDesc[i].pMappedData = vertexUpdateDesc[i].mInternal.mMappedRange.pData;
 			++bufferCounter;
 		}
 
+		// Primitive local indices and vertex remaps, kept for the shadow copy
+		uint32_t* pOptimizedIndices = NULL;
+		uint32_t* pVertexRemaps = NULL;
+		uint8_t* pRemappedAttribute = NULL;
+		if (pDesc->mFlags & GEOMETRY_LOAD_FLAG_OPTIMIZE)
+		{
+			uint32_t maxAttributeSize = 0;
+			for (uint32_t i = 0; i < data->meshes_count; ++i)
+				for (uint32_t p = 0; p < data->meshes[i].primitives_count; ++p)
+					for (uint32_t a = 0; a < data->meshes[i].primitives[p].attributes_count; ++a)
+					{
+						const cgltf_accessor* accessor = data->meshes[i].primitives[p].attributes[a].data;
+						maxAttributeSize = max(maxAttributeSize, (uint32_t)(accessor->count * accessor->stride));
+					}
+
+			pOptimizedIndices = (uint32_t*)tf_malloc(indexCount * sizeof(uint32_t));
+			pVertexRemaps = (uint32_t*)tf_malloc(vertexCount * sizeof(uint32_t));
+			pRemappedAttribute = (uint8_t*)tf_malloc(maxAttributeSize);
+		}
+
 		indexCount = 0;
 		vertexCount = 0;
 		drawCount = 0;
@@ -1314,20 +1590,36 @@ static UploadFunctionResult loadGeometry(Renderer* pRenderer, CopyEngine* pCopyE
 			for (uint32_t p = 0; p < data->meshes[i].primitives_count; ++p)
 			{
 				const cgltf_primitive* prim = &data->meshes[i].primitives[p];
+				const uint32_t* pPrimitiveIndices = NULL;
+				const uint32_t* pPrimitiveRemap = NULL;
+				if (pOptimizedIndices)
+				{
+					util_optimize_primitive(prim, pOptimizedIndices + indexCount, pVertexRemaps + vertexCount);
+					pPrimitiveIndices = pOptimizedIndices + indexCount;
+					pPrimitiveRemap = pVertexRemaps + vertexCount;
+				}
 				/************************************************************************/
 				// Fill index buffer for this primitive
 				/************************************************************************/
 				if (sizeof(uint16_t) == indexStride)
 				{
 					uint16_t* dst = (uint16_t*)indexUpdateDesc.pMappedData;
-					for (uint32_t idx = 0; idx < prim->indices->count; ++idx)
-						dst[indexCount + idx] = vertexCount + (uint16_t)cgltf_accessor_read_index(prim->indices, idx);
+					if (pPrimitiveIndices)
+						for (uint32_t idx = 0; idx < prim->indices->count; ++idx)
+							dst[indexCount + idx] = vertexCount + (uint16_t)pPrimitiveIndices[idx];
+					else
+						for (uint32_t idx = 0; idx < prim->indices->count; ++idx)
+							dst[indexCount + idx] = vertexCount + (uint16_t)cgltf_accessor_read_index(prim->indices, idx);
 				}
 				else
 				{
 					uint32_t* dst = (uint32_t*)indexUpdateDesc.pMappedData;
-					for (uint32_t idx = 0; idx < prim->indices->count; ++idx)
-						dst[indexCount + idx] = vertexCount + (uint32_t)cgltf_accessor_read_index(prim->indices, idx);
+					if (pPrimitiveIndices)
+						for (uint32_t idx = 0; idx < prim->indices->count; ++idx)
+							dst[indexCount + idx] = vertexCount + pPrimitiveIndices[idx];
+					else
+						for (uint32_t idx = 0; idx < prim->indices->count; ++idx)
+							dst[indexCount + idx] = vertexCount + (uint32_t)cgltf_accessor_read_index(prim->indices, idx);
 				}
 				/************************************************************************/
 				// Fill vertex buffers for this primitive
@@ -1344,13 +1636,19 @@ static UploadFunctionResult loadGeometry(Renderer* pRenderer, CopyEngine* pCopyE
 						const uint32_t stride = vertexStrides[binding];
 						const uint8_t* src = (uint8_t*)attr->data->buffer_view->buffer->data + attr->data->offset + attr->data->buffer_view->offset;
 
+						if (pPrimitiveRemap)
+						{
+							util_remap_vertex_attribute((uint32_t)attr->data->count, (uint32_t)attr->data->stride, pPrimitiveRemap, src, pRemappedAttribute);
+							src = pRemappedAttribute;
+						}
+
 						// If this vertex attribute is not interleaved with any other attribute use fast path instead of copying one by one
 						// In this case a simple memcpy will be enough to transfer the data to the buffer
 						if (1 == vertexAttribCount[binding])
 						{
 							uint8_t* dst = (uint8_t*)vertexUpdateDesc[binding].pMappedData + vertexCount * stride;
 							if (vertexPacking[index])
-								vertexPacking[index]((uint32_t)attr->data->count, (uint32_t)attr->data->stride, 0, src, dst);
+								vertexPacking[index]((uint32_t)attr->data->count, (uint32_t)attr->data->stride, stride, src, dst);
 							else
 								memcpy(dst, src, attr->data->count * attr->data->stride);
 						}
@@ -1361,7 +1659,7 @@ static UploadFunctionResult loadGeometry(Renderer* pRenderer, CopyEngine* pCopyE
 							// Example:
 							// [ POSITION | NORMAL | TEXCOORD ] => [ 0 | 12 | 24 ], [ 32 | 44 | 52 ], ... (vertex stride of 32 => 12 + 12 + 8)
 							if (vertexPacking[index])
-								vertexPacking[index]((uint32_t)attr->data->count, (uint32_t)attr->data->stride, offset, src, dst);
+								vertexPacking[index]((uint32_t)attr->data->count, (uint32_t)attr->data->stride, stride, src, dst + offset);
 							else
 								for (uint32_t e = 0; e < attr->data->count; ++e)
 									memcpy(dst + e * stride + offset, src + e * attr->data->stride, attr->data->stride);
@@ -1386,15 +1684,14 @@ static UploadFunctionResult loadGeometry(Renderer* pRenderer, CopyEngine* pCopyE
 			}
 		}
 
-		UploadFunctionResult uploadResult = UPLOAD_FUNCTION_RESULT_COMPLETED;
 #if !UMA
-		uploadResult = updateBuffer(pRenderer, pCopyEngine, activeSet, indexUpdateDesc);
+		pOutUpdates[(*pOutUpdateCount)++] = indexUpdateDesc;
 
 		for (uint32_t i = 0; i < MAX_VERTEX_BINDINGS; ++i)
 		{
 			if (vertexUpdateDesc[i].pMappedData)
 			{
-				uploadResult = updateBuffer(pRenderer, pCopyEngine, activeSet, vertexUpdateDesc[i]);
+				pOutUpdates[(*pOutUpdateCount)++] = vertexUpdateDesc[i];
 			}
 		}
 #endif
@@ -1450,44 +1747,286 @@ static UploadFunctionResult loadGeometry(Renderer* pRenderer, CopyEngine* pCopyE
 					if (sizeof(uint16_t) == indexStride)
 					{
 						uint16_t* dst = (uint16_t*)geom->pShadow->pIndices;
-						for (uint32_t idx = 0; idx < prim->indices->count; ++idx)
-							dst[indexCount + idx] = vertexCount + (uint16_t)cgltf_accessor_read_index(prim->indices, idx);
+						if (pOptimizedIndices)
+							for (uint32_t idx = 0; idx < prim->indices->count; ++idx)
+								dst[indexCount + idx] = vertexCount + (uint16_t)pOptimizedIndices[indexCount + idx];
+						else
+							for (uint32_t idx = 0; idx < prim->indices->count; ++idx)
+								dst[indexCount + idx] = vertexCount + (uint16_t)cgltf_accessor_read_index(prim->indices, idx);
 					}
 					else
 					{
 						uint32_t* dst = (uint32_t*)geom->pShadow->pIndices;
-						for (uint32_t idx = 0; idx < prim->indices->count; ++idx)
-							dst[indexCount + idx] = vertexCount + (uint32_t)cgltf_accessor_read_index(prim->indices, idx);
+						if (pOptimizedIndices)
+							for (uint32_t idx = 0; idx < prim->indices->count; ++idx)
+								dst[indexCount + idx] = vertexCount + pOptimizedIndices[indexCount + idx];
+						else
+							for (uint32_t idx = 0; idx < prim->indices->count; ++idx)
+								dst[indexCount + idx] = vertexCount + (uint32_t)cgltf_accessor_read_index(prim->indices, idx);
+					}
+
+					for (uint32_t a = 0; a < prim->attributes_count; ++a)
+					{
+						cgltf_attribute* attr = &prim->attributes[a];
+						if (cgltf_attribute_type_position == attr->type)
+						{
+							const uint8_t* src = (uint8_t*)attr->data->buffer_view->buffer->data + attr->data->offset + attr->data->buffer_view->offset;
+							uint8_t* dst = (uint8_t*)geom->pShadow->pAttributes[SEMANTIC_POSITION] + vertexCount * attr->data->stride;
+							if (pVertexRemaps)
+								util_remap_vertex_attribute((uint32_t)attr->data->count, (uint32_t)attr->data->stride, pVertexRemaps + vertexCount, src, dst);
+							else
+								memcpy(dst, src, attr->data->count * attr->data->stride);
+						}
 					}
 
-					for (uint32_t a = 0; a < prim->attributes_count; ++a)
-					{
-						cgltf_attribute* attr = &prim->attributes[a];
-						if (cgltf_attribute_type_position == attr->type)
-						{
-							const uint8_t* src = (uint8_t*)attr->data->buffer_view->buffer->data + attr->data->offset + attr->data->buffer_view->offset;
-							uint8_t* dst = (uint8_t*)geom->pShadow->pAttributes[SEMANTIC_POSITION] + vertexCount * attr->data->stride;
-							memcpy(dst, src, attr->data->count * attr->data->stride);
-						}
-					}
+					indexCount += (uint32_t)prim->indices->count;
+					vertexCount += (uint32_t)prim->attributes->data->count;
+				}
+			}
+		}
+
+		tf_free(pOptimizedIndices);
+		tf_free(pVertexRemaps);
+		tf_free(pRemappedAttribute);
+
+		util_cgltf_close_buffer_streams(data, pBufferStreams);
+		data->file_data = fileData;
+		cgltf_free(data);
+		fsCloseStream(&file);
+
+		tf_free(pDesc->pVertexLayout);
+
+		*pDesc->ppGeometry = geom;
+
+		return UPLOAD_FUNCTION_RESULT_COMPLETED;
+	}
+
+	return UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
+}
+
+static UploadFunctionResult loadGeometry(Renderer* pRenderer, CopyEngine* pCopyEngine, size_t activeSet, UpdateRequest& pGeometryLoad)
+{
+	BufferUpdateDesc updates[MAX_VERTEX_BINDINGS + 1];
+	uint32_t updateCount = 0;
+	UploadFunctionResult uploadResult = decodeGeometry(pRenderer, &pGeometryLoad.geomLoadDesc, NULL, allocateStagingMemory, updates, &updateCount);
+
+	for (uint32_t i = 0; i < updateCount && UPLOAD_FUNCTION_RESULT_COMPLETED == uploadResult; ++i)
+	{
+		uploadResult = updateBuffer(pRenderer, pCopyEngine, activeSet, updates[i]);
+	}
+
+	return uploadResult;
+}
+/************************************************************************/
+// Decode Workers
+/************************************************************************/
+static void decodeResourceTask(void* pUser, uintptr_t)
+{
+	ResourceDecodeTask* pTask = (ResourceDecodeTask*)pUser;
+	ResourceLoader* pLoader = pResourceLoader;
+	Renderer* pRenderer = pLoader->pRenderer;
+
+	if (UPDATE_REQUEST_LOAD_TEXTURE == pTask->mType)
+	{
+		if (TEXTURE_CONTAINER_SVT == pTask->texLoadDesc.mContainer)
+		{
+			pTask->mDeferred = true;
+		}
+		else
+		{
+			pTask->mResult = decodeTexture(pRenderer, &pTask->texLoadDesc, &pTask->mPrefetch, &pTask->mTextureUpdate);
+			if (UPLOAD_FUNCTION_RESULT_COMPLETED == pTask->mResult && pTask->mTextureUpdate.pTexture &&
+				!fillTextureUploadMemory(pRenderer, &pTask->mTextureUpdate))
+			{
+				pTask->mResult = UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
+			}
+		}
+	}
+	else
+	{
+		pTask->mResult = decodeGeometry(pRenderer, &pTask->geomLoadDesc, &pTask->mPrefetch, allocateDecodeMemory, pTask->mBufferUpdates, &pTask->mBufferUpdateCount);
+	}
+
+	// Loaders which open their file through the platform do not take the prefetched copy
+	if (pTask->mPrefetch.pDestination)
+	{
+		tf_free(pTask->mPrefetch.pDestination);
+		pTask->mPrefetch.pDestination = NULL;
+	}
+
+	pLoader->mDecodeMutex.Acquire();
+	pTask->mDone = true;
+	pLoader->mDecodeMutex.Release();
+	pLoader->mDecodeCond.WakeAll();
+}
+
+static ResourceDecodeTask* allocDecodeTask(ResourceLoader* pLoader, UpdateRequestType type)
+{
+	if (!pLoader->pDecodeThreadSystem)
+	{
+		return NULL;
+	}
+
+	ResourceDecodeTask* pTask = (ResourceDecodeTask*)tf_calloc(1, sizeof(ResourceDecodeTask));
+	pTask->mType = type;
+	pTask->mResult = UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
+	return pTask;
+}
+
+/// Sets up the read ahead of the whole file for a decode task.
+/// Returns false without a prefetch queue and for loads whose file is opened by a platform loader.
+static bool prepareDecodePrefetch(ResourceLoader* pLoader, ResourceDecodeTask* pTask)
+{
+	if (!pLoader->pPrefetchQueue)
+	{
+		return false;
+	}
+
+	AsyncReadRequest& request = pTask->mPrefetch;
+	if (UPDATE_REQUEST_LOAD_TEXTURE == pTask->mType)
+	{
+		if (!pTask->texLoadDesc.pFileName)
+		{
+			return false;
+		}
+
+		TextureContainerType container = util_get_texture_file_name(&pTask->texLoadDesc, pTask->mPrefetchFileName);
+		// Xbox DDS, GNF and sparse textures are read by their own loaders
+#if defined(XBOX)
+		if (TEXTURE_CONTAINER_KTX != container && TEXTURE_CONTAINER_BASIS != container)
+#else
+		if (TEXTURE_CONTAINER_DDS != container && TEXTURE_CONTAINER_KTX != container && TEXTURE_CONTAINER_BASIS != container)
+#endif
+		{
+			return false;
+		}
+		request.mResourceDir = RD_TEXTURES;
+	}
+	else
+	{
+		strncpy(pTask->mPrefetchFileName, pTask->geomLoadDesc.pFileName, FS_MAX_PATH - 1);
+		request.mResourceDir = RD_MESHES;
+	}
+
+	request.pFileName = pTask->mPrefetchFileName;
+	request.pUserData = pTask;
+	return true;
+}
+
+/// Hands a load to the decode workers, going through the prefetch thread first if its file can be read ahead
+static void dispatchDecodeTask(ResourceLoader* pLoader, ResourceDecodeTask* pTask)
+{
+	if (prepareDecodePrefetch(pLoader, pTask))
+	{
+		pLoader->mPrefetchMutex.Acquire();
+		pLoader->mPrefetchRequests.push_back(pTask);
+		pLoader->mPrefetchMutex.Release();
+		pLoader->mPrefetchCond.WakeOne();
+		return;
+	}
+
+	addThreadSystemTask(pLoader->pDecodeThreadSystem, decodeResourceTask, pTask);
+}
+
+/// Keeps up to mReadPrefetchDepth whole-file reads in flight and passes every finished read on to the decode workers.
+/// Reads finish in any order, the copy thread still records the loads in queue order.
+static void prefetchThreadFunc(void* pThreadData)
+{
+	ResourceLoader* pLoader = (ResourceLoader*)pThreadData;
+	AsyncReadQueue* pQueue = pLoader->pPrefetchQueue;
+	const uint32_t depth = pLoader->mDesc.mReadPrefetchDepth;
+
+	eastl::vector<ResourceDecodeTask*> pendingTasks;
+	eastl::vector<AsyncReadRequest*> requests;
+	requests.reserve(depth);
+	AsyncReadRequest** ppCompleted = (AsyncReadRequest**)tf_malloc(depth * sizeof(AsyncReadRequest*));
 
-					indexCount += (uint32_t)prim->indices->count;
-					vertexCount += (uint32_t)prim->attributes->data->count;
-				}
-			}
+	for (;;)
+	{
+		pLoader->mPrefetchMutex.Acquire();
+		while (pLoader->mRun && pLoader->mPrefetchRequests.empty() && pendingTasks.empty() && !fsGetAsyncReadsInFlight(pQueue))
+		{
+			pLoader->mPrefetchCond.Wait(pLoader->mPrefetchMutex);
 		}
+		pendingTasks.insert(pendingTasks.end(), pLoader->mPrefetchRequests.begin(), pLoader->mPrefetchRequests.end());
+		pLoader->mPrefetchRequests.clear();
+		bool run = pLoader->mRun;
+		pLoader->mPrefetchMutex.Release();
 
-		data->file_data = fileData;
-		cgltf_free(data);
+		if (!run)
+		{
+			break;
+		}
 
-		tf_free(pDesc->pVertexLayout);
+		requests.clear();
+		for (size_t i = 0; i < pendingTasks.size() && requests.size() < depth - fsGetAsyncReadsInFlight(pQueue); ++i)
+		{
+			requests.push_back(&pendingTasks[i]->mPrefetch);
+		}
+		uint32_t submitted = fsSubmitAsyncReads(pQueue, (uint32_t)requests.size(), requests.data());
+		pendingTasks.erase(pendingTasks.begin(), pendingTasks.begin() + submitted);
 
-		*pDesc->ppGeometry = geom;
+		// Loads queued while this waits are submitted as soon as one read finishes
+		uint32_t completed = fsWaitAsyncReads(pQueue, 1, depth, ppCompleted);
+		for (uint32_t i = 0; i < completed; ++i)
+		{
+			addThreadSystemTask(pLoader->pDecodeThreadSystem, decodeResourceTask, ppCompleted[i]->pUserData);
+		}
+	}
+
+	// Every load has to reach the decode workers before the copy thread can exit, the ones not read yet open their files themselves
+	while (fsGetAsyncReadsInFlight(pQueue))
+	{
+		uint32_t completed = fsWaitAsyncReads(pQueue, 1, depth, ppCompleted);
+		for (uint32_t i = 0; i < completed; ++i)
+		{
+			addThreadSystemTask(pLoader->pDecodeThreadSystem, decodeResourceTask, ppCompleted[i]->pUserData);
+		}
+	}
+	for (ResourceDecodeTask* pTask : pendingTasks)
+	{
+		addThreadSystemTask(pLoader->pDecodeThreadSystem, decodeResourceTask, pTask);
+	}
+
+	tf_free(ppCompleted);
+}
+
+/// Records the copies for a load decoded by the workers. Requests are recorded in queue order, so this waits for the decode if it is still running.
+static UploadFunctionResult recordDecodedResource(ResourceLoader* pLoader, CopyEngine* pCopyEngine, size_t activeSet, UpdateRequest& request)
+{
+	ResourceDecodeTask* pTask = request.pDecodeTask;
 
-		return uploadResult;
+	pLoader->mDecodeMutex.Acquire();
+	while (!pTask->mDone)
+	{
+		pLoader->mDecodeCond.Wait(pLoader->mDecodeMutex);
 	}
+	pLoader->mDecodeMutex.Release();
 
-	return UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
+	CopyResourceSet& resourceSet = pCopyEngine->resourceSets[activeSet];
+	UploadFunctionResult result = pTask->mResult;
+	if (pTask->mDeferred)
+	{
+		result = loadTexture(pLoader->pRenderer, pCopyEngine, activeSet, request);
+	}
+	else if (UPLOAD_FUNCTION_RESULT_COMPLETED == result)
+	{
+		if (pTask->mTextureUpdate.pTexture)
+		{
+			result = updateTexture(pLoader->pRenderer, pCopyEngine, activeSet, pTask->mTextureUpdate);
+			resourceSet.mTempBuffers.push_back(pTask->mTextureUpdate.mRange.pBuffer);
+		}
+
+		for (uint32_t i = 0; i < pTask->mBufferUpdateCount; ++i)
+		{
+			result = updateBuffer(pLoader->pRenderer, pCopyEngine, activeSet, pTask->mBufferUpdates[i]);
+			resourceSet.mTempBuffers.push_back(pTask->mBufferUpdates[i].mInternal.mMappedRange.pBuffer);
+		}
+	}
+
+	tf_free(pTask);
+	request.pDecodeTask = NULL;
+	return result;
 }
 /************************************************************************/
 // Internal Resource Loader Implementation
@@ -1597,10 +2136,16 @@ static void streamerThreadFunc(void* pThreadData)
 					result = UPLOAD_FUNCTION_RESULT_COMPLETED;
 					break;
 				case UPDATE_REQUEST_LOAD_TEXTURE:
-					result = loadTexture(pLoader->pRenderer, &copyEngine, pLoader->mNextSet, updateState);
+					if (updateState.pDecodeTask)
+						result = recordDecodedResource(pLoader, &copyEngine, pLoader->mNextSet, updateState);
+					else
+						result = loadTexture(pLoader->pRenderer, &copyEngine, pLoader->mNextSet, updateState);
 					break;
 				case UPDATE_REQUEST_LOAD_GEOMETRY:
-					result = loadGeometry(pLoader->pRenderer, &copyEngine, pLoader->mNextSet, updateState);
+					if (updateState.pDecodeTask)
+						result = recordDecodedResource(pLoader, &copyEngine, pLoader->mNextSet, updateState);
+					else
+						result = loadGeometry(pLoader->pRenderer, &copyEngine, pLoader->mNextSet, updateState);
 					break;
 				case UPDATE_REQUEST_INVALID:
 					break;
@@ -1651,6 +2196,12 @@ static void streamerThreadFunc(void* pThreadData)
 		cleanupCopyEngine(pLoader->pRenderer, &pLoader->pCopyEngines[nodeIndex]);
 	}
 
+	// Requests left in the queue may still be decoding
+	if (pLoader->pDecodeThreadSystem)
+	{
+		waitThreadSystemIdle(pLoader->pDecodeThreadSystem);
+	}
+
 	freeAllUploadMemory();
 
 #if defined(GLES)
@@ -1659,6 +2210,21 @@ static void streamerThreadFunc(void* pThreadData)
 #endif
 }
 
+static void destroyDeferredRemoval(void* pUserData, const DeferredRemoval& removal)
+{
+	Renderer* pRenderer = (Renderer*)pUserData;
+	switch (removal.mType)
+	{
+		case DEFERRED_REMOVAL_BUFFER: removeBuffer(pRenderer, (Buffer*)removal.pObject); break;
+		case DEFERRED_REMOVAL_TEXTURE: removeTexture(pRenderer, (Texture*)removal.pObject); break;
+		case DEFERRED_REMOVAL_GEOMETRY: removeResource((Geometry*)removal.pObject); break;
+		case DEFERRED_REMOVAL_RENDER_TARGET: removeRenderTarget(pRenderer, (RenderTarget*)removal.pObject); break;
+		case DEFERRED_REMOVAL_SWAP_CHAIN: removeSwapChain(pRenderer, (SwapChain*)removal.pObject); break;
+		case DEFERRED_REMOVAL_PIPELINE: removePipeline(pRenderer, (Pipeline*)removal.pObject); break;
+		default: ASSERT(false); break;
+	}
+}
+
 static void addResourceLoader(Renderer* pRenderer, ResourceLoaderDesc* pDesc, ResourceLoader** ppLoader)
 {
 	ResourceLoader* pLoader = tf_new(ResourceLoader);
@@ -1667,10 +2233,20 @@ static void addResourceLoader(Renderer* pRenderer, ResourceLoaderDesc* pDesc, Re
 	pLoader->mRun = true;
 	pLoader->mDesc = pDesc ? *pDesc : gDefaultResourceLoaderDesc;
 
+	// Temporary memory of GEOMETRY_LOAD_FLAG_OPTIMIZE
+	meshopt_setAllocator(util_meshopt_allocate, util_meshopt_deallocate);
+
 	pLoader->mQueueMutex.Init();
 	pLoader->mTokenMutex.Init();
 	pLoader->mQueueCond.Init();
 	pLoader->mTokenCond.Init();
+	pLoader->mDecodeMutex.Init();
+	pLoader->mDecodeCond.Init();
+	pLoader->mShaderCacheMutex.Init();
+	pLoader->mShaderCacheCond.Init();
+	pLoader->mShaderCacheLoaded = false;
+	pLoader->mShaderCacheDirty = false;
+	pLoader->mDeferredRemovals.init(destroyDeferredRemoval, pLoader->pRenderer);
 
 	pLoader->mTokenCounter = 0;
 	pLoader->mTokenCompleted = 0;
@@ -1695,6 +2271,30 @@ static void addResourceLoader(Renderer* pRenderer, ResourceLoaderDesc* pDesc, Re
 	pLoader->mDesc.mSingleThreaded = true;
 #endif
 
+	// Create the decode workers before the loader thread so every queued load can be handed to them.
+	// GLES workers would need their own context to create resources and NX can not read files straight into upload memory.
+	pLoader->pDecodeThreadSystem = NULL;
+#if !defined(GLES) && !defined(NX64)
+	if (!pLoader->mDesc.mSingleThreaded)
+	{
+		uint32_t decodeThreadCount = pLoader->mDesc.mDecodeThreadCount ? pLoader->mDesc.mDecodeThreadCount : MAX_LOAD_THREADS;
+		initThreadSystem(&pLoader->pDecodeThreadSystem, decodeThreadCount, 0, true, "ResourceDecode");
+	}
+#endif
+
+	// Reads ahead of the decode workers so many file reads are in flight at once instead of one per worker
+	pLoader->pPrefetchQueue = NULL;
+	if (pLoader->pDecodeThreadSystem && pLoader->mDesc.mReadPrefetchDepth)
+	{
+		pLoader->mPrefetchMutex.Init();
+		pLoader->mPrefetchCond.Init();
+		fsCreateAsyncReadQueue(pLoader->mDesc.mReadPrefetchDepth, &pLoader->pPrefetchQueue);
+
+		pLoader->mPrefetchThreadDesc.pFunc = prefetchThreadFunc;
+		pLoader->mPrefetchThreadDesc.pData = pLoader;
+		pLoader->mPrefetchThread = create_thread(&pLoader->mPrefetchThreadDesc);
+	}
+
 	// Create dedicated resource loader thread.
 	if (!pLoader->mDesc.mSingleThreaded)
 	{
@@ -1706,8 +2306,25 @@ static void addResourceLoader(Renderer* pRenderer, ResourceLoaderDesc* pDesc, Re
 
 static void removeResourceLoader(ResourceLoader* pLoader)
 {
+	// The application idles its queues before shutting down, nothing waiting for removal can still be in use
+	pLoader->mDeferredRemovals.exit();
+
 	pLoader->mRun = false;
 
+	// Stop the prefetch thread first, it hands every load it still holds to the decode workers the copy thread waits on
+	if (pLoader->pPrefetchQueue)
+	{
+		// Taking the lock keeps the wake from slipping in between the thread's check of mRun and its wait
+		pLoader->mPrefetchMutex.Acquire();
+		pLoader->mPrefetchMutex.Release();
+		pLoader->mPrefetchCond.WakeOne();
+		destroy_thread(pLoader->mPrefetchThread);
+
+		fsDestroyAsyncReadQueue(pLoader->pPrefetchQueue);
+		pLoader->mPrefetchCond.Destroy();
+		pLoader->mPrefetchMutex.Destroy();
+	}
+
 	if (pLoader->mDesc.mSingleThreaded)
 	{
 		streamerThreadFunc(pLoader);
@@ -1718,10 +2335,19 @@ static void removeResourceLoader(ResourceLoader* pLoader)
 		destroy_thread(pLoader->mThread);
 	}
 
+	if (pLoader->pDecodeThreadSystem)
+	{
+		shutdownThreadSystem(pLoader->pDecodeThreadSystem);
+	}
+
 	pLoader->mQueueCond.Destroy();
 	pLoader->mTokenCond.Destroy();
+	pLoader->mDecodeCond.Destroy();
+	pLoader->mShaderCacheCond.Destroy();
 	pLoader->mQueueMutex.Destroy();
 	pLoader->mTokenMutex.Destroy();
+	pLoader->mDecodeMutex.Destroy();
+	pLoader->mShaderCacheMutex.Destroy();
 
 	tf_delete(pLoader);
 }
@@ -1746,28 +2372,42 @@ static void queueBufferUpdate(ResourceLoader* pLoader, BufferUpdateDesc* pBuffer
 static void queueTextureLoad(ResourceLoader* pLoader, TextureLoadDesc* pTextureUpdate, SyncToken* token)
 {
 	uint32_t nodeIndex = pTextureUpdate->mNodeIndex;
+	ResourceDecodeTask* pDecodeTask = allocDecodeTask(pLoader, UPDATE_REQUEST_LOAD_TEXTURE);
+	if (pDecodeTask)
+		pDecodeTask->texLoadDesc = *pTextureUpdate;
+
 	pLoader->mQueueMutex.Acquire();
 
 	SyncToken t = tfrg_atomic64_add_relaxed(&pLoader->mTokenCounter, 1) + 1;
 
 	pLoader->mRequestQueue[nodeIndex].emplace_back(UpdateRequest(*pTextureUpdate));
 	pLoader->mRequestQueue[nodeIndex].back().mWaitIndex = t;
+	pLoader->mRequestQueue[nodeIndex].back().pDecodeTask = pDecodeTask;
 	pLoader->mQueueMutex.Release();
 	pLoader->mQueueCond.WakeOne();
+	if (pDecodeTask)
+		dispatchDecodeTask(pLoader, pDecodeTask);
 	if (token) *token = max(t, *token);
 }
 
 static void queueGeometryLoad(ResourceLoader* pLoader, GeometryLoadDesc* pGeometryLoad, SyncToken* token)
 {
 	uint32_t nodeIndex = pGeometryLoad->mNodeIndex;
+	ResourceDecodeTask* pDecodeTask = allocDecodeTask(pLoader, UPDATE_REQUEST_LOAD_GEOMETRY);
+	if (pDecodeTask)
+		pDecodeTask->geomLoadDesc = *pGeometryLoad;
+
 	pLoader->mQueueMutex.Acquire();
 
 	SyncToken t = tfrg_atomic64_add_relaxed(&pLoader->mTokenCounter, 1) + 1;
 
 	pLoader->mRequestQueue[nodeIndex].emplace_back(UpdateRequest(*pGeometryLoad));
 	pLoader->mRequestQueue[nodeIndex].back().mWaitIndex = t;
+	pLoader->mRequestQueue[nodeIndex].back().pDecodeTask = pDecodeTask;
 	pLoader->mQueueMutex.Release();
 	pLoader->mQueueCond.WakeOne();
+	if (pDecodeTask)
+		dispatchDecodeTask(pLoader, pDecodeTask);
 	if (token) *token = max(t, *token);
 }
 
@@ -1987,6 +2627,25 @@ void removeResource(Geometry* pGeom)
 	tf_free(pGeom);
 }
 
+void removeResourceDeferred(Buffer* pBuffer) { pResourceLoader->mDeferredRemovals.queue(DEFERRED_REMOVAL_BUFFER, pBuffer); }
+
+void removeResourceDeferred(Texture* pTexture) { pResourceLoader->mDeferredRemovals.queue(DEFERRED_REMOVAL_TEXTURE, pTexture); }
+
+void removeResourceDeferred(Geometry* pGeom) { pResourceLoader->mDeferredRemovals.queue(DEFERRED_REMOVAL_GEOMETRY, pGeom); }
+
+void removeRenderTargetDeferred(RenderTarget* pRenderTarget)
+{
+	pResourceLoader->mDeferredRemovals.queue(DEFERRED_REMOVAL_RENDER_TARGET, pRenderTarget);
+}
+
+void removeSwapChainDeferred(SwapChain* pSwapChain) { pResourceLoader->mDeferredRemovals.queue(DEFERRED_REMOVAL_SWAP_CHAIN, pSwapChain); }
+
+void removePipelineDeferred(Pipeline* pPipeline) { pResourceLoader->mDeferredRemovals.queue(DEFERRED_REMOVAL_PIPELINE, pPipeline); }
+
+void beginResourceFrame(uint32_t framesInFlight) { pResourceLoader->mDeferredRemovals.beginFrame(framesInFlight); }
+
+void flushDeferredRemovals() { pResourceLoader->mDeferredRemovals.flush(); }
+
 void beginUpdateResource(BufferUpdateDesc* pBufferUpdate)
 {
 	Buffer* pBuffer = pBufferUpdate->pBuffer;
@@ -2047,9 +2706,18 @@ void beginUpdateResource(TextureUpdateDesc* pTextureUpdate)
 	const TinyImageFormat fmt = (TinyImageFormat)texture->mFormat;
 	const uint32_t alignment = util_get_texture_subresource_alignment(pResourceLoader->pRenderer, fmt);
 
+	// A region only stages its own rows
+	const bool hasRegion = pTextureUpdate->mRegionWidth && pTextureUpdate->mRegionHeight;
+	const uint32_t width = MIP_REDUCE(texture->mWidth, pTextureUpdate->mMipLevel);
+	const uint32_t height = MIP_REDUCE(texture->mHeight, pTextureUpdate->mMipLevel);
+	ASSERT(!hasRegion || (texture->mDepth == 1 && pTextureUpdate->mRegionX + pTextureUpdate->mRegionWidth <= width &&
+						  pTextureUpdate->mRegionY + pTextureUpdate->mRegionHeight <= height));
+	ASSERT(!hasRegion || (pTextureUpdate->mRegionX % TinyImageFormat_WidthOfBlock(fmt) == 0 &&
+						  pTextureUpdate->mRegionY % TinyImageFormat_HeightOfBlock(fmt) == 0));
+
 	bool success = util_get_surface_info(
-		MIP_REDUCE(texture->mWidth, pTextureUpdate->mMipLevel),
-		MIP_REDUCE(texture->mHeight, pTextureUpdate->mMipLevel),
+		hasRegion ? pTextureUpdate->mRegionWidth : width,
+		hasRegion ? pTextureUpdate->mRegionHeight : height,
 		fmt,
 		&pTextureUpdate->mSrcSliceStride,
 		&pTextureUpdate->mSrcRowStride,
@@ -2079,6 +2747,10 @@ void endUpdateResource(TextureUpdateDesc* pTextureUpdate, SyncToken* token)
 	desc.mMipLevels = 1;
 	desc.mBaseArrayLayer = pTextureUpdate->mArrayLayer;
 	desc.mLayerCount = 1;
+	desc.mRegionX = pTextureUpdate->mRegionX;
+	desc.mRegionY = pTextureUpdate->mRegionY;
+	desc.mRegionWidth = pTextureUpdate->mRegionWidth;
+	desc.mRegionHeight = pTextureUpdate->mRegionHeight;
 	queueTextureUpdate(pResourceLoader, &desc, token);
 
 	// Restore the state to before the beginUpdateResource call.
@@ -2411,59 +3083,71 @@ extern void gl_compileShader(Renderer* pRenderer, ShaderTarget target, ShaderSta
 	bool enablePrimitiveId, uint32_t macroCount, ShaderMacro* pMacros, BinaryShaderStageDesc* pOut, const char* pEntryPoint);
 #endif
 
-static eastl::string fsReadFromStreamSTLLine(FileStream* stream)
+// Returns the next line of `text` starting at `*pPos`, a "\r\n" sequence or a null character also ends the line
+static eastl::string util_read_source_line(const eastl::string& text, size_t* pPos)
 {
 	eastl::string result;
+	size_t pos = *pPos;
 
-	while (!fsStreamAtEnd(stream))
+	while (pos < text.size())
 	{
-		char nextChar = 0;
-		fsReadFromStream(stream, &nextChar, sizeof(nextChar));
+		char nextChar = text[pos++];
 		if (nextChar == 0 || nextChar == '\n')
 		{
 			break;
 		}
-		if (nextChar == '\r')
+		if (nextChar == '\r' && pos < text.size() && text[pos] == '\n')
 		{
-			char newLine = 0;
-			fsReadFromStream(stream, &newLine, sizeof(newLine));
-			if (newLine == '\n')
-			{
-				break;
-			}
-			else
-			{
-				// We're not looking at a "\r\n" sequence, so add the '\r' to the buffer.
-				fsSeekStream(stream, SBO_CURRENT_POSITION, -1);
-			}
+			++pos;
+			break;
 		}
 		result.push_back(nextChar);
 	}
 
+	*pPos = pos;
 	return result;
 }
 
-// Function to generate the timestamp of this shader source file considering all include file timestamp
+static uint64_t util_hash_shader_data(const void* pData, size_t size)
+{
+	// The bundled MurmurHash3 only has the 32 bit variant, two seeds make a 64 bit key
+	uint32_t low = 0;
+	uint32_t high = 0;
+	MurmurHash3_x86_32(pData, (int)size, 0, &low);
+	MurmurHash3_x86_32(pData, (int)size, 0x9747b28c, &high);
+	return ((uint64_t)high << 32) | low;
+}
+
+// Collects the shader source and every file it includes. The path and content hash of each file go into `outKeyData`
+// and the include paths into `outDependencies`, so the binary cache can tell when anything the shader sees has changed.
 #if !defined(NX64)
-static bool process_source_file(const char* pAppName, FileStream* original, const char* filePath, FileStream* file, time_t& outTimeStamp, eastl::string& outCode)
+static bool process_source_file(
+	const char* pAppName, FileStream* original, const char* filePath, FileStream* file, eastl::vector<eastl::string>& outDependencies,
+	eastl::string& outKeyData, eastl::string& outCode)
 {
-	// If the source if a non-packaged file, store the timestamp
-	if (file)
+	if (!file)
 	{
-		time_t fileTimeStamp = fsGetLastModifiedTime(RD_SHADER_SOURCES, filePath);
-
-		if (fileTimeStamp > outTimeStamp)
-			outTimeStamp = fileTimeStamp;
+		return true; // The source file is missing, but we may still be able to use the shader binary.
 	}
-	else
+
+	// Read the whole file at once, the include scan and the hash both need all of it
+	eastl::string text;
+	ssize_t fileSize = fsGetStreamFileSize(file);
+	if (fileSize > 0)
 	{
-		return true; // The source file is missing, but we may still be able to use the shader binary.
+		text.resize((size_t)fileSize);
+		text.resize(fsReadFromStream(file, &text[0], (size_t)fileSize));
 	}
 
+	uint64_t fileHash = util_hash_shader_data(text.data(), text.size());
+	outKeyData.append(filePath);
+	outKeyData.append((const char*)&fileHash, sizeof(fileHash));
+
 	const eastl::string pIncludeDirective = "#include";
-	while (!fsStreamAtEnd(file))
+	size_t textPos = 0;
+	while (textPos < text.size())
 	{
-		eastl::string line = fsReadFromStreamSTLLine(file);
+		eastl::string line = util_read_source_line(text, &textPos);
 
 		size_t        filePos = line.find(pIncludeDirective, 0);
 		const size_t  commentPosCpp = line.find("//", 0);
@@ -2516,8 +3200,10 @@ static bool process_source_file(const char* pAppName, FileStream* original, cons
 				continue;
 			}
 
+			outDependencies.push_back(includePath);
+
 			// Add the include file into the current code recursively
-			if (!process_source_file(pAppName, original, includePath, &fHandle, outTimeStamp, outCode))
+			if (!process_source_file(pAppName, original, includePath, &fHandle, outDependencies, outKeyData, outCode))
 			{
 				fsCloseStream(&fHandle);
 				return false;
@@ -2554,19 +3240,124 @@ static bool process_source_file(const char* pAppName, FileStream* original, cons
 }
 #endif
 
-// Loads the bytecode from file if the binary shader file is newer than the source
-bool check_for_byte_code(Renderer* pRenderer, const char* binaryShaderPath, time_t sourceTimeStamp, BinaryShaderStageDesc* pOut)
+/************************************************************************/
+// Shader binary cache
+/************************************************************************/
+// The index maps every binary to the content key it was compiled from and the files it includes. A binary is reused when
+// the key of the current sources, macros, entry point and target matches, timestamps are not looked at.
+#define SHADER_CACHE_INDEX_FILE "ShaderCache.index"
+#define SHADER_CACHE_INDEX_HEADER "ShaderCacheIndex 1"
+
+// Called with mShaderCacheMutex held
+static void loadShaderCacheIndex(ResourceLoader* pLoader)
+{
+	pLoader->mShaderCacheLoaded = true;
+
+	FileStream fh = {};
+	if (!fsOpenStreamFromPath(RD_SHADER_BINARIES, SHADER_CACHE_INDEX_FILE, FM_READ_BINARY, &fh))
+		return;
+
+	eastl::string text;
+	ssize_t fileSize = fsGetStreamFileSize(&fh);
+	if (fileSize > 0)
+	{
+		text.resize((size_t)fileSize);
+		text.resize(fsReadFromStream(&fh, &text[0], (size_t)fileSize));
+	}
+	fsCloseStream(&fh);
+
+	size_t pos = 0;
+	if (util_read_source_line(text, &pos) != SHADER_CACHE_INDEX_HEADER)
+	{
+		LOGF(LogLevel::eWARNING, "Ignoring shader cache index with unknown version");
+		return;
+	}
+
+	// <binary name>\t<key>\t<dependency count> followed by one \t<dependency> line per dependency
+	while (pos < text.size())
+	{
+		eastl::string line = util_read_source_line(text, &pos);
+		size_t keyStart = line.find('\t');
+		size_t countStart = keyStart != eastl::string::npos ? line.find('\t', keyStart + 1) : eastl::string::npos;
+		if (countStart == eastl::string::npos)
+			continue;
+
+		ShaderCacheEntry entry = {};
+		entry.mKey = strtoull(line.c_str() + keyStart + 1, NULL, 16);
+		uint32_t dependencyCount = (uint32_t)strtoul(line.c_str() + countStart + 1, NULL, 10);
+		for (uint32_t i = 0; i < dependencyCount && pos < text.size(); ++i)
+		{
+			eastl::string dependency = util_read_source_line(text, &pos);
+			entry.mDependencies.push_back(dependency.substr(1));
+		}
+
+		pLoader->mShaderCache[line.substr(0, keyStart)] = eastl::move(entry);
+	}
+}
+
+// Called with mShaderCacheMutex held
+static void saveShaderCacheIndex(ResourceLoader* pLoader)
+{
+	eastl::string text = SHADER_CACHE_INDEX_HEADER "\n";
+	for (const eastl::pair<const eastl::string, ShaderCacheEntry>& it : pLoader->mShaderCache)
+	{
+		text.append_sprintf("%s\t%016llx\t%u\n", it.first.c_str(), (unsigned long long)it.second.mKey, (uint32_t)it.second.mDependencies.size());
+		for (const eastl::string& dependency : it.second.mDependencies)
+			text.append_sprintf("\t%s\n", dependency.c_str());
+	}
+
+	FileStream fh = {};
+	if (!fsOpenStreamFromPath(RD_SHADER_BINARIES, SHADER_CACHE_INDEX_FILE, FM_WRITE_BINARY, &fh))
+	{
+		LOGF(LogLevel::eWARNING, "Failed to write shader cache index %s", SHADER_CACHE_INDEX_FILE);
+		return;
+	}
+	fsWriteToStream(&fh, text.c_str(), text.size());
+	fsCloseStream(&fh);
+	pLoader->mShaderCacheDirty = false;
+}
+
+// Waits until no other thread is building `binaryName` and claims it. Returns whether the index says the binary was built from `key`.
+// Every call has to be paired with releaseShaderCacheEntry.
+static bool acquireShaderCacheEntry(ResourceLoader* pLoader, const eastl::string& binaryName, uint64_t key)
 {
-	// If source code is loaded from a package, its timestamp will be zero. Else check that binary is not older
-	// than source
-	time_t dstTimeStamp = fsGetLastModifiedTime(RD_SHADER_BINARIES, binaryShaderPath);
-	if (!sourceTimeStamp || (dstTimeStamp < sourceTimeStamp))
+	if (!pLoader)
 		return false;
 
+	MutexLock lock(pLoader->mShaderCacheMutex);
+	if (!pLoader->mShaderCacheLoaded)
+		loadShaderCacheIndex(pLoader);
+
+	while (pLoader->mShaderCompilesInFlight.find(binaryName) != pLoader->mShaderCompilesInFlight.end())
+		pLoader->mShaderCacheCond.Wait(pLoader->mShaderCacheMutex);
+	pLoader->mShaderCompilesInFlight.insert(binaryName);
+
+	eastl::unordered_map<eastl::string, ShaderCacheEntry>::iterator it = pLoader->mShaderCache.find(binaryName);
+	return it != pLoader->mShaderCache.end() && it->second.mKey == key;
+}
+
+// Stores `pEntry` in the index if the binary was rebuilt
+static void releaseShaderCacheEntry(ResourceLoader* pLoader, const eastl::string& binaryName, ShaderCacheEntry* pEntry)
+{
+	if (!pLoader)
+		return;
+
+	MutexLock lock(pLoader->mShaderCacheMutex);
+	if (pEntry)
+	{
+		pLoader->mShaderCache[binaryName] = eastl::move(*pEntry);
+		pLoader->mShaderCacheDirty = true;
+	}
+	pLoader->mShaderCompilesInFlight.erase(binaryName);
+	pLoader->mShaderCacheCond.WakeAll();
+}
+
+// Loads the bytecode from file
+bool check_for_byte_code(Renderer* pRenderer, const char* binaryShaderPath, BinaryShaderStageDesc* pOut)
+{
 	FileStream fh = {};
 	if (!fsOpenStreamFromPath(RD_SHADER_BINARIES, binaryShaderPath, FM_READ_BINARY, &fh))
 	{
-		LOGF(LogLevel::eERROR, "'%s' is not a valid shader bytecode file", binaryShaderPath);
 		return false;
 	}
 
@@ -2615,7 +3406,8 @@ bool load_shader_stage_byte_code(
 
 	eastl::string code;
 #if !defined(NX64)
-	time_t          timeStamp = 0;
+	eastl::string keyData;
+	ShaderCacheEntry cacheEntry = {};
 #endif
 
 #if !defined(METAL) && !defined(NX64)
@@ -2623,7 +3415,7 @@ bool load_shader_stage_byte_code(
 	bool sourceExists = fsOpenStreamFromPath(RD_SHADER_SOURCES, loadDesc.pFileName, FM_READ_BINARY, &sourceFileStream);
 	ASSERT(sourceExists);
 
-	if (!process_source_file(pRenderer->pName, &sourceFileStream, loadDesc.pFileName, &sourceFileStream, timeStamp, code))
+	if (!process_source_file(pRenderer->pName, &sourceFileStream, loadDesc.pFileName, sourceExists ? &sourceFileStream : NULL, cacheEntry.mDependencies, keyData, code))
 	{
 		fsCloseStream(&sourceFileStream);
 		return false;
@@ -2669,7 +3461,7 @@ bool load_shader_stage_byte_code(
 	FileStream sourceFileStream = {};
 	bool sourceExists = fsOpenStreamFromPath(RD_SHADER_SOURCES, metalShaderPath, FM_READ_BINARY, &sourceFileStream);
 	ASSERT(sourceExists);
-	if (!process_source_file(pRenderer->pName, &sourceFileStream, metalShaderPath, &sourceFileStream, timeStamp, code))
+	if (!process_source_file(pRenderer->pName, &sourceFileStream, metalShaderPath, sourceExists ? &sourceFileStream : NULL, cacheEntry.mDependencies, keyData, code))
 	{
 		fsCloseStream(&sourceFileStream);
 		return false;
@@ -2719,12 +3511,30 @@ bool load_shader_stage_byte_code(
 #endif
 		".bin";
 
-	// Shader source is newer than binary
-	if (!check_for_byte_code(pRenderer, binaryShaderComponent.c_str(), timeStamp, pOut))
+	// Everything the compiler output depends on goes into the key
+	keyData += shaderDefines;
+	keyData.append_sprintf("|%s|%u|%u|%s", loadDesc.pEntryPointName ? loadDesc.pEntryPointName : "", (uint32_t)target, (uint32_t)stage, rendererApi.c_str());
+#if defined(VULKAN) && !defined(__ANDROID__)
+	// glslangValidator picks up the limits in config.conf
+	FileStream confStream = {};
+	if (fsOpenStreamFromPath(RD_SHADER_SOURCES, "config.conf", FM_READ_BINARY, &confStream))
+	{
+		eastl::vector<eastl::string> confDependencies;
+		eastl::string confCode;
+		process_source_file(pRenderer->pName, &confStream, "config.conf", &confStream, confDependencies, keyData, confCode);
+		fsCloseStream(&confStream);
+	}
+#endif
+	cacheEntry.mKey = util_hash_shader_data(keyData.data(), keyData.size());
+
+	// Without sources there is nothing to compare against, use whatever binary is there
+	bool upToDate = acquireShaderCacheEntry(pResourceLoader, binaryShaderComponent, cacheEntry.mKey) || !sourceExists;
+	if (!upToDate || !check_for_byte_code(pRenderer, binaryShaderComponent.c_str(), pOut))
 	{
 		if (!sourceExists)
 		{
 			LOGF(eERROR, "No source shader or precompiled binary present for file %s", fileName);
+			releaseShaderCacheEntry(pResourceLoader, binaryShaderComponent, NULL);
 			return false;
 		}
 
@@ -2781,11 +3591,17 @@ bool load_shader_stage_byte_code(
 		if (!pOut->pByteCode)
 		{
 			LOGF(eERROR, "Error while generating bytecode for shader %s", loadDesc.pFileName);
+			releaseShaderCacheEntry(pResourceLoader, binaryShaderComponent, NULL);
 			fsCloseStream(&sourceFileStream);
 			ASSERT(false);
 			return false;
 		}
 #endif
+		releaseShaderCacheEntry(pResourceLoader, binaryShaderComponent, &cacheEntry);
+	}
+	else
+	{
+		releaseShaderCacheEntry(pResourceLoader, binaryShaderComponent, NULL);
 	}
 #else
 #endif
@@ -2888,170 +3704,284 @@ bool find_shader_stage(
 	return true;
 }
 #endif
-void addShader(Renderer* pRenderer, const ShaderLoadDesc* pDesc, Shader** ppShader)
+// One stage of one shader, every stage of an addShaders call is loaded on its own
+struct ShaderStageLoadJob
 {
-#ifndef DIRECT3D11
-	if ((uint32_t)pDesc->mTarget > pRenderer->mShaderTarget)
-	{
-		eastl::string error = eastl::string().sprintf("Requested shader target (%u) is higher than the shader target that the renderer supports (%u). Shader wont be compiled",
-			(uint32_t)pDesc->mTarget, (uint32_t)pRenderer->mShaderTarget);
-		LOGF(LogLevel::eERROR, error.c_str());
-		return;
-	}
-#endif
+	Renderer*              pRenderer;
+	const ShaderLoadDesc*  pDesc;
+	uint32_t               mShaderIndex;
+	uint32_t               mStageIndex;
+	ShaderStage            mStage;
+	ShaderStage            mAllStages;
+	BinaryShaderStageDesc* pOut;
+	bool                   mLoaded;
+};
+
+struct ShaderLoadBatch
+{
+	ShaderStageLoadJob* pJobs;
+	uint32_t            mRemaining;
+	Mutex               mMutex;
+	ConditionVariable   mCond;
+};
+
+static void loadShaderStage(ShaderStageLoadJob* pJob)
+{
+	Renderer* pRenderer = pJob->pRenderer;
+	const ShaderStageLoadDesc& stageDesc = pJob->pDesc->mStages[pJob->mStageIndex];
+
+	const uint32_t macroCount = stageDesc.mMacroCount + pRenderer->mBuiltinShaderDefinesCount;
+	eastl::vector<ShaderMacro> macros(macroCount);
+	for (uint32_t macro = 0; macro < pRenderer->mBuiltinShaderDefinesCount; ++macro)
+		macros[macro] = pRenderer->pBuiltinShaderDefines[macro];
+	for (uint32_t macro = 0; macro < stageDesc.mMacroCount; ++macro)
+		macros[pRenderer->mBuiltinShaderDefinesCount + macro] = stageDesc.pMacros[macro];
+
+	pJob->mLoaded = load_shader_stage_byte_code(
+		pRenderer, pJob->pDesc->mTarget, pJob->mStage, pJob->mAllStages, stageDesc, macroCount, macros.data(), pJob->pOut);
+}
+
+static void loadShaderStageTask(void* pUser, uintptr_t index)
+{
+	ShaderLoadBatch* pBatch = (ShaderLoadBatch*)pUser;
+	loadShaderStage(&pBatch->pJobs[index]);
 
+	// The caller destroys the batch as soon as it sees the count drop to zero, so signal while holding the lock
+	MutexLock lock(pBatch->mMutex);
+	if (--pBatch->mRemaining == 0)
+		pBatch->mCond.WakeAll();
+}
+
+void addShaders(Renderer* pRenderer, uint32_t shaderCount, const ShaderLoadDesc* pDescs, Shader** ppShaders)
+{
 #ifndef TARGET_IOS
-	BinaryShaderDesc      binaryDesc = {};
-#if defined(METAL)
-	char* pSources[SHADER_STAGE_COUNT] = {};
-#endif
+	eastl::vector<BinaryShaderDesc> binaryDescs(shaderCount);
+	eastl::vector<bool> validShaders(shaderCount, false);
+	eastl::vector<ShaderStageLoadJob> jobs;
 
-	ShaderStage stages = SHADER_STAGE_NONE;
-	for (uint32_t i = 0; i < SHADER_STAGE_COUNT; ++i)
+	for (uint32_t s = 0; s < shaderCount; ++s)
 	{
-		if (pDesc->mStages[i].pFileName && strlen(pDesc->mStages[i].pFileName) != 0)
+		const ShaderLoadDesc* pDesc = &pDescs[s];
+#ifndef DIRECT3D11
+		if ((uint32_t)pDesc->mTarget > pRenderer->mShaderTarget)
+		{
+			eastl::string error = eastl::string().sprintf("Requested shader target (%u) is higher than the shader target that the renderer supports (%u). Shader wont be compiled",
+				(uint32_t)pDesc->mTarget, (uint32_t)pRenderer->mShaderTarget);
+			LOGF(LogLevel::eERROR, error.c_str());
+			continue;
+		}
+#endif
+		validShaders[s] = true;
+
+		BinaryShaderDesc& binaryDesc = binaryDescs[s];
+		binaryDesc = {};
+
+		ShaderStage stages = SHADER_STAGE_NONE;
+		for (uint32_t i = 0; i < SHADER_STAGE_COUNT; ++i)
+		{
+			if (pDesc->mStages[i].pFileName && strlen(pDesc->mStages[i].pFileName) != 0)
+			{
+				ShaderStage            stage;
+				BinaryShaderStageDesc* pStage = NULL;
+				char ext[FS_MAX_PATH] = { 0 };
+				fsGetPathExtension(pDesc->mStages[i].pFileName, ext);
+				if (find_shader_stage(ext, &binaryDesc, &pStage, &stage))
+					stages |= stage;
+			}
+		}
+		for (uint32_t i = 0; i < SHADER_STAGE_COUNT; ++i)
 		{
-			ShaderStage            stage;
-			BinaryShaderStageDesc* pStage = NULL;
-			char ext[FS_MAX_PATH] = { 0 };
-			fsGetPathExtension(pDesc->mStages[i].pFileName, ext);
-			if (find_shader_stage(ext, &binaryDesc, &pStage, &stage))
-				stages |= stage;
+			if (pDesc->mStages[i].pFileName && strlen(pDesc->mStages[i].pFileName) != 0)
+			{
+				ShaderStage            stage;
+				BinaryShaderStageDesc* pStage = NULL;
+				char ext[FS_MAX_PATH] = { 0 };
+				fsGetPathExtension(pDesc->mStages[i].pFileName, ext);
+				if (find_shader_stage(ext, &binaryDesc, &pStage, &stage))
+				{
+					ShaderStageLoadJob job = { pRenderer, pDesc, s, i, stage, stages, pStage, false };
+					jobs.push_back(job);
+				}
+			}
 		}
 	}
-	for (uint32_t i = 0; i < SHADER_STAGE_COUNT; ++i)
+
+	// Cache hits only read files, but misses run the shader compiler. Spread all stages of all shaders over the decode workers.
+#if defined(GLES) || defined(ORBIS) || defined(PROSPERO)
+	// GLES compiles through the context of the calling thread, the console compilers are not known to be thread safe
+	ThreadSystem* pThreadSystem = NULL;
+#else
+	ThreadSystem* pThreadSystem = pResourceLoader ? pResourceLoader->pDecodeThreadSystem : NULL;
+#endif
+	if (pThreadSystem && jobs.size() > 1)
+	{
+		ShaderLoadBatch batch = {};
+		batch.pJobs = jobs.data();
+		batch.mRemaining = (uint32_t)jobs.size();
+		batch.mMutex.Init();
+		batch.mCond.Init();
+
+		for (uint32_t i = 0; i < (uint32_t)jobs.size(); ++i)
+			addThreadSystemTask(pThreadSystem, loadShaderStageTask, &batch, i);
+
+		batch.mMutex.Acquire();
+		while (batch.mRemaining)
+			batch.mCond.Wait(batch.mMutex);
+		batch.mMutex.Release();
+
+		batch.mCond.Destroy();
+		batch.mMutex.Destroy();
+	}
+	else
+	{
+		for (ShaderStageLoadJob& job : jobs)
+			loadShaderStage(&job);
+	}
+
+	for (const ShaderStageLoadJob& job : jobs)
+	{
+		if (!job.mLoaded)
+			validShaders[job.mShaderIndex] = false;
+	}
+
+	uint32_t jobIndex = 0;
+	for (uint32_t s = 0; s < shaderCount; ++s)
 	{
-		if (pDesc->mStages[i].pFileName && strlen(pDesc->mStages[i].pFileName) != 0)
+		BinaryShaderDesc& binaryDesc = binaryDescs[s];
+#if defined(METAL)
+		char* pSources[SHADER_STAGE_COUNT] = {};
+#endif
+		for (; jobIndex < (uint32_t)jobs.size() && jobs[jobIndex].mShaderIndex == s; ++jobIndex)
 		{
-			const char* fileName = pDesc->mStages[i].pFileName;
+			const ShaderStageLoadJob& job = jobs[jobIndex];
+			if (!validShaders[s])
+				continue;
 
-			ShaderStage            stage;
-			BinaryShaderStageDesc* pStage = NULL;
-			char ext[FS_MAX_PATH] = { 0 };
-			fsGetPathExtension(fileName, ext);
-			if (find_shader_stage(ext, &binaryDesc, &pStage, &stage))
-			{
-				const uint32_t macroCount = pDesc->mStages[i].mMacroCount + pRenderer->mBuiltinShaderDefinesCount;
-				eastl::vector<ShaderMacro> macros(macroCount);
-				for (uint32_t macro = 0; macro < pRenderer->mBuiltinShaderDefinesCount; ++macro)
-					macros[macro] = pRenderer->pBuiltinShaderDefines[macro];
-				for (uint32_t macro = 0; macro < pDesc->mStages[i].mMacroCount; ++macro)
-					macros[pRenderer->mBuiltinShaderDefinesCount + macro] = pDesc->mStages[i].pMacros[macro];
-
-				if (!load_shader_stage_byte_code(
-					pRenderer, pDesc->mTarget, stage, stages, pDesc->mStages[i], macroCount, macros.data(),
-					pStage))
-					return;
-
-				binaryDesc.mStages |= stage;
+			const ShaderLoadDesc* pDesc = job.pDesc;
+			const uint32_t i = job.mStageIndex;
+			BinaryShaderStageDesc* pStage = job.pOut;
+			binaryDesc.mStages |= job.mStage;
 #if defined(METAL)
-				if (pDesc->mStages[i].pEntryPointName)
-					pStage->pEntryPoint = pDesc->mStages[i].pEntryPointName;
-				else
-					pStage->pEntryPoint = "stageMain";
-
-				char metalFileName[FS_MAX_PATH] = {0};
-				fsAppendPathExtension(fileName, "metal", metalFileName);
-
-				FileStream fh = {};
-				fsOpenStreamFromPath(RD_SHADER_SOURCES, metalFileName, FM_READ_BINARY, &fh);
-				size_t metalFileSize = fsGetStreamFileSize(&fh);
-				pSources[i] = (char*)tf_malloc(metalFileSize + 1);
-				pStage->pSource = pSources[i];
-				pStage->mSourceSize = (uint32_t)metalFileSize;
-				fsReadFromStream(&fh, pSources[i], metalFileSize);
-				pSources[i][metalFileSize] = 0; // Ensure the shader text is null-terminated
-				fsCloseStream(&fh);
+			if (pDesc->mStages[i].pEntryPointName)
+				pStage->pEntryPoint = pDesc->mStages[i].pEntryPointName;
+			else
+				pStage->pEntryPoint = "stageMain";
+
+			char metalFileName[FS_MAX_PATH] = {0};
+			fsAppendPathExtension(pDesc->mStages[i].pFileName, "metal", metalFileName);
+
+			FileStream fh = {};
+			fsOpenStreamFromPath(RD_SHADER_SOURCES, metalFileName, FM_READ_BINARY, &fh);
+			size_t metalFileSize = fsGetStreamFileSize(&fh);
+			pSources[i] = (char*)tf_malloc(metalFileSize + 1);
+			pStage->pSource = pSources[i];
+			pStage->mSourceSize = (uint32_t)metalFileSize;
+			fsReadFromStream(&fh, pSources[i], metalFileSize);
+			pSources[i][metalFileSize] = 0; // Ensure the shader text is null-terminated
+			fsCloseStream(&fh);
 #elif !defined(ORBIS) && !defined(PROSPERO)
-				if (pDesc->mStages[i].pEntryPointName)
-					pStage->pEntryPoint = pDesc->mStages[i].pEntryPointName;
-				else
-					pStage->pEntryPoint = "main";
+			if (pDesc->mStages[i].pEntryPointName)
+				pStage->pEntryPoint = pDesc->mStages[i].pEntryPointName;
+			else
+				pStage->pEntryPoint = "main";
+#else
+			UNREF_PARAM(pDesc);
+			UNREF_PARAM(i);
+			UNREF_PARAM(pStage);
 #endif
-			}
 		}
-	}
 
+		if (validShaders[s])
+		{
 #if defined(PROSPERO)
-	binaryDesc.mOwnByteCode = true;
+			binaryDesc.mOwnByteCode = true;
 #endif
-
-	addShaderBinary(pRenderer, &binaryDesc, ppShader);
+			addShaderBinary(pRenderer, &binaryDesc, &ppShaders[s]);
+		}
 
 #if defined(METAL)
-	for (uint32_t i = 0; i < SHADER_STAGE_COUNT; ++i)
-	{
-		if (pSources[i])
+		for (uint32_t i = 0; i < SHADER_STAGE_COUNT; ++i)
 		{
-			tf_free(pSources[i]);
+			if (pSources[i])
+			{
+				tf_free(pSources[i]);
+			}
 		}
-	}
 #endif
+	}
+
 #if !defined(PROSPERO)
-	if (binaryDesc.mStages & SHADER_STAGE_VERT)
-		tf_free(binaryDesc.mVert.pByteCode);
-	if (binaryDesc.mStages & SHADER_STAGE_FRAG)
-		tf_free(binaryDesc.mFrag.pByteCode);
-	if (binaryDesc.mStages & SHADER_STAGE_COMP)
-		tf_free(binaryDesc.mComp.pByteCode);
-#if !defined(METAL)
-	if (binaryDesc.mStages & SHADER_STAGE_TESC)
-		tf_free(binaryDesc.mHull.pByteCode);
-	if (binaryDesc.mStages & SHADER_STAGE_TESE)
-		tf_free(binaryDesc.mDomain.pByteCode);
-	if (binaryDesc.mStages & SHADER_STAGE_GEOM)
-		tf_free(binaryDesc.mGeom.pByteCode);
-	if (binaryDesc.mStages & SHADER_STAGE_RAYTRACING)
-		tf_free(binaryDesc.mComp.pByteCode);
-#endif
+	// Stages of shaders which failed to load are freed as well
+	for (const ShaderStageLoadJob& job : jobs)
+	{
+		if (job.mLoaded)
+			tf_free(job.pOut->pByteCode);
+	}
 #endif
-#else
-	// Binary shaders are not supported on iOS.
-	ShaderDesc desc = {};
-	eastl::string codes[SHADER_STAGE_COUNT] = {};
-	ShaderMacro* pMacros[SHADER_STAGE_COUNT] = {};
-	for (uint32_t i = 0; i < SHADER_STAGE_COUNT; ++i)
+
+	if (pResourceLoader)
 	{
-		if (pDesc->mStages[i].pFileName && strlen(pDesc->mStages[i].pFileName))
+		MutexLock lock(pResourceLoader->mShaderCacheMutex);
+		if (pResourceLoader->mShaderCacheDirty)
+			saveShaderCacheIndex(pResourceLoader);
+	}
+#else
+	for (uint32_t s = 0; s < shaderCount; ++s)
+	{
+		const ShaderLoadDesc* pDesc = &pDescs[s];
+		// Binary shaders are not supported on iOS.
+		ShaderDesc desc = {};
+		eastl::string codes[SHADER_STAGE_COUNT] = {};
+		ShaderMacro* pMacros[SHADER_STAGE_COUNT] = {};
+		for (uint32_t i = 0; i < SHADER_STAGE_COUNT; ++i)
 		{
-			ShaderStage stage;
-			ShaderStageDesc* pStage = NULL;
-			if (find_shader_stage(pDesc->mStages[i].pFileName, &desc, &pStage, &stage))
+			if (pDesc->mStages[i].pFileName && strlen(pDesc->mStages[i].pFileName))
 			{
-				char metalFileName[FS_MAX_PATH] = {0};
-				fsAppendPathExtension(pDesc->mStages[i].pFileName, "metal", metalFileName);
-				FileStream fh = {};
-				bool sourceExists = fsOpenStreamFromPath(RD_SHADER_SOURCES, metalFileName, FM_READ_BINARY, &fh);
-				ASSERT(sourceExists);
-
-				pStage->pName = pDesc->mStages[i].pFileName;
-				time_t timestamp = 0;
-				process_source_file(pRenderer->pName, &fh, metalFileName, &fh, timestamp, codes[i]);
-				pStage->pCode = codes[i].c_str();
-				if (pDesc->mStages[i].pEntryPointName)
-					pStage->pEntryPoint = pDesc->mStages[i].pEntryPointName;
-				else
-					pStage->pEntryPoint = "stageMain";
-				// Apply user specified shader macros
-				pStage->mMacroCount = pDesc->mStages[i].mMacroCount + pRenderer->mBuiltinShaderDefinesCount;
-				pMacros[i] = (ShaderMacro*)alloca(pStage->mMacroCount * sizeof(ShaderMacro));
-				pStage->pMacros = pMacros[i];
-				for (uint32_t j = 0; j < pDesc->mStages[i].mMacroCount; j++)
-					pMacros[i][j] = pDesc->mStages[i].pMacros[j];
-				// Apply renderer specified shader macros
-				for (uint32_t j = 0; j < pRenderer->mBuiltinShaderDefinesCount; j++)
+				ShaderStage stage;
+				ShaderStageDesc* pStage = NULL;
+				if (find_shader_stage(pDesc->mStages[i].pFileName, &desc, &pStage, &stage))
 				{
-					pMacros[i][pDesc->mStages[i].mMacroCount + j] = pRenderer->pBuiltinShaderDefines[j];
+					char metalFileName[FS_MAX_PATH] = {0};
+					fsAppendPathExtension(pDesc->mStages[i].pFileName, "metal", metalFileName);
+					FileStream fh = {};
+					bool sourceExists = fsOpenStreamFromPath(RD_SHADER_SOURCES, metalFileName, FM_READ_BINARY, &fh);
+					ASSERT(sourceExists);
+
+					pStage->pName = pDesc->mStages[i].pFileName;
+					eastl::vector<eastl::string> dependencies;
+					eastl::string keyData;
+					process_source_file(pRenderer->pName, &fh, metalFileName, sourceExists ? &fh : NULL, dependencies, keyData, codes[i]);
+					pStage->pCode = codes[i].c_str();
+					if (pDesc->mStages[i].pEntryPointName)
+						pStage->pEntryPoint = pDesc->mStages[i].pEntryPointName;
+					else
+						pStage->pEntryPoint = "stageMain";
+					// Apply user specified shader macros
+					pStage->mMacroCount = pDesc->mStages[i].mMacroCount + pRenderer->mBuiltinShaderDefinesCount;
+					pMacros[i] = (ShaderMacro*)alloca(pStage->mMacroCount * sizeof(ShaderMacro));
+					pStage->pMacros = pMacros[i];
+					for (uint32_t j = 0; j < pDesc->mStages[i].mMacroCount; j++)
+						pMacros[i][j] = pDesc->mStages[i].pMacros[j];
+					// Apply renderer specified shader macros
+					for (uint32_t j = 0; j < pRenderer->mBuiltinShaderDefinesCount; j++)
+					{
+						pMacros[i][pDesc->mStages[i].mMacroCount + j] = pRenderer->pBuiltinShaderDefines[j];
+					}
+					fsCloseStream(&fh);
+					desc.mStages |= stage;
 				}
-				fsCloseStream(&fh);
-				desc.mStages |= stage;
 			}
 		}
-	}
 
-	addShader(pRenderer, &desc, ppShader);
+		addShader(pRenderer, &desc, &ppShaders[s]);
+	}
 #endif
 }
+
+void addShader(Renderer* pRenderer, const ShaderLoadDesc* pDesc, Shader** ppShader)
+{
+	addShaders(pRenderer, 1, pDesc, ppShader);
+}
 /************************************************************************/
 // Pipeline cache save, load
 /************************************************************************/
@@ -0,0 +1,436 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+#pragma once
+
+// Vertex attribute packing used by loadGeometry. Kept in a header so the tests can compare the SIMD kernels with the scalar ones.
+
+#include "../OS/Math/MathTypes.h"
+
+#define F16_EXPONENT_BITS 0x1F
+#define F16_EXPONENT_SHIFT 10
+#define F16_EXPONENT_BIAS 15
+#define F16_MANTISSA_BITS 0x3ff
+#define F16_MANTISSA_SHIFT (23 - F16_EXPONENT_SHIFT)
+#define F16_MAX_EXPONENT (F16_EXPONENT_BITS << F16_EXPONENT_SHIFT)
+
+static inline uint16_t util_float_to_half(float val)
+{
+	uint32_t           f32 = (*(uint32_t*)&val);
+	uint16_t           f16 = 0;
+	/* Decode IEEE 754 little-endian 32-bit floating-point value */
+	int sign = (f32 >> 16) & 0x8000;
+	/* Map exponent to the range [-127,128] */
+	int exponent = ((f32 >> 23) & 0xff) - 127;
+	int mantissa = f32 & 0x007fffff;
+	if (exponent == 128)
+	{ /* Infinity or NaN */
+		f16 = (uint16_t)(sign | F16_MAX_EXPONENT);
+		if (mantissa)
+			f16 |= (mantissa & F16_MANTISSA_BITS);
+	}
+	else if (exponent > 15)
+	{ /* Overflow - flush to Infinity */
+		f16 = (unsigned short)(sign | F16_MAX_EXPONENT);
+	}
+	else if (exponent > -15)
+	{ /* Representable value */
+		exponent += F16_EXPONENT_BIAS;
+		mantissa >>= F16_MANTISSA_SHIFT;
+		f16 = (unsigned short)(sign | exponent << F16_EXPONENT_SHIFT | mantissa);
+	}
+	else
+	{
+		f16 = (unsigned short)sign;
+	}
+	return f16;
+}
+
+// Packing functions read count elements src + e * srcStride and write them to dst + e * dstStride
+typedef void (*PackingFunction)(uint32_t count, uint32_t srcStride, uint32_t dstStride, const uint8_t* src, uint8_t* dst);
+
+static inline void util_pack_float2_to_half2_scalar(uint32_t count, uint32_t srcStride, uint32_t dstStride, const uint8_t* src, uint8_t* dst)
+{
+	for (uint32_t e = 0; e < count; ++e)
+	{
+		const float* f = (const float*)(src + e * srcStride);
+		*(uint32_t*)(dst + e * dstStride) = (
+			(util_float_to_half(f[0]) & 0x0000FFFF) | ((util_float_to_half(f[1]) << 16) & 0xFFFF0000));
+	}
+}
+
+static inline uint32_t util_float2_to_unorm2x16(const float* v)
+{
+	uint32_t x = (uint32_t)round(clamp(v[0], 0, 1) * 65535.0f);
+	uint32_t y = (uint32_t)round(clamp(v[1], 0, 1) * 65535.0f);
+	return ((uint32_t)0x0000FFFF & x) | ((y << 16) & (uint32_t)0xFFFF0000);
+}
+
+#define OCT_WRAP(v, w) ((1.0f - abs((w))) * ((v) >= 0.0f ? 1.0f : -1.0f))
+
+static inline void util_pack_float3_direction_to_half2_scalar(uint32_t count, uint32_t srcStride, uint32_t dstStride, const uint8_t* src, uint8_t* dst)
+{
+	struct f3 { float x; float y; float z; };
+	for (uint32_t e = 0; e < count; ++e)
+	{
+		f3 f = *(f3*)(src + e * srcStride);
+		float absLength = (abs(f.x) + abs(f.y) + abs(f.z));
+		f3 enc = {};
+		if (absLength)
+		{
+			enc.x = f.x / absLength;
+			enc.y = f.y / absLength;
+			enc.z = f.z / absLength;
+			if (enc.z < 0)
+			{
+				float oldX = enc.x;
+				enc.x = OCT_WRAP(enc.x, enc.y);
+				enc.y = OCT_WRAP(enc.y, oldX);
+			}
+			enc.x = enc.x * 0.5f + 0.5f;
+			enc.y = enc.y * 0.5f + 0.5f;
+			*(uint32_t*)(dst + e * dstStride) = util_float2_to_unorm2x16(&enc.x);
+		}
+		else
+		{
+			*(uint32_t*)(dst + e * dstStride) = 0;
+		}
+	}
+}
+
+// The SIMD packing functions produce the same bits as the scalar ones above, which also handle the remaining elements.
+// Half conversion truncates the mantissa and flushes denormals to zero, unorm conversion rounds halfway cases away from zero.
+#if defined(__AVX2__)
+#define VERTEX_PACKING_AVX2
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VERTEX_PACKING_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define VERTEX_PACKING_NEON
+#include <arm_neon.h>
+#endif
+
+#define F32_HALF_MIN_NORMAL_BITS 0x38800000 // Smallest float which does not flush to zero as half
+#define F32_HALF_OVERFLOW_BITS 0x477FFFFF   // Largest float bit pattern which does not overflow to infinity as half
+#define F32_INF_BITS 0x7F800000
+#define F32_HALF_EXPONENT_REBIAS ((127 - F16_EXPONENT_BIAS) << F16_EXPONENT_SHIFT)
+
+#if defined(VERTEX_PACKING_SSE2)
+static inline __m128i util_float4_to_half4_sse2(__m128 v)
+{
+	const __m128i bits = _mm_castps_si128(v);
+	const __m128i absBits = _mm_and_si128(bits, _mm_set1_epi32(0x7FFFFFFF));
+	const __m128i sign = _mm_and_si128(_mm_srli_epi32(bits, 16), _mm_set1_epi32(0x8000));
+	__m128i half = _mm_sub_epi32(_mm_srli_epi32(absBits, F16_MANTISSA_SHIFT), _mm_set1_epi32(F32_HALF_EXPONENT_REBIAS));
+	// Overflow turns into infinity, NaN keeps the low mantissa bits
+	const __m128i overflow = _mm_cmpgt_epi32(absBits, _mm_set1_epi32(F32_HALF_OVERFLOW_BITS));
+	const __m128i nan = _mm_cmpgt_epi32(absBits, _mm_set1_epi32(F32_INF_BITS - 1));
+	const __m128i special = _mm_or_si128(
+		_mm_set1_epi32(F16_MAX_EXPONENT), _mm_and_si128(nan, _mm_and_si128(absBits, _mm_set1_epi32(F16_MANTISSA_BITS))));
+	half = _mm_or_si128(_mm_andnot_si128(overflow, half), _mm_and_si128(overflow, special));
+	half = _mm_andnot_si128(_mm_cmplt_epi32(absBits, _mm_set1_epi32(F32_HALF_MIN_NORMAL_BITS)), half);
+	half = _mm_or_si128(half, sign);
+	// Sign extend so the saturating pack to 16 bits keeps every value as is
+	return _mm_srai_epi32(_mm_slli_epi32(half, 16), 16);
+}
+
+static inline __m128 util_float4_octahedral_wrap_sse2(__m128 v, __m128 w)
+{
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 negative = _mm_cmpnge_ps(v, _mm_setzero_ps());
+	const __m128 signValue = _mm_or_ps(_mm_andnot_ps(negative, one), _mm_and_ps(negative, _mm_set1_ps(-1.0f)));
+	return _mm_mul_ps(_mm_sub_ps(one, _mm_and_ps(w, absMask)), signValue);
+}
+
+static inline __m128i util_float4_to_unorm16_sse2(__m128 v)
+{
+	const __m128 half = _mm_set1_ps(0.5f);
+	// Same operand order as max(v, 0) and min(v, 1) so NaN clamps the same way
+	v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+	v = _mm_mul_ps(v, _mm_set1_ps(65535.0f));
+	const __m128i whole = _mm_cvttps_epi32(v);
+	const __m128 fraction = _mm_sub_ps(v, _mm_cvtepi32_ps(whole));
+	return _mm_sub_epi32(whole, _mm_castps_si128(_mm_cmpge_ps(fraction, half)));
+}
+
+static inline __m128i util_float3x4_direction_to_unorm2x16_sse2(__m128 x, __m128 y, __m128 z)
+{
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 absLength = _mm_add_ps(_mm_add_ps(_mm_and_ps(x, absMask), _mm_and_ps(y, absMask)), _mm_and_ps(z, absMask));
+	__m128 encX = _mm_div_ps(x, absLength);
+	__m128 encY = _mm_div_ps(y, absLength);
+	const __m128 encZ = _mm_div_ps(z, absLength);
+	const __m128 wrap = _mm_cmplt_ps(encZ, _mm_setzero_ps());
+	const __m128 wrapX = util_float4_octahedral_wrap_sse2(encX, encY);
+	const __m128 wrapY = util_float4_octahedral_wrap_sse2(encY, encX);
+	encX = _mm_or_ps(_mm_andnot_ps(wrap, encX), _mm_and_ps(wrap, wrapX));
+	encY = _mm_or_ps(_mm_andnot_ps(wrap, encY), _mm_and_ps(wrap, wrapY));
+	const __m128i unormX = util_float4_to_unorm16_sse2(_mm_add_ps(_mm_mul_ps(encX, half), half));
+	const __m128i unormY = util_float4_to_unorm16_sse2(_mm_add_ps(_mm_mul_ps(encY, half), half));
+	const __m128i packed = _mm_or_si128(unormX, _mm_slli_epi32(unormY, 16));
+	return _mm_and_si128(packed, _mm_castps_si128(_mm_cmpneq_ps(absLength, _mm_setzero_ps())));
+}
+
+// Two float2 elements, srcStride apart
+static inline __m128 util_load_float2x2_sse2(const uint8_t* src, uint32_t srcStride)
+{
+	return _mm_castsi128_ps(_mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)src), _mm_loadl_epi64((const __m128i*)(src + srcStride))));
+}
+
+static inline void util_store_uint4_sse2(__m128i v, uint32_t dstStride, uint8_t* dst)
+{
+	if (sizeof(uint32_t) == dstStride)
+	{
+		_mm_storeu_si128((__m128i*)dst, v);
+		return;
+	}
+
+	alignas(16) uint32_t values[4];
+	_mm_store_si128((__m128i*)values, v);
+	for (uint32_t i = 0; i < 4; ++i)
+		*(uint32_t*)(dst + i * dstStride) = values[i];
+}
+#endif
+
+#if defined(VERTEX_PACKING_AVX2)
+static inline __m256i util_float8_to_half8_avx2(__m256 v)
+{
+	const __m256i bits = _mm256_castps_si256(v);
+	const __m256i absBits = _mm256_and_si256(bits, _mm256_set1_epi32(0x7FFFFFFF));
+	const __m256i sign = _mm256_and_si256(_mm256_srli_epi32(bits, 16), _mm256_set1_epi32(0x8000));
+	__m256i half = _mm256_sub_epi32(_mm256_srli_epi32(absBits, F16_MANTISSA_SHIFT), _mm256_set1_epi32(F32_HALF_EXPONENT_REBIAS));
+	const __m256i overflow = _mm256_cmpgt_epi32(absBits, _mm256_set1_epi32(F32_HALF_OVERFLOW_BITS));
+	const __m256i nan = _mm256_cmpgt_epi32(absBits, _mm256_set1_epi32(F32_INF_BITS - 1));
+	const __m256i special = _mm256_or_si256(
+		_mm256_set1_epi32(F16_MAX_EXPONENT), _mm256_and_si256(nan, _mm256_and_si256(absBits, _mm256_set1_epi32(F16_MANTISSA_BITS))));
+	half = _mm256_blendv_epi8(half, special, overflow);
+	half = _mm256_andnot_si256(_mm256_cmpgt_epi32(_mm256_set1_epi32(F32_HALF_MIN_NORMAL_BITS), absBits), half);
+	half = _mm256_or_si256(half, sign);
+	return _mm256_srai_epi32(_mm256_slli_epi32(half, 16), 16);
+}
+
+static inline __m256 util_float8_octahedral_wrap_avx2(__m256 v, __m256 w)
+{
+	const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 signValue = _mm256_blendv_ps(one, _mm256_set1_ps(-1.0f), _mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_NGE_UQ));
+	return _mm256_mul_ps(_mm256_sub_ps(one, _mm256_and_ps(w, absMask)), signValue);
+}
+
+static inline __m256i util_float8_to_unorm16_avx2(__m256 v)
+{
+	v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+	v = _mm256_mul_ps(v, _mm256_set1_ps(65535.0f));
+	const __m256i whole = _mm256_cvttps_epi32(v);
+	const __m256 fraction = _mm256_sub_ps(v, _mm256_cvtepi32_ps(whole));
+	return _mm256_sub_epi32(whole, _mm256_castps_si256(_mm256_cmp_ps(fraction, _mm256_set1_ps(0.5f), _CMP_GE_OQ)));
+}
+
+static inline __m256i util_float3x8_direction_to_unorm2x16_avx2(__m256 x, __m256 y, __m256 z)
+{
+	const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 absLength =
+		_mm256_add_ps(_mm256_add_ps(_mm256_and_ps(x, absMask), _mm256_and_ps(y, absMask)), _mm256_and_ps(z, absMask));
+	__m256 encX = _mm256_div_ps(x, absLength);
+	__m256 encY = _mm256_div_ps(y, absLength);
+	const __m256 encZ = _mm256_div_ps(z, absLength);
+	const __m256 wrap = _mm256_cmp_ps(encZ, _mm256_setzero_ps(), _CMP_LT_OQ);
+	const __m256 wrapX = util_float8_octahedral_wrap_avx2(encX, encY);
+	const __m256 wrapY = util_float8_octahedral_wrap_avx2(encY, encX);
+	encX = _mm256_blendv_ps(encX, wrapX, wrap);
+	encY = _mm256_blendv_ps(encY, wrapY, wrap);
+	const __m256i unormX = util_float8_to_unorm16_avx2(_mm256_add_ps(_mm256_mul_ps(encX, half), half));
+	const __m256i unormY = util_float8_to_unorm16_avx2(_mm256_add_ps(_mm256_mul_ps(encY, half), half));
+	const __m256i packed = _mm256_or_si256(unormX, _mm256_slli_epi32(unormY, 16));
+	return _mm256_and_si256(packed, _mm256_castps_si256(_mm256_cmp_ps(absLength, _mm256_setzero_ps(), _CMP_NEQ_UQ)));
+}
+
+static inline void util_store_uint8_avx2(__m256i v, uint32_t dstStride, uint8_t* dst)
+{
+	if (sizeof(uint32_t) == dstStride)
+	{
+		_mm256_storeu_si256((__m256i*)dst, v);
+		return;
+	}
+
+	alignas(32) uint32_t values[8];
+	_mm256_store_si256((__m256i*)values, v);
+	for (uint32_t i = 0; i < 8; ++i)
+		*(uint32_t*)(dst + i * dstStride) = values[i];
+}
+#endif
+
+#if defined(VERTEX_PACKING_NEON)
+static inline uint32x4_t util_float4_to_half4_neon(float32x4_t v)
+{
+	const uint32x4_t bits = vreinterpretq_u32_f32(v);
+	const uint32x4_t absBits = vandq_u32(bits, vdupq_n_u32(0x7FFFFFFF));
+	const uint32x4_t sign = vandq_u32(vshrq_n_u32(bits, 16), vdupq_n_u32(0x8000));
+	uint32x4_t half = vsubq_u32(vshrq_n_u32(absBits, F16_MANTISSA_SHIFT), vdupq_n_u32(F32_HALF_EXPONENT_REBIAS));
+	const uint32x4_t overflow = vcgtq_u32(absBits, vdupq_n_u32(F32_HALF_OVERFLOW_BITS));
+	const uint32x4_t nan = vcgtq_u32(absBits, vdupq_n_u32(F32_INF_BITS - 1));
+	const uint32x4_t special = vorrq_u32(vdupq_n_u32(F16_MAX_EXPONENT), vandq_u32(nan, vandq_u32(absBits, vdupq_n_u32(F16_MANTISSA_BITS))));
+	half = vbslq_u32(overflow, special, half);
+	half = vbicq_u32(half, vcltq_u32(absBits, vdupq_n_u32(F32_HALF_MIN_NORMAL_BITS)));
+	return vorrq_u32(half, sign);
+}
+
+static inline float32x4_t util_float4_octahedral_wrap_neon(float32x4_t v, float32x4_t w)
+{
+	const float32x4_t one = vdupq_n_f32(1.0f);
+	const uint32x4_t positive = vcgeq_f32(v, vdupq_n_f32(0.0f));
+	return vmulq_f32(vsubq_f32(one, vabsq_f32(w)), vbslq_f32(positive, one, vdupq_n_f32(-1.0f)));
+}
+
+static inline uint32x4_t util_float4_to_unorm16_neon(float32x4_t v)
+{
+	const float32x4_t zero = vdupq_n_f32(0.0f);
+	const float32x4_t one = vdupq_n_f32(1.0f);
+	// vmaxq / vminq propagate NaN, select like max(v, 0) and min(v, 1) do instead
+	v = vbslq_f32(vcgtq_f32(v, zero), v, zero);
+	v = vbslq_f32(vcltq_f32(v, one), v, one);
+	v = vmulq_f32(v, vdupq_n_f32(65535.0f));
+	const uint32x4_t whole = vcvtq_u32_f32(v);
+	const float32x4_t fraction = vsubq_f32(v, vcvtq_f32_u32(whole));
+	return vsubq_u32(whole, vcgeq_f32(fraction, vdupq_n_f32(0.5f)));
+}
+
+static inline uint32x4_t util_float3x4_direction_to_unorm2x16_neon(float32x4_t x, float32x4_t y, float32x4_t z)
+{
+	const float32x4_t half = vdupq_n_f32(0.5f);
+	const float32x4_t absLength = vaddq_f32(vaddq_f32(vabsq_f32(x), vabsq_f32(y)), vabsq_f32(z));
+	float32x4_t encX = vdivq_f32(x, absLength);
+	float32x4_t encY = vdivq_f32(y, absLength);
+	const float32x4_t encZ = vdivq_f32(z, absLength);
+	const uint32x4_t wrap = vcltq_f32(encZ, vdupq_n_f32(0.0f));
+	const float32x4_t wrapX = util_float4_octahedral_wrap_neon(encX, encY);
+	const float32x4_t wrapY = util_float4_octahedral_wrap_neon(encY, encX);
+	encX = vbslq_f32(wrap, wrapX, encX);
+	encY = vbslq_f32(wrap, wrapY, encY);
+	// No fused multiply add, the scalar version rounds after the multiply
+	const uint32x4_t unormX = util_float4_to_unorm16_neon(vaddq_f32(vmulq_f32(encX, half), half));
+	const uint32x4_t unormY = util_float4_to_unorm16_neon(vaddq_f32(vmulq_f32(encY, half), half));
+	const uint32x4_t packed = vorrq_u32(unormX, vshlq_n_u32(unormY, 16));
+	// absLength != 0, NaN included
+	return vbicq_u32(packed, vceqq_f32(absLength, vdupq_n_f32(0.0f)));
+}
+
+static inline void util_store_uint4_neon(uint32x4_t v, uint32_t dstStride, uint8_t* dst)
+{
+	if (sizeof(uint32_t) == dstStride)
+	{
+		vst1q_u32((uint32_t*)dst, v);
+		return;
+	}
+
+	uint32_t values[4];
+	vst1q_u32(values, v);
+	for (uint32_t i = 0; i < 4; ++i)
+		*(uint32_t*)(dst + i * dstStride) = values[i];
+}
+#endif
+
+static inline void util_pack_float2_to_half2(uint32_t count, uint32_t srcStride, uint32_t dstStride, const uint8_t* src, uint8_t* dst)
+{
+	uint32_t e = 0;
+#if defined(VERTEX_PACKING_AVX2)
+	for (; e + 8 <= count; e += 8)
+	{
+		const uint8_t* s = src + e * srcStride;
+		const __m256 lo = _mm256_set_m128(util_load_float2x2_sse2(s + 2 * srcStride, srcStride), util_load_float2x2_sse2(s, srcStride));
+		s += 4 * srcStride;
+		const __m256 hi = _mm256_set_m128(util_load_float2x2_sse2(s + 2 * srcStride, srcStride), util_load_float2x2_sse2(s, srcStride));
+		// packs works within 128 bit lanes, put the 64 bit halves back in order afterwards
+		const __m256i packed = _mm256_packs_epi32(util_float8_to_half8_avx2(lo), util_float8_to_half8_avx2(hi));
+		util_store_uint8_avx2(_mm256_permute4x64_epi64(packed, 0xD8), dstStride, dst + e * dstStride);
+	}
+#endif
+#if defined(VERTEX_PACKING_SSE2)
+	for (; e + 4 <= count; e += 4)
+	{
+		const uint8_t* s = src + e * srcStride;
+		const __m128 lo = util_load_float2x2_sse2(s, srcStride);
+		const __m128 hi = util_load_float2x2_sse2(s + 2 * srcStride, srcStride);
+		const __m128i packed = _mm_packs_epi32(util_float4_to_half4_sse2(lo), util_float4_to_half4_sse2(hi));
+		util_store_uint4_sse2(packed, dstStride, dst + e * dstStride);
+	}
+#elif defined(VERTEX_PACKING_NEON)
+	for (; e + 4 <= count; e += 4)
+	{
+		const uint8_t* s = src + e * srcStride;
+		const float32x4_t lo = vcombine_f32(vld1_f32((const float*)s), vld1_f32((const float*)(s + srcStride)));
+		const float32x4_t hi = vcombine_f32(vld1_f32((const float*)(s + 2 * srcStride)), vld1_f32((const float*)(s + 3 * srcStride)));
+		const uint16x8_t packed = vcombine_u16(vmovn_u32(util_float4_to_half4_neon(lo)), vmovn_u32(util_float4_to_half4_neon(hi)));
+		util_store_uint4_neon(vreinterpretq_u32_u16(packed), dstStride, dst + e * dstStride);
+	}
+#endif
+	util_pack_float2_to_half2_scalar(count - e, srcStride, dstStride, src + e * srcStride, dst + e * dstStride);
+}
+
+static inline void util_pack_float3_direction_to_half2(uint32_t count, uint32_t srcStride, uint32_t dstStride, const uint8_t* src, uint8_t* dst)
+{
+	uint32_t e = 0;
+#if defined(VERTEX_PACKING_AVX2)
+	for (; e + 8 <= count; e += 8)
+	{
+		// Gather the components since reading a full vector at the last vertex could run past the buffer
+		alignas(32) float x[8], y[8], z[8];
+		for (uint32_t i = 0; i < 8; ++i)
+		{
+			const float* f = (const float*)(src + (e + i) * srcStride);
+			x[i] = f[0];
+			y[i] = f[1];
+			z[i] = f[2];
+		}
+		const __m256i packed = util_float3x8_direction_to_unorm2x16_avx2(_mm256_load_ps(x), _mm256_load_ps(y), _mm256_load_ps(z));
+		util_store_uint8_avx2(packed, dstStride, dst + e * dstStride);
+	}
+#endif
+#if defined(VERTEX_PACKING_SSE2) || defined(VERTEX_PACKING_NEON)
+	for (; e + 4 <= count; e += 4)
+	{
+		alignas(16) float x[4], y[4], z[4];
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			const float* f = (const float*)(src + (e + i) * srcStride);
+			x[i] = f[0];
+			y[i] = f[1];
+			z[i] = f[2];
+		}
+#if defined(VERTEX_PACKING_SSE2)
+		const __m128i packed = util_float3x4_direction_to_unorm2x16_sse2(_mm_load_ps(x), _mm_load_ps(y), _mm_load_ps(z));
+		util_store_uint4_sse2(packed, dstStride, dst + e * dstStride);
+#else
+		const uint32x4_t packed = util_float3x4_direction_to_unorm2x16_neon(vld1q_f32(x), vld1q_f32(y), vld1q_f32(z));
+		util_store_uint4_neon(packed, dstStride, dst + e * dstStride);
+#endif
+	}
+#endif
+	util_pack_float3_direction_to_half2_scalar(count - e, srcStride, dstStride, src + e * srcStride, dst + e * dstStride);
+}
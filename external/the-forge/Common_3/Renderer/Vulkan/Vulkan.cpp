@@ -79,6 +79,7 @@
 
 #include "../../OS/Core/Atomics.h"
 #include "../../OS/Core/GPUConfig.h"
+#include "../RenderPassCache.h"
 #include "../../ThirdParty/OpenSource/tinyimageformat/tinyimageformat_base.h"
 #include "../../ThirdParty/OpenSource/tinyimageformat/tinyimageformat_query.h"
 #include "VulkanCapsBuilder.h"
@@ -614,6 +615,9 @@ typedef struct FrameBuffer
 	uint32_t      mWidth;
 	uint32_t      mHeight;
 	uint32_t      mArraySize;
+	// RenderTarget::mId of the attachments, to evict the frame buffer when one of them is removed
+	uint32_t      mRenderTargetIds[MAX_RENDER_TARGET_ATTACHMENTS + 1];
+	uint32_t      mRenderTargetIdCount;
 } FrameBuffer;
 
 static void add_render_pass(Renderer* pRenderer, const RenderPassDesc* pDesc, RenderPass** ppRenderPass)
@@ -741,6 +745,11 @@ static void add_framebuffer(Renderer* pRenderer, const FrameBufferDesc* pDesc, F
 	uint32_t colorAttachmentCount = pDesc->mRenderTargetCount;
 	uint32_t depthAttachmentCount = (pDesc->pDepthStencil) ? 1 : 0;
 
+	for (uint32_t i = 0; i < colorAttachmentCount; ++i)
+		pFrameBuffer->mRenderTargetIds[pFrameBuffer->mRenderTargetIdCount++] = pDesc->ppRenderTargets[i]->mId;
+	if (pDesc->pDepthStencil)
+		pFrameBuffer->mRenderTargetIds[pFrameBuffer->mRenderTargetIdCount++] = pDesc->pDepthStencil->mId;
+
 	if (colorAttachmentCount)
 	{
 		pFrameBuffer->mWidth = pDesc->ppRenderTargets[0]->mWidth;
@@ -858,49 +867,13 @@ static void remove_framebuffer(Renderer* pRenderer, FrameBuffer* pFrameBuffer)
 // Per Thread Render Pass synchronization logic
 /************************************************************************/
 /// Render-passes are not exposed to the app code since they are not available on all apis
-/// This map takes care of hashing a render pass based on the render targets passed to cmdBeginRender
-using RenderPassMap = eastl::hash_map<uint64_t, struct RenderPass*>;
-using RenderPassMapNode = RenderPassMap::value_type;
+/// These maps take care of hashing a render pass based on the render targets passed to cmdBeginRender
+typedef RenderPassCaches<RenderPass, FrameBuffer> VkRenderPassCaches;
+using RenderPassCache = VkRenderPassCaches::Cache;
+using RenderPassMap = VkRenderPassCaches::RenderPassMap;
 using RenderPassMapIt = RenderPassMap::iterator;
-using FrameBufferMap = eastl::hash_map<uint64_t, struct FrameBuffer*>;
-using FrameBufferMapNode = FrameBufferMap::value_type;
+using FrameBufferMap = VkRenderPassCaches::FrameBufferMap;
 using FrameBufferMapIt = FrameBufferMap::iterator;
-
-// RenderPass map per thread (this will make lookups lock free and we only need a lock when inserting a RenderPass Map for the first time)
-eastl::hash_map<ThreadID, RenderPassMap>* gRenderPassMap;
-// FrameBuffer map per thread (this will make lookups lock free and we only need a lock when inserting a FrameBuffer map for the first time)
-eastl::hash_map<ThreadID, FrameBufferMap>* gFrameBufferMap;
-Mutex*                                    pRenderPassMutex;
-
-static RenderPassMap& get_render_pass_map()
-{
-	// Only need a lock when creating a new renderpass map for this thread
-	MutexLock lock(*pRenderPassMutex);
-	eastl::hash_map<ThreadID, RenderPassMap>::iterator it = gRenderPassMap->find(Thread::GetCurrentThreadID());
-	if (it == gRenderPassMap->end())
-	{
-		return gRenderPassMap->insert(Thread::GetCurrentThreadID()).first->second;
-	}
-	else
-	{
-		return it->second;
-	}
-}
-
-static FrameBufferMap& get_frame_buffer_map()
-{
-	// Only need a lock when creating a new framebuffer map for this thread
-	MutexLock lock(*pRenderPassMutex);
-	eastl::hash_map<ThreadID, FrameBufferMap>::iterator it = gFrameBufferMap->find(Thread::GetCurrentThreadID());
-	if (it == gFrameBufferMap->end())
-	{
-		return gFrameBufferMap->insert(Thread::GetCurrentThreadID()).first->second;
-	}
-	else
-	{
-		return it->second;
-	}
-}
 /************************************************************************/
 // Logging, Validation layer implementation
 /************************************************************************/
@@ -2419,7 +2392,7 @@ static bool AddDevice(const RendererDesc* pDesc, Renderer* pRenderer)
 	}
 #endif
 
-	if (VK_PHYSICAL_DEVICE_TYPE_CPU == gpuProperties[gpuIndex].properties.deviceType)
+	if (VK_PHYSICAL_DEVICE_TYPE_CPU == gpuProperties[gpuIndex].properties.deviceType && !pDesc->mAllowCpuDevice)
 	{
 		LOGF(eERROR, "The only available GPU is of type VK_PHYSICAL_DEVICE_TYPE_CPU. Early exiting");
 		ASSERT(false);
@@ -2927,10 +2900,7 @@ void initRenderer(const char* appName, const RendererDesc* pDesc, Renderer** ppR
 	}
 #endif
 	add_descriptor_pool(pRenderer, 8192, (VkDescriptorPoolCreateFlags)0, descriptorPoolSizes, gDescriptorTypeRangeSize, &pRenderer->pDescriptorPool);
-	pRenderPassMutex = (Mutex*)tf_calloc(1, sizeof(Mutex));
-	pRenderPassMutex->Init();
-	gRenderPassMap = tf_placement_new<eastl::hash_map<ThreadID, RenderPassMap> >(tf_malloc(sizeof(*gRenderPassMap)));
-	gFrameBufferMap = tf_placement_new<eastl::hash_map<ThreadID, FrameBufferMap> >(tf_malloc(sizeof(*gFrameBufferMap)));
+	VkRenderPassCaches::init(remove_render_pass, remove_framebuffer);
 
 	VkPhysicalDeviceFeatures2KHR gpuFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR };
 	vkGetPhysicalDeviceFeatures2KHR(pRenderer->pVkActiveGPU, &gpuFeatures);
@@ -2971,14 +2941,8 @@ void removeRenderer(Renderer* pRenderer)
 
 	remove_descriptor_pool(pRenderer, pRenderer->pDescriptorPool);
 
-	// Remove the renderpasses
-	for (eastl::hash_map<ThreadID, RenderPassMap>::value_type& t : *gRenderPassMap)
-		for (RenderPassMapNode& it : t.second)
-			remove_render_pass(pRenderer, it.second);
-
-	for (eastl::hash_map<ThreadID, FrameBufferMap>::value_type& t : *gFrameBufferMap)
-		for (FrameBufferMapNode& it : t.second)
-			remove_framebuffer(pRenderer, it.second);
+	// Remove the renderpasses and framebuffers of every thread
+	VkRenderPassCaches::exit(pRenderer);
 
 	// Destroy the Vulkan bits
 	vmaDestroyAllocator(pRenderer->pVmaAllocator);
@@ -2992,14 +2956,6 @@ void removeRenderer(Renderer* pRenderer)
 	nvapiExit();
 	agsExit();
 
-	pRenderPassMutex->Destroy();
-	gRenderPassMap->clear(true);
-	gFrameBufferMap->clear(true);
-
-	SAFE_FREE(pRenderPassMutex);
-	SAFE_FREE(gRenderPassMap);
-	SAFE_FREE(gFrameBufferMap);
-
 	for (uint32_t i = 0; i < pRenderer->mLinkedNodeCount; ++i)
 	{
 		SAFE_FREE(pRenderer->pAvailableQueueCount[i]);
@@ -3245,10 +3201,11 @@ void toggleVSync(Renderer* pRenderer, SwapChain** ppSwapChain)
 	desc.mEnableVsync = !desc.mEnableVsync;
 	desc.mPresentQueueCount = 1;
 	desc.ppPresentQueues = queues;
+	desc.pOldSwapChain = pSwapChain;
 	//toggle vsync on or off
-	//for Vulkan we need to remove the SwapChain and recreate it with correct vsync option
-	removeSwapChain(pRenderer, pSwapChain);
+	//for Vulkan we need to recreate the SwapChain with correct vsync option, the old one hands over its surface
 	addSwapChain(pRenderer, &desc, ppSwapChain);
+	removeSwapChain(pRenderer, pSwapChain);
 }
 
 void addSwapChain(Renderer* pRenderer, const SwapChainDesc* pDesc, SwapChain** ppSwapChain)
@@ -3262,52 +3219,61 @@ void addSwapChain(Renderer* pRenderer, const SwapChainDesc* pDesc, SwapChain** p
 	// Create surface
 	/************************************************************************/
 	ASSERT(VK_NULL_HANDLE != pRenderer->pVkInstance);
-	VkSurfaceKHR vkSurface;
-	// Create a WSI surface for the window:
+	VkSurfaceKHR vkSurface = VK_NULL_HANDLE;
+	if (pDesc->pOldSwapChain)
+	{
+		// oldSwapchain must belong to the surface of the new swapchain, which takes it over
+		vkSurface = pDesc->pOldSwapChain->pVkSurface;
+		pDesc->pOldSwapChain->pVkSurface = VK_NULL_HANDLE;
+	}
+	else
+	{
+		// Create a WSI surface for the window:
 #if defined(VK_USE_PLATFORM_WIN32_KHR)
-	DECLARE_ZERO(VkWin32SurfaceCreateInfoKHR, add_info);
-	add_info.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
-	add_info.pNext = NULL;
-	add_info.flags = 0;
-	add_info.hinstance = ::GetModuleHandle(NULL);
-	add_info.hwnd = (HWND)pDesc->mWindowHandle.window;
-	CHECK_VKRESULT(vkCreateWin32SurfaceKHR(pRenderer->pVkInstance, &add_info, &gVkAllocationCallbacks, &vkSurface));
+		DECLARE_ZERO(VkWin32SurfaceCreateInfoKHR, add_info);
+		add_info.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
+		add_info.pNext = NULL;
+		add_info.flags = 0;
+		add_info.hinstance = ::GetModuleHandle(NULL);
+		add_info.hwnd = (HWND)pDesc->mWindowHandle.window;
+		CHECK_VKRESULT(vkCreateWin32SurfaceKHR(pRenderer->pVkInstance, &add_info, &gVkAllocationCallbacks, &vkSurface));
 #elif defined(VK_USE_PLATFORM_XLIB_KHR)
-	DECLARE_ZERO(VkXlibSurfaceCreateInfoKHR, add_info);
-	add_info.sType = VK_STRUCTURE_TYPE_XLIB_SURFACE_CREATE_INFO_KHR;
-	add_info.pNext = NULL;
-	add_info.flags = 0;
-	add_info.dpy = pDesc->mWindowHandle.display;      //TODO
-	add_info.window = pDesc->mWindowHandle.window;    //TODO
-	CHECK_VKRESULT(vkCreateXlibSurfaceKHR(pRenderer->pVkInstance, &add_info, &gVkAllocationCallbacks, &vkSurface));
+		DECLARE_ZERO(VkXlibSurfaceCreateInfoKHR, add_info);
+		add_info.sType = VK_STRUCTURE_TYPE_XLIB_SURFACE_CREATE_INFO_KHR;
+		add_info.pNext = NULL;
+		add_info.flags = 0;
+		add_info.dpy = pDesc->mWindowHandle.display;      //TODO
+		add_info.window = pDesc->mWindowHandle.window;    //TODO
+		CHECK_VKRESULT(vkCreateXlibSurfaceKHR(pRenderer->pVkInstance, &add_info, &gVkAllocationCallbacks, &vkSurface));
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
-	DECLARE_ZERO(VkXcbSurfaceCreateInfoKHR, add_info);
-	add_info.sType = VK_STRUCTURE_TYPE_XCB_SURFACE_CREATE_INFO_KHR;
-	add_info.pNext = NULL;
-	add_info.flags = 0;
-	add_info.connection = pDesc->mWindowHandle.connection;    //TODO
-	add_info.window = pDesc->mWindowHandle.window;        //TODO
-	CHECK_VKRESULT(vkCreateXcbSurfaceKHR(pRenderer->pVkInstance, &add_info, &gVkAllocationCallbacks, &vkSurface));
+		DECLARE_ZERO(VkXcbSurfaceCreateInfoKHR, add_info);
+		add_info.sType = VK_STRUCTURE_TYPE_XCB_SURFACE_CREATE_INFO_KHR;
+		add_info.pNext = NULL;
+		add_info.flags = 0;
+		add_info.connection = pDesc->mWindowHandle.connection;    //TODO
+		add_info.window = pDesc->mWindowHandle.window;        //TODO
+		CHECK_VKRESULT(vkCreateXcbSurfaceKHR(pRenderer->pVkInstance, &add_info, &gVkAllocationCallbacks, &vkSurface));
 #elif defined(VK_USE_PLATFORM_IOS_MVK)
-	// Add IOS support here
+		// Add IOS support here
 #elif defined(VK_USE_PLATFORM_MACOS_MVK)
-	// Add MacOS support here
+		// Add MacOS support here
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
-	DECLARE_ZERO(VkAndroidSurfaceCreateInfoKHR, add_info);
-	add_info.sType = VK_STRUCTURE_TYPE_ANDROID_SURFACE_CREATE_INFO_KHR;
-	add_info.pNext = NULL;
-	add_info.flags = 0;
-	add_info.window = pDesc->mWindowHandle.window;
-	CHECK_VKRESULT(vkCreateAndroidSurfaceKHR(pRenderer->pVkInstance, &add_info, &gVkAllocationCallbacks, &vkSurface));
+		DECLARE_ZERO(VkAndroidSurfaceCreateInfoKHR, add_info);
+		add_info.sType = VK_STRUCTURE_TYPE_ANDROID_SURFACE_CREATE_INFO_KHR;
+		add_info.pNext = NULL;
+		add_info.flags = 0;
+		add_info.window = pDesc->mWindowHandle.window;
+		CHECK_VKRESULT(vkCreateAndroidSurfaceKHR(pRenderer->pVkInstance, &add_info, &gVkAllocationCallbacks, &vkSurface));
 #elif defined(VK_USE_PLATFORM_GGP)
-	extern VkResult ggpCreateSurface(VkInstance, VkSurfaceKHR* surface);
-	CHECK_VKRESULT(ggpCreateSurface(pRenderer->pVkInstance, &vkSurface));
+		extern VkResult ggpCreateSurface(VkInstance, VkSurfaceKHR* surface);
+		CHECK_VKRESULT(ggpCreateSurface(pRenderer->pVkInstance, &vkSurface));
 #elif defined(VK_USE_PLATFORM_VI_NN)
-	extern VkResult nxCreateSurface(VkInstance, VkSurfaceKHR* surface);
-	CHECK_VKRESULT(nxCreateSurface(pRenderer->pVkInstance, &vkSurface));
+		extern VkResult nxCreateSurface(VkInstance, VkSurfaceKHR* surface);
+		CHECK_VKRESULT(nxCreateSurface(pRenderer->pVkInstance, &vkSurface));
 #else
 #error PLATFORM NOT SUPPORTED
 #endif
+	}
 	/************************************************************************/
 	// Create swap chain
 	/************************************************************************/
@@ -3533,7 +3499,7 @@ void addSwapChain(Renderer* pRenderer, const SwapChainDesc* pDesc, SwapChain** p
 	swapChainCreateInfo.compositeAlpha = composite_alpha;
 	swapChainCreateInfo.presentMode = present_mode;
 	swapChainCreateInfo.clipped = VK_TRUE;
-	swapChainCreateInfo.oldSwapchain = 0;
+	swapChainCreateInfo.oldSwapchain = pDesc->pOldSwapChain ? pDesc->pOldSwapChain->pSwapChain : VK_NULL_HANDLE;
 	CHECK_VKRESULT(vkCreateSwapchainKHR(pRenderer->pVkDevice, &swapChainCreateInfo, &gVkAllocationCallbacks, &vkSwapchain));
 
 	((SwapChainDesc*)pDesc)->mColorFormat = TinyImageFormat_FromVkFormat((TinyImageFormat_VkFormat)surface_format.format);
@@ -3603,6 +3569,7 @@ void addSwapChain(Renderer* pRenderer, const SwapChainDesc* pDesc, SwapChain** p
 	/************************************************************************/
 	/************************************************************************/
 	*pSwapChain->pDesc = *pDesc;
+	pSwapChain->pDesc->pOldSwapChain = NULL;
 	pSwapChain->mEnableVsync = pDesc->mEnableVsync;
 	pSwapChain->mImageCount = imageCount;
 	pSwapChain->pVkSurface = vkSurface;
@@ -3624,7 +3591,9 @@ void removeSwapChain(Renderer* pRenderer, SwapChain* pSwapChain)
 	}
 
 	vkDestroySwapchainKHR(pRenderer->pVkDevice, pSwapChain->pSwapChain, &gVkAllocationCallbacks);
-	vkDestroySurfaceKHR(pRenderer->pVkInstance, pSwapChain->pVkSurface, &gVkAllocationCallbacks);
+	// Swapchains replaced by a newer one handed their surface over
+	if (VK_NULL_HANDLE != pSwapChain->pVkSurface)
+		vkDestroySurfaceKHR(pRenderer->pVkInstance, pSwapChain->pVkSurface, &gVkAllocationCallbacks);
 
 	SAFE_FREE(pSwapChain);
 }
@@ -4325,6 +4294,9 @@ void addRenderTarget(Renderer* pRenderer, const RenderTargetDesc* pDesc, RenderT
 
 void removeRenderTarget(Renderer* pRenderer, RenderTarget* pRenderTarget)
 {
+	// Frame buffers are destroyed before the image views they reference
+	VkRenderPassCaches::retireRenderTarget(pRenderer, pRenderTarget->mId);
+
 	::removeTexture(pRenderer, pRenderTarget->pTexture);
 
 	vkDestroyImageView(pRenderer->pVkDevice, pRenderTarget->pVkDescriptor, &gVkAllocationCallbacks);
@@ -4591,10 +4563,11 @@ void updateDescriptorSet(Renderer* pRenderer, uint32_t index, DescriptorSet* pDe
 
 		VALIDATE_DESCRIPTOR(pParam->pName || (paramIndex != -1), "DescriptorData has NULL name and invalid index");
 
+		// Pre-resolved indices skip the name lookup
 		const DescriptorInfo* pDesc = (paramIndex != -1) ? (pRootSignature->pDescriptors + paramIndex) : get_descriptor(pRootSignature, pParam->pName);
 		if (paramIndex != -1)
 		{
-			VALIDATE_DESCRIPTOR(pDesc, "Invalid descriptor with param index (%u)", paramIndex);
+			VALIDATE_DESCRIPTOR(paramIndex < pRootSignature->mDescriptorCount, "Invalid descriptor with param index (%u)", paramIndex);
 		}
 		else
 		{
@@ -4631,12 +4604,15 @@ void updateDescriptorSet(Renderer* pRenderer, uint32_t index, DescriptorSet* pDe
 		{
 			VALIDATE_DESCRIPTOR(pParam->ppTextures, "NULL Texture (%s)", pDesc->pName);
 
+#if defined(ENABLE_GRAPHICS_DEBUG)
+			// Hashes the name on every update so only check it when validating
 			DescriptorNameToIndexMap::const_iterator it = pRootSignature->pDescriptorNameToIndexMap->mMap.find(pDesc->pName);
 			if (it == pRootSignature->pDescriptorNameToIndexMap->mMap.end())
 			{
 				LOGF(LogLevel::eERROR, "No Static Sampler called (%s)", pDesc->pName);
 				ASSERT(false);
 			}
+#endif
 
 			for (uint32_t arr = 0; arr < arrayCount; ++arr)
 			{
@@ -4929,6 +4905,16 @@ void cmdBindPushConstantsByIndex(Cmd* pCmd, RootSignature* pRootSignature, uint3
 	vkCmdPushConstants(pCmd->pVkCmdBuf, pRootSignature->pPipelineLayout,
 		pDesc->mVkStages, 0, pDesc->mSize, pConstants);
 }
+
+uint32_t getDescriptorIndexFromName(const RootSignature* pRootSignature, const char* pName)
+{
+	ASSERT(pRootSignature);
+	ASSERT(pName);
+
+	// Looked up directly instead of through get_descriptor, probing for a descriptor the shaders may not declare is not an error
+	DescriptorNameToIndexMap::const_iterator it = pRootSignature->pDescriptorNameToIndexMap->mMap.find(pName);
+	return it != pRootSignature->pDescriptorNameToIndexMap->mMap.end() ? it->second : UINT32_MAX;
+}
 /************************************************************************/
 // Shader Functions
 /************************************************************************/
@@ -6130,8 +6116,9 @@ void cmdBindRenderTargets(
 
 	SampleCount sampleCount = SAMPLE_COUNT_1;
 
-	RenderPassMap&  renderPassMap = get_render_pass_map();
-	FrameBufferMap& frameBufferMap = get_frame_buffer_map();
+	RenderPassCache* pCache = VkRenderPassCaches::get(pCmd->pRenderer);
+	RenderPassMap&   renderPassMap = pCache->mRenderPasses;
+	FrameBufferMap&  frameBufferMap = pCache->mFrameBuffers;
 
 	const RenderPassMapIt  pNode = renderPassMap.find(renderPassHash);
 	const FrameBufferMapIt pFrameBufferNode = frameBufferMap.find(frameBufferHash);
@@ -6196,6 +6183,7 @@ void cmdBindRenderTargets(
 
 		// No need of a lock here since this map is per thread
 		frameBufferMap.insert({{ frameBufferHash, pFrameBuffer }});
+		VkRenderPassCaches::trackFrameBuffer(pCache, pFrameBuffer);
 	}
 
 	DECLARE_ZERO(VkRect2D, render_area);
@@ -6586,6 +6574,11 @@ typedef struct SubresourceDataDesc
 	uint32_t mArrayLayer;
 	uint32_t mRowPitch;
 	uint32_t mSlicePitch;
+	// Region of a 2D subresource to copy to, the whole subresource when mRegionWidth is 0
+	uint32_t mRegionX;
+	uint32_t mRegionY;
+	uint32_t mRegionWidth;
+	uint32_t mRegionHeight;
 } SubresourceDataDesc;
 
 void cmdUpdateSubresource(Cmd* pCmd, Texture* pTexture, Buffer* pSrcBuffer, const SubresourceDataDesc* pSubresourceDesc)
@@ -6609,17 +6602,19 @@ void cmdUpdateSubresource(Cmd* pCmd, Texture* pTexture, Buffer* pSrcBuffer, cons
 		copy.imageSubresource.mipLevel = pSubresourceDesc->mMipLevel;
 		copy.imageSubresource.baseArrayLayer = pSubresourceDesc->mArrayLayer;
 		copy.imageSubresource.layerCount = 1;
-		copy.imageOffset.x = 0;
-		copy.imageOffset.y = 0;
+		copy.imageOffset.x = pSubresourceDesc->mRegionX;
+		copy.imageOffset.y = pSubresourceDesc->mRegionY;
 		copy.imageOffset.z = 0;
-		copy.imageExtent.width = width;
-		copy.imageExtent.height = height;
+		copy.imageExtent.width = pSubresourceDesc->mRegionWidth ? pSubresourceDesc->mRegionWidth : width;
+		copy.imageExtent.height = pSubresourceDesc->mRegionWidth ? pSubresourceDesc->mRegionHeight : height;
 		copy.imageExtent.depth = depth;
 
 		vkCmdCopyBufferToImage(pCmd->pVkCmdBuf, pSrcBuffer->pVkBuffer, pTexture->pVkImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
 	}
 	else
 	{
+		// Regions of multi planar formats are not supported
+		ASSERT(!pSubresourceDesc->mRegionWidth);
 		const uint32_t	width = pTexture->mWidth;
 		const uint32_t	height = pTexture->mHeight;
 		const uint32_t	depth = pTexture->mDepth;
@@ -7922,7 +7917,12 @@ void removeVirtualTexture(Renderer* pRenderer, VirtualTexture* pSvt)
 	if (pSvt->mPageCounts)
 		removeBuffer(pRenderer, pSvt->mPageCounts);
 
-	if (pSvt->mVirtualImageData)
+	if (pSvt->pVirtualImageStream)
+	{
+		fsCloseStream((FileStream*)pSvt->pVirtualImageStream);
+		tf_free(pSvt->pVirtualImageStream);
+	}
+	else if (pSvt->mVirtualImageData)
 		tf_free(pSvt->mVirtualImageData);
 }
 
@@ -5819,6 +5819,8 @@ mz_bool mz_zip_reader_end(mz_zip_archive *pZip) {
   mz_zip_array_clear(pZip, &pState->m_sorted_central_dir_offsets);
 
 #ifndef MINIZ_NO_STDIO
+  // CONFFX_CHANGE - Readers initialized from memory have no stream to close
+  if (pState->m_pFile.pIO)
     MZ_FCLOSE(&pState->m_pFile);
 #endif // #ifndef MINIZ_NO_STDIO
 
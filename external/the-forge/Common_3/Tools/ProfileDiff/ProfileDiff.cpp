@@ -0,0 +1,309 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Compares two histogram dumps written by dumpProfileHistograms and reports the scopes whose percentiles regressed.
+// Exits with 1 when a regression was found so it can gate automated performance runs.
+//
+// A percentile only counts as changed when the change is above the relative and absolute thresholds and the
+// confidence intervals of both captures do not overlap. The interval of a percentile comes from the binomial
+// distribution of its rank, widened to the bucket bounds, so small captures and quantization never report noise.
+
+#include "../../OS/Profiler/ProfilerHistogram.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct Histogram
+{
+	std::string           mKind;
+	uint64_t              mTicksPerSecond = 0;
+	uint64_t              mCount = 0;
+	std::vector<uint64_t> mCounts;
+};
+
+struct Settings
+{
+	double              mThresholdPercent = 5.0;
+	double              mMinDeltaMs = 0.01;
+	uint64_t            mMinCount = 100;
+	double              mConfidence = 99.0;
+	std::vector<double> mPercentiles = { 50.0, 95.0, 99.0, 99.9 };
+	bool                mPrintAll = false;
+};
+
+struct Estimate
+{
+	double mValueMs;
+	double mLowMs;
+	double mHighMs;
+};
+
+static void PrintHelp()
+{
+	printf(
+		"ProfileDiff base.txt new.txt [options]\n"
+		"\nCompares two dumps of dumpProfileHistograms. Exits with 1 if a scope regressed, 2 on errors.\n"
+		"\nOptions:\n"
+		"\t --threshold <percent>        : Smallest relative change reported. Default 5\n"
+		"\t --min-delta <ms>             : Smallest absolute change reported. Default 0.01\n"
+		"\t --min-count <n>              : Scopes with fewer runs in either capture are skipped. Default 100\n"
+		"\t --confidence <percent>       : Confidence level of the percentile intervals. Default 99\n"
+		"\t --percentiles <p,p,...>      : Percentiles to compare. Default 50,95,99,99.9\n"
+		"\t --all                        : Print every comparison, not only the significant ones\n"
+		"\t -h | -help                   : Print usage information.\n");
+}
+
+static bool LoadHistograms(const char* pFileName, std::map<std::string, Histogram>& histograms)
+{
+	std::ifstream file(pFileName);
+	if (!file)
+	{
+		printf("ERROR: Failed to open %s\n", pFileName);
+		return false;
+	}
+
+	std::string line;
+	unsigned subBucketBits = 0, valueBits = 0;
+	if (!std::getline(file, line) || sscanf(line.c_str(), "TFPH\t%u\t%u", &subBucketBits, &valueBits) != 2)
+	{
+		printf("ERROR: %s is not a profile histogram dump\n", pFileName);
+		return false;
+	}
+	if (subBucketBits != PROFILE_HISTOGRAM_SUB_BUCKET_BITS || valueBits != PROFILE_HISTOGRAM_VALUE_BITS)
+	{
+		printf("ERROR: %s uses a different histogram layout\n", pFileName);
+		return false;
+	}
+
+	while (std::getline(file, line))
+	{
+		if (line.empty())
+			continue;
+
+		std::vector<std::string> fields;
+		std::stringstream        stream(line);
+		std::string              field;
+		while (std::getline(stream, field, '\t'))
+			fields.push_back(field);
+		if (fields.size() < 5)
+		{
+			printf("ERROR: Malformed line in %s: %s\n", pFileName, line.c_str());
+			return false;
+		}
+
+		// Lines with the same group and name are merged
+		Histogram& histogram = histograms[fields[1] + "/" + fields[2]];
+		histogram.mKind = fields[0];
+		histogram.mTicksPerSecond = strtoull(fields[3].c_str(), NULL, 10);
+		histogram.mCount += strtoull(fields[4].c_str(), NULL, 10);
+		histogram.mCounts.resize(PROFILE_HISTOGRAM_BUCKETS);
+		for (size_t i = 5; i < fields.size(); ++i)
+		{
+			unsigned           bucket = 0;
+			unsigned long long count = 0;
+			if (sscanf(fields[i].c_str(), "%u:%llu", &bucket, &count) != 2 || bucket >= PROFILE_HISTOGRAM_BUCKETS)
+			{
+				printf("ERROR: Malformed bucket in %s: %s\n", pFileName, fields[i].c_str());
+				return false;
+			}
+			histogram.mCounts[bucket] += count;
+		}
+	}
+	return true;
+}
+
+// Two sided standard normal quantile, found by bisection on erfc
+static double NormalQuantile(double confidencePercent)
+{
+	double alpha = 1.0 - confidencePercent / 100.0;
+	double low = 0.0, high = 10.0;
+	for (int i = 0; i < 100; ++i)
+	{
+		double mid = 0.5 * (low + high);
+		if (erfc(mid / sqrt(2.0)) > alpha)
+			low = mid;
+		else
+			high = mid;
+	}
+	return 0.5 * (low + high);
+}
+
+static Estimate EstimatePercentile(const Histogram& histogram, double percentile, double z)
+{
+	const uint64_t* pCounts = histogram.mCounts.data();
+	double          toMs = 1000.0 / (double)histogram.mTicksPerSecond;
+	double          n = (double)histogram.mCount;
+	double          p = percentile / 100.0;
+	double          spread = z * sqrt(n * p * (1.0 - p));
+	double          rank = (double)profileHistogramPercentileRank(histogram.mCount, percentile);
+	uint64_t        lowRank = (uint64_t)fmax(0.0, floor(rank - spread));
+	uint64_t        highRank = (uint64_t)fmin(n - 1.0, ceil(rank + spread));
+
+	Estimate estimate;
+	estimate.mValueMs = profileHistogramPercentile(pCounts, histogram.mCount, percentile) * toMs;
+	estimate.mLowMs = (double)profileHistogramBucketStart(profileHistogramFindRank(pCounts, lowRank)) * toMs;
+	estimate.mHighMs = (double)(profileHistogramBucketStart(profileHistogramFindRank(pCounts, highRank) + 1) - 1) * toMs;
+	return estimate;
+}
+
+static bool ParseSettings(int argc, char** argv, Settings& settings)
+{
+	for (int i = 3; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+		if (!strcmp(arg, "--all"))
+		{
+			settings.mPrintAll = true;
+			continue;
+		}
+		if (!value)
+		{
+			printf("ERROR: Argument expects a value: %s\n", arg);
+			return false;
+		}
+		++i;
+		if (!strcmp(arg, "--threshold"))
+			settings.mThresholdPercent = atof(value);
+		else if (!strcmp(arg, "--min-delta"))
+			settings.mMinDeltaMs = atof(value);
+		else if (!strcmp(arg, "--min-count"))
+			settings.mMinCount = strtoull(value, NULL, 10);
+		else if (!strcmp(arg, "--confidence"))
+			settings.mConfidence = atof(value);
+		else if (!strcmp(arg, "--percentiles"))
+		{
+			settings.mPercentiles.clear();
+			std::stringstream stream(value);
+			std::string       percentile;
+			while (std::getline(stream, percentile, ','))
+				settings.mPercentiles.push_back(atof(percentile.c_str()));
+		}
+		else
+		{
+			printf("ERROR: Unrecognized argument: %s\n", arg);
+			return false;
+		}
+	}
+
+	if (settings.mConfidence <= 0.0 || settings.mConfidence >= 100.0)
+	{
+		printf("ERROR: --confidence must be between 0 and 100\n");
+		return false;
+	}
+	for (double percentile : settings.mPercentiles)
+	{
+		if (percentile <= 0.0 || percentile >= 100.0)
+		{
+			printf("ERROR: Percentiles must be between 0 and 100\n");
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3 || !strcmp(argv[1], "-h") || !strcmp(argv[1], "-help"))
+	{
+		PrintHelp();
+		return argc < 3 ? 2 : 0;
+	}
+
+	Settings settings;
+	if (!ParseSettings(argc, argv, settings))
+		return 2;
+
+	std::map<std::string, Histogram> base, current;
+	if (!LoadHistograms(argv[1], base) || !LoadHistograms(argv[2], current))
+		return 2;
+
+	double   z = NormalQuantile(settings.mConfidence);
+	uint32_t regressions = 0, improvements = 0, compared = 0, skipped = 0;
+
+	printf("%-48s %7s %12s %12s %9s  %s\n", "Scope", "Pct", "Base ms", "New ms", "Change", "Result");
+	for (const auto& entry : current)
+	{
+		auto baseEntry = base.find(entry.first);
+		if (baseEntry == base.end())
+		{
+			if (settings.mPrintAll)
+				printf("%-48s %7s %12s %12s %9s  %s\n", entry.first.c_str(), "", "", "", "", "new scope");
+			continue;
+		}
+
+		const Histogram& before = baseEntry->second;
+		const Histogram& after = entry.second;
+		if (before.mCount < settings.mMinCount || after.mCount < settings.mMinCount || !before.mTicksPerSecond || !after.mTicksPerSecond)
+		{
+			++skipped;
+			continue;
+		}
+		++compared;
+
+		for (double percentile : settings.mPercentiles)
+		{
+			// The tail above a percentile needs a few runs in both captures to say anything about it
+			double tail = 1.0 - percentile / 100.0;
+			if (tail * (double)before.mCount < 5.0 || tail * (double)after.mCount < 5.0)
+				continue;
+
+			Estimate    old = EstimatePercentile(before, percentile, z);
+			Estimate    now = EstimatePercentile(after, percentile, z);
+			double      delta = now.mValueMs - old.mValueMs;
+			double      change = old.mValueMs > 0.0 ? 100.0 * delta / old.mValueMs : 0.0;
+			bool        bLarge = fabs(change) >= settings.mThresholdPercent && fabs(delta) >= settings.mMinDeltaMs;
+			const char* pResult = "";
+			if (bLarge && now.mLowMs > old.mHighMs)
+			{
+				pResult = "REGRESSED";
+				++regressions;
+			}
+			else if (bLarge && now.mHighMs < old.mLowMs)
+			{
+				pResult = "improved";
+				++improvements;
+			}
+			else if (!settings.mPrintAll)
+			{
+				continue;
+			}
+
+			char name[16];
+			snprintf(name, sizeof(name), "p%g", percentile);
+			printf("%-48s %7s %12.4f %12.4f %+8.1f%%  %s\n", entry.first.c_str(), name, old.mValueMs, now.mValueMs, change, pResult);
+		}
+	}
+
+	printf("\n%u regressions, %u improvements in %u scopes (%u skipped with fewer than %llu runs)\n", regressions, improvements, compared,
+		   skipped, (unsigned long long)settings.mMinCount);
+	return regressions ? 1 : 0;
+}
@@ -0,0 +1,519 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Replays an allocation trace against the allocator backends:
+// - system, the C runtime
+// - thread cache, the size-class slabs behind per-thread caches
+// - thread cache + arena, allocations freed within the frame they were made in come from a FrameArena instead
+// Each replay thread runs the whole trace on its own blocks. Blocks are stamped on allocation and checked on free and
+// realloc, so overlapping blocks or a realloc which loses data fail the run.
+//
+// The trace is a text file, one operation per line:
+//   a <id> <size> [<alignment>]   allocate
+//   r <id> <size>                 reallocate
+//   f <id>                        free
+//   n                             next frame
+// Lines starting with # are comments. Without --trace a trace modelled on a frame of the demo is generated: short lived
+// strings and containers growing through realloc, UI geometry, long lived objects and a few blocks above the slab limit.
+// --write-trace saves it for reuse.
+//
+// Usage: AllocatorBenchmark [--trace <file>] [--write-trace <file>] [--frames <n>] [--threads <n>] [--iterations <n>]
+
+#include "../../OS/Interfaces/IThread.h"
+
+#include "../../ThirdParty/OpenSource/EASTL/vector.h"
+
+#include "TestCommon.h"
+
+enum TraceOpType
+{
+	TRACE_ALLOC,
+	TRACE_REALLOC,
+	TRACE_FREE,
+	TRACE_FRAME,
+};
+
+struct TraceOp
+{
+	uint32_t mType;
+	uint32_t mId;
+	uint32_t mSize;
+	uint32_t mAlignment;
+	// Set for allocations which are freed before the next frame
+	bool     mTransient;
+};
+
+struct Trace
+{
+	eastl::vector<TraceOp> mOps;
+	uint32_t               mIdCount;
+	uint32_t               mFrameCount;
+};
+
+enum ReplayMode
+{
+	REPLAY_HEAP,
+	REPLAY_ARENA,
+};
+
+struct ReplayThread
+{
+	const Trace* pTrace;
+	ReplayMode   mMode;
+	uint32_t     mIterations;
+	uint32_t     mIndex;
+	ThreadDesc   mDesc;
+	ThreadHandle mHandle;
+	uint32_t     mErrors;
+	int64_t      mTime;
+};
+
+static const char* GetTestString(int argc, char** argv, const char* pName)
+{
+	for (int i = 1; i + 1 < argc; ++i)
+	{
+		if (!strcmp(argv[i], pName))
+			return argv[i + 1];
+	}
+	return NULL;
+}
+
+/************************************************************************/
+// Trace
+/************************************************************************/
+static uint32_t gRandomState = 0x9e3779b9u;
+
+static uint32_t Random(uint32_t range)
+{
+	gRandomState ^= gRandomState << 13;
+	gRandomState ^= gRandomState >> 17;
+	gRandomState ^= gRandomState << 5;
+	return gRandomState % range;
+}
+
+static void GenerateTrace(uint32_t frameCount, Trace* pTrace)
+{
+	eastl::vector<uint32_t> freeIds;
+	eastl::vector<uint32_t> longLived;
+	uint32_t                idCount = 0;
+	auto allocId = [&]() {
+		if (freeIds.empty())
+			return idCount++;
+		uint32_t id = freeIds.back();
+		freeIds.pop_back();
+		return id;
+	};
+	auto push = [&](uint32_t type, uint32_t id, uint32_t size, uint32_t alignment) {
+		pTrace->mOps.push_back(TraceOp{ type, id, size, alignment, false });
+		if (TRACE_FREE == type)
+			freeIds.push_back(id);
+	};
+
+	for (uint32_t frame = 0; frame < frameCount; ++frame)
+	{
+		eastl::vector<uint32_t> frameIds;
+
+		// Strings and small temporaries
+		for (uint32_t i = 0; i < 400; ++i)
+		{
+			uint32_t id = allocId();
+			push(TRACE_ALLOC, id, 16 + Random(112), 0);
+			frameIds.push_back(id);
+		}
+
+		// Containers growing one push_back at a time
+		for (uint32_t i = 0; i < 40; ++i)
+		{
+			uint32_t id = allocId();
+			uint32_t size = 32;
+			push(TRACE_ALLOC, id, size, 0);
+			for (uint32_t steps = 2 + Random(8); steps; --steps)
+			{
+				size = size * 3 / 2 + 8;
+				push(TRACE_REALLOC, id, size, 0);
+			}
+			frameIds.push_back(id);
+		}
+
+		// UI geometry and constants
+		for (uint32_t i = 0; i < 8; ++i)
+		{
+			uint32_t id = allocId();
+			push(TRACE_ALLOC, id, 4096 + Random(28 * 1024), i & 1 ? 256 : 0);
+			frameIds.push_back(id);
+		}
+
+		// Objects which outlive the frame
+		for (uint32_t i = 0; i < 20; ++i)
+		{
+			uint32_t id = allocId();
+			push(TRACE_ALLOC, id, 64 + Random(2048), i % 4 ? 0 : 64);
+			longLived.push_back(id);
+		}
+		while (longLived.size() > 2000)
+		{
+			uint32_t index = Random((uint32_t)longLived.size());
+			push(TRACE_FREE, longLived[index], 0, 0);
+			longLived[index] = longLived.back();
+			longLived.pop_back();
+		}
+
+		// Loaded data above the slab limit
+		if (frame % 16 == 0)
+		{
+			uint32_t id = allocId();
+			push(TRACE_ALLOC, id, 64 * 1024 + Random(512 * 1024), 0);
+			frameIds.push_back(id);
+		}
+
+		// Frees in a shuffled order
+		for (uint32_t i = (uint32_t)frameIds.size(); i > 1; --i)
+			eastl::swap(frameIds[i - 1], frameIds[Random(i)]);
+		for (uint32_t id : frameIds)
+			push(TRACE_FREE, id, 0, 0);
+		push(TRACE_FRAME, 0, 0, 0);
+	}
+
+	for (uint32_t id : longLived)
+		push(TRACE_FREE, id, 0, 0);
+	pTrace->mIdCount = idCount;
+}
+
+static bool ReadTrace(const char* pPath, Trace* pTrace)
+{
+	FILE* pFile = fopen(pPath, "r");
+	if (!pFile)
+	{
+		printf("ERROR: Cannot open trace %s\n", pPath);
+		return false;
+	}
+
+	char     line[256];
+	uint32_t lineNumber = 0;
+	bool     success = true;
+	while (success && fgets(line, sizeof(line), pFile))
+	{
+		++lineNumber;
+		TraceOp op = {};
+		int     fields = 0;
+		switch (line[0])
+		{
+		case 'a':
+			op.mType = TRACE_ALLOC;
+			fields = sscanf(line + 1, "%u %u %u", &op.mId, &op.mSize, &op.mAlignment);
+			success = fields >= 2;
+			break;
+		case 'r':
+			op.mType = TRACE_REALLOC;
+			success = sscanf(line + 1, "%u %u", &op.mId, &op.mSize) == 2;
+			break;
+		case 'f':
+			op.mType = TRACE_FREE;
+			success = sscanf(line + 1, "%u", &op.mId) == 1;
+			break;
+		case 'n':
+			op.mType = TRACE_FRAME;
+			break;
+		case '#':
+		case '\n':
+		case '\r':
+		case 0:
+			continue;
+		default:
+			success = false;
+			break;
+		}
+
+		if (!success)
+		{
+			printf("ERROR: %s:%u: invalid trace operation\n", pPath, lineNumber);
+			break;
+		}
+		pTrace->mIdCount = max(pTrace->mIdCount, op.mId + 1);
+		pTrace->mOps.push_back(op);
+	}
+	fclose(pFile);
+	return success;
+}
+
+static bool WriteTrace(const char* pPath, const Trace& trace)
+{
+	FILE* pFile = fopen(pPath, "w");
+	if (!pFile)
+		return false;
+
+	fprintf(pFile, "# AllocatorBenchmark trace\n");
+	for (const TraceOp& op : trace.mOps)
+	{
+		switch (op.mType)
+		{
+		case TRACE_ALLOC:
+			if (op.mAlignment)
+				fprintf(pFile, "a %u %u %u\n", op.mId, op.mSize, op.mAlignment);
+			else
+				fprintf(pFile, "a %u %u\n", op.mId, op.mSize);
+			break;
+		case TRACE_REALLOC: fprintf(pFile, "r %u %u\n", op.mId, op.mSize); break;
+		case TRACE_FREE: fprintf(pFile, "f %u\n", op.mId); break;
+		case TRACE_FRAME: fprintf(pFile, "n\n"); break;
+		}
+	}
+	fclose(pFile);
+	return true;
+}
+
+// Marks the allocations whose block is freed before the next frame, and counts the frames
+static bool PrepareTrace(Trace* pTrace)
+{
+	// Index of the live allocation of each id, -1 when the id is free
+	eastl::vector<int32_t>  allocOps(pTrace->mIdCount, -1);
+	eastl::vector<uint32_t> allocFrames(pTrace->mIdCount, 0);
+	pTrace->mFrameCount = 0;
+	for (uint32_t i = 0; i < (uint32_t)pTrace->mOps.size(); ++i)
+	{
+		TraceOp& op = pTrace->mOps[i];
+		if (TRACE_FRAME == op.mType)
+		{
+			++pTrace->mFrameCount;
+			continue;
+		}
+
+		if ((TRACE_ALLOC == op.mType) != (allocOps[op.mId] < 0))
+		{
+			printf("ERROR: Trace operation %u uses id %u in the wrong state\n", i, op.mId);
+			return false;
+		}
+
+		if (TRACE_ALLOC == op.mType)
+		{
+			allocOps[op.mId] = (int32_t)i;
+			allocFrames[op.mId] = pTrace->mFrameCount;
+		}
+		else if (TRACE_FREE == op.mType)
+		{
+			pTrace->mOps[allocOps[op.mId]].mTransient = allocFrames[op.mId] == pTrace->mFrameCount;
+			allocOps[op.mId] = -1;
+		}
+	}
+	return true;
+}
+
+/************************************************************************/
+// Replay
+/************************************************************************/
+static uint8_t GetStamp(uint32_t thread, uint32_t id) { return (uint8_t)(id * 31u + thread * 7u + 1u); }
+
+static void StampBlock(void* pBlock, uint32_t size, uint8_t stamp)
+{
+	uint8_t* pBytes = (uint8_t*)pBlock;
+	pBytes[0] = stamp;
+	pBytes[size - 1] = stamp;
+	pBytes[size / 2] = stamp;
+}
+
+static bool CheckBlock(const void* pBlock, uint32_t size, uint8_t stamp)
+{
+	const uint8_t* pBytes = (const uint8_t*)pBlock;
+	return pBytes[0] == stamp && pBytes[size - 1] == stamp && pBytes[size / 2] == stamp;
+}
+
+static void Replay(void* pData)
+{
+	ReplayThread* pThread = (ReplayThread*)pData;
+	const Trace&  trace = *pThread->pTrace;
+	void**        ppBlocks = (void**)tf_calloc(trace.mIdCount, sizeof(void*));
+	uint32_t*     pSizes = (uint32_t*)tf_calloc(trace.mIdCount, sizeof(uint32_t));
+	bool*         pArenaBlocks = (bool*)tf_calloc(trace.mIdCount, sizeof(bool));
+	FrameArena*   pArena = NULL;
+	if (REPLAY_ARENA == pThread->mMode)
+		initFrameArena(256 * 1024, &pArena);
+
+	int64_t start = getNSec();
+	for (uint32_t iteration = 0; iteration < pThread->mIterations; ++iteration)
+	{
+		for (const TraceOp& op : trace.mOps)
+		{
+			uint8_t stamp = GetStamp(pThread->mIndex, op.mId);
+			switch (op.mType)
+			{
+			case TRACE_ALLOC:
+			{
+				void* pBlock = NULL;
+				pArenaBlocks[op.mId] = pArena && op.mTransient;
+				if (pArenaBlocks[op.mId])
+					pBlock = frameArenaAlloc(pArena, op.mSize, op.mAlignment ? op.mAlignment : 16);
+				else
+					pBlock = op.mAlignment ? tf_memalign(op.mAlignment, op.mSize) : tf_malloc(op.mSize);
+				pThread->mErrors += !pBlock || (op.mAlignment && ((uintptr_t)pBlock & (op.mAlignment - 1)));
+				if (!pBlock)
+					break;
+				StampBlock(pBlock, op.mSize, stamp);
+				ppBlocks[op.mId] = pBlock;
+				pSizes[op.mId] = op.mSize;
+				break;
+			}
+			case TRACE_REALLOC:
+			{
+				void* pBlock = ppBlocks[op.mId];
+				if (!pBlock)
+					break;
+				pThread->mErrors += !CheckBlock(pBlock, pSizes[op.mId], stamp);
+				if (pArenaBlocks[op.mId])
+				{
+					// Arena blocks grow by copying into a new arena block
+					void* pNew = frameArenaAlloc(pArena, op.mSize, 16);
+					memcpy(pNew, pBlock, min(pSizes[op.mId], op.mSize));
+					pBlock = pNew;
+				}
+				else
+				{
+					pBlock = tf_realloc(pBlock, op.mSize);
+				}
+				pThread->mErrors += !pBlock || ((uint8_t*)pBlock)[0] != stamp;
+				if (!pBlock)
+					break;
+				StampBlock(pBlock, op.mSize, stamp);
+				ppBlocks[op.mId] = pBlock;
+				pSizes[op.mId] = op.mSize;
+				break;
+			}
+			case TRACE_FREE:
+				if (!ppBlocks[op.mId])
+					break;
+				pThread->mErrors += !CheckBlock(ppBlocks[op.mId], pSizes[op.mId], stamp);
+				if (!pArenaBlocks[op.mId])
+					tf_free(ppBlocks[op.mId]);
+				ppBlocks[op.mId] = NULL;
+				break;
+			case TRACE_FRAME:
+				if (pArena)
+					resetFrameArena(pArena);
+				break;
+			}
+		}
+	}
+	pThread->mTime = getNSec() - start;
+
+	for (uint32_t id = 0; id < trace.mIdCount; ++id)
+	{
+		if (ppBlocks[id] && !pArenaBlocks[id])
+			tf_free(ppBlocks[id]);
+	}
+	if (pArena)
+		exitFrameArena(pArena);
+	tf_free(ppBlocks);
+	tf_free(pSizes);
+	tf_free(pArenaBlocks);
+}
+
+static void RunReplay(const char* pLabel, MemAllocBackend backend, ReplayMode mode, const Trace& trace, uint32_t threadCount, uint32_t iterations)
+{
+	MemAllocDesc desc = {};
+	desc.pAppName = "AllocatorBenchmark";
+	desc.mBackend = backend;
+	MemAllocInit(&desc);
+
+	ReplayThread* pThreads = (ReplayThread*)tf_calloc(threadCount, sizeof(ReplayThread));
+	int64_t       start = getNSec();
+	for (uint32_t i = 0; i < threadCount; ++i)
+	{
+		pThreads[i].pTrace = &trace;
+		pThreads[i].mMode = mode;
+		pThreads[i].mIterations = iterations;
+		pThreads[i].mIndex = i;
+		pThreads[i].mDesc.pFunc = Replay;
+		pThreads[i].mDesc.pData = &pThreads[i];
+		pThreads[i].mHandle = create_thread(&pThreads[i].mDesc);
+	}
+	uint32_t errors = 0;
+	int64_t  slowest = 0;
+	for (uint32_t i = 0; i < threadCount; ++i)
+	{
+		destroy_thread(pThreads[i].mHandle);
+		errors += pThreads[i].mErrors;
+		slowest = max(slowest, pThreads[i].mTime);
+	}
+	int64_t time = getNSec() - start;
+	tf_free(pThreads);
+
+	uint64_t peakBytes = 0;
+	MemAllocStats stats = {};
+	MemAllocGetStats(&stats);
+	for (uint32_t i = 0; i < stats.mSizeClassCount; ++i)
+		peakBytes += stats.mSizeClasses[i].mPeakBytes;
+
+	// Operations without frame markers
+	const double ops = (double)(trace.mOps.size() - trace.mFrameCount) * iterations * threadCount;
+	printf("%-20s %8.2f Mops/s   %7.3f ms/frame", pLabel, ops / 1e6 / (time / 1e9),
+		NsToMs(slowest) / max(trace.mFrameCount * iterations, 1u));
+	if (stats.mSizeClassCount)
+		printf("   slab peak %6.2f MB", peakBytes / 1e6);
+	printf("\n");
+	TEST_CHECK(errors == 0);
+	TEST_CHECK(stats.mBackend == backend);
+}
+
+int main(int argc, char** argv)
+{
+	if (!InitTestEnvironment("AllocatorBenchmark"))
+		return EXIT_FAILURE;
+
+	uint32_t    threadCount = max(GetTestArg(argc, argv, "--threads", 4), 1u);
+	uint32_t    iterations = max(GetTestArg(argc, argv, "--iterations", 1), 1u);
+	const char* pTracePath = GetTestString(argc, argv, "--trace");
+	const char* pWritePath = GetTestString(argc, argv, "--write-trace");
+
+	Trace trace = {};
+	if (pTracePath)
+	{
+		if (!ReadTrace(pTracePath, &trace))
+		{
+			ExitTestEnvironment();
+			return EXIT_FAILURE;
+		}
+	}
+	else
+	{
+		GenerateTrace(max(GetTestArg(argc, argv, "--frames", 300), 1u), &trace);
+	}
+	if (pWritePath && !WriteTrace(pWritePath, trace))
+		printf("ERROR: Cannot write trace %s\n", pWritePath);
+
+	if (!PrepareTrace(&trace))
+	{
+		ExitTestEnvironment();
+		return EXIT_FAILURE;
+	}
+
+	printf("%u operations, %u frames, %u threads\n", (uint32_t)(trace.mOps.size() - trace.mFrameCount), trace.mFrameCount, threadCount);
+	RunReplay("system", MEM_ALLOC_BACKEND_SYSTEM, REPLAY_HEAP, trace, threadCount, iterations);
+	RunReplay("thread cache", MEM_ALLOC_BACKEND_THREAD_CACHE, REPLAY_HEAP, trace, threadCount, iterations);
+	RunReplay("thread cache + arena", MEM_ALLOC_BACKEND_THREAD_CACHE, REPLAY_ARENA, trace, threadCount, iterations);
+
+	// Back to the backend the environment was set up with
+	MemAllocDesc desc = {};
+	desc.mBackend = MEM_ALLOC_BACKEND_SYSTEM;
+	MemAllocInit(&desc);
+	return ExitTestEnvironment();
+}
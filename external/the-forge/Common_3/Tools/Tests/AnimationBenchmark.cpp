@@ -0,0 +1,320 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Measures how many rigs the AnimationSystem updates per millisecond, without a renderer:
+// - a crowd of characters, each blending two clips, updated on the calling thread and over a ThreadSystem
+// - the threaded update poses every rig exactly like the single threaded one
+// - with a sampling LOD, far rigs are sampled every few frames and the sampled count per frame matches the LOD setup
+//
+// No .ozz data is bundled, so a 53 joint humanoid skeleton and a walk and a run clip are built with the ozz offline
+// builders, saved as .ozz files and loaded through Rig and Clip like assets.
+//
+// Options: --rigs <largest crowd> --frames <updates per measurement> --threads <workers>
+
+#include "../../OS/Interfaces/IFileSystem.h"
+#include "../../OS/Interfaces/IThread.h"
+#include "../../../Middleware_3/Animation/AnimationSystem.h"
+#include "../../ThirdParty/OpenSource/ozz-animation/include/ozz/animation/offline/animation_builder.h"
+#include "../../ThirdParty/OpenSource/ozz-animation/include/ozz/animation/offline/raw_animation.h"
+#include "../../ThirdParty/OpenSource/ozz-animation/include/ozz/animation/offline/raw_skeleton.h"
+#include "../../ThirdParty/OpenSource/ozz-animation/include/ozz/animation/offline/skeleton_builder.h"
+
+#include "TestCommon.h"
+
+using ozz::animation::offline::RawAnimation;
+using ozz::animation::offline::RawSkeleton;
+
+static const char* gSkeletonFile = "AnimationBenchmarkSkeleton.ozz";
+static const char* gClipFiles[] = { "AnimationBenchmarkWalk.ozz", "AnimationBenchmarkRun.ozz" };
+
+static RawSkeleton::Joint MakeJoint(const char* pName, float x, float y, float z)
+{
+	RawSkeleton::Joint joint;
+	joint.name = pName;
+	joint.transform.translation = Vector3(x, y, z);
+	joint.transform.rotation = Quat::identity();
+	joint.transform.scale = Vector3(1.0f);
+	return joint;
+}
+
+// Appends a chain of count joints going along the offset, returns the last one
+static RawSkeleton::Joint* AddChain(RawSkeleton::Joint* pParent, const char* pName, uint32_t count, float x, float y, float z)
+{
+	char name[64];
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		snprintf(name, sizeof(name), "%s%u", pName, i);
+		pParent->children.push_back(MakeJoint(name, x, y, z));
+		pParent = &pParent->children.back();
+	}
+	return pParent;
+}
+
+// Pelvis, spine, head, two arms with five three joint fingers each, two legs
+static void BuildSkeleton(RawSkeleton* pRaw)
+{
+	pRaw->roots.push_back(MakeJoint("Pelvis", 0.0f, 1.0f, 0.0f));
+	RawSkeleton::Joint* pPelvis = &pRaw->roots.back();
+	pPelvis->children.reserve(3);
+	RawSkeleton::Joint* pChest = AddChain(pPelvis, "Spine", 4, 0.0f, 0.12f, 0.0f);
+	pChest->children.reserve(3);
+	AddChain(pChest, "Head", 2, 0.0f, 0.1f, 0.0f);
+	for (float side = -1.0f; side <= 1.0f; side += 2.0f)
+	{
+		RawSkeleton::Joint* pHand = AddChain(pChest, side < 0.0f ? "LeftArm" : "RightArm", 4, side * 0.15f, 0.0f, 0.0f);
+		pHand->children.reserve(5);
+		for (uint32_t finger = 0; finger < 5; ++finger)
+		{
+			char name[32];
+			snprintf(name, sizeof(name), "%sFinger%u_", side < 0.0f ? "Left" : "Right", finger);
+			AddChain(pHand, name, 3, side * 0.03f, 0.0f, (finger - 2.0f) * 0.02f);
+		}
+		AddChain(pPelvis, side < 0.0f ? "LeftLeg" : "RightLeg", 4, side * 0.05f, -0.22f, 0.0f);
+	}
+}
+
+// Every joint swings around its local x axis with its own phase, keys at 30 fps
+static void BuildClip(const ozz::animation::Skeleton& skeleton, float duration, float amplitude, RawAnimation* pRaw)
+{
+	const uint32_t jointCount = (uint32_t)skeleton.num_joints();
+	const uint32_t keyCount = (uint32_t)(duration * 30.0f) + 1;
+	pRaw->duration = duration;
+	pRaw->tracks.resize(jointCount);
+	for (uint32_t joint = 0; joint < jointCount; ++joint)
+	{
+		RawAnimation::JointTrack& track = pRaw->tracks[joint];
+		const AffineTransform& bind = ozz::animation::GetJointLocalBindPose(skeleton, (int)joint);
+		RawAnimation::TranslationKey translation = { 0.0f, bind.translation };
+		track.translations.push_back(translation);
+		for (uint32_t key = 0; key < keyCount; ++key)
+		{
+			const float time = duration * key / (keyCount - 1);
+			const float angle = amplitude * sinf(6.2831853f * time / duration + joint * 0.7f);
+			RawAnimation::RotationKey rotation = { time, Quat::rotationX(angle) };
+			track.rotations.push_back(rotation);
+		}
+		RawAnimation::ScaleKey scale = { 0.0f, Vector3(1.0f) };
+		track.scales.push_back(scale);
+	}
+}
+
+template <typename T>
+static bool SaveArchive(const char* pFileName, const T& object)
+{
+	FileStream stream = {};
+	if (!fsOpenStreamFromPath(RD_ANIMATIONS, pFileName, FM_WRITE_BINARY, &stream))
+		return false;
+	{
+		ozz::io::OArchive archive(&stream);
+		archive << object;
+	}
+	fsCloseStream(&stream);
+	return true;
+}
+
+static bool WriteAssets()
+{
+	RawSkeleton rawSkeleton;
+	BuildSkeleton(&rawSkeleton);
+	ozz::animation::Skeleton skeleton;
+	if (!ozz::animation::offline::SkeletonBuilder::Build(rawSkeleton, &skeleton) || !SaveArchive(gSkeletonFile, skeleton))
+		return false;
+
+	const float durations[] = { 1.2f, 0.7f };
+	const float amplitudes[] = { 0.4f, 0.7f };
+	bool success = true;
+	for (uint32_t clip = 0; clip < 2 && success; ++clip)
+	{
+		RawAnimation rawClip;
+		BuildClip(skeleton, durations[clip], amplitudes[clip], &rawClip);
+		ozz::animation::Animation animation;
+		success = ozz::animation::offline::AnimationBuilder::Build(rawClip, &animation) && SaveArchive(gClipFiles[clip], animation);
+		animation.Deallocate();
+	}
+	printf("Skeleton with %d joints, clips of %.1f s and %.1f s\n", skeleton.num_joints(), durations[0], durations[1]);
+	skeleton.Deallocate();
+	return success;
+}
+
+// A character owns its rig, clips and animation, so characters can be updated independently
+struct Character
+{
+	Rig            mRig;
+	Clip           mClips[2];
+	ClipController mClipControllers[2];
+	Animation      mAnimation;
+	AnimatedObject mObject;
+};
+
+static Character* CreateCrowd(uint32_t rigCount)
+{
+	Character* pCrowd = (Character*)tf_calloc(rigCount, sizeof(Character));
+	for (uint32_t i = 0; i < rigCount; ++i)
+	{
+		Character* pCharacter = tf_placement_new<Character>(&pCrowd[i]);
+		pCharacter->mRig.Initialize(RD_ANIMATIONS, gSkeletonFile);
+
+		AnimationDesc desc = {};
+		desc.mRig = &pCharacter->mRig;
+		desc.mNumLayers = 2;
+		desc.mBlendType = BlendType::EQUAL;
+		for (uint32_t clip = 0; clip < 2; ++clip)
+		{
+			pCharacter->mClips[clip].Initialize(RD_ANIMATIONS, gClipFiles[clip], &pCharacter->mRig);
+			pCharacter->mClipControllers[clip].Initialize(pCharacter->mClips[clip].GetDuration());
+			desc.mLayerProperties[clip].mClip = &pCharacter->mClips[clip];
+			desc.mLayerProperties[clip].mClipController = &pCharacter->mClipControllers[clip];
+		}
+		pCharacter->mAnimation.Initialize(desc);
+		pCharacter->mObject.Initialize(&pCharacter->mRig, &pCharacter->mAnimation);
+
+		// On a grid around the origin, which is where the view is
+		const float spacing = 2.0f;
+		const uint32_t side = (uint32_t)sqrtf((float)rigCount) + 1;
+		pCharacter->mObject.SetRootTransform(
+			mat4::translation(vec3((i % side - side * 0.5f) * spacing, 0.0f, (i / side - side * 0.5f) * spacing)));
+	}
+	return pCrowd;
+}
+
+static void DestroyCrowd(Character* pCrowd, uint32_t rigCount)
+{
+	for (uint32_t i = 0; i < rigCount; ++i)
+	{
+		Character& character = pCrowd[i];
+		character.mObject.Destroy();
+		character.mAnimation.Destroy();
+		for (uint32_t clip = 0; clip < 2; ++clip)
+			character.mClips[clip].Destroy();
+		character.mRig.Destroy();
+		character.~Character();
+	}
+	tf_free(pCrowd);
+}
+
+// Returns the best frame time in ms
+static double RunCrowd(ThreadSystem* pThreadSystem, Character* pCrowd, uint32_t rigCount, uint32_t frameCount,
+					   const AnimationLOD* pLods, uint32_t lodCount, uint32_t* pSampledTotal)
+{
+	AnimationSystem system;
+	system.Initialize(pThreadSystem);
+	system.SetLODs(pLods, lodCount);
+	for (uint32_t i = 0; i < rigCount; ++i)
+		system.AddObject(&pCrowd[i].mObject);
+
+	double bestMs = 1e30;
+	uint32_t failed = 0;
+	*pSampledTotal = 0;
+	for (uint32_t frame = 0; frame < frameCount; ++frame)
+	{
+		const int64_t start = getNSec();
+		failed += system.Update(1.0f / 60.0f) ? 0 : 1;
+		const double ms = NsToMs(getNSec() - start);
+		bestMs = ms < bestMs ? ms : bestMs;
+		*pSampledTotal += system.GetSampledObjectCount();
+	}
+	TEST_CHECK(failed == 0);
+	system.Destroy();
+	return bestMs;
+}
+
+static uint32_t CountPoseMismatches(Character* pA, Character* pB, uint32_t rigCount)
+{
+	uint32_t mismatches = 0;
+	for (uint32_t i = 0; i < rigCount; ++i)
+	{
+		for (uint32_t joint = 0; joint < pA[i].mRig.GetNumJoints(); ++joint)
+		{
+			Matrix4 a = pA[i].mRig.GetJointWorldMat(joint);
+			Matrix4 b = pB[i].mRig.GetJointWorldMat(joint);
+			if (memcmp(&a, &b, sizeof(a)) != 0)
+			{
+				++mismatches;
+				break;
+			}
+		}
+	}
+	return mismatches;
+}
+
+static void BenchmarkCrowd(ThreadSystem* pThreadSystem, uint32_t rigCount, uint32_t frameCount, uint32_t threadCount)
+{
+	Character* pSerialCrowd = CreateCrowd(rigCount);
+	Character* pThreadedCrowd = CreateCrowd(rigCount);
+	uint32_t sampled = 0;
+
+	const double serialMs = RunCrowd(NULL, pSerialCrowd, rigCount, frameCount, NULL, 0, &sampled);
+	TEST_CHECK(sampled == rigCount * frameCount);
+	const double threadedMs = RunCrowd(pThreadSystem, pThreadedCrowd, rigCount, frameCount, NULL, 0, &sampled);
+	TEST_CHECK(sampled == rigCount * frameCount);
+	const uint32_t mismatches = CountPoseMismatches(pSerialCrowd, pThreadedCrowd, rigCount);
+	TEST_CHECK(mismatches == 0);
+
+	// Every rig outside the first ring samples every 4 frames, over a multiple of 4 frames each samples a quarter
+	// of the frames
+	const float lodDistance = 8.0f;
+	AnimationLOD lod = { lodDistance, 4 };
+	uint32_t nearCount = 0;
+	for (uint32_t i = 0; i < rigCount; ++i)
+		nearCount += length(pThreadedCrowd[i].mObject.GetRootTransform().getTranslation()) < lodDistance ? 1 : 0;
+	const uint32_t lodFrames = (frameCount + 3) / 4 * 4;
+	const double lodMs = RunCrowd(pThreadSystem, pThreadedCrowd, rigCount, lodFrames, &lod, 1, &sampled);
+	TEST_CHECK(sampled == nearCount * lodFrames + (rigCount - nearCount) * lodFrames / 4);
+
+	printf("  %6u rigs: 1 thread %8.2f rigs/ms, %u threads %8.2f rigs/ms (%.2fx), with LOD %8.2f rigs/ms, %u pose mismatches\n",
+		   rigCount, rigCount / serialMs, threadCount, rigCount / threadedMs, serialMs / threadedMs, rigCount / lodMs, mismatches);
+
+	DestroyCrowd(pThreadedCrowd, rigCount);
+	DestroyCrowd(pSerialCrowd, rigCount);
+}
+
+int main(int argc, char** argv)
+{
+	const uint32_t maxRigCount = GetTestArg(argc, argv, "--rigs", 1024);
+	const uint32_t frameCount = GetTestArg(argc, argv, "--frames", 60);
+	const uint32_t threadCount = GetTestArg(argc, argv, "--threads", Thread::GetNumCPUCores());
+	if (maxRigCount < 16 || !frameCount || !threadCount)
+	{
+		printf("--rigs must be at least 16, --frames and --threads greater than zero\n");
+		return EXIT_FAILURE;
+	}
+
+	if (!InitTestEnvironment("AnimationBenchmark"))
+		return EXIT_FAILURE;
+	fsSetPathForResourceDir(pSystemFileIO, RM_DEBUG, RD_ANIMATIONS, "");
+
+	TEST_CHECK(WriteAssets());
+	if (gTestFailures)
+		return ExitTestEnvironment();
+
+	ThreadSystem* pThreadSystem = NULL;
+	initThreadSystem(&pThreadSystem, threadCount, 0, true, "Animation");
+
+	printf("Best frame of %u, rigs updated per millisecond:\n", frameCount);
+	for (uint32_t rigCount = 16; rigCount <= maxRigCount; rigCount *= 4)
+		BenchmarkCrowd(pThreadSystem, rigCount, frameCount, threadCount);
+
+	shutdownThreadSystem(pThreadSystem);
+	return ExitTestEnvironment();
+}
@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Compares the archetype data components of the EntityManager with its BaseComponent components:
+// - create, iterate and destroy rates for entities with a position and a velocity, from 10k entities up to --max-entities
+// - BaseComponent iteration walks the position lookup and finds the velocity on the entity, like existing systems do.
+//   Archetype iteration uses forEach and parallelForEach over the thread system.
+// - all three iterations integrate the same values, the checksums have to match, and parallelForEach visits every
+//   entity once per pass
+//
+// Options: --max-entities <largest entity count> --passes <iteration passes, the best is kept> --threads <workers>
+
+#include "../../OS/Interfaces/IThread.h"
+#include "../../OS/Core/Atomics.h"
+#include "../../OS/Core/ThreadSystem.h"
+#include "../../../Middleware_3/ECS/EntityManager.h"
+#include "../../../Middleware_3/ECS/ComponentRepresentation.h"
+
+#include "TestCommon.h"
+
+// BaseComponent versions. Every BaseComponent needs a representation, these expose no variables.
+class PositionComponent: public BaseComponent
+{
+	FORGE_DECLARE_COMPONENT(PositionComponent)
+public:
+	float mX, mY, mZ;
+};
+
+class VelocityComponent: public BaseComponent
+{
+	FORGE_DECLARE_COMPONENT(VelocityComponent)
+public:
+	float mX, mY, mZ;
+};
+
+FORGE_START_GENERATE_COMPONENT_REPRESENTATION(PositionComponent)
+FORGE_END_GENERATE_COMPONENT_REPRESENTATION
+FORGE_START_GENERATE_COMPONENT_REPRESENTATION(VelocityComponent)
+FORGE_END_GENERATE_COMPONENT_REPRESENTATION
+
+FORGE_DEFINE_COMPONENT_ID(PositionComponent)
+FORGE_START_VAR_REPRESENTATIONS_BUILD(PositionComponent)
+FORGE_END_VAR_REPRESENTATIONS_BUILD(PositionComponent)
+FORGE_START_VAR_REFERENCES(PositionComponent)
+FORGE_END_VAR_REFERENCES
+FORGE_IMPLEMENT_COMPONENT(PositionComponent)
+
+FORGE_DEFINE_COMPONENT_ID(VelocityComponent)
+FORGE_START_VAR_REPRESENTATIONS_BUILD(VelocityComponent)
+FORGE_END_VAR_REPRESENTATIONS_BUILD(VelocityComponent)
+FORGE_START_VAR_REFERENCES(VelocityComponent)
+FORGE_END_VAR_REFERENCES
+FORGE_IMPLEMENT_COMPONENT(VelocityComponent)
+
+// Data component versions
+struct Position
+{
+	float mX, mY, mZ;
+};
+
+struct Velocity
+{
+	float mX, mY, mZ;
+};
+
+// Small integers, so the sums are exact in any order
+static float GetSpeed(uint32_t index) { return (float)(index % 8); }
+
+struct RunResult
+{
+	double mCreateMs;
+	double mIterateMs;
+	double mParallelMs;
+	double mDestroyMs;
+	double mChecksum;
+	double mParallelChecksum;
+};
+
+static double Best(double a, double b) { return a < b ? a : b; }
+
+static RunResult RunBaseComponents(EntityManager& entityManager, uint32_t entityCount, uint32_t passCount)
+{
+	RunResult result = {};
+	eastl::vector<EntityId> ids(entityCount);
+
+	int64_t start = getNSec();
+	for (uint32_t i = 0; i < entityCount; ++i)
+	{
+		ids[i] = entityManager.createEntity();
+		PositionComponent& position = entityManager.addComponentToEntity<PositionComponent>(ids[i]);
+		position.mX = position.mY = position.mZ = 0.0f;
+		VelocityComponent& velocity = entityManager.addComponentToEntity<VelocityComponent>(ids[i]);
+		velocity.mX = GetSpeed(i);
+		velocity.mY = velocity.mZ = 1.0f;
+	}
+	result.mCreateMs = NsToMs(getNSec() - start);
+
+	result.mIterateMs = 1e30;
+	for (uint32_t pass = 0; pass < passCount; ++pass)
+	{
+		start = getNSec();
+		for (const Pair& pair : entityManager.getByComponent<PositionComponent>())
+		{
+			PositionComponent* pPosition = (PositionComponent*)pair.second;
+			const VelocityComponent* pVelocity = entityManager.getEntityById(pair.first)->getComponent<VelocityComponent>();
+			pPosition->mX += pVelocity->mX;
+			pPosition->mY += pVelocity->mY;
+			pPosition->mZ += pVelocity->mZ;
+		}
+		result.mIterateMs = Best(result.mIterateMs, NsToMs(getNSec() - start));
+	}
+
+	for (const Pair& pair : entityManager.getByComponent<PositionComponent>())
+		result.mChecksum += ((PositionComponent*)pair.second)->mX;
+
+	start = getNSec();
+	for (uint32_t i = 0; i < entityCount; ++i)
+		entityManager.deleteEntity(ids[i]);
+	result.mDestroyMs = NsToMs(getNSec() - start);
+	return result;
+}
+
+static RunResult RunDataComponents(EntityManager& entityManager, ThreadSystem* pThreadSystem, uint32_t entityCount, uint32_t passCount)
+{
+	RunResult result = {};
+	eastl::vector<EntityId> ids(entityCount);
+
+	int64_t start = getNSec();
+	for (uint32_t i = 0; i < entityCount; ++i)
+	{
+		ids[i] = entityManager.createEntity();
+		entityManager.addComponentDataToEntity<Position>(ids[i]) = { 0.0f, 0.0f, 0.0f };
+		entityManager.addComponentDataToEntity<Velocity>(ids[i]) = { GetSpeed(i), 1.0f, 1.0f };
+	}
+	result.mCreateMs = NsToMs(getNSec() - start);
+
+	auto integrate = [](EntityId, Position& position, const Velocity& velocity) {
+		position.mX += velocity.mX;
+		position.mY += velocity.mY;
+		position.mZ += velocity.mZ;
+	};
+
+	result.mIterateMs = 1e30;
+	for (uint32_t pass = 0; pass < passCount; ++pass)
+	{
+		start = getNSec();
+		entityManager.forEach<Position, Velocity>(integrate);
+		result.mIterateMs = Best(result.mIterateMs, NsToMs(getNSec() - start));
+	}
+	entityManager.forEach<Position>([&result](EntityId, const Position& position) { result.mChecksum += position.mX; });
+
+	// Same passes again in parallel, every entity has to be visited once per pass
+	tfrg_atomic32_t visited = 0;
+	auto integrateAndCount = [&visited](EntityId, Position& position, const Velocity& velocity) {
+		position.mX += velocity.mX;
+		position.mY += velocity.mY;
+		position.mZ += velocity.mZ;
+		tfrg_atomic32_add_relaxed(&visited, 1);
+	};
+	entityManager.forEach<Position>([](EntityId, Position& position) { position = { 0.0f, 0.0f, 0.0f }; });
+	result.mParallelMs = 1e30;
+	for (uint32_t pass = 0; pass < passCount; ++pass)
+	{
+		start = getNSec();
+		entityManager.parallelForEach<Position, Velocity>(pThreadSystem, integrateAndCount);
+		result.mParallelMs = Best(result.mParallelMs, NsToMs(getNSec() - start));
+	}
+	TEST_CHECK((uint32_t)tfrg_atomic32_load_relaxed(&visited) == entityCount * passCount);
+	entityManager.forEach<Position>([&result](EntityId, const Position& position) { result.mParallelChecksum += position.mX; });
+
+	start = getNSec();
+	for (uint32_t i = 0; i < entityCount; ++i)
+		entityManager.deleteEntity(ids[i]);
+	result.mDestroyMs = NsToMs(getNSec() - start);
+
+	uint32_t left = 0;
+	entityManager.forEach<Position>([&left](EntityId, const Position&) { ++left; });
+	TEST_CHECK(left == 0);
+	return result;
+}
+
+static double PerSecond(uint32_t count, double ms) { return ms > 0.0 ? count / (ms / 1000.0) / 1e6 : 0.0; }
+
+int main(int argc, char** argv)
+{
+	const uint32_t maxEntityCount = GetTestArg(argc, argv, "--max-entities", 1000000);
+	const uint32_t passCount = GetTestArg(argc, argv, "--passes", 5);
+	const uint32_t threadCount = GetTestArg(argc, argv, "--threads", Thread::GetNumCPUCores());
+	if (maxEntityCount < 10000 || !passCount || !threadCount)
+	{
+		printf("--max-entities must be at least 10000, --passes and --threads greater than zero\n");
+		return EXIT_FAILURE;
+	}
+
+	if (!InitTestEnvironment("ArchetypeBenchmark"))
+		return EXIT_FAILURE;
+
+	// Registers the BaseComponent generators, the EntityManager looks them up when it is constructed
+	FORGE_INIT_COMPONENT_ID(PositionComponent);
+	FORGE_INIT_COMPONENT_ID(VelocityComponent);
+
+	ThreadSystem* pThreadSystem = NULL;
+	initThreadSystem(&pThreadSystem, threadCount, 0, true, "ArchetypeQuery");
+	EntityManager* pEntityManager = tf_new(EntityManager);
+
+	printf("Million entities or entity updates per second, %u passes, %u workers:\n", passCount, threadCount);
+	printf("  %9s %-15s %8s %8s %10s %8s\n", "entities", "storage", "create", "iterate", "parallel", "destroy");
+	for (uint32_t entityCount = 10000; entityCount <= maxEntityCount; entityCount *= 10)
+	{
+		RunResult base = RunBaseComponents(*pEntityManager, entityCount, passCount);
+		RunResult data = RunDataComponents(*pEntityManager, pThreadSystem, entityCount, passCount);
+
+		TEST_CHECK(base.mChecksum == data.mChecksum);
+		TEST_CHECK(data.mChecksum == data.mParallelChecksum);
+
+		printf("  %9u %-15s %8.2f %8.2f %10s %8.2f\n", entityCount, "BaseComponent", PerSecond(entityCount, base.mCreateMs),
+			   PerSecond(entityCount, base.mIterateMs), "-", PerSecond(entityCount, base.mDestroyMs));
+		printf("  %9u %-15s %8.2f %8.2f %10.2f %8.2f\n", entityCount, "archetype", PerSecond(entityCount, data.mCreateMs),
+			   PerSecond(entityCount, data.mIterateMs), PerSecond(entityCount, data.mParallelMs), PerSecond(entityCount, data.mDestroyMs));
+		printf("  %9u %-15s %7.1fx %7.1fx %9.1fx %7.1fx\n", entityCount, "speedup", base.mCreateMs / data.mCreateMs,
+			   base.mIterateMs / data.mIterateMs, base.mIterateMs / data.mParallelMs, base.mDestroyMs / data.mDestroyMs);
+	}
+
+	tf_delete(pEntityManager);
+	shutdownThreadSystem(pThreadSystem);
+
+	return ExitTestEnvironment();
+}
@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Serial reads, one blocking open and read per file like the loaders used to do, against batched reads through an
+// AsyncReadQueue. Two workloads:
+// - many small files, one request per file
+// - a few large files, split into chunk sized requests
+// Every read is checked against the data the file was written with. With --cold the page cache of the files is
+// dropped before each run (Linux only), otherwise the numbers are warm cache numbers.
+//
+// Options: --small-files <n> --small-size <bytes> --large-files <n> --large-size <MB> --chunk <KB> --depth <n> --cold
+
+#include "../../OS/Interfaces/IFileSystem.h"
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "TestCommon.h"
+
+static const ResourceDirectory READ_DIR = RD_OTHER_FILES;
+
+struct ReadFile
+{
+	char   mName[64];
+	size_t mSize;
+};
+
+static uint8_t GetFileByte(uint32_t file, size_t offset) { return (uint8_t)(file * 131u + offset * 7u + (offset >> 12)); }
+
+static bool WriteFiles(const char* pPrefix, uint32_t count, size_t size, ReadFile* pFiles)
+{
+	const size_t blockSize = 1 << 20;
+	uint8_t*     pBlock = (uint8_t*)tf_malloc(min(size, blockSize));
+	bool         success = true;
+	for (uint32_t i = 0; i < count && success; ++i)
+	{
+		snprintf(pFiles[i].mName, sizeof(pFiles[i].mName), "%s%05u.bin", pPrefix, i);
+		pFiles[i].mSize = size;
+
+		FileStream stream = {};
+		success = fsOpenStreamFromPath(READ_DIR, pFiles[i].mName, FM_WRITE_BINARY, &stream);
+		for (size_t offset = 0; offset < size && success; offset += blockSize)
+		{
+			size_t bytes = min(size - offset, blockSize);
+			for (size_t b = 0; b < bytes; ++b)
+				pBlock[b] = GetFileByte(i, offset + b);
+			success = fsWriteToStream(&stream, pBlock, bytes) == bytes;
+		}
+		fsCloseStream(&stream);
+	}
+	tf_free(pBlock);
+	return success;
+}
+
+static void DropFileCache(const ReadFile* pFiles, uint32_t count)
+{
+#if defined(__linux__)
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		char path[FS_MAX_PATH] = {};
+		fsAppendPathComponent(fsGetResourceDirectory(READ_DIR), pFiles[i].mName, path);
+		int fd = open(path, O_RDONLY);
+		if (fd >= 0)
+		{
+			fdatasync(fd);
+			posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+			close(fd);
+		}
+	}
+#else
+	(void)pFiles;
+	(void)count;
+#endif
+}
+
+static uint32_t CountMismatches(const ReadFile* pFiles, uint32_t count, uint8_t* const* ppData)
+{
+	uint32_t mismatches = 0;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		for (size_t offset = 0; offset < pFiles[i].mSize; ++offset)
+		{
+			if (ppData[i][offset] != GetFileByte(i, offset))
+			{
+				++mismatches;
+				break;
+			}
+		}
+		memset(ppData[i], 0, pFiles[i].mSize);
+	}
+	return mismatches;
+}
+
+static int64_t ReadSerial(const ReadFile* pFiles, uint32_t count, uint8_t* const* ppData)
+{
+	int64_t start = getNSec();
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		FileStream stream = {};
+		if (fsOpenStreamFromPath(READ_DIR, pFiles[i].mName, FM_READ_BINARY, &stream))
+		{
+			fsReadFromStream(&stream, ppData[i], pFiles[i].mSize);
+			fsCloseStream(&stream);
+		}
+	}
+	return getNSec() - start;
+}
+
+static int64_t ReadBatched(const ReadFile* pFiles, uint32_t count, uint8_t* const* ppData, size_t chunkSize, uint32_t depth)
+{
+	uint32_t requestCount = 0;
+	for (uint32_t i = 0; i < count; ++i)
+		requestCount += (uint32_t)((pFiles[i].mSize + chunkSize - 1) / chunkSize);
+
+	AsyncReadRequest*  pRequests = (AsyncReadRequest*)tf_calloc(requestCount, sizeof(AsyncReadRequest));
+	AsyncReadRequest** ppRequests = (AsyncReadRequest**)tf_malloc(requestCount * sizeof(AsyncReadRequest*));
+	AsyncReadRequest** ppCompleted = (AsyncReadRequest**)tf_malloc(depth * sizeof(AsyncReadRequest*));
+	uint32_t           request = 0;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		for (size_t offset = 0; offset < pFiles[i].mSize; offset += chunkSize)
+		{
+			AsyncReadRequest* pRequest = &pRequests[request];
+			pRequest->mResourceDir = READ_DIR;
+			pRequest->pFileName = pFiles[i].mName;
+			pRequest->mOffset = offset;
+			pRequest->mSize = min(pFiles[i].mSize - offset, chunkSize);
+			pRequest->pDestination = ppData[i] + offset;
+			ppRequests[request++] = pRequest;
+		}
+	}
+
+	int64_t         start = getNSec();
+	AsyncReadQueue* pQueue = NULL;
+	fsCreateAsyncReadQueue(depth, &pQueue);
+	uint32_t submitted = 0;
+	uint32_t completed = 0;
+	uint32_t failed = 0;
+	while (completed < requestCount)
+	{
+		submitted += fsSubmitAsyncReads(pQueue, requestCount - submitted, ppRequests + submitted);
+		uint32_t done = fsWaitAsyncReads(pQueue, 1, depth, ppCompleted);
+		for (uint32_t i = 0; i < done; ++i)
+			failed += ppCompleted[i]->mBytesRead != (ssize_t)ppCompleted[i]->mSize;
+		completed += done;
+	}
+	fsDestroyAsyncReadQueue(pQueue);
+	int64_t time = getNSec() - start;
+	TEST_CHECK(failed == 0);
+
+	tf_free(pRequests);
+	tf_free(ppRequests);
+	tf_free(ppCompleted);
+	return time;
+}
+
+static void RunWorkload(const char* pLabel, const ReadFile* pFiles, uint32_t count, size_t chunkSize, uint32_t depth, bool cold)
+{
+	uint8_t** ppData = (uint8_t**)tf_malloc(count * sizeof(uint8_t*));
+	size_t    totalSize = 0;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		ppData[i] = (uint8_t*)tf_calloc(1, pFiles[i].mSize);
+		totalSize += pFiles[i].mSize;
+	}
+
+	if (cold)
+		DropFileCache(pFiles, count);
+	int64_t serialTime = ReadSerial(pFiles, count, ppData);
+	TEST_CHECK(CountMismatches(pFiles, count, ppData) == 0);
+
+	if (cold)
+		DropFileCache(pFiles, count);
+	int64_t batchedTime = ReadBatched(pFiles, count, ppData, chunkSize, depth);
+	TEST_CHECK(CountMismatches(pFiles, count, ppData) == 0);
+
+	printf("%-6s %5u files %9.1f MB   serial %9.3f ms %8.1f MB/s   batched %9.3f ms %8.1f MB/s   %5.2fx\n", pLabel, count,
+		totalSize / 1e6, NsToMs(serialTime), totalSize / 1e6 / (serialTime / 1e9), NsToMs(batchedTime),
+		totalSize / 1e6 / (batchedTime / 1e9), (double)serialTime / batchedTime);
+
+	for (uint32_t i = 0; i < count; ++i)
+		tf_free(ppData[i]);
+	tf_free(ppData);
+}
+
+int main(int argc, char** argv)
+{
+	if (!InitTestEnvironment("AsyncReadBenchmark"))
+		return EXIT_FAILURE;
+
+	uint32_t smallCount = max(GetTestArg(argc, argv, "--small-files", 2000), 1u);
+	size_t   smallSize = max(GetTestArg(argc, argv, "--small-size", 16 << 10), 1u);
+	uint32_t largeCount = max(GetTestArg(argc, argv, "--large-files", 2), 1u);
+	size_t   largeSize = (size_t)max(GetTestArg(argc, argv, "--large-size", 256), 1u) << 20;
+	size_t   chunkSize = (size_t)max(GetTestArg(argc, argv, "--chunk", 4096), 4u) << 10;
+	uint32_t depth = max(GetTestArg(argc, argv, "--depth", 64), 1u);
+	bool     cold = HasTestFlag(argc, argv, "--cold");
+	fsSetPathForResourceDir(pSystemFileIO, RM_DEBUG, READ_DIR, "");
+
+	ReadFile* pSmallFiles = (ReadFile*)tf_calloc(smallCount, sizeof(ReadFile));
+	ReadFile* pLargeFiles = (ReadFile*)tf_calloc(largeCount, sizeof(ReadFile));
+	if (WriteFiles("AsyncReadSmall", smallCount, smallSize, pSmallFiles) && WriteFiles("AsyncReadLarge", largeCount, largeSize, pLargeFiles))
+	{
+		printf("queue depth %u, %s cache\n", depth, cold ? "cold" : "warm");
+		RunWorkload("small", pSmallFiles, smallCount, smallSize, depth, cold);
+		RunWorkload("large", pLargeFiles, largeCount, chunkSize, depth, cold);
+	}
+	else
+	{
+		TEST_CHECK(!"Failed to write the input files");
+	}
+
+	tf_free(pSmallFiles);
+	tf_free(pLargeFiles);
+	return ExitTestEnvironment();
+}
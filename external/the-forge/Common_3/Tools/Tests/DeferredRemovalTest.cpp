@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Resizes every frame the way the demo's recreateSwapchainResources does, through the deferred removal queue of the
+// resource loader with stand-in swap chains, depth buffers and buffers, for 1 to --frames-in-flight frame slots:
+// - a frame only completes once the CPU waits for the fence of its slot, the latest the GPU is allowed to finish
+// - no object is destroyed before the last frame using it is complete, or later than the first beginResourceFrame
+//   after that, and none is destroyed twice
+// - buffers are also removed from worker threads while the main thread begins frames, like streamed out resources
+// - the number of pending removals stays at what the frames in flight hold, and nothing is left once the queue is
+//   flushed at exit
+//
+// Options: --frames <frames per run> --frames-in-flight <most frame slots> --threads <threads removing buffers>
+
+#include "../../OS/Core/Atomics.h"
+#include "../../OS/Interfaces/IThread.h"
+#include "../../Renderer/DeferredRemovals.h"
+
+#include "TestCommon.h"
+
+static const uint32_t LIVE_OBJECT = 0x4C495645;
+static const uint32_t DESTROYED_OBJECT = 0xDEADDEAD;
+
+struct TestObject
+{
+	uint32_t mState;
+	uint64_t mLastUseFrame;
+};
+
+struct TestContext
+{
+	uint32_t         mFramesInFlight;
+	// Last frame whose fence the CPU waited for, and the frame being recorded
+	uint64_t         mCompletedFrame;
+	uint64_t         mFrame;
+	tfrg_atomic32_t  mLiveObjects;
+	tfrg_atomic32_t  mEarlyRemovals;
+	tfrg_atomic32_t  mLateRemovals;
+	tfrg_atomic32_t  mDoubleRemovals;
+	bool             mFlushing;
+	// Objects are only freed at the end, so a second removal still finds the first one's mark
+	eastl::vector<TestObject*> mObjects;
+
+	DeferredRemovalQueue mRemovals;
+
+	// Buffers handed to the worker threads, which queue their removal
+	Mutex                     mHandoffMutex;
+	ConditionVariable         mHandoffCond;
+	ConditionVariable         mDrainedCond;
+	eastl::vector<TestObject*> mHandoff;
+	uint32_t                  mOutstanding;
+	bool                      mRun;
+};
+
+static TestObject* AddObject(TestContext* pContext)
+{
+	TestObject* pObject = (TestObject*)tf_malloc(sizeof(TestObject));
+	pObject->mState = LIVE_OBJECT;
+	pObject->mLastUseFrame = pContext->mFrame;
+	tfrg_atomic32_add_relaxed(&pContext->mLiveObjects, 1);
+	pContext->mObjects.push_back(pObject);
+	return pObject;
+}
+
+static void RemoveObject(TestContext* pContext, TestObject* pObject)
+{
+	if (pObject->mState != LIVE_OBJECT)
+	{
+		tfrg_atomic32_add_relaxed(&pContext->mDoubleRemovals, 1);
+		return;
+	}
+	pObject->mState = DESTROYED_OBJECT;
+	tfrg_atomic32_add_relaxed(&pContext->mLiveObjects, -1);
+}
+
+static void DestroyRemoval(void* pUserData, const DeferredRemoval& removal)
+{
+	TestContext* pContext = (TestContext*)pUserData;
+	TestObject*  pObject = (TestObject*)removal.pObject;
+	if (pObject->mState == LIVE_OBJECT)
+	{
+		if (pObject->mLastUseFrame > pContext->mCompletedFrame)
+			tfrg_atomic32_add_relaxed(&pContext->mEarlyRemovals, 1);
+		// The first frame allowed to destroy it is the one reusing the slot of its last frame
+		if (!pContext->mFlushing && pContext->mFrame > pObject->mLastUseFrame + pContext->mFramesInFlight)
+			tfrg_atomic32_add_relaxed(&pContext->mLateRemovals, 1);
+	}
+	RemoveObject(pContext, pObject);
+}
+
+static void RemoveBuffersThread(void* pData)
+{
+	TestContext* pContext = (TestContext*)pData;
+	MutexLock    lock(pContext->mHandoffMutex);
+	while (true)
+	{
+		while (pContext->mRun && pContext->mHandoff.empty())
+			pContext->mHandoffCond.Wait(pContext->mHandoffMutex);
+		if (pContext->mHandoff.empty())
+			break;
+
+		TestObject* pBuffer = pContext->mHandoff.back();
+		pContext->mHandoff.pop_back();
+		pContext->mHandoffMutex.Release();
+		pContext->mRemovals.queue(DEFERRED_REMOVAL_BUFFER, pBuffer);
+		pContext->mHandoffMutex.Acquire();
+
+		if (--pContext->mOutstanding == 0)
+			pContext->mDrainedCond.WakeAll();
+	}
+}
+
+static void RunFrames(uint32_t framesInFlight, uint32_t frameCount, uint32_t threadCount)
+{
+	TestContext context = {};
+	context.mFramesInFlight = framesInFlight;
+	context.mRemovals.init(DestroyRemoval, &context);
+	context.mHandoffMutex.Init();
+	context.mHandoffCond.Init();
+	context.mDrainedCond.Init();
+	context.mRun = true;
+
+	ThreadHandle* pThreads = (ThreadHandle*)tf_calloc(threadCount ? threadCount : 1, sizeof(ThreadHandle));
+	for (uint32_t i = 0; i < threadCount; ++i)
+	{
+		ThreadDesc threadDesc = {};
+		threadDesc.pFunc = RemoveBuffersThread;
+		threadDesc.pData = &context;
+		pThreads[i] = create_thread(&threadDesc);
+	}
+
+	// Frame each slot's fence was last signaled by
+	uint64_t*   pSlotFrames = (uint64_t*)tf_calloc(framesInFlight, sizeof(uint64_t));
+	TestObject* pSwapChain = AddObject(&context);
+	TestObject* pDepthBuffer = AddObject(&context);
+	// Loading resizes once before the first frame
+	context.mRemovals.queue(DEFERRED_REMOVAL_SWAP_CHAIN, pSwapChain);
+	context.mRemovals.queue(DEFERRED_REMOVAL_RENDER_TARGET, pDepthBuffer);
+	pSwapChain = AddObject(&context);
+	pDepthBuffer = AddObject(&context);
+	// Removals each frame: the swap chain, the depth buffer and one buffer per thread
+	const uint32_t removalsPerFrame = 2 + threadCount;
+	uint32_t       unexpectedPending = 0;
+
+	for (uint32_t f = 0; f < frameCount; ++f)
+	{
+		// Wait for the fence of the slot about to be recorded, then begin the frame like the demo
+		const uint32_t slot = f % framesInFlight;
+		context.mCompletedFrame = eastl::max(context.mCompletedFrame, pSlotFrames[slot]);
+		context.mFrame = f + 1;
+		context.mRemovals.beginFrame(framesInFlight);
+
+		// Removals of the last framesInFlight - 1 frames are still waiting for their fences
+		uint32_t expectedPending = (uint32_t)eastl::min<uint64_t>(context.mFrame - 1, framesInFlight - 1) * removalsPerFrame;
+		expectedPending += context.mFrame < framesInFlight ? 2 : 0;
+		unexpectedPending += context.mRemovals.getPendingCount() != expectedPending ? 1 : 0;
+
+		// Record and submit
+		pSwapChain->mLastUseFrame = context.mFrame;
+		pDepthBuffer->mLastUseFrame = context.mFrame;
+		pSlotFrames[slot] = context.mFrame;
+
+		// Streamed out buffers used by this frame go to the worker threads
+		{
+			MutexLock lock(context.mHandoffMutex);
+			for (uint32_t i = 0; i < threadCount; ++i)
+				context.mHandoff.push_back(AddObject(&context));
+			context.mOutstanding += threadCount;
+		}
+		context.mHandoffCond.WakeAll();
+
+		// Resize after present, the old swap chain and depth buffer were used by this frame
+		context.mRemovals.queue(DEFERRED_REMOVAL_SWAP_CHAIN, pSwapChain);
+		context.mRemovals.queue(DEFERRED_REMOVAL_RENDER_TARGET, pDepthBuffer);
+		pSwapChain = AddObject(&context);
+		pDepthBuffer = AddObject(&context);
+
+		// The workers finish within the frame, so every removal of a frame carries its stamp
+		MutexLock lock(context.mHandoffMutex);
+		while (context.mOutstanding)
+			context.mDrainedCond.Wait(context.mHandoffMutex);
+	}
+
+	{
+		MutexLock lock(context.mHandoffMutex);
+		context.mRun = false;
+	}
+	context.mHandoffCond.WakeAll();
+	for (uint32_t i = 0; i < threadCount; ++i)
+		destroy_thread(pThreads[i]);
+
+	TEST_CHECK(unexpectedPending == 0);
+	TEST_CHECK(tfrg_atomic32_load_relaxed(&context.mEarlyRemovals) == 0);
+	TEST_CHECK(tfrg_atomic32_load_relaxed(&context.mLateRemovals) == 0);
+	TEST_CHECK(tfrg_atomic32_load_relaxed(&context.mDoubleRemovals) == 0);
+	// The swap chain and depth buffer in use, and what the frames in flight still hold
+	const uint32_t pending = context.mRemovals.getPendingCount();
+	TEST_CHECK((uint32_t)tfrg_atomic32_load_relaxed(&context.mLiveObjects) == 2 + pending);
+
+	// Exit idles the queue first
+	context.mCompletedFrame = context.mFrame;
+	context.mFlushing = true;
+	context.mRemovals.exit();
+	RemoveObject(&context, pDepthBuffer);
+	RemoveObject(&context, pSwapChain);
+	TEST_CHECK(tfrg_atomic32_load_relaxed(&context.mLiveObjects) == 0);
+	TEST_CHECK(tfrg_atomic32_load_relaxed(&context.mDoubleRemovals) == 0);
+
+	printf(
+		"  %16u %8u %8u %12u %8u %8u\n", framesInFlight, frameCount, frameCount * removalsPerFrame + 2, pending,
+		tfrg_atomic32_load_relaxed(&context.mEarlyRemovals), tfrg_atomic32_load_relaxed(&context.mLiveObjects));
+
+	for (TestObject* pObject : context.mObjects)
+		tf_free(pObject);
+	tf_free(pSlotFrames);
+	tf_free(pThreads);
+	context.mDrainedCond.Destroy();
+	context.mHandoffCond.Destroy();
+	context.mHandoffMutex.Destroy();
+}
+
+int main(int argc, char** argv)
+{
+	const uint32_t frameCount = GetTestArg(argc, argv, "--frames", 1000);
+	const uint32_t maxFramesInFlight = GetTestArg(argc, argv, "--frames-in-flight", 3);
+	const uint32_t threadCount = GetTestArg(argc, argv, "--threads", 2);
+	if (!frameCount || !maxFramesInFlight)
+	{
+		printf("--frames and --frames-in-flight must be greater than zero\n");
+		return EXIT_FAILURE;
+	}
+
+	if (!InitTestEnvironment("DeferredRemovalTest"))
+		return EXIT_FAILURE;
+
+	printf("Resizing every frame, %u threads removing buffers:\n", threadCount);
+	printf("  %16s %8s %8s %12s %8s %8s\n", "frames in flight", "frames", "removals", "pending end", "early", "leaked");
+	for (uint32_t framesInFlight = 1; framesInFlight <= maxFramesInFlight; ++framesInFlight)
+		RunFrames(framesInFlight, frameCount, threadCount);
+
+	return ExitTestEnvironment();
+}
@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Measures the descriptor updates per second of the updateDescriptorSet resolve loop when DescriptorData names its
+// descriptors and when it carries indices resolved once with getDescriptorIndexFromName:
+// - the name lookup mirrors the backends, a find in the root signature's string_hash_map, the index path reads the
+//   descriptor array directly. The update data written per array element stands in for the VkDescriptorImageInfo writes.
+//   cmdBindPushConstants does the same name lookup on every draw
+// - every name resolves to its own index, unknown names resolve to UINT32_MAX, and both paths write the same update data
+//
+// Options: --descriptors <per root signature> --updates <DescriptorData per updateDescriptorSet call> --calls <per pass> --passes <count>
+
+#include "../../Renderer/IRenderer.h"
+#include "../../ThirdParty/OpenSource/EASTL/string.h"
+#include "../../ThirdParty/OpenSource/EASTL/string_hash_map.h"
+#include "../../ThirdParty/OpenSource/EASTL/vector.h"
+
+#include "TestCommon.h"
+
+// Stand-in for the backend DescriptorInfo, only the fields an update reads
+struct TestDescriptorInfo
+{
+	const char* pName;
+	uint32_t    mSize;
+	uint32_t    mHandleIndex;
+};
+
+// Stand-in for the backend DescriptorUpdateData
+struct TestUpdateData
+{
+	const void* pView;
+	uint32_t    mLayout;
+};
+
+struct TestRootSignature
+{
+	eastl::vector<eastl::string>     mNames;
+	eastl::vector<TestDescriptorInfo> mDescriptors;
+	eastl::string_hash_map<uint32_t> mNameToIndex;
+	uint32_t                          mHandleCount;
+};
+
+// Same as get_descriptor on the backends, minus the error log
+static const TestDescriptorInfo* GetDescriptor(const TestRootSignature* pRootSignature, const char* pName)
+{
+	eastl::string_hash_map<uint32_t>::const_iterator it = pRootSignature->mNameToIndex.find(pName);
+	return it != pRootSignature->mNameToIndex.end() ? &pRootSignature->mDescriptors[it->second] : NULL;
+}
+
+static uint32_t GetDescriptorIndexFromName(const TestRootSignature* pRootSignature, const char* pName)
+{
+	eastl::string_hash_map<uint32_t>::const_iterator it = pRootSignature->mNameToIndex.find(pName);
+	return it != pRootSignature->mNameToIndex.end() ? it->second : UINT32_MAX;
+}
+
+// The resolve and write loop of updateDescriptorSet
+static void UpdateDescriptorSet(const TestRootSignature* pRootSignature, TestUpdateData* pUpdateData, uint32_t count, const DescriptorData* pParams)
+{
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const DescriptorData*     pParam = pParams + i;
+		const uint32_t            paramIndex = pParam->mIndex;
+		const TestDescriptorInfo* pDesc =
+			(paramIndex != UINT32_MAX) ? &pRootSignature->mDescriptors[paramIndex] : GetDescriptor(pRootSignature, pParam->pName);
+		const uint32_t arrayCount = pParam->mCount ? pParam->mCount : 1;
+		for (uint32_t arr = 0; arr < arrayCount; ++arr)
+			pUpdateData[pDesc->mHandleIndex + arr] = { pParam->ppTextures[arr], pDesc->mSize };
+	}
+}
+
+// Shader resource names are usually a few words long and share prefixes, which is what the hash has to chew through
+static void AddRootSignature(TestRootSignature* pRootSignature, uint32_t descriptorCount)
+{
+	static const char* pPrefixes[] = { "uniformBlock", "diffuseMap", "normalMap", "shadowCascade", "lightClusterBuffer", "materialParams" };
+	const uint32_t     prefixCount = sizeof(pPrefixes) / sizeof(pPrefixes[0]);
+
+	pRootSignature->mNames.resize(descriptorCount);
+	pRootSignature->mDescriptors.resize(descriptorCount);
+	pRootSignature->mHandleCount = 0;
+	for (uint32_t i = 0; i < descriptorCount; ++i)
+	{
+		pRootSignature->mNames[i].sprintf("%s_%u_rootcbv", pPrefixes[i % prefixCount], i / prefixCount);
+		pRootSignature->mNameToIndex.insert(pRootSignature->mNames[i].c_str()).first->second = i;
+		pRootSignature->mDescriptors[i] = { pRootSignature->mNames[i].c_str(), 64 + i, pRootSignature->mHandleCount };
+		// Every fourth descriptor is an array of two
+		pRootSignature->mHandleCount += (i % 4 == 3) ? 2 : 1;
+	}
+}
+
+static void FillParams(const TestRootSignature* pRootSignature, DescriptorData* pParams, uint32_t updateCount, void** ppResources, bool byIndex)
+{
+	const uint32_t descriptorCount = (uint32_t)pRootSignature->mDescriptors.size();
+	for (uint32_t i = 0; i < updateCount; ++i)
+	{
+		// Spread the updates over the root signature so a small table can't stay in one cache line
+		const uint32_t descriptor = (i * 7) % descriptorCount;
+		pParams[i] = {};
+		pParams[i].pName = byIndex ? NULL : pRootSignature->mNames[descriptor].c_str();
+		pParams[i].mIndex = byIndex ? GetDescriptorIndexFromName(pRootSignature, pRootSignature->mNames[descriptor].c_str()) : UINT32_MAX;
+		pParams[i].mCount = (descriptor % 4 == 3) ? 2 : 1;
+		pParams[i].ppTextures = (Texture**)(ppResources + (i % 8));
+	}
+}
+
+static void TestLookups(const TestRootSignature* pRootSignature, uint32_t updateCount, void** ppResources)
+{
+	const uint32_t descriptorCount = (uint32_t)pRootSignature->mDescriptors.size();
+	for (uint32_t i = 0; i < descriptorCount; ++i)
+		TEST_CHECK(GetDescriptorIndexFromName(pRootSignature, pRootSignature->mNames[i].c_str()) == i);
+	TEST_CHECK(GetDescriptorIndexFromName(pRootSignature, "UniformBlockRootConstant") == UINT32_MAX);
+	TEST_CHECK(GetDescriptorIndexFromName(pRootSignature, "") == UINT32_MAX);
+
+	DescriptorData* pByName = (DescriptorData*)tf_calloc(updateCount, sizeof(DescriptorData));
+	DescriptorData* pByIndex = (DescriptorData*)tf_calloc(updateCount, sizeof(DescriptorData));
+	TestUpdateData* pNameData = (TestUpdateData*)tf_calloc(pRootSignature->mHandleCount, sizeof(TestUpdateData));
+	TestUpdateData* pIndexData = (TestUpdateData*)tf_calloc(pRootSignature->mHandleCount, sizeof(TestUpdateData));
+	FillParams(pRootSignature, pByName, updateCount, ppResources, false);
+	FillParams(pRootSignature, pByIndex, updateCount, ppResources, true);
+	UpdateDescriptorSet(pRootSignature, pNameData, updateCount, pByName);
+	UpdateDescriptorSet(pRootSignature, pIndexData, updateCount, pByIndex);
+	for (uint32_t i = 0; i < pRootSignature->mHandleCount; ++i)
+		TEST_CHECK(pNameData[i].pView == pIndexData[i].pView && pNameData[i].mLayout == pIndexData[i].mLayout);
+	tf_free(pIndexData);
+	tf_free(pNameData);
+	tf_free(pByIndex);
+	tf_free(pByName);
+}
+
+// Returns descriptor updates per second
+static double RunBenchmark(const TestRootSignature* pRootSignature, uint32_t updateCount, uint32_t callCount, void** ppResources, bool byIndex)
+{
+	DescriptorData* pParams = (DescriptorData*)tf_calloc(updateCount, sizeof(DescriptorData));
+	TestUpdateData* pUpdateData = (TestUpdateData*)tf_calloc(pRootSignature->mHandleCount, sizeof(TestUpdateData));
+	FillParams(pRootSignature, pParams, updateCount, ppResources, byIndex);
+
+	const int64_t start = getNSec();
+	for (uint32_t call = 0; call < callCount; ++call)
+		UpdateDescriptorSet(pRootSignature, pUpdateData, updateCount, pParams);
+	const int64_t ns = getNSec() - start;
+
+	uint64_t checksum = 0;
+	for (uint32_t i = 0; i < pRootSignature->mHandleCount; ++i)
+		checksum += (uint64_t)(uintptr_t)pUpdateData[i].pView + pUpdateData[i].mLayout;
+	TEST_CHECK(checksum != 0);
+
+	tf_free(pUpdateData);
+	tf_free(pParams);
+	return (double)updateCount * callCount * 1e9 / (double)(ns ? ns : 1);
+}
+
+int main(int argc, char** argv)
+{
+	const uint32_t descriptorCount = GetTestArg(argc, argv, "--descriptors", 32);
+	const uint32_t updateCount = GetTestArg(argc, argv, "--updates", 16);
+	const uint32_t callCount = GetTestArg(argc, argv, "--calls", 100000);
+	const uint32_t passCount = GetTestArg(argc, argv, "--passes", 3);
+	if (!descriptorCount || !updateCount || !callCount || !passCount)
+	{
+		printf("--descriptors, --updates, --calls and --passes must be greater than zero\n");
+		return EXIT_FAILURE;
+	}
+
+	if (!InitTestEnvironment("DescriptorUpdateBenchmark"))
+		return EXIT_FAILURE;
+
+	{
+		TestRootSignature rootSignature;
+		AddRootSignature(&rootSignature, descriptorCount);
+
+		// Fake texture pointers, only compared and summed
+		void* pResources[9];
+		for (uint32_t i = 0; i < 9; ++i)
+			pResources[i] = (void*)(uintptr_t)(0x1000 * (i + 1));
+
+		TestLookups(&rootSignature, updateCount, pResources);
+
+		printf("Descriptor updates per second, %u descriptors in the root signature, %u updates per call:\n", descriptorCount, updateCount);
+		printf("  %4s %14s %14s %8s\n", "pass", "by name", "by index", "speedup");
+		for (uint32_t pass = 0; pass < passCount; ++pass)
+		{
+			const double byName = RunBenchmark(&rootSignature, updateCount, callCount, pResources, false);
+			const double byIndex = RunBenchmark(&rootSignature, updateCount, callCount, pResources, true);
+			printf("  %4u %14.0f %14.0f %7.1fx\n", pass, byName, byIndex, byIndex / byName);
+		}
+	}
+
+	return ExitTestEnvironment();
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Checks the stream buffer accessor of the file system:
+// - FM_READ_BINARY files are mapped, the buffer holds the file and reads, seeks and the end flag still work
+// - text mode files go through stdio and have no buffer
+// - empty files cannot be mapped and fall back to stdio
+// - memory streams expose their own buffer
+//
+// Options: --size <bytes>
+
+#include "../../OS/Interfaces/IFileSystem.h"
+
+#include "TestCommon.h"
+
+static const ResourceDirectory TEST_DIR = RD_OTHER_FILES;
+
+static void FillData(uint8_t* pData, uint32_t size)
+{
+	uint32_t state = 0x12345678u;
+	for (uint32_t i = 0; i < size; ++i)
+	{
+		state = state * 1664525u + 1013904223u;
+		pData[i] = (uint8_t)(state >> 24);
+	}
+}
+
+static bool WriteFile(const char* pFileName, const void* pData, size_t size)
+{
+	FileStream stream = {};
+	if (!fsOpenStreamFromPath(TEST_DIR, pFileName, FM_WRITE_BINARY, &stream))
+		return false;
+	bool success = fsWriteToStream(&stream, pData, size) == size;
+	fsCloseStream(&stream);
+	return success;
+}
+
+static void TestMappedFile(const uint8_t* pData, uint32_t size)
+{
+	FileStream stream = {};
+	TEST_CHECK(fsOpenStreamFromPath(TEST_DIR, "FileStreamTest.bin", FM_READ_BINARY, &stream));
+
+	const uint8_t* pBuffer = (const uint8_t*)fsGetStreamBufferIfPresent(&stream);
+	TEST_CHECK(pBuffer != NULL);
+	TEST_CHECK(fsGetStreamFileSize(&stream) == (ssize_t)size);
+	if (pBuffer)
+		TEST_CHECK(memcmp(pBuffer, pData, size) == 0);
+
+	// Reads copy out of the mapping and advance the position
+	uint8_t chunk[4096];
+	uint32_t offset = size / 3;
+	TEST_CHECK(fsSeekStream(&stream, SBO_START_OF_FILE, offset));
+	TEST_CHECK(fsReadFromStream(&stream, chunk, sizeof(chunk)) == sizeof(chunk));
+	TEST_CHECK(memcmp(chunk, pData + offset, sizeof(chunk)) == 0);
+	TEST_CHECK(fsGetStreamSeekPosition(&stream) == (ssize_t)(offset + sizeof(chunk)));
+
+	// Reads are clamped at the end of the file
+	TEST_CHECK(fsSeekStream(&stream, SBO_END_OF_FILE, -100));
+	TEST_CHECK(fsReadFromStream(&stream, chunk, sizeof(chunk)) == 100);
+	TEST_CHECK(memcmp(chunk, pData + size - 100, 100) == 0);
+	TEST_CHECK(fsStreamAtEnd(&stream));
+	TEST_CHECK(fsCloseStream(&stream));
+}
+
+static void TestTextFile(const uint8_t* pData, uint32_t size)
+{
+	FileStream stream = {};
+	TEST_CHECK(fsOpenStreamFromPath(TEST_DIR, "FileStreamTest.bin", FM_READ, &stream));
+	TEST_CHECK(fsGetStreamBufferIfPresent(&stream) == NULL);
+
+	uint8_t* pRead = (uint8_t*)tf_malloc(size);
+	TEST_CHECK(fsReadFromStream(&stream, pRead, size) == size);
+	TEST_CHECK(memcmp(pRead, pData, size) == 0);
+	tf_free(pRead);
+	TEST_CHECK(fsCloseStream(&stream));
+}
+
+static void TestEmptyFile()
+{
+	TEST_CHECK(WriteFile("FileStreamTestEmpty.bin", NULL, 0));
+
+	FileStream stream = {};
+	TEST_CHECK(fsOpenStreamFromPath(TEST_DIR, "FileStreamTestEmpty.bin", FM_READ_BINARY, &stream));
+	TEST_CHECK(fsGetStreamBufferIfPresent(&stream) == NULL);
+	TEST_CHECK(fsGetStreamFileSize(&stream) == 0);
+
+	uint8_t byte = 0;
+	TEST_CHECK(fsReadFromStream(&stream, &byte, 1) == 0);
+	TEST_CHECK(fsCloseStream(&stream));
+}
+
+static void TestMemoryStream(const uint8_t* pData, uint32_t size)
+{
+	FileStream stream = {};
+	TEST_CHECK(fsOpenStreamFromMemory(pData, size, FM_READ_BINARY, false, &stream));
+	TEST_CHECK(fsGetStreamBufferIfPresent(&stream) == pData);
+	TEST_CHECK(fsGetStreamFileSize(&stream) == (ssize_t)size);
+	TEST_CHECK(fsCloseStream(&stream));
+}
+
+int main(int argc, char** argv)
+{
+	if (!InitTestEnvironment("FileStreamTest"))
+		return EXIT_FAILURE;
+
+	uint32_t size = max(GetTestArg(argc, argv, "--size", 4 << 20), 8192u);
+	fsSetPathForResourceDir(pSystemFileIO, RM_DEBUG, TEST_DIR, "");
+
+	uint8_t* pData = (uint8_t*)tf_malloc(size);
+	FillData(pData, size);
+	TEST_CHECK(WriteFile("FileStreamTest.bin", pData, size));
+
+	TestMappedFile(pData, size);
+	TestTextFile(pData, size);
+	TestEmptyFile();
+	TestMemoryStream(pData, size);
+
+	tf_free(pData);
+	return ExitTestEnvironment();
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Synchronous against asynchronous logging with several threads logging at once. Measured per mode:
+// - messages/s over all threads, async mode counts the messages it dropped on full rings as well
+// - latency of a single LOGF call on the logging thread, p50/p99/max
+// Every message passes a format which the caller overwrites right after the call, like the c_str() of a temporary
+// eastl::string, so a deferred format that is not copied shows up as a corrupted message. A log callback checks each
+// message and counts the drops reported in async mode, every message has to be either valid or dropped.
+//
+// Options: --threads <n> --messages <n per thread>
+
+#include "../../OS/Interfaces/IThread.h"
+#include "../../OS/Core/Atomics.h"
+#include "../../OS/Core/ThreadSystem.h"
+#include "../../OS/Logging/Log.h"
+
+#include "../../ThirdParty/OpenSource/EASTL/sort.h"
+#include "../../ThirdParty/OpenSource/EASTL/vector.h"
+
+#include "TestCommon.h"
+
+struct LogBenchmark
+{
+	uint32_t         mMessageCount;
+	int64_t**        ppLatencies;
+	tfrg_atomic32_t  mValid;
+	tfrg_atomic32_t  mInvalid;
+	tfrg_atomic32_t  mDropped;
+};
+
+// Log callbacks cannot be removed, so there is one for all runs
+static LogBenchmark gBenchmark = {};
+
+static const char* GetMessageString(uint32_t index)
+{
+	static const char* pStrings[] = { "texture", "buffer", "pipeline", "swapchain" };
+	return pStrings[index % 4];
+}
+
+static void CheckMessage(void*, const char* pMessage)
+{
+	LogBenchmark* pBenchmark = &gBenchmark;
+
+	const char* pDropped = strstr(pMessage, "Dropped ");
+	if (pDropped)
+	{
+		tfrg_atomic32_add_relaxed(&pBenchmark->mDropped, (int32_t)strtoul(pDropped + 8, NULL, 10));
+		return;
+	}
+
+	const char* pBody = strstr(pMessage, "LogBenchmark t");
+	if (!pBody)
+		return;
+
+	unsigned thread = 0, index = 0;
+	char     str[32] = {};
+	double   value = 0.0;
+	bool     valid = sscanf(pBody, "LogBenchmark t%u m%u %31s %lf", &thread, &index, str, &value) == 4 &&
+				 !strcmp(str, GetMessageString(index)) && fabs(value - index * 0.5) < 1e-6;
+	tfrg_atomic32_add_relaxed(valid ? &pBenchmark->mValid : &pBenchmark->mInvalid, 1);
+}
+
+static void LogMessages(void*, uintptr_t thread)
+{
+	LogBenchmark* pBenchmark = &gBenchmark;
+	int64_t*      pLatencies = pBenchmark->ppLatencies[thread];
+	char          format[64];
+	for (uint32_t i = 0; i < pBenchmark->mMessageCount; ++i)
+	{
+		snprintf(format, sizeof(format), "LogBenchmark t%u m%%u %%s %%.3f", (uint32_t)thread);
+		int64_t start = getNSec();
+		LOGF(LogLevel::eINFO, format, i, GetMessageString(i), i * 0.5);
+		pLatencies[i] = getNSec() - start;
+		// The format is gone once LOGF returns
+		memset(format, 'X', sizeof(format) - 1);
+	}
+}
+
+static void RunMode(const char* pLabel, bool async, uint32_t threadCount, uint32_t messageCount)
+{
+	LogBenchmark& benchmark = gBenchmark;
+	benchmark = {};
+	benchmark.mMessageCount = messageCount;
+	benchmark.ppLatencies = (int64_t**)tf_malloc(threadCount * sizeof(int64_t*));
+	for (uint32_t i = 0; i < threadCount; ++i)
+		benchmark.ppLatencies[i] = (int64_t*)tf_malloc(messageCount * sizeof(int64_t));
+
+	Log::SetAsync(async);
+
+	ThreadSystem* pThreadSystem = NULL;
+	initThreadSystem(&pThreadSystem, threadCount);
+	int64_t start = getNSec();
+	addThreadSystemRangeTask(pThreadSystem, LogMessages, NULL, threadCount);
+	waitThreadSystemIdle(pThreadSystem);
+	int64_t time = getNSec() - start;
+	shutdownThreadSystem(pThreadSystem);
+
+	// Also waits for the log thread to write everything out
+	Log::SetAsync(false);
+
+	eastl::vector<int64_t> latencies;
+	latencies.reserve(threadCount * messageCount);
+	for (uint32_t i = 0; i < threadCount; ++i)
+	{
+		latencies.insert(latencies.end(), benchmark.ppLatencies[i], benchmark.ppLatencies[i] + messageCount);
+		tf_free(benchmark.ppLatencies[i]);
+	}
+	tf_free(benchmark.ppLatencies);
+	eastl::sort(latencies.begin(), latencies.end());
+
+	const uint32_t total = threadCount * messageCount;
+	printf("%-5s %10.0f messages/s   call p50 %7.0f ns  p99 %8.0f ns  max %9.0f ns   dropped %u\n", pLabel, total / (time / 1e9),
+		(double)GetPercentile(latencies.data(), latencies.size(), 50.0), (double)GetPercentile(latencies.data(), latencies.size(), 99.0),
+		(double)latencies.back(), (uint32_t)benchmark.mDropped);
+	TEST_CHECK(benchmark.mInvalid == 0);
+	TEST_CHECK(benchmark.mValid + benchmark.mDropped == total);
+	TEST_CHECK(async || benchmark.mDropped == 0);
+}
+
+int main(int argc, char** argv)
+{
+	if (!InitTestEnvironment("LogBenchmark"))
+		return EXIT_FAILURE;
+
+	uint32_t threadCount = max(GetTestArg(argc, argv, "--threads", 4), 1u);
+	uint32_t messageCount = max(GetTestArg(argc, argv, "--messages", 100000), 1u);
+	Log::SetConsoleLogging(false);
+	Log::AddCallback("LogBenchmark", LogLevel::eALL, NULL, CheckMessage);
+
+	printf("%u threads, %u messages each\n", threadCount, messageCount);
+	RunMode("sync", false, threadCount, messageCount);
+	RunMode("async", true, threadCount, messageCount);
+
+	return ExitTestEnvironment();
+}
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Checks the async script execution of the Lua manager:
+// - hundreds of CPU-bound scripts submitted from a simulated main loop all finish with FINISHED_OK, callbacks run on the
+//   thread they were requested on, and a full queue rejects submissions without calling the callback
+// - the main loop stays responsive while the workers run, its frame times are reported
+// - the async run is compared with running the same scripts one after another on the main thread, which shows the
+//   scaling across cores
+// - canceled scripts, queued or running, report CANCELED, and scripts with errors report FINISHED_ERROR
+//
+// Options: --scripts <count> --loop <iterations per script> --frame-budget <max main loop frame in ms>
+//          --check-scaling (fail unless the async run is at least half the core count faster than the serial one)
+
+#include "../../OS/Interfaces/IFileSystem.h"
+#include "../../OS/Interfaces/IThread.h"
+#include "../../OS/Core/Atomics.h"
+#include "../../OS/Core/ThreadSystem.h"
+#include "../../ThirdParty/OpenSource/EASTL/sort.h"
+#include "../../../Middleware_3/LUA/LuaManager.h"
+
+#include "TestCommon.h"
+
+static bool WriteScript(const char* pFileName, const char* pSource)
+{
+	FileStream stream = {};
+	if (!fsOpenStreamFromPath(RD_SCRIPTS, pFileName, FM_WRITE_BINARY, &stream))
+		return false;
+	size_t size = strlen(pSource);
+	bool success = fsWriteToStream(&stream, pSource, size) == size;
+	fsCloseStream(&stream);
+	return success;
+}
+
+struct AsyncResults
+{
+	tfrg_atomic32_t mFinished;
+	tfrg_atomic32_t mStates[CANCELED + 1];
+	tfrg_atomic32_t mWrongThread;
+};
+
+static void TestAsyncScripts(LuaManager& lua, uint32_t scriptCount, double frameBudgetMs, bool checkScaling)
+{
+	// Serial reference on the main thread
+	const uint32_t serialCount = scriptCount < 32 ? scriptCount : 32;
+	int64_t start = getNSec();
+	bool serialOk = true;
+	for (uint32_t i = 0; i < serialCount; ++i)
+		serialOk &= lua.RunScript("LuaAsyncWork.lua");
+	const double serialMsPerScript = NsToMs(getNSec() - start) / serialCount;
+	TEST_CHECK(serialOk);
+
+	AsyncResults results = {};
+	const ThreadID mainThread = Thread::GetCurrentThreadID();
+	uint32_t submitted = 0;
+	uint32_t rejected = 0;
+	uint32_t frameCount = 0;
+	double maxFrameMs = 0.0;
+	eastl::vector<double> frameTimes;
+
+	// Every frame submits a batch and dispatches the finished callbacks, like a game loop would
+	start = getNSec();
+	int64_t frameStart = start;
+	while (tfrg_atomic32_load_relaxed(&results.mFinished) < scriptCount)
+	{
+		for (uint32_t i = 0; i < 32 && submitted < scriptCount; ++i)
+		{
+			const bool onWorker = submitted % 4 == 3;
+			ScriptHandle handle = lua.AddAsyncScript(
+				"LuaAsyncWork.lua",
+				[&results, mainThread, onWorker](ScriptState state) {
+					if (onWorker == (Thread::GetCurrentThreadID() == mainThread))
+						tfrg_atomic32_add_relaxed(&results.mWrongThread, 1);
+					tfrg_atomic32_add_relaxed(&results.mStates[state], 1);
+					tfrg_atomic32_add_relaxed(&results.mFinished, 1);
+				},
+				onWorker ? SCRIPT_CALLBACK_THREAD_WORKER : SCRIPT_CALLBACK_THREAD_DISPATCH);
+			if (handle == INVALID_SCRIPT_HANDLE)
+			{
+				++rejected;
+				break;
+			}
+			++submitted;
+		}
+		lua.DispatchAsyncScriptCallbacks();
+		Thread::Sleep(1);
+
+		const int64_t now = getNSec();
+		frameTimes.push_back(NsToMs(now - frameStart));
+		maxFrameMs = frameTimes.back() > maxFrameMs ? frameTimes.back() : maxFrameMs;
+		frameStart = now;
+		++frameCount;
+	}
+	const double asyncMsPerScript = NsToMs(getNSec() - start) / scriptCount;
+
+	TEST_CHECK(tfrg_atomic32_load_relaxed(&results.mStates[FINISHED_OK]) == scriptCount);
+	TEST_CHECK(tfrg_atomic32_load_relaxed(&results.mWrongThread) == 0);
+	// The queue holds MAX_LUA_ASYNC_SCRIPTS, more than that can only be submitted once earlier scripts finished
+	TEST_CHECK(scriptCount <= MAX_LUA_ASYNC_SCRIPTS || rejected > 0);
+
+	eastl::sort(frameTimes.begin(), frameTimes.end());
+	const double p99FrameMs = GetPercentile(frameTimes.data(), frameTimes.size(), 99.0);
+	TEST_CHECK(p99FrameMs <= frameBudgetMs);
+
+	// Off by default, on machines with few cores or busy CI runners the scheduling noise outweighs the work
+	const uint32_t coreCount = Thread::GetNumCPUCores();
+	const double scaling = serialMsPerScript / asyncMsPerScript;
+	if (checkScaling)
+		TEST_CHECK(scaling >= 0.5 * (coreCount < MAX_LOAD_THREADS ? coreCount : MAX_LOAD_THREADS));
+
+	printf("%u scripts, %u rejected submissions while the queue was full\n", scriptCount, rejected);
+	printf("  serial on the main thread: %.3f ms/script\n", serialMsPerScript);
+	printf("  async: %.3f ms/script, %.2fx the serial rate with %u cores\n", asyncMsPerScript, scaling, coreCount);
+	printf("  main loop: %u frames, p99 %.2f ms, max %.2f ms (budget %.1f ms)\n", frameCount, p99FrameMs, maxFrameMs, frameBudgetMs);
+}
+
+static void TestCancelAndErrors(LuaManager& lua)
+{
+	tfrg_atomic32_t states[CANCELED + 1] = {};
+	auto callback = [&states](ScriptState state) { tfrg_atomic32_add_relaxed(&states[state], 1); };
+
+	// Long scripts, the first ones are running when they get canceled and the rest are still queued
+	const uint32_t cancelCount = 64;
+	ScriptHandle handles[cancelCount] = {};
+	for (uint32_t i = 0; i < cancelCount; ++i)
+		handles[i] = lua.AddAsyncScript("LuaAsyncEndless.lua", callback);
+	Thread::Sleep(10);
+	uint32_t canceled = 0;
+	for (uint32_t i = 0; i < cancelCount; ++i)
+	{
+		TEST_CHECK(handles[i] != INVALID_SCRIPT_HANDLE);
+		canceled += lua.CancelAsyncScript(handles[i]) ? 1 : 0;
+	}
+	TEST_CHECK(canceled == cancelCount);
+
+	ScriptHandle errorHandle = lua.AddAsyncScript("LuaAsyncError.lua", callback);
+	TEST_CHECK(errorHandle != INVALID_SCRIPT_HANDLE);
+	lua.WaitAsyncScripts();
+
+	TEST_CHECK(tfrg_atomic32_load_relaxed(&states[CANCELED]) == cancelCount);
+	TEST_CHECK(tfrg_atomic32_load_relaxed(&states[FINISHED_ERROR]) == 1);
+	TEST_CHECK(tfrg_atomic32_load_relaxed(&states[FINISHED_OK]) == 0);
+	// Finished scripts cannot be canceled any more
+	TEST_CHECK(!lua.CancelAsyncScript(errorHandle));
+	printf("cancel: %u scripts canceled, error script reported FINISHED_ERROR\n", canceled);
+}
+
+int main(int argc, char** argv)
+{
+	const uint32_t scriptCount = GetTestArg(argc, argv, "--scripts", 400);
+	const uint32_t loopCount = GetTestArg(argc, argv, "--loop", 2000000);
+	const double frameBudgetMs = GetTestArg(argc, argv, "--frame-budget", 50);
+	const bool checkScaling = HasTestFlag(argc, argv, "--check-scaling");
+	if (!scriptCount || !loopCount)
+	{
+		printf("--scripts and --loop must be greater than zero\n");
+		return EXIT_FAILURE;
+	}
+
+	if (!InitTestEnvironment("LuaAsyncTest"))
+		return EXIT_FAILURE;
+	fsSetPathForResourceDir(pSystemFileIO, RM_DEBUG, RD_SCRIPTS, "");
+
+	char work[256];
+	snprintf(work, sizeof(work), "local s = 0\nfor i = 1, %u do s = s + i %% 7 end\nreturn s\n", loopCount);
+	TEST_CHECK(WriteScript("LuaAsyncWork.lua", work));
+	TEST_CHECK(WriteScript("LuaAsyncEndless.lua", "local s = 0\nwhile true do s = s + 1 end\n"));
+	TEST_CHECK(WriteScript("LuaAsyncError.lua", "error(\"expected error\")\n"));
+
+	LuaManager lua;
+	lua.Init();
+	TestAsyncScripts(lua, scriptCount, frameBudgetMs, checkScaling);
+	TestCancelAndErrors(lua);
+	lua.Exit();
+
+	return ExitTestEnvironment();
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Measures the startup cost of a large Lua script set with and without the bytecode cache:
+// - source: a manager without RD_SCRIPT_CACHE compiles every script
+// - memory cache: the same manager runs the scripts again from the bytecode it kept
+// - source + disk write: a manager with RD_SCRIPT_CACHE compiles every script and writes the bytecode files
+// - disk cache: a new manager loads the bytecode files instead of compiling
+// - reload: one script is edited, only that one is compiled again and the edit is picked up
+//
+// Every run adds a nonce to the sources, so bytecode files of earlier runs never match.
+//
+// Options: --scripts <count> --functions <per script>
+
+#include "../../OS/Interfaces/IFileSystem.h"
+#include "../../../Middleware_3/LUA/LuaManager.h"
+
+#include "TestCommon.h"
+
+static char gScriptNames[1024][32];
+
+static bool WriteScript(const char* pFileName, const eastl::string& source)
+{
+	FileStream stream = {};
+	if (!fsOpenStreamFromPath(RD_SCRIPTS, pFileName, FM_WRITE_BINARY, &stream))
+		return false;
+	bool success = fsWriteToStream(&stream, source.c_str(), source.size()) == source.size();
+	fsCloseStream(&stream);
+	return success;
+}
+
+// Defines the functions without calling them, so running the script costs little more than loading it
+static eastl::string GenerateScript(uint32_t scriptIndex, uint32_t functionCount, uint64_t nonce, const char* pExtra)
+{
+	eastl::string source;
+	source.append_sprintf("-- generated by LuaBytecodeBenchmark %llu\n", (unsigned long long)nonce);
+	for (uint32_t i = 0; i < functionCount; ++i)
+	{
+		source.append_sprintf(
+			"function script%u_function%u(count, scale)\n"
+			"\tlocal values = {}\n"
+			"\tfor i = 1, count do\n"
+			"\t\tif i %% 3 == 0 then values[i] = i * scale + %u else values[i] = math.sqrt(i) - %u end\n"
+			"\tend\n"
+			"\treturn #values, values[1], \"script%u_function%u\"\n"
+			"end\n",
+			scriptIndex, i, i, i, scriptIndex, i);
+	}
+	source.append(pExtra);
+	return source;
+}
+
+static double RunAllScripts(LuaManager& lua, uint32_t scriptCount)
+{
+	int64_t start = getNSec();
+	uint32_t failed = 0;
+	for (uint32_t i = 0; i < scriptCount; ++i)
+		failed += lua.RunScript(gScriptNames[i]) ? 0 : 1;
+	double ms = NsToMs(getNSec() - start);
+	TEST_CHECK(failed == 0);
+	return ms;
+}
+
+static void PrintResult(const char* pName, double ms, uint32_t scriptCount, double sourceMs)
+{
+	printf("  %-22s %9.2f ms %8.3f ms/script %7.2fx\n", pName, ms, ms / scriptCount, sourceMs / ms);
+}
+
+int main(int argc, char** argv)
+{
+	const uint32_t scriptCount = GetTestArg(argc, argv, "--scripts", 256);
+	const uint32_t functionCount = GetTestArg(argc, argv, "--functions", 300);
+	if (!scriptCount || scriptCount > 1024 || !functionCount)
+	{
+		printf("--scripts must be between 1 and 1024, --functions greater than zero\n");
+		return EXIT_FAILURE;
+	}
+
+	if (!InitTestEnvironment("LuaBytecodeBenchmark"))
+		return EXIT_FAILURE;
+	fsSetPathForResourceDir(pSystemFileIO, RM_DEBUG, RD_SCRIPTS, "");
+
+	const uint64_t nonce = (uint64_t)getNSec();
+	size_t sourceSize = 0;
+	for (uint32_t i = 0; i < scriptCount; ++i)
+	{
+		snprintf(gScriptNames[i], sizeof(gScriptNames[i]), "LuaBytecode%u.lua", i);
+		eastl::string source = GenerateScript(i, functionCount, nonce, "");
+		sourceSize += source.size();
+		TEST_CHECK(WriteScript(gScriptNames[i], source));
+	}
+	printf("%u scripts with %u functions each, %.1f MB of source\n", scriptCount, functionCount, sourceSize / (1024.0 * 1024.0));
+
+	// Only the memory cache, RD_SCRIPT_CACHE is not set yet
+	LuaManager lua;
+	lua.Init();
+	const double sourceMs = RunAllScripts(lua, scriptCount);
+	const double memoryMs = RunAllScripts(lua, scriptCount);
+	lua.Exit();
+
+	fsSetPathForResourceDir(pSystemFileIO, RM_DEBUG, RD_SCRIPT_CACHE, "");
+	lua.Init();
+	const double writeMs = RunAllScripts(lua, scriptCount);
+	lua.Exit();
+
+	FileStream bytecodeFile = {};
+	TEST_CHECK(fsOpenStreamFromPath(RD_SCRIPT_CACHE, "LuaBytecode0.lua.bc", FM_READ_BINARY, &bytecodeFile));
+	fsCloseStream(&bytecodeFile);
+
+	lua.Init();
+	const double diskMs = RunAllScripts(lua, scriptCount);
+
+	// A broken edit has to fail, which shows the script was compiled again instead of taken from the cache.
+	// Fixing it has to succeed again, and the unchanged scripts still come from the cache.
+	TEST_CHECK(WriteScript(gScriptNames[0], GenerateScript(0, functionCount, nonce, "this is not lua\n")));
+	TEST_CHECK(!lua.RunScript(gScriptNames[0]));
+	TEST_CHECK(WriteScript(gScriptNames[0], GenerateScript(0, functionCount, nonce, "return 1\n")));
+	const double reloadMs = RunAllScripts(lua, scriptCount);
+	lua.Exit();
+
+	printf("Load and run all scripts:\n");
+	PrintResult("source", sourceMs, scriptCount, sourceMs);
+	PrintResult("memory cache", memoryMs, scriptCount, sourceMs);
+	PrintResult("source + disk write", writeMs, scriptCount, sourceMs);
+	PrintResult("disk cache", diskMs, scriptCount, sourceMs);
+	PrintResult("reload, one changed", reloadMs, scriptCount, sourceMs);
+
+	return ExitTestEnvironment();
+}
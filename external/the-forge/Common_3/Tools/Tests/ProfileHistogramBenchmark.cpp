@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Checks the profiler latency histograms and measures what they cost:
+// - every value falls in a bucket whose range holds it and is at most 1/32 of the value wide, percentiles of a known
+//   distribution are within that bound of the exact ones
+// - with histograms enabled every recorded scope is counted once, with them disabled nothing is added
+// - ProfileEnter/ProfileLeave cost per scope and flipProfiler cost per frame with histograms enabled and disabled.
+//   The histograms are filled in the flip, so the scope cost should not change.
+//
+// Options: --frames <count per pass> --scopes <scopes per frame> --passes <benchmark passes, the best is kept>
+
+#include "../../OS/Interfaces/IFileSystem.h"
+#include "../../OS/Interfaces/IProfiler.h"
+#include "../../OS/Profiler/ProfilerHistogram.h"
+#include "../../ThirdParty/OpenSource/EASTL/sort.h"
+#include "../../ThirdParty/OpenSource/EASTL/vector.h"
+
+#include "TestCommon.h"
+
+// GpuProfiler.cpp needs the renderer and is not linked, no GPU logs are recorded
+void     initGpuProfilers() {}
+void     exitGpuProfilers() {}
+uint64_t getGpuProfileTicksPerSecond(ProfileToken) { return 1000000000; }
+
+static uint32_t gRandomState = 0x9E3779B9u;
+
+static uint32_t Random()
+{
+	gRandomState ^= gRandomState << 13;
+	gRandomState ^= gRandomState >> 17;
+	gRandomState ^= gRandomState << 5;
+	return gRandomState;
+}
+
+static void TestBuckets()
+{
+	uint32_t failures = 0;
+	uint64_t values[4096];
+	for (uint32_t i = 0; i < 4096; ++i)
+	{
+		// Small values, powers of two and their neighbours, and random values of every magnitude
+		if (i < 64)
+			values[i] = i;
+		else if (i < 64 + 3 * 48)
+			values[i] = (1ull << ((i - 64) / 3)) + (i - 64) % 3 - 1;
+		else
+			values[i] = (((uint64_t)Random() << 32) | Random()) >> (Random() % 64);
+	}
+
+	uint32_t lastBucket = 0;
+	for (uint32_t i = 0; i < 4096; ++i)
+	{
+		const uint64_t value = values[i] >> PROFILE_HISTOGRAM_VALUE_BITS ? (1ull << PROFILE_HISTOGRAM_VALUE_BITS) - 1 : values[i];
+		const uint32_t bucket = profileHistogramBucket(value);
+		const uint64_t start = profileHistogramBucketStart(bucket);
+		const uint64_t end = profileHistogramBucketStart(bucket + 1);
+		if (bucket >= PROFILE_HISTOGRAM_BUCKETS || value < start || value >= end || (end - start) * PROFILE_HISTOGRAM_SUB_BUCKETS > (value > PROFILE_HISTOGRAM_SUB_BUCKETS ? value : PROFILE_HISTOGRAM_SUB_BUCKETS))
+		{
+			if (failures++ < 8)
+				printf("  value %llu in bucket %u [%llu, %llu)\n", (unsigned long long)value, bucket, (unsigned long long)start, (unsigned long long)end);
+		}
+		// Larger small and power of two values may not map to a lower bucket
+		if (i > 0 && i < 64 + 3 * 48 && values[i] >= values[i - 1] && bucket < lastBucket)
+			++failures;
+		lastBucket = bucket;
+	}
+	TEST_CHECK(failures == 0);
+
+	// Long tailed frame time like distribution, in ticks
+	const uint32_t sampleCount = 100000;
+	eastl::vector<uint64_t> samples(sampleCount);
+	uint64_t* pCounts = (uint64_t*)tf_calloc(PROFILE_HISTOGRAM_BUCKETS, sizeof(uint64_t));
+	for (uint32_t i = 0; i < sampleCount; ++i)
+	{
+		uint64_t value = 16000000 + Random() % 2000000;
+		if (!(Random() % 100))
+			value *= 2 + Random() % 4;
+		samples[i] = value;
+		pCounts[profileHistogramBucket(value)]++;
+	}
+	eastl::sort(samples.begin(), samples.end());
+
+	const double percentiles[] = { 50.0, 95.0, 99.0, 99.9 };
+	double maxError = 0.0;
+	for (double percentile : percentiles)
+	{
+		const double exact = (double)samples[(size_t)profileHistogramPercentileRank(sampleCount, percentile)];
+		const double estimate = profileHistogramPercentile(pCounts, sampleCount, percentile);
+		const double error = fabs(estimate - exact) / exact;
+		maxError = error > maxError ? error : maxError;
+	}
+	tf_free(pCounts);
+	TEST_CHECK(maxError <= 1.0 / PROFILE_HISTOGRAM_SUB_BUCKETS);
+	printf("buckets: %u values checked, percentile error at most %.2f%% (bound %.2f%%)\n", 4096, maxError * 100.0,
+		   100.0 / PROFILE_HISTOGRAM_SUB_BUCKETS);
+}
+
+struct PassResult
+{
+	double mScopeNs;
+	double mFlipUs;
+};
+
+static PassResult RunPass(ProfileToken token, uint32_t frameCount, uint32_t scopeCount)
+{
+	PassResult result = {};
+	int64_t scopeTime = 0;
+	int64_t flipTime = 0;
+	for (uint32_t frame = 0; frame < frameCount; ++frame)
+	{
+		int64_t start = getNSec();
+		for (uint32_t i = 0; i < scopeCount; ++i)
+			cpuProfileLeave(token, cpuProfileEnter(token));
+		int64_t end = getNSec();
+		flipProfiler();
+		scopeTime += end - start;
+		flipTime += getNSec() - end;
+	}
+	result.mScopeNs = (double)scopeTime / ((double)frameCount * scopeCount);
+	result.mFlipUs = (double)flipTime / frameCount / 1000.0;
+	return result;
+}
+
+// The flip handles a frame PROFILE_GPU_FRAME_DELAY + 1 frames after it was recorded
+static void FlushFrames()
+{
+	for (uint32_t i = 0; i < 8; ++i)
+		flipProfiler();
+}
+
+static void TestCounts(ProfileToken token, uint32_t frameCount, uint32_t scopeCount)
+{
+	ProfileLatencyStats stats = {};
+	setProfileHistogramsEnabled(true);
+	FlushFrames();
+	resetProfileHistograms();
+	RunPass(token, frameCount, scopeCount);
+	FlushFrames();
+	setProfileHistogramsEnabled(false);
+	TEST_CHECK(getProfileLatencyStats("ProfileHistogramBenchmark", "Scope", NULL, &stats));
+	const uint64_t enabledCount = stats.mCount;
+	TEST_CHECK(enabledCount == (uint64_t)frameCount * scopeCount);
+	TEST_CHECK(stats.mMinMs <= stats.mP50Ms && stats.mP50Ms <= stats.mP99Ms && stats.mP99Ms <= stats.mMaxMs);
+
+	RunPass(token, frameCount, scopeCount);
+	FlushFrames();
+	getProfileLatencyStats("ProfileHistogramBenchmark", "Scope", NULL, &stats);
+	TEST_CHECK(stats.mCount == enabledCount);
+
+	ProfileLatencyStats frameStats = {};
+	TEST_CHECK(getProfileFrameLatencyStats(&frameStats));
+	TEST_CHECK(dumpProfileHistograms("ProfileHistogramBenchmark.txt"));
+	printf("counts: %llu/%llu scopes recorded while enabled, %llu after a disabled pass, %llu frames\n",
+		   (unsigned long long)enabledCount, (unsigned long long)frameCount * scopeCount, (unsigned long long)stats.mCount,
+		   (unsigned long long)frameStats.mCount);
+}
+
+int main(int argc, char** argv)
+{
+	const uint32_t frameCount = GetTestArg(argc, argv, "--frames", 200);
+	const uint32_t scopeCount = GetTestArg(argc, argv, "--scopes", 5000);
+	const uint32_t passCount = GetTestArg(argc, argv, "--passes", 5);
+	// The per thread log has to hold the frames the flip has not handled yet
+	if (!frameCount || !scopeCount || scopeCount > 20000 || !passCount)
+	{
+		printf("--frames and --passes must be greater than zero, --scopes between 1 and 20000\n");
+		return EXIT_FAILURE;
+	}
+
+	if (!InitTestEnvironment("ProfileHistogramBenchmark"))
+		return EXIT_FAILURE;
+
+	TestBuckets();
+
+	initProfiler();
+	ProfileToken token = getCpuProfileToken("ProfileHistogramBenchmark", "Scope", 0xff00ff00);
+	TestCounts(token, frameCount < 50 ? frameCount : 50, scopeCount);
+
+	// Alternate the modes, so drifting clocks and caches affect both the same way
+	PassResult best[2] = { { 1e30, 1e30 }, { 1e30, 1e30 } };
+	for (uint32_t pass = 0; pass < passCount; ++pass)
+	{
+		for (uint32_t enabled = 0; enabled < 2; ++enabled)
+		{
+			setProfileHistogramsEnabled(enabled != 0);
+			FlushFrames();
+			PassResult result = RunPass(token, frameCount, scopeCount);
+			best[enabled].mScopeNs = result.mScopeNs < best[enabled].mScopeNs ? result.mScopeNs : best[enabled].mScopeNs;
+			best[enabled].mFlipUs = result.mFlipUs < best[enabled].mFlipUs ? result.mFlipUs : best[enabled].mFlipUs;
+		}
+	}
+	exitProfiler();
+
+	printf("\nBest of %u passes, %u frames of %u scopes:\n", passCount, frameCount, scopeCount);
+	printf("  histograms off: enter+leave %6.1f ns/scope, flip %8.1f us/frame\n", best[0].mScopeNs, best[0].mFlipUs);
+	printf("  histograms on:  enter+leave %6.1f ns/scope, flip %8.1f us/frame\n", best[1].mScopeNs, best[1].mFlipUs);
+	printf("  histogram cost: %+.1f ns/scope in the flip, %+.1f ns/scope at the call site\n",
+		   (best[1].mFlipUs - best[0].mFlipUs) * 1000.0 / scopeCount, best[1].mScopeNs - best[0].mScopeNs);
+
+	return ExitTestEnvironment();
+}
@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Records synthetic scopes, labels and counters from many threads into a profile stream, converts it to a Chrome trace
+// and validates the trace:
+// - every scope recorded while the stream ran is a complete event, nested inside its parent on the same thread
+// - scopes recorded before the stream started are not in it
+// - scopes of threads which exit between two flips are kept
+// - every label appears once, the counter track ends at the sum of all additions
+// - the exporter's own cost, as reported by getProfileStreamStats
+//
+// The GPU profiler needs a renderer, so the stream holds CPU logs only.
+//
+// Options: --threads <recording threads> --frames <count> --scopes <outer scopes per thread and frame>
+
+#include "../../OS/Interfaces/IFileSystem.h"
+#include "../../OS/Interfaces/IProfiler.h"
+#include "../../OS/Interfaces/IThread.h"
+#include "../../OS/Core/ThreadSystem.h"
+#include "../../OS/Profiler/ProfilerBase.h"
+#include "../../ThirdParty/OpenSource/EASTL/sort.h"
+#include "../../ThirdParty/OpenSource/EASTL/vector.h"
+#include "../../ThirdParty/OpenSource/EASTL/unordered_set.h"
+
+#include "TestCommon.h"
+
+// GpuProfiler.cpp needs the renderer and is not linked, no GPU logs are recorded
+void     initGpuProfilers() {}
+void     exitGpuProfilers() {}
+uint64_t getGpuProfileTicksPerSecond(ProfileToken) { return 1000000000; }
+
+struct RecordContext
+{
+	ProfileToken mOuterToken;
+	ProfileToken mInnerToken;
+	ProfileToken mLabelToken;
+	ProfileToken mCounterToken;
+	uint32_t     mFrame;
+	uint32_t     mScopes;
+};
+
+static void RecordScopes(RecordContext* pContext, uint32_t recorder)
+{
+	for (uint32_t i = 0; i < pContext->mScopes; ++i)
+	{
+		uint64_t outerTick = cpuProfileEnter(pContext->mOuterToken);
+		uint64_t innerTick = cpuProfileEnter(pContext->mInnerToken);
+		// Some work, so the scopes have a duration
+		volatile uint32_t sum = 0;
+		for (uint32_t j = 0; j < 200; ++j)
+			sum += j * i;
+		cpuProfileLeave(pContext->mInnerToken, innerTick);
+		ProfileCounterAdd(pContext->mCounterToken, 1);
+		cpuProfileLeave(pContext->mOuterToken, outerTick);
+	}
+	ProfileLabelFormat(pContext->mLabelToken, "frame %u recorder %u", pContext->mFrame, recorder);
+}
+
+static void RecordTask(void* pUser, uintptr_t index) { RecordScopes((RecordContext*)pUser, (uint32_t)index); }
+
+// Records from a thread which exits before the next flip
+static RecordContext* pShortLivedContext = NULL;
+static uint32_t       gShortLivedRecorder = 0;
+static void           ShortLivedThread(void*) { RecordScopes(pShortLivedContext, gShortLivedRecorder); }
+
+struct TraceEvent
+{
+	uint32_t mTid;
+	double   mStart;
+	double   mEnd;
+};
+
+static const char* FindValue(const char* pLine, const char* pKey)
+{
+	const char* pFound = strstr(pLine, pKey);
+	return pFound ? pFound + strlen(pKey) : NULL;
+}
+
+static eastl::string GetName(const char* pLine)
+{
+	const char* pName = FindValue(pLine, "\"name\":\"");
+	if (!pName)
+		return eastl::string();
+	const char* pEnd = strchr(pName, '"');
+	return eastl::string(pName, pEnd ? pEnd : pName + strlen(pName));
+}
+
+// Inner scopes have to lie within an outer scope of the same thread. The times are printed with 3 decimals.
+static uint32_t CountUnnested(eastl::vector<TraceEvent>& outer, const eastl::vector<TraceEvent>& inner)
+{
+	eastl::sort(outer.begin(), outer.end(), [](const TraceEvent& a, const TraceEvent& b) {
+		return a.mTid != b.mTid ? a.mTid < b.mTid : a.mStart < b.mStart;
+	});
+	const double epsilon = 0.002;
+	uint32_t unnested = 0;
+	for (const TraceEvent& event : inner)
+	{
+		// Last outer scope of the thread starting at or before the inner one
+		const TraceEvent* pParent = NULL;
+		size_t lo = 0, hi = outer.size();
+		while (lo < hi)
+		{
+			size_t mid = (lo + hi) / 2;
+			const TraceEvent& candidate = outer[mid];
+			if (candidate.mTid < event.mTid || (candidate.mTid == event.mTid && candidate.mStart <= event.mStart + epsilon))
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		if (lo > 0 && outer[lo - 1].mTid == event.mTid)
+			pParent = &outer[lo - 1];
+		if (!pParent || pParent->mEnd + epsilon < event.mEnd)
+			++unnested;
+	}
+	return unnested;
+}
+
+static void ValidateTrace(const char* pFileName, uint32_t expectedScopes, uint32_t expectedLabels, uint32_t expectedThreads)
+{
+	FileStream stream = {};
+	if (!fsOpenStreamFromPath(RD_LOG, pFileName, FM_READ_BINARY, &stream))
+	{
+		TEST_CHECK(false);
+		return;
+	}
+	eastl::string text;
+	text.resize((size_t)fsGetStreamFileSize(&stream));
+	text.resize(fsReadFromStream(&stream, &text[0], text.size()));
+	fsCloseStream(&stream);
+
+	eastl::vector<TraceEvent> outer;
+	eastl::vector<TraceEvent> inner;
+	eastl::unordered_set<eastl::string> labels;
+	uint32_t beforeStream = 0;
+	uint32_t duplicateLabels = 0;
+	uint32_t threadNames = 0;
+	long long lastCounter = -1;
+
+	// One event per line
+	size_t pos = 0;
+	while (pos < text.size())
+	{
+		size_t end = text.find('\n', pos);
+		if (end == eastl::string::npos)
+			end = text.size();
+		eastl::string line = text.substr(pos, end - pos);
+		pos = end + 1;
+		const char* pLine = line.c_str();
+		const char* pPhase = FindValue(pLine, "{\"ph\":\"");
+		if (!pPhase)
+			continue;
+
+		eastl::string name = GetName(pLine);
+		if (*pPhase == 'X')
+		{
+			const char* pTid = FindValue(pLine, "\"tid\":");
+			const char* pTs = FindValue(pLine, "\"ts\":");
+			const char* pDur = FindValue(pLine, "\"dur\":");
+			TEST_CHECK(pTid && pTs && pDur);
+			if (!pTid || !pTs || !pDur)
+				continue;
+			TraceEvent event = { (uint32_t)strtoul(pTid, NULL, 10), strtod(pTs, NULL), 0.0 };
+			event.mEnd = event.mStart + strtod(pDur, NULL);
+			if (name == "Outer")
+				outer.push_back(event);
+			else if (name == "Inner")
+				inner.push_back(event);
+			else if (name == "BeforeStream")
+				++beforeStream;
+		}
+		else if (*pPhase == 'i' && strstr(pLine, "\"s\":\"t\""))
+		{
+			if (!labels.insert(name).second)
+				++duplicateLabels;
+		}
+		else if (*pPhase == 'C' && name == "ProfileStreamTest items")
+		{
+			const char* pValue = FindValue(pLine, "\"value\":");
+			if (pValue)
+				lastCounter = strtoll(pValue, NULL, 10);
+		}
+		else if (*pPhase == 'M' && name == "thread_name")
+		{
+			++threadNames;
+		}
+	}
+
+	const uint32_t unnested = CountUnnested(outer, inner);
+	TEST_CHECK(outer.size() == expectedScopes);
+	TEST_CHECK(inner.size() == expectedScopes);
+	TEST_CHECK(unnested == 0);
+	TEST_CHECK(beforeStream == 0);
+	TEST_CHECK(labels.size() == expectedLabels);
+	TEST_CHECK(duplicateLabels == 0);
+	TEST_CHECK(lastCounter == (long long)expectedScopes);
+	TEST_CHECK(threadNames >= expectedThreads);
+
+	printf("trace: %u/%u outer and %u/%u inner scopes, %u not nested, %u/%u labels, counter %lld/%u, %u threads\n", (uint32_t)outer.size(),
+		   expectedScopes, (uint32_t)inner.size(), expectedScopes, unnested, (uint32_t)labels.size(), expectedLabels, lastCounter,
+		   expectedScopes, threadNames);
+}
+
+int main(int argc, char** argv)
+{
+	const uint32_t threadCount = GetTestArg(argc, argv, "--threads", 8);
+	const uint32_t frameCount = GetTestArg(argc, argv, "--frames", 300);
+	const uint32_t scopeCount = GetTestArg(argc, argv, "--scopes", 64);
+	if (!threadCount || !frameCount || !scopeCount)
+	{
+		printf("--threads, --frames and --scopes must be greater than zero\n");
+		return EXIT_FAILURE;
+	}
+
+	if (!InitTestEnvironment("ProfileStreamTest"))
+		return EXIT_FAILURE;
+
+	initProfiler();
+	ThreadSystem* pThreadSystem = NULL;
+	initThreadSystem(&pThreadSystem, threadCount, 0, true, "ProfileRecorder");
+
+	RecordContext context = {};
+	context.mOuterToken = getCpuProfileToken("ProfileStreamTest", "Outer", 0xff00ff00);
+	context.mInnerToken = getCpuProfileToken("ProfileStreamTest", "Inner", 0xff0000ff);
+	context.mLabelToken = ProfileGetLabelToken("ProfileStreamTest");
+	context.mCounterToken = ProfileGetCounterToken("ProfileStreamTest items");
+	context.mScopes = scopeCount;
+	pShortLivedContext = &context;
+
+	// Not part of the capture
+	ProfileToken beforeToken = getCpuProfileToken("ProfileStreamTest", "BeforeStream", 0xffff0000);
+	cpuProfileLeave(beforeToken, cpuProfileEnter(beforeToken));
+	flipProfiler();
+
+	TEST_CHECK(startProfileStream("ProfileStreamTest.bin"));
+	// One recorder per thread system task and one short lived thread per frame
+	const uint32_t recordersPerFrame = threadCount + 1;
+	const int64_t start = getNSec();
+	for (uint32_t frame = 0; frame < frameCount; ++frame)
+	{
+		context.mFrame = frame;
+		addThreadSystemRangeTask(pThreadSystem, RecordTask, &context, threadCount);
+
+		gShortLivedRecorder = threadCount;
+		ThreadDesc threadDesc = {};
+		threadDesc.pFunc = ShortLivedThread;
+		ThreadHandle thread = create_thread(&threadDesc);
+		destroy_thread(thread);
+
+		waitThreadSystemIdle(pThreadSystem);
+		flipProfiler();
+	}
+	const double recordMs = NsToMs(getNSec() - start);
+	stopProfileStream();
+
+	ProfileStreamStats stats = {};
+	getProfileStreamStats(&stats);
+	shutdownThreadSystem(pThreadSystem);
+	exitProfiler();
+
+	TEST_CHECK(stats.mFrames >= frameCount);
+	TEST_CHECK(stats.mDroppedFrames == 0);
+	printf("%u frames, %u recorders per frame, %u scopes each, %.1f ms\n", frameCount, recordersPerFrame, scopeCount, recordMs);
+	printf("stream: %llu entries, %.2f bytes/entry, flip encode %.1f us/frame (max %.1f us), writer %.1f us/frame\n",
+		   (unsigned long long)stats.mEntries, stats.mEntries ? (double)stats.mBytesWritten / stats.mEntries : 0.0,
+		   stats.mFrames ? stats.mFlipTotalMs * 1000.0 / stats.mFrames : 0.0, stats.mFlipMaxMs * 1000.0,
+		   stats.mFrames ? stats.mWriterTotalMs * 1000.0 / stats.mFrames : 0.0);
+
+	const int64_t convertStart = getNSec();
+	TEST_CHECK(convertProfileStreamToChromeTrace("ProfileStreamTest.bin", "ProfileStreamTest.json"));
+	printf("converted in %.1f ms\n", NsToMs(getNSec() - convertStart));
+
+	// The short lived threads of all frames plus the thread system workers
+	ValidateTrace("ProfileStreamTest.json", frameCount * recordersPerFrame * scopeCount, frameCount * recordersPerFrame, threadCount + 1);
+
+	return ExitTestEnvironment();
+}
@@ -0,0 +1,408 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Records render target binds on several threads while render targets are removed, through the per thread render pass
+// caches of the Vulkan backend with stand-in render passes and frame buffers:
+// - after its first lookup in a frame, no thread holds a frame buffer of a render target removed before that frame
+// - frame buffers of removed render targets are destroyed, the live count stays bounded while targets are replaced
+//   every frame, and nothing is left once all render targets are removed after the threads exited
+// - binds per millisecond of the lock free caches against the previous ThreadID keyed maps behind one mutex
+//
+// Options: --threads <recording threads> --frames <frames> --targets <render targets in use> --binds <binds per thread per frame>
+
+#include "../../OS/Core/Atomics.h"
+#include "../../OS/Interfaces/IThread.h"
+#include "../../Renderer/RenderPassCache.h"
+
+#include "TestCommon.h"
+
+struct TestRenderPass
+{
+	uint32_t mKey;
+};
+
+struct TestFrameBuffer
+{
+	uint32_t mRenderTargetIds[2];
+	uint32_t mRenderTargetIdCount;
+};
+
+typedef RenderPassCaches<TestRenderPass, TestFrameBuffer> TestRenderPassCaches;
+
+static tfrg_atomic32_t gRenderPassesCreated = 0;
+static tfrg_atomic32_t gRenderPassesRemoved = 0;
+static tfrg_atomic32_t gFrameBuffersCreated = 0;
+static tfrg_atomic32_t gFrameBuffersRemoved = 0;
+
+static void RemoveRenderPass(Renderer*, TestRenderPass* pRenderPass)
+{
+	tf_free(pRenderPass);
+	tfrg_atomic32_add_relaxed(&gRenderPassesRemoved, 1);
+}
+
+static void RemoveFrameBuffer(Renderer*, TestFrameBuffer* pFrameBuffer)
+{
+	tf_free(pFrameBuffer);
+	tfrg_atomic32_add_relaxed(&gFrameBuffersRemoved, 1);
+}
+
+// Same lookups as cmdBindRenderTargets, a render pass per format combination and a frame buffer per render target pair
+static TestFrameBuffer* Bind(uint32_t colorId, uint32_t depthId, uint32_t renderPassKey)
+{
+	TestRenderPassCaches::Cache* pCache = TestRenderPassCaches::get(NULL);
+	if (pCache->mRenderPasses.find(renderPassKey) == pCache->mRenderPasses.end())
+	{
+		TestRenderPass* pRenderPass = (TestRenderPass*)tf_calloc(1, sizeof(TestRenderPass));
+		pRenderPass->mKey = renderPassKey;
+		pCache->mRenderPasses.insert(eastl::make_pair((uint64_t)renderPassKey, pRenderPass));
+		tfrg_atomic32_add_relaxed(&gRenderPassesCreated, 1);
+	}
+
+	const uint64_t                                   frameBufferKey = ((uint64_t)colorId << 32) | depthId;
+	TestRenderPassCaches::FrameBufferMap::iterator it = pCache->mFrameBuffers.find(frameBufferKey);
+	if (it != pCache->mFrameBuffers.end())
+		return it->second;
+
+	TestFrameBuffer* pFrameBuffer = (TestFrameBuffer*)tf_calloc(1, sizeof(TestFrameBuffer));
+	pFrameBuffer->mRenderTargetIds[0] = colorId;
+	pFrameBuffer->mRenderTargetIds[1] = depthId;
+	pFrameBuffer->mRenderTargetIdCount = 2;
+	pCache->mFrameBuffers.insert(eastl::make_pair(frameBufferKey, pFrameBuffer));
+	TestRenderPassCaches::trackFrameBuffer(pCache, pFrameBuffer);
+	tfrg_atomic32_add_relaxed(&gFrameBuffersCreated, 1);
+	return pFrameBuffer;
+}
+
+#define MAX_TARGETS 64
+
+struct RecordContext
+{
+	Mutex             mMutex;
+	ConditionVariable mFrameStarted;
+	ConditionVariable mFrameDone;
+	uint32_t          mPublishedFrame;
+	uint32_t          mDoneCount;
+	uint32_t          mThreadCount;
+	uint32_t          mFrameCount;
+	uint32_t          mTargetCount;
+	uint32_t          mBindCount;
+	// Render target ids used by even and odd frames, the main thread fills in the next frame while this one records
+	uint32_t          mTargets[2][MAX_TARGETS];
+	// Frame before which a render target was removed, 0 while it is alive
+	tfrg_atomic32_t*  pRemovedBefore;
+	tfrg_atomic32_t   mStaleFrameBuffers;
+	tfrg_atomic32_t   mNextThreadIndex;
+};
+
+static void RecordThread(void* pData)
+{
+	RecordContext* pContext = (RecordContext*)pData;
+	const uint32_t threadIndex = tfrg_atomic32_add_relaxed(&pContext->mNextThreadIndex, 1);
+	for (uint32_t frame = 1; frame <= pContext->mFrameCount; ++frame)
+	{
+		{
+			MutexLock lock(pContext->mMutex);
+			while (pContext->mPublishedFrame < frame)
+				pContext->mFrameStarted.Wait(pContext->mMutex);
+		}
+
+		const uint32_t* pTargets = pContext->mTargets[frame & 1];
+		for (uint32_t b = 0; b < pContext->mBindCount; ++b)
+		{
+			const uint32_t i = (b + threadIndex) % pContext->mTargetCount;
+			Bind(pTargets[i], pTargets[(i + 1) % pContext->mTargetCount], i % 4);
+		}
+
+		// The lookups above evicted everything removed before this frame was published
+		const TestRenderPassCaches::Cache* pCache = TestRenderPassCaches::get(NULL);
+		for (const TestRenderPassCaches::FrameBufferMap::value_type& it : pCache->mFrameBuffers)
+		{
+			for (uint32_t i = 0; i < it.second->mRenderTargetIdCount; ++i)
+			{
+				const uint32_t removedBefore = tfrg_atomic32_load_relaxed(&pContext->pRemovedBefore[it.second->mRenderTargetIds[i]]);
+				if (removedBefore && removedBefore <= frame)
+					tfrg_atomic32_add_relaxed(&pContext->mStaleFrameBuffers, 1);
+			}
+		}
+
+		MutexLock lock(pContext->mMutex);
+		++pContext->mDoneCount;
+		pContext->mFrameDone.WakeOne();
+	}
+}
+
+static void TestRecording(uint32_t threadCount, uint32_t frameCount, uint32_t targetCount, uint32_t bindCount)
+{
+	RecordContext context = {};
+	context.mMutex.Init();
+	context.mFrameStarted.Init();
+	context.mFrameDone.Init();
+	context.mThreadCount = threadCount;
+	context.mFrameCount = frameCount;
+	context.mTargetCount = targetCount;
+	context.mBindCount = bindCount;
+
+	// A quarter of the render targets is replaced every frame, like resized targets
+	const uint32_t replaceCount = targetCount / 4 ? targetCount / 4 : 1;
+	const uint32_t idCount = 1 + targetCount + (frameCount + 1) * replaceCount;
+	context.pRemovedBefore = (tfrg_atomic32_t*)tf_calloc(idCount, sizeof(tfrg_atomic32_t));
+	uint32_t nextId = 1;
+	for (uint32_t i = 0; i < targetCount; ++i)
+		context.mTargets[1][i] = nextId++;
+
+	ThreadHandle* pThreads = (ThreadHandle*)tf_calloc(threadCount, sizeof(ThreadHandle));
+	for (uint32_t i = 0; i < threadCount; ++i)
+	{
+		ThreadDesc threadDesc = {};
+		threadDesc.pFunc = RecordThread;
+		threadDesc.pData = &context;
+		pThreads[i] = create_thread(&threadDesc);
+	}
+
+	eastl::vector<uint32_t> replacedIds;
+	eastl::vector<uint32_t> removeIds;
+	uint32_t                maxLive = 0;
+	uint32_t                removedCount = 0;
+	for (uint32_t frame = 1; frame <= frameCount; ++frame)
+	{
+		{
+			MutexLock lock(context.mMutex);
+			context.mPublishedFrame = frame;
+			context.mFrameStarted.WakeAll();
+		}
+
+		// Targets replaced for this frame were last used by the previous one, which all threads finished.
+		// They are removed while this frame records.
+		removeIds.swap(replacedIds);
+		replacedIds.clear();
+		for (uint32_t id : removeIds)
+		{
+			tfrg_atomic32_store_relaxed(&context.pRemovedBefore[id], frame + 1);
+			TestRenderPassCaches::retireRenderTarget(NULL, id);
+			++removedCount;
+		}
+
+		const uint32_t* pCurrent = context.mTargets[frame & 1];
+		uint32_t*       pNext = context.mTargets[(frame + 1) & 1];
+		memcpy(pNext, pCurrent, targetCount * sizeof(uint32_t));
+		for (uint32_t r = 0; r < replaceCount; ++r)
+		{
+			const uint32_t slot = (frame * replaceCount + r) % targetCount;
+			replacedIds.push_back(pNext[slot]);
+			pNext[slot] = nextId++;
+		}
+
+		MutexLock lock(context.mMutex);
+		while (context.mDoneCount < threadCount * frame)
+			context.mFrameDone.Wait(context.mMutex);
+
+		const uint32_t live = tfrg_atomic32_load_relaxed(&gFrameBuffersCreated) - tfrg_atomic32_load_relaxed(&gFrameBuffersRemoved);
+		maxLive = live > maxLive ? live : maxLive;
+	}
+
+	for (uint32_t i = 0; i < threadCount; ++i)
+		join_thread(pThreads[i]);
+	tf_free(pThreads);
+
+	// The caches of the exited threads are evicted as soon as their render targets are removed
+	const uint32_t heldAfterExit = TestRenderPassCaches::getFrameBufferCount();
+	for (uint32_t id : replacedIds)
+		TestRenderPassCaches::retireRenderTarget(NULL, id);
+	for (uint32_t i = 0; i < targetCount; ++i)
+		TestRenderPassCaches::retireRenderTarget(NULL, context.mTargets[(frameCount + 1) & 1][i]);
+	removedCount += (uint32_t)replacedIds.size() + targetCount;
+
+	const uint32_t created = tfrg_atomic32_load_relaxed(&gFrameBuffersCreated);
+	const uint32_t removed = tfrg_atomic32_load_relaxed(&gFrameBuffersRemoved);
+	TEST_CHECK(tfrg_atomic32_load_relaxed(&context.mStaleFrameBuffers) == 0);
+	TEST_CHECK(TestRenderPassCaches::getFrameBufferCount() == 0);
+	TEST_CHECK(created == removed);
+	// Every thread holds the pairs of the current and of the previous frame at most
+	TEST_CHECK(maxLive <= threadCount * targetCount * 2);
+
+	printf("recording: %u threads, %u frames, %u render targets removed, %u frame buffers created, at most %u live, "
+		   "%u held by exited threads, %u stale\n",
+		   threadCount, frameCount, removedCount, created, maxLive, heldAfterExit,
+		   (uint32_t)tfrg_atomic32_load_relaxed(&context.mStaleFrameBuffers));
+
+	tf_free((void*)context.pRemovedBefore);
+	context.mFrameDone.Destroy();
+	context.mFrameStarted.Destroy();
+	context.mMutex.Destroy();
+}
+
+// The maps cmdBindRenderTargets used before: per thread maps in ThreadID keyed maps, each lookup takes the mutex
+struct LockedRenderPassMaps
+{
+	Mutex                                                                  mMutex;
+	eastl::hash_map<ThreadID, TestRenderPassCaches::RenderPassMap>  mRenderPassMaps;
+	eastl::hash_map<ThreadID, TestRenderPassCaches::FrameBufferMap> mFrameBufferMaps;
+
+	TestRenderPassCaches::RenderPassMap& getRenderPassMap()
+	{
+		MutexLock lock(mMutex);
+		return mRenderPassMaps[Thread::GetCurrentThreadID()];
+	}
+
+	TestRenderPassCaches::FrameBufferMap& getFrameBufferMap()
+	{
+		MutexLock lock(mMutex);
+		return mFrameBufferMaps[Thread::GetCurrentThreadID()];
+	}
+};
+
+struct BenchmarkContext
+{
+	LockedRenderPassMaps* pLockedMaps;
+	uint32_t              mBindCount;
+	uint32_t              mTargetCount;
+	uint32_t              mFirstId;
+	tfrg_atomic32_t       mStarted;
+	tfrg_atomic32_t       mGo;
+	tfrg_atomic64_t       mChecksum;
+};
+
+static void BenchmarkThread(void* pData)
+{
+	BenchmarkContext* pContext = (BenchmarkContext*)pData;
+	const uint32_t    targetCount = pContext->mTargetCount;
+	const uint32_t    firstId = pContext->mFirstId;
+	LockedRenderPassMaps* pLockedMaps = pContext->pLockedMaps;
+
+	// Warm the caches, the timed loop only hits
+	for (uint32_t i = 0; i < targetCount; ++i)
+	{
+		if (pLockedMaps)
+		{
+			TestFrameBuffer* pFrameBuffer = (TestFrameBuffer*)tf_calloc(1, sizeof(TestFrameBuffer));
+			pLockedMaps->getRenderPassMap()[i % 4] = NULL;
+			pLockedMaps->getFrameBufferMap()[((uint64_t)(firstId + i) << 32) | (firstId + (i + 1) % targetCount)] = pFrameBuffer;
+		}
+		else
+		{
+			Bind(firstId + i, firstId + (i + 1) % targetCount, i % 4);
+		}
+	}
+
+	tfrg_atomic32_add_relaxed(&pContext->mStarted, 1);
+	while (!tfrg_atomic32_load_acquire(&pContext->mGo))
+		Thread::Sleep(0);
+
+	uint64_t checksum = 0;
+	for (uint32_t b = 0; b < pContext->mBindCount; ++b)
+	{
+		const uint32_t i = b % targetCount;
+		const uint64_t key = ((uint64_t)(firstId + i) << 32) | (firstId + (i + 1) % targetCount);
+		if (pLockedMaps)
+		{
+			TestRenderPassCaches::RenderPassMap&  renderPassMap = pLockedMaps->getRenderPassMap();
+			TestRenderPassCaches::FrameBufferMap& frameBufferMap = pLockedMaps->getFrameBufferMap();
+			checksum += (uint64_t)(renderPassMap.find(i % 4) != renderPassMap.end());
+			checksum += (uint64_t)(uintptr_t)frameBufferMap.find(key)->second;
+		}
+		else
+		{
+			TestRenderPassCaches::Cache* pCache = TestRenderPassCaches::get(NULL);
+			checksum += (uint64_t)(pCache->mRenderPasses.find(i % 4) != pCache->mRenderPasses.end());
+			checksum += (uint64_t)(uintptr_t)pCache->mFrameBuffers.find(key)->second;
+		}
+	}
+	tfrg_atomic64_add_relaxed(&pContext->mChecksum, checksum);
+}
+
+// Returns binds per millisecond over all threads
+static double RunBenchmark(LockedRenderPassMaps* pLockedMaps, uint32_t threadCount, uint32_t bindCount, uint32_t targetCount, uint32_t firstId)
+{
+	BenchmarkContext context = {};
+	context.pLockedMaps = pLockedMaps;
+	context.mBindCount = bindCount;
+	context.mTargetCount = targetCount;
+	context.mFirstId = firstId;
+
+	ThreadHandle* pThreads = (ThreadHandle*)tf_calloc(threadCount, sizeof(ThreadHandle));
+	for (uint32_t i = 0; i < threadCount; ++i)
+	{
+		ThreadDesc threadDesc = {};
+		threadDesc.pFunc = BenchmarkThread;
+		threadDesc.pData = &context;
+		pThreads[i] = create_thread(&threadDesc);
+	}
+	while (tfrg_atomic32_load_acquire(&context.mStarted) < threadCount)
+		Thread::Sleep(0);
+
+	const int64_t start = getNSec();
+	tfrg_atomic32_store_release(&context.mGo, 1);
+	for (uint32_t i = 0; i < threadCount; ++i)
+		join_thread(pThreads[i]);
+	const double ms = NsToMs(getNSec() - start);
+	tf_free(pThreads);
+
+	TEST_CHECK(tfrg_atomic64_load_relaxed(&context.mChecksum) != 0);
+	return (double)threadCount * bindCount / ms;
+}
+
+int main(int argc, char** argv)
+{
+	const uint32_t threadCount = GetTestArg(argc, argv, "--threads", Thread::GetNumCPUCores());
+	const uint32_t frameCount = GetTestArg(argc, argv, "--frames", 500);
+	const uint32_t targetCount = GetTestArg(argc, argv, "--targets", 16);
+	const uint32_t bindCount = GetTestArg(argc, argv, "--binds", 200);
+	if (!threadCount || !frameCount || targetCount < 2 || targetCount > MAX_TARGETS || !bindCount)
+	{
+		printf("--threads, --frames and --binds must be greater than zero, --targets between 2 and %u\n", MAX_TARGETS);
+		return EXIT_FAILURE;
+	}
+
+	if (!InitTestEnvironment("RenderPassCacheTest"))
+		return EXIT_FAILURE;
+
+	TestRenderPassCaches::init(RemoveRenderPass, RemoveFrameBuffer);
+	TestRecording(threadCount, frameCount, targetCount, bindCount);
+
+	// Ids past the ones used by the recording test
+	const uint32_t benchmarkBinds = bindCount * frameCount;
+	const uint32_t firstId = 0x40000000;
+	printf("\nBinds per ms, %u binds per thread over %u render targets:\n", benchmarkBinds, targetCount);
+	printf("  %7s %12s %12s %8s\n", "threads", "locked maps", "lock free", "speedup");
+	for (uint32_t threads = 1; threads <= threadCount; threads *= 2)
+	{
+		LockedRenderPassMaps* pLockedMaps = tf_new(LockedRenderPassMaps);
+		pLockedMaps->mMutex.Init();
+		const double locked = RunBenchmark(pLockedMaps, threads, benchmarkBinds, targetCount, firstId);
+		for (eastl::hash_map<ThreadID, TestRenderPassCaches::FrameBufferMap>::value_type& it : pLockedMaps->mFrameBufferMaps)
+			for (TestRenderPassCaches::FrameBufferMap::value_type& frameBuffer : it.second)
+				tf_free(frameBuffer.second);
+		pLockedMaps->mMutex.Destroy();
+		tf_delete(pLockedMaps);
+
+		const double lockFree = RunBenchmark(NULL, threads, benchmarkBinds, targetCount, firstId);
+		printf("  %7u %12.0f %12.0f %7.1fx\n", threads, locked, lockFree, lockFree / locked);
+	}
+
+	TestRenderPassCaches::exit(NULL);
+	TEST_CHECK(tfrg_atomic32_load_relaxed(&gRenderPassesCreated) == tfrg_atomic32_load_relaxed(&gRenderPassesRemoved));
+	TEST_CHECK(tfrg_atomic32_load_relaxed(&gFrameBuffersCreated) == tfrg_atomic32_load_relaxed(&gFrameBuffersRemoved));
+
+	return ExitTestEnvironment();
+}
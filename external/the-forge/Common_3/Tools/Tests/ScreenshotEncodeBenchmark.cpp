@@ -0,0 +1,382 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Checks and measures the CPU half of the async screenshot capture, everything after the readback:
+// - the SIMD red/blue swizzle matches a scalar loop bit for bit, in place and out of place, including the tails
+// - QOI output decodes, with the independent decoder below, to the exact input pixels, RGB and RGBA
+// - TGA headers describe the image
+// - frames captured per second for PNG, QOI and TGA: swizzle, encode and write on worker threads like the capture ring does
+//
+// The GPU readback ring itself needs a renderer and is not covered here.
+//
+// Options: --width <pixels> --height <pixels> --frames <per format> --workers <encode threads>
+
+#include "../../OS/Interfaces/IFileSystem.h"
+#include "../../OS/Interfaces/IThread.h"
+#include "../../OS/Core/ThreadSystem.h"
+#include "../../OS/Core/ScreenshotEncoders.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#define STBIW_MALLOC tf_malloc
+#define STBIW_REALLOC tf_realloc
+#define STBIW_FREE tf_free
+#define STBIW_ASSERT ASSERT
+#include "../../ThirdParty/OpenSource/Nothings/stb_image_write.h"
+
+#include "TestCommon.h"
+
+static const ResourceDirectory CAPTURE_DIR = RD_SCREENSHOTS;
+
+enum EncodeFormat
+{
+	ENCODE_FORMAT_PNG,
+	ENCODE_FORMAT_QOI,
+	ENCODE_FORMAT_TGA,
+	ENCODE_FORMAT_COUNT,
+};
+
+static const char* gFormatNames[] = { "png", "qoi", "tga" };
+
+// Gradients, flat areas and noise, so QOI uses all of its ops
+static void FillImage(uint8_t* pPixels, uint32_t width, uint32_t height, uint32_t channelCount, uint32_t seed)
+{
+	uint32_t state = seed * 2654435761u + 1;
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			uint8_t* pPixel = pPixels + ((size_t)y * width + x) * channelCount;
+			state = state * 1664525u + 1013904223u;
+			const uint32_t region = (x / 64 + y / 64 + seed) % 4;
+			for (uint32_t c = 0; c < channelCount; ++c)
+			{
+				switch (region)
+				{
+				case 0: pPixel[c] = (uint8_t)(c == 3 ? 255 : 40 * c + 7); break;
+				case 1: pPixel[c] = (uint8_t)(x + y * c + seed); break;
+				case 2: pPixel[c] = (uint8_t)(x * (c + 1) + ((state >> (8 * c)) & 3)); break;
+				default: pPixel[c] = (uint8_t)(state >> (8 * c)); break;
+				}
+			}
+		}
+	}
+}
+
+/************************************************************************/
+// Swizzle
+/************************************************************************/
+static void TestSwizzle()
+{
+	const uint32_t pixelSizes[] = { 3, 4, 8 };
+	const size_t counts[] = { 0, 1, 3, 4, 15, 16, 17, 63, 1000, 4099 };
+	uint32_t failures = 0;
+
+	for (uint32_t pixelByteSize : pixelSizes)
+	{
+		for (size_t count : counts)
+		{
+			const size_t size = count * pixelByteSize;
+			uint8_t* pSrc = (uint8_t*)tf_malloc(size + 1);
+			uint8_t* pExpected = (uint8_t*)tf_malloc(size + 1);
+			uint8_t* pDst = (uint8_t*)tf_malloc(size + 1);
+			uint32_t state = (uint32_t)(count * 31 + pixelByteSize);
+			for (size_t i = 0; i < size; ++i)
+			{
+				state = state * 1664525u + 1013904223u;
+				pSrc[i] = (uint8_t)(state >> 24);
+			}
+
+			memcpy(pExpected, pSrc, size);
+			for (size_t i = 0; i < count; ++i)
+			{
+				uint8_t* pPixel = pExpected + i * pixelByteSize;
+				const uint8_t red = pPixel[0];
+				pPixel[0] = pPixel[2];
+				pPixel[2] = red;
+			}
+
+			// Out of place, the byte after the last pixel has to stay untouched
+			memset(pDst, 0xCD, size + 1);
+			swizzleRedBlue(pSrc, pDst, count, pixelByteSize);
+			bool ok = memcmp(pDst, pExpected, size) == 0 && pDst[size] == 0xCD;
+
+			// In place
+			swizzleRedBlue(pSrc, pSrc, count, pixelByteSize);
+			ok &= memcmp(pSrc, pExpected, size) == 0;
+
+			if (!ok)
+			{
+				printf("  swizzle mismatch: %zu pixels of %u bytes\n", count, pixelByteSize);
+				++failures;
+			}
+			tf_free(pDst);
+			tf_free(pExpected);
+			tf_free(pSrc);
+		}
+	}
+	TEST_CHECK(failures == 0);
+	printf("swizzle matches the scalar loop: %s\n", failures ? "FAILED" : "ok");
+}
+
+/************************************************************************/
+// QOI and TGA
+/************************************************************************/
+static uint32_t ReadBigEndian32(const uint8_t* pSrc) { return (uint32_t)pSrc[0] << 24 | pSrc[1] << 16 | pSrc[2] << 8 | pSrc[3]; }
+
+// Straight from the QOI specification, shares nothing with the encoder
+static bool DecodeQoi(const uint8_t* pData, size_t size, uint32_t* pWidth, uint32_t* pHeight, uint32_t* pChannels, uint8_t* pOut, size_t outSize)
+{
+	if (size < 14 + 8 || memcmp(pData, "qoif", 4) != 0)
+		return false;
+	*pWidth = ReadBigEndian32(pData + 4);
+	*pHeight = ReadBigEndian32(pData + 8);
+	*pChannels = pData[12];
+	const size_t pixelCount = (size_t)*pWidth * *pHeight;
+	if ((*pChannels != 3 && *pChannels != 4) || pixelCount * *pChannels > outSize)
+		return false;
+
+	uint8_t index[64][4] = {};
+	uint8_t pixel[4] = { 0, 0, 0, 255 };
+	size_t  pos = 14;
+	const size_t end = size - 8;
+	uint32_t run = 0;
+	for (size_t i = 0; i < pixelCount; ++i)
+	{
+		if (run > 0)
+		{
+			--run;
+		}
+		else
+		{
+			if (pos >= end)
+				return false;
+			const uint8_t op = pData[pos++];
+			if (op == 0xFE)
+			{
+				pixel[0] = pData[pos++];
+				pixel[1] = pData[pos++];
+				pixel[2] = pData[pos++];
+			}
+			else if (op == 0xFF)
+			{
+				pixel[0] = pData[pos++];
+				pixel[1] = pData[pos++];
+				pixel[2] = pData[pos++];
+				pixel[3] = pData[pos++];
+			}
+			else if ((op & 0xC0) == 0x00)
+			{
+				memcpy(pixel, index[op], 4);
+			}
+			else if ((op & 0xC0) == 0x40)
+			{
+				pixel[0] += ((op >> 4) & 3) - 2;
+				pixel[1] += ((op >> 2) & 3) - 2;
+				pixel[2] += (op & 3) - 2;
+			}
+			else if ((op & 0xC0) == 0x80)
+			{
+				const int dg = (op & 0x3F) - 32;
+				const uint8_t next = pData[pos++];
+				pixel[0] += dg - 8 + ((next >> 4) & 0x0F);
+				pixel[1] += dg;
+				pixel[2] += dg - 8 + (next & 0x0F);
+			}
+			else
+			{
+				run = op & 0x3F;
+			}
+			memcpy(index[(pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64], pixel, 4);
+		}
+		memcpy(pOut + i * *pChannels, pixel, *pChannels);
+	}
+
+	static const uint8_t padding[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+	return pos == end && memcmp(pData + end, padding, 8) == 0;
+}
+
+static void TestQoi()
+{
+	const uint32_t sizes[][2] = { { 1, 1 }, { 7, 3 }, { 257, 129 }, { 640, 360 } };
+	uint32_t failures = 0;
+	for (uint32_t channelCount = 3; channelCount <= 4; ++channelCount)
+	{
+		for (const uint32_t* size : sizes)
+		{
+			const size_t pixelsSize = (size_t)size[0] * size[1] * channelCount;
+			uint8_t* pPixels = (uint8_t*)tf_malloc(pixelsSize);
+			uint8_t* pDecoded = (uint8_t*)tf_malloc(pixelsSize);
+			FillImage(pPixels, size[0], size[1], channelCount, size[0]);
+
+			size_t encodedSize = 0;
+			uint8_t* pEncoded = encodeQoi(pPixels, size[0], size[1], channelCount, &encodedSize);
+			uint32_t width = 0, height = 0, channels = 0;
+			const bool ok = DecodeQoi(pEncoded, encodedSize, &width, &height, &channels, pDecoded, pixelsSize) && width == size[0] &&
+							height == size[1] && channels == channelCount && memcmp(pDecoded, pPixels, pixelsSize) == 0;
+			if (!ok)
+			{
+				printf("  qoi round trip failed: %ux%u, %u channels\n", size[0], size[1], channelCount);
+				++failures;
+			}
+
+			tf_free(pEncoded);
+			tf_free(pDecoded);
+			tf_free(pPixels);
+		}
+	}
+	TEST_CHECK(failures == 0);
+	printf("qoi round trip through an independent decoder: %s\n", failures ? "FAILED" : "ok");
+
+	uint8_t header[18];
+	writeTgaHeader(header, 1920, 1080, 4);
+	TEST_CHECK(header[2] == 2);
+	TEST_CHECK((header[12] | header[13] << 8) == 1920 && (header[14] | header[15] << 8) == 1080);
+	TEST_CHECK(header[16] == 32 && header[17] == (0x20 | 8));
+	writeTgaHeader(header, 640, 480, 3);
+	TEST_CHECK(header[16] == 24 && header[17] == 0x20);
+}
+
+/************************************************************************/
+// Throughput
+/************************************************************************/
+struct CaptureJob
+{
+	// Stands in for the mapped readback buffer
+	const uint8_t* pReadback;
+	uint8_t*       pPixels;
+	uint32_t       mWidth;
+	uint32_t       mHeight;
+	EncodeFormat   mFormat;
+	char           mFileName[64];
+	bool           mSucceeded;
+};
+
+// The same steps as the capture workers: one swizzle pass out of the readback memory, encode, write
+static void CaptureTask(void* pUser, uintptr_t index)
+{
+	CaptureJob* pJob = (CaptureJob*)pUser + index;
+	const size_t pixelCount = (size_t)pJob->mWidth * pJob->mHeight;
+	// The render target is BGRA, TGA stores BGRA as well
+	if (pJob->mFormat == ENCODE_FORMAT_TGA)
+		memcpy(pJob->pPixels, pJob->pReadback, pixelCount * 4);
+	else
+		swizzleRedBlue(pJob->pReadback, pJob->pPixels, pixelCount, 4);
+
+	uint8_t* pEncoded = NULL;
+	size_t   encodedSize = 0;
+	uint8_t  tgaHeader[18];
+	switch (pJob->mFormat)
+	{
+	case ENCODE_FORMAT_QOI: pEncoded = encodeQoi(pJob->pPixels, pJob->mWidth, pJob->mHeight, 4, &encodedSize); break;
+	case ENCODE_FORMAT_TGA: writeTgaHeader(tgaHeader, pJob->mWidth, pJob->mHeight, 4); break;
+	default:
+	{
+		int len = 0;
+		pEncoded = stbi_write_png_to_mem(pJob->pPixels, pJob->mWidth * 4, pJob->mWidth, pJob->mHeight, 4, &len);
+		encodedSize = (size_t)len;
+		break;
+	}
+	}
+
+	FileStream stream = {};
+	pJob->mSucceeded = fsOpenStreamFromPath(CAPTURE_DIR, pJob->mFileName, FM_WRITE_BINARY, &stream);
+	if (pJob->mSucceeded)
+	{
+		if (pJob->mFormat == ENCODE_FORMAT_TGA)
+			pJob->mSucceeded = fsWriteToStream(&stream, tgaHeader, sizeof(tgaHeader)) == sizeof(tgaHeader) &&
+							   fsWriteToStream(&stream, pJob->pPixels, pixelCount * 4) == pixelCount * 4;
+		else
+			pJob->mSucceeded = pEncoded && fsWriteToStream(&stream, pEncoded, encodedSize) == encodedSize;
+		fsCloseStream(&stream);
+	}
+	if (pEncoded)
+		tf_free(pEncoded);
+}
+
+static void BenchmarkFormat(
+	ThreadSystem* pThreadSystem, EncodeFormat format, const uint8_t* pReadback, uint32_t width, uint32_t height, uint32_t frameCount)
+{
+	const size_t frameSize = (size_t)width * height * 4;
+	CaptureJob* pJobs = (CaptureJob*)tf_calloc(frameCount, sizeof(CaptureJob));
+	for (uint32_t i = 0; i < frameCount; ++i)
+	{
+		pJobs[i].pReadback = pReadback;
+		pJobs[i].pPixels = (uint8_t*)tf_malloc(frameSize);
+		pJobs[i].mWidth = width;
+		pJobs[i].mHeight = height;
+		pJobs[i].mFormat = format;
+		// A few files are overwritten over and over, the sequence would only fill the disk
+		snprintf(pJobs[i].mFileName, sizeof(pJobs[i].mFileName), "ScreenshotEncodeBenchmark%u.%s", i % 4, gFormatNames[format]);
+	}
+
+	const int64_t start = getNSec();
+	addThreadSystemRangeTask(pThreadSystem, CaptureTask, pJobs, frameCount);
+	waitThreadSystemIdle(pThreadSystem);
+	const double seconds = (getNSec() - start) / 1e9;
+
+	uint32_t written = 0;
+	for (uint32_t i = 0; i < frameCount; ++i)
+	{
+		written += pJobs[i].mSucceeded ? 1 : 0;
+		tf_free(pJobs[i].pPixels);
+	}
+	tf_free(pJobs);
+	TEST_CHECK(written == frameCount);
+
+	printf("  %s: %8.1f frames/s, %7.1f MB/s of pixels\n", gFormatNames[format], frameCount / seconds, frameCount * frameSize / seconds / 1e6);
+}
+
+int main(int argc, char** argv)
+{
+	const uint32_t width = GetTestArg(argc, argv, "--width", 1920);
+	const uint32_t height = GetTestArg(argc, argv, "--height", 1080);
+	const uint32_t frameCount = GetTestArg(argc, argv, "--frames", 32);
+	const uint32_t cpuCount = Thread::GetNumCPUCores();
+	const uint32_t workerCount = GetTestArg(argc, argv, "--workers", cpuCount > 1 ? cpuCount - 1 : 1);
+	if (!width || !height || !frameCount || !workerCount)
+	{
+		printf("--width, --height, --frames and --workers must be greater than zero\n");
+		return EXIT_FAILURE;
+	}
+
+	if (!InitTestEnvironment("ScreenshotEncodeBenchmark"))
+		return EXIT_FAILURE;
+	fsSetPathForResourceDir(pSystemFileIO, RM_DEBUG, CAPTURE_DIR, "");
+
+	TestSwizzle();
+	TestQoi();
+
+	uint8_t* pReadback = (uint8_t*)tf_malloc((size_t)width * height * 4);
+	FillImage(pReadback, width, height, 4, 1);
+
+	ThreadSystem* pThreadSystem = NULL;
+	initThreadSystem(&pThreadSystem, workerCount, 0, true, "ScreenshotEncode");
+	printf("\n%u frames of %ux%u BGRA8 per format on %u workers:\n", frameCount, width, height, workerCount);
+	for (uint32_t format = 0; format < ENCODE_FORMAT_COUNT; ++format)
+		BenchmarkFormat(pThreadSystem, (EncodeFormat)format, pReadback, width, height, frameCount);
+	shutdownThreadSystem(pThreadSystem);
+
+	tf_free(pReadback);
+	return ExitTestEnvironment();
+}
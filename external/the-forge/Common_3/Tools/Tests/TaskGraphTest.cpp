@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Runs a synthetic layered DAG, 10k nodes by default, through a TaskGraph and through the equivalent ThreadSystem
+// code with a waitThreadSystemIdle barrier between layers, and compares the wall times.
+// Every node checks on entry that all of its dependencies already finished in the current submission, and the graph
+// is submitted several times to cover reuse. A small graph also runs on a ThreadSystem without workers.
+//
+// Options: --workers <n> --layers <n> --width <n> --work <average spin iterations per node> --iterations <n>
+
+#include "../../OS/Interfaces/IThread.h"
+#include "../../OS/Core/Atomics.h"
+#include "../../OS/Core/TaskGraph.h"
+
+#include "TestCommon.h"
+
+// Every RANGE_NODE_INTERVAL-th node is a range node of RANGE_NODE_SIZE indices
+static const uint32_t RANGE_NODE_INTERVAL = 10;
+static const uint32_t RANGE_NODE_SIZE = 16;
+
+struct DagNode
+{
+	struct Dag*     pDag;
+	uint32_t        mFirstDependency;
+	uint32_t        mNumDependencies;
+	uint32_t        mIndexCount;
+	uint32_t        mWork;
+	// Indices run over all submissions, a node finished submission s once it reached s * mIndexCount
+	tfrg_atomic32_t mFinishedIndices;
+};
+
+struct Dag
+{
+	DagNode*        pNodes;
+	uint32_t*       pDependencies;
+	uint32_t        mNumNodes;
+	uint32_t        mLayers;
+	uint32_t        mWidth;
+	// Submissions started so far, nodes compare their dependencies against it
+	uint32_t        mSubmission;
+	tfrg_atomic32_t mViolations;
+};
+
+static uint32_t gRandomState = 0x12345678u;
+
+static uint32_t NextRandom()
+{
+	gRandomState ^= gRandomState << 13;
+	gRandomState ^= gRandomState >> 17;
+	gRandomState ^= gRandomState << 5;
+	return gRandomState;
+}
+
+// Each node depends on one to three nodes of the previous layer, and sometimes on a node further back
+static void BuildDag(Dag* pDag, uint32_t layers, uint32_t width, uint32_t work)
+{
+	pDag->mLayers = layers;
+	pDag->mWidth = width;
+	pDag->mNumNodes = layers * width;
+	pDag->mSubmission = 0;
+	pDag->mViolations = 0;
+	pDag->pNodes = (DagNode*)tf_calloc(pDag->mNumNodes, sizeof(DagNode));
+	pDag->pDependencies = (uint32_t*)tf_calloc(pDag->mNumNodes * 4, sizeof(uint32_t));
+
+	uint32_t numDependencies = 0;
+	for (uint32_t i = 0; i < pDag->mNumNodes; ++i)
+	{
+		DagNode* pNode = &pDag->pNodes[i];
+		uint32_t layer = i / width;
+		pNode->pDag = pDag;
+		pNode->mFirstDependency = numDependencies;
+		pNode->mIndexCount = (i % RANGE_NODE_INTERVAL) == RANGE_NODE_INTERVAL - 1 ? RANGE_NODE_SIZE : 1;
+		// Uneven work is what makes layer barriers expensive
+		pNode->mWork = work ? NextRandom() % (2 * work) : 0;
+		if (!layer)
+			continue;
+
+		uint32_t count = 1 + NextRandom() % 3;
+		for (uint32_t j = 0; j < count; ++j)
+			pDag->pDependencies[numDependencies++] = (layer - 1) * width + NextRandom() % width;
+		if (NextRandom() % 4 == 0)
+			pDag->pDependencies[numDependencies++] = (NextRandom() % layer) * width + NextRandom() % width;
+		pNode->mNumDependencies = numDependencies - pNode->mFirstDependency;
+	}
+}
+
+static void DestroyDag(Dag* pDag)
+{
+	tf_free(pDag->pNodes);
+	tf_free(pDag->pDependencies);
+}
+
+static void DagNodeTask(void* pUser, uintptr_t)
+{
+	DagNode* pNode = (DagNode*)pUser;
+	Dag*     pDag = pNode->pDag;
+
+	for (uint32_t i = 0; i < pNode->mNumDependencies; ++i)
+	{
+		DagNode* pDependency = &pDag->pNodes[pDag->pDependencies[pNode->mFirstDependency + i]];
+		if (tfrg_atomic32_load_acquire(&pDependency->mFinishedIndices) != pDag->mSubmission * pDependency->mIndexCount)
+			tfrg_atomic32_add_relaxed(&pDag->mViolations, 1);
+	}
+
+	volatile uint32_t x = 0;
+	for (uint32_t i = 0; i < pNode->mWork; ++i)
+		x = x * 1664525u + 1013904223u;
+
+	tfrg_atomic32_add_relaxed(&pNode->mFinishedIndices, 1);
+}
+
+static void CheckSubmission(Dag* pDag, const char* pName)
+{
+	uint32_t unfinished = 0;
+	for (uint32_t i = 0; i < pDag->mNumNodes; ++i)
+		unfinished += pDag->pNodes[i].mFinishedIndices != pDag->mSubmission * pDag->pNodes[i].mIndexCount;
+	if (unfinished || pDag->mViolations)
+		printf("%s: submission %u, %u nodes unfinished, %u ran before a dependency finished\n", pName, pDag->mSubmission,
+			unfinished, (uint32_t)pDag->mViolations);
+	TEST_CHECK(unfinished == 0);
+	TEST_CHECK(pDag->mViolations == 0);
+}
+
+static TaskGraph* BuildTaskGraph(ThreadSystem* pSystem, Dag* pDag)
+{
+	TaskGraph* pGraph = NULL;
+	initTaskGraph(pSystem, &pGraph);
+	for (uint32_t i = 0; i < pDag->mNumNodes; ++i)
+	{
+		DagNode*      pNode = &pDag->pNodes[i];
+		TaskGraphNode node = pNode->mIndexCount > 1 ? addTaskGraphRangeNode(pGraph, DagNodeTask, pNode, pNode->mIndexCount)
+													: addTaskGraphNode(pGraph, DagNodeTask, pNode);
+		TEST_CHECK(node == i);
+	}
+	for (uint32_t i = 0; i < pDag->mNumNodes; ++i)
+	{
+		const DagNode* pNode = &pDag->pNodes[i];
+		for (uint32_t j = 0; j < pNode->mNumDependencies; ++j)
+			addTaskGraphEdge(pGraph, pDag->pDependencies[pNode->mFirstDependency + j], i);
+	}
+	return pGraph;
+}
+
+// Returns the wall time of the submission in nanoseconds
+static int64_t RunGraph(TaskGraph* pGraph, Dag* pDag)
+{
+	++pDag->mSubmission;
+	int64_t start = getNSec();
+	waitForTaskGroup(submitTaskGraph(pGraph));
+	int64_t elapsed = getNSec() - start;
+	CheckSubmission(pDag, "graph");
+	return elapsed;
+}
+
+static int64_t RunLayerBarriers(ThreadSystem* pSystem, Dag* pDag)
+{
+	++pDag->mSubmission;
+	int64_t start = getNSec();
+	for (uint32_t layer = 0; layer < pDag->mLayers; ++layer)
+	{
+		for (uint32_t i = layer * pDag->mWidth; i < (layer + 1) * pDag->mWidth; ++i)
+		{
+			DagNode* pNode = &pDag->pNodes[i];
+			if (pNode->mIndexCount > 1)
+				addThreadSystemRangeTask(pSystem, DagNodeTask, pNode, pNode->mIndexCount);
+			else
+				addThreadSystemTask(pSystem, DagNodeTask, pNode);
+		}
+		waitThreadSystemIdle(pSystem);
+	}
+	int64_t elapsed = getNSec() - start;
+	CheckSubmission(pDag, "barriers");
+	return elapsed;
+}
+
+static void RunNoWorkerTest()
+{
+	ThreadSystem* pSystem = NULL;
+	initThreadSystem(&pSystem, 0);
+
+	Dag dag = {};
+	BuildDag(&dag, 10, 10, 0);
+	TaskGraph* pGraph = BuildTaskGraph(pSystem, &dag);
+	for (uint32_t i = 0; i < 2; ++i)
+		RunGraph(pGraph, &dag);
+	shutdownTaskGraph(pGraph);
+	DestroyDag(&dag);
+
+	shutdownThreadSystem(pSystem);
+}
+
+int main(int argc, char** argv)
+{
+	if (!InitTestEnvironment("TaskGraphTest"))
+		return EXIT_FAILURE;
+
+	uint32_t workerCount = GetTestArg(argc, argv, "--workers", MAX_LOAD_THREADS);
+	uint32_t layers = max(GetTestArg(argc, argv, "--layers", 100), 1u);
+	uint32_t width = max(GetTestArg(argc, argv, "--width", 100), 1u);
+	uint32_t work = GetTestArg(argc, argv, "--work", 2000);
+	uint32_t iterations = max(GetTestArg(argc, argv, "--iterations", 5), 1u);
+
+	RunNoWorkerTest();
+
+	ThreadSystem* pSystem = NULL;
+	initThreadSystem(&pSystem, workerCount);
+
+	Dag dag = {};
+	BuildDag(&dag, layers, width, work);
+	TaskGraph* pGraph = BuildTaskGraph(pSystem, &dag);
+
+	// Both share the node states, so alternate them and keep counting submissions
+	int64_t graphTime = 0, barrierTime = 0;
+	for (uint32_t i = 0; i < iterations; ++i)
+	{
+		graphTime += RunGraph(pGraph, &dag);
+		barrierTime += RunLayerBarriers(pSystem, &dag);
+	}
+
+	printf("%u nodes in %u layers, %u workers, %u iterations\n", dag.mNumNodes, layers, getThreadSystemThreadCount(pSystem),
+		iterations);
+	printf("task graph      %9.3f ms\n", NsToMs(graphTime / iterations));
+	printf("layer barriers  %9.3f ms\n", NsToMs(barrierTime / iterations));
+
+	shutdownTaskGraph(pGraph);
+	DestroyDag(&dag);
+	shutdownThreadSystem(pSystem);
+
+	return ExitTestEnvironment();
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Setup shared by the tests and benchmarks in this folder. They link ForgeToolsOS, the OS layer without a renderer,
+// so they build and run on machines without a GPU. Include this header last, it pulls in IMemory.h.
+//
+// Every executable exits with 0 on success and 1 when a check failed, which is what ctest looks at. Benchmarks
+// also accept their problem sizes on the command line, ctest runs them with small sizes as smoke tests.
+
+#pragma once
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../OS/Interfaces/IFileSystem.h"
+#include "../../OS/Interfaces/ILog.h"
+#include "../../OS/Interfaces/ITime.h"
+
+#include "../../OS/Interfaces/IMemory.h"
+
+static uint32_t gTestFailures = 0;
+
+#define TEST_CHECK(cond)                                                             \
+	do                                                                               \
+	{                                                                                \
+		if (!(cond))                                                                 \
+		{                                                                            \
+			printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);          \
+			++gTestFailures;                                                         \
+		}                                                                            \
+	} while (0)
+
+static bool InitTestEnvironment(const char* pName, MemAllocBackend backend = MEM_ALLOC_BACKEND_SYSTEM)
+{
+	MemAllocDesc memDesc = {};
+	memDesc.pAppName = pName;
+	memDesc.mBackend = backend;
+	if (!MemAllocInit(&memDesc))
+	{
+		printf("ERROR: Failed to init the memory allocator\n");
+		return false;
+	}
+
+	FileSystemInitDesc fsDesc = {};
+	fsDesc.pAppName = pName;
+	if (!initFileSystem(&fsDesc))
+	{
+		printf("ERROR: Failed to init the file system\n");
+		return false;
+	}
+
+	// Logs go to the working directory, which ctest sets to the build directory
+	fsSetPathForResourceDir(pSystemFileIO, RM_DEBUG, RD_LOG, "");
+	Log::Init(pName);
+	return true;
+}
+
+// Returns the exit code of the executable
+static int ExitTestEnvironment()
+{
+	Log::Exit();
+	exitFileSystem();
+	MemAllocExit();
+
+	if (gTestFailures)
+		printf("%u check(s) failed\n", gTestFailures);
+	return gTestFailures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// Value of "--name <value>", or defaultValue when the option is missing
+static uint32_t GetTestArg(int argc, char** argv, const char* pName, uint32_t defaultValue)
+{
+	for (int i = 1; i + 1 < argc; ++i)
+	{
+		if (!strcmp(argv[i], pName))
+			return (uint32_t)strtoul(argv[i + 1], NULL, 10);
+	}
+	return defaultValue;
+}
+
+static bool HasTestFlag(int argc, char** argv, const char* pName)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], pName))
+			return true;
+	}
+	return false;
+}
+
+static double NsToMs(int64_t ns) { return ns / 1e6; }
+
+// Nearest rank percentile of sorted samples
+template <typename T>
+static T GetPercentile(const T* pSorted, size_t count, double percentile)
+{
+	if (!count)
+		return T();
+	size_t rank = (size_t)ceil(percentile / 100.0 * count);
+	return pSorted[(rank ? rank : 1) - 1];
+}
@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// CPU stage of texture loading at 1..N decode workers, the part the resource loader runs on its worker pool before
+// the copy thread records the upload: open the file, parse the header, transcode Basis files and read the texel
+// data into staging memory. The textures given on the command line are copied --copies times into a scratch folder,
+// so reads hit different files like a real scene would. Reports textures/s and MB/s of staging data per worker count.
+//
+// Usage: TextureDecodeBenchmark [--copies <n>] [--max-workers <n>] <file.dds|file.ktx|file.basis>...
+
+#include "../../OS/Interfaces/IThread.h"
+#include "../../OS/Core/Atomics.h"
+#include "../../OS/Core/ThreadSystem.h"
+
+#define TINYKTX_IMPLEMENTATION
+#include "../../OS/Core/TextureContainers.h"
+
+#include "TestCommon.h"
+
+static const ResourceDirectory SCRATCH_DIR = RD_OTHER_FILES;
+
+enum TextureFileType
+{
+	TEXTURE_FILE_DDS,
+	TEXTURE_FILE_KTX,
+	TEXTURE_FILE_BASIS,
+};
+
+struct TextureFile
+{
+	char            mName[64];
+	TextureFileType mType;
+};
+
+struct DecodeContext
+{
+	TextureFile*     pFiles;
+	tfrg_atomic64_t  mStagingBytes;
+	tfrg_atomic32_t  mFailures;
+};
+
+static bool GetFileType(const char* pPath, TextureFileType* pType)
+{
+	const char* pExt = strrchr(pPath, '.');
+	if (!pExt)
+		return false;
+	if (!strcmp(pExt, ".dds"))
+		*pType = TEXTURE_FILE_DDS;
+	else if (!strcmp(pExt, ".ktx"))
+		*pType = TEXTURE_FILE_KTX;
+	else if (!strcmp(pExt, ".basis"))
+		*pType = TEXTURE_FILE_BASIS;
+	else
+		return false;
+	return true;
+}
+
+// The inputs can live anywhere, so they are read with stdio and written into the scratch folder
+static void* ReadInput(const char* pPath, size_t* pSize)
+{
+	FILE* pFile = fopen(pPath, "rb");
+	if (!pFile)
+		return NULL;
+	fseek(pFile, 0, SEEK_END);
+	long size = ftell(pFile);
+	fseek(pFile, 0, SEEK_SET);
+	void* pData = size > 0 ? tf_malloc((size_t)size) : NULL;
+	if (pData && fread(pData, 1, (size_t)size, pFile) != (size_t)size)
+	{
+		tf_free(pData);
+		pData = NULL;
+	}
+	fclose(pFile);
+	*pSize = (size_t)size;
+	return pData;
+}
+
+static void DecodeTexture(void* pUser, uintptr_t index)
+{
+	DecodeContext*     pContext = (DecodeContext*)pUser;
+	const TextureFile& file = pContext->pFiles[index];
+
+	FileStream stream = {};
+	if (!fsOpenStreamFromPath(SCRATCH_DIR, file.mName, FM_READ_BINARY, &stream))
+	{
+		tfrg_atomic32_add_relaxed(&pContext->mFailures, 1);
+		return;
+	}
+
+	TextureDesc desc = {};
+	void*       pStaging = NULL;
+	uint32_t    stagingSize = 0;
+	bool        success = false;
+	switch (file.mType)
+	{
+	case TEXTURE_FILE_DDS:
+	case TEXTURE_FILE_KTX:
+		success = file.mType == TEXTURE_FILE_DDS ? loadDDSTextureDesc(&stream, &desc) : loadKTXTextureDesc(&stream, &desc);
+		if (success)
+		{
+			// The header parsers leave the stream at the texel data
+			stagingSize = (uint32_t)(fsGetStreamFileSize(&stream) - fsGetStreamSeekPosition(&stream));
+			pStaging = tf_malloc(stagingSize);
+			success = fsReadFromStream(&stream, pStaging, stagingSize) == stagingSize;
+		}
+		break;
+	case TEXTURE_FILE_BASIS:
+		success = loadBASISTextureDesc(&stream, &desc, &pStaging, &stagingSize);
+		break;
+	}
+	fsCloseStream(&stream);
+
+	if (success)
+		tfrg_atomic64_add_relaxed(&pContext->mStagingBytes, stagingSize);
+	else
+		tfrg_atomic32_add_relaxed(&pContext->mFailures, 1);
+	tf_free(pStaging);
+}
+
+int main(int argc, char** argv)
+{
+	if (!InitTestEnvironment("TextureDecodeBenchmark"))
+		return EXIT_FAILURE;
+
+	uint32_t copies = max(GetTestArg(argc, argv, "--copies", 16), 1u);
+	uint32_t maxWorkers = max(GetTestArg(argc, argv, "--max-workers", Thread::GetNumCPUCores()), 1u);
+	fsSetPathForResourceDir(pSystemFileIO, RM_DEBUG, SCRATCH_DIR, "");
+	basist::basisu_transcoder_init();
+
+	eastl::vector<TextureFile> files;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (argv[i][0] == '-')
+		{
+			++i;
+			continue;
+		}
+
+		TextureFile file = {};
+		size_t      size = 0;
+		void*       pData = GetFileType(argv[i], &file.mType) ? ReadInput(argv[i], &size) : NULL;
+		if (!pData)
+		{
+			printf("ERROR: Cannot read texture %s\n", argv[i]);
+			TEST_CHECK(pData);
+			continue;
+		}
+
+		const char* pExt = strrchr(argv[i], '.');
+		for (uint32_t c = 0; c < copies; ++c)
+		{
+			snprintf(file.mName, sizeof(file.mName), "TextureDecode%03u_%04u%s", i, c, pExt);
+			FileStream stream = {};
+			TEST_CHECK(fsOpenStreamFromPath(SCRATCH_DIR, file.mName, FM_WRITE_BINARY, &stream));
+			TEST_CHECK(fsWriteToStream(&stream, pData, size) == size);
+			fsCloseStream(&stream);
+			files.push_back(file);
+		}
+		tf_free(pData);
+	}
+
+	if (files.empty())
+	{
+		printf("ERROR: No textures given\n");
+		ExitTestEnvironment();
+		return EXIT_FAILURE;
+	}
+
+	printf("%u textures\n", (uint32_t)files.size());
+	double baseRate = 0.0;
+	for (uint32_t workers = 1; workers <= maxWorkers; ++workers)
+	{
+		ThreadSystem* pThreadSystem = NULL;
+		initThreadSystem(&pThreadSystem, workers);
+
+		DecodeContext context = {};
+		context.pFiles = files.data();
+		int64_t start = getNSec();
+		addThreadSystemRangeTask(pThreadSystem, DecodeTexture, &context, files.size());
+		waitThreadSystemIdle(pThreadSystem);
+		int64_t time = getNSec() - start;
+		shutdownThreadSystem(pThreadSystem);
+
+		TEST_CHECK(context.mFailures == 0);
+		double rate = files.size() / (time / 1e9);
+		baseRate = workers == 1 ? rate : baseRate;
+		printf("%2u workers  %8.1f textures/s  %8.1f MB/s  %5.2fx\n", workers, rate, context.mStagingBytes / 1e6 / (time / 1e9),
+			rate / baseRate);
+	}
+
+	return ExitTestEnvironment();
+}
@@ -0,0 +1,404 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Compares the work stealing ThreadSystem with the mutex protected task ring it replaced. RingThreadSystem below is
+// that scheduler, trimmed to what the benchmark calls. Measured:
+// - throughput of single tasks submitted from the main thread, in batches since the ring holds MAX_SYSTEM_TASKS
+// - throughput of range tasks
+// - throughput of tasks submitted from inside tasks, ThreadSystem only, the ring would overflow
+// - latency from submitting a task to an idle system until it starts running
+// Every run also checks that each task ran exactly once, including on a ThreadSystem created without workers.
+//
+// Options: --workers <n> --tasks <n> --latency-samples <n> --work <spin iterations per task>
+
+#include "../../OS/Interfaces/IThread.h"
+#include "../../OS/Core/Atomics.h"
+#include "../../OS/Core/ThreadSystem.h"
+
+#include "../../ThirdParty/OpenSource/EASTL/sort.h"
+#include "../../ThirdParty/OpenSource/EASTL/vector.h"
+
+#include "TestCommon.h"
+
+static const uint32_t BATCH_SIZE = 64;
+static const uint32_t RANGE_SIZE = 4096;
+
+static uint32_t gTaskWork = 0;
+
+/************************************************************************/
+// Previous scheduler
+/************************************************************************/
+struct RingTask
+{
+	TaskFunc  mTask;
+	void*     mUser;
+	uintptr_t mStart;
+	uintptr_t mEnd;
+};
+
+struct RingThreadSystem
+{
+	ThreadDesc        mThreadDescs[MAX_LOAD_THREADS];
+	ThreadHandle      mThread[MAX_LOAD_THREADS];
+	RingTask          mTasks[MAX_SYSTEM_TASKS];
+	uint32_t          mBegin, mEnd;
+	ConditionVariable mQueueCond;
+	Mutex             mQueueMutex;
+	uint32_t          mNumLoaders;
+	volatile bool     mRun;
+};
+
+// Takes one index off the front task, the queue mutex must be held
+static bool PopRingTask(RingThreadSystem* pSystem, RingTask* pTask)
+{
+	if (pSystem->mBegin == pSystem->mEnd)
+		return false;
+
+	*pTask = pSystem->mTasks[pSystem->mEnd];
+	if (pTask->mStart + 1 == pTask->mEnd)
+		pSystem->mEnd = (pSystem->mEnd + 1) % MAX_SYSTEM_TASKS;
+	else
+		++pSystem->mTasks[pSystem->mEnd].mStart;
+	return true;
+}
+
+static void RingThreadFunc(void* pData)
+{
+	RingThreadSystem* pSystem = (RingThreadSystem*)pData;
+	while (pSystem->mRun)
+	{
+		pSystem->mQueueMutex.Acquire();
+		while (pSystem->mRun && pSystem->mBegin == pSystem->mEnd)
+			pSystem->mQueueCond.Wait(pSystem->mQueueMutex);
+
+		RingTask task;
+		bool     found = PopRingTask(pSystem, &task);
+		pSystem->mQueueMutex.Release();
+		if (found)
+			task.mTask(task.mUser, task.mStart);
+	}
+}
+
+static RingThreadSystem* InitRingThreadSystem(uint32_t numWorkers)
+{
+	RingThreadSystem* pSystem = tf_new(RingThreadSystem);
+	pSystem->mQueueMutex.Init();
+	pSystem->mQueueCond.Init();
+	pSystem->mBegin = 0;
+	pSystem->mEnd = 0;
+	pSystem->mRun = true;
+	pSystem->mNumLoaders = numWorkers;
+	for (uint32_t i = 0; i < numWorkers; ++i)
+	{
+		pSystem->mThreadDescs[i].pFunc = RingThreadFunc;
+		pSystem->mThreadDescs[i].pData = pSystem;
+		pSystem->mThread[i] = create_thread(&pSystem->mThreadDescs[i]);
+	}
+	return pSystem;
+}
+
+static void ShutdownRingThreadSystem(RingThreadSystem* pSystem)
+{
+	pSystem->mQueueMutex.Acquire();
+	pSystem->mRun = false;
+	pSystem->mQueueMutex.Release();
+	pSystem->mQueueCond.WakeAll();
+	for (uint32_t i = 0; i < pSystem->mNumLoaders; ++i)
+		destroy_thread(pSystem->mThread[i]);
+	pSystem->mQueueCond.Destroy();
+	pSystem->mQueueMutex.Destroy();
+	tf_delete(pSystem);
+}
+
+static void AddRingTask(RingThreadSystem* pSystem, TaskFunc task, void* pUser, uintptr_t start, uintptr_t end)
+{
+	pSystem->mQueueMutex.Acquire();
+	pSystem->mTasks[pSystem->mBegin] = RingTask{ task, pUser, start, end };
+	pSystem->mBegin = (pSystem->mBegin + 1) % MAX_SYSTEM_TASKS;
+	ASSERT(pSystem->mBegin != pSystem->mEnd);
+	pSystem->mQueueMutex.Release();
+	pSystem->mQueueCond.WakeAll();
+}
+
+static bool AssistRingThreadSystem(RingThreadSystem* pSystem)
+{
+	pSystem->mQueueMutex.Acquire();
+	RingTask task;
+	bool     found = PopRingTask(pSystem, &task);
+	pSystem->mQueueMutex.Release();
+	if (found)
+		task.mTask(task.mUser, task.mStart);
+	return found;
+}
+
+/************************************************************************/
+// Both schedulers behind the same interface
+/************************************************************************/
+struct StealingScheduler
+{
+	ThreadSystem* pSystem;
+
+	void AddTask(TaskFunc task, void* pUser, uintptr_t index) { addThreadSystemTask(pSystem, task, pUser, index); }
+	void AddRange(TaskFunc task, void* pUser, uintptr_t count) { addThreadSystemRangeTask(pSystem, task, pUser, count); }
+	bool Assist() { return assistThreadSystem(pSystem); }
+};
+
+struct RingScheduler
+{
+	RingThreadSystem* pSystem;
+
+	void AddTask(TaskFunc task, void* pUser, uintptr_t index) { AddRingTask(pSystem, task, pUser, index, index + 1); }
+	void AddRange(TaskFunc task, void* pUser, uintptr_t count) { AddRingTask(pSystem, task, pUser, 0, count); }
+	bool Assist() { return AssistRingThreadSystem(pSystem); }
+};
+
+/************************************************************************/
+// Tasks
+/************************************************************************/
+struct CountingTaskData
+{
+	tfrg_atomic64_t  mDone;
+	tfrg_atomic32_t* pRuns;
+};
+
+static void DoTaskWork(uintptr_t index)
+{
+	// Something the compiler can not drop, stands in for the work of a real task
+	volatile uint32_t x = (uint32_t)index;
+	for (uint32_t i = 0; i < gTaskWork; ++i)
+		x = x * 1664525u + 1013904223u;
+}
+
+static void CountingTask(void* pUser, uintptr_t index)
+{
+	CountingTaskData* pData = (CountingTaskData*)pUser;
+	DoTaskWork(index);
+	if (pData->pRuns)
+		tfrg_atomic32_add_relaxed(&pData->pRuns[index], 1);
+	tfrg_atomic64_add_relaxed(&pData->mDone, 1);
+}
+
+struct NestedTaskData
+{
+	ThreadSystem*    pSystem;
+	CountingTaskData mChildren;
+	uint32_t         mChildrenPerTask;
+};
+
+static void NestedTask(void* pUser, uintptr_t index)
+{
+	NestedTaskData* pData = (NestedTaskData*)pUser;
+	for (uint32_t i = 0; i < pData->mChildrenPerTask; ++i)
+		addThreadSystemTask(pData->pSystem, CountingTask, &pData->mChildren, index * pData->mChildrenPerTask + i);
+}
+
+struct LatencyTaskData
+{
+	tfrg_atomic64_t mRunTime;
+};
+
+static void LatencyTask(void* pUser, uintptr_t)
+{
+	LatencyTaskData* pData = (LatencyTaskData*)pUser;
+	tfrg_atomic64_store_release(&pData->mRunTime, (uint64_t)getNSec());
+}
+
+template <typename Scheduler>
+static void WaitForTasks(Scheduler& scheduler, tfrg_atomic64_t* pDone, uint64_t count)
+{
+	while (tfrg_atomic64_load_acquire(pDone) < count)
+	{
+		if (!scheduler.Assist())
+			Thread::Sleep(0);
+	}
+}
+
+static tfrg_atomic32_t* AllocRuns(uint32_t count) { return (tfrg_atomic32_t*)tf_calloc(count, sizeof(tfrg_atomic32_t)); }
+
+static void CheckRuns(const char* pName, tfrg_atomic32_t* pRuns, uint32_t count)
+{
+	uint32_t wrong = 0;
+	for (uint32_t i = 0; i < count; ++i)
+		wrong += pRuns[i] != 1;
+	if (wrong)
+		printf("%s: %u tasks did not run exactly once\n", pName, wrong);
+	TEST_CHECK(wrong == 0);
+}
+
+/************************************************************************/
+// Benchmarks
+/************************************************************************/
+// Returns tasks per second
+template <typename Scheduler>
+static double RunBatchBenchmark(const char* pName, Scheduler& scheduler, uint32_t taskCount)
+{
+	tfrg_atomic32_t* pRuns = AllocRuns(taskCount);
+	CountingTaskData               data = { 0, pRuns };
+
+	int64_t start = getNSec();
+	for (uint32_t submitted = 0; submitted < taskCount;)
+	{
+		uint32_t batchEnd = min(submitted + BATCH_SIZE, taskCount);
+		for (; submitted < batchEnd; ++submitted)
+			scheduler.AddTask(CountingTask, &data, submitted);
+		WaitForTasks(scheduler, &data.mDone, submitted);
+	}
+	int64_t elapsed = getNSec() - start;
+
+	CheckRuns(pName, pRuns, taskCount);
+	tf_free((void*)pRuns);
+	return taskCount / (elapsed / 1e9);
+}
+
+// Returns indices per second
+template <typename Scheduler>
+static double RunRangeBenchmark(const char* pName, Scheduler& scheduler, uint32_t taskCount)
+{
+	tfrg_atomic32_t* pRuns = AllocRuns(RANGE_SIZE);
+	CountingTaskData               data = { 0, pRuns };
+	uint32_t                       rangeCount = max(taskCount / RANGE_SIZE, 1u);
+
+	int64_t start = getNSec();
+	for (uint32_t i = 0; i < rangeCount; ++i)
+	{
+		scheduler.AddRange(CountingTask, &data, RANGE_SIZE);
+		WaitForTasks(scheduler, &data.mDone, (uint64_t)(i + 1) * RANGE_SIZE);
+	}
+	int64_t elapsed = getNSec() - start;
+
+	uint32_t wrong = 0;
+	for (uint32_t i = 0; i < RANGE_SIZE; ++i)
+		wrong += pRuns[i] != rangeCount;
+	if (wrong)
+		printf("%s: %u range indices did not run once per range\n", pName, wrong);
+	TEST_CHECK(wrong == 0);
+	tf_free((void*)pRuns);
+	return (double)rangeCount * RANGE_SIZE / (elapsed / 1e9);
+}
+
+static double RunNestedBenchmark(ThreadSystem* pSystem, uint32_t taskCount)
+{
+	const uint32_t childrenPerTask = 32;
+	const uint32_t rootCount = max(taskCount / childrenPerTask, 1u);
+	const uint32_t childCount = rootCount * childrenPerTask;
+
+	tfrg_atomic32_t* pRuns = AllocRuns(childCount);
+	NestedTaskData                 data = { pSystem, { 0, pRuns }, childrenPerTask };
+	StealingScheduler              scheduler = { pSystem };
+
+	int64_t start = getNSec();
+	addThreadSystemRangeTask(pSystem, NestedTask, &data, rootCount);
+	WaitForTasks(scheduler, &data.mChildren.mDone, childCount);
+	int64_t elapsed = getNSec() - start;
+
+	CheckRuns("nested", pRuns, childCount);
+	tf_free((void*)pRuns);
+	return childCount / (elapsed / 1e9);
+}
+
+// Prints the median, 99th percentile and maximum in microseconds
+template <typename Scheduler>
+static void RunLatencyBenchmark(const char* pName, Scheduler& scheduler, uint32_t sampleCount)
+{
+	eastl::vector<int64_t> samples;
+	samples.reserve(sampleCount);
+	for (uint32_t i = 0; i < sampleCount; ++i)
+	{
+		// Let the workers go idle, that is the common case for a task submitted once per frame
+		Thread::Sleep(1);
+
+		LatencyTaskData data = { 0 };
+		int64_t         submitTime = getNSec();
+		scheduler.AddTask(LatencyTask, &data, 0);
+		// Do not assist, the latency of a worker picking the task up is what we are after
+		while (!tfrg_atomic64_load_acquire(&data.mRunTime))
+			Thread::Sleep(0);
+		samples.push_back((int64_t)data.mRunTime - submitTime);
+	}
+
+	eastl::sort(samples.begin(), samples.end());
+	printf("%-10s latency       p50 %8.1f us   p99 %8.1f us   max %8.1f us\n", pName,
+		GetPercentile(samples.data(), samples.size(), 50.0) / 1e3, GetPercentile(samples.data(), samples.size(), 99.0) / 1e3,
+		samples.back() / 1e3);
+}
+
+// Tasks must still run through the assist functions when the system has no workers
+static void RunNoWorkerTest(uint32_t taskCount)
+{
+	ThreadSystem* pSystem = NULL;
+	initThreadSystem(&pSystem, 0);
+	TEST_CHECK(getThreadSystemThreadCount(pSystem) == 0);
+
+	tfrg_atomic32_t* pRuns = AllocRuns(taskCount);
+	CountingTaskData               data = { 0, pRuns };
+	for (uint32_t i = 0; i < taskCount / 2; ++i)
+		addThreadSystemTask(pSystem, CountingTask, &data, i);
+	addThreadSystemRangeTask(pSystem, CountingTask, &data, taskCount / 2, taskCount);
+	waitThreadSystemIdle(pSystem);
+
+	TEST_CHECK(tfrg_atomic64_load_acquire(&data.mDone) == taskCount);
+	CheckRuns("no workers", pRuns, taskCount);
+	tf_free((void*)pRuns);
+	shutdownThreadSystem(pSystem);
+}
+
+int main(int argc, char** argv)
+{
+	if (!InitTestEnvironment("ThreadSystemBenchmark"))
+		return EXIT_FAILURE;
+
+	uint32_t workerCount = GetTestArg(argc, argv, "--workers", max(Thread::GetNumCPUCores() - 1, 1u));
+	uint32_t taskCount = GetTestArg(argc, argv, "--tasks", 200000);
+	uint32_t latencySamples = GetTestArg(argc, argv, "--latency-samples", 1000);
+	gTaskWork = GetTestArg(argc, argv, "--work", 0);
+	workerCount = min(max(workerCount, 1u), (uint32_t)MAX_LOAD_THREADS);
+
+	RunNoWorkerTest(min(taskCount, 10000u));
+
+	ThreadSystem* pStealingSystem = NULL;
+	initThreadSystem(&pStealingSystem, workerCount);
+	// initThreadSystem caps the worker count at the number of cores, give the ring the same number
+	workerCount = getThreadSystemThreadCount(pStealingSystem);
+	StealingScheduler stealing = { pStealingSystem };
+	printf("%u workers, %u tasks, %u spin iterations per task\n", workerCount, taskCount, gTaskWork);
+
+	double stealingBatch = RunBatchBenchmark("stealing", stealing, taskCount);
+	double stealingRange = RunRangeBenchmark("stealing", stealing, taskCount);
+	double stealingNested = RunNestedBenchmark(pStealingSystem, taskCount);
+	RunLatencyBenchmark("stealing", stealing, latencySamples);
+	shutdownThreadSystem(pStealingSystem);
+
+	RingThreadSystem* pRingSystem = InitRingThreadSystem(workerCount);
+	RingScheduler     ring = { pRingSystem };
+	double            ringBatch = RunBatchBenchmark("ring", ring, taskCount);
+	double            ringRange = RunRangeBenchmark("ring", ring, taskCount);
+	RunLatencyBenchmark("ring", ring, latencySamples);
+	ShutdownRingThreadSystem(pRingSystem);
+
+	printf("%-10s batched tasks %10.0f /s   range indices %10.0f /s   nested tasks %10.0f /s\n", "stealing", stealingBatch,
+		stealingRange, stealingNested);
+	printf("%-10s batched tasks %10.0f /s   range indices %10.0f /s\n", "ring", ringBatch, ringRange);
+
+	return ExitTestEnvironment();
+}
@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Measures the CPU time of building a UI frame with ImGui and uploading its geometry the way ImguiGUIDriver::draw does,
+// with and without mReuseUnchangedDrawData:
+// - a static UI and a UI whose first window shows a per frame counter, both built from the same widgets
+// - the upload goes to MAX_FRAMES slots of plain memory standing in for the mapped vertex and index buffers. A reused
+//   frame draws from the slot written last, a changed frame writes the least recently drawn slot
+// - with reuse, the static UI only uploads while ImGui settles its window sizes and the changing UI uploads every frame
+// - the slot drawn from always holds the geometry of the frame, with and without reuse
+//
+// Options: --windows <count> --widgets <per window> --frames <per pass> --passes <count>
+
+#include "../../../Middleware_3/UI/ImguiGeometry.h"
+
+#include "TestCommon.h"
+
+static const uint32_t MAX_FRAMES = 3;
+// ImGui sizes new windows over their first frames
+static const uint32_t SETTLE_FRAMES = 4;
+
+struct TestSlots
+{
+	uint8_t* pVertices;
+	uint8_t* pIndices;
+	uint64_t mVertexSlotSize;
+	uint64_t mIndexSlotSize;
+	uint32_t mSlot;
+	uint64_t mDrawCount;
+	uint64_t mSlotLastDraw[MAX_FRAMES];
+};
+
+struct TestResult
+{
+	double   mBuildMs;
+	double   mUploadMs;
+	uint32_t mUploads;
+	uint32_t mSettledUploads;
+	uint32_t mMismatches;
+	uint64_t mVertexSize;
+	uint64_t mIndexSize;
+};
+
+static void* Alloc(size_t size, void* pUserData) { return tf_malloc(size); }
+
+static void Dealloc(void* ptr, void* pUserData) { tf_free(ptr); }
+
+static void BuildFrame(uint32_t windowCount, uint32_t widgetCount, uint32_t frame, bool changing)
+{
+	ImGuiIO& io = ImGui::GetIO();
+	io.DisplaySize = float2(1920.0f, 1080.0f);
+	io.DeltaTime = 1.0f / 60.0f;
+	ImGui::NewFrame();
+
+	for (uint32_t w = 0; w < windowCount; ++w)
+	{
+		char title[32];
+		snprintf(title, sizeof(title), "Window %u", w);
+		ImGui::SetNextWindowPos(float2(10.0f + 230.0f * (w % 8), 10.0f + 520.0f * (w / 8 % 2)));
+		ImGui::SetNextWindowSize(float2(220.0f, 500.0f));
+		ImGui::Begin(title);
+		if (w == 0)
+			ImGui::Text("Frame %u", changing ? frame : 0);
+		for (uint32_t i = 0; i < widgetCount; ++i)
+		{
+			ImGui::PushID((int)i);
+			float value = (float)i / (float)widgetCount;
+			bool  checked = (i % 2) != 0;
+			switch (i % 4)
+			{
+			case 0: ImGui::Text("Item %u: %.3f", i, value); break;
+			case 1: ImGui::SliderFloat("Value", &value, 0.0f, 1.0f); break;
+			case 2: ImGui::Checkbox("Enabled", &checked); break;
+			default: ImGui::Button("Apply"); break;
+			}
+			ImGui::PopID();
+		}
+		ImGui::End();
+	}
+
+	ImGui::Render();
+}
+
+// Same slot choice as ImguiGUIDriver::draw
+static void Upload(TestSlots* pSlots, ImguiGeometryCache* pCache, const ImDrawData* pDrawData, bool reuseUnchanged, bool* pUploaded)
+{
+	uint64_t vertexSize = 0;
+	uint64_t indexSize = 0;
+	getImguiGeometrySize(pDrawData, &vertexSize, &indexSize);
+
+	bool reuse = false;
+	if (reuseUnchanged)
+		reuse = pCache->retain(pDrawData, vertexSize, indexSize);
+	else
+		pCache->invalidate();
+
+	if (!reuse)
+	{
+		pSlots->mSlot = 0;
+		for (uint32_t i = 1; i < MAX_FRAMES; ++i)
+			if (pSlots->mSlotLastDraw[i] < pSlots->mSlotLastDraw[pSlots->mSlot])
+				pSlots->mSlot = i;
+	}
+	pSlots->mSlotLastDraw[pSlots->mSlot] = ++pSlots->mDrawCount;
+
+	if (vertexSize && !reuse)
+		copyImguiGeometry(
+			pDrawData, 0, pSlots->pVertices + pSlots->mSlot * pSlots->mVertexSlotSize,
+			pSlots->pIndices + pSlots->mSlot * pSlots->mIndexSlotSize);
+	*pUploaded = !reuse;
+}
+
+static bool SlotHoldsDrawData(const TestSlots* pSlots, const ImDrawData* pDrawData)
+{
+	const uint8_t* pVertices = pSlots->pVertices + pSlots->mSlot * pSlots->mVertexSlotSize;
+	const uint8_t* pIndices = pSlots->pIndices + pSlots->mSlot * pSlots->mIndexSlotSize;
+	for (int n = 0; n < pDrawData->CmdListsCount; ++n)
+	{
+		const ImDrawList* pList = pDrawData->CmdLists[n];
+		const size_t      vertexSize = pList->VtxBuffer.size() * sizeof(ImDrawVert);
+		const size_t      indexSize = pList->IdxBuffer.size() * sizeof(ImDrawIdx);
+		if (memcmp(pVertices, pList->VtxBuffer.data(), vertexSize) || memcmp(pIndices, pList->IdxBuffer.data(), indexSize))
+			return false;
+		pVertices += vertexSize;
+		pIndices += indexSize;
+	}
+	return true;
+}
+
+static TestResult RunFrames(uint32_t windowCount, uint32_t widgetCount, uint32_t frameCount, bool changing, bool reuseUnchanged)
+{
+	ImGuiContext* pContext = ImGui::CreateContext();
+	ImGui::SetCurrentContext(pContext);
+	ImGuiIO& io = ImGui::GetIO();
+	unsigned char* pPixels = NULL;
+	int            width = 0;
+	int            height = 0;
+	io.Fonts->GetTexDataAsAlpha8(&pPixels, &width, &height);
+
+	TestSlots slots = {};
+	slots.mVertexSlotSize = 1024 * 1024 * sizeof(ImDrawVert);
+	slots.mIndexSlotSize = 1024 * 1024 * sizeof(ImDrawIdx);
+	slots.pVertices = (uint8_t*)tf_malloc(slots.mVertexSlotSize * MAX_FRAMES);
+	slots.pIndices = (uint8_t*)tf_malloc(slots.mIndexSlotSize * MAX_FRAMES);
+	ImguiGeometryCache cache;
+	cache.init();
+
+	TestResult result = {};
+	int64_t    buildNs = 0;
+	int64_t    uploadNs = 0;
+	for (uint32_t frame = 0; frame < frameCount; ++frame)
+	{
+		const int64_t start = getNSec();
+		BuildFrame(windowCount, widgetCount, frame, changing);
+		const int64_t built = getNSec();
+		const ImDrawData* pDrawData = ImGui::GetDrawData();
+		bool              uploaded = false;
+		Upload(&slots, &cache, pDrawData, reuseUnchanged, &uploaded);
+		const int64_t end = getNSec();
+		buildNs += built - start;
+		uploadNs += end - built;
+
+		result.mUploads += uploaded ? 1 : 0;
+		result.mSettledUploads += (uploaded && frame >= SETTLE_FRAMES) ? 1 : 0;
+		result.mMismatches += SlotHoldsDrawData(&slots, pDrawData) ? 0 : 1;
+		getImguiGeometrySize(pDrawData, &result.mVertexSize, &result.mIndexSize);
+		TEST_CHECK(result.mVertexSize <= slots.mVertexSlotSize && result.mIndexSize <= slots.mIndexSlotSize);
+	}
+	result.mBuildMs = NsToMs(buildNs) / frameCount;
+	result.mUploadMs = NsToMs(uploadNs) / frameCount;
+
+	cache.exit();
+	tf_free(slots.pIndices);
+	tf_free(slots.pVertices);
+	ImGui::DestroyContext(pContext);
+	return result;
+}
+
+int main(int argc, char** argv)
+{
+	const uint32_t windowCount = GetTestArg(argc, argv, "--windows", 8);
+	const uint32_t widgetCount = GetTestArg(argc, argv, "--widgets", 40);
+	const uint32_t frameCount = GetTestArg(argc, argv, "--frames", 200);
+	const uint32_t passCount = GetTestArg(argc, argv, "--passes", 2);
+	if (!windowCount || !widgetCount || frameCount <= SETTLE_FRAMES || !passCount)
+	{
+		printf("--windows, --widgets and --passes must be greater than zero, --frames greater than %u\n", SETTLE_FRAMES);
+		return EXIT_FAILURE;
+	}
+
+	if (!InitTestEnvironment("UIDrawBenchmark"))
+		return EXIT_FAILURE;
+
+	ImGui::SetAllocatorFunctions(Alloc, Dealloc);
+
+	printf("UI frame time in ms, %u windows of %u widgets, %u frames per pass:\n", windowCount, widgetCount, frameCount);
+	printf("  %4s %9s %6s %9s %9s %9s %8s %12s\n", "pass", "ui", "reuse", "build", "upload", "total", "uploads", "bytes/frame");
+	for (uint32_t pass = 0; pass < passCount; ++pass)
+	{
+		for (uint32_t changing = 0; changing < 2; ++changing)
+		{
+			for (uint32_t reuse = 0; reuse < 2; ++reuse)
+			{
+				const TestResult result = RunFrames(windowCount, widgetCount, frameCount, changing != 0, reuse != 0);
+				printf(
+					"  %4u %9s %6s %9.3f %9.3f %9.3f %8u %12llu\n", pass, changing ? "changing" : "static", reuse ? "on" : "off",
+					result.mBuildMs, result.mUploadMs, result.mBuildMs + result.mUploadMs, result.mUploads,
+					(unsigned long long)(result.mVertexSize + result.mIndexSize));
+
+				TEST_CHECK(result.mMismatches == 0);
+				if (reuse && !changing)
+					TEST_CHECK(result.mSettledUploads == 0);
+				else
+					TEST_CHECK(result.mUploads == frameCount);
+			}
+		}
+	}
+
+	return ExitTestEnvironment();
+}
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Checks the SIMD vertex packing kernels used by loadGeometry against the scalar ones and measures their throughput:
+// - texcoord half packing and octahedral direction packing produce the same bits for every source and destination stride,
+//   over random values, random bit patterns (NaN, infinity, denormals) and edge cases such as rounding ties and zero vectors
+// - element counts which are not a multiple of the vector width exercise the scalar tail
+// - bytes between the packed elements are left untouched
+// - vertices/sec of the scalar and the SIMD version of every kernel over a large synthetic mesh
+//
+// Options: --elements <count to compare per stride combination> --vertices <benchmark mesh size> --iterations <benchmark passes>
+
+#include "../../Renderer/VertexPacking.h"
+
+#include "TestCommon.h"
+
+#if defined(VERTEX_PACKING_AVX2)
+static const char* gSimdName = "AVX2";
+#elif defined(VERTEX_PACKING_SSE2)
+static const char* gSimdName = "SSE2";
+#elif defined(VERTEX_PACKING_NEON)
+static const char* gSimdName = "NEON";
+#else
+static const char* gSimdName = "none";
+#endif
+
+struct PackingKernel
+{
+	const char*     pName;
+	PackingFunction pScalar;
+	PackingFunction pSimd;
+	// Floats read per element
+	uint32_t        mComponents;
+};
+
+static const PackingKernel gKernels[] = {
+	{ "float2 to half2", util_pack_float2_to_half2_scalar, util_pack_float2_to_half2, 2 },
+	{ "float3 direction to octahedral unorm2x16", util_pack_float3_direction_to_half2_scalar, util_pack_float3_direction_to_half2, 3 },
+};
+
+static uint32_t gRandomState = 0x9E3779B9u;
+
+static uint32_t Random()
+{
+	gRandomState ^= gRandomState << 13;
+	gRandomState ^= gRandomState >> 17;
+	gRandomState ^= gRandomState << 5;
+	return gRandomState;
+}
+
+static float RandomFloat(float minValue, float maxValue) { return minValue + (maxValue - minValue) * (Random() >> 8) / 16777216.0f; }
+
+static float BitsToFloat(uint32_t bits)
+{
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+// Values where the conversions round, clamp, overflow or flush
+static const float gEdgeValues[] = {
+	0.0f, -0.0f, 1.0f, -1.0f, 0.5f, -0.5f, 2.0f, 65504.0f, 65520.0f, -65520.0f, 1e10f, -1e10f,
+	BitsToFloat(F32_HALF_MIN_NORMAL_BITS), BitsToFloat(F32_HALF_MIN_NORMAL_BITS - 1), BitsToFloat(F32_HALF_OVERFLOW_BITS),
+	BitsToFloat(F32_HALF_OVERFLOW_BITS + 1), BitsToFloat(F32_INF_BITS), BitsToFloat(F32_INF_BITS | 0x80000000u),
+	BitsToFloat(0x7FC00000u), BitsToFloat(0x7F800001u), BitsToFloat(0x00000001u), BitsToFloat(0x80400000u),
+	// unorm ties, (k + 0.5) / 65535 before the octahedral bias
+	0.5f / 65535.0f, 1.5f / 65535.0f, 32767.5f / 65535.0f, 65534.5f / 65535.0f,
+};
+
+enum ValueMode
+{
+	VALUE_MODE_RANDOM,
+	VALUE_MODE_BITS,
+	VALUE_MODE_EDGE,
+	VALUE_MODE_COUNT,
+};
+
+static const char* gValueModeNames[] = { "random values", "random bits", "edge cases" };
+
+static void FillSource(uint8_t* pSrc, uint32_t count, uint32_t srcStride, uint32_t components, ValueMode mode)
+{
+	for (uint32_t e = 0; e < count; ++e)
+	{
+		float* f = (float*)(pSrc + e * srcStride);
+		for (uint32_t c = 0; c < components; ++c)
+		{
+			switch (mode)
+			{
+			case VALUE_MODE_RANDOM: f[c] = RandomFloat(-2.0f, 2.0f); break;
+			case VALUE_MODE_BITS: f[c] = BitsToFloat(Random()); break;
+			default: f[c] = gEdgeValues[Random() % (sizeof(gEdgeValues) / sizeof(gEdgeValues[0]))]; break;
+			}
+		}
+		// Zero vectors take their own branch in the direction encode
+		if (mode == VALUE_MODE_EDGE && !(Random() % 16))
+			memset(f, 0, components * sizeof(float));
+	}
+}
+
+static void TestKernel(const PackingKernel& kernel, uint32_t elementCount)
+{
+	const uint32_t packedSize = sizeof(uint32_t);
+	const uint32_t srcStrides[] = { kernel.mComponents * (uint32_t)sizeof(float), 16, 32, 44 };
+	const uint32_t dstStrides[] = { packedSize, 8, 20, 32 };
+	// The full count and a few counts leaving a tail for every vector width
+	const uint32_t counts[] = { elementCount, elementCount - 1, 7, 3, 1, 0 };
+
+	uint8_t* pSrc = (uint8_t*)tf_malloc((size_t)elementCount * 44);
+	uint8_t* pScalarDst = (uint8_t*)tf_malloc((size_t)elementCount * 32);
+	uint8_t* pSimdDst = (uint8_t*)tf_malloc((size_t)elementCount * 32);
+
+	uint32_t failures = 0;
+	for (uint32_t srcStride : srcStrides)
+	{
+		for (uint32_t dstStride : dstStrides)
+		{
+			for (uint32_t mode = 0; mode < VALUE_MODE_COUNT; ++mode)
+			{
+				for (uint32_t count : counts)
+				{
+					const size_t dstSize = (size_t)elementCount * dstStride;
+					FillSource(pSrc, elementCount, srcStride, kernel.mComponents, (ValueMode)mode);
+					memset(pScalarDst, 0xCD, dstSize);
+					memset(pSimdDst, 0xCD, dstSize);
+
+					kernel.pScalar(count, srcStride, dstStride, pSrc, pScalarDst);
+					kernel.pSimd(count, srcStride, dstStride, pSrc, pSimdDst);
+
+					if (memcmp(pScalarDst, pSimdDst, dstSize) == 0)
+						continue;
+
+					++failures;
+					for (uint32_t e = 0; e < elementCount; ++e)
+					{
+						uint32_t scalarValue, simdValue;
+						memcpy(&scalarValue, pScalarDst + e * dstStride, packedSize);
+						memcpy(&simdValue, pSimdDst + e * dstStride, packedSize);
+						if (scalarValue != simdValue)
+						{
+							const float* f = (const float*)(pSrc + e * srcStride);
+							printf("  %s: mismatch at %u/%u (src stride %u, dst stride %u, %s): %08x != %08x, source %08x %08x\n", kernel.pName,
+								   e, count, srcStride, dstStride, gValueModeNames[mode], simdValue, scalarValue, *(const uint32_t*)&f[0],
+								   *(const uint32_t*)&f[1]);
+							break;
+						}
+					}
+				}
+			}
+		}
+	}
+	TEST_CHECK(failures == 0);
+	printf("%-42s bit-exact over %u elements per stride combination: %s\n", kernel.pName, elementCount, failures ? "FAILED" : "ok");
+
+	tf_free(pSimdDst);
+	tf_free(pScalarDst);
+	tf_free(pSrc);
+}
+
+// Interleaved position, normal and texcoord like an unpacked glTF vertex stream, packed into a 16 byte vertex
+static void BenchmarkKernel(const PackingKernel& kernel, uint32_t vertexCount, uint32_t iterations)
+{
+	const uint32_t srcStride = 32;
+	const uint32_t dstStride = 16;
+	uint8_t* pSrc = (uint8_t*)tf_malloc((size_t)vertexCount * srcStride);
+	uint8_t* pDst = (uint8_t*)tf_malloc((size_t)vertexCount * dstStride);
+	FillSource(pSrc, vertexCount, srcStride, kernel.mComponents, VALUE_MODE_RANDOM);
+
+	double verticesPerSec[2] = {};
+	for (uint32_t simd = 0; simd < 2; ++simd)
+	{
+		PackingFunction pack = simd ? kernel.pSimd : kernel.pScalar;
+		// Warm the caches and page in the destination
+		pack(vertexCount, srcStride, dstStride, pSrc, pDst);
+
+		int64_t best = INT64_MAX;
+		for (uint32_t i = 0; i < iterations; ++i)
+		{
+			int64_t start = getNSec();
+			pack(vertexCount, srcStride, dstStride, pSrc, pDst);
+			int64_t time = getNSec() - start;
+			best = time < best ? time : best;
+		}
+		verticesPerSec[simd] = vertexCount / (best / 1e9);
+	}
+
+	printf("%-42s scalar %8.1f Mvertices/s, %s %8.1f Mvertices/s (%.2fx)\n", kernel.pName, verticesPerSec[0] / 1e6, gSimdName,
+		   verticesPerSec[1] / 1e6, verticesPerSec[1] / verticesPerSec[0]);
+
+	tf_free(pDst);
+	tf_free(pSrc);
+}
+
+int main(int argc, char** argv)
+{
+	const uint32_t elementCount = (uint32_t)GetTestArg(argc, argv, "--elements", 4096);
+	const uint32_t vertexCount = (uint32_t)GetTestArg(argc, argv, "--vertices", 4000000);
+	const uint32_t iterations = (uint32_t)GetTestArg(argc, argv, "--iterations", 10);
+	if (elementCount < 8 || !vertexCount || !iterations)
+	{
+		printf("--elements must be at least 8, --vertices and --iterations greater than zero\n");
+		return EXIT_FAILURE;
+	}
+
+	if (!InitTestEnvironment("VertexPackingTest"))
+		return EXIT_FAILURE;
+
+	printf("SIMD path: %s\n", gSimdName);
+	for (const PackingKernel& kernel : gKernels)
+		TestKernel(kernel, elementCount);
+
+	printf("\nBest of %u passes over %u vertices:\n", iterations, vertexCount);
+	for (const PackingKernel& kernel : gKernels)
+		BenchmarkKernel(kernel, vertexCount, iterations);
+
+	return ExitTestEnvironment();
+}
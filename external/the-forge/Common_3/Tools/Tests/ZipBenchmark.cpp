@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Open and read throughput of mounted zip archives. Writes two synthetic archives of 10k entries by default, one with
+// stored and one with deflated entries, then measures:
+// - mounting, which maps the archive and builds the hashed index
+// - opening every entry in random order, without reading it
+// - opening and reading every entry, entries/s and MB/s of uncompressed data
+// Every entry read is compared with the data it was written from.
+//
+// Options: --entries <n> --min-size <bytes> --max-size <bytes>
+
+#include "../../OS/Interfaces/IFileSystem.h"
+#define MINIZ_HEADER_FILE_ONLY
+#include "../../ThirdParty/OpenSource/zip/miniz.h"
+
+#include "TestCommon.h"
+
+// Archives are written to RD_OTHER_FILES, each one is mounted on its own resource directory since those cannot be unset
+static const ResourceDirectory ARCHIVE_DIR = RD_OTHER_FILES;
+
+static uint32_t gEntryCount = 10000;
+static uint32_t gMinSize = 512;
+static uint32_t gMaxSize = 8192;
+
+static uint32_t HashIndex(uint32_t x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+static uint32_t GetEntrySize(uint32_t index) { return gMinSize + HashIndex(index) % (gMaxSize - gMinSize + 1); }
+
+// Text like, so deflate has something to do
+static void FillEntry(uint32_t index, uint8_t* pData, uint32_t size)
+{
+	static const char* pWords[] = { "vertex ", "index ", "texture ", "sampler ", "buffer ", "shader ", "pipeline ", "\n" };
+	uint32_t           state = HashIndex(index + 1);
+	uint32_t           written = 0;
+	while (written < size)
+	{
+		state = state * 1664525u + 1013904223u;
+		const char* pWord = pWords[(state >> 24) % 8];
+		for (; *pWord && written < size; ++pWord)
+			pData[written++] = (uint8_t)*pWord;
+	}
+}
+
+static void GetEntryName(uint32_t index, char* pName, size_t size) { snprintf(pName, size, "dir%02u/entry%06u.txt", index % 64, index); }
+
+// miniz is built without malloc, same callbacks as zip.cpp
+static void* ZipAlloc(void*, size_t items, size_t size) { return tf_calloc(items, size); }
+static void  ZipFree(void*, void* address) { tf_free(address); }
+static void* ZipRealloc(void*, void* address, size_t items, size_t size) { return tf_realloc(address, items * size); }
+
+// The archive is built on the heap, zip_open cannot create files through the custom file IO
+static bool WriteArchive(const char* pFileName, mz_uint level)
+{
+	mz_zip_archive zip = {};
+	zip.m_pAlloc = ZipAlloc;
+	zip.m_pFree = ZipFree;
+	zip.m_pRealloc = ZipRealloc;
+	if (!mz_zip_writer_init_heap(&zip, 0, (size_t)gEntryCount * gMaxSize / 2))
+	{
+		printf("ERROR: Failed to create %s\n", pFileName);
+		return false;
+	}
+
+	uint8_t* pData = (uint8_t*)tf_malloc(gMaxSize);
+	bool     success = true;
+	for (uint32_t i = 0; i < gEntryCount && success; ++i)
+	{
+		char name[64];
+		GetEntryName(i, name, sizeof(name));
+		uint32_t size = GetEntrySize(i);
+		FillEntry(i, pData, size);
+		success = mz_zip_writer_add_mem(&zip, name, pData, size, level);
+	}
+	tf_free(pData);
+
+	void*  pArchive = NULL;
+	size_t archiveSize = 0;
+	success = success && mz_zip_writer_finalize_heap_archive(&zip, &pArchive, &archiveSize);
+	mz_zip_writer_end(&zip);
+
+	FileStream stream = {};
+	if (success && fsOpenStreamFromPath(ARCHIVE_DIR, pFileName, FM_WRITE_BINARY, &stream))
+	{
+		success = fsWriteToStream(&stream, pArchive, archiveSize) == archiveSize;
+		fsCloseStream(&stream);
+	}
+	else
+	{
+		success = false;
+	}
+	tf_free(pArchive);
+
+	if (!success)
+		printf("ERROR: Failed to write %s\n", pFileName);
+	return success;
+}
+
+static void BenchmarkArchive(
+	const char* pLabel, const char* pFileName, IFileSystem* pZipIO, ResourceDirectory mountDir, const uint32_t* pOrder)
+{
+	int64_t start = getNSec();
+	if (!fsOpenZipFile(ARCHIVE_DIR, pFileName, FM_READ_BINARY, pZipIO))
+	{
+		TEST_CHECK(!"fsOpenZipFile failed");
+		return;
+	}
+	int64_t mountTime = getNSec() - start;
+	fsSetPathForResourceDir(pZipIO, RM_CONTENT, mountDir, "");
+
+	char name[64];
+	start = getNSec();
+	uint32_t opened = 0;
+	for (uint32_t i = 0; i < gEntryCount; ++i)
+	{
+		GetEntryName(pOrder[i], name, sizeof(name));
+		FileStream stream = {};
+		if (fsOpenStreamFromPath(mountDir, name, FM_READ_BINARY, &stream))
+		{
+			opened += fsGetStreamFileSize(&stream) == (ssize_t)GetEntrySize(pOrder[i]);
+			fsCloseStream(&stream);
+		}
+	}
+	int64_t openTime = getNSec() - start;
+	TEST_CHECK(opened == gEntryCount);
+
+	uint8_t* pExpected = (uint8_t*)tf_malloc(gMaxSize);
+	uint8_t* pRead = (uint8_t*)tf_malloc(gMaxSize);
+	uint64_t bytes = 0;
+	uint32_t mismatches = 0;
+	int64_t  readTime = 0;
+	for (uint32_t i = 0; i < gEntryCount; ++i)
+	{
+		uint32_t index = pOrder[i];
+		uint32_t size = GetEntrySize(index);
+		GetEntryName(index, name, sizeof(name));
+
+		start = getNSec();
+		FileStream stream = {};
+		size_t     read = 0;
+		if (fsOpenStreamFromPath(mountDir, name, FM_READ_BINARY, &stream))
+		{
+			read = fsReadFromStream(&stream, pRead, size);
+			fsCloseStream(&stream);
+		}
+		readTime += getNSec() - start;
+
+		FillEntry(index, pExpected, size);
+		mismatches += read != size || memcmp(pExpected, pRead, size) != 0;
+		bytes += read;
+	}
+	tf_free(pExpected);
+	tf_free(pRead);
+	TEST_CHECK(mismatches == 0);
+
+	printf("%-9s mount %8.3f ms   open %9.0f entries/s   open+read %9.0f entries/s %8.1f MB/s\n", pLabel, NsToMs(mountTime),
+		gEntryCount / (openTime / 1e9), gEntryCount / (readTime / 1e9), bytes / 1e6 / (readTime / 1e9));
+}
+
+int main(int argc, char** argv)
+{
+	if (!InitTestEnvironment("ZipBenchmark"))
+		return EXIT_FAILURE;
+
+	gEntryCount = max(GetTestArg(argc, argv, "--entries", gEntryCount), 1u);
+	gMinSize = GetTestArg(argc, argv, "--min-size", gMinSize);
+	gMaxSize = max(GetTestArg(argc, argv, "--max-size", gMaxSize), gMinSize);
+	fsSetPathForResourceDir(pSystemFileIO, RM_DEBUG, ARCHIVE_DIR, "");
+
+	if (!WriteArchive("ZipBenchmarkStored.zip", MZ_NO_COMPRESSION) || !WriteArchive("ZipBenchmarkDeflated.zip", MZ_DEFAULT_LEVEL))
+	{
+		ExitTestEnvironment();
+		return EXIT_FAILURE;
+	}
+
+	// Random access order, lookups are what the hashed index is for
+	uint32_t* pOrder = (uint32_t*)tf_malloc(gEntryCount * sizeof(uint32_t));
+	for (uint32_t i = 0; i < gEntryCount; ++i)
+		pOrder[i] = i;
+	for (uint32_t i = gEntryCount - 1; i > 0; --i)
+	{
+		uint32_t j = HashIndex(i) % (i + 1);
+		uint32_t temp = pOrder[i];
+		pOrder[i] = pOrder[j];
+		pOrder[j] = temp;
+	}
+
+	printf("%u entries of %u to %u bytes\n", gEntryCount, gMinSize, gMaxSize);
+	IFileSystem storedIO = {};
+	IFileSystem deflatedIO = {};
+	BenchmarkArchive("stored", "ZipBenchmarkStored.zip", &storedIO, RD_MIDDLEWARE_0, pOrder);
+	BenchmarkArchive("deflated", "ZipBenchmarkDeflated.zip", &deflatedIO, RD_MIDDLEWARE_1, pOrder);
+	tf_free(pOrder);
+
+	fsCloseZipFile(&storedIO);
+	fsCloseZipFile(&deflatedIO);
+	return ExitTestEnvironment();
+}
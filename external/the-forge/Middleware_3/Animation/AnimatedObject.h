@@ -112,6 +112,12 @@ class AnimatedObject
 	// Set the root transform of the object
 	inline void SetRootTransform(const Matrix4& rootTransform) { mRootTransform = rootTransform; };
 
+	// Get the root transform of the object
+	inline const Matrix4& GetRootTransform() { return mRootTransform; };
+
+	// Get the animation being sampled
+	inline Animation* GetAnimation() { return mAnimation; };
+
 	// Get the rig of this animated object
 	inline Rig* GetRig() { return mRig; };
 
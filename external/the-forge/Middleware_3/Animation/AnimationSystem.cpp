@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+#include "AnimationSystem.h"
+
+#include "../../Common_3/ThirdParty/OpenSource/EASTL/sort.h"
+
+void AnimationSystem::Initialize(ThreadSystem* threadSystem)
+{
+	pThreadSystem = threadSystem;
+	mFrameIndex = 0;
+	mNumLODs = 0;
+}
+
+void AnimationSystem::Destroy()
+{
+	mObjects.set_capacity(0);
+	mSortedObjects.set_capacity(0);
+	mGroupStarts.set_capacity(0);
+}
+
+void AnimationSystem::AddObject(AnimatedObject* animatedObject)
+{
+	ASSERT(animatedObject);
+	ObjectState state = { animatedObject, 0.0f };
+	mObjects.push_back(state);
+}
+
+void AnimationSystem::RemoveObject(AnimatedObject* animatedObject)
+{
+	for (uint32_t i = 0; i < (uint32_t)mObjects.size(); ++i)
+	{
+		if (mObjects[i].pObject == animatedObject)
+		{
+			mObjects.erase(mObjects.begin() + i);
+			return;
+		}
+	}
+}
+
+void AnimationSystem::SetLODs(const AnimationLOD* lods, uint32_t numLods)
+{
+	ASSERT(numLods <= MAX_ANIMATION_LODS);
+	mNumLODs = min(numLods, (uint32_t)MAX_ANIMATION_LODS);
+	for (uint32_t i = 0; i < mNumLODs; ++i)
+	{
+		ASSERT(i == 0 || lods[i - 1].mDistance <= lods[i].mDistance);
+		mLODs[i] = lods[i];
+	}
+}
+
+bool AnimationSystem::Update(float dt)
+{
+	const uint32_t numObjects = (uint32_t)mObjects.size();
+	mDt = dt;
+	++mFrameIndex;
+	tfrg_atomic32_store_relaxed(&mSampledObjects, 0);
+	tfrg_atomic32_store_relaxed(&mFailedObjects, 0);
+
+	if (!numObjects)
+	{
+		mSampledObjectCount = 0;
+		return true;
+	}
+
+	// Animations can be swapped at any time so regroup every update, sorting a few thousand pointers is cheap
+	mSortedObjects.resize(numObjects);
+	for (uint32_t i = 0; i < numObjects; ++i)
+		mSortedObjects[i] = i;
+	const ObjectState* pObjects = mObjects.data();
+	eastl::sort(mSortedObjects.begin(), mSortedObjects.end(), [pObjects](uint32_t a, uint32_t b) {
+		return pObjects[a].pObject->GetAnimation() < pObjects[b].pObject->GetAnimation();
+	});
+
+	mGroupStarts.clear();
+	for (uint32_t i = 0; i < numObjects; ++i)
+	{
+		if (!i || pObjects[mSortedObjects[i]].pObject->GetAnimation() != pObjects[mSortedObjects[i - 1]].pObject->GetAnimation())
+			mGroupStarts.push_back(i);
+	}
+	mGroupStarts.push_back(numObjects);
+
+	const uint32_t numGroups = (uint32_t)mGroupStarts.size() - 1;
+	if (!pThreadSystem || numGroups == 1)
+	{
+		for (uint32_t i = 0; i < numGroups; ++i)
+			UpdateGroup(i);
+	}
+	else
+	{
+		tfrg_atomic32_store_relaxed(&mGroupsLeft, (int32_t)numGroups);
+		addThreadSystemRangeTask(pThreadSystem, UpdateGroupTask, this, numGroups);
+
+		// Help with the groups instead of blocking
+		while (tfrg_atomic32_load_acquire(&mGroupsLeft))
+		{
+			if (!assistThreadSystem(pThreadSystem))
+				Thread::Sleep(0);
+		}
+	}
+
+	mSampledObjectCount = (uint32_t)tfrg_atomic32_load_relaxed(&mSampledObjects);
+	return tfrg_atomic32_load_relaxed(&mFailedObjects) == 0;
+}
+
+void AnimationSystem::UpdateGroupTask(void* user, uintptr_t groupIndex)
+{
+	AnimationSystem* pSystem = (AnimationSystem*)user;
+	pSystem->UpdateGroup((uint32_t)groupIndex);
+	tfrg_atomic32_add_relaxed(&pSystem->mGroupsLeft, -1);
+}
+
+void AnimationSystem::UpdateGroup(uint32_t groupIndex)
+{
+	uint32_t sampled = 0;
+	uint32_t failed = 0;
+
+	for (uint32_t i = mGroupStarts[groupIndex]; i < mGroupStarts[groupIndex + 1]; ++i)
+	{
+		const uint32_t  objectIndex = mSortedObjects[i];
+		ObjectState&    state = mObjects[objectIndex];
+		AnimatedObject* pObject = state.pObject;
+
+		// Pick the sampling interval of the furthest LOD the object is in
+		uint32_t updateInterval = 1;
+		if (mNumLODs)
+		{
+			const float distSq = lengthSqr(pObject->GetRootTransform().getTranslation() - Vector3(mViewPosition));
+			for (uint32_t lod = 0; lod < mNumLODs && distSq >= mLODs[lod].mDistance * mLODs[lod].mDistance; ++lod)
+				updateInterval = max(mLODs[lod].mUpdateInterval, 1U);
+		}
+
+		state.mSkippedTime += mDt;
+
+		// Offset by the object index so objects of the same LOD do not all sample on the same frame
+		if ((mFrameIndex + objectIndex) % updateInterval == 0)
+		{
+			if (!pObject->Update(state.mSkippedTime))
+				++failed;
+			state.mSkippedTime = 0.0f;
+			++sampled;
+		}
+
+		pObject->PoseRig();
+	}
+
+	tfrg_atomic32_add_relaxed(&mSampledObjects, sampled);
+	if (failed)
+		tfrg_atomic32_add_relaxed(&mFailedObjects, failed);
+}
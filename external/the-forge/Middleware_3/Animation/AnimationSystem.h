@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+#pragma once
+
+#include "../../Common_3/OS/Interfaces/IThread.h"
+#include "../../Common_3/OS/Core/Atomics.h"
+#include "../../Common_3/OS/Core/ThreadSystem.h"
+
+#include "AnimatedObject.h"
+
+#define MAX_ANIMATION_LODS 4
+
+// Objects further than mDistance from the view position are sampled every mUpdateInterval frames
+struct AnimationLOD
+{
+	float    mDistance;
+	uint32_t mUpdateInterval;
+};
+
+// Updates many AnimatedObjects per frame, spreading sampling, blending, local to model conversion and posing
+// over the threads of a ThreadSystem. Distant objects can be sampled at a lower rate, they accumulate the
+// skipped time and are still posed every frame so they follow their root transform.
+class AnimationSystem
+{
+	public:
+	// Pass a NULL thread system to update all objects on the calling thread
+	void Initialize(ThreadSystem* pThreadSystem);
+
+	// Must be called to clean up the system if it has been initialized
+	void Destroy();
+
+	// Add an object to update. Objects sharing an Animation are updated one after the other on the same thread,
+	// since sampling advances the time of the animation's clip controllers.
+	void AddObject(AnimatedObject* animatedObject);
+
+	void RemoveObject(AnimatedObject* animatedObject);
+
+	// LODs must be sorted by increasing distance. Objects closer than the first LOD are sampled every frame.
+	void SetLODs(const AnimationLOD* lods, uint32_t numLods);
+
+	// Position the LOD distances are measured from, usually the camera
+	inline void SetViewPosition(const Point3& viewPosition) { mViewPosition = viewPosition; };
+
+	// Samples and poses all objects, returns once every object is done
+	bool Update(float dt);
+
+	// Number of objects sampled by the last update, the others only got posed
+	inline uint32_t GetSampledObjectCount() { return mSampledObjectCount; };
+
+	private:
+	struct ObjectState
+	{
+		AnimatedObject* pObject;
+		float           mSkippedTime;
+	};
+
+	static void UpdateGroupTask(void* user, uintptr_t groupIndex);
+
+	void UpdateGroup(uint32_t groupIndex);
+
+	ThreadSystem* pThreadSystem = NULL;
+
+	eastl::vector<ObjectState> mObjects;
+
+	// Object indices sorted by animation, each group is a run of objects sharing one animation
+	eastl::vector<uint32_t> mSortedObjects;
+	eastl::vector<uint32_t> mGroupStarts;
+
+	AnimationLOD mLODs[MAX_ANIMATION_LODS];
+	uint32_t     mNumLODs = 0;
+	Point3       mViewPosition = Point3(0.0f);
+
+	// Per update data read by the tasks
+	float           mDt = 0.0f;
+	uint32_t        mFrameIndex = 0;
+	uint32_t        mSampledObjectCount = 0;
+	tfrg_atomic32_t mGroupsLeft;
+	tfrg_atomic32_t mSampledObjects;
+	tfrg_atomic32_t mFailedObjects;
+};
@@ -84,6 +84,8 @@ void Rig::Pose(const Matrix4& rootTransform)
 		float minBoneLen = 0.f;
 		bool  minBoneLenSet = false;
 
+		const ozz::Range<const ozz::animation::Skeleton::JointProperties> jointProperties = mSkeleton.joint_properties();
+
 		// For each joint
 		for (unsigned int childIndex = 0; childIndex < mNumJoints; childIndex++)
 		{
@@ -96,7 +98,7 @@ void Rig::Pose(const Matrix4& rootTransform)
 			}
 
 			// Get the index of the parent of childIndex
-			const int parentIndex = mSkeleton.joint_properties()[childIndex].parent;
+			const int parentIndex = jointProperties[childIndex].parent;
 
 			// Selects joint matrices.
 			const mat4 parentMat = mJointModelMats[parentIndex];
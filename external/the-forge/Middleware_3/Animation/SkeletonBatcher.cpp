@@ -142,8 +142,14 @@ void SkeletonBatcher::SetPerInstanceUniforms(const uint32_t& frameIndex, int num
 	// For every rig
 	for (uint32_t rigIndex = rigsOffset; rigIndex < numRigs + rigsOffset; ++rigIndex)
 	{
+		Rig* pRig = mRigs[rigIndex];
+
 		// Get the number of joints in the rig
-		unsigned int numJoints = mRigs[rigIndex]->GetNumJoints();
+		unsigned int numJoints = pRig->GetNumJoints();
+
+		// Same for every joint of the rig
+		const Vector4 jointColor = pRig->GetJointColor();
+		const Vector4 boneColor = pRig->GetBoneColor();
 
 		// For every joint in the rig
 		for (unsigned int jointIndex = 0; jointIndex < numJoints; jointIndex++)
@@ -155,19 +161,23 @@ void SkeletonBatcher::SetPerInstanceUniforms(const uint32_t& frameIndex, int num
 			if (mDrawBones)
 			{
 				// add bones data to the uniform
-				uniformDataBones.mToWorldMat[instanceIndex] = mRigs[rigIndex]->GetBoneWorldMat(jointIndex);
-				uniformDataBones.mColor[instanceIndex] = mRigs[rigIndex]->GetBoneColor();
+				uniformDataBones.mToWorldMat[instanceIndex] = pRig->GetBoneWorldMat(jointIndex);
+				uniformDataBones.mColor[instanceIndex] = boneColor;
 
 				// add joint data to the uniform while scaling the joints by their determined chlid bone length
-				uniformDataJoints.mToWorldMat[instanceIndex] =
-					mRigs[rigIndex]->GetJointWorldMatNoScale(jointIndex) * mat4::scale(mRigs[rigIndex]->GetJointScale(jointIndex));
+				// scaling the columns directly saves a full matrix multiply
+				const Matrix4 jointMat = pRig->GetJointWorldMatNoScale(jointIndex);
+				const Vector3 jointScale = pRig->GetJointScale(jointIndex);
+				uniformDataJoints.mToWorldMat[instanceIndex] = Matrix4(
+					jointMat.getCol0() * jointScale.getX(), jointMat.getCol1() * jointScale.getY(), jointMat.getCol2() * jointScale.getZ(),
+					jointMat.getCol3());
 			}
 			else
 			{
 				// add joint data to the uniform without scaling
-				uniformDataJoints.mToWorldMat[instanceIndex] = mRigs[rigIndex]->GetJointWorldMatNoScale(jointIndex);
+				uniformDataJoints.mToWorldMat[instanceIndex] = pRig->GetJointWorldMatNoScale(jointIndex);
 			}
-			uniformDataJoints.mColor[instanceIndex] = mRigs[rigIndex]->GetJointColor();
+			uniformDataJoints.mColor[instanceIndex] = jointColor;
 
 			// increment the count of uniform data that has been filled for this batch
 			++instanceCount;
@@ -0,0 +1,323 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+#include "ArchetypeStorage.h"
+
+#include "../../Common_3/OS/Interfaces/ILog.h"
+
+#include "../../Common_3/OS/Interfaces/IMemory.h"    // Must be the last include in a cpp file
+
+// Chunks are cache line aligned so component arrays of aligned types stay aligned
+#define ARCHETYPE_CHUNK_ALIGNMENT 64
+
+struct ComponentDataTypeInfo
+{
+	uint32_t mSize;
+	uint32_t mAlignment;
+};
+
+static ComponentDataTypeInfo gComponentDataTypes[MAX_COMPONENT_DATA_TYPES];
+static tfrg_atomic32_t       gComponentDataTypeCount = 0;
+
+ComponentDataType registerComponentDataType(uint32_t size, uint32_t alignment)
+{
+	ComponentDataType type = (ComponentDataType)tfrg_atomic32_add_relaxed(&gComponentDataTypeCount, 1);
+	ASSERT(type < MAX_COMPONENT_DATA_TYPES && "Too many data component types");
+	ASSERT(alignment <= ARCHETYPE_CHUNK_ALIGNMENT);
+	gComponentDataTypes[type].mSize = size;
+	gComponentDataTypes[type].mAlignment = alignment;
+	return type;
+}
+
+void waitArchetypeQuery(ThreadSystem* pThreadSystem, tfrg_atomic32_t* pChunksLeft)
+{
+	while (tfrg_atomic32_load_acquire(pChunksLeft))
+	{
+		if (!assistThreadSystem(pThreadSystem))
+			Thread::Sleep(0);
+	}
+}
+
+static inline uint32_t alignOffset(uint32_t offset, uint32_t alignment) { return (offset + alignment - 1) & ~(alignment - 1); }
+
+static inline uint32_t countTrailingZeros(ComponentDataMask bits)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward64(&index, bits);
+	return (uint32_t)index;
+#else
+	return (uint32_t)__builtin_ctzll(bits);
+#endif
+}
+
+// Returns the end of the last component array for the given capacity
+static uint32_t layoutChunk(ComponentDataMask mask, uint32_t capacity, uint32_t* pOffsets)
+{
+	uint32_t offset = capacity * (uint32_t)sizeof(EntityId);
+	for (ComponentDataMask bits = mask; bits; bits &= bits - 1)
+	{
+		ComponentDataType type = (ComponentDataType)countTrailingZeros(bits);
+		offset = alignOffset(offset, gComponentDataTypes[type].mAlignment);
+		pOffsets[type] = offset;
+		offset += capacity * gComponentDataTypes[type].mSize;
+	}
+	return offset;
+}
+
+ArchetypeStorage::ArchetypeStorage()
+{
+	mMutex.Init();
+}
+
+ArchetypeStorage::~ArchetypeStorage()
+{
+	reset();
+	mMutex.Destroy();
+}
+
+void ArchetypeStorage::reset()
+{
+	MutexLock lock(mMutex);
+	for (Archetype* pArchetype : mArchetypes)
+	{
+		for (ArchetypeChunk& chunk : pArchetype->mChunks)
+			tf_free(chunk.pData);
+		tf_delete(pArchetype);
+	}
+	mArchetypes.set_capacity(0);
+	mArchetypeMap.clear(true);
+	mLocations.set_capacity(0);
+}
+
+Archetype* ArchetypeStorage::getArchetype(ComponentDataMask mask)
+{
+	eastl::hash_map<ComponentDataMask, Archetype*>::iterator it = mArchetypeMap.find(mask);
+	if (it != mArchetypeMap.end())
+		return it->second;
+
+	Archetype* pArchetype = tf_new(Archetype);
+	pArchetype->mMask = mask;
+
+	uint32_t rowSize = (uint32_t)sizeof(EntityId);
+	for (ComponentDataMask bits = mask; bits; bits &= bits - 1)
+		rowSize += gComponentDataTypes[countTrailingZeros(bits)].mSize;
+
+	// Start from the capacity ignoring padding and shrink until the aligned layout fits
+	uint32_t capacity = ARCHETYPE_CHUNK_SIZE / rowSize;
+	while (capacity > 1 && layoutChunk(mask, capacity, pArchetype->mColumnOffsets) > ARCHETYPE_CHUNK_SIZE)
+		--capacity;
+	ASSERT(capacity && layoutChunk(mask, capacity, pArchetype->mColumnOffsets) <= ARCHETYPE_CHUNK_SIZE && "Components do not fit in a chunk");
+	pArchetype->mChunkCapacity = capacity;
+
+	mArchetypes.push_back(pArchetype);
+	mArchetypeMap.insert(eastl::pair<ComponentDataMask, Archetype*>(mask, pArchetype));
+	return pArchetype;
+}
+
+void ArchetypeStorage::allocateRow(Archetype* pArchetype, EntityId id, EntityLocation* pLocation)
+{
+	if (pArchetype->mChunks.empty() || pArchetype->mChunks.back().mCount == pArchetype->mChunkCapacity)
+	{
+		ArchetypeChunk chunk = { (uint8_t*)tf_memalign(ARCHETYPE_CHUNK_ALIGNMENT, ARCHETYPE_CHUNK_SIZE), 0 };
+		pArchetype->mChunks.push_back(chunk);
+	}
+
+	ArchetypeChunk& chunk = pArchetype->mChunks.back();
+	pLocation->pArchetype = pArchetype;
+	pLocation->mChunk = (uint32_t)pArchetype->mChunks.size() - 1;
+	pLocation->mRow = chunk.mCount++;
+	((EntityId*)chunk.pData)[pLocation->mRow] = id;
+}
+
+void ArchetypeStorage::freeRow(Archetype* pArchetype, uint32_t chunkIndex, uint32_t row)
+{
+	// Fill the hole with the last row so every chunk but the last one stays full
+	ArchetypeChunk& last = pArchetype->mChunks.back();
+	uint32_t        lastChunkIndex = (uint32_t)pArchetype->mChunks.size() - 1;
+	uint32_t        lastRow = last.mCount - 1;
+	if (chunkIndex != lastChunkIndex || row != lastRow)
+	{
+		ArchetypeChunk& chunk = pArchetype->mChunks[chunkIndex];
+		EntityId        movedId = ((EntityId*)last.pData)[lastRow];
+		((EntityId*)chunk.pData)[row] = movedId;
+		for (ComponentDataMask bits = pArchetype->mMask; bits; bits &= bits - 1)
+		{
+			ComponentDataType type = (ComponentDataType)countTrailingZeros(bits);
+			uint32_t          size = gComponentDataTypes[type].mSize;
+			uint32_t          offset = pArchetype->mColumnOffsets[type];
+			memcpy(chunk.pData + offset + row * size, last.pData + offset + lastRow * size, size);
+		}
+
+		mLocations[movedId].mChunk = chunkIndex;
+		mLocations[movedId].mRow = row;
+	}
+
+	if (!--last.mCount)
+	{
+		tf_free(last.pData);
+		pArchetype->mChunks.pop_back();
+	}
+}
+
+void ArchetypeStorage::moveEntity(EntityId id, ComponentDataMask mask)
+{
+	EntityLocation& location = mLocations[id];
+	Archetype*      pOldArchetype = location.pArchetype;
+	EntityLocation  oldLocation = location;
+
+	if (mask)
+	{
+		Archetype* pNewArchetype = getArchetype(mask);
+		allocateRow(pNewArchetype, id, &location);
+
+		ArchetypeChunk& chunk = pNewArchetype->mChunks[location.mChunk];
+		for (ComponentDataMask bits = mask; bits; bits &= bits - 1)
+		{
+			ComponentDataType type = (ComponentDataType)countTrailingZeros(bits);
+			uint32_t          size = gComponentDataTypes[type].mSize;
+			uint8_t*          pDst = chunk.pData + pNewArchetype->mColumnOffsets[type] + location.mRow * size;
+			if (pOldArchetype && (pOldArchetype->mMask & ((ComponentDataMask)1 << type)))
+			{
+				const ArchetypeChunk& oldChunk = pOldArchetype->mChunks[oldLocation.mChunk];
+				memcpy(pDst, oldChunk.pData + pOldArchetype->mColumnOffsets[type] + oldLocation.mRow * size, size);
+			}
+			else
+			{
+				memset(pDst, 0, size);
+			}
+		}
+	}
+	else
+	{
+		location.pArchetype = NULL;
+	}
+
+	if (pOldArchetype)
+		freeRow(pOldArchetype, oldLocation.mChunk, oldLocation.mRow);
+}
+
+void ArchetypeStorage::reserveLocation(EntityId id)
+{
+	if ((uint32_t)id >= mLocations.size())
+	{
+		EntityLocation empty = { NULL, 0, 0 };
+		mLocations.resize(eastl::max((uint32_t)id + 1, (uint32_t)mLocations.size() * 2), empty);
+	}
+}
+
+void* ArchetypeStorage::addComponent(EntityId id, ComponentDataType type)
+{
+	ASSERT(id > 0);
+	MutexLock lock(mMutex);
+	reserveLocation(id);
+
+	const ComponentDataMask bit = (ComponentDataMask)1 << type;
+	Archetype*              pArchetype = mLocations[id].pArchetype;
+	const ComponentDataMask mask = pArchetype ? pArchetype->mMask : 0;
+	if (mask & bit)
+	{
+		ASSERT(0 && "component for entity already exist");
+	}
+	else
+	{
+		moveEntity(id, mask | bit);
+	}
+
+	const EntityLocation& location = mLocations[id];
+	const Archetype*      pNewArchetype = location.pArchetype;
+	return pNewArchetype->mChunks[location.mChunk].pData + pNewArchetype->mColumnOffsets[type] + location.mRow * gComponentDataTypes[type].mSize;
+}
+
+void ArchetypeStorage::removeComponent(EntityId id, ComponentDataType type)
+{
+	MutexLock lock(mMutex);
+
+	const ComponentDataMask bit = (ComponentDataMask)1 << type;
+	Archetype*              pArchetype = (uint32_t)id < mLocations.size() ? mLocations[id].pArchetype : NULL;
+	if (!pArchetype || !(pArchetype->mMask & bit))
+	{
+		ASSERT(0 && "entity does not have this component");
+		return;
+	}
+
+	moveEntity(id, pArchetype->mMask & ~bit);
+}
+
+void* ArchetypeStorage::getComponent(EntityId id, ComponentDataType type)
+{
+	if ((uint32_t)id >= mLocations.size())
+		return NULL;
+
+	const EntityLocation& location = mLocations[id];
+	const Archetype*      pArchetype = location.pArchetype;
+	if (!pArchetype || !(pArchetype->mMask & ((ComponentDataMask)1 << type)))
+		return NULL;
+
+	return pArchetype->mChunks[location.mChunk].pData + pArchetype->mColumnOffsets[type] + location.mRow * gComponentDataTypes[type].mSize;
+}
+
+void ArchetypeStorage::removeEntity(EntityId id)
+{
+	MutexLock lock(mMutex);
+	if ((uint32_t)id < mLocations.size() && mLocations[id].pArchetype)
+		moveEntity(id, 0);
+}
+
+void ArchetypeStorage::cloneEntity(EntityId srcId, EntityId dstId)
+{
+	ASSERT(dstId > 0);
+	MutexLock lock(mMutex);
+	if ((uint32_t)srcId >= mLocations.size() || !mLocations[srcId].pArchetype)
+		return;
+
+	reserveLocation(dstId);
+	ASSERT(!mLocations[dstId].pArchetype);
+
+	// Read the source location after allocating, the new row may be in a new chunk
+	Archetype* pArchetype = mLocations[srcId].pArchetype;
+	allocateRow(pArchetype, dstId, &mLocations[dstId]);
+	const EntityLocation& src = mLocations[srcId];
+	const EntityLocation& dst = mLocations[dstId];
+	for (ComponentDataMask bits = pArchetype->mMask; bits; bits &= bits - 1)
+	{
+		ComponentDataType type = (ComponentDataType)countTrailingZeros(bits);
+		uint32_t          size = gComponentDataTypes[type].mSize;
+		uint32_t          offset = pArchetype->mColumnOffsets[type];
+		memcpy(pArchetype->mChunks[dst.mChunk].pData + offset + dst.mRow * size,
+			   pArchetype->mChunks[src.mChunk].pData + offset + src.mRow * size, size);
+	}
+}
+
+void ArchetypeStorage::getChunks(ComponentDataMask mask, eastl::vector<ArchetypeChunkRef>& chunks)
+{
+	for (Archetype* pArchetype : mArchetypes)
+	{
+		if ((pArchetype->mMask & mask) != mask)
+			continue;
+
+		for (ArchetypeChunk& chunk : pArchetype->mChunks)
+			chunks.push_back({ pArchetype, &chunk });
+	}
+}
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+#pragma once
+
+#include "../../Common_3/OS/Interfaces/IThread.h"
+#include "../../Common_3/OS/Core/Atomics.h"
+#include "../../Common_3/OS/Core/ThreadSystem.h"
+
+#include "../../Common_3/ThirdParty/OpenSource/EASTL/hash_map.h"
+#include "../../Common_3/ThirdParty/OpenSource/EASTL/type_traits.h"
+#include "../../Common_3/ThirdParty/OpenSource/EASTL/vector.h"
+
+/* Data components:
+ * Plain data components stored by archetype. Entities with the same set of data components share an archetype which
+ * keeps them in fixed size chunks. A chunk holds the entity ids followed by one contiguous array per component type,
+ * so queries walk memory linearly instead of looking up a heap allocated component per entity.
+ *
+ * Data components must be trivially copyable: rows are moved with memcpy when an entity changes archetype and when
+ * the last row of an archetype fills the hole left by a removed one. Component pointers are therefore only valid until
+ * the next structural change (adding or removing components or entities). Structural changes are serialized with a
+ * mutex but queries and getComponent must not run concurrently with them.
+ */
+
+typedef int32_t EntityId;
+
+#define MAX_COMPONENT_DATA_TYPES 64
+#define ARCHETYPE_CHUNK_SIZE (16 * 1024)
+
+typedef uint32_t ComponentDataType;
+typedef uint64_t ComponentDataMask;
+
+ComponentDataType registerComponentDataType(uint32_t size, uint32_t alignment);
+
+template <typename T>
+ComponentDataType getComponentDataType()
+{
+	static_assert(eastl::is_trivially_copyable<T>::value, "Data components are moved with memcpy and must be trivially copyable");
+	static const ComponentDataType type = registerComponentDataType((uint32_t)sizeof(T), (uint32_t)alignof(T));
+	return type;
+}
+
+template <typename... T>
+ComponentDataMask getComponentDataMask()
+{
+	ComponentDataMask mask = 0;
+	int expand[] = { 0, ((mask |= (ComponentDataMask)1 << getComponentDataType<T>()), 0)... };
+	(void)expand;
+	return mask;
+}
+
+struct ArchetypeChunk
+{
+	uint8_t* pData;
+	uint32_t mCount;
+};
+
+struct Archetype
+{
+	ComponentDataMask             mMask;
+	uint32_t                      mChunkCapacity;
+	// Offset of each component array in a chunk, only valid for the types in mMask. Entity ids are at offset 0.
+	uint32_t                      mColumnOffsets[MAX_COMPONENT_DATA_TYPES];
+	// Every chunk but the last one is full
+	eastl::vector<ArchetypeChunk> mChunks;
+};
+
+struct ArchetypeChunkRef
+{
+	const Archetype* pArchetype;
+	ArchetypeChunk*  pChunk;
+};
+
+template <typename T>
+inline T* getArchetypeColumn(const Archetype* pArchetype, const ArchetypeChunk& chunk)
+{
+	return (T*)(chunk.pData + pArchetype->mColumnOffsets[getComponentDataType<T>()]);
+}
+
+inline const EntityId* getArchetypeEntities(const ArchetypeChunk& chunk) { return (const EntityId*)chunk.pData; }
+
+template <typename F, typename... T>
+inline void forEachArchetypeRow(F& func, uint32_t count, const EntityId* pIds, T*... pColumns)
+{
+	for (uint32_t i = 0; i < count; ++i)
+		func(pIds[i], pColumns[i]...);
+}
+
+class ArchetypeStorage
+{
+public:
+	ArchetypeStorage();
+	~ArchetypeStorage();
+
+	// Removes the data components of all entities
+	void reset();
+
+	// Moves the entity to the archetype including T and returns the zero initialized component
+	template <typename T> T& addComponent(EntityId id) { return *(T*)addComponent(id, getComponentDataType<T>()); }
+	template <typename T> void removeComponent(EntityId id) { removeComponent(id, getComponentDataType<T>()); }
+	// Returns NULL if the entity has no such component
+	template <typename T> T* getComponent(EntityId id) { return (T*)getComponent(id, getComponentDataType<T>()); }
+
+	void* addComponent(EntityId id, ComponentDataType type);
+	void  removeComponent(EntityId id, ComponentDataType type);
+	void* getComponent(EntityId id, ComponentDataType type);
+	// Removes all data components of the entity
+	void  removeEntity(EntityId id);
+	// Copies all data components of srcId to dstId, which must not have any yet
+	void  cloneEntity(EntityId srcId, EntityId dstId);
+
+	// Calls func(EntityId, T&...) for every entity having all the components T
+	template <typename... T, typename F> void forEach(F func);
+	// Same as forEach, with the chunks split over the threads of pThreadSystem. func is called concurrently.
+	template <typename... T, typename F> void parallelForEach(ThreadSystem* pThreadSystem, F func);
+
+	// Chunks of all archetypes including every component of mask
+	void getChunks(ComponentDataMask mask, eastl::vector<ArchetypeChunkRef>& chunks);
+
+	uint32_t getArchetypeCount() const { return (uint32_t)mArchetypes.size(); }
+
+private:
+	struct EntityLocation
+	{
+		Archetype* pArchetype;
+		uint32_t   mChunk;
+		uint32_t   mRow;
+	};
+
+	Archetype* getArchetype(ComponentDataMask mask);
+	void       allocateRow(Archetype* pArchetype, EntityId id, EntityLocation* pLocation);
+	void       freeRow(Archetype* pArchetype, uint32_t chunkIndex, uint32_t row);
+	void       moveEntity(EntityId id, ComponentDataMask mask);
+	void       reserveLocation(EntityId id);
+
+	Mutex                                          mMutex;
+	eastl::vector<Archetype*>                      mArchetypes;
+	eastl::hash_map<ComponentDataMask, Archetype*> mArchetypeMap;
+	// Indexed by entity id, entity ids are handed out by a counter so this stays dense
+	eastl::vector<EntityLocation>                  mLocations;
+};
+
+template <typename... T, typename F>
+void ArchetypeStorage::forEach(F func)
+{
+	const ComponentDataMask mask = getComponentDataMask<T...>();
+	for (Archetype* pArchetype : mArchetypes)
+	{
+		if ((pArchetype->mMask & mask) != mask)
+			continue;
+
+		for (ArchetypeChunk& chunk : pArchetype->mChunks)
+			forEachArchetypeRow(func, chunk.mCount, getArchetypeEntities(chunk), getArchetypeColumn<T>(pArchetype, chunk)...);
+	}
+}
+
+template <typename F>
+struct ArchetypeQueryTask
+{
+	F*                       pFunc;
+	const ArchetypeChunkRef* pChunks;
+	tfrg_atomic32_t          mChunksLeft;
+};
+
+template <typename F, typename... T>
+void archetypeQueryTaskFunc(void* user, uintptr_t index)
+{
+	ArchetypeQueryTask<F>*   pTask = (ArchetypeQueryTask<F>*)user;
+	const ArchetypeChunkRef& ref = pTask->pChunks[index];
+	forEachArchetypeRow(*pTask->pFunc, ref.pChunk->mCount, getArchetypeEntities(*ref.pChunk), getArchetypeColumn<T>(ref.pArchetype, *ref.pChunk)...);
+	tfrg_atomic32_add_relaxed(&pTask->mChunksLeft, -1);
+}
+
+// Helps the thread system until the counter drops to zero
+void waitArchetypeQuery(ThreadSystem* pThreadSystem, tfrg_atomic32_t* pChunksLeft);
+
+template <typename... T, typename F>
+void ArchetypeStorage::parallelForEach(ThreadSystem* pThreadSystem, F func)
+{
+	eastl::vector<ArchetypeChunkRef> chunks;
+	getChunks(getComponentDataMask<T...>(), chunks);
+	if (chunks.empty())
+		return;
+
+	ArchetypeQueryTask<F> task;
+	task.pFunc = &func;
+	task.pChunks = chunks.data();
+	tfrg_atomic32_store_relaxed(&task.mChunksLeft, (int32_t)chunks.size());
+	addThreadSystemRangeTask(pThreadSystem, archetypeQueryTaskFunc<F, T...>, &task, chunks.size());
+	waitArchetypeQuery(pThreadSystem, &task.mChunksLeft);
+}
@@ -136,9 +136,10 @@ void EntityManager::reset()
 		deleteEntity(entity.first);
 	}
 	mEntities.clear();
+	mComponentData.reset();
 
 	// Clear stale component pointers
-	for (eastl::pair<uint32_t, ComponentLookup> pair : mComponentViseMap)
+	for (eastl::pair<const uint32_t, ComponentLookup>& pair : mComponentViseMap)
 	{
 		pair.second.clear();
 	}
@@ -175,6 +176,7 @@ EntityId EntityManager::cloneEntity(EntityId id)
 		MutexLock entLock(mEntitiesMutex);
 		mEntities[newid] = new_entity;
 	}
+	mComponentData.cloneEntity(id, newid);
 	
 	return newid;
 }
@@ -196,6 +198,17 @@ void EntityManager::deleteEntity(EntityId id)
 		ASSERT(entities_iter != mEntities.end());
 		mEntities.erase(entities_iter);
 	}
+	{
+		// Drop the component pointers from the per type lookups before they are freed
+		MutexLock lock(mComponentMutex);
+		for (Entity::ComponentMap::iterator it = entity->mComponents.begin(); it != entity->mComponents.end(); ++it)
+		{
+			ComponentViseMap::iterator lookup = mComponentViseMap.find(it->first);
+			if (lookup != mComponentViseMap.end())
+				lookup->second.erase(id);
+		}
+	}
+	mComponentData.removeEntity(id);
 	entity->~Entity();
 	tf_free(entity);
 }
@@ -39,6 +39,7 @@ namespace FCR
 
 //class BaseComponent;
 #include "BaseComponent.h"
+#include "ArchetypeStorage.h"
 
 // An entity is collection of components.
 // An entity has a name.
@@ -157,6 +158,24 @@ public:
 		return *map;
 	}
 
+	// Plain data components stored in archetype chunks, see ArchetypeStorage.h.
+	// They live next to the BaseComponent ones and are meant for data iterated every frame.
+	template <typename T>
+	T& addComponentDataToEntity(EntityId id) { return mComponentData.addComponent<T>(id); }
+
+	template <typename T>
+	void removeComponentDataFromEntity(EntityId id) { mComponentData.removeComponent<T>(id); }
+
+	template <typename T>
+	T* getComponentData(EntityId id) { return mComponentData.getComponent<T>(id); }
+
+	// Calls func(EntityId, T&...) for every entity having all the data components T
+	template <typename... T, typename F>
+	void forEach(F func) { mComponentData.forEach<T...>(func); }
+
+	template <typename... T, typename F>
+	void parallelForEach(ThreadSystem* pThreadSystem, F func) { mComponentData.parallelForEach<T...>(pThreadSystem, func); }
+
 private:
 	Mutex mIdMutex;
 	Mutex mEntitiesMutex;
@@ -177,6 +196,7 @@ private:
 	/////////////////////////////////////////////////////////////////
 
 	ComponentViseMap mComponentViseMap;
+	ArchetypeStorage mComponentData;
 };
 
 
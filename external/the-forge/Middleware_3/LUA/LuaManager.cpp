@@ -60,22 +60,40 @@ bool LuaManager::RunScript(const char* scriptFile)
 	return m_Impl->RunScript(scriptFile);
 }
 
-void LuaManager::AddAsyncScript(const char* scriptFile, ScriptDoneCallback callback)
+ScriptHandle LuaManager::AddAsyncScript(const char* scriptFile, ScriptDoneCallback callback, ScriptCallbackThread callbackThread)
 {
 	ASSERT(m_Impl != nullptr);
-	m_Impl->AddAsyncScript(scriptFile, callback);
+	return m_Impl->AddAsyncScript(scriptFile, callback, callbackThread);
 }
 
-void LuaManager::AddAsyncScript(const char* scriptFile)
+ScriptHandle LuaManager::AddAsyncScript(const char* scriptFile)
 {
 	ASSERT(m_Impl != nullptr);
-	m_Impl->AddAsyncScript(scriptFile);
+	return m_Impl->AddAsyncScript(scriptFile);
 }
 
-void LuaManager::AddAsyncScript(const char* scriptFile, IScriptCallbackWrap* callbackLambda)
+ScriptHandle LuaManager::AddAsyncScript(const char* scriptFile, IScriptCallbackWrap* callbackLambda, ScriptCallbackThread callbackThread)
 {
 	ASSERT(m_Impl != nullptr);
-	m_Impl->AddAsyncScript(scriptFile, callbackLambda);
+	return m_Impl->AddAsyncScript(scriptFile, callbackLambda, callbackThread);
+}
+
+bool LuaManager::CancelAsyncScript(ScriptHandle handle)
+{
+	ASSERT(m_Impl != nullptr);
+	return m_Impl->CancelAsyncScript(handle);
+}
+
+void LuaManager::DispatchAsyncScriptCallbacks()
+{
+	ASSERT(m_Impl != nullptr);
+	m_Impl->DispatchAsyncScriptCallbacks();
+}
+
+void LuaManager::WaitAsyncScripts()
+{
+	ASSERT(m_Impl != nullptr);
+	m_Impl->WaitAsyncScripts();
 }
 
 bool LuaManager::SetUpdatableScript(const char* scriptFile, const char* updateFunctionName, const char* exitFunctionName)
@@ -45,11 +45,22 @@ class LuaManager
 	void SetFunction(const char* functionName, T function);
 
 	bool RunScript(const char* scriptFile);
-	void AddAsyncScript(const char* scriptFile, ScriptDoneCallback callback);
-	void AddAsyncScript(const char* scriptFile);
+	//Runs the script on one of the Lua worker threads.
+	//Returns INVALID_SCRIPT_HANDLE without calling the callback when MAX_LUA_ASYNC_SCRIPTS scripts are queued or running.
+	ScriptHandle AddAsyncScript(
+		const char* scriptFile, ScriptDoneCallback callback, ScriptCallbackThread callbackThread = SCRIPT_CALLBACK_THREAD_DISPATCH);
+	ScriptHandle AddAsyncScript(const char* scriptFile);
 
 	template <class T>
-	void AddAsyncScript(const char* scriptFile, T callbackLambda);
+	ScriptHandle AddAsyncScript(const char* scriptFile, T callbackLambda, ScriptCallbackThread callbackThread = SCRIPT_CALLBACK_THREAD_DISPATCH);
+
+	//A queued script does not start, a running one stops at its next instruction count hook.
+	//The callback is still called, with CANCELED. Returns false if the script already finished.
+	bool CancelAsyncScript(ScriptHandle handle);
+	//Calls the callbacks of finished scripts which use SCRIPT_CALLBACK_THREAD_DISPATCH
+	void DispatchAsyncScriptCallbacks();
+	//Blocks until all queued scripts finished, then dispatches their callbacks
+	void WaitAsyncScripts();
 
 	//updateFunctionName - function that will be called on Update()
 	bool SetUpdatableScript(const char* scriptFile, const char* updateFunctionName, const char* exitFunctionName);
@@ -62,7 +73,7 @@ class LuaManager
 	LuaManagerImpl* m_Impl;
 
 	void SetFunction(ILuaFunctionWrap* wrap);
-	void AddAsyncScript(const char* scriptFile, IScriptCallbackWrap* callbackLambda);
+	ScriptHandle AddAsyncScript(const char* scriptFile, IScriptCallbackWrap* callbackLambda, ScriptCallbackThread callbackThread);
 };
 
 template <typename T>
@@ -74,11 +85,11 @@ void LuaManager::SetFunction(const char* functionName, T function)
 }
 
 template <class T>
-void LuaManager::AddAsyncScript(const char* scriptFile, T callbackLambda)
+ScriptHandle LuaManager::AddAsyncScript(const char* scriptFile, T callbackLambda, ScriptCallbackThread callbackThread)
 {
 	IScriptCallbackWrap* lambdaWrap = (IScriptCallbackWrap*)tf_calloc(1, sizeof(ScriptCallbackWrap<T>));
 	tf_placement_new<ScriptCallbackWrap<T> >(lambdaWrap, callbackLambda);
-	AddAsyncScript(scriptFile, lambdaWrap);
+	return AddAsyncScript(scriptFile, lambdaWrap, callbackThread);
 }
 
 #include "../../Common_3/ThirdParty/OpenSource/FluidStudios/MemoryManager/nommgr.h"
@@ -33,8 +33,24 @@ enum ScriptState
 {
 	FINISHED_OK,
 	FINISHED_ERROR,
+	CANCELED,
 };
 
+// Thread on which the callback of an async script is called
+enum ScriptCallbackThread
+{
+	// LuaManager::DispatchAsyncScriptCallbacks, which LuaManager::Update calls as well
+	SCRIPT_CALLBACK_THREAD_DISPATCH,
+	// The worker which ran the script, right after it finished
+	SCRIPT_CALLBACK_THREAD_WORKER,
+};
+
+// Async scripts which can be queued or running at the same time
+#define MAX_LUA_ASYNC_SCRIPTS 256
+
+typedef uint32_t ScriptHandle;
+#define INVALID_SCRIPT_HANDLE 0
+
 typedef void (*ScriptDoneCallback)(ScriptState state);
 
 struct ILuaStateWrap
@@ -29,6 +29,7 @@
 #include "../../Common_3/ThirdParty/OpenSource/EASTL/string.h"
 #include "../../Common_3/OS/Interfaces/IFileSystem.h"
 #include "../../Common_3/OS/Interfaces/ICameraController.h"
+#include "../../Common_3/ThirdParty/OpenSource/murmurhash3/MurmurHash3_32.h"
 #include "../../Common_3/OS/Interfaces/IMemory.h"
 
 const char LuaManagerImpl::className[] = "LuaManager";
@@ -68,19 +69,52 @@ Luna<LuaManagerImpl>::PropertyType LuaManagerImpl::properties[] = { { NULL, NULL
 
 LuaManagerImpl::LuaManagerImpl(lua_State* L): m_SyncLuaState(nullptr) { memset(m_AsyncLuaStates, 0, MAX_LUA_WORKERS * sizeof(lua_State*)); }
 
-LuaManagerImpl::LuaManagerImpl(): m_SyncLuaState(nullptr), m_AsyncScriptsCounter(0)
+LuaManagerImpl::LuaManagerImpl(): m_SyncLuaState(nullptr)
 {
 	memset(m_AsyncLuaStates, 0, MAX_LUA_WORKERS * sizeof(lua_State*));
 
-	Register();
-	
-	for (uint32_t i = 0; i <  MAX_LUA_WORKERS; ++i)
-		m_AsyncLuaStatesMutex[i].Init();
+	m_AsyncLuaStatesMutex.Init();
+	m_AsyncLuaStatesCond.Init();
 	m_AddAsyncScriptMutex.Init();
+	m_BytecodeCacheMutex.Init();
+	m_DiskBytecodeCache = fsIsResourceDirectorySet(RD_SCRIPT_CACHE);
+
+	initThreadSystem(&m_AsyncThreadSystem, MAX_LUA_WORKERS, 0, true, "LuaWorker");
+	m_AsyncLuaStateCount = getThreadSystemThreadCount(m_AsyncThreadSystem);
+
+	memset(m_ScriptTasks, 0, sizeof(m_ScriptTasks));
+	for (uint32_t i = 0; i < MAX_LUA_ASYNC_SCRIPTS; ++i)
+	{
+		m_ScriptTasks[i].pManager = this;
+		m_ScriptTasks[i].generation = 1;
+		m_FreeScriptTasks[i] = MAX_LUA_ASYNC_SCRIPTS - 1 - i;
+	}
+	m_FreeScriptTaskCount = MAX_LUA_ASYNC_SCRIPTS;
+
+	Register();
 }
 
 LuaManagerImpl::~LuaManagerImpl()
 {
+	//Scripts which did not start yet are skipped, running ones stop at their next hook
+	{
+		MutexLock lock(m_AddAsyncScriptMutex);
+		for (uint32_t i = 0; i < MAX_LUA_ASYNC_SCRIPTS; ++i)
+		{
+			if (SCRIPT_TASK_QUEUED == m_ScriptTasks[i].status)
+				tfrg_atomic32_store_relaxed(&m_ScriptTasks[i].cancelRequested, 1);
+		}
+	}
+	waitThreadSystemIdle(m_AsyncThreadSystem);
+	shutdownThreadSystem(m_AsyncThreadSystem);
+	m_AsyncThreadSystem = nullptr;
+
+	//The application may already be gone, so callbacks which were not dispatched yet are dropped
+	for (size_t i = 0; i < m_FinishedScriptTasks.size(); ++i)
+		ReleaseScriptTask(&m_ScriptTasks[m_FinishedScriptTasks[i]]);
+	m_FinishedScriptTasks.set_capacity(0);
+	m_DispatchingScriptTasks.set_capacity(0);
+
 	DestroyLuaState(m_SyncLuaState);
 	m_SyncLuaState = nullptr;
 
@@ -92,7 +126,7 @@ LuaManagerImpl::~LuaManagerImpl()
 		m_UpdatableScriptLuaState = nullptr;
 	}
 
-	for (int i = 0; i < MAX_LUA_WORKERS; ++i)
+	for (uint32_t i = 0; i < m_AsyncLuaStateCount; ++i)
 	{
 		DestroyLuaState(m_AsyncLuaStates[i]);
 		m_AsyncLuaStates[i] = nullptr;
@@ -104,9 +138,10 @@ LuaManagerImpl::~LuaManagerImpl()
 		tf_free(m_Functions[i]);
 	}
 
-	for (uint32_t i = 0; i <  MAX_LUA_WORKERS; ++i)
-		m_AsyncLuaStatesMutex[i].Destroy();
+	m_AsyncLuaStatesMutex.Destroy();
+	m_AsyncLuaStatesCond.Destroy();
 	m_AddAsyncScriptMutex.Destroy();
+	m_BytecodeCacheMutex.Destroy();
 	
 	m_registered = false;
 }
@@ -141,33 +176,162 @@ static int msghandler(lua_State* L)
 	return 1; /* return the traceback */
 }
 
-const char* luaReaderFunction(lua_State *L, void *ud, size_t *sz)
+//Bytecode cache files start with this header, followed by the dumped chunk
+#define LUA_BYTECODE_MAGIC 0x424C4654 //"TFLB"
+#define LUA_BYTECODE_VERSION 1
+
+struct LuaBytecodeHeader
+{
+	uint32_t mMagic;
+	uint32_t mVersion;
+	uint64_t mSourceHash;
+	uint64_t mBytecodeSize;
+};
+
+static uint64_t HashScriptSource(const char* source, size_t size)
+{
+	uint32_t low = 0;
+	uint32_t high = 0;
+	MurmurHash3_x86_32(source, (int)size, 0, &low);
+	MurmurHash3_x86_32(source, (int)size, 0x9747b28c, &high);
+	return ((uint64_t)high << 32) | low;
+}
+
+static int luaBytecodeWriter(lua_State* L, const void* p, size_t sz, void* ud)
 {
-	FileStream* pHandle = (FileStream*)ud;
-	const size_t size = 1024;
-	static char buffer[size];
-	//*sz = read_file((void*)buffer, size, pHandle);
-	*sz = fsReadFromStream(pHandle, buffer, size);
-	return buffer;
+	eastl::vector<char>* pBytecode = (eastl::vector<char>*)ud;
+	pBytecode->insert(pBytecode->end(), (const char*)p, (const char*)p + sz);
+	return 0;
 }
 
-int RunScriptFile(const char* scriptFile, lua_State* L)
+//Scripts in subdirectories share one flat cache directory
+static void GetBytecodeCacheFileName(const char* scriptFile, char* outFileName)
 {
-	//int loadfile_error = luaL_loadfile(L, scriptFile);
-	lua_Reader reader = luaReaderFunction;
-    
+	size_t len = strlen(scriptFile);
+	ASSERT(len + 4 < FS_MAX_PATH);
+	for (size_t i = 0; i < len; ++i)
+		outFileName[i] = (scriptFile[i] == '/' || scriptFile[i] == '\\') ? '_' : scriptFile[i];
+	strcpy(outFileName + len, ".bc");
+}
+
+bool LuaManagerImpl::LoadBytecodeFromDisk(const char* scriptFile, uint64_t sourceHash, eastl::vector<char>& outBytecode)
+{
+	char fileName[FS_MAX_PATH] = {};
+	GetBytecodeCacheFileName(scriptFile, fileName);
+
 	FileStream fh = {};
-	
-    if (!fsOpenStreamFromPath(RD_SCRIPTS, scriptFile, FM_READ_BINARY, &fh))
-    {
-        return false;
-    }
-    
-	int loadfile_error = lua_load(L, reader, &fh, NULL, NULL);
-    fsCloseStream(&fh);
-	if (loadfile_error != 0)
-	{
-		LOGF(eERROR, "Can't load script %s\n", scriptFile);
+	if (!fsOpenStreamFromPath(RD_SCRIPT_CACHE, fileName, FM_READ_BINARY, &fh))
+		return false;
+
+	LuaBytecodeHeader header = {};
+	bool valid = fsReadFromStream(&fh, &header, sizeof(header)) == sizeof(header) && header.mMagic == LUA_BYTECODE_MAGIC &&
+				 header.mVersion == LUA_BYTECODE_VERSION && header.mSourceHash == sourceHash && header.mBytecodeSize > 0;
+	if (valid)
+	{
+		outBytecode.resize((size_t)header.mBytecodeSize);
+		valid = fsReadFromStream(&fh, outBytecode.data(), outBytecode.size()) == outBytecode.size();
+	}
+	fsCloseStream(&fh);
+	return valid;
+}
+
+void LuaManagerImpl::SaveBytecodeToDisk(const char* scriptFile, uint64_t sourceHash, const eastl::vector<char>& bytecode)
+{
+	char fileName[FS_MAX_PATH] = {};
+	GetBytecodeCacheFileName(scriptFile, fileName);
+
+	FileStream fh = {};
+	if (!fsOpenStreamFromPath(RD_SCRIPT_CACHE, fileName, FM_WRITE_BINARY, &fh))
+	{
+		LOGF(eWARNING, "Can't write bytecode cache for script %s", scriptFile);
+		return;
+	}
+
+	LuaBytecodeHeader header = {};
+	header.mMagic = LUA_BYTECODE_MAGIC;
+	header.mVersion = LUA_BYTECODE_VERSION;
+	header.mSourceHash = sourceHash;
+	header.mBytecodeSize = bytecode.size();
+	fsWriteToStream(&fh, &header, sizeof(header));
+	fsWriteToStream(&fh, bytecode.data(), bytecode.size());
+	fsCloseStream(&fh);
+}
+
+//Pushes the main chunk of the script. The source is always read so edits are picked up,
+//but it is only compiled when its hash does not match the cached bytecode.
+int LuaManagerImpl::LoadScriptChunk(lua_State* L, const char* scriptFile)
+{
+	FileStream fh = {};
+	if (!fsOpenStreamFromPath(RD_SCRIPTS, scriptFile, FM_READ_BINARY, &fh))
+		return LUA_ERRFILE;
+
+	ssize_t fileSize = fsGetStreamFileSize(&fh);
+	eastl::vector<char> source(fileSize > 0 ? (size_t)fileSize : 0);
+	size_t sourceSize = fsReadFromStream(&fh, source.data(), source.size());
+	fsCloseStream(&fh);
+
+	const uint64_t sourceHash = HashScriptSource(source.data(), sourceSize);
+	eastl::string chunkName("@");
+	chunkName.append(scriptFile);
+
+	eastl::vector<char> bytecode;
+	bool cached = false;
+	{
+		MutexLock lock(m_BytecodeCacheMutex);
+		eastl::unordered_map<eastl::string, LuaBytecodeEntry>::iterator it = m_BytecodeCache.find(scriptFile);
+		if (it != m_BytecodeCache.end() && it->second.mSourceHash == sourceHash)
+		{
+			bytecode = it->second.mBytecode;
+			cached = true;
+		}
+	}
+
+	if (!cached && m_DiskBytecodeCache && LoadBytecodeFromDisk(scriptFile, sourceHash, bytecode))
+	{
+		MutexLock lock(m_BytecodeCacheMutex);
+		LuaBytecodeEntry& entry = m_BytecodeCache[scriptFile];
+		entry.mSourceHash = sourceHash;
+		entry.mBytecode = bytecode;
+		cached = true;
+	}
+
+	if (cached)
+	{
+		if (luaL_loadbufferx(L, bytecode.data(), bytecode.size(), chunkName.c_str(), "b") == LUA_OK)
+			return LUA_OK;
+
+		//Bytecode from another Lua build, fall back to the source
+		LOGF(eWARNING, "Discarding cached bytecode of script %s: %s", scriptFile, lua_tostring(L, -1));
+		lua_pop(L, 1);
+	}
+
+	int status = luaL_loadbufferx(L, source.data(), sourceSize, chunkName.c_str(), "t");
+	if (status != LUA_OK)
+		return status;
+
+	bytecode.clear();
+	if (lua_dump(L, luaBytecodeWriter, &bytecode, 0) != 0 || bytecode.empty())
+		return LUA_OK;
+
+	MutexLock lock(m_BytecodeCacheMutex);
+	LuaBytecodeEntry& entry = m_BytecodeCache[scriptFile];
+	entry.mSourceHash = sourceHash;
+	entry.mBytecode.swap(bytecode);
+	if (m_DiskBytecodeCache)
+		SaveBytecodeToDisk(scriptFile, sourceHash, entry.mBytecode);
+	return LUA_OK;
+}
+
+bool LuaManagerImpl::RunScriptFile(const char* scriptFile, lua_State* L)
+{
+	int loadfile_error = LoadScriptChunk(L, scriptFile);
+	if (loadfile_error != LUA_OK)
+	{
+		if (loadfile_error != LUA_ERRFILE)
+		{
+			LOGF(eERROR, "Can't load script %s: %s\n", scriptFile, lua_tostring(L, -1));
+			lua_pop(L, 1);
+		}
 		return false;
 	}
 
@@ -212,22 +376,12 @@ bool LuaManagerImpl::SetUpdatableScript(const char* scriptFile, const char* upda
 	m_UpdateFunctonName = updateFunctionName;
     m_UpdatableScriptFile = scriptFile;
 	m_UpdatableScriptExitName = exitFunctionName;
-	//int loadfile_error = luaL_loadfile(m_UpdatableScriptLuaState, m_UpdatableScriptName.c_str());
-	lua_Reader reader = luaReaderFunction;
-	//int loadfile_error = lua_load(m_UpdatableScriptLuaState, reader, open_file(scriptFile, "rb"), NULL, NULL);
-    
-	FileStream fHandle = {};
-    if (!fsOpenStreamFromPath(RD_SCRIPTS, scriptFile, FM_READ_BINARY, &fHandle))
-    {
-        return false;
-    }
-    
-	int loadfile_error = lua_load(m_UpdatableScriptLuaState, reader, &fHandle, NULL, NULL);
-    fsCloseStream(&fHandle);
-    
-	if (loadfile_error != 0)
-	{
-		LOGF(eERROR, "Can't load script %s\n", scriptFile);
+	//Reloading only recompiles the script when its source changed
+	int loadfile_error = LoadScriptChunk(m_UpdatableScriptLuaState, scriptFile);
+	if (loadfile_error != LUA_OK)
+	{
+		if (loadfile_error != LUA_ERRFILE)
+			LOGF(eERROR, "Can't load script %s: %s\n", scriptFile, lua_tostring(m_UpdatableScriptLuaState, -1));
 		return false;
 	}
 	int narg = 0;
@@ -257,6 +411,8 @@ void LuaManagerImpl::RegisterFunctionsForState(lua_State* state)
 
 bool LuaManagerImpl::Update(float deltaTime, const char* updateFunctionName)
 {
+	DispatchAsyncScriptCallbacks();
+
 	int narg = 1;    //we are going to push "deltaTime"
 	int nres = 0;
 	int base = lua_gettop(m_UpdatableScriptLuaState) - narg; /* function index */
@@ -280,85 +436,200 @@ bool LuaManagerImpl::Update(float deltaTime, const char* updateFunctionName)
 
 bool LuaManagerImpl::RunScript(const char* scriptFile)
 {
-	int status = RunScriptFile(scriptFile, m_SyncLuaState);
-	return status == 0;
+	//RunScriptFile returns true on success
+	return RunScriptFile(scriptFile, m_SyncLuaState);
 }
 
-void AsyncScriptExecute(void* pData)
+static void CallScriptCallbacks(ScriptTaskInfo* info)
 {
-	ASSERT(pData != nullptr);
-	ScriptTaskInfo* info = (ScriptTaskInfo*)pData;
-	MutexLock       lock(*(info->mutex));
-	int             status = RunScriptFile(info->scriptFile, info->luaState);
 	if (info->callback)
 	{
-		info->callback(status == 0 ? FINISHED_OK : FINISHED_ERROR);
+		info->callback(info->resultState);
 	}
 	if (info->callbackLambda)
 	{
-		info->callbackLambda->ExecuteCallback(status == 0 ? FINISHED_OK : FINISHED_ERROR);
-		info->callbackLambda->~IScriptCallbackWrap();
-		tf_free(info->callbackLambda);
+		info->callbackLambda->ExecuteCallback(info->resultState);
 	}
-	info->~ScriptTaskInfo();           //call destructors of non-trivial members of the struct
-	memset(info, 0, sizeof(*info));    //set zeros just in case if someone will try to use released chunk of memory
-	tf_free(info);
 }
 
-void LuaManagerImpl::AddAsyncScript(const char* scriptFile, IScriptCallbackWrap* callbackLambda)
+//Count hook of the async states, stops the running script once it got canceled
+static void AsyncScriptCancelHook(lua_State* L, lua_Debug* ar)
 {
-	ScriptTaskInfo* info = (ScriptTaskInfo*)tf_calloc(1, sizeof(ScriptTaskInfo));
-	info->scriptFile = scriptFile;
-	info->callback = nullptr;
+	ScriptTaskInfo* info = *(ScriptTaskInfo**)lua_getextraspace(L);
+	if (info && tfrg_atomic32_load_relaxed(&info->cancelRequested))
+		luaL_error(L, "Script %s canceled", info->scriptFile);
+}
 
-	info->callbackLambda = callbackLambda;
+void LuaManagerImpl::AsyncScriptTask(void* pUser, uintptr_t taskIndex)
+{
+	LuaManagerImpl* pManager = (LuaManagerImpl*)pUser;
+	ScriptTaskInfo* info = &pManager->m_ScriptTasks[taskIndex];
 
-	//ThreadDesc* pItem = (ThreadDesc*)tf_calloc(1, sizeof(*pItem));
+	if (tfrg_atomic32_load_relaxed(&info->cancelRequested))
+	{
+		info->resultState = CANCELED;
+		pManager->FinishScriptTask(info);
+		return;
+	}
 
-	//pItem->pFunc = AsyncScriptExecute;
-	//pItem->pData = info;
+	uint32_t stateIndex = 0;
+	{
+		MutexLock lock(pManager->m_AsyncLuaStatesMutex);
+		while (!pManager->m_FreeAsyncLuaStateCount)
+			pManager->m_AsyncLuaStatesCond.Wait(pManager->m_AsyncLuaStatesMutex);
+		stateIndex = pManager->m_FreeAsyncLuaStates[--pManager->m_FreeAsyncLuaStateCount];
+	}
+
+	lua_State* state = pManager->m_AsyncLuaStates[stateIndex];
+	*(ScriptTaskInfo**)lua_getextraspace(state) = info;
+	lua_sethook(state, AsyncScriptCancelHook, LUA_MASKCOUNT, LUA_CANCEL_HOOK_INSTRUCTION_COUNT);
+	const bool succeeded = info->pManager->RunScriptFile(info->scriptFile, state);
+	lua_sethook(state, NULL, 0, 0);
+	*(ScriptTaskInfo**)lua_getextraspace(state) = NULL;
+	//Drop the error message a failed script leaves behind
+	lua_settop(state, 0);
 
 	{
-		MutexLock lock(m_AddAsyncScriptMutex);
-		info->luaState = m_AsyncLuaStates[m_AsyncScriptsCounter % MAX_LUA_WORKERS];
-		info->mutex = &m_AsyncLuaStatesMutex[m_AsyncScriptsCounter % MAX_LUA_WORKERS];
-		++m_AsyncScriptsCounter;
+		MutexLock lock(pManager->m_AsyncLuaStatesMutex);
+		pManager->m_FreeAsyncLuaStates[pManager->m_FreeAsyncLuaStateCount++] = stateIndex;
+		pManager->m_AsyncLuaStatesCond.WakeOne();
+	}
+
+	if (succeeded)
+		info->resultState = FINISHED_OK;
+	else
+		info->resultState = tfrg_atomic32_load_relaxed(&info->cancelRequested) ? CANCELED : FINISHED_ERROR;
+	pManager->FinishScriptTask(info);
+}
 
-		//for now we run scripts in synchronous way
-		//m_ThreadPool->AddWorkItem(pItem);
-		AsyncScriptExecute(info);
+void LuaManagerImpl::FinishScriptTask(ScriptTaskInfo* info)
+{
+	if (SCRIPT_CALLBACK_THREAD_WORKER == info->callbackThread)
+	{
+		CallScriptCallbacks(info);
+		ReleaseScriptTask(info);
+		return;
 	}
+
+	MutexLock lock(m_AddAsyncScriptMutex);
+	info->status = SCRIPT_TASK_FINISHED;
+	m_FinishedScriptTasks.push_back((uint32_t)(info - m_ScriptTasks));
 }
 
-void LuaManagerImpl::AddAsyncScript(const char* scriptFile, ScriptDoneCallback callback)
+void LuaManagerImpl::ReleaseScriptTask(ScriptTaskInfo* info)
 {
-	ScriptTaskInfo* info = (ScriptTaskInfo*)tf_calloc(1, sizeof(ScriptTaskInfo));
-    info->scriptFile = scriptFile;
+	if (info->callbackLambda)
+	{
+		info->callbackLambda->~IScriptCallbackWrap();
+		tf_free(info->callbackLambda);
+		info->callbackLambda = nullptr;
+	}
+	info->callback = nullptr;
+
+	MutexLock lock(m_AddAsyncScriptMutex);
+	info->status = SCRIPT_TASK_FREE;
+	++info->generation;
+	tfrg_atomic32_store_relaxed(&info->cancelRequested, 0);
+	m_FreeScriptTasks[m_FreeScriptTaskCount++] = (uint32_t)(info - m_ScriptTasks);
+}
+
+ScriptHandle LuaManagerImpl::AddAsyncScript(
+	const char* scriptFile, ScriptDoneCallback callback, IScriptCallbackWrap* callbackLambda, ScriptCallbackThread callbackThread)
+{
+	ScriptTaskInfo* info = nullptr;
+	{
+		MutexLock lock(m_AddAsyncScriptMutex);
+		if (m_FreeScriptTaskCount)
+		{
+			info = &m_ScriptTasks[m_FreeScriptTasks[--m_FreeScriptTaskCount]];
+			info->status = SCRIPT_TASK_QUEUED;
+		}
+	}
+
+	if (!info)
+	{
+		LOGF(eWARNING, "%u async scripts are already queued, %s is not run", MAX_LUA_ASYNC_SCRIPTS, scriptFile);
+		if (callbackLambda)
+		{
+			callbackLambda->~IScriptCallbackWrap();
+			tf_free(callbackLambda);
+		}
+		return INVALID_SCRIPT_HANDLE;
+	}
+
+	//The caller's string does not have to outlive the script
+	strncpy(info->scriptFile, scriptFile, FS_MAX_PATH - 1);
+	info->scriptFile[FS_MAX_PATH - 1] = 0;
 	info->callback = callback;
-	info->callbackLambda = nullptr;
-	//ThreadDesc* pItem = (ThreadDesc*)tf_calloc(1, sizeof(*pItem));
+	info->callbackLambda = callbackLambda;
+	info->callbackThread = callbackThread;
+	info->resultState = FINISHED_ERROR;
 
-	//pItem->pFunc = AsyncScriptExecute;
-	//pItem->pData = info;
+	const uint32_t     taskIndex = (uint32_t)(info - m_ScriptTasks);
+	const ScriptHandle handle = ((info->generation & 0xFFFF) << 16) | (taskIndex + 1);
+	addThreadSystemTask(m_AsyncThreadSystem, AsyncScriptTask, this, taskIndex);
+	return handle;
+}
+
+ScriptHandle LuaManagerImpl::AddAsyncScript(const char* scriptFile, IScriptCallbackWrap* callbackLambda, ScriptCallbackThread callbackThread)
+{
+	return AddAsyncScript(scriptFile, nullptr, callbackLambda, callbackThread);
+}
 
+ScriptHandle LuaManagerImpl::AddAsyncScript(const char* scriptFile, ScriptDoneCallback callback, ScriptCallbackThread callbackThread)
+{
+	return AddAsyncScript(scriptFile, callback, nullptr, callbackThread);
+}
+
+ScriptHandle LuaManagerImpl::AddAsyncScript(const char* scriptFile)
+{
+	return AddAsyncScript(scriptFile, nullptr, nullptr, SCRIPT_CALLBACK_THREAD_DISPATCH);
+}
+
+bool LuaManagerImpl::CancelAsyncScript(ScriptHandle handle)
+{
+	const uint32_t taskIndex = (handle & 0xFFFF) - 1;
+	if (INVALID_SCRIPT_HANDLE == handle || taskIndex >= MAX_LUA_ASYNC_SCRIPTS)
+		return false;
+
+	MutexLock       lock(m_AddAsyncScriptMutex);
+	ScriptTaskInfo* info = &m_ScriptTasks[taskIndex];
+	if (SCRIPT_TASK_QUEUED != info->status || (info->generation & 0xFFFF) != (handle >> 16))
+		return false;
+
+	tfrg_atomic32_store_relaxed(&info->cancelRequested, 1);
+	return true;
+}
+
+void LuaManagerImpl::DispatchAsyncScriptCallbacks()
+{
 	{
 		MutexLock lock(m_AddAsyncScriptMutex);
-		info->luaState = m_AsyncLuaStates[m_AsyncScriptsCounter % MAX_LUA_WORKERS];
-		info->mutex = &m_AsyncLuaStatesMutex[m_AsyncScriptsCounter % MAX_LUA_WORKERS];
-		++m_AsyncScriptsCounter;
-		//m_ThreadPool->AddWorkItem(pItem);
-		AsyncScriptExecute(info);
+		m_DispatchingScriptTasks.swap(m_FinishedScriptTasks);
+	}
+
+	//Callbacks may add new scripts, no lock is held while they run
+	for (size_t i = 0; i < m_DispatchingScriptTasks.size(); ++i)
+	{
+		ScriptTaskInfo* info = &m_ScriptTasks[m_DispatchingScriptTasks[i]];
+		CallScriptCallbacks(info);
+		ReleaseScriptTask(info);
 	}
+	m_DispatchingScriptTasks.clear();
 }
 
-void LuaManagerImpl::AddAsyncScript(const char* scriptFile)
+void LuaManagerImpl::WaitAsyncScripts()
 {
-	ScriptDoneCallback cb = nullptr;
-	AddAsyncScript(scriptFile, cb);
+	waitThreadSystemIdle(m_AsyncThreadSystem);
+	DispatchAsyncScriptCallbacks();
 }
 
 void LuaManagerImpl::SetFunction(ILuaFunctionWrap* wrap)
 {
+	//Async scripts may be calling the functions right now, let them finish first.
+	//This means SetFunction must not be called from an async script or a worker callback.
+	waitThreadSystemIdle(m_AsyncThreadSystem);
+
 	//1. Check if function is already registered
 	//Since this shouldn't be called often then just
 	//use string compare. We can implement more fast search if needed
@@ -379,11 +650,8 @@ void LuaManagerImpl::SetFunction(ILuaFunctionWrap* wrap)
 	//When LuaManagerImpl::SetUpdatableScript() is invoked all these functions will be registered in new state.
 	if (m_UpdatableScriptLuaState != nullptr)
 		Luna<LuaManagerImpl>::RegisterMethod(m_UpdatableScriptLuaState, wrap->functionName.c_str(), (int)m_Functions.size() - 1);
-	for (int i = 0; i < MAX_LUA_WORKERS; ++i)
-	{
-		MutexLock lock(m_AsyncLuaStatesMutex[i]);
+	for (uint32_t i = 0; i < m_AsyncLuaStateCount; ++i)
 		Luna<LuaManagerImpl>::RegisterMethod(m_AsyncLuaStates[i], wrap->functionName.c_str(), (int)m_Functions.size() - 1);
-	}
 }
 
 //allocate and free function. Used in lua_newstate and in lua_close
@@ -417,11 +685,13 @@ void LuaManagerImpl::Register()
 	m_SyncLuaState = CreateLuaState();
 	RegisterLuaManagerForLuaState(m_SyncLuaState);
 
-	for (int i = 0; i < MAX_LUA_WORKERS; ++i)
+	for (uint32_t i = 0; i < m_AsyncLuaStateCount; ++i)
 	{
 		m_AsyncLuaStates[i] = CreateLuaState();
 		RegisterLuaManagerForLuaState(m_AsyncLuaStates[i]);
+		m_FreeAsyncLuaStates[i] = i;
 	}
+	m_FreeAsyncLuaStateCount = m_AsyncLuaStateCount;
 
 	m_registered = true;
 }
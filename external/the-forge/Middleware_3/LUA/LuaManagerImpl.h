@@ -35,6 +35,7 @@ extern "C"
 
 #include "../../Common_3/ThirdParty/OpenSource/EASTL/string.h"
 #include "../../Common_3/ThirdParty/OpenSource/EASTL/vector.h"
+#include "../../Common_3/ThirdParty/OpenSource/EASTL/unordered_map.h"
 
 #include "../../Common_3/OS/Interfaces/ILog.h"
 #include "LunaV.hpp"
@@ -42,8 +43,13 @@ extern "C"
 
 #include "../../Common_3/OS/Interfaces/IFileSystem.h"
 #include "../../Common_3/OS/Interfaces/IThread.h"
+#include "../../Common_3/OS/Core/Atomics.h"
+#include "../../Common_3/OS/Core/ThreadSystem.h"
 
-#define MAX_LUA_WORKERS 4
+// One lua_State per worker thread of the async script ThreadSystem
+#define MAX_LUA_WORKERS MAX_LOAD_THREADS
+// Instructions between two checks for cancellation of a running async script
+#define LUA_CANCEL_HOOK_INSTRUCTION_COUNT 1000
 
 struct LuaStateWrap: public ILuaStateWrap
 {
@@ -60,13 +66,34 @@ struct LuaStateWrap: public ILuaStateWrap
 	lua_State* luaState;
 };
 
+enum ScriptTaskStatus
+{
+	SCRIPT_TASK_FREE,
+	SCRIPT_TASK_QUEUED,
+	SCRIPT_TASK_FINISHED,
+};
+
+class LuaManagerImpl;
+
+//Compiled chunk of a script, valid as long as the source hashes to mSourceHash
+struct LuaBytecodeEntry
+{
+	uint64_t            mSourceHash;
+	eastl::vector<char> mBytecode;
+};
+
 struct ScriptTaskInfo
 {
-	lua_State*           luaState;
-	Mutex*               mutex;
-    const char*          scriptFile;
+	LuaManagerImpl*      pManager;
 	ScriptDoneCallback   callback;
 	IScriptCallbackWrap* callbackLambda;
+	ScriptCallbackThread callbackThread;
+	ScriptState          resultState;
+	ScriptTaskStatus     status;
+	// Makes handles of earlier scripts which used the same slot invalid
+	uint32_t             generation;
+	tfrg_atomic32_t      cancelRequested;
+	char                 scriptFile[FS_MAX_PATH];
 };
 
 class LuaManagerImpl
@@ -75,9 +102,12 @@ class LuaManagerImpl
 	LuaManagerImpl();
 	~LuaManagerImpl();
 	bool RunScript(const char* scriptFile);
-	void AddAsyncScript(const char* scriptFile, ScriptDoneCallback callback);
-	void AddAsyncScript(const char* scriptFile);
-	void AddAsyncScript(const char* scriptFile, IScriptCallbackWrap* callbackLambda);
+	ScriptHandle AddAsyncScript(const char* scriptFile, ScriptDoneCallback callback, ScriptCallbackThread callbackThread);
+	ScriptHandle AddAsyncScript(const char* scriptFile);
+	ScriptHandle AddAsyncScript(const char* scriptFile, IScriptCallbackWrap* callbackLambda, ScriptCallbackThread callbackThread);
+	bool         CancelAsyncScript(ScriptHandle handle);
+	void         DispatchAsyncScriptCallbacks();
+	void         WaitAsyncScripts();
 
 	void SetFunction(ILuaFunctionWrap* wrap);
 
@@ -95,16 +125,33 @@ class LuaManagerImpl
 	lua_State*  m_UpdatableScriptLuaState;
 	lua_State*  m_SyncLuaState;
 	lua_State*  m_AsyncLuaStates[MAX_LUA_WORKERS];
-	Mutex       m_AsyncLuaStatesMutex[MAX_LUA_WORKERS];
-	Mutex       m_AddAsyncScriptMutex;
+
+	// Each worker takes a free state for the script it runs, there are as many states as workers
+	ThreadSystem*     m_AsyncThreadSystem;
+	uint32_t          m_AsyncLuaStateCount;
+	uint32_t          m_FreeAsyncLuaStates[MAX_LUA_WORKERS];
+	uint32_t          m_FreeAsyncLuaStateCount;
+	Mutex             m_AsyncLuaStatesMutex;
+	ConditionVariable m_AsyncLuaStatesCond;
+
+	// Guards the task slots and the finished list
+	Mutex                   m_AddAsyncScriptMutex;
+	ScriptTaskInfo          m_ScriptTasks[MAX_LUA_ASYNC_SCRIPTS];
+	uint32_t                m_FreeScriptTasks[MAX_LUA_ASYNC_SCRIPTS];
+	uint32_t                m_FreeScriptTaskCount;
+	eastl::vector<uint32_t> m_FinishedScriptTasks;
+	eastl::vector<uint32_t> m_DispatchingScriptTasks;
+
+	// Bytecode of every script loaded so far, by script file name. Mirrored to RD_SCRIPT_CACHE when that is set.
+	Mutex                                              m_BytecodeCacheMutex;
+	eastl::unordered_map<eastl::string, LuaBytecodeEntry> m_BytecodeCache;
+	bool                                               m_DiskBytecodeCache;
 
 	eastl::vector<ILuaFunctionWrap*> m_Functions;
 	eastl::string                    m_UpdateFunctonName;
 	const char*                      m_UpdatableScriptFile;
 	eastl::string                    m_UpdatableScriptExitName;
 
-	uint32_t m_AsyncScriptsCounter;
-
 	void       Register();
 	void       RegisterLuaManagerForLuaState(lua_State* state);
 	int        FunctionDispatch(int functionIndex, lua_State* state);
@@ -112,6 +159,15 @@ class LuaManagerImpl
 	void       DestroyLuaState(lua_State* state);
 	void       RegisterFunctionsForState(lua_State* state);
 	void       ExitScript(lua_State* state, const char* exitFunctionName);
+	int        LoadScriptChunk(lua_State* state, const char* scriptFile);
+	bool       RunScriptFile(const char* scriptFile, lua_State* state);
+	bool       LoadBytecodeFromDisk(const char* scriptFile, uint64_t sourceHash, eastl::vector<char>& outBytecode);
+	void       SaveBytecodeToDisk(const char* scriptFile, uint64_t sourceHash, const eastl::vector<char>& bytecode);
+
+	ScriptHandle AddAsyncScript(const char* scriptFile, ScriptDoneCallback callback, IScriptCallbackWrap* callbackLambda, ScriptCallbackThread callbackThread);
+	void         FinishScriptTask(ScriptTaskInfo* info);
+	void         ReleaseScriptTask(ScriptTaskInfo* info);
+	static void  AsyncScriptTask(void* pUser, uintptr_t taskIndex);
 
 	LuaManagerImpl(lua_State* L);
 	static const char                         className[];
@@ -23,8 +23,7 @@
 */
 
 #ifdef USE_TEXT_PRECOMPILED_SHADERS
-#include "Shaders/Compiled/fontstash2D.vert.h"
-#include "Shaders/Compiled/fontstash3D.vert.h"
+#include "Shaders/Compiled/fontstash.vert.h"
 #include "Shaders/Compiled/fontstash.frag.h"
 #endif
 
@@ -36,6 +35,7 @@
 
 #include "../../Common_3/ThirdParty/OpenSource/EASTL/vector.h"
 #include "../../Common_3/ThirdParty/OpenSource/EASTL/string.h"
+#include "../../Common_3/ThirdParty/OpenSource/EASTL/hash_map.h"
 
 #include "../../Common_3/OS/Interfaces/ILog.h"
 #include "../../Common_3/OS/Interfaces/IFileSystem.h"
@@ -48,23 +48,82 @@
 
 #include "../../Common_3/OS/Interfaces/IMemory.h"
 
+// Laid out strings kept for measuring and drawing, the cache is emptied when it is full
+#define FONTSTASH_LAYOUT_CACHE_SIZE 1024
+
+// Vertices are transformed to clip space on the CPU, so strings with different colors and transforms share a draw
+struct FontstashVertex
+{
+	float    mPosition[4];
+	float    mTexCoord[2];
+	uint32_t mColor;
+};
+
+// Consecutive queued strings using the same pipeline and atlas page
+struct FontstashDrawRun
+{
+	uint32_t mPipeline;
+	uint32_t mPage;
+	uint32_t mFirstVertex;
+	uint32_t mVertexCount;
+};
+
+// Glyph quads of a string laid out at the origin
+struct FontstashLayout
+{
+	uint32_t mFirstQuad;
+	uint32_t mQuadCount;
+	float    mAdvance;
+	float    mBounds[4];
+};
+
+// In-flight frames keep reading the pages they were recorded with, new glyphs are uploaded to a page none of them reads.
+// There is one page per frame in flight plus one, so glyphs can be added every frame without waiting for the GPU.
+struct FontstashAtlasPage
+{
+	Texture*  pTexture;
+	// Last two frames the page was drawn with
+	uint64_t  mUseFrame;
+	uint64_t  mPrevUseFrame;
+	// Part of the atlas changed since the last upload to the page, empty when mDirtyRect[0] >= mDirtyRect[2]
+	int       mDirtyRect[4];
+	// Last upload to the page, the page is drawn with once it completed
+	SyncToken mUploadToken;
+};
+
 class _Impl_FontStash
 {
 public:
 	_Impl_FontStash()
 	{
-		pCurrentTexture = {};
+		pPages = NULL;
+		mPageCount = 0;
+		mMaxFramesInFlight = 0;
+		mCurrentPage = 0;
+		mUploadPage = UINT32_MAX;
+		mFrame = 0;
+		mDeferredFrame = UINT64_MAX;
+		mFrameTracking = false;
+		mAtlasUploaded = false;
+		mStats = {};
 		mWidth = 0;
 		mHeight = 0;
 		pContext = NULL;
-
-		mText3D = false;
+		pBatchCmd = NULL;
+		mBatchDepth = 0;
 	}
 
-	bool init(Renderer* renderer, int width_, int height_, uint32_t ringSizeBytes)
+	bool init(Renderer* renderer, int width_, int height_, uint32_t ringSizeBytes, uint32_t maxFramesInFlight)
 	{
 		pRenderer = renderer;
 
+		ASSERT(maxFramesInFlight);
+		mMaxFramesInFlight = maxFramesInFlight;
+		mPageCount = maxFramesInFlight + 1;
+		pPages = (FontstashAtlasPage*)tf_calloc(mPageCount, sizeof(FontstashAtlasPage));
+		// Pages that were never drawn with are free from the first frame on
+		mFrame = maxFramesInFlight;
+
 		// create image
 		TextureDesc desc = {};
 		desc.mArraySize = 1;
@@ -77,10 +136,13 @@ public:
 		desc.mStartState = RESOURCE_STATE_COMMON;
 		desc.mWidth = width_;
 		desc.pName = "Fontstash Texture";
-		TextureLoadDesc loadDesc = {};
-		loadDesc.ppTexture = &pCurrentTexture;
-		loadDesc.pDesc = &desc;
-		addResource(&loadDesc, NULL);
+		for (uint32_t i = 0; i < mPageCount; ++i)
+		{
+			TextureLoadDesc loadDesc = {};
+			loadDesc.ppTexture = &pPages[i].pTexture;
+			loadDesc.pDesc = &desc;
+			addResource(&loadDesc, NULL);
+		}
 
 		// create FONS context
 		FONSparams params;
@@ -91,7 +153,8 @@ public:
 		params.renderCreate = fonsImplementationGenerateTexture;
 		params.renderUpdate = fonsImplementationModifyTexture;
 		params.renderDelete = fonsImplementationRemoveTexture;
-		params.renderDraw = fonsImplementationRenderText;
+		// Strings are laid out with the text iterator and drawn from the layout cache, fontstash never draws itself
+		params.renderDraw = NULL;
 		params.userPtr = this;
 
 		pContext = fonsCreateInternal(&params);
@@ -109,49 +172,37 @@ public:
 #ifdef USE_TEXT_PRECOMPILED_SHADERS
 		BinaryShaderDesc binaryShaderDesc = {};
 		binaryShaderDesc.mStages = SHADER_STAGE_VERT | SHADER_STAGE_FRAG;
-		binaryShaderDesc.mVert.mByteCodeSize = sizeof(gShaderFontstash2DVert);
-		binaryShaderDesc.mVert.pByteCode = (char*)gShaderFontstash2DVert;
+		binaryShaderDesc.mVert.mByteCodeSize = sizeof(gShaderFontstashVert);
+		binaryShaderDesc.mVert.pByteCode = (char*)gShaderFontstashVert;
 		binaryShaderDesc.mVert.pEntryPoint = "main";
 		binaryShaderDesc.mFrag.mByteCodeSize = sizeof(gShaderFontstashFrag);
 		binaryShaderDesc.mFrag.pByteCode = (char*)gShaderFontstashFrag;
 		binaryShaderDesc.mFrag.pEntryPoint = "main";
-		addShaderBinary(pRenderer, &binaryShaderDesc, &pShaders[0]);
-		binaryShaderDesc.mVert.mByteCodeSize = sizeof(gShaderFontstash3DVert);
-		binaryShaderDesc.mVert.pByteCode = (char*)gShaderFontstash3DVert;
-		binaryShaderDesc.mVert.pEntryPoint = "main";
-		addShaderBinary(pRenderer, &binaryShaderDesc, &pShaders[1]);
+		addShaderBinary(pRenderer, &binaryShaderDesc, &pShader);
 #else
-		ShaderLoadDesc text2DShaderDesc = {};
-		text2DShaderDesc.mStages[0] = { "fontstash2D.vert", NULL, 0, NULL };
-		text2DShaderDesc.mStages[1] = { "fontstash.frag", NULL, 0, NULL};
-		ShaderLoadDesc text3DShaderDesc = {};
-		text3DShaderDesc.mStages[0] = { "fontstash3D.vert", NULL, 0, NULL };
-		text3DShaderDesc.mStages[1] = { "fontstash.frag", NULL, 0, NULL };
-
-		addShader(pRenderer, &text2DShaderDesc, &pShaders[0]);
-		addShader(pRenderer, &text3DShaderDesc, &pShaders[1]);
+		ShaderLoadDesc textShaderDesc = {};
+		textShaderDesc.mStages[0] = { "fontstash.vert", NULL, 0, NULL };
+		textShaderDesc.mStages[1] = { "fontstash.frag", NULL, 0, NULL };
+		addShader(pRenderer, &textShaderDesc, &pShader);
 #endif
 
-		RootSignatureDesc textureRootDesc = { pShaders, 2 };
+		RootSignatureDesc textureRootDesc = { &pShader, 1 };
 		const char* pStaticSamplers[] = { "uSampler0" };
 		textureRootDesc.mStaticSamplerCount = 1;
 		textureRootDesc.ppStaticSamplerNames = pStaticSamplers;
 		textureRootDesc.ppStaticSamplers = &pDefaultSampler;
 		addRootSignature(pRenderer, &textureRootDesc, &pRootSignature);
 
-		addUniformGPURingBuffer(pRenderer, 65536, &pUniformRingBuffer, true);
-
-		uint64_t size = sizeof(mat4);
-		DescriptorSetDesc setDesc = { pRootSignature, DESCRIPTOR_UPDATE_FREQ_NONE, 2 };
+		// One set per atlas page
+		DescriptorSetDesc setDesc = { pRootSignature, DESCRIPTOR_UPDATE_FREQ_NONE, mPageCount };
 		addDescriptorSet(pRenderer, &setDesc, &pDescriptorSets);
-		DescriptorData setParams[2] = {};
-		setParams[0].pName = "uniformBlock_rootcbv";
-		setParams[0].ppBuffers = &pUniformRingBuffer->pBuffer;
-		setParams[0].pSizes = &size;
-		setParams[1].pName = "uTex0";
-		setParams[1].ppTextures = &pCurrentTexture;
-		updateDescriptorSet(pRenderer, 0, pDescriptorSets, 2, setParams);
-		updateDescriptorSet(pRenderer, 1, pDescriptorSets, 2, setParams);
+		for (uint32_t i = 0; i < mPageCount; ++i)
+		{
+			DescriptorData setParams[1] = {};
+			setParams[0].pName = "uTex0";
+			setParams[0].ppTextures = &pPages[i].pTexture;
+			updateDescriptorSet(pRenderer, i, pDescriptorSets, 1, setParams);
+		}
 
 		BufferDesc vbDesc = {};
 		vbDesc.mDescriptors = DESCRIPTOR_TYPE_VERTEX_BUFFER;
@@ -170,7 +221,9 @@ public:
 		// unload fontstash context
 		fonsDeleteInternal(pContext);
 
-		removeResource(pCurrentTexture);
+		for (uint32_t i = 0; i < mPageCount; ++i)
+			removeResource(pPages[i].pTexture);
+		tf_free(pPages);
 
 		// unload font buffers
 		for (unsigned int i = 0; i < (uint32_t)mFontBuffers.size(); i++)
@@ -179,22 +232,18 @@ public:
 		removeDescriptorSet(pRenderer, pDescriptorSets);
 		removeRootSignature(pRenderer, pRootSignature);
 
-		for (uint32_t i = 0; i < 2; ++i)
-		{
-			removeShader(pRenderer, pShaders[i]);
-		}
+		removeShader(pRenderer, pShader);
 
 		removeGPURingBuffer(pMeshRingBuffer);
-		removeGPURingBuffer(pUniformRingBuffer);
 		removeSampler(pRenderer, pDefaultSampler);
 	}
 
 	bool load(RenderTarget** pRts, uint32_t count, PipelineCache* pCache)
 	{
 		VertexLayout vertexLayout = {};
-		vertexLayout.mAttribCount = 2;
+		vertexLayout.mAttribCount = 3;
 		vertexLayout.mAttribs[0].mSemantic = SEMANTIC_POSITION;
-		vertexLayout.mAttribs[0].mFormat = TinyImageFormat_R32G32_SFLOAT;
+		vertexLayout.mAttribs[0].mFormat = TinyImageFormat_R32G32B32A32_SFLOAT;
 		vertexLayout.mAttribs[0].mBinding = 0;
 		vertexLayout.mAttribs[0].mLocation = 0;
 		vertexLayout.mAttribs[0].mOffset = 0;
@@ -205,6 +254,13 @@ public:
 		vertexLayout.mAttribs[1].mLocation = 1;
 		vertexLayout.mAttribs[1].mOffset = TinyImageFormat_BitSizeOfBlock(vertexLayout.mAttribs[0].mFormat) / 8;
 
+		vertexLayout.mAttribs[2].mSemantic = SEMANTIC_COLOR;
+		vertexLayout.mAttribs[2].mFormat = TinyImageFormat_R8G8B8A8_UNORM;
+		vertexLayout.mAttribs[2].mBinding = 0;
+		vertexLayout.mAttribs[2].mLocation = 2;
+		vertexLayout.mAttribs[2].mOffset =
+			vertexLayout.mAttribs[1].mOffset + TinyImageFormat_BitSizeOfBlock(vertexLayout.mAttribs[1].mFormat) / 8;
+
 		BlendStateDesc blendStateDesc = {};
 		blendStateDesc.mSrcFactors[0] = BC_SRC_ALPHA;
 		blendStateDesc.mDstFactors[0] = BC_ONE_MINUS_SRC_ALPHA;
@@ -245,7 +301,7 @@ public:
 		for (uint32_t i = 0; i < min(count, 2U); ++i)
 		{
 			pipelineDesc.mGraphicsDesc.mDepthStencilFormat = (i > 0) ? pRts[1]->mFormat : TinyImageFormat_UNDEFINED;
-			pipelineDesc.mGraphicsDesc.pShaderProgram = pShaders[i];
+			pipelineDesc.mGraphicsDesc.pShaderProgram = pShader;
 			pipelineDesc.mGraphicsDesc.pDepthState = &depthStateDesc[i];
 			pipelineDesc.mGraphicsDesc.pRasterizerState = &rasterizerStateDesc[i];
 			addPipeline(pRenderer, &pipelineDesc, &pPipelines[i]);
@@ -269,15 +325,31 @@ public:
 
 	static int  fonsImplementationGenerateTexture(void* userPtr, int width, int height);
 	static void fonsImplementationModifyTexture(void* userPtr, int* rect, const unsigned char* data);
-	static void fonsImplementationRenderText(void* userPtr, const float* verts, const float* tcoords, const unsigned int* colors, int nverts);
 	static void fonsImplementationRemoveTexture(void* userPtr);
 
+	void                   updateAtlas(Cmd* pCmd);
+	const FontstashLayout* getLayout(const char* message, int fontID, float size, float spacing, float blur, int align);
+	void                   queueLayout(Cmd* pCmd, const FontstashLayout* pLayout, uint32_t pipelineIndex, const mat4& transform, uint32_t color);
+	void                   flush();
+
 	Renderer*    pRenderer;
 	FONScontext* pContext;
 
-	const uint8_t* pPixels;
-	Texture*       pCurrentTexture;
-	bool           mUpdateTexture;
+	const uint8_t*      pPixels;
+	FontstashAtlasPage* pPages;
+	uint32_t            mPageCount;
+	uint32_t            mMaxFramesInFlight;
+	// Page drawn with, and the page new glyphs were last uploaded to until that upload completes
+	uint32_t            mCurrentPage;
+	uint32_t            mUploadPage;
+	uint64_t            mFrame;
+	// Frame in which no page was free for new glyphs, they are uploaded in a later frame
+	uint64_t            mDeferredFrame;
+	bool                mFrameTracking;
+	// No page holds glyphs before the first upload completed
+	bool                mAtlasUploaded;
+	bool                mUpdateTexture;
+	FontstashAtlasStats mStats;
 
 	uint32_t mWidth;
 	uint32_t mHeight;
@@ -287,24 +359,29 @@ public:
 	eastl::vector<uint32_t>        mFontBufferSizes;
 	eastl::vector<eastl::string>   mFontNames;
 
-	mat4 mProjView;
-	mat4 mWorldMat;
-	Cmd* pCmd;
+	eastl::hash_map<eastl::string, FontstashLayout> mLayouts;
+	eastl::vector<FONSquad>                         mLayoutQuads;
+	eastl::string                                   mLayoutKey;
 
-	Shader*            pShaders[2];
+	// Strings queued since the last flush
+	eastl::vector<FontstashVertex>  mVertices;
+	eastl::vector<FontstashDrawRun> mRuns;
+	Cmd*                            pBatchCmd;
+	// Nested beginTextBatch calls, strings are queued while it is not zero
+	uint32_t                        mBatchDepth;
+
+	Shader*            pShader;
 	RootSignature*     pRootSignature;
 	DescriptorSet*     pDescriptorSets;
 	Pipeline*          pPipelines[2];
 	/// Default states
 	Sampler*             pDefaultSampler;
-	GPURingBuffer*       pUniformRingBuffer;
 	GPURingBuffer*       pMeshRingBuffer;
 	float2               mDpiScale;
 	float                mDpiScaleMin;
-	bool                 mText3D;
 };
 
-bool Fontstash::init(Renderer* renderer, uint32_t width, uint32_t height, uint32_t ringSizeBytes)
+bool Fontstash::init(Renderer* renderer, uint32_t width, uint32_t height, uint32_t ringSizeBytes, uint32_t maxFramesInFlight)
 {
 	impl = tf_placement_new<_Impl_FontStash>(tf_calloc(1, sizeof(_Impl_FontStash)));
 	impl->mDpiScale = getDpiScale();
@@ -313,7 +390,7 @@ bool Fontstash::init(Renderer* renderer, uint32_t width, uint32_t height, uint32
 	width = width * (int)ceilf(impl->mDpiScale.x);
 	height = height * (int)ceilf(impl->mDpiScale.y);
 
-	bool success = impl->init(renderer, width, height, ringSizeBytes);
+	bool success = impl->init(renderer, width, height, ringSizeBytes, maxFramesInFlight);
 	m_fFontMaxSize = min(width, height) / 10.0f;    // see fontstash.h, line 1271, for fontSize calculation
 
 	return success;
@@ -336,6 +413,11 @@ void Fontstash::unload()
 	impl->unload();
 }
 
+void Fontstash::resize(uint32_t width, uint32_t height)
+{
+	impl->mScaleBias = { 2.0f / (float)width, -2.0f / (float)height };
+}
+
 int Fontstash::defineFont(const char* identification, const char* pFontPath)
 {
 	FONScontext* fs = impl->pContext;
@@ -360,6 +442,74 @@ int Fontstash::defineFont(const char* identification, const char* pFontPath)
 	return INT32_MAX;
 }
 
+void Fontstash::prewarmGlyphs(int fontID, uint32_t firstCodepoint, uint32_t lastCodepoint, float size /*=16.0f*/, float blur /*=0.0f*/)
+{
+	size = min(size, m_fFontMaxSize);
+
+	FONScontext* fs = impl->pContext;
+	fonsSetSize(fs, size * impl->mDpiScaleMin);
+	fonsSetFont(fs, fontID);
+	fonsSetBlur(fs, blur);
+	fonsSetAlign(fs, FONS_ALIGN_LEFT | FONS_ALIGN_TOP);
+
+	// Measuring rasterizes the glyphs, feed the range as UTF-8 in chunks
+	char     text[256];
+	uint32_t length = 0;
+	float    bounds[4];
+	for (uint64_t codepoint = max(firstCodepoint, 1U); codepoint <= lastCodepoint && codepoint <= 0x10FFFF; ++codepoint)
+	{
+		if (codepoint >= 0xD800 && codepoint <= 0xDFFF)
+			continue;
+
+		if (codepoint < 0x80)
+		{
+			text[length++] = (char)codepoint;
+		}
+		else if (codepoint < 0x800)
+		{
+			text[length++] = (char)(0xC0 | (codepoint >> 6));
+			text[length++] = (char)(0x80 | (codepoint & 0x3F));
+		}
+		else if (codepoint < 0x10000)
+		{
+			text[length++] = (char)(0xE0 | (codepoint >> 12));
+			text[length++] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+			text[length++] = (char)(0x80 | (codepoint & 0x3F));
+		}
+		else
+		{
+			text[length++] = (char)(0xF0 | (codepoint >> 18));
+			text[length++] = (char)(0x80 | ((codepoint >> 12) & 0x3F));
+			text[length++] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+			text[length++] = (char)(0x80 | (codepoint & 0x3F));
+		}
+
+		if (length > sizeof(text) - 4)
+		{
+			fonsTextBounds(fs, 0.0f, 0.0f, text, text + length, bounds);
+			length = 0;
+		}
+	}
+	if (length)
+		fonsTextBounds(fs, 0.0f, 0.0f, text, text + length, bounds);
+
+	// Measuring does not flush, hand the new glyphs over so the next draw uploads them
+	int dirty[4];
+	if (fonsValidateTexture(fs, dirty))
+		_Impl_FontStash::fonsImplementationModifyTexture(impl, dirty, fonsGetTextureData(fs, NULL, NULL));
+}
+
+void Fontstash::beginFrame()
+{
+	++impl->mFrame;
+	impl->mFrameTracking = true;
+}
+
+void Fontstash::getAtlasStats(FontstashAtlasStats* pStats) const
+{
+	*pStats = impl->mStats;
+}
+
 void* Fontstash::getFontBuffer(uint32_t index)
 {
 	if (index < impl->mFontBuffers.size())
@@ -374,50 +524,58 @@ uint32_t Fontstash::getFontBufferSize(uint32_t index)
 	return UINT_MAX;
 }
 
+void Fontstash::beginTextBatch()
+{
+	if (!impl->mBatchDepth++)
+		impl->flush();
+}
+
+void Fontstash::endTextBatch()
+{
+	ASSERT(impl->mBatchDepth);
+	if (!--impl->mBatchDepth)
+		impl->flush();
+}
+
 void Fontstash::drawText(
 	Cmd* pCmd, const char* message, float x, float y, int fontID, unsigned int color /*=0xffffffff*/, float size /*=16.0f*/,
 	float spacing /*=3.0f*/, float blur /*=0.0f*/)
 {
-	impl->mText3D = false;
-	impl->pCmd = pCmd;
 	// clamp the font size to max size.
 	// Precomputed font texture puts limitation to the maximum size.
 	size = min(size, m_fFontMaxSize);
 
-	FONScontext* fs = impl->pContext;
-	fonsSetSize(fs, size * impl->mDpiScaleMin);
-	fonsSetFont(fs, fontID);
-	fonsSetColor(fs, color);
-	fonsSetSpacing(fs, spacing * impl->mDpiScaleMin);
-	fonsSetBlur(fs, blur);
-	fonsSetAlign(fs, FONS_ALIGN_LEFT | FONS_ALIGN_TOP);
+	const FontstashLayout* pLayout = impl->getLayout(
+		message, fontID, size * impl->mDpiScaleMin, spacing * impl->mDpiScaleMin, blur, FONS_ALIGN_LEFT | FONS_ALIGN_TOP);
 
 	// considering the retina scaling:
 	// the render target is already scaled up (w/ retina) and the (x,y) position given to this function
 	// is expected to be in the render target's area. Hence, we don't scale up the position again.
-	fonsDrawText(fs, x /** impl->mDpiScale.x*/, y /** impl->mDpiScale.y*/, message, NULL);
+	// The origin is snapped to whole pixels since fontstash snaps every glyph of the cached layout.
+	const float scaleX = impl->mScaleBias.x;
+	const float scaleY = impl->mScaleBias.y;
+	const mat4  transform(
+		Vector4(scaleX, 0.0f, 0.0f, 0.0f), Vector4(0.0f, scaleY, 0.0f, 0.0f), Vector4(0.0f, 0.0f, 1.0f, 0.0f),
+		Vector4(roundf(x) * scaleX - 1.0f, roundf(y) * scaleY + 1.0f, 0.0f, 1.0f));
+	impl->queueLayout(pCmd, pLayout, 0, transform, color);
 }
 
 void Fontstash::drawText(
 	Cmd* pCmd, const char* message, const mat4& projView, const mat4& worldMat, int fontID, unsigned int color /*=0xffffffff*/,
 	float size /*=16.0f*/, float spacing /*=3.0f*/, float blur /*=0.0f*/)
 {
-	impl->mText3D = true;
-	impl->mProjView = projView;
-	impl->mWorldMat = worldMat;
-	impl->pCmd = pCmd;
 	// clamp the font size to max size.
 	// Precomputed font texture puts limitation to the maximum size.
 	size = min(size, m_fFontMaxSize);
 
-	FONScontext* fs = impl->pContext;
-	fonsSetSize(fs, size * impl->mDpiScaleMin);
-	fonsSetFont(fs, fontID);
-	fonsSetColor(fs, color);
-	fonsSetSpacing(fs, spacing * impl->mDpiScaleMin);
-	fonsSetBlur(fs, blur);
-	fonsSetAlign(fs, FONS_ALIGN_CENTER | FONS_ALIGN_MIDDLE);
-	fonsDrawText(fs, 0.0f, 0.0f, message, NULL);
+	const FontstashLayout* pLayout = impl->getLayout(
+		message, fontID, size * impl->mDpiScaleMin, spacing * impl->mDpiScaleMin, blur, FONS_ALIGN_CENTER | FONS_ALIGN_MIDDLE);
+
+	// Glyphs are laid out in the z = 1 plane of the object, scaled from pixels like in screen space
+	const mat4 toObject(
+		Vector4(-impl->mScaleBias.x, 0.0f, 0.0f, 0.0f), Vector4(0.0f, impl->mScaleBias.y, 0.0f, 0.0f), Vector4(0.0f, 0.0f, 1.0f, 0.0f),
+		Vector4(0.0f, 0.0f, 1.0f, 1.0f));
+	impl->queueLayout(pCmd, pLayout, 1, projView * worldMat * toObject, color);
 }
 
 float Fontstash::measureText(
@@ -430,22 +588,22 @@ float Fontstash::measureText(
 	float blur /*=0.0f*/
 )
 {
+	UNREF_PARAM(color);
+
 	if (out_bounds == NULL)
 		return 0;
 
-	const int    messageLength = (int)strlen(message);
-	FONScontext* fs = impl->pContext;
-	fonsSetSize(fs, size * impl->mDpiScaleMin);
-	fonsSetFont(fs, fontID);
-	fonsSetColor(fs, color);
-	fonsSetSpacing(fs, spacing * impl->mDpiScaleMin);
-	fonsSetBlur(fs, blur);
-	fonsSetAlign(fs, FONS_ALIGN_LEFT | FONS_ALIGN_TOP);
+	const FontstashLayout* pLayout = impl->getLayout(
+		message, fontID, size * impl->mDpiScaleMin, spacing * impl->mDpiScaleMin, blur, FONS_ALIGN_LEFT | FONS_ALIGN_TOP);
 
 	// considering the retina scaling:
 	// the render target is already scaled up (w/ retina) and the (x,y) position given to this function
 	// is expected to be in the render target's area. Hence, we don't scale up the position again.
-	return fonsTextBounds(fs, x /** impl->mDpiScale.x*/, y /** impl->mDpiScale.y*/, message, message + messageLength, out_bounds);
+	out_bounds[0] = x + pLayout->mBounds[0];
+	out_bounds[1] = y + pLayout->mBounds[1];
+	out_bounds[2] = x + pLayout->mBounds[2];
+	out_bounds[3] = y + pLayout->mBounds[3];
+	return pLayout->mAdvance;
 }
 
 // --  FONS renderer implementation --
@@ -455,6 +613,15 @@ int _Impl_FontStash::fonsImplementationGenerateTexture(void* userPtr, int width,
 	ctx->mWidth = width;
 	ctx->mHeight = height;
 
+	// Every page starts with a full upload, so the parts of the atlas without glyphs are cleared too
+	for (uint32_t i = 0; i < ctx->mPageCount; ++i)
+	{
+		int* pDirty = ctx->pPages[i].mDirtyRect;
+		pDirty[0] = 0;
+		pDirty[1] = 0;
+		pDirty[2] = width;
+		pDirty[3] = height;
+	}
 	ctx->mUpdateTexture = true;
 
 	return 1;
@@ -462,115 +629,276 @@ int _Impl_FontStash::fonsImplementationGenerateTexture(void* userPtr, int width,
 
 void _Impl_FontStash::fonsImplementationModifyTexture(void* userPtr, int* rect, const unsigned char* data)
 {
-	UNREF_PARAM(rect);
-
 	_Impl_FontStash* ctx = (_Impl_FontStash*)userPtr;
 
+	// Each page gets the glyphs it is missing with its next upload
+	for (uint32_t i = 0; i < ctx->mPageCount; ++i)
+	{
+		int* pDirty = ctx->pPages[i].mDirtyRect;
+		if (pDirty[0] >= pDirty[2])
+		{
+			memcpy(pDirty, rect, sizeof(int) * 4);
+			continue;
+		}
+		pDirty[0] = min(pDirty[0], rect[0]);
+		pDirty[1] = min(pDirty[1], rect[1]);
+		pDirty[2] = max(pDirty[2], rect[2]);
+		pDirty[3] = max(pDirty[3], rect[3]);
+	}
+
 	ctx->pPixels = data;
 	ctx->mUpdateTexture = true;
 }
 
-void _Impl_FontStash::fonsImplementationRenderText(
-	void* userPtr, const float* verts, const float* tcoords, const unsigned int* colors, int nverts)
+const FontstashLayout* _Impl_FontStash::getLayout(const char* message, int fontID, float size, float spacing, float blur, int align)
 {
-	_Impl_FontStash* ctx = (_Impl_FontStash*)userPtr;
-	if (!ctx->pCurrentTexture)
-		return;
+	struct
+	{
+		int32_t mFont;
+		float   mSize;
+		float   mSpacing;
+		float   mBlur;
+		int32_t mAlign;
+	} params = { fontID, size, spacing, blur, align };
+
+	// The terminator separates the string from the parameters, the string hash stops at it
+	mLayoutKey.assign(message, strlen(message) + 1);
+	mLayoutKey.append((const char*)&params, sizeof(params));
+
+	eastl::hash_map<eastl::string, FontstashLayout>::iterator it = mLayouts.find(mLayoutKey);
+	if (it != mLayouts.end())
+		return &it->second;
+
+	if (mLayouts.size() >= FONTSTASH_LAYOUT_CACHE_SIZE)
+	{
+		mLayouts.clear();
+		mLayoutQuads.clear();
+	}
 
-	Cmd* pCmd = ctx->pCmd;
+	FONScontext* fs = pContext;
+	fonsSetSize(fs, size);
+	fonsSetFont(fs, fontID);
+	fonsSetSpacing(fs, spacing);
+	fonsSetBlur(fs, blur);
+	fonsSetAlign(fs, align);
 
-	if (ctx->mUpdateTexture)
-	{
-		// #TODO: Investigate - Causes hang on low-mid end Android phones (tested on Samsung Galaxy A50s)
-#ifndef __ANDROID__
-		waitQueueIdle(pCmd->pQueue);
-#endif
+	FontstashLayout layout = {};
+	layout.mFirstQuad = (uint32_t)mLayoutQuads.size();
+	layout.mAdvance = fonsTextBounds(fs, 0.0f, 0.0f, message, NULL, layout.mBounds);
 
-		SyncToken token = {};
-		TextureUpdateDesc updateDesc = {};
-		updateDesc.pTexture = ctx->pCurrentTexture;
-		beginUpdateResource(&updateDesc);
-		for (uint32_t r = 0; r < updateDesc.mRowCount; ++r)
+	FONStextIter iter;
+	FONSquad     quad;
+	if (fonsTextIterInit(fs, &iter, 0.0f, 0.0f, message, NULL))
+	{
+		while (fonsTextIterNext(fs, &iter, &quad))
 		{
-			memcpy(updateDesc.pMappedData + r * updateDesc.mDstRowStride,
-				ctx->pPixels + r * updateDesc.mSrcRowStride, updateDesc.mSrcRowStride);
+			// Missing glyphs leave the quad untouched
+			if (iter.prevGlyphIndex != -1)
+				mLayoutQuads.push_back(quad);
 		}
-		endUpdateResource(&updateDesc, &token);
-		waitForToken(&token);
+	}
+	layout.mQuadCount = (uint32_t)mLayoutQuads.size() - layout.mFirstQuad;
+
+	// Measuring and iterating do not flush, hand the new glyphs over so the next draw uploads them
+	int dirty[4];
+	if (fonsValidateTexture(fs, dirty))
+		fonsImplementationModifyTexture(this, dirty, fonsGetTextureData(fs, NULL, NULL));
+
+	return &mLayouts.insert(eastl::make_pair(mLayoutKey, layout)).first->second;
+}
+
+void _Impl_FontStash::queueLayout(Cmd* pCmd, const FontstashLayout* pLayout, uint32_t pipelineIndex, const mat4& transform, uint32_t color)
+{
+	if (!pPages || !pLayout->mQuadCount)
+		return;
+
+	ASSERT(pPipelines[pipelineIndex]);
+
+	const uint32_t vertexCount = pLayout->mQuadCount * 6;
+	if (pBatchCmd != pCmd || (mVertices.size() + vertexCount) * sizeof(FontstashVertex) > pMeshRingBuffer->mMaxBufferSize / 2)
+		flush();
+	pBatchCmd = pCmd;
 
-		ctx->mUpdateTexture = false;
+	// Switch to the page with the new glyphs once its upload is done, until then they are missing from the text
+	if (mUploadPage != UINT32_MAX && isTokenCompleted(&pPages[mUploadPage].mUploadToken))
+	{
+		mCurrentPage = mUploadPage;
+		mUploadPage = UINT32_MAX;
 	}
 
-	GPURingBufferOffset buffer = getGPURingBufferOffset(ctx->pMeshRingBuffer, nverts * sizeof(float4));
-	BufferUpdateDesc update = { buffer.pBuffer, buffer.mOffset };
-	beginUpdateResource(&update);
-	float4* vtx = (float4*)update.pMappedData;
-	// build vertices
-	for (int impl = 0; impl < nverts; impl++)
+	FontstashAtlasPage& page = pPages[mCurrentPage];
+	if (page.mUseFrame != mFrame)
 	{
-		vtx[impl].setX(verts[impl * 2 + 0]);
-		vtx[impl].setY(verts[impl * 2 + 1]);
-		vtx[impl].setZ(tcoords[impl * 2 + 0]);
-		vtx[impl].setW(tcoords[impl * 2 + 1]);
+		page.mPrevUseFrame = page.mUseFrame;
+		page.mUseFrame = mFrame;
 	}
-	endUpdateResource(&update, NULL);
 
-	// extract color
-	uint8_t* colorByte = (uint8_t*)colors;
-	float4 color;
-	for (int i = 0; i < 4; i++)
-		color[i] = ((float)colorByte[i]) / 255.0f;
+	if (mRuns.empty() || mRuns.back().mPipeline != pipelineIndex || mRuns.back().mPage != mCurrentPage)
+	{
+		FontstashDrawRun run = { pipelineIndex, mCurrentPage, (uint32_t)mVertices.size(), 0 };
+		mRuns.push_back(run);
+	}
+	mRuns.back().mVertexCount += vertexCount;
 
-	uint32_t                               pipelineIndex = ctx->mText3D ? 1 : 0;
-	Pipeline*                              pPipeline = ctx->pPipelines[pipelineIndex];
-	ASSERT(pPipeline);
+	const Vector4 col0 = transform.getCol0();
+	const Vector4 col1 = transform.getCol1();
+	const Vector4 col3 = transform.getCol3();
 
-	cmdBindPipeline(pCmd, pPipeline);
+	const uint32_t firstVertex = (uint32_t)mVertices.size();
+	mVertices.resize(firstVertex + vertexCount);
+	FontstashVertex* pVertex = mVertices.data() + firstVertex;
+	const FONSquad*  pQuads = mLayoutQuads.data() + pLayout->mFirstQuad;
+	for (uint32_t i = 0; i < pLayout->mQuadCount; ++i)
+	{
+		const FONSquad& q = pQuads[i];
+		// Same triangles as fonsDrawText
+		const float corners[6][4] = {
+			{ q.x0, q.y0, q.s0, q.t0 }, { q.x1, q.y1, q.s1, q.t1 }, { q.x1, q.y0, q.s1, q.t0 },
+			{ q.x0, q.y0, q.s0, q.t0 }, { q.x0, q.y1, q.s0, q.t1 }, { q.x1, q.y1, q.s1, q.t1 },
+		};
+		for (uint32_t v = 0; v < 6; ++v, ++pVertex)
+		{
+			const Vector4 position = col0 * corners[v][0] + col1 * corners[v][1] + col3;
+			pVertex->mPosition[0] = position.getX();
+			pVertex->mPosition[1] = position.getY();
+			pVertex->mPosition[2] = position.getZ();
+			pVertex->mPosition[3] = position.getW();
+			pVertex->mTexCoord[0] = corners[v][2];
+			pVertex->mTexCoord[1] = corners[v][3];
+			pVertex->mColor = color;
+		}
+	}
 
-	struct UniformData
+	if (!mBatchDepth)
+		flush();
+}
+
+void _Impl_FontStash::flush()
+{
+	if (mVertices.empty())
+		return;
+
+	Cmd*           pCmd = pBatchCmd;
+	const uint32_t size = (uint32_t)(mVertices.size() * sizeof(FontstashVertex));
+
+	// Once per batch, the glyphs laid out for it are drawn from the current page until the upload completed
+	if (mUpdateTexture && mDeferredFrame != mFrame)
+		updateAtlas(pCmd);
+
+	GPURingBufferOffset buffer = getGPURingBufferOffset(pMeshRingBuffer, size);
+	if (buffer.pBuffer)
+	{
+		BufferUpdateDesc update = { buffer.pBuffer, buffer.mOffset, size };
+		beginUpdateResource(&update);
+		memcpy(update.pMappedData, mVertices.data(), size);
+		endUpdateResource(&update, NULL);
+
+		const uint32_t stride = sizeof(FontstashVertex);
+		cmdBindVertexBuffer(pCmd, 1, &buffer.pBuffer, &stride, &buffer.mOffset);
+
+		uint32_t boundPipeline = UINT32_MAX;
+		uint32_t boundPage = UINT32_MAX;
+		for (const FontstashDrawRun& run : mRuns)
+		{
+			if (run.mPipeline != boundPipeline)
+			{
+				cmdBindPipeline(pCmd, pPipelines[run.mPipeline]);
+				boundPipeline = run.mPipeline;
+				boundPage = UINT32_MAX;
+			}
+			if (run.mPage != boundPage)
+			{
+				cmdBindDescriptorSet(pCmd, run.mPage, pDescriptorSets);
+				boundPage = run.mPage;
+			}
+			cmdDraw(pCmd, run.mVertexCount, run.mFirstVertex);
+		}
+	}
+
+	mVertices.clear();
+	mRuns.clear();
+}
+
+void _Impl_FontStash::updateAtlas(Cmd* pCmd)
+{
+	// Add the glyphs to the page still being uploaded to, or else to a page no submitted frame still reads. Neither is
+	// drawn with before the upload completed, so the upload needs no wait.
+	uint32_t pageIndex = mUploadPage;
+	if (pageIndex == UINT32_MAX && mFrameTracking && mAtlasUploaded)
 	{
-		float4 color;
-		float2 scaleBias;
-	} data;
+		for (uint32_t i = 1; i < mPageCount; ++i)
+		{
+			uint32_t                  candidate = (mCurrentPage + i) % mPageCount;
+			const FontstashAtlasPage& page = pPages[candidate];
+			uint64_t                  lastSubmittedUse = page.mUseFrame == mFrame ? page.mPrevUseFrame : page.mUseFrame;
+			if (lastSubmittedUse + mMaxFramesInFlight <= mFrame)
+			{
+				pageIndex = candidate;
+				break;
+			}
+		}
+	}
 
-	data.color = color;
-	data.scaleBias = ctx->mScaleBias;
+	// Glyphs are added faster than pages free up, they are drawn once a page did
+	if (pageIndex == UINT32_MAX && mFrameTracking && mAtlasUploaded)
+	{
+		++mStats.mDeferredUploads;
+		mDeferredFrame = mFrame;
+		return;
+	}
 
-	if (ctx->mText3D)
+	// The first upload goes to the current page, which no frame has drawn with yet, and is waited for since no page
+	// holds glyphs before it. Without beginFrame the pages in flight are not known, the current page is then updated
+	// once the GPU is idle.
+	const bool waitForUpload = pageIndex == UINT32_MAX;
+	if (waitForUpload)
 	{
-		mat4 mvp = ctx->mProjView * ctx->mWorldMat;
-		data.color = color;
-		data.scaleBias.x = -data.scaleBias.x;
+		// #TODO: Investigate - Causes hang on low-mid end Android phones (tested on Samsung Galaxy A50s)
+#ifndef __ANDROID__
+		if (mAtlasUploaded)
+			waitQueueIdle(pCmd->pQueue);
+#endif
+		pageIndex = mCurrentPage;
+	}
 
-		GPURingBufferOffset uniformBlock = {};
-		uniformBlock = getGPURingBufferOffset(ctx->pUniformRingBuffer, sizeof(mvp));
-		BufferUpdateDesc updateDesc = { uniformBlock.pBuffer, uniformBlock.mOffset };
+	FontstashAtlasPage& page = pPages[pageIndex];
+	int*                pDirty = page.mDirtyRect;
+	if (pDirty[0] < pDirty[2] && pDirty[1] < pDirty[3])
+	{
+		// Only the part of the atlas the page is missing. The first upload of a page covers all of it and is not a
+		// region, updating a region needs the previous content.
+		TextureUpdateDesc updateDesc = {};
+		updateDesc.pTexture = page.pTexture;
+		if (pDirty[0] > 0 || pDirty[1] > 0 || pDirty[2] < (int)mWidth || pDirty[3] < (int)mHeight)
+		{
+			updateDesc.mRegionX = (uint32_t)pDirty[0];
+			updateDesc.mRegionY = (uint32_t)pDirty[1];
+			updateDesc.mRegionWidth = (uint32_t)(pDirty[2] - pDirty[0]);
+			updateDesc.mRegionHeight = (uint32_t)(pDirty[3] - pDirty[1]);
+		}
 		beginUpdateResource(&updateDesc);
-		*((mat4*)updateDesc.pMappedData) = mvp;
-		endUpdateResource(&updateDesc, NULL);
-
-		const uint64_t size = sizeof(mvp);
-		const uint32_t stride = sizeof(float4);
-
-		DescriptorData params[1] = {};
-		params[0].pName = "uniformBlock_rootcbv";
-		params[0].ppBuffers = &uniformBlock.pBuffer;
-		params[0].pOffsets = &uniformBlock.mOffset;
-		params[0].pSizes = &size;
-		updateDescriptorSet(ctx->pRenderer, pipelineIndex, ctx->pDescriptorSets, 1, params);
-		cmdBindDescriptorSet(pCmd, pipelineIndex, ctx->pDescriptorSets);
-		cmdBindPushConstants(pCmd, ctx->pRootSignature, "uRootConstants", &data);
-		cmdBindVertexBuffer(pCmd, 1, &buffer.pBuffer, &stride, &buffer.mOffset);
-		cmdDraw(pCmd, nverts, 0);
+		const uint8_t* pSrc = pPixels + pDirty[1] * mWidth + pDirty[0];
+		for (uint32_t r = 0; r < updateDesc.mRowCount; ++r)
+		{
+			memcpy(updateDesc.pMappedData + r * updateDesc.mDstRowStride, pSrc + r * mWidth, updateDesc.mSrcRowStride);
+		}
+		++mStats.mUploads;
+		mStats.mUploadedBytes += (uint64_t)updateDesc.mRowCount * updateDesc.mSrcRowStride;
+		endUpdateResource(&updateDesc, &page.mUploadToken);
+		pDirty[0] = pDirty[2] = 0;
+	}
+
+	if (waitForUpload)
+	{
+		waitForToken(&page.mUploadToken);
+		++mStats.mUploadWaits;
+		mAtlasUploaded = true;
 	}
 	else
 	{
-		const uint32_t stride = sizeof(float4);
-		cmdBindDescriptorSet(pCmd, pipelineIndex, ctx->pDescriptorSets);
-		cmdBindPushConstants(pCmd, ctx->pRootSignature, "uRootConstants", &data);
-		cmdBindVertexBuffer(pCmd, 1, &buffer.pBuffer, &stride, &buffer.mOffset);
-		cmdDraw(pCmd, nverts, 0);
+		mUploadPage = pageIndex;
 	}
+	mUpdateTexture = false;
 }
 
 void _Impl_FontStash::fonsImplementationRemoveTexture(void* userPtr)
@@ -48,14 +48,29 @@ typedef struct TextDrawDesc
 	float    mFontBlur;
 } TextDrawDesc;
 
+typedef struct FontstashAtlasStats
+{
+	//! Number of atlas uploads and bytes copied to the GPU by them, only the part of the atlas an upload's page is missing is copied
+	uint64_t mUploads;
+	uint64_t mUploadedBytes;
+	//! Frames in which new glyphs waited for an atlas page to free up, they are drawn in a later frame
+	uint64_t mDeferredUploads;
+	//! Uploads the CPU waited for, only the first one unless beginFrame is not called
+	uint64_t mUploadWaits;
+} FontstashAtlasStats;
+
 class Fontstash
 {
 public:
-	bool init(Renderer* pRenderer, uint32_t width, uint32_t height, uint32_t ringSizeBytes);
+	//! maxFramesInFlight is the number of frames the GPU can still be processing while the next one is recorded,
+	//! the atlas keeps one page more than that.
+	bool init(Renderer* pRenderer, uint32_t width, uint32_t height, uint32_t ringSizeBytes, uint32_t maxFramesInFlight);
 	void exit();
 
 	bool load(RenderTarget** pRts, uint32_t count, PipelineCache* pCache);
 	void unload();
+	//! Updates the render target size of screen space text without recreating the pipelines.
+	void resize(uint32_t width, uint32_t height);
 
 	//! Makes a font available to the font stash.
 	//! - Fonts can not be undefined in a FontStash due to its dynamic nature (once packed into an atlas, they cannot be unpacked, unless it is fully rebuilt)
@@ -63,9 +78,25 @@ public:
 	//! - When it is paramount to be able to unload individual fonts, use multiple fontstashes.
 	int defineFont(const char* identification, const char* pFontPath);
 
+	//! Rasterizes the glyphs of the codepoints in [firstCodepoint, lastCodepoint] into the atlas, so drawing them later
+	//! does not update the atlas. Size and blur must match the ones used for drawing.
+	void prewarmGlyphs(int fontID, uint32_t firstCodepoint, uint32_t lastCodepoint, float size = 16.0f, float blur = 0.0f);
+
+	//! Call once per frame before drawing text. New glyphs are then uploaded to an atlas page no in-flight frame is
+	//! reading instead of waiting for the GPU to go idle, and drawn once the upload completed.
+	void beginFrame();
+
+	void getAtlasStats(FontstashAtlasStats* pStats) const;
+
 	void*       getFontBuffer(uint32_t index);
 	uint32_t    getFontBufferSize(uint32_t index);
 
+	//! Text drawn between beginTextBatch and endTextBatch is queued and recorded as a few draws by endTextBatch,
+	//! which must be called before the render pass of the text ends. Text is drawn after any other draw in between.
+	//! Outside of a batch every drawText call records its own draw. Batches nest, the outermost endTextBatch records the text.
+	void beginTextBatch();
+	void endTextBatch();
+
 	//! Draw text.
 	void drawText(
 		struct Cmd* pCmd, const char* message, float x, float y, int fontID, unsigned int color = 0xffffffff, float size = 16.0f,
@@ -77,6 +108,7 @@ public:
 		float size = 16.0f, float spacing = 0.0f, float blur = 0.0f);
 
 	//! Measure text boundaries. Results will be written to out_bounds (x,y,x2,y2).
+	//! Layouts are cached per font, size, spacing and string, measuring a string that is drawn as well is cheap.
 	float measureText(
 		float* out_bounds, const char* message, float x, float y, int fontID, unsigned int color = 0xffffffff, float size = 16.0f,
 		float spacing = 0.0f, float blur = 0.0f);
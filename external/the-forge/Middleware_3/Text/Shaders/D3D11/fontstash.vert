@@ -22,31 +22,25 @@
  * under the License.
 */
 
-
-
 struct VsIn
 {
-	float2 position: Position;
+	float4 position: Position;
 	float2 texCoord: TEXCOORD0;
+	float4 color: COLOR0;
 };
 
 struct PsIn
 {
 	float4 position: SV_Position;
 	float2 texCoord: TEXCOORD0;
-};
-
-cbuffer uRootConstants : register(b0)
-{
-	float4 color;
-	float2 scaleBias;
+	float4 color: COLOR0;
 };
 
 PsIn main(VsIn In)
 {
 	PsIn Out;
-	Out.position = float4 (In.position, 0.0f, 1.0f);
-	Out.position.xy = Out.position.xy * scaleBias.xy + float2(-1.0f, 1.0f);
+	Out.position = In.position;
 	Out.texCoord = In.texCoord;
+	Out.color = In.color;
 	return Out;
-};
\ No newline at end of file
+}
@@ -0,0 +1,18 @@
+#version 100
+
+precision mediump float;
+precision mediump int;
+
+attribute vec4 Position;
+attribute vec2 UV;
+attribute vec4 Color;
+
+varying vec2 vertOutput_TEXCOORD0;
+varying vec4 vertOutput_COLOR0;
+
+void main()
+{
+    gl_Position = Position;
+    vertOutput_TEXCOORD0 = UV;
+    vertOutput_COLOR0 = Color;
+}
@@ -31,35 +31,30 @@ struct Fragment_Shader
     {
         float4 position [[position]];
         float2 texCoord;
+        float4 color;
     };
-    struct Uniforms_uRootConstants
-    {
-        packed_float4 color;
-        packed_float2 scaleBias;
-    };
-    constant Uniforms_uRootConstants & uRootConstants;
     texture2d<float> uTex0;
     sampler uSampler0;
     float4 main(PsIn In)
     {
-        return (float4(1.0, 1.0, 1.0, uTex0.sample(uSampler0, (In).texCoord).r) * uRootConstants.color);
+        return (float4(1.0, 1.0, 1.0, uTex0.sample(uSampler0, (In).texCoord).r) * (In).color);
     };
 
     Fragment_Shader(
-constant Uniforms_uRootConstants & uRootConstants,texture2d<float> uTex0,sampler uSampler0) :
-uRootConstants(uRootConstants),uTex0(uTex0),uSampler0(uSampler0) {}
+texture2d<float> uTex0,sampler uSampler0) :
+uTex0(uTex0),uSampler0(uSampler0) {}
 };
 
 fragment float4 stageMain(
                           Fragment_Shader::PsIn In                                           [[stage_in]],
 						  texture2d<float> uTex0                                       [[texture(0)]],
-						  sampler uSampler0                                                   [[sampler(0)]],
-                          constant Fragment_Shader::Uniforms_uRootConstants& uRootConstants [[buffer(0)]]
+						  sampler uSampler0                                                   [[sampler(0)]]
 )
 {
     Fragment_Shader::PsIn In0;
     In0.position = float4(In.position.xyz, 1.0 / In.position.w);
     In0.texCoord = In.texCoord;
-    Fragment_Shader main(uRootConstants, uTex0, uSampler0);
+    In0.color = In.color;
+    Fragment_Shader main(uTex0, uSampler0);
     return main.main(In0);
 }
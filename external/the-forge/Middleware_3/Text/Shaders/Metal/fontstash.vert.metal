@@ -29,43 +29,38 @@ struct Vertex_Shader
 {
     struct VsIn
     {
-        float2 position [[attribute(0)]];
+        float4 position [[attribute(0)]];
         float2 texCoord [[attribute(1)]];
+        float4 color [[attribute(2)]];
     };
     struct PsIn
     {
         float4 position [[position]];
         float2 texCoord;
+        float4 color;
     };
-    struct Uniforms_uRootConstants
-    {
-        packed_float4 color;
-        float2 scaleBias;
-    };
-    constant Uniforms_uRootConstants & uRootConstants;
     PsIn main(VsIn In)
     {
         PsIn Out;
-        ((Out).position = float4((In).position, 0.0, 1.0));
-        (((Out).position).xy = ((((Out).position).xy * (uRootConstants.scaleBias).xy) + float2((-1.0), 1.0)));
+        ((Out).position = (In).position);
         ((Out).texCoord = (In).texCoord);
+        ((Out).color = (In).color);
         return Out;
     };
 
-    Vertex_Shader(constant Uniforms_uRootConstants & uRootConstants)
-        : uRootConstants(uRootConstants)
+    Vertex_Shader()
     {
     }
 };
 
 vertex Vertex_Shader::PsIn stageMain(
-                                     Vertex_Shader::VsIn In                                           [[stage_in]],
-                                     constant Vertex_Shader::Uniforms_uRootConstants& uRootConstants [[buffer(0)]]
+                                     Vertex_Shader::VsIn In                                           [[stage_in]]
 )
 {
     Vertex_Shader::VsIn In0;
     In0.position = In.position;
     In0.texCoord = In.texCoord;
-    Vertex_Shader main(uRootConstants);
+    In0.color = In.color;
+    Vertex_Shader main;
     return main.main(In0);
 }
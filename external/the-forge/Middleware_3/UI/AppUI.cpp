@@ -729,7 +729,7 @@ UIApp::UIApp(int32_t const fontAtlasSize, uint32_t const maxDynamicUIUpdatesPerB
 	mFontstashRingSizeBytes = fontstashRingSizeBytes;
 }
 
-bool UIApp::Init(Renderer* renderer, PipelineCache* pCache)
+bool UIApp::Init(Renderer* renderer, uint32_t maxFramesInFlight, PipelineCache* pCache)
 {
 	mShowDemoUiWindow = false;
 
@@ -748,7 +748,7 @@ bool UIApp::Init(Renderer* renderer, PipelineCache* pCache)
 		mFontAtlasSize = 256;
 
 	pImpl->pFontStash = tf_new(Fontstash);
-	bool success = pImpl->pFontStash->init(renderer, mFontAtlasSize, mFontAtlasSize, mFontstashRingSizeBytes);
+	bool success = pImpl->pFontStash->init(renderer, mFontAtlasSize, mFontAtlasSize, mFontstashRingSizeBytes, maxFramesInFlight);
 
 	initGUIDriver(pImpl->pRenderer, &pDriver);
 	if (pCustomShader)
@@ -819,6 +819,16 @@ void UIApp::Unload()
 	pImpl->pFontStash->unload();
 }
 
+void UIApp::Resize(RenderTarget** rts, uint32_t count)
+{
+	UNREF_PARAM(count);
+	ASSERT(rts && rts[0]);
+	mWidth = (float)rts[0]->mWidth;
+	mHeight = (float)rts[0]->mHeight;
+
+	pImpl->pFontStash->resize(rts[0]->mWidth, rts[0]->mHeight);
+}
+
 void UIApp::AddLuaManager(LuaManager* aLuaManager)
 {
 	ASSERT(!pLuaManager || aLuaManager);
@@ -852,6 +862,16 @@ float2 UIApp::MeasureText(const char* pText, const TextDrawDesc& drawDesc) const
 	return float2(textBounds[2] - textBounds[0], textBounds[3] - textBounds[1]);
 }
 
+void UIApp::PrewarmGlyphs(uint32_t firstCodepoint, uint32_t lastCodepoint, const TextDrawDesc* pDrawDesc)
+{
+	const TextDrawDesc* pDesc = pDrawDesc ? pDrawDesc : &gDefaultTextDrawDesc;
+	pImpl->pFontStash->prewarmGlyphs(pDesc->mFontID, firstCodepoint, lastCodepoint, pDesc->mFontSize, pDesc->mFontBlur);
+}
+
+void UIApp::BeginTextBatch() { pImpl->pFontStash->beginTextBatch(); }
+
+void UIApp::EndTextBatch() { pImpl->pFontStash->endTextBatch(); }
+
 void UIApp::DrawText(Cmd* cmd, const float2& screenCoordsInPx, const char* pText, const TextDrawDesc* pDrawDesc) const
 {
 	const TextDrawDesc* pDesc = pDrawDesc ? pDrawDesc : &gDefaultTextDrawDesc;
@@ -931,6 +951,8 @@ void UIApp::RemoveAllGuiComponents()
 
 void UIApp::Update(float deltaTime)
 {
+	pImpl->pFontStash->beginFrame();
+
 	if (pImpl->mUpdated || !pImpl->mComponentsToUpdate.size())
 		return;
 
@@ -954,7 +976,7 @@ void UIApp::Update(float deltaTime)
 		if (pImpl->mComponentsToUpdate[i]->mActive)
 			activeComponents[activeComponentCount++] = pImpl->mComponentsToUpdate[i];
 
-	GUIDriver::GUIUpdate guiUpdate{ activeComponents.data(), activeComponentCount, deltaTime, mWidth, mHeight, mShowDemoUiWindow };
+	GUIDriver::GUIUpdate guiUpdate{ activeComponents.data(), activeComponentCount, deltaTime, mWidth, mHeight, mShowDemoUiWindow, mReuseUnchangedDrawData };
 	pDriver->update(&guiUpdate);
 
 	pImpl->mComponentsToUpdate.clear();
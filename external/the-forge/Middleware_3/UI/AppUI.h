@@ -907,6 +907,7 @@ public:
 		float width;
 		float height;
 		bool showDemoWindow;
+		bool reuseUnchangedDrawData;
 	};
 
 	virtual ~GUIDriver() {}
@@ -961,12 +962,19 @@ class UIApp : public IMiddleware
 public:
 	UIApp(int32_t const fontAtlasSize = 0, uint32_t const maxDynamicUIUpdatesPerBatch = 20u, uint32_t const fontStashRingSizeBytes = 1024 * 1024);
 
-	bool Init(Renderer* renderer, PipelineCache* pCache = NULL);
+	// maxFramesInFlight is the number of frames the GPU can still be processing while the app records the next one,
+	// the font atlas is updated without waiting for those frames
+	bool Init(Renderer* renderer, uint32_t maxFramesInFlight, PipelineCache* pCache = NULL);
 	void Exit();
 
 	bool Load(RenderTarget** rts, uint32_t count = 1);
 	void Unload();
 
+	// takes the size of render targets recreated with the formats given to Load,
+	// the pipelines stay valid so frames in flight are left alone
+	//
+	void Resize(RenderTarget** rts, uint32_t count = 1);
+
 	void Update(float deltaTime);
 	void Draw(Cmd* cmd);
 
@@ -986,6 +994,11 @@ public:
 	//
 	float2 MeasureText(const char* pText, const TextDrawDesc& drawDesc) const;
 
+	// rasterizes the glyphs of a codepoint range ahead of time, so text using them later does not update the font atlas.
+	// The font size and blur of @pDrawDesc must match the ones used for drawing.
+	//
+	void PrewarmGlyphs(uint32_t firstCodepoint, uint32_t lastCodepoint, const TextDrawDesc* pDrawDesc = NULL);
+
 	// draws the @pText on screen using the @drawDesc descriptor and @screenCoordsInPx.
 	//
 	// Note:
@@ -994,6 +1007,13 @@ public:
 	//
 	void DrawText(Cmd* cmd, const float2& screenCoordsInPx, const char* pText, const TextDrawDesc* pDrawDesc = NULL) const;
 
+	// queues the text drawn until EndTextBatch and records it as a few draws, instead of one draw per string.
+	// EndTextBatch must be called before the render pass of the text ends, the text is drawn after other draws in between.
+	// Batches nest, the text is recorded by the outermost EndTextBatch.
+	//
+	void BeginTextBatch();
+	void EndTextBatch();
+
 	// draws the @pText in world space by using the linear transformation pipeline.
 	//
 	void DrawTextInWorldSpace(Cmd* pCmd, const char* pText, const mat4& matWorld, const mat4& matProjView, const TextDrawDesc* pDrawDesc = NULL);
@@ -1014,6 +1034,10 @@ public:
 	// Will only take effect if at least one GUI Component is active.
 	bool mShowDemoUiWindow;
 
+	// Compare the UI geometry with a copy of the last frame's and keep drawing from last frame's buffers when it did not
+	// change. Worth it for large UIs that rarely change, a wasted compare for UIs changing every frame.
+	bool mReuseUnchangedDrawData = false;
+
 private:
 	float   mWidth;
 	float   mHeight;
@@ -32,6 +32,7 @@
 #include "../../Common_3/ThirdParty/OpenSource/tinyimageformat/tinyimageformat_query.h"
 
 #include "AppUI.h"
+#include "ImguiGeometry.h"
 
 #include "../../Common_3/OS/Interfaces/IOperatingSystem.h"
 #include "../../Common_3/OS/Interfaces/IInput.h"
@@ -320,6 +321,18 @@ class ImguiGUIDriver: public GUIDriver
 	bool             mActive;
 	bool             mCustomShader;
 	bool             mPostUpdateKeyDownStates[512];
+	bool             mReuseUnchangedDrawData;
+	// Size of each of the MAX_FRAMES slots of the vertex and index buffers, doubled when the UI outgrows them
+	uint64_t           mVertexSlotSize;
+	uint64_t           mIndexSlotSize;
+	// Slot last written, and the draw that last read each slot
+	uint32_t           mGeometrySlot;
+	uint64_t           mDrawCount;
+	uint64_t           mSlotLastDraw[MAX_FRAMES];
+	ImguiGeometryCache mGeometryCache;
+
+	void addGeometryBuffers();
+	void growGeometryBuffers(uint64_t vertexSize, uint64_t indexSize);
 };
 
 static const uint64_t VERTEX_BUFFER_SIZE = 1024 * 64 * sizeof(ImDrawVert);
@@ -782,6 +795,13 @@ bool ImguiGUIDriver::init(Renderer* renderer, uint32_t const maxDynamicUIUpdates
 	mMaxDynamicUIUpdatesPerBatch = maxDynamicUIUpdatesPerBatch;
 	mActive = true;
 	memset(mPostUpdateKeyDownStates, false, sizeof(mPostUpdateKeyDownStates));
+	mReuseUnchangedDrawData = false;
+	mVertexSlotSize = VERTEX_BUFFER_SIZE;
+	mIndexSlotSize = INDEX_BUFFER_SIZE;
+	mGeometrySlot = 0;
+	mDrawCount = 0;
+	memset(mSlotLastDraw, 0, sizeof(mSlotLastDraw));
+	mGeometryCache.init();
 	/************************************************************************/
 	// Rendering resources
 	/************************************************************************/
@@ -825,19 +845,7 @@ bool ImguiGUIDriver::init(Renderer* renderer, uint32_t const maxDynamicUIUpdates
 	setDesc = { pRootSignatureTextured, DESCRIPTOR_UPDATE_FREQ_NONE, MAX_FRAMES };
 	addDescriptorSet(pRenderer, &setDesc, &pDescriptorSetUniforms);
 
-	BufferLoadDesc vbDesc = {};
-	vbDesc.mDesc.mDescriptors = DESCRIPTOR_TYPE_VERTEX_BUFFER;
-	vbDesc.mDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_CPU_TO_GPU;
-	vbDesc.mDesc.mSize = VERTEX_BUFFER_SIZE * MAX_FRAMES;
-	vbDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT;
-	vbDesc.ppBuffer = &pVertexBuffer;
-	addResource(&vbDesc, NULL);
-
-	BufferLoadDesc ibDesc = vbDesc;
-	ibDesc.mDesc.mDescriptors = DESCRIPTOR_TYPE_INDEX_BUFFER;
-	ibDesc.mDesc.mSize = INDEX_BUFFER_SIZE * MAX_FRAMES;
-	ibDesc.ppBuffer = &pIndexBuffer;
-	addResource(&ibDesc, NULL);
+	addGeometryBuffers();
 
 	BufferLoadDesc ubDesc = {};
 	ubDesc.mDesc.mDescriptors = DESCRIPTOR_TYPE_UNIFORM_BUFFER;
@@ -899,6 +907,41 @@ bool ImguiGUIDriver::init(Renderer* renderer, uint32_t const maxDynamicUIUpdates
 	return true;
 }
 
+void ImguiGUIDriver::addGeometryBuffers()
+{
+	BufferLoadDesc vbDesc = {};
+	vbDesc.mDesc.mDescriptors = DESCRIPTOR_TYPE_VERTEX_BUFFER;
+	vbDesc.mDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_CPU_TO_GPU;
+	vbDesc.mDesc.mSize = mVertexSlotSize * MAX_FRAMES;
+	vbDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT;
+	vbDesc.ppBuffer = &pVertexBuffer;
+	addResource(&vbDesc, NULL);
+
+	BufferLoadDesc ibDesc = vbDesc;
+	ibDesc.mDesc.mDescriptors = DESCRIPTOR_TYPE_INDEX_BUFFER;
+	ibDesc.mDesc.mSize = mIndexSlotSize * MAX_FRAMES;
+	ibDesc.ppBuffer = &pIndexBuffer;
+	addResource(&ibDesc, NULL);
+}
+
+void ImguiGUIDriver::growGeometryBuffers(uint64_t vertexSize, uint64_t indexSize)
+{
+	while (mVertexSlotSize < vertexSize)
+		mVertexSlotSize *= 2;
+	while (mIndexSlotSize < indexSize)
+		mIndexSlotSize *= 2;
+	LOGF(
+		LogLevel::eINFO, "UI geometry of %llu vertex and %llu index bytes does not fit, growing the buffer slots to %llu and %llu bytes",
+		(unsigned long long)vertexSize, (unsigned long long)indexSize, (unsigned long long)mVertexSlotSize,
+		(unsigned long long)mIndexSlotSize);
+
+	// Frames in flight still read the old buffers
+	removeResourceDeferred(pVertexBuffer);
+	removeResourceDeferred(pIndexBuffer);
+	addGeometryBuffers();
+	mGeometryCache.invalidate();
+}
+
 void ImguiGUIDriver::exit()
 {
 	removeSampler(pRenderer, pDefaultSampler);
@@ -911,6 +954,7 @@ void ImguiGUIDriver::exit()
 	removeResource(pIndexBuffer);
 	for (uint32_t i = 0; i < MAX_FRAMES; ++i)
 		removeResource(pUniformBuffer[i]);
+	mGeometryCache.exit();
 
 	for (Texture*& pFontTexture : mFontTextures)
 		removeResource(pFontTexture);
@@ -1047,6 +1091,7 @@ bool ImguiGUIDriver::update(GUIUpdate* pGuiUpdate)
 	io.DisplaySize.x = pGuiUpdate->width;
 	io.DisplaySize.y = pGuiUpdate->height;
 	io.DeltaTime = pGuiUpdate->deltaTime;
+	mReuseUnchangedDrawData = pGuiUpdate->reuseUnchangedDrawData;
 	if (pMovePosition)
 		io.MousePos = *pMovePosition;
 	
@@ -1221,38 +1266,41 @@ void ImguiGUIDriver::draw(Cmd* pCmd)
 
 	Pipeline*            pPipeline = pPipelineTextured;
 
-	uint32_t vSize = 0;
-	uint32_t iSize = 0;
-	for (int n = 0; n < draw_data->CmdListsCount; n++)
+	uint64_t vSize = 0;
+	uint64_t iSize = 0;
+	getImguiGeometrySize(draw_data, &vSize, &iSize);
+	if (vSize > mVertexSlotSize || iSize > mIndexSlotSize)
+		growGeometryBuffers(vSize, iSize);
+
+	// Keep drawing from the slot written last while the geometry does not change
+	bool reuse = false;
+	if (mReuseUnchangedDrawData)
+		reuse = mGeometryCache.retain(draw_data, vSize, iSize);
+	else
+		mGeometryCache.invalidate();
+
+	if (!reuse)
 	{
-		const ImDrawList* cmd_list = draw_data->CmdLists[n];
-		vSize += (int)(cmd_list->VtxBuffer.size() * sizeof(ImDrawVert));
-		iSize += (int)(cmd_list->IdxBuffer.size() * sizeof(ImDrawIdx));
+		// Two draws read at most two slots, so the least recently drawn one is not used by the last MAX_FRAMES - 1 frames
+		mGeometrySlot = 0;
+		for (uint32_t i = 1; i < MAX_FRAMES; ++i)
+			if (mSlotLastDraw[i] < mSlotLastDraw[mGeometrySlot])
+				mGeometrySlot = i;
 	}
+	mSlotLastDraw[mGeometrySlot] = ++mDrawCount;
 
-	vSize = min<uint32_t>(vSize, VERTEX_BUFFER_SIZE);
-	iSize = min<uint32_t>(iSize, INDEX_BUFFER_SIZE);
-
-	// Copy and convert all vertices into a single contiguous buffer
-	uint64_t vOffset = frameIdx * VERTEX_BUFFER_SIZE;
-	uint64_t iOffset = frameIdx * INDEX_BUFFER_SIZE;
-	uint64_t vtx_dst = vOffset;
-	uint64_t idx_dst = iOffset;
-	for (int n = 0; n < draw_data->CmdListsCount; n++)
+	// Map the slot once and copy all lists into it, the buffers are persistently mapped where supported
+	uint64_t vOffset = mGeometrySlot * mVertexSlotSize;
+	uint64_t iOffset = mGeometrySlot * mIndexSlotSize;
+	if (vSize && !reuse)
 	{
-		const ImDrawList* cmd_list = draw_data->CmdLists[n];
-		BufferUpdateDesc  update = { pVertexBuffer, vtx_dst };
-		beginUpdateResource(&update);
-		memcpy(update.pMappedData, cmd_list->VtxBuffer.data(), cmd_list->VtxBuffer.size() * sizeof(ImDrawVert));
-		endUpdateResource(&update, NULL);
-
-		update = { pIndexBuffer, idx_dst };
-		beginUpdateResource(&update);
-		memcpy(update.pMappedData, cmd_list->IdxBuffer.data(), cmd_list->IdxBuffer.size() * sizeof(ImDrawIdx));
-		endUpdateResource(&update, NULL);
-
-		vtx_dst += (cmd_list->VtxBuffer.size() * sizeof(ImDrawVert));
-		idx_dst += (cmd_list->IdxBuffer.size() * sizeof(ImDrawIdx));
+		BufferUpdateDesc vertexUpdate = { pVertexBuffer, vOffset, vSize };
+		BufferUpdateDesc indexUpdate = { pIndexBuffer, iOffset, iSize };
+		beginUpdateResource(&vertexUpdate);
+		beginUpdateResource(&indexUpdate);
+		copyImguiGeometry(draw_data, 0, (uint8_t*)vertexUpdate.pMappedData, (uint8_t*)indexUpdate.pMappedData);
+		endUpdateResource(&vertexUpdate, NULL);
+		endUpdateResource(&indexUpdate, NULL);
 	}
 
 	float L = draw_data->DisplayPos.x;
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+#pragma once
+
+// CPU side of the geometry upload of ImguiGUIDriver::draw. Kept in a header so the UI benchmark can build ImGui frames
+// and upload them into plain memory, without a renderer.
+
+#include "../../Common_3/ThirdParty/OpenSource/imgui/imgui.h"
+
+#define IMEMORY_FROM_HEADER
+#include "../../Common_3/OS/Interfaces/IMemory.h"
+
+/// Bytes of vertices and indices of all command lists
+inline void getImguiGeometrySize(const ImDrawData* pDrawData, uint64_t* pVertexSize, uint64_t* pIndexSize)
+{
+	uint64_t vertexSize = 0;
+	uint64_t indexSize = 0;
+	for (int n = 0; n < pDrawData->CmdListsCount; ++n)
+	{
+		vertexSize += pDrawData->CmdLists[n]->VtxBuffer.size() * sizeof(ImDrawVert);
+		indexSize += pDrawData->CmdLists[n]->IdxBuffer.size() * sizeof(ImDrawIdx);
+	}
+	*pVertexSize = vertexSize;
+	*pIndexSize = indexSize;
+}
+
+/// Copies the vertices and indices of the command lists from firstList on back to back, starting at the given offsets
+inline void copyImguiGeometry(const ImDrawData* pDrawData, int firstList, uint8_t* pVertexDst, uint8_t* pIndexDst)
+{
+	for (int n = firstList; n < pDrawData->CmdListsCount; ++n)
+	{
+		const ImDrawList* pList = pDrawData->CmdLists[n];
+		const size_t      vertexSize = pList->VtxBuffer.size() * sizeof(ImDrawVert);
+		const size_t      indexSize = pList->IdxBuffer.size() * sizeof(ImDrawIdx);
+		memcpy(pVertexDst, pList->VtxBuffer.data(), vertexSize);
+		memcpy(pIndexDst, pList->IdxBuffer.data(), indexSize);
+		pVertexDst += vertexSize;
+		pIndexDst += indexSize;
+	}
+}
+
+/// CPU copy of the geometry last uploaded. Comparing against it stays in cached memory and stops at the first
+/// difference, unlike writing the geometry again into a write combined upload buffer.
+class ImguiGeometryCache
+{
+public:
+	void init()
+	{
+		pVertices = NULL;
+		pIndices = NULL;
+		mVertexCapacity = 0;
+		mIndexCapacity = 0;
+		invalidate();
+	}
+
+	void exit()
+	{
+		tf_free(pVertices);
+		tf_free(pIndices);
+		init();
+	}
+
+	/// Forgets the retained geometry, the next retain call returns false
+	void invalidate()
+	{
+		mVertexSize = 0;
+		mIndexSize = 0;
+		mValid = false;
+	}
+
+	/// Returns true when the draw data holds the same geometry as the last call. Otherwise keeps a copy of it, only
+	/// copying the command lists from the first one that differs.
+	bool retain(const ImDrawData* pDrawData, uint64_t vertexSize, uint64_t indexSize)
+	{
+		int      firstChanged = 0;
+		uint64_t vertexOffset = 0;
+		uint64_t indexOffset = 0;
+		if (mValid && vertexSize == mVertexSize && indexSize == mIndexSize)
+		{
+			for (; firstChanged < pDrawData->CmdListsCount; ++firstChanged)
+			{
+				const ImDrawList* pList = pDrawData->CmdLists[firstChanged];
+				const size_t      listVertexSize = pList->VtxBuffer.size() * sizeof(ImDrawVert);
+				const size_t      listIndexSize = pList->IdxBuffer.size() * sizeof(ImDrawIdx);
+				// Lists can move bytes between each other and keep the same total
+				if (vertexOffset + listVertexSize > mVertexSize || indexOffset + listIndexSize > mIndexSize ||
+					memcmp(pVertices + vertexOffset, pList->VtxBuffer.data(), listVertexSize) ||
+					memcmp(pIndices + indexOffset, pList->IdxBuffer.data(), listIndexSize))
+					break;
+				vertexOffset += listVertexSize;
+				indexOffset += listIndexSize;
+			}
+			if (firstChanged == pDrawData->CmdListsCount)
+				return true;
+		}
+
+		if (vertexSize > mVertexCapacity)
+		{
+			mVertexCapacity = vertexSize;
+			pVertices = (uint8_t*)tf_realloc(pVertices, mVertexCapacity);
+		}
+		if (indexSize > mIndexCapacity)
+		{
+			mIndexCapacity = indexSize;
+			pIndices = (uint8_t*)tf_realloc(pIndices, mIndexCapacity);
+		}
+		copyImguiGeometry(pDrawData, firstChanged, pVertices + vertexOffset, pIndices + indexOffset);
+		mVertexSize = vertexSize;
+		mIndexSize = indexSize;
+		mValid = true;
+		return false;
+	}
+
+private:
+	uint8_t* pVertices;
+	uint8_t* pIndices;
+	uint64_t mVertexCapacity;
+	uint64_t mIndexCapacity;
+	uint64_t mVertexSize;
+	uint64_t mIndexSize;
+	bool     mValid;
+};
@@ -22,10 +22,16 @@
 #include <Renderer/IResourceLoader.h>
 #include <OS/Interfaces/ILog.h>
 #include <OS/Interfaces/IInput.h>
+#include <ThirdParty/OpenSource/EASTL/sort.h>
+//The-forge memory allocator, must be the last include
+#include <OS/Interfaces/IMemory.h>
 
-//The-forge memory allocator
-extern bool MemAllocInit(const char* name);
-extern void MemAllocExit();
+//distance between the cubes of the stress scene
+static const float gGridSpacing = 3.0f;
+//frames between frame pacing log messages in windowed mode
+static const uint32_t gPacingLogInterval = 1000;
+//frame stats drawn below the gui window every frame
+static const TextDrawDesc gStatsTextDesc(0, 0xffffffff, 16.0f);
 
 Demo::~Demo()
 {
@@ -33,6 +39,8 @@ Demo::~Demo()
 	if (mRenderer != NULL)
 	{
 		waitQueueIdle(mGraphicsQueue);
+		//retired swapchains must go before the surface they handed over to the current one
+		flushDeferredRemovals();
 		mAppUI.Unload();
 		mAppUI.Exit();
 
@@ -44,13 +52,20 @@ Demo::~Demo()
 		removeShader(mRenderer, mShader);
 		removeRootSignature(mRenderer, mRootSignature);
 		removeDescriptorSet(mRenderer, mDescriptorSet);
+		removeDescriptorSet(mRenderer, mObjectDescriptorSet);
 		removePipeline(mRenderer, mGraphicsPipeline);
 		removeSampler(mRenderer, mSampler);
-		removeSwapChain(mRenderer, mSwapChain);
+		if (mSwapChain)
+			removeSwapChain(mRenderer, mSwapChain);
 		removeRenderTarget(mRenderer, mDepthBuffer);
 
 		for (uint32_t i = 0; i < gImageCount; ++i)
 		{
+			if (mOffscreenTargets[i])
+				removeRenderTarget(mRenderer, mOffscreenTargets[i]);
+			removeResource(mObjectBuffers[i]);
+			removeResource(mTimestampBuffers[i]);
+			removeQueryPool(mRenderer, mTimestampPools[i]);
 			removeFence(mRenderer, mRenderCompleteFences[i]);
 			removeSemaphore(mRenderer, mRenderCompleteSemaphores[i]);
          removeCmd(mRenderer, mCmds[i]);
@@ -64,18 +79,30 @@ Demo::~Demo()
 		removeRenderer(mRenderer);
 	}
 
+	//free these before the memory allocator goes away
+	mWorldMatrices.set_capacity(0);
+	mCpuFrameTimes.set_capacity(0);
+	mGpuFrameTimes.set_capacity(0);
+	mFramePacer.destroy();
+
 	Log::Exit();
    exitFileSystem();
 	MemAllocExit();
 }
 
-bool Demo::init(GLFWwindow *pWindow)
+bool Demo::init(GLFWwindow *pWindow, const DemoSettings& settings)
 {
-	//store the window pointer
+	//store the window pointer, it is NULL in headless mode
 	mWindow = pWindow;
-
-	//init memory allocator
-	if (!MemAllocInit(getName()))
+	mSettings = settings;
+	mFramePacer.setTargetFps(mSettings.targetFps);
+	HiresTimer initTimer;
+
+	//init memory allocator, small allocations go through the thread caches
+	MemAllocDesc memDesc = {};
+	memDesc.pAppName = getName();
+	memDesc.mBackend = MEM_ALLOC_BACKEND_THREAD_CACHE;
+	if (!MemAllocInit(&memDesc))
 	{
 		printf("Failed to init memory allocator\n");
 		return false;
@@ -131,10 +158,30 @@ bool Demo::init(GLFWwindow *pWindow)
    fsSetPathForResourceDir(pSystemFileIO, RM_CONTENT, RD_GPU_CONFIG, "gpucfg/");
 
 	//get framebuffer size, it may be different from window size
-	glfwGetFramebufferSize(pWindow, &mFbWidth, &mFbHeight);
+	if (mSettings.headless)
+	{
+		mFbWidth = (int32_t)mSettings.width;
+		mFbHeight = (int32_t)mSettings.height;
+	}
+	else
+	{
+		glfwGetFramebufferSize(pWindow, &mFbWidth, &mFbHeight);
+	}
+
+	//without an index the resource loader treats every binary as stale and compiles it again
+	if (mSettings.coldShaderCache)
+	{
+		char indexPath[FS_MAX_PATH] = {};
+		fsAppendPathComponent(fsGetResourceDirectory(RD_SHADER_BINARIES), "ShaderCache.index", indexPath);
+		remove(indexPath);
+	}
 
 	//init renderer interface
 	RendererDesc rendererDesc = {};
+#if defined(VULKAN)
+	//headless runs on machines without a gpu use a software implementation such as lavapipe
+	rendererDesc.mAllowCpuDevice = mSettings.headless;
+#endif
 	initRenderer(getName(), &rendererDesc, &mRenderer);
 	if (mRenderer == NULL)
 		return false;
@@ -167,9 +214,30 @@ bool Demo::init(GLFWwindow *pWindow)
 	}
 	addSemaphore(mRenderer, &mImageAcquiredSemaphore);
 
+	//gpu frame timestamps, read back once the frame's fence has signaled
+	getTimestampFrequency(mGraphicsQueue, &mTimestampFrequency);
+	for (uint32_t i = 0; i < gImageCount; ++i)
+	{
+		QueryPoolDesc queryDesc = {};
+		queryDesc.mType = QUERY_TYPE_TIMESTAMP;
+		queryDesc.mQueryCount = 2;
+		addQueryPool(mRenderer, &queryDesc, &mTimestampPools[i]);
+
+		BufferLoadDesc desc = {};
+		desc.ppBuffer = &mTimestampBuffers[i];
+		desc.mDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_GPU_TO_CPU;
+		desc.mDesc.mFlags = BUFFER_CREATION_FLAG_OWN_MEMORY_BIT | BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT;
+		desc.mDesc.mSize = 2 * sizeof(uint64_t);
+		desc.mDesc.mStartState = RESOURCE_STATE_COPY_DEST;
+		addResource(&desc, NULL);
+	}
+
 	//UI - create before swapchain as createSwapchainResources calls into mAppUI
-	if (!mAppUI.Init(mRenderer))
+	HiresTimer shaderTimer;
+	//frames are in flight until the fence of their slot is waited on, the latency mode only waits sooner
+	if (!mAppUI.Init(mRenderer, gImageCount))
 		return false;
+	mShaderLoadMs += shaderTimer.GetUSec(false) / 1000.0f;
 
 	mAppUI.LoadFont("TitilliumText/TitilliumText-Bold.otf");
 
@@ -184,7 +252,10 @@ bool Demo::init(GLFWwindow *pWindow)
 	mLoadActions.mClearDepth.stencil = 0;
 
 	//create swapchain and depth buffer
-	if (!createSwapchainResources())
+	if (!createSwapchainResources(NULL))
+		return false;
+
+	if (!mAppUI.Load(getRenderTargets()))
 		return false;
 
 	//vertex buffer
@@ -262,6 +333,24 @@ bool Demo::init(GLFWwindow *pWindow)
 		addResource(&desc, NULL);
 	}
 
+	//world matrices of the cubes, laid out on a square grid facing the camera
+	{
+		mGridColumns = (uint32_t)ceilf(sqrtf((float)mSettings.objectCount));
+		mWorldMatrices.resize(mSettings.objectCount);
+
+		BufferLoadDesc desc = {};
+		desc.mDesc.mDescriptors = DESCRIPTOR_TYPE_BUFFER;
+		desc.mDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_CPU_TO_GPU;
+		desc.mDesc.mSize = mSettings.objectCount * sizeof(glm::mat4);
+		desc.mDesc.mElementCount = mSettings.objectCount;
+		desc.mDesc.mStructStride = sizeof(glm::mat4);
+		for (uint32_t i = 0; i < gImageCount; ++i)
+		{
+			desc.ppBuffer = &mObjectBuffers[i];
+			addResource(&desc, NULL);
+		}
+	}
+
 	//texture
 	{
 		TextureLoadDesc desc = {};
@@ -288,7 +377,9 @@ bool Demo::init(GLFWwindow *pWindow)
 		desc.mStages[1] = { "demo.frag", NULL, 0 };
 		desc.mTarget = (ShaderTarget)mRenderer->mShaderTarget;
 
+		HiresTimer shaderTimer;
 		addShader(mRenderer, &desc, &mShader);
+		mShaderLoadMs += shaderTimer.GetUSec(false) / 1000.0f;
 	}
 
 	//root signature
@@ -302,6 +393,14 @@ bool Demo::init(GLFWwindow *pWindow)
 		desc.ppShaders = &mShader;
 
 		addRootSignature(mRenderer, &desc, &mRootSignature);
+		//resolve the push constant once instead of looking up its name every frame
+		mRootConstantIndex = getDescriptorIndexFromName(mRootSignature, "UniformBlockRootConstant");
+		//draw only binds by index, a shader without the push constant can't be drawn
+		if (mRootConstantIndex == UINT32_MAX)
+		{
+			LOGF(LogLevel::eERROR, "UniformBlockRootConstant not found in the root signature");
+			return false;
+		}
 	}
 
 	//wait for our resource loads to complete, we need the texture for the descriptor set
@@ -318,6 +417,17 @@ bool Demo::init(GLFWwindow *pWindow)
 		params[0].pName = "texture0";
 		params[0].ppTextures = &mTexture;
 		updateDescriptorSet(mRenderer, 0, mDescriptorSet, 1, params);
+
+		//per frame world matrices
+		DescriptorSetDesc objectDesc = { mRootSignature, DESCRIPTOR_UPDATE_FREQ_PER_FRAME, gImageCount };
+		addDescriptorSet(mRenderer, &objectDesc, &mObjectDescriptorSet);
+		for (uint32_t i = 0; i < gImageCount; ++i)
+		{
+			params[0] = {};
+			params[0].pName = "worldMatrices";
+			params[0].ppBuffers = &mObjectBuffers[i];
+			updateDescriptorSet(mRenderer, i, mObjectDescriptorSet, 1, params);
+		}
 	}
 
 	//pipeline state object
@@ -353,9 +463,9 @@ bool Demo::init(GLFWwindow *pWindow)
 		pipelineSettings.mPrimitiveTopo = PRIMITIVE_TOPO_TRI_LIST;
 		pipelineSettings.mRenderTargetCount = 1;
 		pipelineSettings.pDepthState = &depthStateDesc;
-		pipelineSettings.pColorFormats = &mSwapChain->ppRenderTargets[0]->mFormat;
-		pipelineSettings.mSampleCount = mSwapChain->ppRenderTargets[0]->mSampleCount;
-		pipelineSettings.mSampleQuality = mSwapChain->ppRenderTargets[0]->mSampleQuality;
+		pipelineSettings.pColorFormats = &getRenderTargets()[0]->mFormat;
+		pipelineSettings.mSampleCount = getRenderTargets()[0]->mSampleCount;
+		pipelineSettings.mSampleQuality = getRenderTargets()[0]->mSampleQuality;
 		pipelineSettings.mDepthStencilFormat = mDepthBuffer->mFormat;
 		pipelineSettings.pRootSignature = mRootSignature;
 		pipelineSettings.pShaderProgram = mShader;
@@ -381,8 +491,18 @@ bool Demo::init(GLFWwindow *pWindow)
 	//matrices
 	const float aspect = (float)mFbWidth / (float)mFbHeight;
 	mProjMatrix = glm::perspective(45.0f, aspect, 0.1f, 100.00f);
-	mViewMatrix = glm::lookAt(glm::vec3(0.0f, 0.0f, -5.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	//back the camera off so the whole grid fits
+	const float gridExtent = (mGridColumns - 1) * gGridSpacing;
+	mViewMatrix = glm::lookAt(glm::vec3(0.0f, 0.0f, -5.0f - gridExtent * 1.2f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	if (mSettings.headless)
+	{
+		mCpuFrameTimes.reserve(mSettings.frameCount);
+		mGpuFrameTimes.reserve(mSettings.frameCount);
+	}
 
+	mInitMs = initTimer.GetUSec(false) / 1000.0f;
+	LOGF(LogLevel::eINFO, "Startup: %.2fms, shaders %.2fms (%s shader cache)", mInitMs, mShaderLoadMs, mSettings.coldShaderCache ? "cold" : "warm");
 	return true;
 }
 
@@ -396,16 +516,8 @@ void Demo::onSize(const int32_t width, const int32_t height)
 	mFbWidth = width;
 	mFbHeight = height;
 
-	//wait for the graphics queue to be idle
-	waitQueueIdle(mGraphicsQueue);
-
-	//remove old swapchain and depth buffer
-	removeSwapChain(mRenderer, mSwapChain);
-	removeRenderTarget(mRenderer, mDepthBuffer);
-	mAppUI.Unload();
-
 	//create new swapchain and depth buffer
-	createSwapchainResources();
+	recreateSwapchainResources();
 
 	//recalc projection matrix
 	const float aspect = (float)mFbWidth / (float)mFbHeight;
@@ -426,18 +538,40 @@ void Demo::onMouseButton(int32_t button, int32_t action)
 	mAppUI.OnButton(InputBindings::BUTTON_SOUTH, buttonPressed, &mMousePosition);
 }
 
-bool Demo::createSwapchainResources()
+bool Demo::createSwapchainResources(SwapChain* pOldSwapChain)
 {
-	WindowHandle handle;
+	//create offscreen targets in place of the swapchain images
+	if (mSettings.headless)
+	{
+		RenderTargetDesc desc = {};
+		desc.mArraySize = 1;
+		desc.mClearValue = mLoadActions.mClearColorValues[0];
+		desc.mDepth = 1;
+		desc.mFormat = TinyImageFormat_R8G8B8A8_UNORM;
+		desc.mHeight = mFbHeight;
+		desc.mSampleCount = SAMPLE_COUNT_1;
+		desc.mSampleQuality = 0;
+		desc.mWidth = mFbWidth;
+		desc.mStartState = RESOURCE_STATE_SHADER_RESOURCE;
+		desc.mDescriptors = DESCRIPTOR_TYPE_TEXTURE;
+		for (uint32_t i = 0; i < gImageCount; ++i)
+		{
+			addRenderTarget(mRenderer, &desc, &mOffscreenTargets[i]);
+			if (mOffscreenTargets[i] == NULL)
+				return false;
+		}
+	}
+	//create swapchain
+	else
+	{
+		WindowHandle handle;
 #ifdef _WIN32
-	handle.window = glfwGetWin32Window(mWindow);
+		handle.window = glfwGetWin32Window(mWindow);
 #else
-	handle.window = glfwGetX11Window(mWindow);
-	handle.display = glfwGetX11Display();
+		handle.window = glfwGetX11Window(mWindow);
+		handle.display = glfwGetX11Display();
 #endif
 
-	//create swapchain
-	{
 		SwapChainDesc desc = {};
 		desc.mWindowHandle = handle;
 		desc.mPresentQueueCount = 1;
@@ -446,8 +580,9 @@ bool Demo::createSwapchainResources()
 		desc.mHeight = mFbHeight;
 		desc.mImageCount = gImageCount;
 		desc.mColorFormat = getRecommendedSwapchainFormat(true);
-		desc.mEnableVsync = true;
+		desc.mEnableVsync = mVSyncEnabled;
 		desc.mColorClearValue = mLoadActions.mClearColorValues[0];
+		desc.pOldSwapChain = pOldSwapChain;
 		addSwapChain(mRenderer, &desc, &mSwapChain);
 
 		if (mSwapChain == NULL)
@@ -472,19 +607,71 @@ bool Demo::createSwapchainResources()
 			return false;
 	}
 
-	if (!mAppUI.Load(mSwapChain->ppRenderTargets))
+	return true;
+}
+
+bool Demo::recreateSwapchainResources()
+{
+	SwapChain* pOldSwapChain = mSwapChain;
+	RenderTarget* pOldDepthBuffer = mDepthBuffer;
+
+#if defined(VULKAN)
+	//the new swapchain takes over the old one, which stays alive with the depth buffer until the frames using them are done
+	if (!createSwapchainResources(pOldSwapChain))
+		return false;
+
+	removeSwapChainDeferred(pOldSwapChain);
+	removeRenderTargetDeferred(pOldDepthBuffer);
+#else
+	//a window can only have one swapchain at a time here
+	waitQueueIdle(mGraphicsQueue);
+	removeSwapChain(mRenderer, pOldSwapChain);
+	removeRenderTarget(mRenderer, pOldDepthBuffer);
+
+	if (!createSwapchainResources(NULL))
 		return false;
+#endif
 
+	//the formats did not change so the UI pipelines are still valid
+	mAppUI.Resize(mSwapChain->ppRenderTargets);
 	return true;
 }
 
+void Demo::waitForNextFrame()
+{
+	mDeltaTime = mFramePacer.waitForNextFrame();
+
+	//latency mode - wait for the frame submitted maxFramesInFlight frames ago now, rather than when its slot is reused
+	if (mSettings.maxFramesInFlight < gImageCount)
+	{
+		Fence* pFence = mRenderCompleteFences[(mFrameIndex + gImageCount - mSettings.maxFramesInFlight) % gImageCount];
+		FenceStatus fenceStatus;
+		getFenceStatus(mRenderer, pFence, &fenceStatus);
+		if (fenceStatus == FENCE_STATUS_INCOMPLETE)
+			waitForFences(mRenderer, 1, &pFence);
+	}
+
+	//headless mode writes the pacing statistics at exit instead
+	if (!mSettings.headless && mFramePacer.getSampleCount() >= gPacingLogInterval)
+	{
+		FramePacerStats stats;
+		mFramePacer.getStats(stats);
+		LOGF(LogLevel::eINFO, "Frame pacing: mean %.3fms, std dev %.3fms, p99 jitter %.3fms, max jitter %.3fms", stats.meanMs,
+			stats.stdDevMs, stats.p99JitterMs, stats.maxJitterMs);
+		mFramePacer.resetStats();
+	}
+}
+
 void Demo::onRender()
 {
+	//cpu time of the frame, the wait for the gpu is taken out
+	mCpuTimer.Reset();
+
 	//delta time
-	const float deltaTime = mTimer.GetMSec(true) / 1000.0f;
+	const float deltaTime = mDeltaTime;
 
 	//mouse pos
-	if (glfwGetWindowAttrib(mWindow, GLFW_FOCUSED))
+	if (mWindow && glfwGetWindowAttrib(mWindow, GLFW_FOCUSED))
 	{
 		double mouseX, mouseY;
 		glfwGetCursorPos(mWindow, &mouseX, &mouseY);
@@ -498,27 +685,48 @@ void Demo::onRender()
 	//update UI
 	mAppUI.Update(deltaTime);
 
-	//cube rotation - make it spin slowly
+	//cube rotation - make it spin slowly, each cube of the grid a little ahead of the previous one
 	mRotation += deltaTime * mRotationSpeed;
-	mModelMatrix = glm::rotate(glm::mat4(1.0f), mRotation * glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-	mModelMatrix = glm::rotate(mModelMatrix, mRotation * glm::radians(180.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-	//recalculate world view projection matrix
-	const glm::mat4 worldViewProj = mProjMatrix * mViewMatrix *mModelMatrix;
+	const float halfGridExtent = 0.5f * (mGridColumns - 1) * gGridSpacing;
+	for (uint32_t i = 0; i < mSettings.objectCount; ++i)
+	{
+		const float rotation = (mRotation + i * 0.05f) * glm::radians(180.0f);
+		const glm::vec3 position((i % mGridColumns) * gGridSpacing - halfGridExtent, (i / mGridColumns) * gGridSpacing - halfGridExtent, 0.0f);
+		glm::mat4 world = glm::translate(glm::mat4(1.0f), position);
+		world = glm::rotate(world, rotation, glm::vec3(0.0f, 0.0f, 1.0f));
+		mWorldMatrices[i] = glm::rotate(world, rotation, glm::vec3(1.0f, 0.0f, 0.0f));
+	}
+	//recalculate view projection matrix
+	const glm::mat4 viewProj = mProjMatrix * mViewMatrix;
 
-	//aquire the next swapchain image
-   uint32_t swapchainImageIndex;
-	acquireNextImage(mRenderer, mSwapChain, mImageAcquiredSemaphore, NULL, &swapchainImageIndex);
+	//aquire the next swapchain image, headless mode cycles through its offscreen targets
+	uint32_t swapchainImageIndex = mFrameIndex;
+	if (!mSettings.headless)
+		acquireNextImage(mRenderer, mSwapChain, mImageAcquiredSemaphore, NULL, &swapchainImageIndex);
 
 	//make it easier on our fingers :)
-	RenderTarget* pRenderTarget = mSwapChain->ppRenderTargets[swapchainImageIndex];
+	RenderTarget* pRenderTarget = getRenderTargets()[swapchainImageIndex];
 	Semaphore*    pRenderCompleteSemaphore = mRenderCompleteSemaphores[mFrameIndex];
 	Fence*        pRenderCompleteFence = mRenderCompleteFences[mFrameIndex];
+	const ResourceState presentState = mSettings.headless ? RESOURCE_STATE_SHADER_RESOURCE : RESOURCE_STATE_PRESENT;
 
 	// Stall if CPU is running "Swap Chain Buffer Count" frames ahead of GPU
+	const int64_t waitStart = mCpuTimer.GetUSec(false);
 	FenceStatus fenceStatus;
 	getFenceStatus(mRenderer, pRenderCompleteFence, &fenceStatus);
 	if (fenceStatus == FENCE_STATUS_INCOMPLETE)
 		waitForFences(mRenderer, 1, &pRenderCompleteFence);
+	const int64_t waitTime = mCpuTimer.GetUSec(false) - waitStart;
+
+	//the frame that last used this slot is done, destroy what was removed back then
+	beginResourceFrame(gImageCount);
+	readGpuFrameTime(mFrameIndex);
+
+	//the gpu is done with this frame's world matrices
+	BufferUpdateDesc objectUpdate = { mObjectBuffers[mFrameIndex] };
+	beginUpdateResource(&objectUpdate);
+	memcpy(objectUpdate.pMappedData, mWorldMatrices.data(), mWorldMatrices.size() * sizeof(glm::mat4));
+	endUpdateResource(&objectUpdate, NULL);
 
    // Reset cmd pool for this frame
    resetCmdPool(mRenderer, mCmdPools[mFrameIndex]);
@@ -527,9 +735,17 @@ void Demo::onRender()
 	Cmd* pCmd = mCmds[mFrameIndex];
 	beginCmd(pCmd);
 
+	QueryDesc startQuery = { 0 };
+	QueryDesc endQuery = { 1 };
+	if (mSettings.headless)
+	{
+		cmdResetQueryPool(pCmd, mTimestampPools[mFrameIndex], 0, 2);
+		cmdBeginQuery(pCmd, mTimestampPools[mFrameIndex], &startQuery);
+	}
+
 	//transition our render target to a state that we can write to
    RenderTargetBarrier barriers[] = {
-            { pRenderTarget, RESOURCE_STATE_PRESENT, RESOURCE_STATE_RENDER_TARGET },
+            { pRenderTarget, presentState, RESOURCE_STATE_RENDER_TARGET },
    };
    cmdResourceBarrier(pCmd, 0, NULL, 0, NULL, 1, barriers);
 
@@ -540,8 +756,9 @@ void Demo::onRender()
 	cmdSetViewport(pCmd, 0.0f, 0.0f, (float)pRenderTarget->mWidth, (float)pRenderTarget->mHeight, 0.0f, 1.0f);
 	cmdSetScissor(pCmd, 0, 0, pRenderTarget->mWidth, pRenderTarget->mHeight);
 
-	//bind descriptor set
+	//bind descriptor sets
 	cmdBindDescriptorSet(pCmd, 0, mDescriptorSet);
+	cmdBindDescriptorSet(pCmd, mFrameIndex, mObjectDescriptorSet);
 	//bind pipeline state object
 	cmdBindPipeline(pCmd, mGraphicsPipeline);
 	//bind index buffer
@@ -550,37 +767,65 @@ void Demo::onRender()
 	const uint32_t stride = sizeof(Vertex);
 	cmdBindVertexBuffer(pCmd, 1, &mVertexBuffer, &stride, NULL);
 	//bind the push constant
-	cmdBindPushConstants(pCmd, mRootSignature, "UniformBlockRootConstant", &worldViewProj);
-	//draw our cube
-	cmdDrawIndexed(pCmd, mIndexCount, 0, 0);
+	cmdBindPushConstantsByIndex(pCmd, mRootSignature, mRootConstantIndex, &viewProj);
+	//draw our cubes
+	cmdDrawIndexedInstanced(pCmd, mIndexCount, 0, mSettings.objectCount, 0, 0);
 
 	//draw UI - we want the swapchain render target bound without the depth buffer
 	mLoadActions.mLoadActionsColor[0] = LOAD_ACTION_LOAD;
    mLoadActions.mLoadActionDepth = LOAD_ACTION_DONTCARE;
 	cmdBindRenderTargets(pCmd, 1, &pRenderTarget, NULL, &mLoadActions, NULL, NULL, -1, -1);
+	//the stats lines are recorded as one draw instead of one per string
+	char statsText[64];
+	const float statsLineHeight = gStatsTextDesc.mFontSize * 1.25f;
+	float2 statsPos(10.0f, 130.0f);
+	mAppUI.BeginTextBatch();
+	snprintf(statsText, sizeof(statsText), "Frame: %.2f ms", deltaTime * 1000.0f);
+	mAppUI.DrawText(pCmd, statsPos, statsText, &gStatsTextDesc);
+	statsPos.y += statsLineHeight;
+	snprintf(statsText, sizeof(statsText), "Cubes: %u", mSettings.objectCount);
+	mAppUI.DrawText(pCmd, statsPos, statsText, &gStatsTextDesc);
+	statsPos.y += statsLineHeight;
+	snprintf(statsText, sizeof(statsText), "Frames in flight: %u", mSettings.maxFramesInFlight);
+	mAppUI.DrawText(pCmd, statsPos, statsText, &gStatsTextDesc);
+	mAppUI.EndTextBatch();
 	mAppUI.Gui(mGuiWindow);
 	mAppUI.Draw(pCmd);
 
 	//make sure no render target is bound
 	cmdBindRenderTargets(pCmd, 0, NULL, NULL, NULL, NULL, NULL, -1, -1);
 	//transition render target to a present state
-   barriers[0] = { pRenderTarget, RESOURCE_STATE_RENDER_TARGET, RESOURCE_STATE_PRESENT };
+   barriers[0] = { pRenderTarget, RESOURCE_STATE_RENDER_TARGET, presentState };
 	cmdResourceBarrier(pCmd, 0, NULL, 0, NULL, 1, barriers);
 
+	if (mSettings.headless)
+	{
+		cmdEndQuery(pCmd, mTimestampPools[mFrameIndex], &endQuery);
+		cmdResolveQuery(pCmd, mTimestampPools[mFrameIndex], mTimestampBuffers[mFrameIndex], 0, 2);
+		mTimestampsPending[mFrameIndex] = true;
+	}
+
 	//end the command buffer
 	endCmd(pCmd);
 
-	//submit the graphics queue
+	//submit the graphics queue, there is nothing to present in headless mode
 	QueueSubmitDesc submitDesc = {};
 	submitDesc.mCmdCount = 1;
-	submitDesc.mSignalSemaphoreCount = 1;
-	submitDesc.mWaitSemaphoreCount = 1;
+	submitDesc.mSignalSemaphoreCount = mSettings.headless ? 0 : 1;
+	submitDesc.mWaitSemaphoreCount = mSettings.headless ? 0 : 1;
 	submitDesc.ppCmds = &pCmd;
 	submitDesc.ppSignalSemaphores = &pRenderCompleteSemaphore;
 	submitDesc.ppWaitSemaphores = &mImageAcquiredSemaphore;
 	submitDesc.pSignalFence = pRenderCompleteFence;
 	queueSubmit(mGraphicsQueue, &submitDesc);
 
+	if (mSettings.headless)
+	{
+		mCpuFrameTimes.push_back((mCpuTimer.GetUSec(false) - waitTime) / 1000.0f);
+		mFrameIndex = (mFrameIndex + 1) % gImageCount;
+		return;
+	}
+
 	//present the graphics queue
 	QueuePresentDesc presentDesc = {};
 	presentDesc.mIndex = swapchainImageIndex;
@@ -592,10 +837,80 @@ void Demo::onRender()
 
 	//check v-sync
 	if (mSwapChain->mEnableVsync != mVSyncEnabled)
+		recreateSwapchainResources();
+
+   mFrameIndex = (mFrameIndex + 1) % gImageCount;
+}
+
+RenderTarget** Demo::getRenderTargets()
+{
+	return mSettings.headless ? mOffscreenTargets : mSwapChain->ppRenderTargets;
+}
+
+void Demo::readGpuFrameTime(uint32_t frameIndex)
+{
+	if (!mTimestampsPending[frameIndex])
+		return;
+
+	const uint64_t* pTimestamps = (const uint64_t*)mTimestampBuffers[frameIndex]->pCpuMappedAddress;
+	const double ticks = (double)(pTimestamps[1] - pTimestamps[0]);
+
+	mGpuFrameTimes.push_back((float)(ticks / mTimestampFrequency * 1000.0));
+	mTimestampsPending[frameIndex] = false;
+}
+
+//mean, median, 99th percentile and maximum of the samples as a json object
+static void writeFrameTimeStats(FILE* pFile, const char* pName, eastl::vector<float>& samples, bool last)
+{
+	float mean = 0.0f, p50 = 0.0f, p99 = 0.0f, maximum = 0.0f;
+	if (!samples.empty())
 	{
-		waitQueueIdle(mGraphicsQueue);
-		toggleVSync(mRenderer, &mSwapChain);
+		eastl::sort(samples.begin(), samples.end());
+		double sum = 0.0;
+		for (float sample : samples)
+			sum += sample;
+		const size_t count = samples.size();
+		mean = (float)(sum / count);
+		//nearest rank percentiles
+		p50 = samples[(size_t)ceil(0.50 * count) - 1];
+		p99 = samples[(size_t)ceil(0.99 * count) - 1];
+		maximum = samples.back();
 	}
 
-   mFrameIndex = (mFrameIndex + 1) % gImageCount;
+	fprintf(pFile, "\t\"%s\": { \"samples\": %u, \"mean\": %.4f, \"p50\": %.4f, \"p99\": %.4f, \"max\": %.4f }%s\n", pName,
+		(uint32_t)samples.size(), mean, p50, p99, maximum, last ? "" : ",");
+}
+
+bool Demo::writeBenchmarkStats()
+{
+	//collect the timestamps of the frames still in flight
+	waitQueueIdle(mGraphicsQueue);
+	for (uint32_t i = 0; i < gImageCount; ++i)
+		readGpuFrameTime((mFrameIndex + i) % gImageCount);
+
+	FILE* pFile = fopen(mSettings.pStatsFile, "w");
+	if (!pFile)
+	{
+		LOGF(LogLevel::eERROR, "Failed to open %s for writing", mSettings.pStatsFile);
+		return false;
+	}
+
+	fprintf(pFile, "{\n");
+	fprintf(pFile, "\t\"gpu\": \"%s\",\n", mRenderer->pActiveGpuSettings->mGpuVendorPreset.mGpuName);
+	fprintf(pFile, "\t\"width\": %d,\n", mFbWidth);
+	fprintf(pFile, "\t\"height\": %d,\n", mFbHeight);
+	fprintf(pFile, "\t\"frames\": %u,\n", (uint32_t)mCpuFrameTimes.size());
+	fprintf(pFile, "\t\"objects\": %u,\n", mSettings.objectCount);
+	fprintf(pFile, "\t\"startup\": { \"shaderCache\": \"%s\", \"initMs\": %.4f, \"shaderLoadMs\": %.4f },\n", mSettings.coldShaderCache ? "cold" : "warm", mInitMs, mShaderLoadMs);
+	writeFrameTimeStats(pFile, "cpuMs", mCpuFrameTimes, false);
+	writeFrameTimeStats(pFile, "gpuMs", mGpuFrameTimes, false);
+	FramePacerStats pacing;
+	mFramePacer.getStats(pacing);
+	fprintf(pFile, "\t\"pacing\": { \"targetFps\": %u, \"maxFramesInFlight\": %u, \"samples\": %u, \"meanMs\": %.4f, \"stdDevMs\": %.4f, \"p99JitterMs\": %.4f, \"maxJitterMs\": %.4f }\n",
+		mSettings.targetFps, mSettings.maxFramesInFlight, pacing.frameCount, pacing.meanMs, pacing.stdDevMs, pacing.p99JitterMs, pacing.maxJitterMs);
+	fprintf(pFile, "}\n");
+	fclose(pFile);
+
+	LOGF(LogLevel::eINFO, "Benchmark statistics written to %s", mSettings.pStatsFile);
+	return true;
 }
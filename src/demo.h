@@ -19,6 +19,7 @@
 #include <Renderer/IRenderer.h>
 #include <OS/Interfaces/ITime.h>
 #include <Middleware_3/UI/AppUI.h>
+#include "framePacer.h"
 #include <glm/glm.hpp>
 
 //image count
@@ -27,6 +28,28 @@ const uint32_t gImageCount = 3;
 //forward declare
 struct GLFWwindow;
 
+//command line settings
+struct DemoSettings
+{
+	//render into offscreen targets without a window or swapchain and write benchmark statistics at exit
+	bool headless = false;
+	//frames rendered in headless mode
+	uint32_t frameCount = 1000;
+	//number of instanced cubes
+	uint32_t objectCount = 1;
+	//offscreen target size in headless mode
+	uint32_t width = 1280;
+	uint32_t height = 720;
+	//benchmark statistics file
+	const char* pStatsFile = "benchmark.json";
+	//frame rate limit, zero runs unlimited
+	uint32_t targetFps = 0;
+	//frames the cpu may queue ahead of the gpu, lower values trade throughput for input latency
+	uint32_t maxFramesInFlight = gImageCount;
+	//delete the shader cache index before loading, so every shader is compiled again and the startup time is measured cold
+	bool coldShaderCache = false;
+};
+
 struct Vertex
 {
 	glm::vec3 pos;
@@ -41,20 +64,29 @@ class Demo
 {
 public:
 	~Demo();
-	bool init(GLFWwindow *pWindow);
+	bool init(GLFWwindow *pWindow, const DemoSettings& settings);
 	void onSize(const int32_t width, const int32_t height);
 	void onMouseButton(int32_t button, int32_t action);
+	//paces the loop and applies the latency limit, call before polling input so it is sampled as late as possible
+	void waitForNextFrame();
 	void onRender();
+	//waits for the last frames and writes the cpu and gpu frame time statistics as json
+	bool writeBenchmarkStats();
    const char* getName() { return "ForgeDemo"; }
 private:
 
-	bool createSwapchainResources();
+	bool createSwapchainResources(SwapChain* pOldSwapChain);
+	bool recreateSwapchainResources();
+	RenderTarget** getRenderTargets();
+	void readGpuFrameTime(uint32_t frameIndex);
 
 	Renderer* mRenderer = NULL;
 	Queue* mGraphicsQueue = NULL;
    CmdPool* mCmdPools[gImageCount] = { NULL };
    Cmd* mCmds[gImageCount] = { NULL };
 	SwapChain* mSwapChain = NULL;
+	//headless mode renders into these instead of the swapchain
+	RenderTarget* mOffscreenTargets[gImageCount] = { NULL };
 	RenderTarget* mDepthBuffer = NULL;
 	LoadActionsDesc mLoadActions = {};
 	Fence* mRenderCompleteFences[gImageCount] = { NULL };
@@ -64,26 +96,48 @@ private:
 	Texture* mTexture = NULL;
 	Shader* mShader = NULL;
 	RootSignature* mRootSignature = NULL;
+	uint32_t mRootConstantIndex = UINT32_MAX;
 	DescriptorSet* mDescriptorSet = NULL;
 	Pipeline* mGraphicsPipeline = NULL;
 	Buffer* mVertexBuffer = NULL;
 	Buffer* mIndexBuffer = NULL;
 	Sampler* mSampler = NULL;
-
-	Timer mTimer;
+	//world matrix of every cube, one buffer per frame
+	Buffer* mObjectBuffers[gImageCount] = { NULL };
+	DescriptorSet* mObjectDescriptorSet = NULL;
+	eastl::vector<glm::mat4> mWorldMatrices;
+
+	//gpu timestamps at the start and end of every frame
+	QueryPool* mTimestampPools[gImageCount] = { NULL };
+	Buffer* mTimestampBuffers[gImageCount] = { NULL };
+	bool mTimestampsPending[gImageCount] = { false };
+	double mTimestampFrequency = 0.0;
+
+	//benchmark samples in milliseconds
+	eastl::vector<float> mCpuFrameTimes;
+	eastl::vector<float> mGpuFrameTimes;
+	HiresTimer mCpuTimer;
+	//time spent loading the demo and UI shaders, and the whole init, in milliseconds
+	float mShaderLoadMs = 0.0f;
+	float mInitMs = 0.0f;
+
+	DemoSettings mSettings;
+
+	FramePacer mFramePacer;
+	float mDeltaTime = 0.0f;
 
 	int32_t mFbWidth = 0;
 	int32_t mFbHeight = 0;
 
 	uint32_t mIndexCount = 0;
 	uint32_t mFrameIndex = 0;
+	uint32_t mGridColumns = 1;
 
 	GLFWwindow *mWindow = NULL;
 
 	//matrices
 	glm::mat4 mProjMatrix = glm::mat4(1.0f);
 	glm::mat4 mViewMatrix = glm::mat4(1.0f);
-	glm::mat4 mModelMatrix = glm::mat4(1.0f);
 	float mRotation = 0.0f;
 	float mRotationSpeed = 0.5f;
 
@@ -0,0 +1,127 @@
+//-----------------------------------------------------------------------------
+// Copyright 2020 Tim Barnes
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//----------------------------------------------------------------------------
+
+
+#include "framePacer.h"
+#include <math.h>
+#include <OS/Interfaces/IThread.h>
+#include <ThirdParty/OpenSource/EASTL/sort.h>
+
+void FramePacer::destroy()
+{
+	mFrameTimes.set_capacity(0);
+}
+
+void FramePacer::setTargetFps(uint32_t fps)
+{
+	mTargetPeriod = fps ? 1000000000LL / fps : 0;
+	//takes effect from the next frame on
+	mNextDeadline = mLastFrameTime + mTargetPeriod;
+}
+
+float FramePacer::waitForNextFrame()
+{
+	int64_t now = getNSec();
+
+	//nothing to wait for on the first frame
+	if (mTargetPeriod && mLastFrameTime)
+	{
+		//sleep while the deadline is further away than the recent oversleeps
+		while (mNextDeadline - now > mSpinThreshold)
+		{
+			const int64_t sleepTime = (mNextDeadline - now - mSpinThreshold) / 1000000 * 1000000;
+			Thread::Sleep((unsigned)(sleepTime / 1000000));
+			const int64_t wakeTime = getNSec();
+			updateSpinThreshold(wakeTime - now - sleepTime);
+			now = wakeTime;
+		}
+
+		//spin for the rest
+		while (now < mNextDeadline)
+			now = getNSec();
+	}
+
+	//keep the deadlines on a fixed grid, unless we fell a whole frame behind, catching up would mean a burst of short frames
+	mNextDeadline += mTargetPeriod;
+	if (mNextDeadline <= now)
+		mNextDeadline = now + mTargetPeriod;
+
+	const int64_t frameTime = mLastFrameTime ? now - mLastFrameTime : 0;
+	mLastFrameTime = now;
+	if (!frameTime)
+		return 0.0f;
+
+	mFrameTimes.push_back((float)(frameTime / 1e6));
+	return (float)(frameTime / 1e9);
+}
+
+void FramePacer::updateSpinThreshold(int64_t overshoot)
+{
+	//a single late wake up must not make every later frame spin for milliseconds, so the threshold is capped and
+	//moves back towards the recent overshoots with an exponential moving average, 1/16 of the way per sleep
+	int64_t limit = MAX_SPIN_THRESHOLD;
+	if (mTargetPeriod && mTargetPeriod < limit)
+		limit = mTargetPeriod;
+	if (overshoot > limit)
+		overshoot = limit;
+
+	if (overshoot > mSpinThreshold)
+		mSpinThreshold = overshoot;
+	else
+	{
+		int64_t target = INITIAL_SPIN_THRESHOLD;
+		if (overshoot > target)
+			target = overshoot;
+		mSpinThreshold -= (mSpinThreshold - target + 15) / 16;
+	}
+}
+
+void FramePacer::getStats(FramePacerStats &stats)
+{
+	stats = FramePacerStats();
+	const uint32_t count = (uint32_t)mFrameTimes.size();
+	if (!count)
+		return;
+
+	double sum = 0.0;
+	for (float frameTime : mFrameTimes)
+		sum += frameTime;
+	const double mean = sum / count;
+
+	double variance = 0.0;
+	for (float frameTime : mFrameTimes)
+		variance += (frameTime - mean) * (frameTime - mean);
+	variance /= count;
+
+	//an unlimited loop has no target, measure against the mean instead
+	const double target = mTargetPeriod ? mTargetPeriod / 1e6 : mean;
+	eastl::vector<float> jitter(count);
+	for (uint32_t i = 0; i < count; ++i)
+		jitter[i] = (float)fabs(mFrameTimes[i] - target);
+	eastl::sort(jitter.begin(), jitter.end());
+
+	stats.frameCount = count;
+	stats.meanMs = (float)mean;
+	stats.stdDevMs = (float)sqrt(variance);
+	//nearest rank
+	stats.p99JitterMs = jitter[(size_t)ceil(0.99 * count) - 1];
+	stats.maxJitterMs = jitter.back();
+}
+
+void FramePacer::resetStats()
+{
+	mFrameTimes.clear();
+}
@@ -0,0 +1,63 @@
+//-----------------------------------------------------------------------------
+// Copyright 2020 Tim Barnes
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//----------------------------------------------------------------------------
+
+
+#pragma once
+
+#include <OS/Interfaces/ITime.h>
+#include <ThirdParty/OpenSource/EASTL/vector.h>
+
+//frame time jitter of the frames since the last reset, in milliseconds
+struct FramePacerStats
+{
+	uint32_t frameCount = 0;
+	float meanMs = 0.0f;
+	float stdDevMs = 0.0f;
+	//deviation of the frame times from the target period, or from the mean when unlimited
+	float p99JitterMs = 0.0f;
+	float maxJitterMs = 0.0f;
+};
+
+//limits the render loop to a target frame rate, sleeping for the bulk of the wait and spinning on the monotonic
+//clock for the last stretch since sleeps are only accurate to the scheduler tick
+class FramePacer
+{
+public:
+	//frees the samples, must be called before the memory manager shuts down
+	void destroy();
+	//zero runs unlimited
+	void setTargetFps(uint32_t fps);
+	//waits until the next frame is due and returns the time since the previous frame in seconds
+	float waitForNextFrame();
+	void getStats(FramePacerStats &stats);
+	void resetStats();
+	uint32_t getSampleCount() const { return (uint32_t)mFrameTimes.size(); }
+	//called with how far each sleep overshot, public so tests can inject overshoots
+	void updateSpinThreshold(int64_t overshoot);
+	int64_t getSpinThreshold() const { return mSpinThreshold; }
+
+	//spin threshold in nanoseconds when sleeps are on time, and the most it grows to
+	static const int64_t INITIAL_SPIN_THRESHOLD = 1000000;
+	static const int64_t MAX_SPIN_THRESHOLD = 2000000;
+private:
+	int64_t mTargetPeriod = 0;
+	int64_t mNextDeadline = 0;
+	int64_t mLastFrameTime = 0;
+	//sleeps end this long before the deadline, jumps up when the OS oversleeps and decays back once it stops
+	int64_t mSpinThreshold = INITIAL_SPIN_THRESHOLD;
+	//frame times in milliseconds
+	eastl::vector<float> mFrameTimes;
+};
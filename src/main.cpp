@@ -16,6 +16,8 @@
 
 #include "demo.h"
 #include <GLFW/glfw3.h>
+#include <cstdlib>
+#include <cstring>
 
 //GLFW callbacks
 void errorCallback(int, const char* description)
@@ -37,6 +39,80 @@ void mouseButtonCallback(GLFWwindow* pWin, int button, int action, int)
 	pDemo->onMouseButton(button, action);
 }
 
+//command line
+bool parseSettings(int argc, const char **argv, DemoSettings &settings)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		const char *arg = argv[i];
+		if (!strcmp(arg, "--headless"))
+		{
+			settings.headless = true;
+			continue;
+		}
+		if (!strcmp(arg, "--cold-shader-cache"))
+		{
+			settings.coldShaderCache = true;
+			continue;
+		}
+
+		if (i + 1 >= argc)
+		{
+			printf("Argument expects a value: %s\n", arg);
+			return false;
+		}
+		const char *value = argv[++i];
+		if (!strcmp(arg, "--frames"))
+			settings.frameCount = (uint32_t)strtoul(value, NULL, 10);
+		else if (!strcmp(arg, "--objects"))
+			settings.objectCount = (uint32_t)strtoul(value, NULL, 10);
+		else if (!strcmp(arg, "--width"))
+			settings.width = (uint32_t)strtoul(value, NULL, 10);
+		else if (!strcmp(arg, "--height"))
+			settings.height = (uint32_t)strtoul(value, NULL, 10);
+		else if (!strcmp(arg, "--stats"))
+			settings.pStatsFile = value;
+		else if (!strcmp(arg, "--fps"))
+			settings.targetFps = (uint32_t)strtoul(value, NULL, 10);
+		else if (!strcmp(arg, "--max-frames-in-flight"))
+			settings.maxFramesInFlight = (uint32_t)strtoul(value, NULL, 10);
+		else
+		{
+			printf("Unrecognized argument: %s\n", arg);
+			printf("Usage: ForgeDemo [--headless] [--frames N] [--objects M] [--width W] [--height H] [--stats file.json] [--fps F] [--max-frames-in-flight K] [--cold-shader-cache]\n");
+			return false;
+		}
+	}
+
+	if (!settings.objectCount || !settings.width || !settings.height)
+	{
+		printf("--objects, --width and --height must be greater than zero\n");
+		return false;
+	}
+	if (!settings.maxFramesInFlight || settings.maxFramesInFlight > gImageCount)
+	{
+		printf("--max-frames-in-flight must be between 1 and %u\n", gImageCount);
+		return false;
+	}
+	return true;
+}
+
+//renders without a window and writes the frame time statistics, used for benchmarking on machines without a display
+int runHeadless(const DemoSettings &settings)
+{
+	Demo demo;
+	if (!demo.init(NULL, settings))
+		return EXIT_FAILURE;
+
+	for (uint32_t i = 0; i < settings.frameCount; ++i)
+	{
+		demo.waitForNextFrame();
+		demo.onRender();
+	}
+
+	return demo.writeBenchmarkStats() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 //Main
 #ifdef _WIN32
 int CALLBACK WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow)
@@ -44,6 +120,18 @@ int CALLBACK WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLi
 int main(int argc, const char **argv)
 #endif
 {
+#ifdef _WIN32
+	const int argc = __argc;
+	const char **argv = (const char **)__argv;
+#endif
+	DemoSettings settings;
+	if (!parseSettings(argc, argv, settings))
+		exit(EXIT_FAILURE);
+
+	//no glfw at all, it would need a display
+	if (settings.headless)
+		exit(runHeadless(settings));
+
 	//install glfw error callback first
 	glfwSetErrorCallback(errorCallback);
 	//init glfw
@@ -63,7 +151,7 @@ int main(int argc, const char **argv)
 	//Demo class
 	Demo demo;
 
-	if (!demo.init(pWindow))
+	if (!demo.init(pWindow, settings))
 	{
 		glfwTerminate();
       exit(EXIT_FAILURE);
@@ -78,7 +166,8 @@ int main(int argc, const char **argv)
 
 	while (!glfwWindowShouldClose(pWindow))
 	{
-		//poll events
+		//wait until the frame is due, then poll events
+		demo.waitForNextFrame();
 		glfwPollEvents();
 
 		//render
@@ -0,0 +1,395 @@
+//-----------------------------------------------------------------------------
+// Copyright 2020 Tim Barnes
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//----------------------------------------------------------------------------
+
+//checks the fontstash text path the demo draws its stats with, on a null renderer that counts what would reach the gpu:
+//- text drawn in a batch is recorded as one draw per frame, outside of a batch as one draw per string, with the same vertices
+//- nested batches are recorded by the outermost end
+//- strings/ms of per frame text with and without batching, for text that stays the same (cached layouts) and for numbers
+//  that change every frame (laid out again). The null renderer makes a draw nearly free, so this is the cpu side only
+//- text adding glyphs every frame, with uploads completing a frame later: only the first upload is waited for, uploads
+//  copy the part of the atlas their page is missing instead of the whole page, no upload writes a page an in-flight
+//  frame reads, and no page is drawn with before its upload completed
+//
+//options: --fonts <directory holding TitilliumText/TitilliumText-Bold.otf, relative to the working directory> --strings <per frame> --frames <per run>
+
+#include <Middleware_3/Text/Fontstash.h>
+#include <Renderer/IRenderer.h>
+#include <Renderer/IResourceLoader.h>
+#include <OS/Interfaces/IFileSystem.h>
+//the-forge test setup, must be the last include
+#include <Tools/Tests/TestCommon.h>
+
+static const char* gFontFile = "TitilliumText/TitilliumText-Bold.otf";
+static const uint32_t gAtlasSize = 512;
+static const uint32_t gFramesInFlight = 3;
+//a batch is flushed early once it fills half of the vertex ring, this holds a frame of a few hundred strings
+static const uint32_t gRingSize = 8 * 1024 * 1024;
+
+//what the null renderer was asked to do
+struct NullRendererStats
+{
+	uint32_t draws;
+	uint64_t vertices;
+	uint32_t pipelineBinds;
+	uint32_t descriptorSetBinds;
+	uint32_t vertexBufferBinds;
+	uint32_t textureUploads;
+	uint64_t uploadedBytes;
+	uint32_t stalls;
+	//writes to a page an in-flight frame reads, and draws with a page whose upload did not complete
+	uint32_t inFlightWrites;
+	uint32_t incompleteReads;
+};
+
+static NullRendererStats gStats = {};
+
+//the gpu side of the atlas pages, uploads complete when the test moves gCompletedToken
+struct NullAtlasPage
+{
+	DescriptorSet* pSet;
+	uint32_t       index;
+	Texture*       pTexture;
+	SyncToken      uploadToken;
+	uint64_t       bindFrame;
+};
+
+static NullAtlasPage gPages[16] = {};
+static uint32_t gPageCount = 0;
+static SyncToken gLastToken = 0;
+static SyncToken gCompletedToken = 0;
+//frames start at gFramesInFlight so a page bound in no frame is free
+static uint64_t gFrame = gFramesInFlight;
+
+//the null renderer, fontstash only keeps the objects it gets back and hands them to other calls
+static void* addNullObject() { return tf_calloc(1, 64); }
+
+void addShader(Renderer*, const ShaderLoadDesc*, Shader** ppShader) { *ppShader = (Shader*)addNullObject(); }
+void removeShader(Renderer*, Shader* pShader) { tf_free(pShader); }
+void addRootSignature(Renderer*, const RootSignatureDesc*, RootSignature** ppRootSignature) { *ppRootSignature = (RootSignature*)addNullObject(); }
+void removeRootSignature(Renderer*, RootSignature* pRootSignature) { tf_free(pRootSignature); }
+void addDescriptorSet(Renderer*, const DescriptorSetDesc*, DescriptorSet** ppDescriptorSet) { *ppDescriptorSet = (DescriptorSet*)addNullObject(); }
+
+void removeDescriptorSet(Renderer*, DescriptorSet* pDescriptorSet)
+{
+	for (uint32_t i = 0; i < gPageCount; ++i)
+	{
+		if (gPages[i].pSet == pDescriptorSet)
+			gPages[i--] = gPages[--gPageCount];
+	}
+	tf_free(pDescriptorSet);
+}
+
+//fontstash has one set per atlas page
+void updateDescriptorSet(Renderer*, uint32_t index, DescriptorSet* pDescriptorSet, uint32_t, const DescriptorData* pParams)
+{
+	ASSERT(gPageCount < sizeof(gPages) / sizeof(gPages[0]));
+	gPages[gPageCount++] = { pDescriptorSet, index, pParams[0].ppTextures[0], 0, 0 };
+}
+
+static NullAtlasPage* findPage(Texture* pTexture)
+{
+	for (uint32_t i = 0; i < gPageCount; ++i)
+	{
+		if (gPages[i].pTexture == pTexture)
+			return &gPages[i];
+	}
+	return NULL;
+}
+void addSampler(Renderer*, const SamplerDesc*, Sampler** ppSampler) { *ppSampler = (Sampler*)addNullObject(); }
+void removeSampler(Renderer*, Sampler* pSampler) { tf_free(pSampler); }
+void addPipeline(Renderer*, const PipelineDesc*, Pipeline** ppPipeline) { *ppPipeline = (Pipeline*)addNullObject(); }
+void removePipeline(Renderer*, Pipeline* pPipeline) { tf_free(pPipeline); }
+
+void addResource(BufferLoadDesc* pDesc, SyncToken*)
+{
+	Buffer* pBuffer = (Buffer*)tf_memalign(alignof(Buffer), sizeof(Buffer));
+	memset(pBuffer, 0, sizeof(Buffer));
+	pBuffer->mSize = pDesc->mDesc.mSize;
+	pBuffer->pCpuMappedAddress = tf_malloc(pDesc->mDesc.mSize);
+	*pDesc->ppBuffer = pBuffer;
+}
+
+void removeResource(Buffer* pBuffer)
+{
+	tf_free(pBuffer->pCpuMappedAddress);
+	tf_free(pBuffer);
+}
+
+void addResource(TextureLoadDesc* pDesc, SyncToken*)
+{
+	Texture* pTexture = (Texture*)tf_memalign(alignof(Texture), sizeof(Texture));
+	memset(pTexture, 0, sizeof(Texture));
+	pTexture->mWidth = pDesc->pDesc->mWidth;
+	pTexture->mHeight = pDesc->pDesc->mHeight;
+	pTexture->mDepth = 1;
+	pTexture->mFormat = pDesc->pDesc->mFormat;
+	*pDesc->ppTexture = pTexture;
+}
+
+void removeResource(Texture* pTexture) { tf_free(pTexture); }
+
+void beginUpdateResource(BufferUpdateDesc* pDesc) { pDesc->pMappedData = (uint8_t*)pDesc->pBuffer->pCpuMappedAddress + pDesc->mDstOffset; }
+void endUpdateResource(BufferUpdateDesc* pDesc, SyncToken*) { pDesc->pMappedData = NULL; }
+
+void beginUpdateResource(TextureUpdateDesc* pDesc)
+{
+	//r8 atlas, tightly packed
+	const bool region = pDesc->mRegionWidth && pDesc->mRegionHeight;
+	pDesc->mRowCount = region ? pDesc->mRegionHeight : pDesc->pTexture->mHeight;
+	pDesc->mSrcRowStride = region ? pDesc->mRegionWidth : pDesc->pTexture->mWidth;
+	pDesc->mDstRowStride = pDesc->mSrcRowStride;
+	pDesc->mSrcSliceStride = pDesc->mSrcRowStride * pDesc->mRowCount;
+	pDesc->mDstSliceStride = pDesc->mSrcSliceStride;
+	pDesc->pMappedData = (uint8_t*)tf_malloc(pDesc->mDstSliceStride);
+}
+
+void endUpdateResource(TextureUpdateDesc* pDesc, SyncToken* pToken)
+{
+	++gStats.textureUploads;
+	gStats.uploadedBytes += (uint64_t)pDesc->mRowCount * pDesc->mSrcRowStride;
+	tf_free(pDesc->pMappedData);
+	pDesc->pMappedData = NULL;
+
+	NullAtlasPage* pPage = findPage(pDesc->pTexture);
+	if (pPage->bindFrame && pPage->bindFrame + gFramesInFlight > gFrame)
+		++gStats.inFlightWrites;
+	pPage->uploadToken = ++gLastToken;
+	if (pToken)
+		*pToken = gLastToken;
+}
+
+bool isTokenCompleted(const SyncToken* pToken) { return *pToken <= gCompletedToken; }
+
+void waitForToken(const SyncToken* pToken)
+{
+	++gStats.stalls;
+	gCompletedToken = max(gCompletedToken, *pToken);
+}
+
+void waitQueueIdle(Queue*)
+{
+	++gStats.stalls;
+	gCompletedToken = gLastToken;
+}
+
+void cmdBindPipeline(Cmd*, Pipeline*) { ++gStats.pipelineBinds; }
+
+void cmdBindDescriptorSet(Cmd*, uint32_t index, DescriptorSet* pDescriptorSet)
+{
+	++gStats.descriptorSetBinds;
+	for (uint32_t i = 0; i < gPageCount; ++i)
+	{
+		NullAtlasPage& page = gPages[i];
+		if (page.pSet != pDescriptorSet || page.index != index)
+			continue;
+		if (page.uploadToken > gCompletedToken)
+			++gStats.incompleteReads;
+		page.bindFrame = gFrame;
+	}
+}
+void cmdBindVertexBuffer(Cmd*, uint32_t, Buffer**, const uint32_t*, const uint64_t*) { ++gStats.vertexBufferBinds; }
+
+void cmdDraw(Cmd*, uint32_t vertexCount, uint32_t)
+{
+	++gStats.draws;
+	gStats.vertices += vertexCount;
+}
+
+float2 getDpiScale() { return float2(1.0f, 1.0f); }
+
+//value of "--name <value>", or defaultValue when the option is missing
+static const char* getStringArg(int argc, char** argv, const char* pName, const char* defaultValue)
+{
+	for (int i = 1; i + 1 < argc; ++i)
+	{
+		if (!strcmp(argv[i], pName))
+			return argv[i + 1];
+	}
+	return defaultValue;
+}
+
+//a frame on the null renderer, the uploads of the previous frame have completed by now
+static void beginNullFrame(Fontstash& fontstash)
+{
+	gCompletedToken = gLastToken;
+	++gFrame;
+	fontstash.beginFrame();
+}
+
+//the kind of text drawn every frame, a label and a value that changes
+static void drawFrameText(Fontstash& fontstash, Cmd* pCmd, int fontId, uint32_t frame, uint32_t stringCount)
+{
+	char text[64];
+	for (uint32_t i = 0; i < stringCount; ++i)
+	{
+		snprintf(text, sizeof(text), "Timer %u: %.2f ms", i, ((frame * 7 + i * 13) % 400) / 100.0f);
+		fontstash.drawText(pCmd, text, 10.0f, 10.0f + (i % 40) * 18.0f, fontId, 0xffffffff, 16.0f);
+	}
+}
+
+static void testBatching(Fontstash& fontstash, Cmd* pCmd, int fontId, uint32_t stringCount)
+{
+	//one frame outside of a batch
+	beginNullFrame(fontstash);
+	gStats = {};
+	drawFrameText(fontstash, pCmd, fontId, 0, stringCount);
+	const NullRendererStats single = gStats;
+	TEST_CHECK(single.draws == stringCount);
+
+	//the same frame in a batch
+	beginNullFrame(fontstash);
+	gStats = {};
+	fontstash.beginTextBatch();
+	drawFrameText(fontstash, pCmd, fontId, 0, stringCount);
+	TEST_CHECK(gStats.draws == 0);
+	fontstash.endTextBatch();
+	TEST_CHECK(gStats.draws == 1);
+	TEST_CHECK(gStats.pipelineBinds == 1 && gStats.descriptorSetBinds == 1 && gStats.vertexBufferBinds == 1);
+	TEST_CHECK(gStats.vertices == single.vertices);
+	const NullRendererStats batched = gStats;
+
+	//a nested batch is recorded by the outer end
+	gStats = {};
+	fontstash.beginTextBatch();
+	fontstash.drawText(pCmd, "outer", 10.0f, 10.0f, fontId);
+	fontstash.beginTextBatch();
+	fontstash.drawText(pCmd, "inner", 10.0f, 30.0f, fontId);
+	fontstash.endTextBatch();
+	TEST_CHECK(gStats.draws == 0);
+	fontstash.endTextBatch();
+	TEST_CHECK(gStats.draws == 1);
+
+	//draws and binds recorded for the frame, what the gpu front end has to chew through
+	printf("batching: %u strings, %llu vertices, %u commands without a batch, %u with\n", stringCount, (unsigned long long)single.vertices,
+		single.draws + single.pipelineBinds + single.descriptorSetBinds + single.vertexBufferBinds,
+		batched.draws + batched.pipelineBinds + batched.descriptorSetBinds + batched.vertexBufferBinds);
+}
+
+//text at a size that changes every frame adds glyphs to the atlas in most frames
+static void testAtlasUploads(RenderTarget* pRenderTarget, Cmd* pCmd, uint32_t frameCount)
+{
+	Fontstash fontstash;
+	TEST_CHECK(fontstash.init(NULL, gAtlasSize, gAtlasSize, gRingSize, gFramesInFlight));
+	TEST_CHECK(fontstash.load(&pRenderTarget, 1, NULL));
+	const int fontId = fontstash.defineFont("default", gFontFile);
+
+	gStats = {};
+	char text[64];
+	for (uint32_t frame = 0; frame < frameCount; ++frame)
+	{
+		beginNullFrame(fontstash);
+		fontstash.beginTextBatch();
+		for (uint32_t i = 0; i < 8; ++i)
+		{
+			snprintf(text, sizeof(text), "Frame %u: %.2f ms", frame, ((frame * 7 + i * 13) % 400) / 100.0f);
+			fontstash.drawText(pCmd, text, 10.0f, 10.0f + i * 30.0f, fontId, 0xffffffff, 10.0f + (frame % 16));
+		}
+		fontstash.endTextBatch();
+	}
+
+	FontstashAtlasStats stats;
+	fontstash.getAtlasStats(&stats);
+	//the first upload waits since no page holds glyphs before it
+	TEST_CHECK(stats.mUploadWaits == 1 && gStats.stalls == 1);
+	TEST_CHECK(gStats.inFlightWrites == 0);
+	TEST_CHECK(gStats.incompleteReads == 0);
+	TEST_CHECK(stats.mUploads == gStats.textureUploads && stats.mUploadedBytes == gStats.uploadedBytes);
+	//every page starts with a full copy, the later uploads only copy what their page is missing
+	const uint64_t pageBytes = (uint64_t)gAtlasSize * gAtlasSize;
+	TEST_CHECK(stats.mUploads > gFramesInFlight + 1);
+	TEST_CHECK(stats.mUploadedBytes < stats.mUploads * pageBytes / 2);
+
+	printf("atlas: %u frames, %llu uploads of %llu KB (%llu KB as full page copies), %llu deferred, %u stalls\n", frameCount,
+		(unsigned long long)stats.mUploads, (unsigned long long)stats.mUploadedBytes / 1024,
+		(unsigned long long)(stats.mUploads * pageBytes) / 1024, (unsigned long long)stats.mDeferredUploads, gStats.stalls);
+
+	fontstash.unload();
+	fontstash.exit();
+}
+
+//returns strings per millisecond
+static double benchmarkFrameText(Fontstash& fontstash, Cmd* pCmd, int fontId, uint32_t stringCount, uint32_t frameCount, bool changing, bool batch)
+{
+	gStats = {};
+	const int64_t start = getNSec();
+	for (uint32_t frame = 0; frame < frameCount; ++frame)
+	{
+		beginNullFrame(fontstash);
+		if (batch)
+			fontstash.beginTextBatch();
+		drawFrameText(fontstash, pCmd, fontId, changing ? frame : 0, stringCount);
+		if (batch)
+			fontstash.endTextBatch();
+	}
+	const double ms = NsToMs(getNSec() - start);
+	TEST_CHECK(gStats.draws == (batch ? frameCount : frameCount * stringCount));
+	return stringCount * frameCount / ms;
+}
+
+int main(int argc, char** argv)
+{
+	const char* pFontDir = getStringArg(argc, argv, "--fonts", "fonts/");
+	const uint32_t stringCount = GetTestArg(argc, argv, "--strings", 200);
+	const uint32_t frameCount = GetTestArg(argc, argv, "--frames", 200);
+	if (!stringCount || !frameCount)
+	{
+		printf("--strings and --frames must be greater than zero\n");
+		return EXIT_FAILURE;
+	}
+
+	if (!InitTestEnvironment("FontstashTest"))
+		return EXIT_FAILURE;
+	fsSetPathForResourceDir(pSystemFileIO, RM_DEBUG, RD_FONTS, pFontDir);
+
+	Renderer* pRenderer = NULL;
+	Cmd cmd = {};
+	RenderTarget renderTarget = {};
+	renderTarget.mWidth = 1920;
+	renderTarget.mHeight = 1080;
+	renderTarget.mSampleCount = SAMPLE_COUNT_1;
+	renderTarget.mFormat = TinyImageFormat_R8G8B8A8_UNORM;
+	RenderTarget* pRenderTarget = &renderTarget;
+
+	Fontstash fontstash;
+	TEST_CHECK(fontstash.init(pRenderer, gAtlasSize, gAtlasSize, gRingSize, gFramesInFlight));
+	TEST_CHECK(fontstash.load(&pRenderTarget, 1, NULL));
+	const int fontId = fontstash.defineFont("default", gFontFile);
+	if (fontId < 0 || fontId == INT32_MAX)
+	{
+		printf("failed to load %s%s\n", pFontDir, gFontFile);
+		fontstash.unload();
+		fontstash.exit();
+		ExitTestEnvironment();
+		return EXIT_FAILURE;
+	}
+
+	testBatching(fontstash, &cmd, fontId, stringCount);
+	testAtlasUploads(pRenderTarget, &cmd, frameCount);
+
+	printf("strings/ms, %u strings per frame over %u frames:\n", stringCount, frameCount);
+	printf("  %-9s %10s %10s %8s\n", "text", "no batch", "batch", "speedup");
+	for (uint32_t changing = 0; changing < 2; ++changing)
+	{
+		const double single = benchmarkFrameText(fontstash, &cmd, fontId, stringCount, frameCount, changing != 0, false);
+		const double batched = benchmarkFrameText(fontstash, &cmd, fontId, stringCount, frameCount, changing != 0, true);
+		printf("  %-9s %10.0f %10.0f %7.2fx\n", changing ? "changing" : "same", single, batched, batched / single);
+	}
+
+	fontstash.unload();
+	fontstash.exit();
+
+	return ExitTestEnvironment();
+}
@@ -0,0 +1,121 @@
+//-----------------------------------------------------------------------------
+// Copyright 2020 Tim Barnes
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//----------------------------------------------------------------------------
+
+//checks the frame pacer:
+//- an injected oversleep raises the spin threshold at most to the cap, or to the frame period when that is shorter
+//- once sleeps are on time again the threshold decays back to its initial value without ever growing
+//- paced frames average the target period, also right after an injected oversleep
+//
+//options: --fps <target frame rate> --frames <paced frames per run>
+
+#include "framePacer.h"
+//the-forge test setup, must be the last include
+#include <Tools/Tests/TestCommon.h>
+
+//feeds on time sleeps until the threshold is back at its initial value, returns how many it took
+static uint32_t recoverSpinThreshold(FramePacer &pacer, int64_t onTimeOvershoot)
+{
+	uint32_t sleeps = 0;
+	int64_t previous = pacer.getSpinThreshold();
+	while (pacer.getSpinThreshold() > FramePacer::INITIAL_SPIN_THRESHOLD && sleeps < 1000)
+	{
+		pacer.updateSpinThreshold(onTimeOvershoot);
+		TEST_CHECK(pacer.getSpinThreshold() <= previous);
+		previous = pacer.getSpinThreshold();
+		++sleeps;
+	}
+	TEST_CHECK(pacer.getSpinThreshold() == FramePacer::INITIAL_SPIN_THRESHOLD);
+	return sleeps;
+}
+
+static void testInjectedOvershoot()
+{
+	FramePacer pacer;
+	pacer.setTargetFps(60);
+	TEST_CHECK(pacer.getSpinThreshold() == FramePacer::INITIAL_SPIN_THRESHOLD);
+
+	//a 50ms stall is capped
+	pacer.updateSpinThreshold(50000000);
+	TEST_CHECK(pacer.getSpinThreshold() == FramePacer::MAX_SPIN_THRESHOLD);
+	const uint32_t capSleeps = recoverSpinThreshold(pacer, 50000);
+
+	//an oversleep below the cap is taken as is, and repeating it keeps the threshold there
+	const int64_t moderate = (FramePacer::INITIAL_SPIN_THRESHOLD + FramePacer::MAX_SPIN_THRESHOLD) / 2;
+	pacer.updateSpinThreshold(moderate);
+	TEST_CHECK(pacer.getSpinThreshold() == moderate);
+	for (uint32_t i = 0; i < 100; ++i)
+		pacer.updateSpinThreshold(moderate);
+	TEST_CHECK(pacer.getSpinThreshold() == moderate);
+	recoverSpinThreshold(pacer, 0);
+
+	//frames shorter than the cap limit the threshold to a frame
+	FramePacer fastPacer;
+	fastPacer.setTargetFps(800);
+	fastPacer.updateSpinThreshold(50000000);
+	TEST_CHECK(fastPacer.getSpinThreshold() == 1000000000LL / 800);
+
+	printf("injected: 50ms oversleep capped at %.2fms, back to %.2fms after %u on time sleeps\n",
+		NsToMs(FramePacer::MAX_SPIN_THRESHOLD), NsToMs(FramePacer::INITIAL_SPIN_THRESHOLD), capSleeps);
+}
+
+static void testPacing(uint32_t fps, uint32_t frameCount)
+{
+	FramePacer pacer;
+	pacer.setTargetFps(fps);
+	pacer.waitForNextFrame();
+	for (uint32_t i = 0; i < frameCount; ++i)
+		pacer.waitForNextFrame();
+
+	FramePacerStats stats;
+	pacer.getStats(stats);
+	const double targetMs = 1000.0 / fps;
+	TEST_CHECK(stats.frameCount == frameCount);
+	TEST_CHECK(fabs(stats.meanMs - targetMs) < targetMs * 0.05);
+	TEST_CHECK(pacer.getSpinThreshold() <= FramePacer::MAX_SPIN_THRESHOLD);
+	printf("paced: %u frames at %u fps, mean %.3fms, std dev %.3fms, p99 jitter %.3fms, max jitter %.3fms\n", stats.frameCount,
+		fps, stats.meanMs, stats.stdDevMs, stats.p99JitterMs, stats.maxJitterMs);
+
+	//the same pacer after an oversleep, the real sleeps pull the threshold back down
+	pacer.resetStats();
+	pacer.updateSpinThreshold(50000000);
+	for (uint32_t i = 0; i < frameCount; ++i)
+		pacer.waitForNextFrame();
+	pacer.getStats(stats);
+	TEST_CHECK(fabs(stats.meanMs - targetMs) < targetMs * 0.05);
+	printf("after an injected oversleep: mean %.3fms, p99 jitter %.3fms, spin threshold %.3fms\n", stats.meanMs,
+		stats.p99JitterMs, NsToMs(pacer.getSpinThreshold()));
+
+	pacer.destroy();
+}
+
+int main(int argc, char** argv)
+{
+	const uint32_t fps = GetTestArg(argc, argv, "--fps", 60);
+	const uint32_t frameCount = GetTestArg(argc, argv, "--frames", 300);
+	if (!fps || fps > 1000 || !frameCount)
+	{
+		printf("--fps must be between 1 and 1000, --frames greater than zero\n");
+		return EXIT_FAILURE;
+	}
+
+	if (!InitTestEnvironment("FramePacerTest"))
+		return EXIT_FAILURE;
+
+	testInjectedOvershoot();
+	testPacing(fps, frameCount);
+
+	return ExitTestEnvironment();
+}